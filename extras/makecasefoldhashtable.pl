@@ -173,7 +173,7 @@ for (my $i = 0; $i < $HASHBUCKETS1_16; $i++) {
     my $num = '000' . $i;
     $num =~ s/\A.*?(\d\d\d)\Z/$1/;
     my $sym = "case_fold1_16_${num}";
-    print("static const CaseFoldMapping1_16 ${sym}[] = {\n$str\n};\n\n");
+    print("static constexpr CaseFoldMapping1_16 ${sym}[] = {\n$str\n};\n\n");
 }
 
 for (my $i = 0; $i < $HASHBUCKETS1_32; $i++) {
@@ -183,7 +183,7 @@ for (my $i = 0; $i < $HASHBUCKETS1_32; $i++) {
     my $num = '000' . $i;
     $num =~ s/\A.*?(\d\d\d)\Z/$1/;
     my $sym = "case_fold1_32_${num}";
-    print("static const CaseFoldMapping1_32 ${sym}[] = {\n$str\n};\n\n");
+    print("static constexpr CaseFoldMapping1_32 ${sym}[] = {\n$str\n};\n\n");
 }
 
 for (my $i = 0; $i < $HASHBUCKETS2_16; $i++) {
@@ -193,7 +193,7 @@ for (my $i = 0; $i < $HASHBUCKETS2_16; $i++) {
     my $num = '000' . $i;
     $num =~ s/\A.*?(\d\d\d)\Z/$1/;
     my $sym = "case_fold2_16_${num}";
-    print("static const CaseFoldMapping2_16 ${sym}[] = {\n$str\n};\n\n");
+    print("static constexpr CaseFoldMapping2_16 ${sym}[] = {\n$str\n};\n\n");
 }
 
 for (my $i = 0; $i < $HASHBUCKETS3_16; $i++) {
@@ -203,10 +203,10 @@ for (my $i = 0; $i < $HASHBUCKETS3_16; $i++) {
     my $num = '000' . $i;
     $num =~ s/\A.*?(\d\d\d)\Z/$1/;
     my $sym = "case_fold3_16_${num}";
-    print("static const CaseFoldMapping3_16 ${sym}[] = {\n$str\n};\n\n");
+    print("static constexpr CaseFoldMapping3_16 ${sym}[] = {\n$str\n};\n\n");
 }
 
-print("static const CaseFoldHashBucket1_16 case_fold_hash1_16[] = {\n");
+print("static constexpr CaseFoldHashBucket1_16 case_fold_hash1_16[] = {\n");
 
 for (my $i = 0; $i < $HASHBUCKETS1_16; $i++) {
     my $str = $foldPairs1_16[$i];
@@ -223,7 +223,7 @@ for (my $i = 0; $i < $HASHBUCKETS1_16; $i++) {
 print("};\n\n");
 
 
-print("static const CaseFoldHashBucket1_32 case_fold_hash1_32[] = {\n");
+print("static constexpr CaseFoldHashBucket1_32 case_fold_hash1_32[] = {\n");
 
 for (my $i = 0; $i < $HASHBUCKETS1_32; $i++) {
     my $str = $foldPairs1_32[$i];
@@ -240,7 +240,7 @@ for (my $i = 0; $i < $HASHBUCKETS1_32; $i++) {
 print("};\n\n");
 
 
-print("static const CaseFoldHashBucket2_16 case_fold_hash2_16[] = {\n");
+print("static constexpr CaseFoldHashBucket2_16 case_fold_hash2_16[] = {\n");
 
 for (my $i = 0; $i < $HASHBUCKETS2_16; $i++) {
     my $str = $foldPairs2_16[$i];
@@ -256,7 +256,7 @@ for (my $i = 0; $i < $HASHBUCKETS2_16; $i++) {
 }
 print("};\n\n");
 
-print("static const CaseFoldHashBucket3_16 case_fold_hash3_16[] = {\n");
+print("static constexpr CaseFoldHashBucket3_16 case_fold_hash3_16[] = {\n");
 
 for (my $i = 0; $i < $HASHBUCKETS3_16; $i++) {
     my $str = $foldPairs3_16[$i];
@@ -152,6 +152,13 @@
 ///   - .VDF (Gothic I/II engine archives)
 ///   - .SLB (Independence War archives)
 /// 
+/// Encrypted .ZIP entries, with either the traditional PKWARE cipher or
+///  WinZip AES, are opened by appending "$" and the password to the name, as
+///  in "maps/level1.map$hunter2". A wrong password fails the open with
+///  PHYSFS_ERR_BAD_PASSWORD. An AES entry read through from the start is
+///  also checked against its authentication code, and the read that reaches
+///  the end fails with PHYSFS_ERR_CORRUPT if it doesn't match.
+/// 
 /// String policy for PhysicsFS 2.0 and later:
 /// 
 /// PhysicsFS 1.0 could only deal with null-terminated ASCII strings. All high
@@ -217,9 +224,11 @@
 ///  \author Ryan C. Gordon.
 /// 
 #pragma once
+#include <cstddef>
 #include <cstdint>
 #include <concepts>
 #include <string_view>
+#include <memory_resource>
 
 
 /// All non-argument macros should use this facility                          
@@ -364,7 +373,8 @@ enum PHYSFS_ErrorCode {
    PHYSFS_ERR_OS_ERROR,         // Unspecified OS-level error.          
    PHYSFS_ERR_DUPLICATE,        // Duplicate entry.                     
    PHYSFS_ERR_BAD_PASSWORD,     // Bad password.                        
-   PHYSFS_ERR_APP_CALLBACK      // Application callback reported error. 
+   PHYSFS_ERR_APP_CALLBACK,     // Application callback reported error. 
+   PHYSFS_ERR_CANCELLED         // Operation was cancelled.             
 };
 
 namespace MetaPhysFS
@@ -627,6 +637,10 @@ PHYSFS_DECL int PHYSFS_init(const char* argv0);
  *  handles yourself before calling this function, so that you can gracefully
  *  handle a specific failure.
  *
+ * It also fails, with PHYSFS_ERR_BUSY and nothing torn down, when called on
+ *  one of the threads that serve PHYSFS_submitAsync(), since it has to wait
+ *  for those to end.
+ *
  * Once successfully deinitialized, PHYSFS_init() can be called again to
  *  restart the subsystem. All default API states are restored at this
  *  point, with the exception of any custom allocator you might have
@@ -921,6 +935,12 @@ PHYSFS_DECL const char* PHYSFS_getWriteDir(void);
  * This call will fail (and fail to change the write dir) if the current
  *  write dir still has files open in it.
  *
+ * The write dir doesn't have to be a directory: a file ending in ".mpl" is
+ *  a writable pack, a log that every file written goes into, created if it
+ *  isn't there yet. Writing many small files to one is far cheaper than to
+ *  a directory, and a file that's written and closed replaces the old one
+ *  in one step. The pack can be mounted for reading like any archive.
+ *
  *   \param newDir The new directory to be the root of the write dir,
  *                   specified in platform-dependent notation. Setting to nullptr
  *                   disables the write dir, so no files can be opened for
@@ -1391,6 +1411,107 @@ PHYSFS_DECL PHYSFS_File* PHYSFS_openAppend(const char* filename);
 PHYSFS_DECL PHYSFS_File* PHYSFS_openRead(const char* filename);
 
 
+/**
+ * \fn PHYSFS_File *PHYSFS_openReadDirect(const char *filename)
+ * \brief Open a file for streaming, bypassing the OS page cache.
+ *
+ * This works just like PHYSFS_openRead(), but on Linux the file is read
+ *  with direct i/o (O_DIRECT): data goes straight from the disk into buffers
+ *  PhysicsFS manages, without being cached by the kernel. Use it for large
+ *  files that are read sequentially, once, like video or music, so that
+ *  streaming them doesn't push everything else out of the page cache.
+ *
+ * Reading is done in large aligned blocks, and the next block is fetched in
+ *  the background while the current one is consumed, so you don't have to
+ *  align anything or use big reads yourself. Entries inside archives work
+ *  too, wherever they happen to start, as long as they're stored as-is
+ *  (see PHYSFS_StatEx::mappable) in an archive that lives on disk. Only that
+ *  one file is read directly: the archive itself, and every other file
+ *  opened from it, keep going through the page cache.
+ *
+ * Where direct i/o isn't available (other platforms, memory-mounted or
+ *  nested archives, compressed or encrypted entries), or the filesystem
+ *  refuses it (tmpfs, for one), you quietly get a regular handle instead,
+ *  same as PHYSFS_openRead() would return.
+ *
+ *   \param filename File to open for reading, in platform-independent
+ *                   notation.
+ *  \return A valid PhysicsFS filehandle on success, nullptr on error.
+ *          Use PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_openRead
+ */
+PHYSFS_DECL PHYSFS_File* PHYSFS_openReadDirect(const char* filename);
+
+/**
+ * \fn int PHYSFS_setReadAhead(PHYSFS_uint64 minSize)
+ * \brief Choose which compressed archive entries are read ahead.
+ *
+ * When a compressed entry of a ZIP or 7zip archive is opened, and its
+ *  packed data is at least (minSize) bytes long, a helper thread keeps
+ *  reading the next chunks of it while the current one is decompressed.
+ *  This hides disk (or network) latency behind the inflate work, which
+ *  helps most when the archive lives on slow media. Smaller entries are
+ *  read the usual way, since a thread isn't worth it for them.
+ *
+ * The default is one megabyte. The setting applies to files opened after
+ *  the call; handles that are already open keep what they have.
+ *
+ * Like the symlink setting, this belongs to the calling thread's current
+ *  context (see PHYSFS_setContext()), and only files opened in that context
+ *  use it. It goes back to the default when the context is destroyed, or
+ *  when PHYSFS_deinit() closes the default one.
+ *
+ *   \param minSize Smallest packed size to read ahead, or zero to switch
+ *                  read-ahead off entirely.
+ *  \return nonzero on success, zero if read-ahead isn't compiled into this
+ *          build (see METAPHYSFS_READ_AHEAD) or this platform has no
+ *          threads for it.
+ */
+PHYSFS_DECL int PHYSFS_setReadAhead(PHYSFS_uint64 minSize);
+
+/**
+ * \fn int PHYSFS_setInlineSmallFiles(PHYSFS_uint32 maxFileSize, PHYSFS_uint64 maxBytes)
+ * \brief Read small archive entries into memory when mounting.
+ *
+ * Opening a file in an archive costs a lookup, a duplicate of the
+ *  archive's i/o (a new file descriptor, for a native archive), a seek,
+ *  and for ZIP files a read of the entry's local header - all that for a
+ *  few hundred bytes, in packs full of UI or localization files.
+ *
+ * With this set, ZIP archives mounted afterwards read every entry of at
+ *  most (maxFileSize) bytes into one block of memory, in a single pass in
+ *  archive order, decompressing them as they go. Archives of the simple
+ *  uncompressed formats (GRP, HOG, WAD and the like) do the same, one
+ *  directory at a time, when a small file in that directory is first
+ *  opened. Opening an inlined file then does no i/o at all.
+ *
+ * An archive inlines entries until they add up to (maxBytes), and leaves
+ *  the rest to be read the usual way. Encrypted entries and symlinks are
+ *  never inlined, although a symlink to an inlined file is served from
+ *  memory too. The memory is freed when the archive is unmounted.
+ *
+ * The setting is picked up by each archive as it's mounted, so call this
+ *  before mounting the archives that should inline, and call it again with
+ *  zeroes to mount the others normally. It's off by default.
+ *
+ * Like the symlink setting, this belongs to the calling thread's current
+ *  context (see PHYSFS_setContext()), and only mounts in that context use
+ *  it. It goes back to off when the context is destroyed, or when
+ *  PHYSFS_deinit() closes the default one. An archive that's shared with
+ *  another context's mount (see PHYSFS_mount()) isn't parsed again, so it
+ *  keeps whatever the context that mounted it first had set.
+ *
+ *   \param maxFileSize Largest entry to inline, in bytes.
+ *   \param maxBytes Most memory one archive may inline, in bytes, or zero
+ *                   to stop inlining.
+ *  \return nonzero.
+ *
+ * \sa PHYSFS_mount
+ */
+PHYSFS_DECL int PHYSFS_setInlineSmallFiles(PHYSFS_uint32 maxFileSize,
+   PHYSFS_uint64 maxBytes);
+
 /**
  * \fn int PHYSFS_close(PHYSFS_File *handle)
  * \brief Close a PhysicsFS filehandle.
@@ -1401,6 +1522,10 @@ PHYSFS_DECL PHYSFS_File* PHYSFS_openRead(const char* filename);
  *  the filehandle stays open. A well-written program should ALWAYS check the
  *  return value from the close call in addition to every writing call!
  *
+ * Closing takes no global lock and costs the same no matter how many other
+ *  files are open. As with fclose(), passing a handle that was already
+ *  closed (or never opened) is undefined behaviour.
+ *
  *   \param handle handle returned from PHYSFS_open*().
  *  \return nonzero on success, zero on error. Use PHYSFS_getLastErrorCode()
  *          to obtain the specific error.
@@ -1602,6 +1727,15 @@ PHYSFS_DECL int PHYSFS_flush(PHYSFS_File* handle);
 
 /* Byteorder stuff... */
 #include <bit>
+#include <cstring>
+#include <ranges>
+#include <type_traits>
+
+#if defined(__SSSE3__) or defined(__AVX__)
+   #include <tmmintrin.h>
+#elif defined(__ARM_NEON)
+   #include <arm_neon.h>
+#endif
 
 /// Byteswap item from the specified endianness to the native endianness      
 template<::std::endian ENDIANNESS, PHYSFS_integer T>
@@ -1622,6 +1756,10 @@ constexpr T PHYSFS_swapBE(T x) noexcept {
    return PHYSFS_swap<::std::endian::big>(x);
 }
 
+/// Anything PHYSFS_readArray can byteswap element by element                 
+template<class...T>
+concept PHYSFS_scalar = ((::std::integral<T> or ::std::floating_point<T>) and ...);
+
 /* Everything above this line is part of the PhysicsFS 1.0 API. */
 
 /**
@@ -1657,8 +1795,29 @@ PHYSFS_DECL int PHYSFS_symbolicLinksPermitted(void);
 
 
 /**
- * \struct PHYSFS_DefaultAllocator
- * \brief The default PhysicsFS allocator that uses malloc, realloc, etc. directly.
+ * \enum PHYSFS_AllocTag
+ * \brief The subsystem a PhysicsFS allocation is made for.
+ *
+ * Every allocation carries one of these, both into your allocator's
+ *  callbacks and into the numbers PHYSFS_getAllocStats() reports, so memory
+ *  can be routed to (and accounted against) the right arena.
+ *
+ * \sa PHYSFS_AllocatorCallbacks
+ * \sa PHYSFS_getAllocStats
+ */
+typedef enum PHYSFS_AllocTag
+{
+   PHYSFS_ALLOC_GENERAL,    /**< anything not listed below */
+   PHYSFS_ALLOC_DIRTREE,    /**< archive directory trees and entry tables */
+   PHYSFS_ALLOC_FILEHANDLE, /**< open files and their i/o objects */
+   PHYSFS_ALLOC_DECOMPRESS, /**< decompression buffers and stream state */
+   PHYSFS_ALLOC_CACHE,      /**< read buffers and cached file data */
+   PHYSFS_ALLOC_TAG_COUNT   /**< number of tags; means "all" for stats */
+} PHYSFS_AllocTag;
+
+/**
+ * \struct PHYSFS_AllocatorCallbacks
+ * \brief Entry points of a custom PhysicsFS allocator.
  *
  * (This is for limited, hardcore use. If you don't immediately see a need
  *  for it, you can probably ignore this forever.)
@@ -1667,9 +1826,89 @@ PHYSFS_DECL int PHYSFS_symbolicLinksPermitted(void);
  *  Allocators are assumed to be reentrant by the caller; please mutex
  *  accordingly.
  *
+ * Every callback gets the (userdata) from this struct, and the tag of the
+ *  allocation. Free() also gets the size that was asked for, so sized
+ *  deallocation (and std::pmr) works. Memory must be aligned at least like
+ *  std::max_align_t. Init(), Deinit() and Realloc() may be nullptr; without
+ *  Realloc(), PhysicsFS allocates, copies and frees instead.
+ *
  * \sa PHYSFS_setAllocator
  */
-template<class T = void>
+typedef struct PHYSFS_AllocatorCallbacks
+{
+   int (*Init)(void* userdata);  /**< Initialize. Can be nullptr. Zero on failure. */
+   void (*Deinit)(void* userdata);  /**< Deinitialize your allocator. Can be nullptr. */
+   void* (*Malloc)(PHYSFS_uint64 size, PHYSFS_AllocTag tag, void* userdata);  /**< Allocate like malloc(). */
+   void* (*Realloc)(void* ptr, PHYSFS_uint64 oldsize, PHYSFS_uint64 newsize, PHYSFS_AllocTag tag, void* userdata); /**< Reallocate like realloc(). Can be nullptr. */
+   void (*Free)(void* ptr, PHYSFS_uint64 size, PHYSFS_AllocTag tag, void* userdata); /**< Free memory from Malloc or Realloc. */
+   void* userdata;  /**< Passed to every callback above. */
+} PHYSFS_AllocatorCallbacks;
+
+/**
+ * \struct PHYSFS_AllocStats
+ * \brief Live memory usage of one PhysicsFS subsystem.
+ *
+ * Sizes are what PhysicsFS asked for, not counting the allocator's own
+ *  overhead.
+ *
+ * \sa PHYSFS_getAllocStats
+ */
+typedef struct PHYSFS_AllocStats
+{
+   PHYSFS_uint64 liveBytes;  /**< bytes currently allocated */
+   PHYSFS_uint64 liveCount;  /**< allocations currently alive */
+   PHYSFS_uint64 peakBytes;  /**< highest liveBytes seen so far */
+   PHYSFS_uint64 totalCount; /**< allocations made so far */
+} PHYSFS_AllocStats;
+
+/**
+ * \fn void *PHYSFS_allocate(PHYSFS_uint64 size, PHYSFS_AllocTag tag)
+ * \brief Allocate memory through the current PhysicsFS allocator.
+ *
+ * This is what PHYSFS_Allocator and everything inside PhysicsFS allocates
+ *  with, so you rarely need it directly. Memory must be released with
+ *  PHYSFS_deallocate(), and nothing else.
+ *
+ *    \param size number of bytes to allocate.
+ *    \param tag subsystem to attribute this allocation to.
+ *   \return the new memory, or nullptr if out of memory.
+ *
+ * \sa PHYSFS_reallocate
+ * \sa PHYSFS_deallocate
+ */
+PHYSFS_DECL void* PHYSFS_allocate(PHYSFS_uint64 size, PHYSFS_AllocTag tag);
+
+/**
+ * \fn void *PHYSFS_reallocate(void *ptr, PHYSFS_uint64 size, PHYSFS_AllocTag tag)
+ * \brief Resize memory from PHYSFS_allocate(), like realloc().
+ *
+ *    \param ptr memory to resize, or nullptr to allocate.
+ *    \param size new size in bytes.
+ *    \param tag subsystem for a new allocation; (ptr) keeps its own tag.
+ *   \return the resized memory, or nullptr if out of memory, in which case
+ *           (ptr) is left untouched.
+ */
+PHYSFS_DECL void* PHYSFS_reallocate(void* ptr, PHYSFS_uint64 size, PHYSFS_AllocTag tag);
+
+/**
+ * \fn void PHYSFS_deallocate(void *ptr)
+ * \brief Release memory from PHYSFS_allocate() or PHYSFS_reallocate().
+ *
+ *    \param ptr memory to release. nullptr is a no-op.
+ */
+PHYSFS_DECL void PHYSFS_deallocate(void* ptr);
+
+
+/**
+ * \class PHYSFS_DefaultAllocator
+ * \brief Reference counted memory, allocated through PHYSFS_allocate().
+ *
+ * All memory goes through the runtime allocator installed with
+ *  PHYSFS_setAllocator(), and is attributed to (TAG).
+ *
+ * \sa PHYSFS_setAllocator
+ */
+template<class T = void, PHYSFS_AllocTag TAG = PHYSFS_ALLOC_GENERAL>
 class PHYSFS_DefaultAllocator {
 protected:
    T*   mPointer = nullptr;
@@ -1686,18 +1925,19 @@ public:
 
       // Allocate the data first                                        
       if constexpr (::std::is_void_v<T>)
-         mPointer = malloc(c);
+         mPointer = PHYSFS_allocate(c, TAG);
       else
-         mPointer = static_cast<T*>(malloc(sizeof(T) * c));
+         mPointer = static_cast<T*>(PHYSFS_allocate(sizeof(T) * c, TAG));
 
       if (not mPointer)
          MetaPhysFS::Throw<PHYSFS_ERR_OUT_OF_MEMORY>();
 
       // Allocate the reference counter                                 
-      mReferences = static_cast<int*>(malloc(sizeof(int)));
+      mReferences = static_cast<int*>(PHYSFS_allocate(sizeof(int), TAG));
       if (not mReferences) {
+         PHYSFS_deallocate(mPointer);
+         mPointer = nullptr;
          MetaPhysFS::Throw<PHYSFS_ERR_OUT_OF_MEMORY>();
-         free(mPointer);
       }
       *mReferences = 1;
 
@@ -1749,8 +1989,8 @@ public:
          }
 
          // Free all allocated data                                     
-         free(mPointer);
-         free(mReferences);
+         PHYSFS_deallocate(mPointer);
+         PHYSFS_deallocate(mReferences);
       }
       else --*mReferences;
    }
@@ -1784,13 +2024,13 @@ public:
    /// Destroy a pointer                                                      
    ///   @attention doesn't call any destructors                              
    METAPHYSFS(INLINED) static void Free(void* ptr) {
-      free(ptr);
+      PHYSFS_deallocate(ptr);
    }
 
-   /// Reallocate a pointer                                                   
+   /// Reallocate a pointer, keeping its tag, or make a new one with TAG      
    ///   @attention doesn't call any destructors                              
    METAPHYSFS(INLINED) static void* Realloc(void* ptr, size_t bytes) {
-      return realloc(ptr, bytes);
+      return PHYSFS_reallocate(ptr, bytes, TAG);
    }
 
    /// Get the contained pointer                                              
@@ -1805,11 +2045,18 @@ public:
    /// Add a reference, so that this handle never deallocates, and return raw 
    /// pointer. This is allowed only if elements do not need their destructors
    /// called. You will still have to free the returned pointer at some point 
+   /// If this is the only handle, it lets go of the pointer altogether, so   
+   /// that the reference counter isn't leaked along with it                  
    ///   @return the contained pointer                                        
    METAPHYSFS(INLINED) T* Ref() noexcept {
       if (not mReferences)
          return nullptr;
-      ++*mReferences;
+
+      if (*mReferences == 1) {
+         PHYSFS_deallocate(mReferences);
+         mReferences = nullptr;
+      }
+      else ++*mReferences;
       return mPointer;
    }
 
@@ -1844,7 +2091,7 @@ public:
 
 
 /**
- * \fn int PHYSFS_setAllocator(const PHYSFS_Allocator *allocator)
+ * \fn int PHYSFS_setAllocator(const PHYSFS_AllocatorCallbacks *allocator)
  * \brief Hook your own allocation routines into PhysicsFS.
  *
  * (This is for limited, hardcore use. If you don't immediately see a need
@@ -1863,19 +2110,92 @@ public:
  *  calls. If you want to return to the platform's default allocator, pass a
  *  nullptr in here.
  *
+ * The structure is copied, so it doesn't have to outlive this call. Memory
+ *  is always freed through the allocator that is current at the time, so
+ *  don't switch while you still hold anything PhysicsFS allocated for you.
+ *
  * If you aren't immediately sure what to do with this function, you can
  *  safely ignore it altogether.
  *
  *    \param allocator Structure containing your allocator's entry points.
  *   \return zero on failure, non-zero on success. This call only fails
  *           when used between PHYSFS_init() and PHYSFS_deinit() calls.
+ *
+ * \sa PHYSFS_getAllocator
+ * \sa MetaPhysFS::SetMemoryResource
  */
 #ifndef PHYSFS_Allocator
-   template<class T = void>
-   using PHYSFS_Allocator = PHYSFS_DefaultAllocator<T>;
+   template<class T = void, PHYSFS_AllocTag TAG = PHYSFS_ALLOC_GENERAL>
+   using PHYSFS_Allocator = PHYSFS_DefaultAllocator<T, TAG>;
 #endif
 
-//PHYSFS_DECL int PHYSFS_setAllocator(const PHYSFS_Allocator* allocator);
+PHYSFS_DECL int PHYSFS_setAllocator(const PHYSFS_AllocatorCallbacks* allocator);
+
+/**
+ * \fn const PHYSFS_AllocatorCallbacks *PHYSFS_getAllocator(void)
+ * \brief Discover the current allocator.
+ *
+ * (This is for limited, hardcore use. If you don't immediately see a need
+ *  for it, you can probably ignore this forever.)
+ *
+ *  \return The callbacks PhysicsFS is allocating with right now, either
+ *           the ones you set or the platform's defaults. Don't free it.
+ *
+ * \sa PHYSFS_setAllocator
+ */
+PHYSFS_DECL const PHYSFS_AllocatorCallbacks* PHYSFS_getAllocator(void);
+
+/**
+ * \fn int PHYSFS_getAllocStats(PHYSFS_AllocTag tag, PHYSFS_AllocStats *stats)
+ * \brief Query how much memory a PhysicsFS subsystem is using.
+ *
+ * Statistics are kept for the lifetime of the process, independently of
+ *  PHYSFS_init() and of which allocator is installed, and are safe to read
+ *  from any thread at any time.
+ *
+ *    \param tag subsystem to query, or PHYSFS_ALLOC_TAG_COUNT for the sum
+ *               of all of them.
+ *    \param stats filled in on success.
+ *   \return non-zero on success, zero if (tag) or (stats) is invalid.
+ *
+ * \sa PHYSFS_AllocTag
+ */
+PHYSFS_DECL int PHYSFS_getAllocStats(PHYSFS_AllocTag tag, PHYSFS_AllocStats* stats);
+
+
+namespace MetaPhysFS
+{
+   ///                                                                        
+   ///   Route all PhysicsFS allocations to a std::pmr::memory_resource       
+   ///                                                                        
+   /// Builds PHYSFS_AllocatorCallbacks around the resource and installs      
+   /// them with PHYSFS_setAllocator(), so the same rules apply: call it      
+   /// before PHYSFS_init(), and keep the resource alive until after          
+   /// PHYSFS_deinit(). Pass nullptr to go back to the default allocator      
+   ///   @param resource - the memory resource to allocate from               
+   ///   @return non-zero on success, zero if PhysicsFS is initialized        
+   inline int SetMemoryResource(::std::pmr::memory_resource* resource) {
+      if (not resource)
+         return PHYSFS_setAllocator(nullptr);
+
+      static constexpr auto align = alignof(::std::max_align_t);
+      PHYSFS_AllocatorCallbacks callbacks {};
+      callbacks.userdata = resource;
+      callbacks.Malloc = [](PHYSFS_uint64 size, PHYSFS_AllocTag, void* ud) -> void* {
+         try {
+            return static_cast<::std::pmr::memory_resource*>(ud)->allocate(size, align);
+         }
+         catch (...) {
+            return nullptr;
+         }
+      };
+      callbacks.Free = [](void* ptr, PHYSFS_uint64 size, PHYSFS_AllocTag, void* ud) {
+         static_cast<::std::pmr::memory_resource*>(ud)->deallocate(ptr, size, align);
+      };
+      return PHYSFS_setAllocator(&callbacks);
+   }
+
+} // namespace MetaPhysFS
 
 
 /**
@@ -1908,6 +2228,23 @@ public:
  *  regardless of the state of PHYSFS_permitSymbolicLinks(). That function
  *  only deals with symlinks inside the mounted directory or archive.
  *
+ * Archives inside archives can be mounted directly, by continuing the path
+ *  past the outer archive: "mods/pack.zip/levels/extra.pak" mounts the
+ *  file levels/extra.pak of mods/pack.zip, and nesting can go as deep as
+ *  you like. An inner archive that is stored uncompressed is read straight
+ *  from its place in the outer one, so mounting it and opening files in it
+ *  costs about what it would on disk. A compressed one is decompressed into
+ *  memory once, when mounted, so that it seeks as cheaply as a file. This
+ *  is much faster than PHYSFS_mountHandle() on a file opened from the outer
+ *  archive. Nested archives are read-only.
+ *
+ * An archive file that is mounted already, in this or any other context
+ *  (see PHYSFS_createContext()), isn't parsed again: the new mount shares
+ *  the parsed archive, even if it names the file through another path or a
+ *  link to it. A file that changed size or modification time since counts
+ *  as a different archive. Only archives mounted by file name are shared,
+ *  not directories, nested archives or archives mounted from a PHYSFS_Io.
+ *
  *   \param newDir directory or archive to add to the path, in
  *                   platform-dependent notation.
  *   \param mountPoint Location in the interpolated tree that this archive
@@ -2435,14 +2772,21 @@ typedef PHYSFS_EnumerateCallbackResult(*PHYSFS_EnumerateCallback)(void* data,
  * PHYSFS_enumerate("/some/path", printDir, nullptr);
  * \endcode
  *
- * Items sent to the callback are not guaranteed to be in any order whatsoever.
- *  There is no sorting done at this level, and if you need that, you should
- *  probably use PHYSFS_enumerateFiles() instead, which guarantees
- *  alphabetical sorting. This form reports whatever is discovered in each
- *  archive before moving on to the next. Even within one archive, we can't
- *  guarantee what order it will discover data. <em>Any sorting you find in
- *  these callbacks is just pure luck. Do not rely on it.</em> As this walks
- *  the entire list of archives, you may receive duplicate filenames.
+ * Items are sent to the callback sorted (case-sensitive, byte by byte), and
+ *  each name is reported only once, even if several elements of the search
+ *  path contain it. Every archive produces its own sorted listing (archives
+ *  with a prebuilt directory tree already keep one from mount time), and
+ *  these listings are merged without any global sort. PHYSFS_enumerateFiles()
+ *  is built on top of this, and just collects the names in order.
+ *
+ * This function is built on PHYSFS_openDir(): the whole merged listing is
+ *  snapshotted before the callback is called even once, so results aren't
+ *  streamed as the archives are read, and the snapshot holds every name in
+ *  the directory at once. The callback only runs after PhysicsFS has let go
+ *  of its internal lock. It is free to open files, mount archives or just
+ *  take its time, without stalling other threads. Entries mounted or
+ *  unmounted while the callback runs won't show up in (or vanish from) the
+ *  enumeration already underway.
  *
  * This API and the callbacks themselves are capable of reporting errors.
  *  Prior to this API, callbacks had to accept every enumerated item, even if
@@ -2474,6 +2818,78 @@ PHYSFS_DECL int PHYSFS_enumerate(const char* dir, PHYSFS_EnumerateCallback c,
    void* d);
 
 
+/**
+ * \struct PHYSFS_Dir
+ * \brief A directory listing, as returned by PHYSFS_openDir().
+ *
+ * This is an opaque snapshot of a search path directory. It's read with
+ *  PHYSFS_readDir() and released with PHYSFS_closeDir().
+ *
+ * \sa PHYSFS_openDir
+ */
+struct PHYSFS_Dir;
+
+/**
+ * \fn PHYSFS_Dir *PHYSFS_openDir(const char *dirName)
+ * \brief Take a snapshot of a search path directory, to be read at leisure.
+ *
+ * This builds the same listing PHYSFS_enumerate() would report: sorted,
+ *  with every name appearing once, and with symlinks hidden unless
+ *  PHYSFS_permitSymbolicLinks() allows them. PhysicsFS's internal lock is
+ *  only held while the directory is looked up in each search path element.
+ *  Those elements can't be unmounted until this returns, and their listings
+ *  are read and merged with the lock released, so mounts, opens and stats
+ *  on other threads don't wait for a big directory to be listed.
+ *
+ * After that, the snapshot doesn't depend on the search path at all. Reading
+ *  it takes no lock, and archives can be mounted or unmounted while it's
+ *  open. Changes made after this call aren't reflected in the snapshot.
+ *
+ * A PHYSFS_Dir may be moved between threads, but two threads must not read
+ *  from the same one at the same time.
+ *
+ *    \param dirName Directory, in platform-independent notation, to list.
+ *   \return A new snapshot, or nullptr on error. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error. A
+ *           directory that doesn't exist gives an empty snapshot.
+ *
+ * \sa PHYSFS_readDir
+ * \sa PHYSFS_closeDir
+ * \sa PHYSFS_enumerate
+ */
+PHYSFS_DECL PHYSFS_Dir* PHYSFS_openDir(const char* dirName);
+
+/**
+ * \fn PHYSFS_sint64 PHYSFS_readDir(PHYSFS_Dir *dir, const char **names, PHYSFS_uint64 maxNames)
+ * \brief Read the next batch of names from a directory snapshot.
+ *
+ * Names are handed out in order, up to (maxNames) at a time. The strings
+ *  belong to (dir), and stay valid until it is passed to PHYSFS_closeDir().
+ *
+ *    \param dir Snapshot returned by PHYSFS_openDir().
+ *    \param names Array of at least (maxNames) pointers to fill in.
+ *    \param maxNames Most names to read in this call.
+ *   \return Number of names read, which is zero once the listing is
+ *           exhausted, or -1 on error.
+ *
+ * \sa PHYSFS_openDir
+ */
+PHYSFS_DECL PHYSFS_sint64 PHYSFS_readDir(PHYSFS_Dir* dir, const char** names,
+   PHYSFS_uint64 maxNames);
+
+/**
+ * \fn void PHYSFS_closeDir(PHYSFS_Dir *dir)
+ * \brief Release a directory snapshot.
+ *
+ * Every name read from (dir) becomes invalid.
+ *
+ *    \param dir Snapshot returned by PHYSFS_openDir(). Can be nullptr.
+ *
+ * \sa PHYSFS_openDir
+ */
+PHYSFS_DECL void PHYSFS_closeDir(PHYSFS_Dir* dir);
+
+
 /**
  * \fn int PHYSFS_unmount(const char *oldDir)
  * \brief Remove a directory or archive from the search path.
@@ -2566,6 +2982,108 @@ typedef struct PHYSFS_Stat
  */
 PHYSFS_DECL int PHYSFS_stat(const char* fname, PHYSFS_Stat* stat);
 
+/**
+ * \enum PHYSFS_Compression
+ * \brief How a file's bytes are stored inside its archive.
+ *
+ * \sa PHYSFS_StatEx
+ */
+typedef enum PHYSFS_Compression
+{
+   PHYSFS_COMPRESSION_NONE,    /**< stored as-is */
+   PHYSFS_COMPRESSION_DEFLATE, /**< zlib deflate */
+   PHYSFS_COMPRESSION_LZ4,     /**< LZ4 block */
+   PHYSFS_COMPRESSION_SOLID,   /**< decoded along with the rest of (block) */
+   PHYSFS_COMPRESSION_OTHER,   /**< something else; see (method) */
+   PHYSFS_COMPRESSION_UNKNOWN  /**< the archiver doesn't say */
+} PHYSFS_Compression;
+
+/**
+ * \struct PHYSFS_StatEx
+ * \brief Meta data for a file, plus where and how it's stored.
+ *
+ * Everything PHYSFS_Stat has, plus the physical layout of the file inside
+ *  the archive that provides it, so that an application can plan its
+ *  reads: sort them by (archive) and (offset), skip decompression for what
+ *  can be mapped, and so on.
+ *
+ * Fields that an archiver can't fill in are left at their defaults: -1 for
+ *  numbers, PHYSFS_COMPRESSION_UNKNOWN, and zero for the flags. Directories,
+ *  the root and the directories implied by mount points only ever get
+ *  (stat) and (archive).
+ *
+ * (offset) is measured from the start of the archive's PHYSFS_Io, and is
+ *  where the file's stored bytes start, after any local header. For a plain
+ *  directory, it is zero, and relative to the file itself.
+ *
+ * \sa PHYSFS_statEx
+ * \sa PHYSFS_statMany
+ */
+typedef struct PHYSFS_StatEx
+{
+   PHYSFS_Stat stat; /**< same as PHYSFS_stat() gives */
+   const char* archive; /**< like PHYSFS_getRealDir(), "" for the root */
+   PHYSFS_sint64 offset; /**< where the stored bytes start, -1 if unknown */
+   PHYSFS_sint64 storedSize; /**< bytes in the archive, -1 if unknown */
+   PHYSFS_Compression compression; /**< how the stored bytes are encoded */
+   PHYSFS_uint32 method; /**< the format's own method number, or zero */
+   PHYSFS_sint64 block; /**< solid block it's decoded with, or -1 */
+   int contiguous; /**< non-zero if the stored bytes are in one piece */
+   int mappable; /**< non-zero if the stored bytes ARE the file's data */
+   int encrypted; /**< non-zero if the stored bytes are encrypted */
+} PHYSFS_StatEx;
+
+/**
+ * \fn int PHYSFS_statEx(const char *fname, PHYSFS_StatEx *stat)
+ * \brief Get meta data and the physical layout of a file.
+ *
+ * Like PHYSFS_stat(), but also asks the archive that provides (fname)
+ *  where and how it stores the file. Archivers that don't know (those
+ *  registered with an older PHYSFS_Archiver::version, for example) still
+ *  give the basic data, with the layout fields left unknown.
+ *
+ * (stat->archive) points into PhysicsFS's own data, and stays valid until
+ *  that archive is unmounted.
+ *
+ *    \param fname filename to check, in platform-indepedent notation.
+ *    \param stat pointer to structure to fill in.
+ *   \return non-zero on success, zero on failure. On failure, (stat)'s
+ *           contents are undefined.
+ *
+ * \sa PHYSFS_StatEx
+ * \sa PHYSFS_statMany
+ */
+PHYSFS_DECL int PHYSFS_statEx(const char* fname, PHYSFS_StatEx* stat);
+
+/**
+ * \fn PHYSFS_uint32 PHYSFS_statMany(const char *const *fnames, PHYSFS_uint32 count, PHYSFS_StatEx *stats)
+ * \brief Get meta data and the physical layout of many files at once.
+ *
+ * Does PHYSFS_statEx() for each of (fnames), filling the matching element
+ *  of (stats), but takes PhysicsFS's state lock once for the whole list
+ *  instead of once per file, and doesn't stop at the first file that's
+ *  missing. That makes it the cheap way to build a load plan for thousands
+ *  of assets at startup.
+ *
+ * A file that doesn't exist gets (archive) set to nullptr; its other
+ *  fields are undefined. Any other failure, such as an archive that can't
+ *  be read or running out of memory, ends the call the way it would end
+ *  PHYSFS_statEx(), and leaves (stats) undefined.
+ *
+ *    \param fnames array of (count) filenames, in platform-independent
+ *                  notation.
+ *    \param count number of elements in (fnames) and (stats).
+ *    \param stats array of (count) structures to fill in.
+ *   \return number of files found. Zero is also returned on failure, with
+ *           the error code set; if some files are simply missing, the
+ *           error code isn't touched.
+ *
+ * \sa PHYSFS_statEx
+ */
+PHYSFS_DECL PHYSFS_uint32 PHYSFS_statMany(const char* const* fnames,
+                                          PHYSFS_uint32 count,
+                                          PHYSFS_StatEx* stats);
+
 
 /**
  * \fn void PHYSFS_utf8FromUtf16(const PHYSFS_uint16 *src, char *dst, PHYSFS_uint64 len)
@@ -2654,6 +3172,37 @@ PHYSFS_DECL void PHYSFS_utf8ToUtf16(const char* src, PHYSFS_uint16* dst,
 PHYSFS_DECL PHYSFS_sint64 PHYSFS_readBytes(PHYSFS_File* handle, void* buffer,
    PHYSFS_uint64 len);
 
+/**
+ * \fn PHYSFS_sint64 PHYSFS_readAt(PHYSFS_File *handle, PHYSFS_uint64 offset, void *buffer, PHYSFS_uint64 len)
+ * \brief Read bytes from a given offset of a PhysicsFS filehandle
+ *
+ * The file must be opened for reading. Unlike PHYSFS_readBytes(), this
+ *  doesn't use or move the handle's file position, and doesn't go through
+ *  its buffer. Any number of threads may call it on the same handle at once,
+ *  so a job system can read different chunks of one large file in parallel
+ *  without opening it once per worker.
+ *
+ * Native files (where the platform supports positional reads), memory
+ *  buffers, and uncompressed archive entries are read without taking any
+ *  lock. Compressed entries have to be decoded in order, so their reads are
+ *  serialized per handle, over a private duplicate of the stream; reading
+ *  chunks in ascending order keeps that decoding from rewinding.
+ *
+ * Don't call this while another thread is using the same handle with
+ *  PHYSFS_readBytes(), PHYSFS_seek() or PHYSFS_close().
+ *
+ *   \param handle handle returned from PHYSFS_openRead().
+ *   \param offset byte offset in the file to start reading at.
+ *   \param buffer buffer of at least (len) bytes to store read data into.
+ *   \param len number of bytes being read from (handle).
+ *  \return number of bytes read. This may be less than (len), when the read
+ *          reaches the end of the file. -1 if complete failure.
+ *
+ * \sa PHYSFS_readBytes
+ */
+PHYSFS_DECL PHYSFS_sint64 PHYSFS_readAt(PHYSFS_File* handle,
+   PHYSFS_uint64 offset, void* buffer, PHYSFS_uint64 len);
+
 /**
  * \fn PHYSFS_sint64 PHYSFS_writeBytes(PHYSFS_File *handle, const void *buffer, PHYSFS_uint64 len)
  * \brief Write data to a PhysicsFS filehandle
@@ -2684,13 +3233,93 @@ PHYSFS_DECL PHYSFS_sint64 PHYSFS_writeBytes(PHYSFS_File* handle,
 
 namespace Inner
 {
-   int readAll(PHYSFS_File* file, void* val, const PHYSFS_sint64 len) {
+   inline int readAll(PHYSFS_File* file, void* val, const PHYSFS_sint64 len) {
       return PHYSFS_readBytes(file, val, len) == len;
    }
 
-   int writeAll(PHYSFS_File* f, const void* val, const PHYSFS_sint64 len) {
+   inline int writeAll(PHYSFS_File* f, const void* val, const PHYSFS_sint64 len) {
       return PHYSFS_writeBytes(f, val, len) == len;
    }
+
+   /// Reverse the bytes of (count) SIZE-byte lanes from (src) into (dst)     
+   /// Both may be the same buffer, but must not otherwise overlap            
+   template<size_t SIZE>
+   void swapLanes(void* dst, const void* src, size_t count) noexcept {
+      static_assert(SIZE == 2 or SIZE == 4 or SIZE == 8);
+      using Lane = ::std::conditional_t<SIZE == 2, PHYSFS_uint16,
+                   ::std::conditional_t<SIZE == 4, PHYSFS_uint32, PHYSFS_uint64>>;
+      auto to = static_cast<unsigned char*>(dst);
+      auto from = static_cast<const unsigned char*>(src);
+      const auto end = from + count * SIZE;
+
+   #if defined(__SSSE3__) or defined(__AVX__)
+      // One pshufb reverses every lane in 16 bytes                     
+      const auto mask = [] {
+         alignas(16) char order[16];
+         for (int i = 0; i < 16; ++i)
+            order[i] = static_cast<char>(i - i % SIZE + SIZE - 1 - i % SIZE);
+         return _mm_load_si128(reinterpret_cast<const __m128i*>(order));
+      }();
+      for (; end - from >= 32; from += 32, to += 32) {
+         const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from));
+         const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from + 16));
+         _mm_storeu_si128(reinterpret_cast<__m128i*>(to), _mm_shuffle_epi8(a, mask));
+         _mm_storeu_si128(reinterpret_cast<__m128i*>(to + 16), _mm_shuffle_epi8(b, mask));
+      }
+      for (; end - from >= 16; from += 16, to += 16) {
+         const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from));
+         _mm_storeu_si128(reinterpret_cast<__m128i*>(to), _mm_shuffle_epi8(a, mask));
+      }
+   #elif defined(__ARM_NEON)
+      for (; end - from >= 16; from += 16, to += 16) {
+         const auto a = vld1q_u8(from);
+         if constexpr (SIZE == 2)
+            vst1q_u8(to, vrev16q_u8(a));
+         else if constexpr (SIZE == 4)
+            vst1q_u8(to, vrev32q_u8(a));
+         else
+            vst1q_u8(to, vrev64q_u8(a));
+      }
+   #endif
+
+      // Whatever didn't fill a vector                                  
+      for (; from != end; from += SIZE, to += SIZE) {
+         Lane x;
+         ::std::memcpy(&x, from, SIZE);
+         x = ::std::byteswap(x);
+         ::std::memcpy(to, &x, SIZE);
+      }
+   }
+
+   /// The lane an array of T is swapped in: T itself for scalars, or an      
+   /// explicit LANE for structs made only of LANE-sized scalars              
+   template<class T, class LANE>
+   struct ArrayLane {
+      static_assert(PHYSFS_scalar<LANE>, "LANE must be an integer or floating point type");
+      static_assert(::std::is_trivially_copyable_v<T> and sizeof(T) % sizeof(LANE) == 0,
+         "T must be a trivially copyable struct made of LANE-sized scalars");
+      using Type = LANE;
+   };
+
+   template<class T>
+   struct ArrayLane<T, void> {
+      static_assert(PHYSFS_scalar<T>,
+         "Arrays of structs need an explicit lane, like PHYSFS_readArray<E, float>");
+      using Type = T;
+   };
+
+   /// Swap (count) elements of T to or from ENDIANNESS                       
+   template<::std::endian ENDIANNESS, class T, class LANE>
+   void swapArray(void* dst, const void* src, size_t count) noexcept {
+      constexpr size_t size = sizeof(typename ArrayLane<T, LANE>::Type);
+      if constexpr (ENDIANNESS != ::std::endian::native and size > 1)
+         swapLanes<size>(dst, src, count * (sizeof(T) / size));
+      else if (dst != src)
+         ::std::memcpy(dst, src, count * sizeof(T));
+   }
+
+   template<class R>
+   using ArrayElement = ::std::remove_reference_t<::std::ranges::range_reference_t<R>>;
 }
 
 
@@ -2710,8 +3339,10 @@ namespace Inner
 template<::std::endian ENDIANNESS, PHYSFS_integer T>
 int PHYSFS_read(PHYSFS_File *file, T* val) {
    T in;
-   BAIL_IF(val == nullptr, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-   BAIL_IF_ERRPASS(!Inner::readAll(file, &in, sizeof (in)), 0);
+   if (val == nullptr)
+      MetaPhysFS::Throw<PHYSFS_ERR_INVALID_ARGUMENT>();
+   if (not Inner::readAll(file, &in, sizeof (in)))
+      return 0;
    *val = PHYSFS_swap<ENDIANNESS>(in);
    return 1;
 }
@@ -2732,11 +3363,104 @@ int PHYSFS_read(PHYSFS_File *file, T* val) {
 template<::std::endian ENDIANNESS, PHYSFS_integer T>
 int PHYSFS_write(PHYSFS_File *file, T val) {
    const T out = PHYSFS_swap<ENDIANNESS>(val);
-   BAIL_IF_ERRPASS(!Inner::writeAll(file, &out, sizeof (out)), 0);
+   if (not Inner::writeAll(file, &out, sizeof (out)))
+      return 0;
    return 1;
 }
 
 
+/**
+ * \fn PHYSFS_sint64 PHYSFS_readArray(PHYSFS_File *file, R &&data)
+ * \brief Read an array of values and convert them to native byte order.
+ *
+ * The bulk version of PHYSFS_read(): the whole array is read with one
+ *  PHYSFS_readBytes() call, then byteswapped in place (with SSSE3 or NEON
+ *  where the compiler allows it). When ENDIANNESS is the native byte order,
+ *  this is just the read.
+ *
+ * Elements are integers or floating point values. Arrays of structs are
+ *  read by naming the lane they are swapped in, as long as every member is
+ *  a scalar of that size:
+ *
+ * \code
+ * struct Vertex { float x, y, z; PHYSFS_uint32 color; };
+ * std::vector<Vertex> vertices(count);
+ * PHYSFS_readArray<std::endian::little, PHYSFS_uint32>(file, vertices);
+ * \endcode
+ *
+ *    \param file PhysicsFS file handle from which to read.
+ *    \param data any contiguous range of elements to fill.
+ *   \return number of whole elements read, which is less than the size of
+ *           (data) at the end of the file, or -1 on complete failure. See
+ *           PHYSFS_getLastErrorCode() for why.
+ *
+ * \sa PHYSFS_writeArray
+ */
+template<::std::endian ENDIANNESS, class LANE = void>
+PHYSFS_sint64 PHYSFS_readArray(PHYSFS_File* file, ::std::ranges::contiguous_range auto&& data) {
+   using T = Inner::ArrayElement<decltype(data)>;
+   static_assert(not ::std::is_const_v<T>, "Can't read into a const range");
+
+   const auto buffer = ::std::ranges::data(data);
+   const auto len = PHYSFS_readBytes(file, buffer, ::std::ranges::size(data) * sizeof(T));
+   if (len < 0)
+      return -1;
+
+   const auto count = static_cast<size_t>(len) / sizeof(T);
+   Inner::swapArray<ENDIANNESS, T, LANE>(buffer, buffer, count);
+   return static_cast<PHYSFS_sint64>(count);
+}
+
+
+/**
+ * \fn PHYSFS_sint64 PHYSFS_writeArray(PHYSFS_File *file, R &&data)
+ * \brief Convert an array of values to a byte order and write them.
+ *
+ * The bulk version of PHYSFS_write(). (data) is left untouched: unless
+ *  ENDIANNESS is the native byte order (in which case this is a single
+ *  PHYSFS_writeBytes() call), it is swapped through a small stack buffer
+ *  and written a few kilobytes at a time. Element types and struct lanes
+ *  work as in PHYSFS_readArray().
+ *
+ *    \param file PhysicsFS file handle to which to write.
+ *    \param data any contiguous range of elements to write.
+ *   \return number of whole elements written, or -1 on complete failure.
+ *           See PHYSFS_getLastErrorCode() for why it is short.
+ *
+ * \sa PHYSFS_readArray
+ */
+template<::std::endian ENDIANNESS, class LANE = void>
+PHYSFS_sint64 PHYSFS_writeArray(PHYSFS_File* file, ::std::ranges::contiguous_range auto&& data) {
+   using T = ::std::remove_const_t<Inner::ArrayElement<decltype(data)>>;
+   using Lane = typename Inner::ArrayLane<T, LANE>::Type;
+
+   const auto bytes = reinterpret_cast<const unsigned char*>(::std::ranges::data(data));
+   const PHYSFS_uint64 len = ::std::ranges::size(data) * sizeof(T);
+   if constexpr (ENDIANNESS == ::std::endian::native or sizeof(Lane) == 1) {
+      const auto written = PHYSFS_writeBytes(file, bytes, len);
+      return written < 0 ? -1 : written / static_cast<PHYSFS_sint64>(sizeof(T));
+   }
+   else {
+      // Whole elements only, so a short write counts cleanly           
+      constexpr size_t chunk = (4096 / sizeof(T) ? 4096 / sizeof(T) : 1) * sizeof(T);
+      alignas(16) unsigned char bounce[chunk];
+      PHYSFS_uint64 done = 0;
+      while (done < len) {
+         const auto size = static_cast<size_t>(len - done < chunk ? len - done : chunk);
+         Inner::swapArray<ENDIANNESS, T, LANE>(bounce, bytes + done, size / sizeof(T));
+         const auto written = PHYSFS_writeBytes(file, bounce, size);
+         if (written < 0)
+            return done ? static_cast<PHYSFS_sint64>(done / sizeof(T)) : -1;
+
+         done += static_cast<PHYSFS_uint64>(written);
+         if (static_cast<size_t>(written) < size)
+            break;
+      }
+      return static_cast<PHYSFS_sint64>(done / sizeof(T));
+   }
+}
+
+
 /**
  * \struct PHYSFS_Io
  * \brief An abstract i/o interface.
@@ -2783,9 +3507,10 @@ typedef struct PHYSFS_Io
    /**
     * \brief Binary compatibility information.
     *
-    * This must be set to zero at this time. Future versions of this
-    *  struct will increment this field, so we know what a given
-    *  implementation supports. We'll presumably keep supporting older
+    * Set this to zero or one. Version 1 added readAt(); an implementation
+    *  that sets zero must not be expected to have that field at all. Future
+    *  versions of this struct will increment this field, so we know what a
+    *  given implementation supports. We'll presumably keep supporting older
     *  versions as we offer new features, though.
     */
    PHYSFS_uint32 version;
@@ -2935,6 +3660,29 @@ typedef struct PHYSFS_Io
     *   \param s The i/o instance to destroy.
     */
    void (*destroy)(struct PHYSFS_Io* io);
+
+   /**
+    * \brief Read data at a given offset, without moving the i/o position.
+    *
+    * Read up to (len) bytes starting at byte (offset), and store them in
+    *  (buf). This must not disturb the position used by read() and seek(),
+    *  and it must be safe to call from several threads at once on the same
+    *  instance, although not at the same time as any other method.
+    *
+    * Only present when (version) is at least 1. You don't have to implement
+    *  this; set it to nullptr if the data can't be read positionally without
+    *  locking (a compressed stream, say). PHYSFS_readAt() then serializes
+    *  the reads over a duplicate() of this instance instead.
+    *
+    *   \param io The i/o instance to read from.
+    *   \param offset Byte offset to start reading at.
+    *   \param buf The buffer to store data into, at least (len) bytes long.
+    *   \param len The number of bytes to read.
+    *  \return number of bytes read, 0 if (offset) is at or past the end, -1
+    *          on complete failure.
+    */
+   PHYSFS_sint64(*readAt)(struct PHYSFS_Io* io, PHYSFS_uint64 offset,
+      void* buf, PHYSFS_uint64 len);
 } PHYSFS_Io;
 
 
@@ -3086,6 +3834,390 @@ PHYSFS_DECL int PHYSFS_mountMemory(const void* buf, PHYSFS_uint64 len,
 PHYSFS_DECL int PHYSFS_mountHandle(PHYSFS_File* file, const char* newDir,
    const char* mountPoint, int appendToPath);
 
+/**
+ * \struct PHYSFS_SimulatedMedia
+ * \brief How slow the media behind PHYSFS_createSimulatedIo() should be.
+ *
+ * Zeroed fields cost nothing, so an all-zero struct simulates nothing.
+ *  A spinning disk is roughly 100 microseconds of latency, 8000 per seek,
+ *  150 megabytes per second and a queue depth of 1, for example.
+ *
+ * \sa PHYSFS_createSimulatedIo
+ */
+typedef struct PHYSFS_SimulatedMedia
+{
+   PHYSFS_uint32 latencyUs;       /**< Charged on every request. */
+   PHYSFS_uint32 jitterUs;        /**< Up to this much more, drawn from (seed). */
+   PHYSFS_uint32 seekUs;          /**< Charged when a request doesn't start where the last one ended. */
+   PHYSFS_uint32 queueDepth;      /**< Requests served at once, 0 for no limit. */
+   PHYSFS_uint64 bytesPerSecond;  /**< Transfer rate shared by all requests, 0 for no limit. */
+   PHYSFS_uint64 seed;            /**< Seed for the jitter. */
+} PHYSFS_SimulatedMedia;
+
+/**
+ * \struct PHYSFS_SimulatedStats
+ * \brief What a simulated device has served so far.
+ *
+ * \sa PHYSFS_getSimulatedStats
+ */
+typedef struct PHYSFS_SimulatedStats
+{
+   PHYSFS_uint64 requests;  /**< Reads and writes that moved data. */
+   PHYSFS_uint64 seeks;     /**< Requests that paid the seek penalty. */
+   PHYSFS_uint64 bytes;     /**< Bytes moved. */
+   PHYSFS_uint64 busyUs;    /**< Sum of every request's simulated cost. */
+} PHYSFS_SimulatedStats;
+
+/**
+ * \fn PHYSFS_Io *PHYSFS_createSimulatedIo(PHYSFS_Io *io, const PHYSFS_SimulatedMedia *media)
+ * \brief Make a PHYSFS_Io behave like slower media, for benchmarking.
+ *
+ * Local SSDs hide most of the costs that hard drives, optical drives and
+ *  network shares have. The returned i/o passes everything through to
+ *  (io), but holds back every read and write until (media) would have
+ *  delivered it. Mount it with PHYSFS_mountIo(), and the archive behaves
+ *  as if it was on that media.
+ *
+ * The wrapper and all of its duplicates - archivers make one for every
+ *  file they open - share a single simulated device, with one head, one
+ *  link and one request queue. Interleaving reads from several files costs
+ *  seeks, just like it would on a disk, and concurrent PHYSFS_readAt()
+ *  calls are served (media->queueDepth) at a time. The jitter sequence only
+ *  depends on (media->seed), and PHYSFS_getSimulatedStats()'s busy time
+ *  only on the requests made, so runs can be compared across machines.
+ *
+ * Seeking itself is free: the penalty is charged to the next request that
+ *  starts somewhere the previous one didn't end.
+ *
+ * On success, the returned i/o owns (io), and destroys it along with
+ *  itself. On failure, (io) is left alone.
+ *
+ *   \param io The i/o to wrap.
+ *   \param media How slow to be, or nullptr for no delays at all.
+ *  \return a new i/o, or nullptr on error. Use PHYSFS_getLastErrorCode() to
+ *          obtain the specific error.
+ *
+ * \sa PHYSFS_mountIo
+ * \sa PHYSFS_getSimulatedStats
+ */
+PHYSFS_DECL PHYSFS_Io* PHYSFS_createSimulatedIo(PHYSFS_Io* io,
+   const PHYSFS_SimulatedMedia* media);
+
+/**
+ * \fn int PHYSFS_getSimulatedStats(PHYSFS_Io *io, PHYSFS_SimulatedStats *stats)
+ * \brief Get what a simulated device has served so far.
+ *
+ * (io) is something PHYSFS_createSimulatedIo() returned, or a duplicate of
+ *  it. The numbers cover all of them together. They only ever grow, so
+ *  take them before and after whatever is being measured.
+ *
+ *   \param io A simulated i/o.
+ *   \param stats Filled in on success.
+ *  \return nonzero on success, zero if (io) isn't a simulated i/o.
+ *
+ * \sa PHYSFS_createSimulatedIo
+ */
+PHYSFS_DECL int PHYSFS_getSimulatedStats(PHYSFS_Io* io,
+   PHYSFS_SimulatedStats* stats);
+
+/**
+ * \struct PHYSFS_IoCacheStats
+ * \brief What the block cache behind PHYSFS_createCachedIo() has done.
+ *
+ * \sa PHYSFS_getIoCacheStats
+ */
+typedef struct PHYSFS_IoCacheStats
+{
+   PHYSFS_uint64 hits;             /**< Blocks served from the cache. */
+   PHYSFS_uint64 misses;           /**< Reads that went to a wrapped i/o. */
+   PHYSFS_uint64 readAheadBlocks;  /**< Blocks fetched ahead of a sequential reader. */
+   PHYSFS_uint64 evictions;        /**< Blocks dropped to stay within the size. */
+   PHYSFS_uint64 cachedBytes;      /**< Bytes held right now. */
+   PHYSFS_uint64 cachedBlocks;     /**< Blocks held right now. */
+} PHYSFS_IoCacheStats;
+
+/**
+ * \fn PHYSFS_Io *PHYSFS_createCachedIo(PHYSFS_Io *io, PHYSFS_uint32 blockSize, PHYSFS_uint32 readAhead)
+ * \brief Put a block cache in front of a PHYSFS_Io.
+ *
+ * Archivers duplicate the i/o they're mounted on for every file they open,
+ *  and the duplicates don't share anything: two files reading the same
+ *  bytes fetch them twice. When (io) is slow to fetch from - streamed off
+ *  a server, say - wrap it with this before handing it to
+ *  PHYSFS_mountIo().
+ *
+ * The returned i/o reads (io) in aligned blocks of (blockSize) bytes, and
+ *  keeps them in a least-recently-used cache shared by every cached i/o in
+ *  the process, and bounded by PHYSFS_setIoCacheSize(). Blocks belong to
+ *  the wrapper and all of its duplicates together, so any file opened
+ *  from the archive is served the blocks any other one fetched. When a
+ *  read carries on where the previous one on the same handle ended, and
+ *  misses, the next (readAhead) blocks are fetched along with it, in the
+ *  same request. One request is kept within 64 megabytes, or one block if
+ *  that's bigger, so (readAhead) is lowered to fit if needed.
+ *
+ * (io) is assumed not to change underneath the cache, and the returned
+ *  i/o is read-only. Destroy it before PHYSFS_deinit(); unmounting the
+ *  archive it's mounted as does that. One that's left over can still be
+ *  destroyed afterwards, but reading from it fails with
+ *  PHYSFS_ERR_NOT_INITIALIZED until PhysicsFS is initialized again.
+ *
+ * On success, the returned i/o owns (io), and destroys it along with
+ *  itself. On failure, (io) is left alone.
+ *
+ *   \param io The i/o to wrap.
+ *   \param blockSize Block size, a power of two, or 0 for 64 kilobytes.
+ *   \param readAhead Blocks to fetch ahead of sequential reads, 0 for none.
+ *  \return a new i/o, or nullptr on error. Use PHYSFS_getLastErrorCode() to
+ *          obtain the specific error.
+ *
+ * \sa PHYSFS_setIoCacheSize
+ * \sa PHYSFS_getIoCacheStats
+ * \sa PHYSFS_mountIo
+ */
+PHYSFS_DECL PHYSFS_Io* PHYSFS_createCachedIo(PHYSFS_Io* io,
+   PHYSFS_uint32 blockSize, PHYSFS_uint32 readAhead);
+
+/**
+ * \fn int PHYSFS_setIoCacheSize(PHYSFS_uint64 bytes)
+ * \brief Bound the memory PHYSFS_createCachedIo()'s blocks may take.
+ *
+ * The least recently used blocks are dropped right away, if the cache is
+ *  over the new size. It's 16 megabytes after PHYSFS_init(). Zero keeps
+ *  nothing, and every read goes to the wrapped i/o.
+ *
+ *   \param bytes Most bytes of blocks to hold, across all cached i/o.
+ *  \return nonzero on success, zero if PhysicsFS isn't initialized.
+ *
+ * \sa PHYSFS_createCachedIo
+ */
+PHYSFS_DECL int PHYSFS_setIoCacheSize(PHYSFS_uint64 bytes);
+
+/**
+ * \fn int PHYSFS_getIoCacheStats(PHYSFS_IoCacheStats *stats)
+ * \brief Get what the block cache has done since PHYSFS_init().
+ *
+ *   \param stats Filled in on success.
+ *  \return nonzero on success, zero on failure.
+ *
+ * \sa PHYSFS_createCachedIo
+ */
+PHYSFS_DECL int PHYSFS_getIoCacheStats(PHYSFS_IoCacheStats* stats);
+
+/**
+ * \enum PHYSFS_IoPriority
+ * \brief How urgently a thread's i/o is needed.
+ *
+ * \sa PHYSFS_setIoPriority
+ * \sa PHYSFS_createScheduledIo
+ */
+typedef enum PHYSFS_IoPriority
+{
+   PHYSFS_IO_CRITICAL,       /**< Something is waiting on it. The default. */
+   PHYSFS_IO_STREAMING,      /**< Needed soon, like the next stretch of a song. */
+   PHYSFS_IO_BACKGROUND,     /**< Prefetching, and other speculative work. */
+   PHYSFS_IO_PRIORITY_COUNT  /**< Not a priority, the number of them. */
+} PHYSFS_IoPriority;
+
+/**
+ * \fn int PHYSFS_setIoPriority(PHYSFS_IoPriority priority, PHYSFS_uint32 deadlineUs)
+ * \brief Choose how urgent the calling thread's i/o is.
+ *
+ * Every read and write the calling thread makes from now on, through any
+ *  PhysicsFS call, carries (priority) and (deadlineUs). Only scheduled i/o
+ *  (see PHYSFS_createScheduledIo() and PHYSFS_setIoSchedule()) looks at
+ *  them, to decide which request goes first; elsewhere they cost nothing.
+ *  Threads start out critical, without a deadline.
+ *
+ * Read-ahead helper threads (see PHYSFS_setReadAhead) take the priority of
+ *  the thread reading the file, but never above streaming, since they
+ *  only fetch what might be needed. Opening a file or mounting an archive
+ *  holds a lock every other open waits on, so the reads they do are
+ *  served as streaming at worst, and never throttled.
+ *
+ *   \param priority Priority class of this thread's requests.
+ *   \param deadlineUs Microseconds each request should take at most,
+ *                     counted from when it's made, or 0 for no deadline.
+ *  \return nonzero on success, zero if (priority) isn't valid.
+ *
+ * \sa PHYSFS_getIoPriority
+ * \sa PHYSFS_createScheduledIo
+ */
+PHYSFS_DECL int PHYSFS_setIoPriority(PHYSFS_IoPriority priority,
+   PHYSFS_uint32 deadlineUs);
+
+/**
+ * \fn PHYSFS_IoPriority PHYSFS_getIoPriority(PHYSFS_uint32 *deadlineUs)
+ * \brief Get the calling thread's i/o priority, to restore it later.
+ *
+ *   \param deadlineUs If not nullptr, gets the thread's deadline.
+ *  \return the thread's priority class.
+ *
+ * \sa PHYSFS_setIoPriority
+ */
+PHYSFS_DECL PHYSFS_IoPriority PHYSFS_getIoPriority(PHYSFS_uint32* deadlineUs);
+
+/**
+ * \struct PHYSFS_IoSchedule
+ * \brief How PHYSFS_createScheduledIo() shares its i/o between classes.
+ *
+ * Zeroed fields pick the defaults, and an all-zero struct serves one
+ *  request at a time, without throttling anything.
+ *
+ * \sa PHYSFS_createScheduledIo
+ */
+typedef struct PHYSFS_IoSchedule
+{
+   PHYSFS_uint32 queueDepth;          /**< Requests served at once, 0 for 1. */
+   PHYSFS_uint32 chunkSize;           /**< Streaming and background requests are served in pieces this big, 0 for 256 kilobytes. */
+   PHYSFS_uint64 backgroundBytesPerSecond; /**< Background transfer budget, 0 for no limit. */
+   PHYSFS_uint32 backgroundOpsPerSecond;   /**< Background requests per second, 0 for no limit. */
+} PHYSFS_IoSchedule;
+
+/**
+ * \struct PHYSFS_IoClassStats
+ * \brief What a scheduled i/o did for one priority class.
+ *
+ * \sa PHYSFS_IoSchedulerStats
+ */
+typedef struct PHYSFS_IoClassStats
+{
+   PHYSFS_uint64 requests;        /**< Reads and writes served. */
+   PHYSFS_uint64 bytes;           /**< Bytes moved. */
+   PHYSFS_uint64 waitUs;          /**< Time spent queued, all pieces together. */
+   PHYSFS_uint64 maxWaitUs;       /**< Longest a single piece was queued. */
+   PHYSFS_uint64 deadlineMisses;  /**< Requests that finished past their deadline. */
+   PHYSFS_uint32 queued;          /**< Pieces waiting right now. */
+   PHYSFS_uint32 maxQueued;       /**< Most pieces ever waiting at once. */
+} PHYSFS_IoClassStats;
+
+/**
+ * \struct PHYSFS_IoSchedulerStats
+ * \brief What a scheduled i/o has done so far.
+ *
+ * \sa PHYSFS_getIoSchedulerStats
+ */
+typedef struct PHYSFS_IoSchedulerStats
+{
+   PHYSFS_IoClassStats classes[PHYSFS_IO_PRIORITY_COUNT]; /**< Indexed by PHYSFS_IoPriority. */
+   PHYSFS_uint64 preemptions;  /**< Times a request let another go first, between two of its pieces. */
+   PHYSFS_uint64 throttled;    /**< Times background requests waited for their budget. */
+} PHYSFS_IoSchedulerStats;
+
+/**
+ * \fn PHYSFS_Io *PHYSFS_createScheduledIo(PHYSFS_Io *io, const PHYSFS_IoSchedule *schedule)
+ * \brief Put a priority scheduler in front of a PHYSFS_Io.
+ *
+ * Archivers duplicate the i/o they're mounted on for every file they open,
+ *  and every duplicate reads whenever it's asked to, so a thread streaming
+ *  textures in the background competes with a level load on equal terms.
+ *  Wrap the archive's i/o with this before handing it to PHYSFS_mountIo(),
+ *  and the wrapper and all of its duplicates queue their requests in one
+ *  scheduler, which serves (schedule->queueDepth) of them at a time, in
+ *  this order:
+ *
+ *  - Requests that have waited half their deadline, earliest deadline
+ *    first, whatever their class.
+ *  - Critical requests, then streaming, then background ones.
+ *  - Within a class, in one sweep over the archive by offset, starting
+ *    where the last request ended, so the head doesn't jump back and forth.
+ *
+ * Streaming and background requests are served (schedule->chunkSize) bytes
+ *  at a time, and queue again between pieces, so a critical request waits
+ *  for one piece at most, not for a whole texture. Background requests are
+ *  also held to the budget in (schedule), with bursts of up to a tenth of a
+ *  second's worth. See PHYSFS_setIoPriority() for how requests get their
+ *  class and deadline.
+ *
+ * Archives and directories mounted by name are scheduled the same way
+ *  once PHYSFS_setIoSchedule() is called, so this is only needed for i/o
+ *  you mount yourself with PHYSFS_mountIo(), which is never wrapped for
+ *  you. Read-ahead helper threads (see PHYSFS_setReadAhead) read through
+ *  the archive's i/o, so they're scheduled whenever the archive is.
+ *
+ * On success, the returned i/o owns (io), and destroys it along with
+ *  itself. On failure, (io) is left alone.
+ *
+ *   \param io The i/o to wrap.
+ *   \param schedule How to share it, or nullptr for the defaults.
+ *  \return a new i/o, or nullptr on error. Use PHYSFS_getLastErrorCode() to
+ *          obtain the specific error.
+ *
+ * \sa PHYSFS_setIoPriority
+ * \sa PHYSFS_getIoSchedulerStats
+ * \sa PHYSFS_setIoSchedule
+ * \sa PHYSFS_mountIo
+ */
+PHYSFS_DECL PHYSFS_Io* PHYSFS_createScheduledIo(PHYSFS_Io* io,
+   const PHYSFS_IoSchedule* schedule);
+
+/**
+ * \fn int PHYSFS_setIoSchedule(const PHYSFS_IoSchedule *schedule)
+ * \brief Schedule the reads of everything mounted from now on.
+ *
+ * With a schedule set, every archive or directory mounted afterwards gets
+ *  a scheduler of its own, as PHYSFS_createScheduledIo() would make with
+ *  (schedule). An archive file's i/o is wrapped in it as the archive is
+ *  opened, so every entry read from it queues there; each file opened in
+ *  a directory joins its directory's scheduler. Archives nested inside
+ *  another one (see PHYSFS_mount()) read through the outermost one, and
+ *  share its scheduler. Use PHYSFS_getMountIoSchedulerStats() to see what
+ *  each one did.
+ *
+ * Mounts made before the call keep what they have, and so does the write
+ *  dir, which is never scheduled. An archive that's shared with another
+ *  context's mount isn't opened again, so it stays scheduled, or not, the
+ *  way the mount that opened it first was. I/o handed to PHYSFS_mountIo()
+ *  and friends is never wrapped; wrap it yourself if it should be.
+ *
+ * Like the symlink setting, this belongs to the calling thread's current
+ *  context (see PHYSFS_setContext()). It goes back to off when the context
+ *  is destroyed, or when PHYSFS_deinit() closes the default one.
+ *
+ *   \param schedule How to share each mount's i/o, or nullptr to stop
+ *                   scheduling mounts.
+ *  \return nonzero on success, zero if this build has no threads to
+ *          schedule between.
+ *
+ * \sa PHYSFS_createScheduledIo
+ * \sa PHYSFS_getMountIoSchedulerStats
+ */
+PHYSFS_DECL int PHYSFS_setIoSchedule(const PHYSFS_IoSchedule* schedule);
+
+/**
+ * \fn int PHYSFS_getIoSchedulerStats(PHYSFS_Io *io, PHYSFS_IoSchedulerStats *stats)
+ * \brief Get what a scheduled i/o has done so far.
+ *
+ * (io) is something PHYSFS_createScheduledIo() returned, or a duplicate of
+ *  it. The numbers cover all of them together. Apart from the queue
+ *  lengths, they only ever grow.
+ *
+ *   \param io A scheduled i/o.
+ *   \param stats Filled in on success.
+ *  \return nonzero on success, zero if (io) isn't a scheduled i/o.
+ *
+ * \sa PHYSFS_createScheduledIo
+ */
+PHYSFS_DECL int PHYSFS_getIoSchedulerStats(PHYSFS_Io* io,
+   PHYSFS_IoSchedulerStats* stats);
+
+/**
+ * \fn int PHYSFS_getMountIoSchedulerStats(const char *dir, PHYSFS_IoSchedulerStats *stats)
+ * \brief Get what a mount's scheduler has done so far.
+ *
+ * Same as PHYSFS_getIoSchedulerStats(), for the scheduler a mount in the
+ *  calling thread's current context got from PHYSFS_setIoSchedule().
+ *
+ *   \param dir The mount, named as it was given to PHYSFS_mount().
+ *   \param stats Filled in on success.
+ *  \return nonzero on success, zero if (dir) isn't mounted, or wasn't
+ *          scheduled.
+ *
+ * \sa PHYSFS_setIoSchedule
+ */
+PHYSFS_DECL int PHYSFS_getMountIoSchedulerStats(const char* dir,
+   PHYSFS_IoSchedulerStats* stats);
+
 
 
 /**
@@ -3308,9 +4440,11 @@ typedef struct PHYSFS_Archiver
    /**
     * \brief Binary compatibility information.
     *
-    * This must be set to zero at this time. Future versions of this
-    *  struct will increment this field, so we know what a given
-    *  implementation supports. We'll presumably keep supporting older
+    * Set this to zero, one or two. Version 1 added statEx(), and version 2
+    *  concurrentOpenRead; an implementation that sets an older version
+    *  must not be expected to have those fields at all. Future
+    *  versions of this struct will increment this field, so we know what a
+    *  given implementation supports. We'll presumably keep supporting older
     *  versions as we offer new features, though.
     */
    PHYSFS_uint32 version;
@@ -3466,6 +4600,37 @@ typedef struct PHYSFS_Archiver
     *  there are still files open from this archive.
     */
    void (*closeArchive)(void* opaque);
+
+   /**
+    * \brief Obtain file metadata and physical layout.
+    *
+    * Like stat(), but also fill in where and how (fn) is stored. (stat)
+    *  comes preset with the defaults described for PHYSFS_StatEx, so only
+    *  fill in what you know; PhysicsFS sets (stat->archive) itself.
+    *
+    * Returns non-zero on success, zero on failure.
+    * This filename is in platform-independent notation.
+    * On failure, call PHYSFS_setErrorCode().
+    *
+    * Added in version 1, and optional: leave it nullptr, and PhysicsFS will
+    *  call stat() and leave the layout unknown.
+    */
+   int (*statEx)(void* opaque, const char* fn, PHYSFS_StatEx* stat);
+
+   /**
+    * \brief Non-zero if openRead() can run on several threads at once.
+    *
+    * PhysicsFS normally calls into an archive from one thread at a time.
+    *  Set this if openRead() is safe to run on any number of threads at
+    *  once, alongside stat(), statEx() and enumerate() on the same
+    *  (opaque). PHYSFS_openRead() then opens the file with no lock held,
+    *  so opens into one archive scale with threads. Finding the archive
+    *  that has the file, and checking the path for symlinks, still take
+    *  the lock.
+    *
+    * Added in version 2. Zero keeps the usual serialized calls.
+    */
+   int concurrentOpenRead;
 } PHYSFS_Archiver;
 
 /**
@@ -3567,4 +4732,598 @@ PHYSFS_DECL int PHYSFS_deregisterArchiver(const char* ext);
  *   \return nonzero on success, zero on failure. Use
  *           PHYSFS_getLastErrorCode() to obtain the specific error.
  */
-PHYSFS_DECL int PHYSFS_setRoot(const char* archive, const char* subdir);
\ No newline at end of file
+PHYSFS_DECL int PHYSFS_setRoot(const char* archive, const char* subdir);
+
+
+/**
+ * \struct PHYSFS_PackOptions
+ * \brief How PHYSFS_writePack() lays a pack out.
+ *
+ * Zeroed fields get the defaults, and so does passing nullptr instead of
+ *  the whole struct.
+ *
+ * \sa PHYSFS_writePack
+ */
+typedef struct PHYSFS_PackOptions
+{
+   PHYSFS_uint32 alignment;  /**< File data alignment, a power of two. 4096 by default. */
+   PHYSFS_uint32 chunkSize;  /**< Compressed chunk size, 64 kilobytes by default. */
+   int compress;             /**< Nonzero to LZ4-compress file data. */
+   int verify;               /**< Nonzero to have readers check content hashes. */
+} PHYSFS_PackOptions;
+
+/**
+ * \fn int PHYSFS_writePack(const char *dir, const char *filename, const PHYSFS_PackOptions *opts)
+ * \brief Build a MetaPhysFS pack (.mpk) out of a search path directory.
+ *
+ * Everything under (dir), as the search path currently presents it, goes
+ *  into the pack: loose files, archive contents, or any mix of them. The
+ *  result mounts like any other archive, and is laid out for PhysicsFS's
+ *  hot paths:
+ *
+ * - The index is a single block, used as is: mounting reads it and checks
+ *   its hash, and nothing else. Paths are looked up by hash, without a
+ *   directory tree being built.
+ * - File data is aligned, so uncompressed entries can be read straight
+ *   into page-aligned buffers, or mapped, and support PHYSFS_readAt().
+ * - With (opts->compress), files are compressed in independent chunks, so
+ *   seeking anywhere in one only costs a single chunk's decompression.
+ *   Chunks that don't shrink, and files where none do, are stored as is.
+ * - Files with identical contents are stored once.
+ * - Every file carries a content hash. With (opts->verify), reading a file
+ *   from start to end checks it, and the last read fails with
+ *   PHYSFS_ERR_CORRUPT on a mismatch.
+ *
+ * Directories and regular files are packed; symlinks aren't. The directory
+ *  is listed before the pack is created, but make sure the pack isn't
+ *  written somewhere (dir) will be read from.
+ *
+ *    \param dir Directory, in platform-independent notation, to pack. ""
+ *               or "/" packs the whole search path.
+ *    \param filename Pack to create, in the write dir.
+ *    \param opts Layout options, or nullptr for the defaults.
+ *   \return nonzero on success, zero on failure. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error. A
+ *           pack that fails part way is deleted again.
+ *
+ * \sa PHYSFS_PackOptions
+ * \sa PHYSFS_mount
+ */
+PHYSFS_DECL int PHYSFS_writePack(const char* dir, const char* filename,
+   const PHYSFS_PackOptions* opts);
+
+/**
+ * \struct PHYSFS_Transaction
+ * \brief A set of files to be written to the write dir all at once.
+ *
+ * Opaque. Get one from PHYSFS_beginTransaction(), and hand it back to
+ *  PHYSFS_commitTransaction() or PHYSFS_abortTransaction().
+ *
+ * \sa PHYSFS_beginTransaction
+ */
+typedef struct PHYSFS_Transaction PHYSFS_Transaction;
+
+/**
+ * \fn PHYSFS_Transaction *PHYSFS_beginTransaction(void)
+ * \brief Start writing a set of files that reach the disk together.
+ *
+ * Closing a file opened with PHYSFS_openWrite() syncs it to disk, which
+ *  costs a device flush per file. Files opened with
+ *  PHYSFS_openWriteTransacted() instead go to temporaries next to their
+ *  targets, and aren't synced on close. PHYSFS_commitTransaction() then
+ *  syncs all of them in one batch, and renames them into place.
+ *
+ * A commit is all or nothing, even across a crash: once the batch is
+ *  synced, a record of it goes to disk, and if the renames are cut short,
+ *  the next PHYSFS_setWriteDir() to the same directory finishes them.
+ *  Before that point, the old files are left as they were.
+ *
+ * Transactions are independent, and may run on any number of threads at
+ *  once. Commits that overlap in time are folded together, into a single
+ *  sync for all of them. If two transactions write the same file, the one
+ *  committed last wins.
+ *
+ * The write dir has to be a directory (not an archive), and can't be
+ *  changed until every transaction on it is committed or aborted.
+ *
+ *   \return a new transaction, or nullptr on failure. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_openWriteTransacted
+ * \sa PHYSFS_commitTransaction
+ * \sa PHYSFS_abortTransaction
+ */
+PHYSFS_DECL PHYSFS_Transaction* PHYSFS_beginTransaction(void);
+
+/**
+ * \fn PHYSFS_File *PHYSFS_openWriteTransacted(PHYSFS_Transaction *txn, const char *filename)
+ * \brief Open a file for writing, as part of a transaction.
+ *
+ * Like PHYSFS_openWrite(), except nothing is visible at (filename) until
+ *  the transaction is committed. Opening the same file twice in one
+ *  transaction starts it over.
+ *
+ *    \param txn Transaction the file belongs to.
+ *    \param filename File to open, in platform-independent notation.
+ *   \return A valid PhysicsFS filehandle on success, nullptr on error. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_beginTransaction
+ */
+PHYSFS_DECL PHYSFS_File* PHYSFS_openWriteTransacted(PHYSFS_Transaction* txn,
+   const char* filename);
+
+/**
+ * \fn int PHYSFS_commitTransaction(PHYSFS_Transaction *txn)
+ * \brief Make a transaction's files durable, and put them in place.
+ *
+ * Every file opened in the transaction has to be closed first. Otherwise
+ *  this fails with PHYSFS_ERR_FILES_STILL_OPEN, and (txn) stays usable.
+ *  In any other case, (txn) is gone once this returns, whether it worked
+ *  or not. On failure, none of its files were replaced, unless the commit
+ *  failed in the middle of its renames: the rest of them are then left
+ *  for the next commit, or the next PHYSFS_setWriteDir() to the same
+ *  directory, to finish.
+ *
+ *    \param txn Transaction to commit.
+ *   \return nonzero on success, zero on failure. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_beginTransaction
+ */
+PHYSFS_DECL int PHYSFS_commitTransaction(PHYSFS_Transaction* txn);
+
+/**
+ * \fn int PHYSFS_abortTransaction(PHYSFS_Transaction *txn)
+ * \brief Throw a transaction's files away.
+ *
+ * Every file opened in the transaction has to be closed first. Otherwise
+ *  this fails with PHYSFS_ERR_FILES_STILL_OPEN, and (txn) stays usable.
+ *
+ *    \param txn Transaction to abort.
+ *   \return nonzero on success, zero on failure. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_beginTransaction
+ */
+PHYSFS_DECL int PHYSFS_abortTransaction(PHYSFS_Transaction* txn);
+
+
+/* Contexts... */
+
+/**
+ * \struct PHYSFS_Context
+ * \brief An independent PhysicsFS: its own search path and write dir.
+ *
+ * Opaque. A context has a search path, a write dir, the files open through
+ *  them, the symlink, read-ahead and inlining settings, and locks of its
+ *  own, so threads that work in different contexts don't wait on each
+ *  other. The registered archivers, the error codes, the base, user and
+ *  pref dirs, and the i/o cache are shared by all of them.
+ *
+ * Every call works in the calling thread's current context, which is the
+ *  default one unless PHYSFS_setContext() picked another. The default
+ *  context is the one PhysicsFS always had, so code that never heard of
+ *  contexts keeps working. A file stays with the context it was opened in,
+ *  and can be read, written and closed from any thread.
+ *
+ * \sa PHYSFS_createContext
+ * \sa PHYSFS_setContext
+ */
+typedef struct PHYSFS_Context PHYSFS_Context;
+
+/**
+ * \fn PHYSFS_Context *PHYSFS_createContext(void)
+ * \brief Make a new, empty context.
+ *
+ * It starts with nothing mounted, no write dir and symlinks disallowed. It
+ *  lives until PHYSFS_destroyContext(), or PHYSFS_deinit() at the latest.
+ *
+ *   \return the new context, or nullptr on failure. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_destroyContext
+ * \sa PHYSFS_setContext
+ */
+PHYSFS_DECL PHYSFS_Context* PHYSFS_createContext(void);
+
+/**
+ * \fn int PHYSFS_destroyContext(PHYSFS_Context *context)
+ * \brief Close everything in a context, and get rid of it.
+ *
+ * Its files are closed, and its search path and write dir unmounted, like
+ *  PHYSFS_deinit() does for the default context. Nothing can be working in
+ *  the context at the time, on any thread; threads that still have it as
+ *  their current context go back to the default one only once they call
+ *  PHYSFS_setContext() again, so make sure they did that first.
+ *
+ *    \param context Context to destroy. The default one can't be.
+ *   \return nonzero on success, zero on failure. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error. On
+ *           failure, for example with a transaction still pending, the
+ *           context may be partly closed, but stays usable.
+ *
+ * \sa PHYSFS_createContext
+ */
+PHYSFS_DECL int PHYSFS_destroyContext(PHYSFS_Context* context);
+
+/**
+ * \fn PHYSFS_Context *PHYSFS_setContext(PHYSFS_Context *context)
+ * \brief Pick the context the calling thread works in.
+ *
+ * This is per thread, and costs next to nothing, so a thread serving many
+ *  sessions can switch before every call. Asynchronous ops run in the
+ *  context they were submitted from.
+ *
+ *    \param context Context to work in, or nullptr for the default one.
+ *   \return the context that was current before, nullptr if the default.
+ *
+ * \sa PHYSFS_getContext
+ * \sa MetaPhysFS::ContextScope
+ */
+PHYSFS_DECL PHYSFS_Context* PHYSFS_setContext(PHYSFS_Context* context);
+
+/**
+ * \fn PHYSFS_Context *PHYSFS_getContext(void)
+ * \brief Find out which context the calling thread works in.
+ *
+ *   \return the current context, nullptr if it's the default one.
+ *
+ * \sa PHYSFS_setContext
+ */
+PHYSFS_DECL PHYSFS_Context* PHYSFS_getContext(void);
+
+namespace MetaPhysFS
+{
+   ///                                                                        
+   ///   Work in a context until the end of the scope                         
+   ///                                                                        
+   class ContextScope {
+      PHYSFS_Context* mPrevious;
+
+   public:
+      explicit ContextScope(PHYSFS_Context* context) noexcept
+         : mPrevious {PHYSFS_setContext(context)} {}
+
+      ContextScope(const ContextScope&) = delete;
+      ContextScope& operator = (const ContextScope&) = delete;
+
+      ~ContextScope() {
+         PHYSFS_setContext(mPrevious);
+      }
+   };
+}
+
+
+/* Asynchronous i/o... */
+#include <coroutine>
+#include <ranges>
+#include <span>
+#include <stop_token>
+
+/**
+ * \enum PHYSFS_AsyncType
+ * \brief What a PHYSFS_AsyncOp does.
+ *
+ * \sa PHYSFS_AsyncOp
+ */
+typedef enum PHYSFS_AsyncType
+{
+   PHYSFS_ASYNC_OPEN_READ, /**< PHYSFS_openRead(path) into (file) */
+   PHYSFS_ASYNC_READ,      /**< PHYSFS_readBytes(file, buffer, len) */
+   PHYSFS_ASYNC_READ_AT,   /**< PHYSFS_readAt(file, offset, buffer, len) */
+   PHYSFS_ASYNC_READ_ALL   /**< all of (path), into a new (buffer) */
+} PHYSFS_AsyncType;
+
+/**
+ * \struct PHYSFS_AsyncOp
+ * \brief One asynchronous file operation.
+ *
+ * The caller owns this, fills in the request part, and hands it to
+ *  PHYSFS_submitAsync(). PhysicsFS queues the op itself, not a copy of it, so
+ *  nothing is allocated to submit it, and it has to stay put until
+ *  (complete) is called. The C++ awaitables in MetaPhysFS keep it inside the
+ *  awaiter, which lives in the coroutine's frame.
+ *
+ * For PHYSFS_ASYNC_READ_ALL, (buffer) is allocated with PHYSFS_allocate()
+ *  and becomes the caller's, to release with PHYSFS_deallocate(). If the op
+ *  fails, it's left nullptr.
+ *
+ * \sa PHYSFS_submitAsync
+ */
+typedef struct PHYSFS_AsyncOp
+{
+   /* Request... */
+   PHYSFS_AsyncType type;  /**< what to do */
+   const char* path;       /**< file to open, for OPEN_READ and READ_ALL */
+   PHYSFS_File* file;      /**< file to read, or the file opened */
+   void* buffer;           /**< where to read to, or the data read */
+   PHYSFS_uint64 offset;   /**< where to read from, for READ_AT */
+   PHYSFS_uint64 len;      /**< bytes to read, or bytes in the data read */
+   ::std::stop_token cancel; /**< op stops with PHYSFS_ERR_CANCELLED */
+
+   /**
+    * \brief Called on an i/o thread once the op is done.
+    *
+    * Don't block in here: hand the op on to whoever waits for it, and
+    *  return. PhysicsFS doesn't touch (op) once this is called, so it may
+    *  be released or resubmitted right away.
+    */
+   void (*complete)(struct PHYSFS_AsyncOp* op);
+   void* userdata;         /**< yours */
+
+   /* Result... */
+   PHYSFS_sint64 result;   /**< bytes read, or -1 on failure; 0 or -1 for OPEN_READ */
+   PHYSFS_ErrorCode error; /**< why it failed, PHYSFS_ERR_OK if it didn't */
+
+   /* Private... */
+   PHYSFS_IoPriority priority;
+   PHYSFS_uint32 deadlineUs;
+   struct PHYSFS_Context* context;
+   struct PHYSFS_AsyncOp* next;
+} PHYSFS_AsyncOp;
+
+/**
+ * \fn int PHYSFS_submitAsync(PHYSFS_AsyncOp *op)
+ * \brief Queue a file operation for PhysicsFS's i/o threads.
+ *
+ * The op runs on one of the threads set up with PHYSFS_setAsyncThreads(),
+ *  which are started on the first submit. It runs in the calling thread's
+ *  context, with the i/o class and deadline the calling thread had set with
+ *  PHYSFS_setIoPriority(), so a scheduled io still knows what it's serving.
+ *  The context must outlive the op. Ops are started in the order
+ *  they were submitted; with more than one thread, they may finish in any
+ *  order.
+ *
+ * A cancelled op that hasn't started yet doesn't start, and long reads
+ *  check (op->cancel) between chunks. Either way the op still completes,
+ *  with PHYSFS_ERR_CANCELLED and whatever it read up to then.
+ *
+ * If the op can't be queued, because PhysicsFS was built without threads
+ *  or (op->complete) is nullptr, it runs right here, on the calling thread.
+ *  If PhysicsFS isn't initialized, it fails with PHYSFS_ERR_NOT_INITIALIZED.
+ *
+ *    \param op Operation to queue. Must stay valid until it completes.
+ *   \return non-zero if queued: (op->complete) will be called, on an i/o
+ *           thread. Zero if the op is done already: its result is in,
+ *           and (op->complete) won't be called.
+ *
+ * \sa PHYSFS_AsyncOp
+ * \sa PHYSFS_setAsyncThreads
+ */
+PHYSFS_DECL int PHYSFS_submitAsync(PHYSFS_AsyncOp* op);
+
+/**
+ * \fn int PHYSFS_setAsyncThreads(PHYSFS_uint32 count)
+ * \brief Set how many threads serve PHYSFS_submitAsync().
+ *
+ * The default is two. If the threads are running, this waits for everything
+ *  queued to complete and stops them. The new count takes effect with the
+ *  next submit. PHYSFS_deinit() also waits for the queue and stops the threads.
+ *
+ * Neither can be called on one of the i/o threads, since that would wait for
+ *  the calling thread itself: from an op's (complete), or from a coroutine
+ *  that the default MetaPhysFS::Executor resumed there. Both fail with
+ *  PHYSFS_ERR_BUSY instead. Resume on a thread of your own, with an Executor,
+ *  to change the thread count from a coroutine.
+ *
+ *    \param count Number of threads, from 1 to 64.
+ *   \return non-zero on success, zero if (count) is out of range, or if
+ *           called on an i/o thread.
+ *
+ * \sa PHYSFS_submitAsync
+ */
+PHYSFS_DECL int PHYSFS_setAsyncThreads(PHYSFS_uint32 count);
+
+
+namespace MetaPhysFS
+{
+   ///                                                                        
+   ///   Where a coroutine resumes after an asynchronous operation            
+   ///                                                                        
+   /// (post) gets called on a PhysicsFS i/o thread with the coroutine to     
+   /// resume, and should queue it on your task system. The default resumes   
+   /// it right there, on the i/o thread, where PHYSFS_setAsyncThreads and    
+   /// PHYSFS_deinit fail with PHYSFS_ERR_BUSY                                
+   ///                                                                        
+   struct Executor {
+      void (*post)(void* context, ::std::coroutine_handle<> coroutine) = nullptr;
+      void* context = nullptr;
+
+      METAPHYSFS(INLINED)
+      void operator () (::std::coroutine_handle<> coroutine) const {
+         if (post)
+            post(context, coroutine);
+         else
+            coroutine.resume();
+      }
+   };
+
+   namespace Inner
+   {
+      ///                                                                     
+      ///   Awaiter around one PHYSFS_AsyncOp                                 
+      ///                                                                     
+      /// The op lives right here, so in a coroutine's frame, and awaiting    
+      /// allocates nothing. The error code of a failed op is set on the      
+      /// thread that resumes, like the blocking calls set it on theirs       
+      ///                                                                     
+      struct AsyncAwaiter {
+         PHYSFS_AsyncOp mOp {};
+         Executor mExecutor;
+         ::std::coroutine_handle<> mCoroutine;
+
+         AsyncAwaiter(PHYSFS_AsyncType type, Executor executor, ::std::stop_token cancel) noexcept
+            : mExecutor {executor} {
+            mOp.type = type;
+            mOp.cancel = ::std::move(cancel);
+         }
+
+         METAPHYSFS(INLINED)
+         bool await_ready() const noexcept {
+            return false;
+         }
+
+         /// Once queued, the op may complete and the coroutine resume - and  
+         /// this awaiter go away - before submit even returns                
+         bool await_suspend(::std::coroutine_handle<> coroutine) noexcept {
+            mCoroutine = coroutine;
+            mOp.userdata = this;
+            mOp.complete = [](PHYSFS_AsyncOp* op) {
+               auto self = static_cast<AsyncAwaiter*>(op->userdata);
+               self->mExecutor(self->mCoroutine);
+            };
+            return PHYSFS_submitAsync(&mOp) != 0;
+         }
+
+         PHYSFS_sint64 Finish() noexcept {
+            if (mOp.error != PHYSFS_ERR_OK)
+               PHYSFS_setErrorCode(mOp.error);
+            return mOp.result;
+         }
+      };
+   }
+
+   ///                                                                        
+   ///   A whole file's contents, as PHYSFS_ASYNC_READ_ALL allocates them     
+   ///                                                                        
+   class FileData {
+      void* mData = nullptr;
+      PHYSFS_uint64 mSize = 0;
+
+   public:
+      constexpr FileData() noexcept = default;
+      FileData(void* data, PHYSFS_uint64 size) noexcept
+         : mData {data}, mSize {size} {}
+
+      FileData(FileData&& other) noexcept
+         : mData {other.mData}, mSize {other.mSize} {
+         other.mData = nullptr;
+         other.mSize = 0;
+      }
+
+      FileData& operator = (FileData&& rhs) noexcept {
+         if (this != &rhs) {
+            PHYSFS_deallocate(mData);
+            mData = rhs.mData;
+            mSize = rhs.mSize;
+            rhs.mData = nullptr;
+            rhs.mSize = 0;
+         }
+         return *this;
+      }
+
+      ~FileData() {
+         PHYSFS_deallocate(mData);
+      }
+
+      METAPHYSFS(INLINED) const void* Data() const noexcept { return mData; }
+      METAPHYSFS(INLINED) PHYSFS_uint64 Size() const noexcept { return mSize; }
+
+      /// Contents as bytes                                                   
+      METAPHYSFS(INLINED)
+      ::std::span<const ::std::byte> Bytes() const noexcept {
+         return {static_cast<const ::std::byte*>(mData), static_cast<size_t>(mSize)};
+      }
+
+      /// Nothing read, or the read failed                                    
+      constexpr explicit operator bool() const noexcept {
+         return mData != nullptr;
+      }
+   };
+
+   ///                                                                        
+   ///   co_await OpenAsync(path) - PHYSFS_openRead on an i/o thread          
+   ///                                                                        
+   ///   @param path - file to open, in platform-independent notation; must   
+   ///                 stay valid until the operation completes               
+   ///   @param executor - where to resume                                    
+   ///   @param cancel - cancels the operation if it hasn't started yet       
+   ///   @return the file, or nullptr with the error code set                 
+   inline auto OpenAsync(const char* path, Executor executor = {}, ::std::stop_token cancel = {}) {
+      struct Awaiter : Inner::AsyncAwaiter {
+         using AsyncAwaiter::AsyncAwaiter;
+         PHYSFS_File* await_resume() noexcept {
+            Finish();
+            return mOp.file;
+         }
+      } awaiter {PHYSFS_ASYNC_OPEN_READ, executor, ::std::move(cancel)};
+      awaiter.mOp.path = path;
+      return awaiter;
+   }
+
+   ///                                                                        
+   ///   co_await ReadAsync(file, buffer) - PHYSFS_readBytes on an i/o thread 
+   ///                                                                        
+   /// Don't use (file) for anything else until this completes                
+   ///   @param file - file to read from                                      
+   ///   @param buffer - where to read to, any contiguous range               
+   ///   @param executor - where to resume                                    
+   ///   @param cancel - stops the read between chunks                        
+   ///   @return bytes read, or -1 with the error code set; a cancelled read  
+   ///           returns what it got, with PHYSFS_ERR_CANCELLED set           
+   inline auto ReadAsync(
+      PHYSFS_File* file, ::std::ranges::contiguous_range auto&& buffer,
+      Executor executor = {}, ::std::stop_token cancel = {}
+   ) {
+      struct Awaiter : Inner::AsyncAwaiter {
+         using AsyncAwaiter::AsyncAwaiter;
+         PHYSFS_sint64 await_resume() noexcept {
+            return Finish();
+         }
+      } awaiter {PHYSFS_ASYNC_READ, executor, ::std::move(cancel)};
+      awaiter.mOp.file = file;
+      awaiter.mOp.buffer = ::std::ranges::data(buffer);
+      awaiter.mOp.len = ::std::ranges::size(buffer) * sizeof(*::std::ranges::data(buffer));
+      return awaiter;
+   }
+
+   ///                                                                        
+   ///   co_await ReadAtAsync(file, offset, buffer) - PHYSFS_readAt on an     
+   ///   i/o thread. Several of these may be in flight on one file            
+   ///                                                                        
+   ///   @param file - file to read from                                      
+   ///   @param offset - where to start reading                               
+   ///   @param buffer - where to read to, any contiguous range               
+   ///   @param executor - where to resume                                    
+   ///   @param cancel - stops the read between chunks                        
+   ///   @return bytes read, or -1 with the error code set                    
+   inline auto ReadAtAsync(
+      PHYSFS_File* file, PHYSFS_uint64 offset, ::std::ranges::contiguous_range auto&& buffer,
+      Executor executor = {}, ::std::stop_token cancel = {}
+   ) {
+      struct Awaiter : Inner::AsyncAwaiter {
+         using AsyncAwaiter::AsyncAwaiter;
+         PHYSFS_sint64 await_resume() noexcept {
+            return Finish();
+         }
+      } awaiter {PHYSFS_ASYNC_READ_AT, executor, ::std::move(cancel)};
+      awaiter.mOp.file = file;
+      awaiter.mOp.offset = offset;
+      awaiter.mOp.buffer = ::std::ranges::data(buffer);
+      awaiter.mOp.len = ::std::ranges::size(buffer) * sizeof(*::std::ranges::data(buffer));
+      return awaiter;
+   }
+
+   ///                                                                        
+   ///   co_await ReadWholeFileAsync(path) - open, read all, and close on an  
+   ///   i/o thread                                                           
+   ///                                                                        
+   ///   @param path - file to read, in platform-independent notation; must   
+   ///                 stay valid until the operation completes               
+   ///   @param executor - where to resume                                    
+   ///   @param cancel - stops the read between chunks                        
+   ///   @return the contents, or nothing with the error code set             
+   inline auto ReadWholeFileAsync(const char* path, Executor executor = {}, ::std::stop_token cancel = {}) {
+      struct Awaiter : Inner::AsyncAwaiter {
+         using AsyncAwaiter::AsyncAwaiter;
+         FileData await_resume() noexcept {
+            Finish();
+            return {mOp.buffer, mOp.len};
+         }
+      } awaiter {PHYSFS_ASYNC_READ_ALL, executor, ::std::move(cancel)};
+      awaiter.mOp.path = path;
+      return awaiter;
+   }
+
+} // namespace MetaPhysFS
@@ -9,6 +9,12 @@
 #include "../physfs_tree.hpp"
 #include <7z.h>
 
+/* Extraction reads a folder's packed data start to end, so big ones are
+   read ahead this many chunks of this many bytes deep (see
+   PHYSFS_setReadAhead). */
+#define SZIP_READAHEAD_CHUNK  (64 * 1024)
+#define SZIP_READAHEAD_CHUNKS 3
+
 struct SZIPLookToRead {
    ISeekInStream seekStream; /* lzma sdk i/o interface (lower level).  */
    PHYSFS_Io* io;            /* physfs i/o interface for this archive. */
@@ -52,7 +58,7 @@ static PHYSFS_ErrorCode szipErrorCode(const SRes rc) {
 /* LZMA SDK's ISzAlloc interface ... */
 
 static void* SZIP_ISzAlloc_Alloc(ISzAllocPtr p, size_t size) {
-   return allocator.Malloc(size ? size : 1);
+   return allocator.Malloc(size ? size : 1, PHYSFS_ALLOC_DECOMPRESS);
 } /* SZIP_ISzAlloc_Alloc */
 
 static void SZIP_ISzAlloc_Free(ISzAllocPtr p, void* address) {
@@ -136,6 +142,32 @@ static void szipInitStream(SZIPLookToRead* stream, PHYSFS_Io* io) {
 } /* szipInitStream */
 
 
+/* Wrap (io) for read-ahead, if the packed data of the folder holding entry
+   (idx) is big enough to be worth a thread. The folder is unpacked as a
+   whole, solid or not, so that's what gets streamed. */
+static PHYSFS_Io* szipReadAhead(SZIPinfo* info, PHYSFS_Io* io, const PHYSFS_uint32 idx) {
+#if PHYSFS_HAVE_READ_AHEAD
+   const PHYSFS_uint64 minsize = __PHYSFS_readAheadMinSize();
+   const UInt32 folder = info->db.FileToFolder[idx];
+   if (minsize == 0 || folder == (UInt32) -1)
+      return io;  /* switched off, or an empty file. */
+
+   const UInt64* packpos = info->db.db.PackPositions;
+   const UInt32* packidx = info->db.db.FoStartPackStreamIndex;
+   const UInt64 start = packpos[packidx[folder]];
+   const UInt64 end = packpos[packidx[folder + 1]];
+   if (end - start >= minsize) {
+      PHYSFS_Io* retval = __PHYSFS_createReadAheadIo(io, info->db.dataPos + end,
+         SZIP_READAHEAD_CHUNK, SZIP_READAHEAD_CHUNKS);
+      if (retval)
+         return retval;
+   } /* if */
+#endif
+
+   return io;
+} /* szipReadAhead */
+
+
 /* Do this in a separate function so we can smallAlloc without looping. */
 static int szipLoadEntry(SZIPinfo* info, const PHYSFS_uint32 idx) {
    const size_t utf16len = SzArEx_GetFileNameUtf16(&info->db, idx, nullptr);
@@ -255,6 +287,7 @@ static PHYSFS_Io* SZIP_openRead(void* opaque, const char* path) {
    io = info->io->duplicate(info->io);
    GOTO_IF_ERRPASS(!io, SZIP_openRead_failed);
 
+   io = szipReadAhead(info, io, entry->dbidx);
    szipInitStream(&stream, io);
 
    rc = SzArEx_Extract(&info->db, &stream.lookStream.s, entry->dbidx,
@@ -266,7 +299,7 @@ static PHYSFS_Io* SZIP_openRead(void* opaque, const char* path) {
    io->destroy(io);
    io = nullptr;
 
-   buf = allocator.Malloc(outSizeProcessed ? outSizeProcessed : 1);
+   buf = allocator.Malloc(outSizeProcessed ? outSizeProcessed : 1, PHYSFS_ALLOC_DECOMPRESS);
    GOTO_IF(buf == nullptr, PHYSFS_ERR_OUT_OF_MEMORY, SZIP_openRead_failed);
 
    if (outSizeProcessed > 0)
@@ -360,6 +393,34 @@ static int SZIP_stat(void* opaque, const char* path, PHYSFS_Stat* stat) {
    return 1;
 }
 
+/* A file's bytes come out of unpacking its whole folder, so the layout
+   given is that folder's packed streams, which is what has to be read. */
+static int SZIP_statEx(void* opaque, const char* path, PHYSFS_StatEx* stat) {
+   SZIPinfo* info = (SZIPinfo*) opaque;
+   BAIL_IF_ERRPASS(!SZIP_stat(opaque, path, &stat->stat), 0);
+   if (stat->stat.filetype == PHYSFS_FILETYPE_DIRECTORY)
+      return 1;
+
+   SZIPentry* entry = (SZIPentry*) __PHYSFS_DirTreeFind(&info->tree, path);
+   const UInt32 folder = info->db.FileToFolder[entry->dbidx];
+   stat->contiguous = 1;
+   if (folder == (UInt32) -1) {
+      stat->storedSize = 0;  /* empty file, nothing stored. */
+      stat->compression = PHYSFS_COMPRESSION_NONE;
+      return 1;
+   } /* if */
+
+   const UInt64* packpos = info->db.db.PackPositions;
+   const UInt32* packidx = info->db.db.FoStartPackStreamIndex;
+   const UInt64 start = packpos[packidx[folder]];
+   const UInt64 end = packpos[packidx[folder + 1]];
+   stat->offset = (PHYSFS_sint64) (info->db.dataPos + start);
+   stat->storedSize = (PHYSFS_sint64) (end - start);
+   stat->compression = PHYSFS_COMPRESSION_SOLID;
+   stat->block = folder;
+   return 1;
+}
+
 void SZIP_global_init() {
    // This just needs to calculate some things, so it only ever        
    // has to run once, even after a deinit                             
@@ -386,5 +447,7 @@ const PHYSFS_Archiver __PHYSFS_Archiver_7Z = {
    SZIP_remove,
    SZIP_mkdir,
    SZIP_stat,
-   SZIP_closeArchive
+   SZIP_closeArchive,
+   SZIP_statEx,
+   0  /* concurrentOpenRead */
 };
@@ -33,32 +33,31 @@
 /// Travis Wells.                                                             
 ///                                                                           
 #include "physfs_internal.hpp"
+#include "physfs_unpk.hpp"
 #include <cassert>
 
 
 namespace
 {
-   int csmLoadEntries(PHYSFS_Io* io, const PHYSFS_uint16 count, void* arc) {
+   int csmLoadEntries(UNPK_TableReader& table, const PHYSFS_uint16 count, void* arc) {
       for (PHYSFS_uint16 i = 0; i < count; i++) {
          PHYSFS_uint8 fn_len;
-         BAIL_IF_ERRPASS(not __PHYSFS_readAll(io, &fn_len, 1), 0);
+         BAIL_IF_ERRPASS(not table.read(&fn_len, 1), 0);
 
-         char name[12];
-         BAIL_IF_ERRPASS(not __PHYSFS_readAll(io, name, 12), 0);
+         char name[13];
+         BAIL_IF_ERRPASS(not table.read(name, 12), 0);
 
          PHYSFS_uint32 size;
-         BAIL_IF_ERRPASS(not __PHYSFS_readAll(io, &size, 4), 0);
+         BAIL_IF_ERRPASS(not table.readui32(&size), 0);
 
          PHYSFS_uint32 pos;
-         BAIL_IF_ERRPASS(not __PHYSFS_readAll(io, &pos, 4), 0);
+         BAIL_IF_ERRPASS(not table.readui32(&pos), 0);
 
          // Name might not be null-terminated in file                   
          if (fn_len > 12)
             fn_len = 12;
          name[fn_len] = '\0';
 
-         size = PHYSFS_swapLE(size);
-         pos = PHYSFS_swapLE(pos);
          BAIL_IF_ERRPASS(not UNPK_addEntry(arc, name, 0, -1, -1, pos, size), 0);
       }
 
@@ -82,11 +81,11 @@ namespace
       BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &count, sizeof(count)), nullptr);
       count = PHYSFS_swapLE(count);
 
-
+      UNPK_TableReader table {io, 21 * PHYSFS_uint64(count)};
       unpkarc = UNPK_openArchive(io, 0, 1);
       BAIL_IF_ERRPASS(!unpkarc, nullptr);
 
-      if (!csmLoadEntries(io, count, unpkarc)) {
+      if (!csmLoadEntries(table, count, unpkarc)) {
          UNPK_abandonArchive(unpkarc);
          return nullptr;
       }
@@ -111,5 +110,7 @@ const PHYSFS_Archiver __PHYSFS_Archiver_CSM = {
    UNPK_remove,
    UNPK_mkdir,
    UNPK_stat,
-   UNPK_closeArchive
+   UNPK_closeArchive,
+   UNPK_statEx,
+   0  // concurrentOpenRead
 };
@@ -132,6 +132,24 @@ namespace
       __PHYSFS_smallFree(d);
       return retval;
    }
+
+   /// A file on disk is its own storage, so the offset is into the file      
+   int DIR_statEx(void* opaque, const char* name, PHYSFS_StatEx* stat) {
+      BAIL_IF_ERRPASS(not DIR_stat(opaque, name, &stat->stat), 0);
+      if (stat->stat.filetype != PHYSFS_FILETYPE_REGULAR)
+         return 1;
+
+      stat->offset = 0;
+      stat->storedSize = stat->stat.filesize;
+      stat->compression = PHYSFS_COMPRESSION_NONE;
+      stat->contiguous = 1;
+      stat->mappable = 1;
+      return 1;
+   }
+}
+
+PHYSFS_Io* __PHYSFS_DirOpenReadDirect(void* opaque, const char* filename) {
+   return doOpen(opaque, filename, 'd');
 }
 
 const PHYSFS_Archiver __PHYSFS_Archiver_DIR = {
@@ -150,5 +168,7 @@ const PHYSFS_Archiver __PHYSFS_Archiver_DIR = {
     DIR_remove,
     DIR_mkdir,
     DIR_stat,
-    DIR_closeArchive
+    DIR_closeArchive,
+    DIR_statEx,
+    1  // concurrentOpenRead
 };
\ No newline at end of file
@@ -24,21 +24,22 @@
 /// This file written by Ryan C. Gordon.                                      
 ///                                                                           
 #include "../physfs_internal.hpp"
+#include "../physfs_unpk.hpp"
 #include <cassert>
 
 
 namespace
 {
-   int grpLoadEntries(PHYSFS_Io* io, const PHYSFS_uint32 count, void* arc) {
+   int grpLoadEntries(UNPK_TableReader& table, const PHYSFS_uint32 count, void* arc) {
       PHYSFS_uint32 pos = 16 + (16 * count);  // Past sig+metadata      
       PHYSFS_uint32 i;
 
       for (i = 0; i < count; i++) {
          char name[13];
-         BAIL_IF_ERRPASS(not __PHYSFS_readAll(io, name, 12), 0);
+         BAIL_IF_ERRPASS(not table.read(name, 12), 0);
 
          PHYSFS_uint32 size;
-         BAIL_IF_ERRPASS(not __PHYSFS_readAll(io, &size, 4), 0);
+         BAIL_IF_ERRPASS(not table.readui32(&size), 0);
 
          name[12] = '\0';  // Name isn't null-terminated in file        
 
@@ -46,7 +47,6 @@ namespace
          if (ptr)
             *ptr = '\0';   // Trim extra spaces                         
 
-         size = PHYSFS_swapLE(size);
          BAIL_IF_ERRPASS(not UNPK_addEntry(arc, name, 0, -1, -1, pos, size), 0);
 
          pos += size;
@@ -70,10 +70,11 @@ namespace
       BAIL_IF_ERRPASS(not __PHYSFS_readAll(io, &count, sizeof(count)), nullptr);
       count = PHYSFS_swapLE(count);
 
+      UNPK_TableReader table {io, 16 * PHYSFS_uint64(count)};
       auto unpkarc = UNPK_openArchive(io, 0, 1);
       BAIL_IF_ERRPASS(!unpkarc, nullptr);
 
-      if (not grpLoadEntries(io, count, unpkarc)) {
+      if (not grpLoadEntries(table, count, unpkarc)) {
          UNPK_abandonArchive(unpkarc);
          return nullptr;
       }
@@ -98,5 +99,7 @@ const PHYSFS_Archiver __PHYSFS_Archiver_GRP = {
     UNPK_remove,
     UNPK_mkdir,
     UNPK_stat,
-    UNPK_closeArchive
+    UNPK_closeArchive,
+    UNPK_statEx,
+    0  /* concurrentOpenRead */
 };
\ No newline at end of file
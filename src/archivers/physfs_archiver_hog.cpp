@@ -59,13 +59,16 @@ static int hog1LoadEntries(PHYSFS_Io *io, void *arc)
     const PHYSFS_uint64 iolen = io->length(io);
     PHYSFS_uint32 pos = 3;
 
+    /* headers are spread between the files, so read them in windows. */
+    UNPK_TableReader table(io, 0);
+
     while (pos < iolen)
     {
         PHYSFS_uint32 size;
         char name[13];
 
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, name, 13), 0);
-        BAIL_IF_ERRPASS(!readui32(io, &size), 0);
+        BAIL_IF_ERRPASS(!table.read(name, 13), 0);
+        BAIL_IF_ERRPASS(!table.readui32(&size), 0);
         name[12] = '\0';  /* just in case. */
         pos += 13 + 4;
 
@@ -73,7 +76,7 @@ static int hog1LoadEntries(PHYSFS_Io *io, void *arc)
         pos += size;
 
         /* skip over entry */
-        BAIL_IF_ERRPASS(!io->seek(io, pos), 0);
+        BAIL_IF_ERRPASS(!table.seek(pos), 0);
     } /* while */
 
     return 1;
@@ -89,15 +92,16 @@ static int hog2LoadEntries(PHYSFS_Io *io, void *arc)
     BAIL_IF_ERRPASS(!readui32(io, &pos), 0);
     BAIL_IF_ERRPASS(!io->seek(io, 68), 0);  /* skip to end of header. */
 
+    UNPK_TableReader table(io, 48 * (PHYSFS_uint64) numfiles);
     for (i = 0; i < numfiles; i++) {
         char name[37];
         PHYSFS_uint32 reserved;
         PHYSFS_uint32 size;
         PHYSFS_uint32 mtime;
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, name, 36), 0);
-        BAIL_IF_ERRPASS(!readui32(io, &reserved), 0);
-        BAIL_IF_ERRPASS(!readui32(io, &size), 0);
-        BAIL_IF_ERRPASS(!readui32(io, &mtime), 0);
+        BAIL_IF_ERRPASS(!table.read(name, 36), 0);
+        BAIL_IF_ERRPASS(!table.readui32(&reserved), 0);
+        BAIL_IF_ERRPASS(!table.readui32(&size), 0);
+        BAIL_IF_ERRPASS(!table.readui32(&mtime), 0);
         name[36] = '\0';  /* just in case */
         BAIL_IF_ERRPASS(!UNPK_addEntry(arc, name, 0, mtime, mtime, pos, size), 0);
         pos += size;
@@ -160,5 +164,7 @@ const PHYSFS_Archiver __PHYSFS_Archiver_HOG =
     UNPK_remove,
     UNPK_mkdir,
     UNPK_stat,
-    UNPK_closeArchive
+    UNPK_closeArchive,
+    UNPK_statEx,
+    0  /* concurrentOpenRead */
 };
\ No newline at end of file
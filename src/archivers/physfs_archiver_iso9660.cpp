@@ -373,5 +373,7 @@ const PHYSFS_Archiver __PHYSFS_Archiver_ISO9660 =
     UNPK_remove,
     UNPK_mkdir,
     UNPK_stat,
-    UNPK_closeArchive
+    UNPK_closeArchive,
+    UNPK_statEx,
+    0  /* concurrentOpenRead */
 };
@@ -0,0 +1,1189 @@
+///                                                                           
+/// MPK support routines for PhysicsFS.                                       
+///                                                                           
+///  MPK is MetaPhysFS's own pack format. Unlike everything else we read, it  
+///  was laid out for the lookups PhysicsFS does all day: the whole index is  
+///  one flat block that is used exactly as it sits in the file, so mounting  
+///  is one read and a checksum, and finding a file is a hash and a short     
+///  scan, without a directory tree ever being built.                         
+///                                                                           
+///  ======================================================================== 
+///                                                                           
+///  All integers are little endian. All offsets are from the start of the    
+///  file.                                                                    
+///                                                                           
+///  Header (64 bytes)                                                        
+///   (4 bytes)  signature = 'MPK1'                                           
+///   (4 bytes)  version = 1                                                  
+///   (4 bytes)  alignment of entry data, a power of two                      
+///   (4 bytes)  chunk size of compressed entries, uncompressed bytes         
+///   (4 bytes)  entry count, the root directory included                     
+///   (4 bytes)  bucket count, a power of two                                 
+///   (4 bytes)  chunk table length                                           
+///   (4 bytes)  child table length                                           
+///   (4 bytes)  names size, in bytes                                         
+///   (4 bytes)  flags (1 = verify content hashes on read)                    
+///   (8 bytes)  index offset, 8-aligned                                      
+///   (8 bytes)  index size                                                   
+///   (8 bytes)  FNV-1a hash of the index                                     
+///                                                                           
+///  Index                                                                    
+///   (4 bytes each)  bucket fanout, bucket count + 1 of them: entries whose  
+///                   name hash modulo bucket count is b are the ones from    
+///                   fanout[b] up to fanout[b + 1]                           
+///   (4 bytes each)  child table, entry indices                              
+///   (padding to 8)                                                          
+///   (64 bytes each) entries, sorted by bucket, then by name hash            
+///   (8 bytes each)  chunk table, offsets from the start of an entry's data  
+///   (names size)    names, full paths without a leading '/', \0 ended       
+///                                                                           
+///  Entry                                                                    
+///   (8 bytes)  FNV-1a hash of the name                                      
+///   (8 bytes)  data offset, aligned, so stored data can be mapped directly  
+///   (8 bytes)  size                                                         
+///   (8 bytes)  stored size                                                  
+///   (8 bytes)  FNV-1a hash of the content, identical content is stored once 
+///   (8 bytes)  modification time                                            
+///   (4 bytes)  name offset, into the names                                  
+///   (4 bytes)  flags (1 = directory, 2 = LZ4 chunks)                        
+///   (4 bytes)  first chunk table entry, or first child table entry          
+///   (4 bytes)  child count, for directories                                 
+///                                                                           
+///  A compressed entry is cut into chunks of chunk size bytes, each one an   
+///  LZ4 block on its own, or stored as is if it wouldn't shrink. Its chunk   
+///  table entries, one more than it has chunks, say where each one starts,   
+///  so any position is one chunk decode away.                                
+///                                                                           
+///  ======================================================================== 
+///                                                                           
+/// Please see the file LICENSE.txt in the source's root directory.           
+///                                                                           
+#include "../physfs_internal.hpp"
+#include <algorithm>
+#include <bit>
+
+
+constexpr PHYSFS_uint32 MPK_SIG = 0x314B504D;  // "MPK1" in ASCII
+constexpr PHYSFS_uint32 MPK_VERSION = 1;
+constexpr PHYSFS_uint32 MPK_HEADER_SIZE = 64;
+constexpr PHYSFS_uint32 MPK_ENTRY_SIZE = 64;
+constexpr PHYSFS_uint32 MPK_MAX_CHUNK = 16 * 1024 * 1024;
+constexpr PHYSFS_uint32 MPK_PACK_VERIFY = 1;
+constexpr PHYSFS_uint32 MPK_ENTRY_DIR = 1;
+constexpr PHYSFS_uint32 MPK_ENTRY_LZ4 = 2;
+constexpr PHYSFS_uint32 MPK_NO_CHUNK = 0xFFFFFFFF;
+
+/// An entry, exactly as it is in the file                                    
+struct MPKentry {
+   PHYSFS_uint64 nameHash;
+   PHYSFS_uint64 offset;
+   PHYSFS_uint64 size;
+   PHYSFS_uint64 storedSize;
+   PHYSFS_uint64 contentHash;
+   PHYSFS_sint64 mtime;
+   PHYSFS_uint32 name;
+   PHYSFS_uint32 flags;
+   PHYSFS_uint32 first;
+   PHYSFS_uint32 childCount;
+};
+static_assert(sizeof(MPKentry) == MPK_ENTRY_SIZE);
+
+struct MPKinfo {
+   PHYSFS_Io* io;
+   void* index;                        // The whole index block
+   const PHYSFS_uint32* fanout;
+   const PHYSFS_uint32* children;
+   const MPKentry* entries;
+   const PHYSFS_uint64* chunks;
+   const char* names;
+   PHYSFS_uint64 length;               // Of the whole file
+   PHYSFS_uint32 entryCount;
+   PHYSFS_uint32 bucketCount;
+   PHYSFS_uint32 childCount;
+   PHYSFS_uint32 chunkCount;
+   PHYSFS_uint32 namesSize;
+   PHYSFS_uint32 chunkSize;
+   PHYSFS_uint32 flags;
+};
+
+struct MPKfileinfo {
+   PHYSFS_Io* io;                      // Duplicate of the archive's
+   const MPKinfo* arc;
+   MPKentry entry;                     // Byte swapped copy
+   PHYSFS_uint64 pos;
+
+   // Compressed entries only                                           
+   PHYSFS_uint8* chunk;                // Decoded chunk
+   PHYSFS_uint8* packed;               // Chunk as stored
+   PHYSFS_uint32 chunkIndex;           // Decoded, or MPK_NO_CHUNK
+
+   // Content hash over what was read in order from the start, if the   
+   // pack asks for verification                                        
+   PHYSFS_uint64 hash;
+   PHYSFS_uint64 hashed;
+   bool verify;
+};
+
+namespace
+{
+   PHYSFS_uint64 hashName(const char* name) {
+      return __PHYSFS_fnv1a(__PHYSFS_FNV_BASIS, name, strlen(name));
+   }
+
+   /// Entries are used in place, so they're only swapped when copied out     
+   MPKentry swapEntry(const MPKentry& in) {
+      MPKentry e;
+      e.nameHash = PHYSFS_swapLE(in.nameHash);
+      e.offset = PHYSFS_swapLE(in.offset);
+      e.size = PHYSFS_swapLE(in.size);
+      e.storedSize = PHYSFS_swapLE(in.storedSize);
+      e.contentHash = PHYSFS_swapLE(in.contentHash);
+      e.mtime = PHYSFS_swapLE(in.mtime);
+      e.name = PHYSFS_swapLE(in.name);
+      e.flags = PHYSFS_swapLE(in.flags);
+      e.first = PHYSFS_swapLE(in.first);
+      e.childCount = PHYSFS_swapLE(in.childCount);
+      return e;
+   }
+
+   PHYSFS_uint64 chunkCountOf(const MPKinfo* info, const MPKentry& e) {
+      return (e.size + info->chunkSize - 1) / info->chunkSize;
+   }
+
+   /// Check everything about an entry that could send us out of bounds       
+   bool entryIsSane(const MPKinfo* info, const MPKentry& e) {
+      if (e.name >= info->namesSize)
+         return false;
+      if (e.flags & MPK_ENTRY_DIR)
+         return e.first <= info->childCount and e.childCount <= info->childCount - e.first;
+      if (e.offset > info->length or e.storedSize > info->length - e.offset)
+         return false;
+      if (not (e.flags & MPK_ENTRY_LZ4))
+         return e.storedSize == e.size;
+
+      const auto count = chunkCountOf(info, e);
+      return e.first <= info->chunkCount and count < info->chunkCount - e.first
+         and PHYSFS_swapLE(info->chunks[e.first + count]) == e.storedSize;
+   }
+
+   /// Look a path up: a hash, a bucket, and a few compares at worst          
+   const MPKentry* findEntry(const MPKinfo* info, const char* path) {
+      const auto hash = hashName(path);
+      const auto bucket = static_cast<PHYSFS_uint32>(hash & (info->bucketCount - 1));
+      const auto end = PHYSFS_swapLE(info->fanout[bucket + 1]);
+      for (auto i = PHYSFS_swapLE(info->fanout[bucket]); i < end; ++i) {
+         const auto& e = info->entries[i];
+         const auto nameHash = PHYSFS_swapLE(e.nameHash);
+         if (nameHash > hash)
+            break;
+         if (nameHash == hash and strcmp(info->names + PHYSFS_swapLE(e.name), path) == 0)
+            return &e;
+      }
+
+      BAIL(PHYSFS_ERR_NOT_FOUND, nullptr);
+   }
+
+   /// Decode one LZ4 block, which must fill (dst) exactly                    
+   bool lz4Decode(const PHYSFS_uint8* src, size_t srcLen, PHYSFS_uint8* dst, size_t dstLen) {
+      const auto srcEnd = src + srcLen;
+      const auto dstStart = dst;
+      const auto dstEnd = dst + dstLen;
+
+      while (src < srcEnd) {
+         const auto token = *src++;
+         size_t literals = token >> 4;
+         if (literals == 15) {
+            PHYSFS_uint8 b;
+            do {
+               if (src == srcEnd)
+                  return false;
+               b = *src++;
+               literals += b;
+            }
+            while (b == 255);
+         }
+
+         if (literals > size_t(srcEnd - src) or literals > size_t(dstEnd - dst))
+            return false;
+         memcpy(dst, src, literals);
+         src += literals;
+         dst += literals;
+         if (src == srcEnd)
+            break;  // The last sequence has no match
+
+         if (srcEnd - src < 2)
+            return false;
+         const size_t offset = src[0] | (size_t(src[1]) << 8);
+         src += 2;
+         if (offset == 0 or offset > size_t(dst - dstStart))
+            return false;
+
+         size_t length = token & 15;
+         if (length == 15) {
+            PHYSFS_uint8 b;
+            do {
+               if (src == srcEnd)
+                  return false;
+               b = *src++;
+               length += b;
+            }
+            while (b == 255);
+         }
+         length += 4;
+         if (length > size_t(dstEnd - dst))
+            return false;
+
+         // Matches may overlap what they produce, byte by byte then    
+         const PHYSFS_uint8* match = dst - offset;
+         if (offset >= length)
+            memcpy(dst, match, length);
+         else for (size_t i = 0; i < length; ++i)
+            dst[i] = match[i];
+         dst += length;
+      }
+
+      return dst == dstEnd;
+   }
+
+   /// Make chunk (index) of a compressed entry the decoded one               
+   bool loadChunk(MPKfileinfo* finfo, PHYSFS_uint32 index) {
+      if (finfo->chunkIndex == index)
+         return true;
+
+      const auto info = finfo->arc;
+      const auto& e = finfo->entry;
+      const auto start = PHYSFS_swapLE(info->chunks[e.first + index]);
+      const auto end = PHYSFS_swapLE(info->chunks[e.first + index + 1]);
+      const auto size = std::min<PHYSFS_uint64>(info->chunkSize, e.size - PHYSFS_uint64(index) * info->chunkSize);
+      BAIL_IF(end < start or end - start > size, PHYSFS_ERR_CORRUPT, false);
+
+      // Whatever is read from here on lands in (chunk), so it no longer
+      // holds the one that was decoded, even if the read fails         
+      const auto stored = static_cast<size_t>(end - start);
+      finfo->chunkIndex = MPK_NO_CHUNK;
+      BAIL_IF_ERRPASS(not finfo->io->seek(finfo->io, e.offset + start), false);
+      if (stored == size) {
+         // Didn't shrink, so it's stored as is                         
+         BAIL_IF_ERRPASS(not __PHYSFS_readAll(finfo->io, finfo->chunk, stored), false);
+      }
+      else {
+         BAIL_IF_ERRPASS(not __PHYSFS_readAll(finfo->io, finfo->packed, stored), false);
+         BAIL_IF(not lz4Decode(finfo->packed, stored, finfo->chunk, size_t(size)), PHYSFS_ERR_CORRUPT, false);
+      }
+
+      finfo->chunkIndex = index;
+      return true;
+   }
+
+   PHYSFS_sint64 MPK_read(PHYSFS_Io* io, void* buffer, PHYSFS_uint64 len) {
+      auto finfo = static_cast<MPKfileinfo*>(io->opaque);
+      const auto& e = finfo->entry;
+      const auto start = finfo->pos;
+      len = std::min(len, e.size - finfo->pos);
+
+      PHYSFS_sint64 retval;
+      if (not (e.flags & MPK_ENTRY_LZ4)) {
+         retval = finfo->io->read(finfo->io, buffer, len);
+         BAIL_IF_ERRPASS(retval < 0, -1);
+         finfo->pos += retval;
+      }
+      else {
+         const auto chunkSize = finfo->arc->chunkSize;
+         auto out = static_cast<PHYSFS_uint8*>(buffer);
+         while (len > 0) {
+            const auto index = static_cast<PHYSFS_uint32>(finfo->pos / chunkSize);
+            if (not loadChunk(finfo, index)) {
+               if (finfo->pos == start)
+                  return -1;
+               break;
+            }
+
+            const auto offset = static_cast<size_t>(finfo->pos % chunkSize);
+            const auto size = std::min<PHYSFS_uint64>(chunkSize, e.size - PHYSFS_uint64(index) * chunkSize);
+            const auto count = static_cast<size_t>(std::min<PHYSFS_uint64>(len, size - offset));
+            memcpy(out, finfo->chunk + offset, count);
+            out += count;
+            len -= count;
+            finfo->pos += count;
+         }
+         retval = static_cast<PHYSFS_sint64>(finfo->pos - start);
+      }
+
+      if (finfo->verify and start == finfo->hashed) {
+         finfo->hash = __PHYSFS_fnv1a(finfo->hash, buffer, static_cast<size_t>(retval));
+         finfo->hashed = finfo->pos;
+         if (finfo->hashed == e.size and finfo->hash != e.contentHash)
+            BAIL(PHYSFS_ERR_CORRUPT, -1);
+      }
+      return retval;
+   }
+
+   /// Stored entries are a window onto the archive, and read through it      
+   /// directly. This skips content verification                              
+   PHYSFS_sint64 MPK_readAt(PHYSFS_Io* io, PHYSFS_uint64 offset, void* buffer, PHYSFS_uint64 len) {
+      auto finfo = static_cast<MPKfileinfo*>(io->opaque);
+      const auto& e = finfo->entry;
+      if (offset >= e.size)
+         return 0;
+
+      len = std::min(len, e.size - offset);
+      return finfo->io->readAt(finfo->io, e.offset + offset, buffer, len);
+   }
+
+   PHYSFS_sint64 MPK_write(PHYSFS_Io*, const void*, PHYSFS_uint64) {
+      BAIL(PHYSFS_ERR_READ_ONLY, -1);
+   }
+
+   int MPK_seek(PHYSFS_Io* io, PHYSFS_uint64 offset) {
+      auto finfo = static_cast<MPKfileinfo*>(io->opaque);
+      const auto& e = finfo->entry;
+      BAIL_IF(offset > e.size, PHYSFS_ERR_PAST_EOF, 0);
+
+      // Compressed entries seek for free, the next read loads a chunk  
+      if (not (e.flags & MPK_ENTRY_LZ4))
+         BAIL_IF_ERRPASS(not finfo->io->seek(finfo->io, e.offset + offset), 0);
+      finfo->pos = offset;
+      return 1;
+   }
+
+   PHYSFS_sint64 MPK_tell(PHYSFS_Io* io) {
+      return static_cast<PHYSFS_sint64>(static_cast<MPKfileinfo*>(io->opaque)->pos);
+   }
+
+   PHYSFS_sint64 MPK_length(PHYSFS_Io* io) {
+      return static_cast<PHYSFS_sint64>(static_cast<MPKfileinfo*>(io->opaque)->entry.size);
+   }
+
+   void MPK_destroy(PHYSFS_Io* io) {
+      auto finfo = static_cast<MPKfileinfo*>(io->opaque);
+      if (finfo->io)
+         finfo->io->destroy(finfo->io);
+      allocator.Free(finfo->chunk);
+      allocator.Free(finfo->packed);
+      allocator.Free(finfo);
+      allocator.Free(io);
+   }
+
+   PHYSFS_Io* MPK_duplicate(PHYSFS_Io* io);
+
+   int MPK_flush(PHYSFS_Io*) {
+      return 1;  // No write support
+   }
+
+   const PHYSFS_Io MPK_Io =
+   {
+      CURRENT_PHYSFS_IO_API_VERSION, nullptr,
+      MPK_read,
+      MPK_write,
+      MPK_seek,
+      MPK_tell,
+      MPK_length,
+      MPK_duplicate,
+      MPK_flush,
+      MPK_destroy,
+      MPK_readAt
+   };
+
+   /// Open an io for (e), which must be sane and a file                      
+   PHYSFS_Io* openEntry(const MPKinfo* info, const MPKentry& e) {
+      auto retval = static_cast<PHYSFS_Io*>(allocator.Malloc(sizeof(PHYSFS_Io), PHYSFS_ALLOC_FILEHANDLE));
+      auto finfo = static_cast<MPKfileinfo*>(allocator.Malloc(sizeof(MPKfileinfo), PHYSFS_ALLOC_FILEHANDLE));
+      if (not retval or not finfo) {
+         allocator.Free(retval);
+         allocator.Free(finfo);
+         BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+      }
+
+      memset(finfo, 0, sizeof(MPKfileinfo));
+      memcpy(retval, &MPK_Io, sizeof(PHYSFS_Io));
+      retval->opaque = finfo;
+      finfo->arc = info;
+      finfo->entry = e;
+      finfo->chunkIndex = MPK_NO_CHUNK;
+      finfo->hash = __PHYSFS_FNV_BASIS;
+      finfo->verify = (info->flags & MPK_PACK_VERIFY) != 0;
+
+      if (e.flags & MPK_ENTRY_LZ4) {
+         finfo->chunk = static_cast<PHYSFS_uint8*>(allocator.Malloc(info->chunkSize, PHYSFS_ALLOC_DECOMPRESS));
+         finfo->packed = static_cast<PHYSFS_uint8*>(allocator.Malloc(info->chunkSize, PHYSFS_ALLOC_DECOMPRESS));
+         if (not finfo->chunk or not finfo->packed) {
+            MPK_destroy(retval);
+            BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+         }
+      }
+
+      finfo->io = info->io->duplicate(info->io);
+      if (not finfo->io or not finfo->io->seek(finfo->io, e.offset)) {
+         MPK_destroy(retval);
+         return nullptr;
+      }
+
+      if ((e.flags & MPK_ENTRY_LZ4) or not __PHYSFS_ioCanReadAt(finfo->io))
+         retval->readAt = nullptr;
+      return retval;
+   }
+
+   PHYSFS_Io* MPK_duplicate(PHYSFS_Io* io) {
+      auto finfo = static_cast<MPKfileinfo*>(io->opaque);
+      return openEntry(finfo->arc, finfo->entry);
+   }
+
+   void MPK_closeArchive(void* opaque) {
+      auto info = static_cast<MPKinfo*>(opaque);
+      if (not info)
+         return;
+      if (info->io)
+         info->io->destroy(info->io);
+      allocator.Free(info->index);
+      allocator.Free(info);
+   }
+
+   /// Mounting reads the header and the index, and checks that the index     
+   /// is whole. Nothing in it gets parsed or copied: entries are checked     
+   /// when they're opened                                                    
+   void* MPK_openArchive(PHYSFS_Io* io, const char*, int forWriting, int* claimed) {
+      assert(io != nullptr);  // Shouldn't ever happen
+      BAIL_IF(forWriting, PHYSFS_ERR_READ_ONLY, nullptr);
+
+      PHYSFS_uint32 h32[10];
+      PHYSFS_uint64 h64[3];
+      BAIL_IF_ERRPASS(not __PHYSFS_readAll(io, h32, sizeof(h32)), nullptr);
+      BAIL_IF(PHYSFS_swapLE(h32[0]) != MPK_SIG, PHYSFS_ERR_UNSUPPORTED, nullptr);
+      *claimed = 1;
+
+      BAIL_IF(PHYSFS_swapLE(h32[1]) != MPK_VERSION, PHYSFS_ERR_UNSUPPORTED, nullptr);
+      BAIL_IF_ERRPASS(not __PHYSFS_readAll(io, h64, sizeof(h64)), nullptr);
+      for (auto& v : h32)
+         v = PHYSFS_swapLE(v);
+      for (auto& v : h64)
+         v = PHYSFS_swapLE(v);
+
+      const auto chunkSize = h32[3];
+      const auto entryCount = h32[4];
+      const auto bucketCount = h32[5];
+      const auto chunkCount = h32[6];
+      const auto childCount = h32[7];
+      const auto namesSize = h32[8];
+      const auto indexOffset = h64[0];
+      const auto indexSize = h64[1];
+      const auto length = io->length(io);
+      BAIL_IF_ERRPASS(length < 0, nullptr);
+
+      // The sections have to add up to the index, exactly              
+      const auto entriesAt = (PHYSFS_uint64(bucketCount + 1ull) + childCount) * 4;
+      const auto entriesOffset = (entriesAt + 7) & ~PHYSFS_uint64(7);
+      const auto chunksOffset = entriesOffset + PHYSFS_uint64(entryCount) * MPK_ENTRY_SIZE;
+      const auto namesOffset = chunksOffset + PHYSFS_uint64(chunkCount) * 8;
+      BAIL_IF(chunkSize == 0 or chunkSize > MPK_MAX_CHUNK, PHYSFS_ERR_CORRUPT, nullptr);
+      BAIL_IF(bucketCount == 0 or (bucketCount & (bucketCount - 1)), PHYSFS_ERR_CORRUPT, nullptr);
+      BAIL_IF(entryCount == 0 or namesSize == 0, PHYSFS_ERR_CORRUPT, nullptr);
+      BAIL_IF(namesOffset + namesSize != indexSize, PHYSFS_ERR_CORRUPT, nullptr);
+      BAIL_IF(indexOffset % 8 or indexOffset > PHYSFS_uint64(length), PHYSFS_ERR_CORRUPT, nullptr);
+      BAIL_IF(indexSize > PHYSFS_uint64(length) - indexOffset, PHYSFS_ERR_CORRUPT, nullptr);
+      BAIL_IF(indexSize > SIZE_MAX, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+
+      auto info = static_cast<MPKinfo*>(allocator.Malloc(sizeof(MPKinfo), PHYSFS_ALLOC_DIRTREE));
+      BAIL_IF(not info, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+      memset(info, 0, sizeof(MPKinfo));
+
+      auto index = static_cast<PHYSFS_uint8*>(allocator.Malloc(indexSize, PHYSFS_ALLOC_DIRTREE));
+      if (not index) {
+         MPK_closeArchive(info);
+         BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+      }
+      info->index = index;
+
+      if (not io->seek(io, indexOffset) or not __PHYSFS_readAll(io, index, size_t(indexSize))) {
+         MPK_closeArchive(info);
+         return nullptr;
+      }
+
+      info->fanout = reinterpret_cast<const PHYSFS_uint32*>(index);
+      info->children = info->fanout + bucketCount + 1;
+      info->entries = reinterpret_cast<const MPKentry*>(index + entriesOffset);
+      info->chunks = reinterpret_cast<const PHYSFS_uint64*>(index + chunksOffset);
+      info->names = reinterpret_cast<const char*>(index + namesOffset);
+      info->length = PHYSFS_uint64(length);
+      info->entryCount = entryCount;
+      info->bucketCount = bucketCount;
+      info->childCount = childCount;
+      info->chunkCount = chunkCount;
+      info->namesSize = namesSize;
+      info->chunkSize = chunkSize;
+      info->flags = h32[9];
+
+      bool sane = __PHYSFS_fnv1a(__PHYSFS_FNV_BASIS, index, size_t(indexSize)) == h64[2]
+         and info->names[namesSize - 1] == '\0'
+         and PHYSFS_swapLE(info->fanout[bucketCount]) == entryCount;
+      for (PHYSFS_uint32 i = 0; sane and i < bucketCount; ++i)
+         sane = PHYSFS_swapLE(info->fanout[i]) <= PHYSFS_swapLE(info->fanout[i + 1]);
+      for (PHYSFS_uint32 i = 0; sane and i < childCount; ++i)
+         sane = PHYSFS_swapLE(info->children[i]) < entryCount;
+
+      if (not sane) {
+         MPK_closeArchive(info);
+         BAIL(PHYSFS_ERR_CORRUPT, nullptr);
+      }
+
+      info->io = io;
+      return info;
+   }
+
+   PHYSFS_EnumerateCallbackResult MPK_enumerate(
+      void* opaque, const char* dname, PHYSFS_EnumerateCallback cb,
+      const char* origdir, void* callbackdata
+   ) {
+      auto info = static_cast<MPKinfo*>(opaque);
+      const auto found = findEntry(info, dname);
+      BAIL_IF_ERRPASS(not found, PHYSFS_ENUM_ERROR);
+
+      const auto dir = swapEntry(*found);
+      BAIL_IF(not entryIsSane(info, dir), PHYSFS_ERR_CORRUPT, PHYSFS_ENUM_ERROR);
+      BAIL_IF(not (dir.flags & MPK_ENTRY_DIR), PHYSFS_ERR_NOT_A_FILE, PHYSFS_ENUM_ERROR);
+
+      auto retval = PHYSFS_ENUM_OK;
+      for (PHYSFS_uint32 i = 0; i < dir.childCount and retval == PHYSFS_ENUM_OK; ++i) {
+         const auto& kid = info->entries[PHYSFS_swapLE(info->children[dir.first + i])];
+         const auto name = PHYSFS_swapLE(kid.name);
+         BAIL_IF(name >= info->namesSize, PHYSFS_ERR_CORRUPT, PHYSFS_ENUM_ERROR);
+
+         const char* path = info->names + name;
+         const char* leaf = strrchr(path, '/');
+         retval = cb(callbackdata, origdir, leaf ? leaf + 1 : path);
+         BAIL_IF(retval == PHYSFS_ENUM_ERROR, PHYSFS_ERR_APP_CALLBACK, retval);
+      }
+
+      return retval;
+   }
+
+   PHYSFS_Io* MPK_openRead(void* opaque, const char* name) {
+      auto info = static_cast<MPKinfo*>(opaque);
+      const auto found = findEntry(info, name);
+      BAIL_IF_ERRPASS(not found, nullptr);
+
+      const auto e = swapEntry(*found);
+      BAIL_IF(e.flags & MPK_ENTRY_DIR, PHYSFS_ERR_NOT_A_FILE, nullptr);
+      BAIL_IF(not entryIsSane(info, e), PHYSFS_ERR_CORRUPT, nullptr);
+      return openEntry(info, e);
+   }
+
+   PHYSFS_Io* MPK_openWrite(void*, const char*) {
+      BAIL(PHYSFS_ERR_READ_ONLY, nullptr);
+   }
+
+   PHYSFS_Io* MPK_openAppend(void*, const char*) {
+      BAIL(PHYSFS_ERR_READ_ONLY, nullptr);
+   }
+
+   int MPK_remove(void*, const char*) {
+      BAIL(PHYSFS_ERR_READ_ONLY, 0);
+   }
+
+   int MPK_mkdir(void*, const char*) {
+      BAIL(PHYSFS_ERR_READ_ONLY, 0);
+   }
+
+   int MPK_stat(void* opaque, const char* name, PHYSFS_Stat* stat) {
+      auto info = static_cast<MPKinfo*>(opaque);
+      const auto found = findEntry(info, name);
+      BAIL_IF_ERRPASS(not found, 0);
+
+      const auto e = swapEntry(*found);
+      if (e.flags & MPK_ENTRY_DIR) {
+         stat->filetype = PHYSFS_FILETYPE_DIRECTORY;
+         stat->filesize = 0;
+      }
+      else {
+         stat->filetype = PHYSFS_FILETYPE_REGULAR;
+         stat->filesize = static_cast<PHYSFS_sint64>(e.size);
+      }
+
+      stat->modtime = e.mtime;
+      stat->createtime = e.mtime;
+      stat->accesstime = -1;
+      stat->readonly = 1;
+      return 1;
+   }
+
+   int MPK_statEx(void* opaque, const char* name, PHYSFS_StatEx* stat) {
+      BAIL_IF_ERRPASS(not MPK_stat(opaque, name, &stat->stat), 0);
+      if (stat->stat.filetype == PHYSFS_FILETYPE_DIRECTORY)
+         return 1;
+
+      // LZ4 chunks are packed back to back, so either way it's one run 
+      const auto e = swapEntry(*findEntry(static_cast<MPKinfo*>(opaque), name));
+      const bool lz4 = e.flags & MPK_ENTRY_LZ4;
+      stat->offset = static_cast<PHYSFS_sint64>(e.offset);
+      stat->storedSize = static_cast<PHYSFS_sint64>(e.storedSize);
+      stat->compression = lz4 ? PHYSFS_COMPRESSION_LZ4 : PHYSFS_COMPRESSION_NONE;
+      stat->contiguous = 1;
+      stat->mappable = not lz4;
+      return 1;
+   }
+}
+
+const PHYSFS_Archiver __PHYSFS_Archiver_MPK = {
+    CURRENT_PHYSFS_ARCHIVER_API_VERSION, {
+        "MPK",
+        "MetaPhysFS pack format",
+        "MetaPhysFS contributors",
+        "https://github.com/Epixu/metaphysfs",
+        0,  /* supportsSymlinks */
+    },
+    MPK_openArchive,
+    MPK_enumerate,
+    MPK_openRead,
+    MPK_openWrite,
+    MPK_openAppend,
+    MPK_remove,
+    MPK_mkdir,
+    MPK_stat,
+    MPK_closeArchive,
+    MPK_statEx,
+    1  /* concurrentOpenRead: the index never changes after mount */
+};
+
+
+namespace
+{
+   /// Encode one LZ4 block from (src) into at most (cap) bytes of (dst).     
+   /// Greedy, with a single hash table of recent positions - packs are built 
+   /// once and read many times, and decoding speed doesn't care how hard     
+   /// the encoder tried. Returns the encoded size, or zero if it won't fit   
+   size_t lz4Encode(const PHYSFS_uint8* src, size_t n, PHYSFS_uint8* dst, size_t cap, PHYSFS_uint32* table) {
+      constexpr int HashLog = 14;
+      constexpr PHYSFS_uint32 None = 0xFFFFFFFF;
+      const auto dstEnd = dst + cap;
+      auto op = dst;
+      size_t anchor = 0;
+
+      const auto read32 = [src](size_t at) {
+         PHYSFS_uint32 v;
+         memcpy(&v, src + at, sizeof(v));
+         return v;
+      };
+
+      // A length field, the part of it that doesn't fit in the token   
+      const auto putLength = [&op](size_t len) {
+         for (; len >= 255; len -= 255)
+            *op++ = 255;
+         *op++ = static_cast<PHYSFS_uint8>(len);
+      };
+
+      // Emit the literals since (anchor), followed by a match, or by   
+      // nothing at all for the last sequence                           
+      const auto emit = [&](size_t literals, size_t offset, size_t match) {
+         size_t need = 1 + literals + (literals >= 15 ? 1 + (literals - 15) / 255 : 0);
+         if (match)
+            need += 2 + (match - 4 >= 15 ? 1 + (match - 19) / 255 : 0);
+         if (need > size_t(dstEnd - op))
+            return false;
+
+         auto token = op++;
+         *token = static_cast<PHYSFS_uint8>(std::min<size_t>(literals, 15) << 4);
+         if (literals >= 15)
+            putLength(literals - 15);
+         memcpy(op, src + anchor, literals);
+         op += literals;
+
+         if (match) {
+            *op++ = static_cast<PHYSFS_uint8>(offset);
+            *op++ = static_cast<PHYSFS_uint8>(offset >> 8);
+            *token |= static_cast<PHYSFS_uint8>(std::min<size_t>(match - 4, 15));
+            if (match - 4 >= 15)
+               putLength(match - 19);
+         }
+         return true;
+      };
+
+      // The format wants the last 5 bytes as literals, and no match to 
+      // start in the last 12                                           
+      if (n >= 13) {
+         for (size_t i = 0; i < (size_t(1) << HashLog); ++i)
+            table[i] = None;
+
+         size_t i = 0;
+         while (i < n - 12) {
+            const auto seq = read32(i);
+            const auto h = (seq * 2654435761u) >> (32 - HashLog);
+            const auto ref = table[h];
+            table[h] = static_cast<PHYSFS_uint32>(i);
+            if (ref == None or i - ref > 65535 or read32(ref) != seq) {
+               ++i;
+               continue;
+            }
+
+            size_t len = 4;
+            const auto maxLen = n - 5 - i;
+            while (len < maxLen and src[ref + len] == src[i + len])
+               ++len;
+
+            if (not emit(i - anchor, i - ref, len))
+               return 0;
+            i += len;
+            anchor = i;
+         }
+      }
+
+      if (not emit(n - anchor, 0, 0))
+         return 0;
+      return size_t(op - dst);
+   }
+
+   /// A growable array of plain data for the writer                          
+   template<class T>
+   struct PackList {
+      T* data = nullptr;
+      PHYSFS_uint32 count = 0;
+      PHYSFS_uint32 capacity = 0;
+
+      PackList() = default;
+      PackList(const PackList&) = delete;
+      ~PackList() { allocator.Free(data); }
+
+      T* Grow(PHYSFS_uint32 n) {
+         if (n > capacity - count) {
+            BAIL_IF(n > 0x7FFFFFFF - count, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+            auto wanted = std::max<PHYSFS_uint32>(capacity * 2, 64);
+            wanted = std::max(wanted, count + n);
+            auto ptr = static_cast<T*>(allocator.Realloc(data, PHYSFS_uint64(wanted) * sizeof(T)));
+            BAIL_IF(not ptr, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+            data = ptr;
+            capacity = wanted;
+         }
+
+         auto retval = data + count;
+         count += n;
+         return retval;
+      }
+   };
+
+   /// Everything a pack is built from, released however the build ends       
+   struct PackWriter {
+      const char* source;
+      PHYSFS_uint32 alignment;
+      PHYSFS_uint32 chunkSize;
+      bool compress;
+      bool verify;
+
+      // Entries, in the order the walk found them: breadth first, so the
+      // children of a directory are always next to each other          
+      PackList<MPKentry> entries;
+      PackList<char> names;
+      PackList<PHYSFS_uint64> chunks;
+
+      PHYSFS_File* out = nullptr;
+      PHYSFS_File* in = nullptr;
+      PHYSFS_File* other = nullptr;
+      PHYSFS_Dir* dir = nullptr;
+      char* path = nullptr;
+      PHYSFS_uint8* buffer = nullptr;
+      PHYSFS_uint8* packed = nullptr;
+      PHYSFS_uint32* table = nullptr;
+      PHYSFS_uint32* dedup = nullptr;
+      PHYSFS_uint32* order = nullptr;
+      PHYSFS_uint8* index = nullptr;
+      PHYSFS_uint64 pos = 0;
+
+      ~PackWriter() {
+         if (in)
+            PHYSFS_close(in);
+         if (other)
+            PHYSFS_close(other);
+         if (out)
+            PHYSFS_close(out);
+         PHYSFS_closeDir(dir);
+         allocator.Free(path);
+         allocator.Free(buffer);
+         allocator.Free(packed);
+         allocator.Free(table);
+         allocator.Free(dedup);
+         allocator.Free(order);
+         allocator.Free(index);
+      }
+
+      /// Make (path) the search path name of an entry                        
+      bool SetPath(const char* name) {
+         const auto sourceLen = strlen(source);
+         const auto nameLen = strlen(name);
+         allocator.Free(path);
+         path = static_cast<char*>(allocator.Malloc(sourceLen + nameLen + 2));
+         BAIL_IF(not path, PHYSFS_ERR_OUT_OF_MEMORY, false);
+
+         memcpy(path, source, sourceLen);
+         auto at = path + sourceLen;
+         if (sourceLen and nameLen)
+            *at++ = '/';
+         memcpy(at, name, nameLen + 1);
+         return true;
+      }
+
+      /// Walk (source), collecting every directory and regular file          
+      bool Collect() {
+         auto root = entries.Grow(1);
+         BAIL_IF_ERRPASS(not root or not names.Grow(1), false);
+         memset(root, 0, sizeof(MPKentry));
+         root->flags = MPK_ENTRY_DIR;
+         root->mtime = -1;
+         names.data[0] = '\0';
+
+         for (PHYSFS_uint32 i = 0; i < entries.count; ++i) {
+            if (not (entries.data[i].flags & MPK_ENTRY_DIR))
+               continue;
+
+            BAIL_IF_ERRPASS(not SetPath(names.data + entries.data[i].name), false);
+            dir = PHYSFS_openDir(path);
+            BAIL_IF_ERRPASS(not dir, false);
+
+            entries.data[i].first = entries.count - 1;
+            const char* batch[64];
+            PHYSFS_sint64 got;
+            while ((got = PHYSFS_readDir(dir, batch, __PHYSFS_ARRAYLEN(batch))) > 0) {
+               for (PHYSFS_sint64 k = 0; k < got; ++k) {
+                  // Build the name first, stat what it points to after 
+                  const auto parentLen = strlen(names.data + entries.data[i].name);
+                  const auto leafLen = strlen(batch[k]);
+                  const auto len = parentLen + (parentLen ? 1 : 0) + leafLen + 1;
+                  BAIL_IF(len > 0x7FFFFFFF, PHYSFS_ERR_BAD_FILENAME, false);
+
+                  const auto nameOffset = names.count;
+                  BAIL_IF_ERRPASS(not names.Grow(static_cast<PHYSFS_uint32>(len)), false);
+                  auto at = names.data + nameOffset;
+                  memcpy(at, names.data + entries.data[i].name, parentLen);
+                  at += parentLen;
+                  if (parentLen)
+                     *at++ = '/';
+                  memcpy(at, batch[k], leafLen + 1);
+
+                  PHYSFS_Stat stat;
+                  BAIL_IF_ERRPASS(not SetPath(names.data + nameOffset), false);
+                  BAIL_IF_ERRPASS(not PHYSFS_stat(path, &stat), false);
+                  if (stat.filetype != PHYSFS_FILETYPE_REGULAR
+                  and stat.filetype != PHYSFS_FILETYPE_DIRECTORY) {
+                     names.count = nameOffset;
+                     continue;  // Symlinks and the like don't pack
+                  }
+
+                  auto e = entries.Grow(1);
+                  BAIL_IF_ERRPASS(not e, false);
+                  memset(e, 0, sizeof(MPKentry));
+                  e->name = nameOffset;
+                  e->mtime = stat.modtime;
+                  if (stat.filetype == PHYSFS_FILETYPE_DIRECTORY)
+                     e->flags = MPK_ENTRY_DIR;
+                  ++entries.data[i].childCount;
+               }
+            }
+            BAIL_IF_ERRPASS(got < 0, false);
+
+            PHYSFS_closeDir(dir);
+            dir = nullptr;
+            if (not entries.data[i].childCount)
+               entries.data[i].first = 0;
+         }
+
+         BAIL_IF(entries.count > 0x7FFFFFFF / 4, PHYSFS_ERR_OUT_OF_MEMORY, false);
+         return true;
+      }
+
+      bool Write(const void* data, PHYSFS_uint64 len) {
+         BAIL_IF_ERRPASS(PHYSFS_writeBytes(out, data, len) != PHYSFS_sint64(len), false);
+         pos += len;
+         return true;
+      }
+
+      bool Pad(PHYSFS_uint64 to) {
+         static const PHYSFS_uint8 zeroes[512] = {};
+         const auto target = (pos + to - 1) & ~(to - 1);
+         while (pos < target) {
+            if (not Write(zeroes, std::min<PHYSFS_uint64>(target - pos, sizeof(zeroes))))
+               return false;
+         }
+         return true;
+      }
+
+      PHYSFS_sint64 Read(PHYSFS_File* file, PHYSFS_uint8* into) {
+         PHYSFS_uint64 got = 0;
+         while (got < chunkSize) {
+            const auto rc = PHYSFS_readBytes(file, into + got, chunkSize - got);
+            BAIL_IF_ERRPASS(rc < 0, -1);
+            if (rc == 0)
+               break;
+            got += rc;
+         }
+         return static_cast<PHYSFS_sint64>(got);
+      }
+
+      /// Hash a source file, which gives its size too                        
+      bool Hash(MPKentry& e) {
+         BAIL_IF_ERRPASS(not SetPath(names.data + e.name), false);
+         in = PHYSFS_openRead(path);
+         BAIL_IF_ERRPASS(not in, false);
+
+         e.contentHash = __PHYSFS_FNV_BASIS;
+         PHYSFS_sint64 got;
+         while ((got = Read(in, buffer)) > 0) {
+            e.contentHash = __PHYSFS_fnv1a(e.contentHash, buffer, size_t(got));
+            e.size += got;
+         }
+         BAIL_IF_ERRPASS(got < 0, false);
+         return true;
+      }
+
+      /// Is (e) the same as (prior), byte for byte? (in) is (e), rewound     
+      bool Same(const MPKentry& e, const MPKentry& prior) {
+         if (e.size != prior.size or e.contentHash != prior.contentHash)
+            return false;
+
+         BAIL_IF_ERRPASS(not SetPath(names.data + prior.name), false);
+         other = PHYSFS_openRead(path);
+         BAIL_IF_ERRPASS(not other, false);
+
+         bool same = true;
+         while (same) {
+            const auto a = Read(in, buffer);
+            const auto b = Read(other, packed);
+            BAIL_IF_ERRPASS(a < 0 or b < 0, false);
+            same = a == b and memcmp(buffer, packed, size_t(a)) == 0;
+            if (a == 0)
+               break;
+         }
+
+         PHYSFS_close(other);
+         other = nullptr;
+         BAIL_IF_ERRPASS(not PHYSFS_seek(in, 0), false);
+         return same;
+      }
+
+      /// Write (e) out, from (in) rewound                                    
+      bool Store(MPKentry& e) {
+         if (e.size)
+            BAIL_IF_ERRPASS(not Pad(alignment), false);
+         e.offset = pos;
+
+         if (not compress or not e.size) {
+            PHYSFS_sint64 got;
+            while ((got = Read(in, buffer)) > 0)
+               BAIL_IF_ERRPASS(not Write(buffer, PHYSFS_uint64(got)), false);
+            BAIL_IF_ERRPASS(got < 0, false);
+            e.storedSize = pos - e.offset;
+            return true;
+         }
+
+         // Chunks that don't shrink are stored as they are, so if none 
+         // did, the data is byte for byte what a stored entry would be 
+         e.first = chunks.count;
+         bool shrunk = false;
+         for (PHYSFS_uint64 done = 0; done < e.size; ) {
+            auto start = chunks.Grow(1);
+            BAIL_IF_ERRPASS(not start, false);
+            *start = pos - e.offset;
+
+            const auto got = Read(in, buffer);
+            BAIL_IF_ERRPASS(got < 0, false);
+            BAIL_IF(got == 0, PHYSFS_ERR_IO, false);  // It shrank under us
+            const auto size = size_t(got);
+            const auto encoded = lz4Encode(buffer, size, packed, size - 1, table);
+            if (encoded) {
+               BAIL_IF_ERRPASS(not Write(packed, encoded), false);
+               shrunk = true;
+            }
+            else BAIL_IF_ERRPASS(not Write(buffer, size), false);
+            done += size;
+         }
+
+         e.storedSize = pos - e.offset;
+         if (not shrunk) {
+            chunks.count = e.first;
+            e.first = 0;
+            return true;
+         }
+
+         auto end = chunks.Grow(1);
+         BAIL_IF_ERRPASS(not end, false);
+         *end = e.storedSize;
+         e.flags |= MPK_ENTRY_LZ4;
+         return true;
+      }
+
+      /// Write out every file's data, each distinct content once             
+      bool Pack() {
+         const auto dedupSize = std::bit_ceil(entries.count * 2);
+         buffer = static_cast<PHYSFS_uint8*>(allocator.Malloc(chunkSize));
+         packed = static_cast<PHYSFS_uint8*>(allocator.Malloc(chunkSize));
+         table = static_cast<PHYSFS_uint32*>(allocator.Malloc((1 << 14) * sizeof(PHYSFS_uint32)));
+         dedup = static_cast<PHYSFS_uint32*>(allocator.Malloc(PHYSFS_uint64(dedupSize) * sizeof(PHYSFS_uint32)));
+         BAIL_IF(not buffer or not packed or not table or not dedup, PHYSFS_ERR_OUT_OF_MEMORY, false);
+         memset(dedup, 0, dedupSize * sizeof(PHYSFS_uint32));
+
+         for (PHYSFS_uint32 i = 0; i < entries.count; ++i) {
+            auto& e = entries.data[i];
+            if (e.flags & MPK_ENTRY_DIR)
+               continue;
+
+            BAIL_IF_ERRPASS(not Hash(e) or not PHYSFS_seek(in, 0), false);
+
+            // Slots hold entry index + 1, zero is empty                
+            bool shared = false;
+            auto slot = static_cast<PHYSFS_uint32>(e.contentHash & (dedupSize - 1));
+            for (; e.size and dedup[slot]; slot = (slot + 1) & (dedupSize - 1)) {
+               const auto& prior = entries.data[dedup[slot] - 1];
+               if (not Same(e, prior))
+                  continue;
+
+               e.offset = prior.offset;
+               e.storedSize = prior.storedSize;
+               e.flags = prior.flags;
+               e.first = prior.first;
+               shared = true;
+               break;
+            }
+
+            if (not shared) {
+               BAIL_IF_ERRPASS(not Store(e), false);
+               if (e.size)
+                  dedup[slot] = i + 1;
+            }
+
+            PHYSFS_close(in);
+            in = nullptr;
+         }
+         return true;
+      }
+
+      /// Lay the index out, sorted for lookups, and write it and the header  
+      bool Finish() {
+         const auto count = entries.count;
+         const auto bucketCount = std::bit_ceil(count);
+         const auto childCount = count - 1;
+         for (PHYSFS_uint32 i = 0; i < count; ++i)
+            entries.data[i].nameHash = hashName(names.data + entries.data[i].name);
+
+         // (order) lists entries by their place in the index, and the  
+         // second half of it maps walk order back to that place        
+         order = static_cast<PHYSFS_uint32*>(allocator.Malloc(PHYSFS_uint64(count) * 2 * sizeof(PHYSFS_uint32)));
+         BAIL_IF(not order, PHYSFS_ERR_OUT_OF_MEMORY, false);
+         for (PHYSFS_uint32 i = 0; i < count; ++i)
+            order[i] = i;
+
+         const auto data = entries.data;
+         const auto mask = bucketCount - 1;
+         std::sort(order, order + count, [data, mask](PHYSFS_uint32 a, PHYSFS_uint32 b) {
+            const auto ba = data[a].nameHash & mask;
+            const auto bb = data[b].nameHash & mask;
+            if (ba != bb)
+               return ba < bb;
+            return data[a].nameHash < data[b].nameHash;
+         });
+
+         auto placeOf = order + count;
+         for (PHYSFS_uint32 i = 0; i < count; ++i)
+            placeOf[order[i]] = i;
+
+         const auto entriesAt = (PHYSFS_uint64(bucketCount) + 1 + childCount) * 4;
+         const auto entriesOffset = (entriesAt + 7) & ~PHYSFS_uint64(7);
+         const auto chunksOffset = entriesOffset + PHYSFS_uint64(count) * MPK_ENTRY_SIZE;
+         const auto namesOffset = chunksOffset + PHYSFS_uint64(chunks.count) * 8;
+         const auto indexSize = namesOffset + names.count;
+         index = static_cast<PHYSFS_uint8*>(allocator.Malloc(indexSize));
+         BAIL_IF(not index, PHYSFS_ERR_OUT_OF_MEMORY, false);
+         memset(index, 0, size_t(indexSize));
+
+         auto fanout = reinterpret_cast<PHYSFS_uint32*>(index);
+         for (PHYSFS_uint32 i = 0; i < count; ++i)
+            ++fanout[(data[i].nameHash & mask) + 1];
+         for (PHYSFS_uint32 b = 0; b < bucketCount; ++b)
+            fanout[b + 1] += fanout[b];
+         for (PHYSFS_uint32 b = 0; b <= bucketCount; ++b)
+            fanout[b] = PHYSFS_swapLE(fanout[b]);
+
+         // Every entry but the root is somebody's child, and the walk put
+         // them in the child table's order already                     
+         auto children = fanout + bucketCount + 1;
+         for (PHYSFS_uint32 i = 1; i < count; ++i)
+            children[i - 1] = PHYSFS_swapLE(placeOf[i]);
+
+         auto out = reinterpret_cast<MPKentry*>(index + entriesOffset);
+         for (PHYSFS_uint32 i = 0; i < count; ++i)
+            out[i] = swapEntry(data[order[i]]);
+
+         auto chunkTable = reinterpret_cast<PHYSFS_uint64*>(index + chunksOffset);
+         for (PHYSFS_uint32 i = 0; i < chunks.count; ++i)
+            chunkTable[i] = PHYSFS_swapLE(chunks.data[i]);
+         memcpy(index + namesOffset, names.data, names.count);
+
+         BAIL_IF_ERRPASS(not Pad(8), false);
+         const auto indexOffset = pos;
+         BAIL_IF_ERRPASS(not Write(index, indexSize), false);
+
+         PHYSFS_uint32 h32[10] = {
+            MPK_SIG, MPK_VERSION, alignment, chunkSize, count, bucketCount,
+            chunks.count, childCount, names.count, verify ? MPK_PACK_VERIFY : 0
+         };
+         PHYSFS_uint64 h64[3] = {
+            indexOffset, indexSize, __PHYSFS_fnv1a(__PHYSFS_FNV_BASIS, index, size_t(indexSize))
+         };
+         for (auto& v : h32)
+            v = PHYSFS_swapLE(v);
+         for (auto& v : h64)
+            v = PHYSFS_swapLE(v);
+
+         BAIL_IF_ERRPASS(not PHYSFS_seek(this->out, 0), false);
+         BAIL_IF_ERRPASS(not Write(h32, sizeof(h32)) or not Write(h64, sizeof(h64)), false);
+         return true;
+      }
+   };
+}
+
+/// The header goes in last, once the index offset is known: until then the   
+/// file has no signature and won't mount as anything. A pack that fails      
+/// part way is deleted again                                                 
+int PHYSFS_writePack(const char* dir, const char* filename, const PHYSFS_PackOptions* opts) {
+   BAIL_IF(not dir or not filename, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+   PackWriter w;
+   while (*dir == '/')
+      ++dir;
+   w.source = dir;
+   w.alignment = opts and opts->alignment ? opts->alignment : 4096;
+   w.chunkSize = opts and opts->chunkSize ? opts->chunkSize : 64 * 1024;
+   w.compress = opts and opts->compress;
+   w.verify = opts and opts->verify;
+   BAIL_IF(not std::has_single_bit(w.alignment) or w.alignment > MPK_MAX_CHUNK, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(w.chunkSize < 1024 or w.chunkSize > MPK_MAX_CHUNK, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+   BAIL_IF_ERRPASS(not w.Collect(), 0);
+
+   // The walk is over before the output exists, so a pack written into 
+   // the tree it's made from doesn't end up inside itself              
+   w.out = PHYSFS_openWrite(filename);
+   BAIL_IF_ERRPASS(not w.out, 0);
+
+   const auto discard = [&w, filename] {
+      try {
+         if (w.out)
+            PHYSFS_close(w.out);
+         w.out = nullptr;
+         PHYSFS_delete(filename);
+      }
+      catch (...) {}
+   };
+
+   int rc = 0;
+   try {
+      const PHYSFS_uint8 blank[MPK_HEADER_SIZE] = {};
+      if (w.Write(blank, sizeof(blank)) and w.Pack() and w.Finish()) {
+         rc = PHYSFS_close(w.out);
+         if (rc)
+            w.out = nullptr;
+      }
+   }
+   catch (...) {
+      discard();
+      throw;
+   }
+
+   if (not rc)
+      discard();
+   return rc;
+}
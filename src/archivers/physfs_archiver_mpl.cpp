@@ -0,0 +1,1763 @@
+///                                                                           
+/// MPL support routines for PhysicsFS.                                       
+///                                                                           
+///  MPL is a writable pack: a log that every change is appended to, meant to 
+///  be the write dir when a game writes lots of small files. Writing a file  
+///  appends one record to one open file, instead of creating, writing and    
+///  closing a file of its own, and reading it back reads a slice of that     
+///  same file. The current state of the pack lives in memory, rebuilt from   
+///  the log when it's opened.                                                
+///                                                                           
+///  To keep opening fast, the whole index is written to the log every now    
+///  and then as a checkpoint, and the header points at the latest one; only  
+///  the records after it have to be replayed. Once enough of the log is      
+///  dead (overwritten or removed files), it's compacted on a helper thread:  
+///  the live files are copied into a new log, which then replaces the old    
+///  one with an atomic rename.                                               
+///                                                                           
+///  A crash can cut the last record short, but never corrupts anything       
+///  before it: every record carries a hash, and replay stops at the first    
+///  one that doesn't check out. Records are synced to disk at checkpoints,   
+///  and when the pack is closed.                                             
+///                                                                           
+///  ======================================================================== 
+///                                                                           
+///  All integers are little endian.                                          
+///                                                                           
+///  Header (32 bytes)                                                        
+///   (4 bytes)  signature = 'MPL1'                                           
+///   (4 bytes)  version = 1                                                  
+///   (8 bytes)  salt, random for each log                                    
+///   (8 bytes)  offset of the latest checkpoint record, or zero              
+///   (8 bytes)  FNV-1a hash of the salt and that offset                      
+///                                                                           
+///  Records, one after the other                                             
+///   (4 bytes)  type (1 = put, 2 = extend, 3 = remove, 4 = mkdir,            
+///              5 = checkpoint)                                              
+///   (4 bytes)  path length                                                  
+///   (8 bytes)  data length                                                  
+///   (8 bytes)  modification time                                            
+///   (8 bytes)  FNV-1a hash of the salt, the record's offset, the fields     
+///              above, the path and the data                                 
+///   (varies)   path, without a leading '/' or a \0                          
+///   (varies)   data                                                         
+///                                                                           
+///  A put replaces a file's contents with its data, an extend appends its    
+///  data to them. The data of a checkpoint is the index: for each entry in   
+///  creation order, so parents come before their children                    
+///   (4 bytes)  1 = file, 2 = directory                                      
+///   (4 bytes)  path length                                                  
+///   (8 bytes)  modification time                                            
+///   (4 bytes)  extent count                                                 
+///   (varies)   path                                                         
+///   (16 bytes each) extents: offset of the data in the log, and its size    
+///                                                                           
+///  ======================================================================== 
+///                                                                           
+/// Please see the file LICENSE.txt in the source's root directory.           
+///                                                                           
+#include "../physfs_internal.hpp"
+#include <algorithm>
+#include <ctime>
+
+#ifndef PHYSFS_NO_THREADS
+   #include <atomic>
+   #include <mutex>
+#endif
+
+
+constexpr PHYSFS_uint32 MPL_SIG = 0x314C504D;  // "MPL1" in ASCII
+constexpr PHYSFS_uint32 MPL_VERSION = 1;
+constexpr PHYSFS_uint32 MPL_HEADER_SIZE = 32;
+constexpr PHYSFS_uint32 MPL_RECORD_SIZE = 32;
+constexpr PHYSFS_uint32 MPL_MAX_PATH = 64 * 1024;
+constexpr PHYSFS_uint32 MPL_NONE = 0xFFFFFFFF;
+constexpr PHYSFS_uint32 MPL_TOMBSTONE = 0xFFFFFFFF;
+
+/// File data is buffered up to this much, then appended as one record        
+constexpr size_t MPL_WRITE_BUFFER = 64 * 1024;
+
+/// A checkpoint is written after this many records, or this many bytes       
+constexpr PHYSFS_uint32 MPL_CHECKPOINT_RECORDS = 4096;
+constexpr PHYSFS_uint64 MPL_CHECKPOINT_BYTES = 16 * 1024 * 1024;
+
+/// Compaction starts once dead data outweighs live data, and is at least     
+constexpr PHYSFS_uint64 MPL_COMPACT_MIN = 4 * 1024 * 1024;
+
+enum MPLrecordType : PHYSFS_uint32 {
+   MPL_PUT = 1,
+   MPL_EXTEND,
+   MPL_REMOVE,
+   MPL_MKDIR,
+   MPL_CHECKPOINT
+};
+
+/// A record's header, as it is in the file                                   
+struct MPLrecord {
+   PHYSFS_uint32 type;
+   PHYSFS_uint32 pathLen;
+   PHYSFS_uint64 dataLen;
+   PHYSFS_sint64 mtime;
+   PHYSFS_uint64 hash;
+};
+static_assert(sizeof(MPLrecord) == MPL_RECORD_SIZE);
+
+/// A run of a file's data in the log                                         
+struct MPLextent {
+   PHYSFS_uint64 offset;
+   PHYSFS_uint64 size;
+};
+
+struct MPLnode {
+   char* path;                         // Full path, "" for the root
+   MPLextent* extents;
+   PHYSFS_uint32 extentCount;
+   PHYSFS_uint32 extentCapacity;
+   PHYSFS_uint64 size;
+   PHYSFS_sint64 mtime;
+   PHYSFS_uint32 parent;
+   PHYSFS_uint32 firstChild;           // Children are linked both ways,
+   PHYSFS_uint32 nextSibling;          // so removing one is O(1)
+   PHYSFS_uint32 prevSibling;
+   bool isdir;
+   bool live;
+};
+
+/// The state of the pack. Nodes are never reused, so a node's parent         
+/// always comes before it                                                    
+struct MPLindex {
+   MPLnode* nodes;
+   PHYSFS_uint32 count;
+   PHYSFS_uint32 capacity;
+   PHYSFS_uint32* slots;               // Node + 1 by path hash, 0 is empty
+   PHYSFS_uint32 slotCount;
+   PHYSFS_uint32 slotsUsed;            // Tombstones included
+   PHYSFS_uint64 liveBytes;
+   PHYSFS_uint64 deadBytes;
+};
+
+/// One per log, however many times it's mounted                              
+struct MPLinfo {
+   char* path;                         // Of the log, platform-dependent
+   PHYSFS_Io* readIo;
+   PHYSFS_Io* appendIo;                // Only while it's the write dir
+   void* mutex;
+   MPLinfo* next;                      // In the list of open logs
+   PHYSFS_uint32 refs;
+   MPLindex index;
+   PHYSFS_uint64 salt;
+   PHYSFS_uint64 end;                  // Where the next record goes
+   PHYSFS_uint32 recordsSinceCheckpoint;
+   PHYSFS_uint64 bytesSinceCheckpoint;
+   bool compacting;
+
+#ifndef PHYSFS_NO_THREADS
+   void* compactor;                    // Platform thread, till joined
+   std::atomic<bool> stop;
+#endif
+};
+
+/// What the archiver hands out: a mount of a log, or the write dir           
+struct MPLhandle {
+   MPLinfo* log;
+   bool writer;
+};
+
+/// The log file as a reader found it. Shared by the reader and its           
+/// duplicates, which go on reading that same file after compaction puts      
+/// a new one in its place                                                    
+struct MPLsource {
+   PHYSFS_Io* io;                      // Duplicate of the log's read io
+   void* mutex;                        // Around seek and read, if no readAt
+   PHYSFS_uint64 ioPos;                // Where (io) is, to skip seeks
+   int refs;
+};
+
+struct MPLreadinfo {
+   MPLsource* source;
+   MPLextent* extents;                 // Copied when the file was opened
+   PHYSFS_uint32 extentCount;
+   PHYSFS_uint32 extent;               // Holding (pos), or extentCount
+   PHYSFS_uint64 extentStart;          // File position (extent) starts at
+   PHYSFS_uint64 size;
+   PHYSFS_uint64 pos;
+};
+
+struct MPLwriteinfo {
+   MPLinfo* arc;
+   char* path;
+   PHYSFS_uint8* buffer;
+   size_t fill;
+   PHYSFS_uint64 size;
+   bool started;                       // Put already appended
+   bool appending;
+};
+
+namespace
+{
+   PHYSFS_uint64 hashPath(const char* path, size_t len) {
+      return __PHYSFS_fnv1a(__PHYSFS_FNV_BASIS, path, len);
+   }
+
+   /// The hash in the header, guarding the checkpoint offset                 
+   PHYSFS_uint64 headerCheck(PHYSFS_uint64 salt, PHYSFS_uint64 checkpoint) {
+      const PHYSFS_uint64 fields[2] = {PHYSFS_swapLE(salt), PHYSFS_swapLE(checkpoint)};
+      return __PHYSFS_fnv1a(__PHYSFS_FNV_BASIS, fields, sizeof(fields));
+   }
+
+   /// Start a record's hash: everything but the path and data. (rec) is      
+   /// in file byte order, with the hash field ignored                        
+   PHYSFS_uint64 recordHash(PHYSFS_uint64 salt, PHYSFS_uint64 offset, const MPLrecord& rec) {
+      const PHYSFS_uint64 where[2] = {PHYSFS_swapLE(salt), PHYSFS_swapLE(offset)};
+      auto hash = __PHYSFS_fnv1a(__PHYSFS_FNV_BASIS, where, sizeof(where));
+      return __PHYSFS_fnv1a(hash, &rec, offsetof(MPLrecord, hash));
+   }
+
+   MPLrecord makeRecord(PHYSFS_uint32 type, size_t pathLen, PHYSFS_uint64 dataLen, PHYSFS_sint64 mtime) {
+      MPLrecord rec;
+      rec.type = PHYSFS_swapLE(type);
+      rec.pathLen = PHYSFS_swapLE(static_cast<PHYSFS_uint32>(pathLen));
+      rec.dataLen = PHYSFS_swapLE(dataLen);
+      rec.mtime = PHYSFS_swapLE(mtime);
+      rec.hash = 0;
+      return rec;
+   }
+
+   /// A fresh salt for a new log. It only has to differ between logs, so     
+   /// a record copied into another one can't pass for one of its own         
+   PHYSFS_uint64 makeSalt(const void* seed) {
+      const auto now = static_cast<PHYSFS_sint64>(time(nullptr));
+      const auto address = reinterpret_cast<uintptr_t>(seed);
+      auto hash = __PHYSFS_fnv1a(__PHYSFS_FNV_BASIS, &now, sizeof(now));
+      return __PHYSFS_fnv1a(hash, &address, sizeof(address));
+   }
+
+   PHYSFS_sint64 now() {
+      return static_cast<PHYSFS_sint64>(time(nullptr));
+   }
+
+
+   ///                                                                        
+   /// The index                                                              
+   ///                                                                        
+
+   void indexDeinit(MPLindex& index) {
+      for (PHYSFS_uint32 i = 0; i < index.count; ++i) {
+         allocator.Free(index.nodes[i].path);
+         allocator.Free(index.nodes[i].extents);
+      }
+      allocator.Free(index.nodes);
+      allocator.Free(index.slots);
+      memset(&index, 0, sizeof(MPLindex));
+   }
+
+   /// Find a live node by path, without complaining if there's none          
+   PHYSFS_uint32 indexFind(const MPLindex& index, const char* path, size_t len) {
+      const auto mask = index.slotCount - 1;
+      for (auto slot = static_cast<PHYSFS_uint32>(hashPath(path, len)) & mask; index.slots[slot]; slot = (slot + 1) & mask) {
+         const auto id = index.slots[slot];
+         if (id == MPL_TOMBSTONE)
+            continue;
+
+         const auto& node = index.nodes[id - 1];
+         if (strncmp(node.path, path, len) == 0 and node.path[len] == '\0')
+            return id - 1;
+      }
+      return MPL_NONE;
+   }
+
+   PHYSFS_uint32 indexFind(const MPLindex& index, const char* path) {
+      return indexFind(index, path, strlen(path));
+   }
+
+   /// Rebuild the hash table at (slotCount) slots, dropping tombstones       
+   bool indexRehash(MPLindex& index, PHYSFS_uint32 slotCount) {
+      auto slots = static_cast<PHYSFS_uint32*>(allocator.Malloc(PHYSFS_uint64(slotCount) * sizeof(PHYSFS_uint32), PHYSFS_ALLOC_DIRTREE));
+      BAIL_IF(not slots, PHYSFS_ERR_OUT_OF_MEMORY, false);
+      memset(slots, 0, slotCount * sizeof(PHYSFS_uint32));
+
+      PHYSFS_uint32 used = 0;
+      const auto mask = slotCount - 1;
+      for (PHYSFS_uint32 i = 0; i < index.count; ++i) {
+         const auto& node = index.nodes[i];
+         if (not node.live)
+            continue;
+
+         auto slot = static_cast<PHYSFS_uint32>(hashPath(node.path, strlen(node.path))) & mask;
+         while (slots[slot])
+            slot = (slot + 1) & mask;
+         slots[slot] = i + 1;
+         ++used;
+      }
+
+      allocator.Free(index.slots);
+      index.slots = slots;
+      index.slotCount = slotCount;
+      index.slotsUsed = used;
+      return true;
+   }
+
+   bool indexInit(MPLindex& index) {
+      memset(&index, 0, sizeof(MPLindex));
+      index.nodes = static_cast<MPLnode*>(allocator.Malloc(64 * sizeof(MPLnode), PHYSFS_ALLOC_DIRTREE));
+      BAIL_IF(not index.nodes, PHYSFS_ERR_OUT_OF_MEMORY, false);
+      index.capacity = 64;
+
+      auto& root = index.nodes[0];
+      memset(&root, 0, sizeof(MPLnode));
+      root.path = static_cast<char*>(allocator.Malloc(1, PHYSFS_ALLOC_DIRTREE));
+      if (not root.path) {
+         indexDeinit(index);
+         BAIL(PHYSFS_ERR_OUT_OF_MEMORY, false);
+      }
+
+      root.path[0] = '\0';
+      root.mtime = -1;
+      root.parent = root.firstChild = root.nextSibling = root.prevSibling = MPL_NONE;
+      root.isdir = true;
+      root.live = true;
+      index.count = 1;
+
+      if (not indexRehash(index, 64)) {
+         indexDeinit(index);
+         return false;
+      }
+      return true;
+   }
+
+   /// Where (path) would go: its parent, which has to be a directory         
+   PHYSFS_uint32 indexParentOf(const MPLindex& index, const char* path, size_t len) {
+      size_t cut = len;
+      while (cut and path[cut - 1] != '/')
+         --cut;
+      if (cut == 0)
+         return 0;
+
+      const auto parent = indexFind(index, path, cut - 1);
+      if (parent == MPL_NONE or not index.nodes[parent].isdir)
+         return MPL_NONE;
+      return parent;
+   }
+
+   /// Add a node, which mustn't exist yet, under an existing directory       
+   PHYSFS_uint32 indexAdd(MPLindex& index, const char* path, size_t len, bool isdir, PHYSFS_sint64 mtime) {
+      const auto parent = indexParentOf(index, path, len);
+      BAIL_IF(parent == MPL_NONE, PHYSFS_ERR_NOT_FOUND, MPL_NONE);
+      BAIL_IF(index.count == MPL_NONE - 1, PHYSFS_ERR_OUT_OF_MEMORY, MPL_NONE);
+
+      if ((index.slotsUsed + 1) * 4 > index.slotCount * 3) {
+         // Grow, unless it's mostly tombstones that just need sweeping 
+         const auto wanted = (index.count + 1) * 2 > index.slotCount ? index.slotCount * 2 : index.slotCount;
+         BAIL_IF_ERRPASS(not indexRehash(index, wanted), MPL_NONE);
+      }
+
+      if (index.count == index.capacity) {
+         const auto capacity = index.capacity * 2;
+         auto nodes = static_cast<MPLnode*>(allocator.Realloc(index.nodes, PHYSFS_uint64(capacity) * sizeof(MPLnode), PHYSFS_ALLOC_DIRTREE));
+         BAIL_IF(not nodes, PHYSFS_ERR_OUT_OF_MEMORY, MPL_NONE);
+         index.nodes = nodes;
+         index.capacity = capacity;
+      }
+
+      auto copy = static_cast<char*>(allocator.Malloc(len + 1, PHYSFS_ALLOC_DIRTREE));
+      BAIL_IF(not copy, PHYSFS_ERR_OUT_OF_MEMORY, MPL_NONE);
+      memcpy(copy, path, len);
+      copy[len] = '\0';
+
+      const auto id = index.count++;
+      auto& node = index.nodes[id];
+      memset(&node, 0, sizeof(MPLnode));
+      node.path = copy;
+      node.mtime = mtime;
+      node.isdir = isdir;
+      node.live = true;
+      node.parent = parent;
+      node.prevSibling = MPL_NONE;
+      node.nextSibling = index.nodes[parent].firstChild;
+      node.firstChild = MPL_NONE;
+      if (node.nextSibling != MPL_NONE)
+         index.nodes[node.nextSibling].prevSibling = id;
+      index.nodes[parent].firstChild = id;
+
+      const auto mask = index.slotCount - 1;
+      auto slot = static_cast<PHYSFS_uint32>(hashPath(path, len)) & mask;
+      while (index.slots[slot] and index.slots[slot] != MPL_TOMBSTONE)
+         slot = (slot + 1) & mask;
+      if (not index.slots[slot])
+         ++index.slotsUsed;
+      index.slots[slot] = id + 1;
+      return id;
+   }
+
+   /// Drop a file's data, it's dead weight in the log from now on            
+   void indexTruncate(MPLindex& index, MPLnode& node) {
+      index.liveBytes -= node.size;
+      index.deadBytes += node.size;
+      node.size = 0;
+      node.extentCount = 0;
+   }
+
+   bool indexExtend(MPLindex& index, MPLnode& node, PHYSFS_uint64 offset, PHYSFS_uint64 size) {
+      if (not size)
+         return true;
+
+      if (node.extentCount == node.extentCapacity) {
+         const auto capacity = std::max<PHYSFS_uint32>(node.extentCapacity * 2, 1);
+         auto extents = static_cast<MPLextent*>(allocator.Realloc(node.extents, PHYSFS_uint64(capacity) * sizeof(MPLextent), PHYSFS_ALLOC_DIRTREE));
+         BAIL_IF(not extents, PHYSFS_ERR_OUT_OF_MEMORY, false);
+         node.extents = extents;
+         node.extentCapacity = capacity;
+      }
+
+      node.extents[node.extentCount++] = {offset, size};
+      node.size += size;
+      index.liveBytes += size;
+      return true;
+   }
+
+   void indexRemove(MPLindex& index, PHYSFS_uint32 id) {
+      auto& node = index.nodes[id];
+      indexTruncate(index, node);
+
+      if (node.prevSibling != MPL_NONE)
+         index.nodes[node.prevSibling].nextSibling = node.nextSibling;
+      else
+         index.nodes[node.parent].firstChild = node.nextSibling;
+      if (node.nextSibling != MPL_NONE)
+         index.nodes[node.nextSibling].prevSibling = node.prevSibling;
+
+      const auto mask = index.slotCount - 1;
+      auto slot = static_cast<PHYSFS_uint32>(hashPath(node.path, strlen(node.path))) & mask;
+      while (index.slots[slot] != id + 1)
+         slot = (slot + 1) & mask;
+      index.slots[slot] = MPL_TOMBSTONE;
+
+      allocator.Free(node.extents);
+      node.extents = nullptr;
+      node.extentCapacity = 0;
+      node.live = false;
+   }
+
+   /// Check that a record would apply, before it's written                   
+   PHYSFS_ErrorCode indexCheck(const MPLindex& index, PHYSFS_uint32 type, const char* path) {
+      const auto len = strlen(path);
+      const auto id = indexFind(index, path, len);
+      switch (type) {
+      case MPL_PUT:
+         if (id != MPL_NONE)
+            return index.nodes[id].isdir ? PHYSFS_ERR_NOT_A_FILE : PHYSFS_ERR_OK;
+         return indexParentOf(index, path, len) == MPL_NONE ? PHYSFS_ERR_NOT_FOUND : PHYSFS_ERR_OK;
+      case MPL_EXTEND:
+         if (id == MPL_NONE)
+            return PHYSFS_ERR_NOT_FOUND;
+         return index.nodes[id].isdir ? PHYSFS_ERR_NOT_A_FILE : PHYSFS_ERR_OK;
+      case MPL_REMOVE:
+         if (id == MPL_NONE)
+            return PHYSFS_ERR_NOT_FOUND;
+         if (id == 0)
+            return PHYSFS_ERR_PERMISSION;
+         return index.nodes[id].firstChild != MPL_NONE ? PHYSFS_ERR_DIR_NOT_EMPTY : PHYSFS_ERR_OK;
+      case MPL_MKDIR:
+         if (id != MPL_NONE)
+            return PHYSFS_ERR_DUPLICATE;
+         return indexParentOf(index, path, len) == MPL_NONE ? PHYSFS_ERR_NOT_FOUND : PHYSFS_ERR_OK;
+      default:
+         return PHYSFS_ERR_CORRUPT;
+      }
+   }
+
+   /// Apply a record to the index. Writing, replaying and compacting all     
+   /// go through here, so they can't disagree about what a record means      
+   bool indexApply(
+      MPLindex& index, PHYSFS_uint32 type, const char* path,
+      PHYSFS_uint64 dataOffset, PHYSFS_uint64 dataLen, PHYSFS_sint64 mtime
+   ) {
+      const auto code = indexCheck(index, type, path);
+      if (code != PHYSFS_ERR_OK) {
+         PHYSFS_setErrorCode(code);
+         return false;
+      }
+
+      const auto len = strlen(path);
+      auto id = indexFind(index, path, len);
+      switch (type) {
+      case MPL_PUT:
+         if (id == MPL_NONE) {
+            id = indexAdd(index, path, len, false, mtime);
+            BAIL_IF_ERRPASS(id == MPL_NONE, false);
+         }
+         indexTruncate(index, index.nodes[id]);
+         index.nodes[id].mtime = mtime;
+         return indexExtend(index, index.nodes[id], dataOffset, dataLen);
+      case MPL_EXTEND:
+         index.nodes[id].mtime = mtime;
+         return indexExtend(index, index.nodes[id], dataOffset, dataLen);
+      case MPL_REMOVE:
+         indexRemove(index, id);
+         return true;
+      case MPL_MKDIR:
+         return indexAdd(index, path, len, true, mtime) != MPL_NONE;
+      }
+      return false;
+   }
+
+   /// Serialize the index, as a checkpoint's data                            
+   PHYSFS_uint8* indexSave(const MPLindex& index, PHYSFS_uint64& size) {
+      size = 0;
+      for (PHYSFS_uint32 i = 1; i < index.count; ++i) {
+         const auto& node = index.nodes[i];
+         if (node.live)
+            size += 20 + strlen(node.path) + PHYSFS_uint64(node.extentCount) * sizeof(MPLextent);
+      }
+
+      auto retval = static_cast<PHYSFS_uint8*>(allocator.Malloc(std::max<PHYSFS_uint64>(size, 1), PHYSFS_ALLOC_DIRTREE));
+      BAIL_IF(not retval, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+
+      auto at = retval;
+      const auto put = [&at](const void* data, size_t len) {
+         memcpy(at, data, len);
+         at += len;
+      };
+
+      for (PHYSFS_uint32 i = 1; i < index.count; ++i) {
+         const auto& node = index.nodes[i];
+         if (not node.live)
+            continue;
+
+         const auto len = strlen(node.path);
+         const PHYSFS_uint32 kind = PHYSFS_swapLE(PHYSFS_uint32(node.isdir ? 2 : 1));
+         const auto pathLen = PHYSFS_swapLE(static_cast<PHYSFS_uint32>(len));
+         const auto mtime = PHYSFS_swapLE(node.mtime);
+         const auto extentCount = PHYSFS_swapLE(node.extentCount);
+         put(&kind, 4);
+         put(&pathLen, 4);
+         put(&mtime, 8);
+         put(&extentCount, 4);
+         put(node.path, len);
+         for (PHYSFS_uint32 e = 0; e < node.extentCount; ++e) {
+            const PHYSFS_uint64 extent[2] = {
+               PHYSFS_swapLE(node.extents[e].offset),
+               PHYSFS_swapLE(node.extents[e].size)
+            };
+            put(extent, sizeof(extent));
+         }
+      }
+      return retval;
+   }
+
+   /// Load a checkpoint's data into an empty index. Every extent has to      
+   /// lie before (limit), where the checkpoint itself is                     
+   bool indexLoad(MPLindex& index, const PHYSFS_uint8* data, PHYSFS_uint64 size, PHYSFS_uint64 limit) {
+      const auto end = data + size;
+      char* path = nullptr;
+      bool ok = true;
+
+      while (ok and data < end) {
+         PHYSFS_uint32 kind, pathLen, extentCount;
+         PHYSFS_sint64 mtime;
+         if (end - data < 20)
+            break;
+         memcpy(&kind, data, 4);
+         memcpy(&pathLen, data + 4, 4);
+         memcpy(&mtime, data + 8, 8);
+         memcpy(&extentCount, data + 16, 4);
+         data += 20;
+         kind = PHYSFS_swapLE(kind);
+         pathLen = PHYSFS_swapLE(pathLen);
+         mtime = PHYSFS_swapLE(mtime);
+         extentCount = PHYSFS_swapLE(extentCount);
+
+         if ((kind != 1 and kind != 2) or pathLen == 0 or pathLen > MPL_MAX_PATH
+         or PHYSFS_uint64(end - data) < pathLen + PHYSFS_uint64(extentCount) * sizeof(MPLextent))
+            break;
+
+         allocator.Free(path);
+         path = static_cast<char*>(allocator.Malloc(pathLen + 1));
+         BAIL_IF(not path, PHYSFS_ERR_OUT_OF_MEMORY, false);
+         memcpy(path, data, pathLen);
+         path[pathLen] = '\0';
+         data += pathLen;
+
+         if (indexFind(index, path) != MPL_NONE)
+            break;
+         const auto id = indexAdd(index, path, pathLen, kind == 2, mtime);
+         if (id == MPL_NONE)
+            break;
+
+         for (PHYSFS_uint32 e = 0; ok and e < extentCount; ++e) {
+            PHYSFS_uint64 extent[2];
+            memcpy(extent, data, sizeof(extent));
+            data += sizeof(extent);
+            const auto offset = PHYSFS_swapLE(extent[0]);
+            const auto len = PHYSFS_swapLE(extent[1]);
+            ok = offset <= limit and len <= limit - offset
+               and indexExtend(index, index.nodes[id], offset, len);
+         }
+      }
+
+      allocator.Free(path);
+      BAIL_IF(not ok or data != end, PHYSFS_ERR_CORRUPT, false);
+      return true;
+   }
+
+
+   ///                                                                        
+   /// The log                                                                
+   ///                                                                        
+
+   /// Write a record with its data at (offset) of (io), and return the size  
+   /// it took. The hash goes first, so the data is hashed before anything    
+   /// is written                                                             
+   PHYSFS_uint64 logWrite(
+      PHYSFS_Io* io, PHYSFS_uint64 salt, PHYSFS_uint64 offset, PHYSFS_uint32 type,
+      const char* path, const void* data, PHYSFS_uint64 dataLen, PHYSFS_sint64 mtime
+   ) {
+      const auto pathLen = strlen(path);
+      auto rec = makeRecord(type, pathLen, dataLen, mtime);
+      auto hash = recordHash(salt, offset, rec);
+      hash = __PHYSFS_fnv1a(hash, path, pathLen);
+      hash = __PHYSFS_fnv1a(hash, data, size_t(dataLen));
+      rec.hash = PHYSFS_swapLE(hash);
+
+      BAIL_IF_ERRPASS(not io->seek(io, offset), 0);
+      BAIL_IF_ERRPASS(io->write(io, &rec, sizeof(rec)) != sizeof(rec), 0);
+      BAIL_IF_ERRPASS(io->write(io, path, pathLen) != PHYSFS_sint64(pathLen), 0);
+      if (dataLen)
+         BAIL_IF_ERRPASS(io->write(io, data, dataLen) != PHYSFS_sint64(dataLen), 0);
+      return sizeof(rec) + pathLen + dataLen;
+   }
+
+   /// Copy a record into (dst) at (offset), with its data coming from        
+   /// extents of (src). The hash is patched in once the data's through       
+   PHYSFS_uint64 logCopy(
+      PHYSFS_Io* dst, PHYSFS_uint64 salt, PHYSFS_uint64 offset, PHYSFS_uint32 type,
+      const char* path, PHYSFS_Io* src, const MPLextent* extents, PHYSFS_uint32 extentCount,
+      PHYSFS_sint64 mtime, PHYSFS_uint8* buffer
+   ) {
+      PHYSFS_uint64 dataLen = 0;
+      for (PHYSFS_uint32 i = 0; i < extentCount; ++i)
+         dataLen += extents[i].size;
+
+      const auto pathLen = strlen(path);
+      auto rec = makeRecord(type, pathLen, dataLen, mtime);
+      auto hash = recordHash(salt, offset, rec);
+      hash = __PHYSFS_fnv1a(hash, path, pathLen);
+
+      BAIL_IF_ERRPASS(not dst->seek(dst, offset), 0);
+      BAIL_IF_ERRPASS(dst->write(dst, &rec, sizeof(rec)) != sizeof(rec), 0);
+      BAIL_IF_ERRPASS(dst->write(dst, path, pathLen) != PHYSFS_sint64(pathLen), 0);
+
+      for (PHYSFS_uint32 i = 0; i < extentCount; ++i) {
+         BAIL_IF_ERRPASS(not src->seek(src, extents[i].offset), 0);
+         for (auto left = extents[i].size; left; ) {
+            const auto chunk = static_cast<size_t>(std::min<PHYSFS_uint64>(left, MPL_WRITE_BUFFER));
+            BAIL_IF_ERRPASS(not __PHYSFS_readAll(src, buffer, chunk), 0);
+            BAIL_IF_ERRPASS(dst->write(dst, buffer, chunk) != PHYSFS_sint64(chunk), 0);
+            hash = __PHYSFS_fnv1a(hash, buffer, chunk);
+            left -= chunk;
+         }
+      }
+
+      const auto end = offset + sizeof(rec) + pathLen + dataLen;
+      rec.hash = PHYSFS_swapLE(hash);
+      BAIL_IF_ERRPASS(not dst->seek(dst, offset + offsetof(MPLrecord, hash)), 0);
+      BAIL_IF_ERRPASS(dst->write(dst, &rec.hash, sizeof(rec.hash)) != sizeof(rec.hash), 0);
+      BAIL_IF_ERRPASS(not dst->seek(dst, end), 0);
+      return end - offset;
+   }
+
+   /// A record read back and checked. (path) is allocated, \0 ended          
+   struct MPLread {
+      PHYSFS_uint32 type;
+      char* path;
+      PHYSFS_uint64 dataOffset;
+      PHYSFS_uint64 dataLen;
+      PHYSFS_sint64 mtime;
+      PHYSFS_uint64 next;
+   };
+
+   /// Read the record at (offset) of a log (length) bytes long, checking     
+   /// its hash. Fails on anything short, torn or not ours, which is where    
+   /// replay stops                                                           
+   bool logRead(PHYSFS_Io* io, PHYSFS_uint64 salt, PHYSFS_uint64 offset, PHYSFS_uint64 length, PHYSFS_uint8* buffer, MPLread& out) {
+      out.path = nullptr;
+      if (offset > length or length - offset < MPL_RECORD_SIZE)
+         return false;
+
+      MPLrecord rec;
+      BAIL_IF_ERRPASS(not io->seek(io, offset) or not __PHYSFS_readAll(io, &rec, sizeof(rec)), false);
+      out.type = PHYSFS_swapLE(rec.type);
+      const auto pathLen = PHYSFS_swapLE(rec.pathLen);
+      out.dataLen = PHYSFS_swapLE(rec.dataLen);
+      out.mtime = PHYSFS_swapLE(rec.mtime);
+      out.dataOffset = offset + MPL_RECORD_SIZE + pathLen;
+
+      const auto room = length - offset - MPL_RECORD_SIZE;
+      if (out.type < MPL_PUT or out.type > MPL_CHECKPOINT or pathLen > MPL_MAX_PATH
+      or pathLen > room or out.dataLen > room - pathLen)
+         return false;
+      if (out.type != MPL_CHECKPOINT and pathLen == 0)
+         return false;
+      out.next = out.dataOffset + out.dataLen;
+
+      out.path = static_cast<char*>(allocator.Malloc(pathLen + 1));
+      BAIL_IF(not out.path, PHYSFS_ERR_OUT_OF_MEMORY, false);
+      out.path[pathLen] = '\0';
+
+      auto hash = recordHash(salt, offset, rec);
+      if (not __PHYSFS_readAll(io, out.path, pathLen)) {
+         allocator.Free(out.path);
+         out.path = nullptr;
+         return false;
+      }
+      hash = __PHYSFS_fnv1a(hash, out.path, pathLen);
+
+      for (auto left = out.dataLen; left; ) {
+         const auto chunk = static_cast<size_t>(std::min<PHYSFS_uint64>(left, MPL_WRITE_BUFFER));
+         if (not __PHYSFS_readAll(io, buffer, chunk)) {
+            allocator.Free(out.path);
+            out.path = nullptr;
+            return false;
+         }
+         hash = __PHYSFS_fnv1a(hash, buffer, chunk);
+         left -= chunk;
+      }
+
+      if (hash != PHYSFS_swapLE(rec.hash) or strlen(out.path) != pathLen) {
+         allocator.Free(out.path);
+         out.path = nullptr;
+         return false;
+      }
+      return true;
+   }
+
+   bool writeHeader(PHYSFS_Io* io, PHYSFS_uint64 salt, PHYSFS_uint64 checkpoint) {
+      const PHYSFS_uint32 h32[2] = {PHYSFS_swapLE(MPL_SIG), PHYSFS_swapLE(MPL_VERSION)};
+      const PHYSFS_uint64 h64[3] = {
+         PHYSFS_swapLE(salt), PHYSFS_swapLE(checkpoint),
+         PHYSFS_swapLE(headerCheck(salt, checkpoint))
+      };
+      BAIL_IF_ERRPASS(not io->seek(io, 0), false);
+      BAIL_IF_ERRPASS(io->write(io, h32, sizeof(h32)) != sizeof(h32), false);
+      BAIL_IF_ERRPASS(io->write(io, h64, sizeof(h64)) != sizeof(h64), false);
+      return true;
+   }
+
+   /// Build the index of the log behind (io): from the latest checkpoint if  
+   /// there's a good one, then replaying every record after it. Returns      
+   /// where the last good record ends                                        
+   bool logLoad(PHYSFS_Io* io, PHYSFS_uint64 length, PHYSFS_uint64& salt, MPLindex& index, PHYSFS_uint64& end) {
+      PHYSFS_uint32 h32[2];
+      PHYSFS_uint64 h64[3];
+      BAIL_IF_ERRPASS(not io->seek(io, 0), false);
+      BAIL_IF_ERRPASS(not __PHYSFS_readAll(io, h32, sizeof(h32)), false);
+      BAIL_IF_ERRPASS(not __PHYSFS_readAll(io, h64, sizeof(h64)), false);
+      BAIL_IF(PHYSFS_swapLE(h32[1]) != MPL_VERSION, PHYSFS_ERR_UNSUPPORTED, false);
+      salt = PHYSFS_swapLE(h64[0]);
+      const auto checkpoint = PHYSFS_swapLE(h64[1]);
+
+      auto buffer = static_cast<PHYSFS_uint8*>(allocator.Malloc(MPL_WRITE_BUFFER));
+      BAIL_IF(not buffer, PHYSFS_ERR_OUT_OF_MEMORY, false);
+      BAIL_IF_ERRPASS(not indexInit(index), (allocator.Free(buffer), false));
+
+      // A checkpoint that doesn't check out is as good as none: replaying
+      // the whole log gets to the same place, only slower              
+      end = MPL_HEADER_SIZE;
+      MPLread rec;
+      if (checkpoint and PHYSFS_swapLE(h64[2]) == headerCheck(salt, checkpoint)
+      and logRead(io, salt, checkpoint, length, buffer, rec)) {
+         allocator.Free(rec.path);
+         auto data = rec.type == MPL_CHECKPOINT ? static_cast<PHYSFS_uint8*>(allocator.Malloc(std::max<PHYSFS_uint64>(rec.dataLen, 1))) : nullptr;
+         bool loaded = data and io->seek(io, rec.dataOffset)
+            and __PHYSFS_readAll(io, data, size_t(rec.dataLen))
+            and indexLoad(index, data, rec.dataLen, checkpoint);
+         allocator.Free(data);
+
+         if (loaded)
+            end = rec.next;
+         else {
+            indexDeinit(index);
+            if (not indexInit(index)) {
+               allocator.Free(buffer);
+               return false;
+            }
+         }
+      }
+
+      while (logRead(io, salt, end, length, buffer, rec)) {
+         const bool applied = rec.type == MPL_CHECKPOINT
+            or indexApply(index, rec.type, rec.path, rec.dataOffset, rec.dataLen, rec.mtime);
+         allocator.Free(rec.path);
+         if (not applied)
+            break;
+         end = rec.next;
+      }
+
+      allocator.Free(buffer);
+      return true;
+   }
+
+
+   ///                                                                        
+   /// Writing to the pack                                                    
+   ///                                                                        
+
+   bool writeCheckpoint(MPLinfo* info);
+   void maybeCompact(MPLinfo* info);
+
+   /// Append a record to the pack and apply it. Takes (info->mutex)          
+   bool append(MPLinfo* info, PHYSFS_uint32 type, const char* path, const void* data, PHYSFS_uint64 dataLen) {
+      __PHYSFS_platformGrabMutex(info->mutex);
+      BAIL_IF_MUTEX(not info->appendIo, PHYSFS_ERR_READ_ONLY, info->mutex, false);
+      const auto code = indexCheck(info->index, type, path);
+      BAIL_IF_MUTEX(code != PHYSFS_ERR_OK, code, info->mutex, false);
+
+      const auto mtime = now();
+      const auto offset = info->end;
+      const auto pathLen = strlen(path);
+      PHYSFS_uint64 size = 0;
+      try { size = logWrite(info->appendIo, info->salt, offset, type, path, data, dataLen, mtime); }
+      catch (...) {}
+
+      // A record that didn't make it whole is overwritten by the next one
+      BAIL_IF_MUTEX(not size, PHYSFS_ERR_IO, info->mutex, false);
+      bool applied = false;
+      try { applied = indexApply(info->index, type, path, offset + MPL_RECORD_SIZE + pathLen, dataLen, mtime); }
+      catch (...) {}
+      BAIL_IF_MUTEX(not applied, PHYSFS_ERR_OUT_OF_MEMORY, info->mutex, false);
+
+      info->end += size;
+      info->bytesSinceCheckpoint += size;
+      if (++info->recordsSinceCheckpoint >= MPL_CHECKPOINT_RECORDS
+      or info->bytesSinceCheckpoint >= MPL_CHECKPOINT_BYTES) {
+         // The record is in either way, a late checkpoint only makes the
+         // next open replay more                                       
+         try { writeCheckpoint(info); }
+         catch (...) {}
+      }
+
+      maybeCompact(info);
+      __PHYSFS_platformReleaseMutex(info->mutex);
+      return true;
+   }
+
+   /// Write the index out, sync, then point the header at it. Call with      
+   /// (info->mutex) held                                                     
+   bool writeCheckpoint(MPLinfo* info) {
+      PHYSFS_uint64 size;
+      auto data = indexSave(info->index, size);
+      BAIL_IF_ERRPASS(not data, false);
+
+      const auto offset = info->end;
+      const auto written = logWrite(info->appendIo, info->salt, offset, MPL_CHECKPOINT, "", data, size, now());
+      allocator.Free(data);
+      BAIL_IF_ERRPASS(not written, false);
+      info->end += written;
+      info->recordsSinceCheckpoint = 0;
+      info->bytesSinceCheckpoint = 0;
+
+      // The checkpoint must be on disk before the header points at it  
+      auto io = info->appendIo;
+      BAIL_IF_ERRPASS(not io->flush(io), false);
+      BAIL_IF_ERRPASS(not writeHeader(io, info->salt, offset), false);
+      BAIL_IF_ERRPASS(not io->flush(io), false);
+      return true;
+   }
+
+
+   ///                                                                        
+   /// Compaction                                                             
+   ///                                                                        
+
+   /// Copy the live files into a new log next to the old one, and swap it    
+   /// in. Only the start and the end run under (info->mutex): the bulk of    
+   /// the copy runs alongside writers, whose records are copied over at      
+   /// the end                                                                
+   bool compact(MPLinfo* info) {
+      const auto pathLen = strlen(info->path);
+      auto tmpPath = static_cast<char*>(allocator.Malloc(pathLen + 9));
+      if (not tmpPath)
+         return false;
+      memcpy(tmpPath, info->path, pathLen);
+      memcpy(tmpPath + pathLen, ".compact", 9);
+
+      PHYSFS_Io* src = nullptr;
+      PHYSFS_Io* dst = nullptr;
+      PHYSFS_uint8* buffer = nullptr;
+      PHYSFS_uint8* snapshot = nullptr;
+      MPLindex fresh {};
+      MPLread rec {};
+      bool swapped = false;
+      bool locked = false;
+      bool ok = false;
+
+      // Nothing may escape: this runs on its own thread                
+      try {
+         // The live nodes, as a checkpoint would list them             
+         __PHYSFS_platformGrabMutex(info->mutex);
+         locked = true;
+         PHYSFS_uint64 snapshotSize = 0;
+         snapshot = indexSave(info->index, snapshotSize);
+         const auto copiedUpTo = info->end;
+         src = info->readIo ? info->readIo->duplicate(info->readIo) : nullptr;
+         __PHYSFS_platformReleaseMutex(info->mutex);
+         locked = false;
+
+         buffer = static_cast<PHYSFS_uint8*>(allocator.Malloc(MPL_WRITE_BUFFER));
+         dst = __PHYSFS_createNativeIo(tmpPath, 'w');
+         const auto salt = makeSalt(dst);
+         ok = snapshot and buffer and src and dst and indexInit(fresh)
+            and writeHeader(dst, salt, 0);
+
+         // Snapshot nodes are parents first, like in a checkpoint      
+         PHYSFS_uint64 end = MPL_HEADER_SIZE;
+         const auto* at = snapshot;
+         const auto* stop = snapshot + snapshotSize;
+         while (ok and at < stop) {
+#ifndef PHYSFS_NO_THREADS
+            if (info->stop.load(std::memory_order_relaxed)) {
+               ok = false;
+               break;
+            }
+#endif
+            PHYSFS_uint32 kind, nodePathLen, extentCount;
+            PHYSFS_sint64 mtime;
+            memcpy(&kind, at, 4);
+            memcpy(&nodePathLen, at + 4, 4);
+            memcpy(&mtime, at + 8, 8);
+            memcpy(&extentCount, at + 16, 4);
+            kind = PHYSFS_swapLE(kind);
+            nodePathLen = PHYSFS_swapLE(nodePathLen);
+            mtime = PHYSFS_swapLE(mtime);
+            extentCount = PHYSFS_swapLE(extentCount);
+            at += 20;
+
+            char* nodePath = static_cast<char*>(allocator.Malloc(nodePathLen + 1));
+            ok = nodePath != nullptr;
+            if (not ok)
+               break;
+            memcpy(nodePath, at, nodePathLen);
+            nodePath[nodePathLen] = '\0';
+            at += nodePathLen;
+
+            auto extents = static_cast<MPLextent*>(allocator.Malloc(std::max<PHYSFS_uint64>(extentCount, 1) * sizeof(MPLextent)));
+            ok = extents != nullptr;
+            for (PHYSFS_uint32 e = 0; ok and e < extentCount; ++e) {
+               PHYSFS_uint64 extent[2];
+               memcpy(extent, at, sizeof(extent));
+               extents[e] = {PHYSFS_swapLE(extent[0]), PHYSFS_swapLE(extent[1])};
+               at += sizeof(extent);
+            }
+
+            const auto type = kind == 2 ? MPL_MKDIR : MPL_PUT;
+            PHYSFS_uint64 size = 0;
+            if (ok)
+               size = logCopy(dst, salt, end, type, nodePath, src, extents, extentCount, mtime, buffer);
+            ok = size and indexApply(fresh, type, nodePath, end + MPL_RECORD_SIZE + nodePathLen, size - MPL_RECORD_SIZE - nodePathLen, mtime);
+            end += size;
+            allocator.Free(extents);
+            allocator.Free(nodePath);
+         }
+
+         // Catch up with what was written meanwhile, then swap         
+         __PHYSFS_platformGrabMutex(info->mutex);
+         locked = true;
+         const auto length = info->end;
+         for (auto offset = copiedUpTo; ok and offset < length; offset = rec.next) {
+            ok = logRead(src, info->salt, offset, length, buffer, rec);
+            if (ok and rec.type != MPL_CHECKPOINT) {
+               const MPLextent extent {rec.dataOffset, rec.dataLen};
+               const auto size = logCopy(dst, salt, end, rec.type, rec.path, src, &extent, rec.dataLen ? 1 : 0, rec.mtime, buffer);
+               ok = size and indexApply(fresh, rec.type, rec.path, end + size - rec.dataLen, rec.dataLen, rec.mtime);
+               end += size;
+            }
+            allocator.Free(rec.path);
+            rec.path = nullptr;
+         }
+
+         if (ok) {
+            // Same order as a checkpoint: the new log is whole on disk 
+            // before it can replace the old one                        
+            PHYSFS_uint64 size = 0;
+            auto data = indexSave(fresh, size);
+            const auto written = data ? logWrite(dst, salt, end, MPL_CHECKPOINT, "", data, size, now()) : 0;
+            allocator.Free(data);
+            ok = written and dst->flush(dst) and writeHeader(dst, salt, end) and dst->flush(dst);
+            end += written;
+         }
+
+         if (ok) {
+            dst->destroy(dst);
+            dst = nullptr;
+            src->destroy(src);
+            src = nullptr;
+
+            // Nothing of ours may hold the old log open while it's being
+            // replaced, some platforms won't allow it                  
+            info->appendIo->destroy(info->appendIo);
+            info->readIo->destroy(info->readIo);
+            info->appendIo = info->readIo = nullptr;
+            swapped = __PHYSFS_platformRename(tmpPath, info->path);
+            if (swapped) {
+               indexDeinit(info->index);
+               info->index = fresh;
+               memset(&fresh, 0, sizeof(MPLindex));
+               info->salt = salt;
+               info->end = end;
+               info->recordsSinceCheckpoint = 0;
+               info->bytesSinceCheckpoint = 0;
+            }
+
+            // Whichever log is in place now. If it can't be opened again,
+            // the pack stays mounted, but fails to read or write       
+            info->readIo = __PHYSFS_createNativeIo(info->path, 'r');
+            info->appendIo = __PHYSFS_createNativeIo(info->path, 'a');
+         }
+      }
+      catch (...) {}
+
+      if (locked)
+         __PHYSFS_platformReleaseMutex(info->mutex);
+      if (rec.path)
+         allocator.Free(rec.path);
+      if (src)
+         src->destroy(src);
+      if (dst)
+         dst->destroy(dst);
+      if (not swapped)
+         __PHYSFS_platformDelete(tmpPath);
+      indexDeinit(fresh);
+      allocator.Free(snapshot);
+      allocator.Free(buffer);
+      allocator.Free(tmpPath);
+      return swapped;
+   }
+
+   void compactMain(void* opaque) {
+      auto info = static_cast<MPLinfo*>(opaque);
+      const auto swapped = compact(info);
+
+      __PHYSFS_platformGrabMutex(info->mutex);
+      // If it didn't work out, try again once the log has grown as much
+      // again, instead of after every single write                     
+      if (not swapped)
+         info->index.deadBytes = 0;
+      info->compacting = false;
+      __PHYSFS_platformReleaseMutex(info->mutex);
+   }
+
+   /// Start compacting if enough of the log is dead. Call with               
+   /// (info->mutex) held                                                     
+   void maybeCompact(MPLinfo* info) {
+      const auto& index = info->index;
+      if (info->compacting or index.deadBytes < MPL_COMPACT_MIN or index.deadBytes < index.liveBytes)
+         return;
+
+      info->compacting = true;
+#ifndef PHYSFS_NO_THREADS
+      if (info->compactor) {
+         __PHYSFS_platformJoinThread(info->compactor);
+         info->compactor = nullptr;
+      }
+      try { info->compactor = __PHYSFS_platformCreateThread(compactMain, info); }
+      catch (...) {}
+      if (info->compactor)
+         return;
+#endif
+      // No threads to spare, so the write that tipped it over waits    
+      compactMain(info);
+   }
+
+
+   ///                                                                        
+   /// Reading files                                                          
+   ///                                                                        
+
+   /// Find the extent holding (pos), starting from where (finfo) last was    
+   void readLocate(MPLreadinfo* finfo) {
+      if (finfo->pos < finfo->extentStart) {
+         finfo->extent = 0;
+         finfo->extentStart = 0;
+      }
+      while (finfo->extent < finfo->extentCount
+      and finfo->pos >= finfo->extentStart + finfo->extents[finfo->extent].size) {
+         finfo->extentStart += finfo->extents[finfo->extent].size;
+         ++finfo->extent;
+      }
+   }
+
+   /// Read from (source) at (offset), whoever else is reading it too         
+   PHYSFS_sint64 sourceRead(MPLsource* source, PHYSFS_uint64 offset, void* buffer, PHYSFS_uint64 len) {
+      const auto io = source->io;
+      if (not source->mutex)
+         return io->readAt(io, offset, buffer, len);
+
+      __PHYSFS_platformGrabMutex(source->mutex);
+      PHYSFS_sint64 rc = -1;
+      try {
+         if (offset == source->ioPos or io->seek(io, offset))
+            rc = io->read(io, buffer, len);
+      }
+      catch (...) {
+         source->ioPos = ~PHYSFS_uint64(0);
+         __PHYSFS_platformReleaseMutex(source->mutex);
+         throw;
+      }
+
+      source->ioPos = rc > 0 ? offset + PHYSFS_uint64(rc) : ~PHYSFS_uint64(0);
+      __PHYSFS_platformReleaseMutex(source->mutex);
+      return rc;
+   }
+
+   PHYSFS_sint64 MPL_read(PHYSFS_Io* io, void* buffer, PHYSFS_uint64 len) {
+      auto finfo = static_cast<MPLreadinfo*>(io->opaque);
+      auto out = static_cast<PHYSFS_uint8*>(buffer);
+      const auto start = finfo->pos;
+      len = std::min(len, finfo->size - finfo->pos);
+
+      while (len) {
+         readLocate(finfo);
+         const auto& extent = finfo->extents[finfo->extent];
+         const auto within = finfo->pos - finfo->extentStart;
+         const auto count = std::min(len, extent.size - within);
+         const auto rc = sourceRead(finfo->source, extent.offset + within, out, count);
+         if (rc <= 0) {
+            BAIL_IF_ERRPASS(finfo->pos == start, -1);
+            break;
+         }
+
+         finfo->pos += rc;
+         out += rc;
+         len -= rc;
+      }
+      return static_cast<PHYSFS_sint64>(finfo->pos - start);
+   }
+
+   /// Positional reads leave (pos) alone, and can run alongside each other   
+   PHYSFS_sint64 MPL_readAt(PHYSFS_Io* io, PHYSFS_uint64 offset, void* buffer, PHYSFS_uint64 len) {
+      auto finfo = static_cast<const MPLreadinfo*>(io->opaque);
+      if (offset >= finfo->size)
+         return 0;
+
+      auto out = static_cast<PHYSFS_uint8*>(buffer);
+      len = std::min(len, finfo->size - offset);
+
+      PHYSFS_uint64 done = 0;
+      PHYSFS_uint64 extentStart = 0;
+      for (PHYSFS_uint32 i = 0; i < finfo->extentCount and done < len; ++i) {
+         const auto& extent = finfo->extents[i];
+         const auto pos = offset + done;
+         if (pos >= extentStart + extent.size) {
+            extentStart += extent.size;
+            continue;
+         }
+
+         const auto within = pos - extentStart;
+         const auto count = std::min(len - done, extent.size - within);
+         const auto rc = sourceRead(finfo->source, extent.offset + within, out + done, count);
+         if (rc <= 0) {
+            BAIL_IF_ERRPASS(done == 0, -1);
+            break;
+         }
+
+         done += rc;
+         if (PHYSFS_uint64(rc) < count)
+            break;
+         extentStart += extent.size;
+      }
+      return static_cast<PHYSFS_sint64>(done);
+   }
+
+   PHYSFS_sint64 MPL_readWrite(PHYSFS_Io*, const void*, PHYSFS_uint64) {
+      BAIL(PHYSFS_ERR_OPEN_FOR_READING, -1);
+   }
+
+   int MPL_readSeek(PHYSFS_Io* io, PHYSFS_uint64 offset) {
+      auto finfo = static_cast<MPLreadinfo*>(io->opaque);
+      BAIL_IF(offset > finfo->size, PHYSFS_ERR_PAST_EOF, 0);
+      finfo->pos = offset;
+      return 1;
+   }
+
+   PHYSFS_sint64 MPL_readTell(PHYSFS_Io* io) {
+      return static_cast<PHYSFS_sint64>(static_cast<MPLreadinfo*>(io->opaque)->pos);
+   }
+
+   PHYSFS_sint64 MPL_readLength(PHYSFS_Io* io) {
+      return static_cast<PHYSFS_sint64>(static_cast<MPLreadinfo*>(io->opaque)->size);
+   }
+
+   int MPL_readFlush(PHYSFS_Io*) {
+      return 1;
+   }
+
+   void releaseSource(MPLsource* source) {
+      if (__PHYSFS_ATOMIC_DECR(&source->refs))
+         return;
+      source->io->destroy(source->io);
+      if (source->mutex)
+         __PHYSFS_platformDestroyMutex(source->mutex);
+      allocator.Free(source);
+   }
+
+   void MPL_readDestroy(PHYSFS_Io* io) {
+      auto finfo = static_cast<MPLreadinfo*>(io->opaque);
+      if (finfo->source)
+         releaseSource(finfo->source);
+      allocator.Free(finfo->extents);
+      allocator.Free(finfo);
+      allocator.Free(io);
+   }
+
+   PHYSFS_Io* openReader(MPLsource* source, const MPLextent* extents, PHYSFS_uint32 extentCount, PHYSFS_uint64 size);
+
+   /// A duplicate shares the file the original reads, rather than opening    
+   /// the log again: by now, that might be another file                      
+   PHYSFS_Io* MPL_readDuplicate(PHYSFS_Io* io) {
+      auto finfo = static_cast<MPLreadinfo*>(io->opaque);
+      return openReader(finfo->source, finfo->extents, finfo->extentCount, finfo->size);
+   }
+
+   const PHYSFS_Io MPL_ReadIo =
+   {
+      CURRENT_PHYSFS_IO_API_VERSION, nullptr,
+      MPL_read,
+      MPL_readWrite,
+      MPL_readSeek,
+      MPL_readTell,
+      MPL_readLength,
+      MPL_readDuplicate,
+      MPL_readFlush,
+      MPL_readDestroy,
+      MPL_readAt
+   };
+
+   /// A file is a copy of its extents and a reference to (source), so it     
+   /// reads the same even after the log is compacted away from under it      
+   PHYSFS_Io* openReader(MPLsource* source, const MPLextent* extents, PHYSFS_uint32 extentCount, PHYSFS_uint64 size) {
+      auto retval = static_cast<PHYSFS_Io*>(allocator.Malloc(sizeof(PHYSFS_Io), PHYSFS_ALLOC_FILEHANDLE));
+      auto finfo = static_cast<MPLreadinfo*>(allocator.Malloc(sizeof(MPLreadinfo), PHYSFS_ALLOC_FILEHANDLE));
+      auto copy = static_cast<MPLextent*>(allocator.Malloc(std::max<PHYSFS_uint64>(extentCount, 1) * sizeof(MPLextent), PHYSFS_ALLOC_FILEHANDLE));
+      if (not retval or not finfo or not copy) {
+         allocator.Free(retval);
+         allocator.Free(finfo);
+         allocator.Free(copy);
+         BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+      }
+
+      memset(finfo, 0, sizeof(MPLreadinfo));
+      memcpy(retval, &MPL_ReadIo, sizeof(PHYSFS_Io));
+      if (extentCount)
+         memcpy(copy, extents, extentCount * sizeof(MPLextent));
+      retval->opaque = finfo;
+      finfo->extents = copy;
+      finfo->extentCount = extentCount;
+      finfo->size = size;
+      finfo->source = source;
+      __PHYSFS_ATOMIC_INCR(&source->refs);
+      return retval;
+   }
+
+   /// Open a reader on the log as it is right now, through a duplicate of    
+   /// its read io (log). With the log's mutex held                           
+   PHYSFS_Io* openSourceReader(PHYSFS_Io* log, const MPLextent* extents, PHYSFS_uint32 extentCount, PHYSFS_uint64 size) {
+      auto source = static_cast<MPLsource*>(allocator.Malloc(sizeof(MPLsource), PHYSFS_ALLOC_FILEHANDLE));
+      BAIL_IF(not source, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+      memset(source, 0, sizeof(MPLsource));
+      source->ioPos = ~PHYSFS_uint64(0);
+      source->refs = 1;
+
+      PHYSFS_Io* retval = nullptr;
+      try {
+         source->io = log->duplicate(log);
+         if (source->io and not __PHYSFS_ioCanReadAt(source->io))
+            source->mutex = __PHYSFS_platformCreateMutex();
+         if (source->io and (source->mutex or __PHYSFS_ioCanReadAt(source->io)))
+            retval = openReader(source, extents, extentCount, size);
+      }
+      catch (...) {}
+
+      // The reader, if there is one, holds its own reference           
+      if (source->io)
+         releaseSource(source);
+      else allocator.Free(source);
+      return retval;
+   }
+
+
+   ///                                                                        
+   /// Writing files                                                          
+   ///                                                                        
+
+   /// Append what's buffered. The first record of a file opened for          
+   /// writing is a put, which replaces whatever the file held, so a file     
+   /// that fits the buffer is replaced in one go when it's closed            
+   bool writerEmit(MPLwriteinfo* finfo) {
+      auto type = MPL_EXTEND;
+      if (not finfo->started and not finfo->appending)
+         type = MPL_PUT;
+      else if (not finfo->started) {
+         // Appending to a file that isn't there creates it             
+         __PHYSFS_platformGrabMutex(finfo->arc->mutex);
+         if (indexFind(finfo->arc->index, finfo->path) == MPL_NONE)
+            type = MPL_PUT;
+         __PHYSFS_platformReleaseMutex(finfo->arc->mutex);
+      }
+
+      BAIL_IF_ERRPASS(not append(finfo->arc, type, finfo->path, finfo->buffer, finfo->fill), false);
+      finfo->started = true;
+      finfo->fill = 0;
+      return true;
+   }
+
+   PHYSFS_sint64 MPL_write(PHYSFS_Io* io, const void* buffer, PHYSFS_uint64 len) {
+      auto finfo = static_cast<MPLwriteinfo*>(io->opaque);
+      auto in = static_cast<const PHYSFS_uint8*>(buffer);
+      PHYSFS_uint64 done = 0;
+      while (done < len) {
+         if (finfo->fill == MPL_WRITE_BUFFER) {
+            if (not writerEmit(finfo)) {
+               BAIL_IF_ERRPASS(done == 0, -1);
+               break;
+            }
+         }
+
+         const auto count = static_cast<size_t>(std::min<PHYSFS_uint64>(len - done, MPL_WRITE_BUFFER - finfo->fill));
+         memcpy(finfo->buffer + finfo->fill, in + done, count);
+         finfo->fill += count;
+         finfo->size += count;
+         done += count;
+      }
+      return static_cast<PHYSFS_sint64>(done);
+   }
+
+   PHYSFS_sint64 MPL_writeRead(PHYSFS_Io*, void*, PHYSFS_uint64) {
+      BAIL(PHYSFS_ERR_OPEN_FOR_WRITING, -1);
+   }
+
+   /// Records only ever go at the end, so that's the one place to seek to    
+   int MPL_writeSeek(PHYSFS_Io* io, PHYSFS_uint64 offset) {
+      auto finfo = static_cast<MPLwriteinfo*>(io->opaque);
+      BAIL_IF(offset != finfo->size, PHYSFS_ERR_UNSUPPORTED, 0);
+      return 1;
+   }
+
+   PHYSFS_sint64 MPL_writeTell(PHYSFS_Io* io) {
+      return static_cast<PHYSFS_sint64>(static_cast<MPLwriteinfo*>(io->opaque)->size);
+   }
+
+   PHYSFS_Io* MPL_writeDuplicate(PHYSFS_Io*) {
+      BAIL(PHYSFS_ERR_UNSUPPORTED, nullptr);
+   }
+
+   /// Called when the file is closed: whatever's buffered goes into the      
+   /// log, and a file nothing was written to is created empty                
+   int MPL_writeFlush(PHYSFS_Io* io) {
+      auto finfo = static_cast<MPLwriteinfo*>(io->opaque);
+      if (finfo->fill or not finfo->started)
+         BAIL_IF_ERRPASS(not writerEmit(finfo), 0);
+      return 1;
+   }
+
+   void MPL_writeDestroy(PHYSFS_Io* io) {
+      auto finfo = static_cast<MPLwriteinfo*>(io->opaque);
+      allocator.Free(finfo->buffer);
+      allocator.Free(finfo->path);
+      allocator.Free(finfo);
+      allocator.Free(io);
+   }
+
+   const PHYSFS_Io MPL_WriteIo =
+   {
+      CURRENT_PHYSFS_IO_API_VERSION, nullptr,
+      MPL_writeRead,
+      MPL_write,
+      MPL_writeSeek,
+      MPL_writeTell,
+      MPL_writeTell,
+      MPL_writeDuplicate,
+      MPL_writeFlush,
+      MPL_writeDestroy,
+      nullptr
+   };
+
+   PHYSFS_Io* openWriter(MPLinfo* info, const char* name, bool appending) {
+      __PHYSFS_platformGrabMutex(info->mutex);
+      BAIL_IF_MUTEX(not info->appendIo, PHYSFS_ERR_READ_ONLY, info->mutex, nullptr);
+      const auto code = indexCheck(info->index, MPL_PUT, name);
+      BAIL_IF_MUTEX(code != PHYSFS_ERR_OK, code, info->mutex, nullptr);
+      const auto id = indexFind(info->index, name);
+      const PHYSFS_uint64 size = appending and id != MPL_NONE ? info->index.nodes[id].size : 0;
+      __PHYSFS_platformReleaseMutex(info->mutex);
+
+      auto retval = static_cast<PHYSFS_Io*>(allocator.Malloc(sizeof(PHYSFS_Io), PHYSFS_ALLOC_FILEHANDLE));
+      auto finfo = static_cast<MPLwriteinfo*>(allocator.Malloc(sizeof(MPLwriteinfo), PHYSFS_ALLOC_FILEHANDLE));
+      auto buffer = static_cast<PHYSFS_uint8*>(allocator.Malloc(MPL_WRITE_BUFFER, PHYSFS_ALLOC_FILEHANDLE));
+      auto path = static_cast<char*>(allocator.Malloc(strlen(name) + 1, PHYSFS_ALLOC_FILEHANDLE));
+      if (not retval or not finfo or not buffer or not path) {
+         allocator.Free(retval);
+         allocator.Free(finfo);
+         allocator.Free(buffer);
+         allocator.Free(path);
+         BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+      }
+
+      strcpy(path, name);
+      memset(finfo, 0, sizeof(MPLwriteinfo));
+      memcpy(retval, &MPL_WriteIo, sizeof(PHYSFS_Io));
+      retval->opaque = finfo;
+      finfo->arc = info;
+      finfo->path = path;
+      finfo->buffer = buffer;
+      finfo->size = size;
+      finfo->appending = appending;
+      return retval;
+   }
+
+
+   ///                                                                        
+   /// The archiver                                                           
+   ///                                                                        
+
+   /// Every open log, so mounting the write dir's pack gets the same one,    
+   /// writes and all. Contexts mount and unmount without waiting on each     
+   /// other, so the list and every log's (refs) are under a lock of their    
+   /// own                                                                    
+   MPLinfo* openLogs = nullptr;
+#ifndef PHYSFS_NO_THREADS
+   std::mutex openLogsMutex;
+#endif
+
+   void freeLog(MPLinfo* info) {
+      if (info->appendIo)
+         info->appendIo->destroy(info->appendIo);
+      if (info->readIo)
+         info->readIo->destroy(info->readIo);
+      if (info->mutex)
+         __PHYSFS_platformDestroyMutex(info->mutex);
+      indexDeinit(info->index);
+      allocator.Free(info->path);
+      info->~MPLinfo();
+      allocator.Free(info);
+   }
+
+   /// Stop writing to the log: it's left with a checkpoint, so the next      
+   /// open doesn't have to replay                                            
+   void detachWriter(MPLinfo* info) {
+#ifndef PHYSFS_NO_THREADS
+      info->stop.store(true, std::memory_order_relaxed);
+      if (info->compactor) {
+         __PHYSFS_platformJoinThread(info->compactor);
+         info->compactor = nullptr;
+      }
+      info->stop.store(false, std::memory_order_relaxed);
+#endif
+
+      __PHYSFS_platformGrabMutex(info->mutex);
+      if (info->appendIo) {
+         if (info->recordsSinceCheckpoint) {
+            try { writeCheckpoint(info); }
+            catch (...) {}
+         }
+         info->appendIo->destroy(info->appendIo);
+         info->appendIo = nullptr;
+      }
+      __PHYSFS_platformReleaseMutex(info->mutex);
+   }
+
+   /// Take a log that's no longer mounted off the list, with the list's      
+   /// lock held                                                              
+   void forgetLog(MPLinfo* info) {
+      auto link = &openLogs;
+      while (*link != info)
+         link = &(*link)->next;
+      *link = info->next;
+   }
+
+   void MPL_closeArchive(void* opaque) {
+      auto handle = static_cast<MPLhandle*>(opaque);
+      auto info = handle->log;
+      if (handle->writer)
+         detachWriter(info);
+      allocator.Free(handle);
+
+      {
+#ifndef PHYSFS_NO_THREADS
+         std::lock_guard lock {openLogsMutex};
+#endif
+         if (--info->refs)
+            return;
+         forgetLog(info);
+      }
+      freeLog(info);
+   }
+
+   /// Load the log behind (io), or start one if (fresh). When writing,       
+   /// (io) is opened for appending, and the log gets a second handle for     
+   /// reading. Either way, (io) is the caller's until this succeeds. With    
+   /// the list's lock held                                                   
+   MPLinfo* openLog(PHYSFS_Io* io, const char* name, bool forWriting, bool fresh, PHYSFS_uint64 length, int* claimed) {
+      auto info = static_cast<MPLinfo*>(allocator.Malloc(sizeof(MPLinfo), PHYSFS_ALLOC_DIRTREE));
+      BAIL_IF(not info, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+      memset(static_cast<void*>(info), 0, sizeof(MPLinfo));
+      new (info) MPLinfo {};
+
+      bool ok = false;
+      try {
+         info->readIo = forWriting ? __PHYSFS_createNativeIo(name, 'r') : io;
+         PHYSFS_uint32 sig = 0;
+         if (not fresh) {
+            ok = info->readIo->seek(info->readIo, 0) and __PHYSFS_readAll(info->readIo, &sig, sizeof(sig));
+            ok = ok and PHYSFS_swapLE(sig) == MPL_SIG;
+         }
+
+         if (ok or fresh) {
+            *claimed = 1;
+            if (fresh) {
+               info->salt = makeSalt(info);
+               info->end = MPL_HEADER_SIZE;
+               ok = indexInit(info->index) and writeHeader(io, info->salt, 0) and io->flush(io);
+            }
+            else ok = logLoad(info->readIo, length, info->salt, info->index, info->end);
+
+            if (ok) {
+               info->mutex = __PHYSFS_platformCreateMutex();
+               info->path = static_cast<char*>(allocator.Malloc(strlen(name) + 1));
+               ok = info->mutex and info->path;
+               if (ok)
+                  strcpy(info->path, name);
+            }
+         }
+      }
+      catch (...) {
+         ok = false;
+      }
+
+      if (not ok) {
+         if (not forWriting)
+            info->readIo = nullptr;
+         freeLog(info);
+         BAIL_IF(not *claimed, PHYSFS_ERR_UNSUPPORTED, nullptr);
+         BAIL(PHYSFS_ERR_CORRUPT, nullptr);
+      }
+
+      info->next = openLogs;
+      openLogs = info;
+      return info;
+   }
+
+   void* MPL_openArchive(PHYSFS_Io* io, const char* name, int forWriting, int* claimed) {
+      assert(io != nullptr);  // Shouldn't ever happen
+      const auto length = io->length(io);
+      BAIL_IF_ERRPASS(length < 0, nullptr);
+
+      // Only a file that says it's a log, by name, is made into one    
+      const char* ext = name ? strrchr(name, '.') : nullptr;
+      const bool fresh = length == 0 and forWriting and ext and PHYSFS_utf8stricmp(ext + 1, "mpl") == 0;
+      BAIL_IF(length < MPL_HEADER_SIZE and not fresh, PHYSFS_ERR_UNSUPPORTED, nullptr);
+
+      auto handle = static_cast<MPLhandle*>(allocator.Malloc(sizeof(MPLhandle), PHYSFS_ALLOC_DIRTREE));
+      BAIL_IF(not handle, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+      handle->writer = forWriting;
+
+      // Held throughout, so two mounts of one log can't both load it   
+#ifndef PHYSFS_NO_THREADS
+      std::lock_guard lock {openLogsMutex};
+#endif
+      auto info = openLogs;
+      while (info and (not name or strcmp(info->path, name) != 0))
+         info = info->next;
+
+      if (info and forWriting) {
+         __PHYSFS_platformGrabMutex(info->mutex);
+         const auto busy = info->appendIo != nullptr;
+         __PHYSFS_platformReleaseMutex(info->mutex);
+         if (busy) {
+            allocator.Free(handle);
+            BAIL(PHYSFS_ERR_BUSY, nullptr);
+         }
+      }
+
+      if (not info) {
+         try { info = openLog(io, name, forWriting, fresh, PHYSFS_uint64(length), claimed); }
+         catch (...) {}
+         if (not info) {
+            allocator.Free(handle);
+            return nullptr;
+         }
+      }
+      else if (not forWriting) {
+         // The log's own handle does all the reading                   
+         io->destroy(io);
+      }
+      *claimed = 1;
+
+      if (forWriting) {
+         // Whatever follows the last good record is a torn write, the  
+         // next record goes over it. A log that's already mounted becomes
+         // writable for everyone                                       
+         __PHYSFS_platformGrabMutex(info->mutex);
+         bool ok = false;
+         try { ok = io->seek(io, info->end); }
+         catch (...) {}
+         if (ok)
+            info->appendIo = io;
+         __PHYSFS_platformReleaseMutex(info->mutex);
+
+         if (not ok) {
+            allocator.Free(handle);
+            if (not info->refs) {
+               forgetLog(info);
+               freeLog(info);
+            }
+            BAIL(PHYSFS_ERR_IO, nullptr);
+         }
+      }
+
+      ++info->refs;
+      handle->log = info;
+      return handle;
+   }
+
+   /// Names are copied out before the callback runs, so it's free to         
+   /// change the pack                                                        
+   PHYSFS_EnumerateCallbackResult MPL_enumerate(
+      void* opaque, const char* dname, PHYSFS_EnumerateCallback cb,
+      const char* origdir, void* callbackdata
+   ) {
+      auto info = static_cast<MPLhandle*>(opaque)->log;
+      __PHYSFS_platformGrabMutex(info->mutex);
+      const auto& index = info->index;
+      const auto dir = indexFind(index, dname);
+      BAIL_IF_MUTEX(dir == MPL_NONE, PHYSFS_ERR_NOT_FOUND, info->mutex, PHYSFS_ENUM_ERROR);
+      BAIL_IF_MUTEX(not index.nodes[dir].isdir, PHYSFS_ERR_NOT_A_FILE, info->mutex, PHYSFS_ENUM_ERROR);
+
+      size_t size = 0;
+      for (auto i = index.nodes[dir].firstChild; i != MPL_NONE; i = index.nodes[i].nextSibling)
+         size += strlen(strrchr(index.nodes[i].path, '/') ? strrchr(index.nodes[i].path, '/') + 1 : index.nodes[i].path) + 1;
+
+      auto names = static_cast<char*>(allocator.Malloc(std::max<size_t>(size, 1)));
+      BAIL_IF_MUTEX(not names, PHYSFS_ERR_OUT_OF_MEMORY, info->mutex, PHYSFS_ENUM_ERROR);
+      auto at = names;
+      for (auto i = index.nodes[dir].firstChild; i != MPL_NONE; i = index.nodes[i].nextSibling) {
+         const char* leaf = strrchr(index.nodes[i].path, '/');
+         leaf = leaf ? leaf + 1 : index.nodes[i].path;
+         const auto len = strlen(leaf) + 1;
+         memcpy(at, leaf, len);
+         at += len;
+      }
+      __PHYSFS_platformReleaseMutex(info->mutex);
+
+      auto retval = PHYSFS_ENUM_OK;
+      try {
+         for (const char* name = names; name < names + size and retval == PHYSFS_ENUM_OK; name += strlen(name) + 1)
+            retval = cb(callbackdata, origdir, name);
+      }
+      catch (...) {
+         allocator.Free(names);
+         throw;
+      }
+
+      allocator.Free(names);
+      BAIL_IF(retval == PHYSFS_ENUM_ERROR, PHYSFS_ERR_APP_CALLBACK, retval);
+      return retval;
+   }
+
+   PHYSFS_Io* MPL_openRead(void* opaque, const char* name) {
+      auto info = static_cast<MPLhandle*>(opaque)->log;
+      __PHYSFS_platformGrabMutex(info->mutex);
+      const auto id = indexFind(info->index, name);
+      BAIL_IF_MUTEX(id == MPL_NONE, PHYSFS_ERR_NOT_FOUND, info->mutex, nullptr);
+      const auto& node = info->index.nodes[id];
+      BAIL_IF_MUTEX(node.isdir, PHYSFS_ERR_NOT_A_FILE, info->mutex, nullptr);
+      BAIL_IF_MUTEX(not info->readIo, PHYSFS_ERR_IO, info->mutex, nullptr);
+
+      PHYSFS_Io* retval = nullptr;
+      try { retval = openSourceReader(info->readIo, node.extents, node.extentCount, node.size); }
+      catch (...) {}
+      __PHYSFS_platformReleaseMutex(info->mutex);
+      return retval;
+   }
+
+   PHYSFS_Io* MPL_openWrite(void* opaque, const char* name) {
+      return openWriter(static_cast<MPLhandle*>(opaque)->log, name, false);
+   }
+
+   PHYSFS_Io* MPL_openAppend(void* opaque, const char* name) {
+      return openWriter(static_cast<MPLhandle*>(opaque)->log, name, true);
+   }
+
+   int MPL_remove(void* opaque, const char* name) {
+      return append(static_cast<MPLhandle*>(opaque)->log, MPL_REMOVE, name, nullptr, 0);
+   }
+
+   int MPL_mkdir(void* opaque, const char* name) {
+      return append(static_cast<MPLhandle*>(opaque)->log, MPL_MKDIR, name, nullptr, 0);
+   }
+
+   /// MAKE SURE you hold the log's mutex before calling this!                
+   void statNode(const MPLhandle* handle, const MPLnode& node, PHYSFS_Stat* stat) {
+      stat->filetype = node.isdir ? PHYSFS_FILETYPE_DIRECTORY : PHYSFS_FILETYPE_REGULAR;
+      stat->filesize = node.isdir ? 0 : static_cast<PHYSFS_sint64>(node.size);
+      stat->modtime = node.mtime;
+      stat->createtime = node.mtime;
+      stat->accesstime = -1;
+      stat->readonly = handle->writer ? 0 : 1;
+   }
+
+   /// Not finding (name) isn't exceptional here: mkdir probes every path     
+   /// component with stat first                                              
+   int MPL_stat(void* opaque, const char* name, PHYSFS_Stat* stat) {
+      auto info = static_cast<MPLhandle*>(opaque)->log;
+      __PHYSFS_platformGrabMutex(info->mutex);
+      const auto id = indexFind(info->index, name);
+      BAIL_IF_MUTEX(id == MPL_NONE, PHYSFS_ERR_NOT_FOUND, info->mutex, 0);
+
+      statNode(static_cast<MPLhandle*>(opaque), info->index.nodes[id], stat);
+      __PHYSFS_platformReleaseMutex(info->mutex);
+      return 1;
+   }
+
+   /// A file rewritten in parts is spread over several extents; the layout   
+   /// given is where the first one starts, and what they add up to           
+   int MPL_statEx(void* opaque, const char* name, PHYSFS_StatEx* stat) {
+      auto info = static_cast<MPLhandle*>(opaque)->log;
+      __PHYSFS_platformGrabMutex(info->mutex);
+      const auto id = indexFind(info->index, name);
+      BAIL_IF_MUTEX(id == MPL_NONE, PHYSFS_ERR_NOT_FOUND, info->mutex, 0);
+
+      const auto& node = info->index.nodes[id];
+      statNode(static_cast<MPLhandle*>(opaque), node, &stat->stat);
+      if (not node.isdir) {
+         if (node.extentCount)
+            stat->offset = static_cast<PHYSFS_sint64>(node.extents[0].offset);
+         stat->storedSize = static_cast<PHYSFS_sint64>(node.size);
+         stat->compression = PHYSFS_COMPRESSION_NONE;
+         stat->contiguous = node.extentCount <= 1;
+         stat->mappable = stat->contiguous;
+      }
+      __PHYSFS_platformReleaseMutex(info->mutex);
+      return 1;
+   }
+}
+
+const PHYSFS_Archiver __PHYSFS_Archiver_MPL = {
+    CURRENT_PHYSFS_ARCHIVER_API_VERSION, {
+        "MPL",
+        "MetaPhysFS writable pack log",
+        "MetaPhysFS contributors",
+        "https://github.com/Epixu/metaphysfs",
+        0,  /* supportsSymlinks */
+    },
+    MPL_openArchive,
+    MPL_enumerate,
+    MPL_openRead,
+    MPL_openWrite,
+    MPL_openAppend,
+    MPL_remove,
+    MPL_mkdir,
+    MPL_stat,
+    MPL_closeArchive,
+    MPL_statEx,
+    0  /* concurrentOpenRead */
+};
@@ -35,7 +35,7 @@
 namespace
 {
    int mvlLoadEntries(
-      PHYSFS_Io* io, const PHYSFS_uint32 count, void* arc
+      UNPK_TableReader& table, const PHYSFS_uint32 count, void* arc
    ) {
       PHYSFS_uint32 pos = 8 + (17 * count);   /* past sig+metadata. */
       PHYSFS_uint32 i;
@@ -43,10 +43,9 @@ namespace
       for (i = 0; i < count; i++) {
          PHYSFS_uint32 size;
          char name[13];
-         BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, name, 13), 0);
-         BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &size, 4), 0);
+         BAIL_IF_ERRPASS(!table.read(name, 13), 0);
+         BAIL_IF_ERRPASS(!table.readui32(&size), 0);
          name[12] = '\0';  /* just in case. */
-         size = PHYSFS_swapLE(size);
          BAIL_IF_ERRPASS(!UNPK_addEntry(arc, name, 0, -1, -1, pos, size), 0);
          pos += size;
       }
@@ -71,10 +70,11 @@ namespace
       BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &count, sizeof(count)), nullptr);
       count = PHYSFS_swapLE(count);
 
+      UNPK_TableReader table {io, 17 * PHYSFS_uint64(count)};
       unpkarc = UNPK_openArchive(io, 0, 1);
       BAIL_IF_ERRPASS(!unpkarc, nullptr);
 
-      if (!mvlLoadEntries(io, count, unpkarc)) {
+      if (!mvlLoadEntries(table, count, unpkarc)) {
          UNPK_abandonArchive(unpkarc);
          return nullptr;
       }
@@ -99,5 +99,7 @@ const PHYSFS_Archiver __PHYSFS_Archiver_MVL = {
    UNPK_remove,
    UNPK_mkdir,
    UNPK_stat,
-   UNPK_closeArchive
+   UNPK_closeArchive,
+   UNPK_statEx,
+   0  /* concurrentOpenRead */
 };
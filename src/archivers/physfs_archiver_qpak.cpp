@@ -29,6 +29,7 @@
 ///  This file written by Ryan C. Gordon.                                     
 ///                                                                           
 #include "physfs_internal.hpp"
+#include "physfs_unpk.hpp"
 #include <cassert>
 
 
@@ -36,17 +37,15 @@ constexpr PHYSFS_uint32 QPAK_SIG = 0x4B434150;   // "PACK" in ASCII
 
 namespace
 {
-   int qpakLoadEntries(PHYSFS_Io* io, const PHYSFS_uint32 count, void* arc) {
+   int qpakLoadEntries(UNPK_TableReader& table, const PHYSFS_uint32 count, void* arc) {
       PHYSFS_uint32 i;
       for (i = 0; i < count; i++) {
          PHYSFS_uint32 size;
          PHYSFS_uint32 pos;
          char name[56];
-         BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, name, 56), 0);
-         BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &pos, 4), 0);
-         BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &size, 4), 0);
-         size = PHYSFS_swapLE(size);
-         pos = PHYSFS_swapLE(pos);
+         BAIL_IF_ERRPASS(!table.read(name, 56), 0);
+         BAIL_IF_ERRPASS(!table.readui32(&pos), 0);
+         BAIL_IF_ERRPASS(!table.readui32(&size), 0);
          BAIL_IF_ERRPASS(!UNPK_addEntry(arc, name, 0, -1, -1, pos, size), 0);
       }
 
@@ -81,11 +80,12 @@ namespace
 
       BAIL_IF_ERRPASS(!io->seek(io, pos), nullptr);
 
+      UNPK_TableReader table {io, 64 * PHYSFS_uint64(count)};
       /* !!! FIXME: check case_sensitive and only_usascii params for this archive. */
       unpkarc = UNPK_openArchive(io, 1, 0);
       BAIL_IF_ERRPASS(!unpkarc, nullptr);
 
-      if (!qpakLoadEntries(io, count, unpkarc)) {
+      if (!qpakLoadEntries(table, count, unpkarc)) {
          UNPK_abandonArchive(unpkarc);
          return nullptr;
       }
@@ -112,5 +112,7 @@ const PHYSFS_Archiver __PHYSFS_Archiver_QPAK =
     UNPK_remove,
     UNPK_mkdir,
     UNPK_stat,
-    UNPK_closeArchive
+    UNPK_closeArchive,
+    UNPK_statEx,
+    0  /* concurrentOpenRead */
 };
\ No newline at end of file
@@ -15,9 +15,10 @@
  * Ryan C. Gordon.
  */
 #include "physfs_internal.hpp"
+#include "physfs_unpk.hpp"
 
 
-static int slbLoadEntries(PHYSFS_Io *io, const PHYSFS_uint32 count, void *arc)
+static int slbLoadEntries(UNPK_TableReader &table, const PHYSFS_uint32 count, void *arc)
 {
     PHYSFS_uint32 i;
     for (i = 0; i < count; i++)
@@ -29,11 +30,11 @@ static int slbLoadEntries(PHYSFS_Io *io, const PHYSFS_uint32 count, void *arc)
         char *ptr;
 
         /* don't include the '\' in the beginning */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &backslash, 1), 0);
+        BAIL_IF_ERRPASS(!table.read(&backslash, 1), 0);
         BAIL_IF(backslash != '\\', PHYSFS_ERR_CORRUPT, 0);
 
         /* read the rest of the buffer, 63 bytes */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, name, 63), 0);
+        BAIL_IF_ERRPASS(!table.read(name, 63), 0);
         name[63] = '\0'; /* in case the name lacks the null terminator */
 
         /* convert backslashes */
@@ -43,11 +44,8 @@ static int slbLoadEntries(PHYSFS_Io *io, const PHYSFS_uint32 count, void *arc)
                 *ptr = '/';
         } /* for */
 
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &pos, 4), 0);
-        pos = PHYSFS_swapULE32(pos);
-
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &size, 4), 0);
-        size = PHYSFS_swapULE32(size);
+        BAIL_IF_ERRPASS(!table.readui32(&pos), 0);
+        BAIL_IF_ERRPASS(!table.readui32(&size), 0);
 
         BAIL_IF_ERRPASS(!UNPK_addEntry(arc, name, 0, -1, -1, pos, size), 0);
     } /* for */
@@ -76,26 +74,27 @@ static void *SLB_openArchive(PHYSFS_Io *io, const char *name,
     BAIL_IF(forWriting, PHYSFS_ERR_READ_ONLY, nullptr);
 
     BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &version, sizeof (version)), nullptr);
-    version = PHYSFS_swapULE32(version);
+    version = PHYSFS_swapLE(version);
     BAIL_IF(version != 0, PHYSFS_ERR_UNSUPPORTED, nullptr);
 
     BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &count, sizeof (count)), nullptr);
-    count = PHYSFS_swapULE32(count);
+    count = PHYSFS_swapLE(count);
     BAIL_IF(!count, PHYSFS_ERR_UNSUPPORTED, nullptr);
 
     /* offset of the table of contents */
     BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &tocPos, sizeof (tocPos)), nullptr);
-    tocPos = PHYSFS_swapULE32(tocPos);
+    tocPos = PHYSFS_swapLE(tocPos);
     BAIL_IF(!tocPos, PHYSFS_ERR_UNSUPPORTED, nullptr);
     
     /* seek to the table of contents */
     BAIL_IF_ERRPASS(!io->seek(io, tocPos), nullptr);
 
+    UNPK_TableReader table(io, 72 * (PHYSFS_uint64) count);
     /* !!! FIXME: check case_sensitive and only_usascii params for this archive. */
     unpkarc = UNPK_openArchive(io, 1, 0);
     BAIL_IF_ERRPASS(!unpkarc, nullptr);
 
-    if (!slbLoadEntries(io, count, unpkarc))
+    if (!slbLoadEntries(table, count, unpkarc))
     {
         UNPK_abandonArchive(unpkarc);
         return nullptr;
@@ -125,5 +124,7 @@ const PHYSFS_Archiver __PHYSFS_Archiver_SLB =
     UNPK_remove,
     UNPK_mkdir,
     UNPK_stat,
-    UNPK_closeArchive
+    UNPK_closeArchive,
+    UNPK_statEx,
+    0  /* concurrentOpenRead */
 };
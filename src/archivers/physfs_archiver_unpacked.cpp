@@ -14,11 +14,21 @@
 ///                                                                           
 #include "../physfs_internal.hpp"
 #include "../physfs_tree.hpp"
+#include "../physfs_unpk.hpp"
+#include <algorithm>
 
 
+/// A run of neighboring small files, read in one go (data follows)           
+struct UNPKinline {
+   UNPKinline* next;
+};
+
 struct UNPKinfo {
    __PHYSFS_DirTree tree;
    PHYSFS_Io* io;
+   UNPKinline* inlined;       // every block read by inlineSiblings      
+   PHYSFS_uint64 inlineLeft;  // bytes we may still inline               
+   PHYSFS_uint32 inlineMax;   // largest file to inline, zero if off     
 };
 
 struct UNPKentry {
@@ -27,6 +37,8 @@ struct UNPKentry {
    PHYSFS_uint64 size;
    PHYSFS_sint64 ctime;
    PHYSFS_sint64 mtime;
+   const PHYSFS_uint8* inlined;  // file contents, if inlined           
+   bool inlineTried;             // if dir, were its kids inlined yet   
 };
 
 struct UNPKfileinfo {
@@ -50,6 +62,19 @@ namespace
       return rc;
    }
 
+   /// Entries are stored as-is, so positional reads go straight to the       
+   /// archive, if it can do them                                             
+   PHYSFS_sint64 UNPK_readAt(PHYSFS_Io* io, PHYSFS_uint64 offset, void* buffer, PHYSFS_uint64 len) {
+      auto finfo = static_cast<UNPKfileinfo*>(io->opaque);
+      const auto* entry = finfo->entry;
+      if (offset >= entry->size)
+         return 0;
+
+      if (len > entry->size - offset)
+         len = entry->size - offset;
+      return finfo->io->readAt(finfo->io, entry->startPos + offset, buffer, len);
+   }
+
    PHYSFS_sint64 UNPK_write(PHYSFS_Io*, const void*, PHYSFS_uint64) {
       BAIL(PHYSFS_ERR_READ_ONLY, -1);
    }
@@ -76,12 +101,12 @@ namespace
 
    PHYSFS_Io* UNPK_duplicate(PHYSFS_Io* _io) {
       auto origfinfo = static_cast<UNPKfileinfo*>(_io->opaque);
-      auto finfo = PHYSFS_Allocator<UNPKfileinfo>(1);
+      auto finfo = PHYSFS_Allocator<UNPKfileinfo, PHYSFS_ALLOC_FILEHANDLE>(1);
       finfo->io = origfinfo->io->duplicate(origfinfo->io);
       finfo->entry = origfinfo->entry;
       finfo->curPos = 0;
 
-      auto retval = PHYSFS_Allocator<PHYSFS_Io>(1, *_io);
+      auto retval = PHYSFS_Allocator<PHYSFS_Io, PHYSFS_ALLOC_FILEHANDLE>(1, *_io);
       retval->opaque = finfo.Ref();
       return retval.Ref();
    }
@@ -107,17 +132,99 @@ namespace
       UNPK_length,
       UNPK_duplicate,
       UNPK_flush,
-      UNPK_destroy
+      UNPK_destroy,
+      UNPK_readAt
    };
 
    UNPKentry* findEntry(UNPKinfo* info, const char* path) {
       return (UNPKentry*)__PHYSFS_DirTreeFind(&info->tree, path);
    }
+
+   const PHYSFS_uint8 emptyFile[1] {};
+
+   /// Read all small files in the same directory as (entry) into memory,     
+   /// the first time any of them is opened. Files are taken in archive       
+   /// order, and neighbors that are close enough are read in one go, so a    
+   /// directory of small files costs a handful of reads instead of one       
+   /// per file. The bytes between neighbors count against the budget too.    
+   /// This is only an optimization, so anything that goes wrong just leaves  
+   /// the rest of the files to be read the usual way                         
+   void inlineSiblings(UNPKinfo* info, const UNPKentry* entry) try {
+      auto& tree = info->tree;
+      auto dir = reinterpret_cast<UNPKentry*>(__PHYSFS_DirTreeEntryAt(&tree, entry->tree.parent));
+      if (dir->inlineTried)
+         return;
+      dir->inlineTried = true;
+
+      if (not __PHYSFS_DirTreeFinalize(&tree) or not dir->tree.childCount)
+         return;
+
+      const auto kids = tree.children + dir->tree.children;
+      auto small = PHYSFS_Allocator<UNPKentry*>(dir->tree.childCount);
+      PHYSFS_uint32 count = 0;
+      for (PHYSFS_uint32 i = 0; i < dir->tree.childCount; ++i) {
+         auto kid = reinterpret_cast<UNPKentry*>(__PHYSFS_DirTreeEntryAt(&tree, kids[i]));
+         if (kid->tree.isdir or kid->inlined or kid->size > info->inlineMax)
+            continue;
+         if (kid->size == 0)
+            kid->inlined = emptyFile;
+         else
+            small[count++] = kid;
+      }
+
+      auto first = small.Get();
+      std::sort(first, first + count, [](const UNPKentry* a, const UNPKentry* b) {
+         return a->startPos < b->startPos;
+      });
+
+      for (PHYSFS_uint32 i = 0; i < count;) {
+         // Grow the run while the gap to the next file stays small     
+         const auto start = first[i]->startPos;
+         auto end = start + first[i]->size;
+         if (end - start > info->inlineLeft)
+            return;
+
+         PHYSFS_uint32 last = i + 1;
+         for (; last < count; ++last) {
+            const auto next = first[last];
+            const auto nextEnd = std::max(end, next->startPos + next->size);
+            if (next->startPos > end + info->inlineMax
+            or nextEnd - start > info->inlineLeft)
+               break;
+            end = nextEnd;
+         }
+
+         const auto span = end - start;
+         auto block = static_cast<UNPKinline*>(allocator.Malloc(sizeof(UNPKinline) + span, PHYSFS_ALLOC_CACHE));
+         if (not block)
+            return;
+
+         auto data = reinterpret_cast<PHYSFS_uint8*>(block + 1);
+         if (not info->io->seek(info->io, start)
+         or not __PHYSFS_readAll(info->io, data, static_cast<size_t>(span))) {
+            allocator.Free(block);
+            return;
+         }
+
+         block->next = info->inlined;
+         info->inlined = block;
+         info->inlineLeft -= span;
+         for (; i < last; ++i)
+            first[i]->inlined = data + (first[i]->startPos - start);
+      }
+   }
+   catch (...) {}
 }
 
 void UNPK_closeArchive(void* opaque) {
    auto info = static_cast<UNPKinfo*>(opaque);
    if (info) {
+      while (info->inlined) {
+         auto next = info->inlined->next;
+         allocator.Free(info->inlined);
+         info->inlined = next;
+      }
+
       __PHYSFS_DirTreeDeinit(&info->tree);
       if (info->io)
          info->io->destroy(info->io);
@@ -139,13 +246,20 @@ PHYSFS_Io* UNPK_openRead(void* opaque, const char* name) {
    BAIL_IF_ERRPASS(not entry, nullptr);
    BAIL_IF(entry->tree.isdir, PHYSFS_ERR_NOT_A_FILE, nullptr);
 
-   auto finfo  = PHYSFS_Allocator<UNPKfileinfo>(1);
+   if (not entry->inlined and entry->size <= info->inlineMax)
+      inlineSiblings(info, entry);
+   if (entry->inlined)
+      return __PHYSFS_createMemoryIo(entry->inlined, entry->size, nullptr);
+
+   auto finfo  = PHYSFS_Allocator<UNPKfileinfo, PHYSFS_ALLOC_FILEHANDLE>(1);
    finfo->io = info->io->duplicate(info->io);
    finfo->io->seek(finfo->io, entry->startPos);
    finfo->curPos = 0;
    finfo->entry = entry;
 
-   auto retval = PHYSFS_Allocator<PHYSFS_Io>(1, UNPK_Io);
+   auto retval = PHYSFS_Allocator<PHYSFS_Io, PHYSFS_ALLOC_FILEHANDLE>(1, UNPK_Io);
+   if (not __PHYSFS_ioCanReadAt(finfo->io))
+      retval->readAt = nullptr;
    retval->opaque = finfo.Ref();
    return retval.Ref();
 }
@@ -187,6 +301,21 @@ int UNPK_stat(void* opaque, const char* path, PHYSFS_Stat* stat) {
    return 1;
 }
 
+/// Files in these formats are stored whole and as-is                         
+int UNPK_statEx(void* opaque, const char* path, PHYSFS_StatEx* stat) {
+   BAIL_IF_ERRPASS(not UNPK_stat(opaque, path, &stat->stat), 0);
+   if (stat->stat.filetype == PHYSFS_FILETYPE_DIRECTORY)
+      return 1;
+
+   const auto* entry = findEntry(static_cast<UNPKinfo*>(opaque), path);
+   stat->offset = entry->startPos;
+   stat->storedSize = entry->size;
+   stat->compression = PHYSFS_COMPRESSION_NONE;
+   stat->contiguous = 1;
+   stat->mappable = 1;
+   return 1;
+}
+
 void* UNPK_addEntry(
    void* opaque, char* name, const int isdir,
    const PHYSFS_sint64 ctime, const PHYSFS_sint64 mtime,
@@ -203,9 +332,86 @@ void* UNPK_addEntry(
    return entry;
 }
 
+UNPK_TableReader::UNPK_TableReader(PHYSFS_Io* io, PHYSFS_uint64 expected) : io {io} {
+   const auto pos = io->tell(io);
+   const auto len = io->length(io);
+   if (pos < 0 or len < pos)
+      return;  // Every read fails, the way the io's would             
+
+   base = static_cast<PHYSFS_uint64>(pos);
+   end = static_cast<PHYSFS_uint64>(len);
+
+   // Counts in a corrupt header can promise more table than there is   
+   if (expected > end - base)
+      expected = end - base;
+   capacity = expected ? static_cast<size_t>(std::min<PHYSFS_uint64>(expected, MaxWindow)) : SectorWindow;
+   buffer = static_cast<PHYSFS_uint8*>(allocator.Malloc(capacity));
+   if (not buffer)
+      MetaPhysFS::Throw<PHYSFS_ERR_OUT_OF_MEMORY>();
+}
+
+UNPK_TableReader::~UNPK_TableReader() {
+   allocator.Free(buffer);
+}
+
+/// Fetch the next window, starting right after the current one               
+int UNPK_TableReader::refill() {
+   base += fill;
+   fill = cursor = 0;
+   BAIL_IF_ERRPASS(not buffer or base >= end, 0);
+
+   const auto want = std::min<PHYSFS_uint64>(capacity, end - base);
+   PHYSFS_sint64 got;
+   if (__PHYSFS_ioCanReadAt(io))
+      got = io->readAt(io, base, buffer, want);
+   else {
+      BAIL_IF_ERRPASS(not io->seek(io, base), 0);
+      got = io->read(io, buffer, want);
+   }
+
+   BAIL_IF_ERRPASS(got <= 0, 0);
+   fill = static_cast<size_t>(got);
+   return 1;
+}
+
+int UNPK_TableReader::read(void* buf, size_t len) {
+   auto out = static_cast<PHYSFS_uint8*>(buf);
+   while (len) {
+      if (cursor == fill)
+         BAIL_IF_ERRPASS(not refill(), 0);
+
+      const auto n = std::min(len, fill - cursor);
+      memcpy(out, buffer + cursor, n);
+      cursor += n;
+      out += n;
+      len -= n;
+   }
+   return 1;
+}
+
+int UNPK_TableReader::readui32(PHYSFS_uint32* val) {
+   PHYSFS_uint32 v;
+   BAIL_IF_ERRPASS(not read(&v, sizeof(v)), 0);
+   *val = PHYSFS_swapLE(v);
+   return 1;
+}
+
+/// Like a seek on most ios, going past the end only fails the next read      
+int UNPK_TableReader::seek(PHYSFS_uint64 pos) {
+   if (pos >= base and pos - base <= fill)
+      cursor = static_cast<size_t>(pos - base);
+   else {
+      // The next read fetches a window starting here                   
+      base = pos;
+      fill = cursor = 0;
+   }
+   return 1;
+}
+
 void* UNPK_openArchive(PHYSFS_Io* io, const int case_sensitive, const int only_usascii) {
    auto info = PHYSFS_Allocator<UNPKinfo>(1);
    __PHYSFS_DirTreeInit(&info->tree, sizeof(UNPKentry), case_sensitive, only_usascii);
    info->io = io;
+   info->inlineMax = __PHYSFS_inlineMaxFileSize(&info->inlineLeft);
    return info.Ref();
 }
\ No newline at end of file
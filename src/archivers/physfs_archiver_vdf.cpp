@@ -9,6 +9,7 @@
  *  by Ryan C. Gordon and the works of degenerated1123 and Nico Bendlin.
  */
 #include "physfs_internal.hpp"
+#include "physfs_unpk.hpp"
 #include <time.h>
 
 #define VDF_COMMENT_LENGTH 256
@@ -24,7 +25,7 @@ static inline int readui32(PHYSFS_Io *io, PHYSFS_uint32 *val)
 {
     PHYSFS_uint32 v;
     BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &v, sizeof (v)), 0);
-    *val = PHYSFS_swapULE32(v);
+    *val = PHYSFS_swapLE(v);
     return 1;
 } /* readui32 */
 
@@ -45,7 +46,7 @@ static PHYSFS_sint64 vdfDosTimeToEpoch(const PHYSFS_uint32 dostime)
 } /* vdfDosTimeToEpoch */
 
 
-static int vdfLoadEntries(PHYSFS_Io *io, const PHYSFS_uint32 count,
+static int vdfLoadEntries(UNPK_TableReader &table, const PHYSFS_uint32 count,
                           const PHYSFS_sint64 ts, void *arc)
 {
     PHYSFS_uint32 i;
@@ -56,11 +57,11 @@ static int vdfLoadEntries(PHYSFS_Io *io, const PHYSFS_uint32 count,
         int namei;
         PHYSFS_uint32 jump, size, type, attr;
 
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, name, sizeof (name) - 1), 0);
-        BAIL_IF_ERRPASS(!readui32(io, &jump), 0);
-        BAIL_IF_ERRPASS(!readui32(io, &size), 0);
-        BAIL_IF_ERRPASS(!readui32(io, &type), 0);
-        BAIL_IF_ERRPASS(!readui32(io, &attr), 0);
+        BAIL_IF_ERRPASS(!table.read(name, sizeof (name) - 1), 0);
+        BAIL_IF_ERRPASS(!table.readui32(&jump), 0);
+        BAIL_IF_ERRPASS(!table.readui32(&size), 0);
+        BAIL_IF_ERRPASS(!table.readui32(&type), 0);
+        BAIL_IF_ERRPASS(!table.readui32(&attr), 0);
 
         /* Trim whitespace off the end of the filename */
         name[VDF_ENTRY_NAME_LENGTH] = '\0';  /* always null-terminated. */
@@ -124,11 +125,12 @@ static void *VDF_openArchive(PHYSFS_Io *io, const char *name,
 
     BAIL_IF_ERRPASS(!io->seek(io, rootCatOffset), nullptr);
 
+    UNPK_TableReader table(io, (VDF_ENTRY_NAME_LENGTH + 16) * (PHYSFS_uint64) count);
     /* !!! FIXME: check case_sensitive and only_usascii params for this archive. */
     unpkarc = UNPK_openArchive(io, 1, 0);
     BAIL_IF_ERRPASS(!unpkarc, nullptr);
 
-    if (!vdfLoadEntries(io, count, vdfDosTimeToEpoch(timestamp), unpkarc))
+    if (!vdfLoadEntries(table, count, vdfDosTimeToEpoch(timestamp), unpkarc))
     {
         UNPK_abandonArchive(unpkarc);
         return nullptr;
@@ -156,5 +158,7 @@ const PHYSFS_Archiver __PHYSFS_Archiver_VDF =
     UNPK_remove,
     UNPK_mkdir,
     UNPK_stat,
-    UNPK_closeArchive
+    UNPK_closeArchive,
+    UNPK_statEx,
+    0  /* concurrentOpenRead */
 };
@@ -42,9 +42,10 @@
  *  Ryan C. Gordon.
  */
 #include "physfs_internal.hpp"
+#include "physfs_unpk.hpp"
 
 
-static int wadLoadEntries(PHYSFS_Io *io, const PHYSFS_uint32 count, void *arc)
+static int wadLoadEntries(UNPK_TableReader &table, const PHYSFS_uint32 count, void *arc)
 {
     PHYSFS_uint32 i;
     for (i = 0; i < count; i++)
@@ -53,13 +54,11 @@ static int wadLoadEntries(PHYSFS_Io *io, const PHYSFS_uint32 count, void *arc)
         PHYSFS_uint32 size;
         char name[9];
 
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &pos, 4), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &size, 4), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, name, 8), 0);
+        BAIL_IF_ERRPASS(!table.readui32(&pos), 0);
+        BAIL_IF_ERRPASS(!table.readui32(&size), 0);
+        BAIL_IF_ERRPASS(!table.read(name, 8), 0);
 
         name[8] = '\0'; /* name might not be null-terminated in file. */
-        size = PHYSFS_swapULE32(size);
-        pos = PHYSFS_swapULE32(pos);
         BAIL_IF_ERRPASS(!UNPK_addEntry(arc, name, 0, -1, -1, pos, size), 0);
     } /* for */
 
@@ -85,17 +84,18 @@ static void *WAD_openArchive(PHYSFS_Io *io, const char *name,
     *claimed = 1;
 
     BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &count, sizeof (count)), nullptr);
-    count = PHYSFS_swapULE32(count);
+    count = PHYSFS_swapLE(count);
 
     BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &directoryOffset, 4), 0);
-    directoryOffset = PHYSFS_swapULE32(directoryOffset);
+    directoryOffset = PHYSFS_swapLE(directoryOffset);
 
     BAIL_IF_ERRPASS(!io->seek(io, directoryOffset), 0);
 
+    UNPK_TableReader table(io, 16 * (PHYSFS_uint64) count);
     unpkarc = UNPK_openArchive(io, 0, 1);
     BAIL_IF_ERRPASS(!unpkarc, nullptr);
 
-    if (!wadLoadEntries(io, count, unpkarc))
+    if (!wadLoadEntries(table, count, unpkarc))
     {
         UNPK_abandonArchive(unpkarc);
         return nullptr;
@@ -123,5 +123,7 @@ const PHYSFS_Archiver __PHYSFS_Archiver_WAD =
     UNPK_remove,
     UNPK_mkdir,
     UNPK_stat,
-    UNPK_closeArchive
+    UNPK_closeArchive,
+    UNPK_statEx,
+    0  /* concurrentOpenRead */
 };
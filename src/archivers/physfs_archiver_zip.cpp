@@ -7,8 +7,13 @@
  *   by Gilles Vollant.
  */
 #include "physfs_internal.hpp"
+#include "physfs_tree.hpp"
+#include "physfs_crypto.hpp"
 #include <errno.h>
 #include <time.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
 
 #if (PHYSFS_BYTEORDER == PHYSFS_LIL_ENDIAN)
    #define MINIZ_LITTLE_ENDIAN 1
@@ -32,6 +37,22 @@
  */
 #define ZIP_READBUFSIZE   (16 * 1024)
 
+/*
+ * Size of the window that METAPHYSFS_ZIP_EAGER_RESOLVE reads local headers
+ *  through at mount time. Headers of small files tend to sit close together,
+ *  so one window usually covers a lot of them.
+ */
+#define ZIP_EAGER_BUFSIZE (256 * 1024)
+
+/*
+ * Compressed entries at least PHYSFS_setReadAhead() bytes long get their
+ *  packed data read ahead on a helper thread, ZIP_READAHEAD_CHUNKS chunks of
+ *  ZIP_READAHEAD_CHUNK bytes deep, so the next few buffers' worth is usually
+ *  waiting by the time inflate asks for it.
+ */
+#define ZIP_READAHEAD_CHUNK  (ZIP_READBUFSIZE * 4)
+#define ZIP_READAHEAD_CHUNKS 3
+
 
 /*
  * Entries are "unresolved" until they are first opened. At that time,
@@ -40,6 +61,15 @@
  *  followed and optimized. This means that we don't seek and read around the
  *  archive until forced to do so, and after the first time, we had to do
  *  less reading and parsing, which is very CD-ROM friendly.
+ *
+ * Opens may run concurrently, so the resolve state is only ever read and
+ *  written through atomics. ZIP_RESOLVED and ZIP_DIRECTORY are final and
+ *  published after everything else in the entry is, so an open that sees
+ *  one of them needs no lock at all. Everything else goes through the
+ *  archive's resolve_lock, which makes sure each entry is resolved once.
+ *
+ * If METAPHYSFS_ZIP_EAGER_RESOLVE is defined, all entries are resolved while
+ *  mounting instead, reading the local headers in archive order.
  */
 typedef enum
 {
@@ -66,11 +96,13 @@ typedef struct _ZIPentry
     PHYSFS_uint16 version_needed;       /* version needed to extract      */
     PHYSFS_uint16 general_bits;         /* general purpose bits           */
     PHYSFS_uint16 compression_method;   /* compression method             */
+    PHYSFS_uint8 aes_strength;          /* 1-3 for WinZip AES-128/192/256 */
     PHYSFS_uint32 crc;                  /* crc-32                         */
     PHYSFS_uint64 compressed_size;      /* compressed size                */
     PHYSFS_uint64 uncompressed_size;    /* uncompressed size              */
     PHYSFS_sint64 last_mod_time;        /* last file mod time             */
     PHYSFS_uint32 dos_mod_time;         /* original MS-DOS style mod time */
+    const PHYSFS_uint8 *inlined;        /* uncompressed data, if inlined  */
 } ZIPentry;
 
 /*
@@ -82,8 +114,25 @@ typedef struct
     PHYSFS_Io *io;            /* the i/o interface for this archive.    */
     int zip64;                /* non-zero if this is a Zip64 archive.   */
     int has_crypto;           /* non-zero if any entry uses encryption. */
+    void *resolve_lock;       /* serializes first-time entry resolution. */
+    PHYSFS_uint8 *inline_data; /* small entries, see zip_inline_small. */
 } ZIPinfo;
 
+/*
+ * Decryption state of an open WinZip AES entry. Only allocated for those,
+ *  the key schedule and both HMAC states being rather big.
+ */
+typedef struct
+{
+    __PHYSFS_AesKey key;                  /* expanded AES key.          */
+    __PHYSFS_HmacSha1 initial_mac;        /* keyed MAC, before any data. */
+    __PHYSFS_HmacSha1 mac;                /* MAC of the data read so far. */
+    PHYSFS_uint64 start;                  /* archive offset of the data. */
+    PHYSFS_uint64 size;                   /* encrypted data length.     */
+    PHYSFS_uint64 pos;                    /* position in encrypted data. */
+    int authenticating;                   /* read in order from pos 0?  */
+} ZIPaesinfo;
+
 /*
  * One ZIPfileinfo is kept for each open file in a ZIP archive.
  */
@@ -96,22 +145,33 @@ typedef struct
     PHYSFS_uint8 *buffer;                 /* decompression buffer.      */
     PHYSFS_uint32 crypto_keys[3];         /* for "traditional" crypto.  */
     PHYSFS_uint32 initial_crypto_keys[3]; /* for "traditional" crypto.  */
+    ZIPaesinfo *aes;                      /* for WinZip AES, or nullptr. */
     z_stream stream;                      /* zlib stream state.         */
 } ZIPfileinfo;
 
 
 /* Magic numbers... */
 #define ZIP_LOCAL_FILE_SIG                          0x04034b50
+#define ZIP_LOCAL_FILE_HEADER_SIZE                  30
 #define ZIP_CENTRAL_DIR_SIG                         0x02014b50
 #define ZIP_END_OF_CENTRAL_DIR_SIG                  0x06054b50
 #define ZIP64_END_OF_CENTRAL_DIR_SIG                0x06064b50
 #define ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR_SIG  0x07064b50
 #define ZIP64_EXTENDED_INFO_EXTRA_FIELD_SIG         0x0001
+#define ZIP_WINZIP_AES_EXTRA_FIELD_SIG              0x9901
+#define ZIP_WINZIP_AES_VENDOR_ID                    0x4541  /* "AE" */
 
 /* compression methods... */
 #define COMPMETH_NONE 0
+#define COMPMETH_DEFLATE 8
+#define COMPMETH_AES 99  /* WinZip AES; the real method is in an extra field. */
 /* ...and others... */
 
+/* WinZip AES (AE-1 and AE-2) layout. */
+#define ZIP_AES_VERIFIER_SIZE  2
+#define ZIP_AES_AUTHCODE_SIZE  10
+#define ZIP_AES_ITERATIONS     1000
+
 
 #define UNIX_FILETYPE_MASK    0170000
 #define UNIX_FILETYPE_SYMLINK 0120000
@@ -119,10 +179,20 @@ typedef struct
 #define ZIP_GENERAL_BITS_TRADITIONAL_CRYPTO   (1 << 0)
 #define ZIP_GENERAL_BITS_IGNORE_LOCAL_HEADER  (1 << 3)
 
-/* support for "traditional" PKWARE encryption. */
-static int zip_entry_is_tradional_crypto(const ZIPentry *entry)
+/* support for "traditional" PKWARE encryption, and WinZip's AES. */
+static int zip_entry_is_encrypted(const ZIPentry *entry)
 {
     return (entry->general_bits & ZIP_GENERAL_BITS_TRADITIONAL_CRYPTO) != 0;
+} /* zip_entry_is_encrypted */
+
+static int zip_entry_is_aes(const ZIPentry *entry)
+{
+    return zip_entry_is_encrypted(entry) && (entry->aes_strength != 0);
+} /* zip_entry_is_aes */
+
+static int zip_entry_is_tradional_crypto(const ZIPentry *entry)
+{
+    return zip_entry_is_encrypted(entry) && (entry->aes_strength == 0);
 } /* zip_entry_is_traditional_crypto */
 
 static int zip_entry_ignore_local_header(const ZIPentry *entry)
@@ -130,16 +200,28 @@ static int zip_entry_ignore_local_header(const ZIPentry *entry)
     return (entry->general_bits & ZIP_GENERAL_BITS_IGNORE_LOCAL_HEADER) != 0;
 } /* zip_entry_is_traditional_crypto */
 
-static PHYSFS_uint32 zip_crypto_crc32(const PHYSFS_uint32 crc, const PHYSFS_uint8 val)
+/*
+ * The traditional cipher runs two CRC-32 steps per byte, so it gets the
+ *  usual table instead of eight shifts a step.
+ */
+static constexpr std::array<PHYSFS_uint32, 256> zip_crypto_crc_table = [] {
+    std::array<PHYSFS_uint32, 256> table {};
+    for (PHYSFS_uint32 i = 0; i < 256; i++)
+    {
+        PHYSFS_uint32 xorval = i;
+        for (int j = 0; j < 8; j++)
+            xorval = ((xorval & 1) ? (0xEDB88320 ^ (xorval >> 1)) : (xorval >> 1));
+        table[i] = xorval;
+    } /* for */
+    return table;
+}();
+
+static inline PHYSFS_uint32 zip_crypto_crc32(const PHYSFS_uint32 crc, const PHYSFS_uint8 val)
 {
-    int i;
-    PHYSFS_uint32 xorval = (crc ^ ((PHYSFS_uint32) val)) & 0xFF;
-    for (i = 0; i < 8; i++)
-        xorval = ((xorval & 1) ? (0xEDB88320 ^ (xorval >> 1)) : (xorval >> 1));
-    return xorval ^ (crc >> 8);
+    return zip_crypto_crc_table[(crc ^ val) & 0xFF] ^ (crc >> 8);
 } /* zip_crc32 */
 
-static void zip_update_crypto_keys(PHYSFS_uint32 *keys, const PHYSFS_uint8 val)
+static inline void zip_update_crypto_keys(PHYSFS_uint32 *keys, const PHYSFS_uint8 val)
 {
     keys[0] = zip_crypto_crc32(keys[0], val);
     keys[1] = keys[1] + (keys[0] & 0x000000FF);
@@ -147,34 +229,82 @@ static void zip_update_crypto_keys(PHYSFS_uint32 *keys, const PHYSFS_uint8 val)
     keys[2] = zip_crypto_crc32(keys[2], (PHYSFS_uint8) ((keys[1] >> 24) & 0xFF));
 } /* zip_update_crypto_keys */
 
-static PHYSFS_uint8 zip_decrypt_byte(const PHYSFS_uint32 *keys)
+static inline PHYSFS_uint8 zip_decrypt_byte(const PHYSFS_uint32 *keys)
 {
-    const PHYSFS_uint16 tmp = keys[2] | 2;
+    /* unsigned, or the multiply overflows an int for big enough keys. */
+    const PHYSFS_uint32 tmp = (keys[2] | 2) & 0xFFFF;
     return (PHYSFS_uint8) ((tmp * (tmp ^ 1)) >> 8);
 } /* zip_decrypt_byte */
 
+/* Decrypt (len) bytes in place. The keys live in locals for the loop, so
+   the compiler doesn't have to reload them after every store to (ptr). */
+static void zip_decrypt_block(PHYSFS_uint32 *_keys, PHYSFS_uint8 *ptr, PHYSFS_uint64 len)
+{
+    PHYSFS_uint32 keys[3] = { _keys[0], _keys[1], _keys[2] };
+    PHYSFS_uint64 i;
+    for (i = 0; i < len; i++)
+    {
+        const PHYSFS_uint8 ch = ptr[i] ^ zip_decrypt_byte(keys);
+        zip_update_crypto_keys(keys, ch);
+        ptr[i] = ch;
+    } /* for */
+    memcpy(_keys, keys, sizeof (keys));
+} /* zip_decrypt_block */
+
+/* Check the authentication code that follows an AES entry's data, once all
+   of the data went through the MAC. */
+static int zip_aes_verify(ZIPfileinfo *finfo)
+{
+    ZIPaesinfo *aes = finfo->aes;
+    PHYSFS_Io *io = finfo->io;
+    PHYSFS_uint8 digest[20];
+    PHYSFS_uint8 stored[ZIP_AES_AUTHCODE_SIZE];
+
+    aes->authenticating = 0;
+    __PHYSFS_HmacSha1Final(&aes->mac, digest);
+    BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, stored, sizeof (stored)), 0);
+    BAIL_IF(memcmp(digest, stored, sizeof (stored)) != 0, PHYSFS_ERR_CORRUPT, 0);
+    return 1;
+} /* zip_aes_verify */
+
 static PHYSFS_sint64 zip_read_decrypt(ZIPfileinfo *finfo, void *buf, PHYSFS_uint64 len)
 {
     PHYSFS_Io *io = finfo->io;
-    const PHYSFS_sint64 br = io->read(io, buf, len);
+    ZIPaesinfo *aes = finfo->aes;
+    PHYSFS_sint64 br;
 
-    /* Decompression the new data if necessary. */
-    if (zip_entry_is_tradional_crypto(finfo->entry) && (br > 0))
+    if (aes != nullptr)
     {
-        PHYSFS_uint32 *keys = finfo->crypto_keys;
-        PHYSFS_uint8 *ptr = (PHYSFS_uint8 *) buf;
-        PHYSFS_sint64 i;
-        for (i = 0; i < br; i++, ptr++)
+        /* the authentication code follows the data; don't read into it. */
+        if (len > aes->size - aes->pos)
+            len = aes->size - aes->pos;
+        if (len == 0)
+            return 0;
+    } /* if */
+
+    br = io->read(io, buf, len);
+
+    /* Decrypt the new data if necessary. */
+    if (br > 0)
+    {
+        if (aes != nullptr)
         {
-            const PHYSFS_uint8 ch = *ptr ^ zip_decrypt_byte(keys);
-            zip_update_crypto_keys(keys, ch);
-            *ptr = ch;
-        } /* for */
-    } /* if  */
+            if (aes->authenticating)
+                __PHYSFS_HmacSha1Update(&aes->mac, buf, (size_t) br);
+            __PHYSFS_AesCtrXor(&aes->key, aes->pos, (PHYSFS_uint8 *) buf, (size_t) br);
+            aes->pos += (PHYSFS_uint64) br;
+            if ((aes->pos == aes->size) && (aes->authenticating))
+                BAIL_IF_ERRPASS(!zip_aes_verify(finfo), -1);
+        } /* if */
+
+        else if (zip_entry_is_tradional_crypto(finfo->entry))
+            zip_decrypt_block(finfo->crypto_keys, (PHYSFS_uint8 *) buf, (PHYSFS_uint64) br);
+    } /* if */
 
     return br;
 } /* zip_read_decrypt */
 
+/* Returns zero if the password is wrong, without setting an error. */
 static int zip_prep_crypto_keys(ZIPfileinfo *finfo, const PHYSFS_uint8 *crypto_header, const PHYSFS_uint8 *password)
 {
     /* It doesn't appear to be documented in PKWare's APPNOTE.TXT, but you
@@ -186,8 +316,7 @@ static int zip_prep_crypto_keys(ZIPfileinfo *finfo, const PHYSFS_uint8 *crypto_h
     const ZIPentry *entry = finfo->entry;
     const int usedate = zip_entry_ignore_local_header(entry);
     const PHYSFS_uint8 verifier = (PHYSFS_uint8) ((usedate ? (entry->dos_mod_time >> 8) : (entry->crc >> 24)) & 0xFF);
-    PHYSFS_uint8 finalbyte = 0;
-    int i = 0;
+    PHYSFS_uint8 header[12];
 
     /* initialize vector with defaults, then password, then header. */
     keys[0] = 305419896;
@@ -197,29 +326,70 @@ static int zip_prep_crypto_keys(ZIPfileinfo *finfo, const PHYSFS_uint8 *crypto_h
     while (*password)
         zip_update_crypto_keys(keys, *(password++));
 
-    for (i = 0; i < 12; i++)
-    {
-        const PHYSFS_uint8 c = crypto_header[i] ^ zip_decrypt_byte(keys);
-        zip_update_crypto_keys(keys, c);
-        finalbyte = c;
-    } /* for */
+    memcpy(header, crypto_header, sizeof (header));
+    zip_decrypt_block(keys, header, sizeof (header));
 
     /* you have a 1/256 chance of passing this test incorrectly. :/ */
-    if (finalbyte != verifier)
-        BAIL(PHYSFS_ERR_BAD_PASSWORD, 0);
+    if (header[11] != verifier)
+        return 0;
 
     /* save the initial vector for seeking purposes. Not secure!! */
     memcpy(finfo->initial_crypto_keys, finfo->crypto_keys, 12);
     return 1;
 } /* zip_prep_crypto_keys */
 
+/*
+ * WinZip AES: the data is preceded by a salt and a password verifier, and
+ *  followed by an authentication code. One PBKDF2 run over the password and
+ *  salt gives the AES key, the HMAC key and the verifier, in that order.
+ *  (header) is the salt and verifier; returns zero if the password is wrong,
+ *  without setting an error.
+ */
+static int zip_prep_aes(ZIPfileinfo *finfo, const PHYSFS_uint8 *header, const PHYSFS_uint8 *password)
+{
+    const ZIPentry *entry = finfo->entry;
+    const size_t saltlen = 4 + 4 * (size_t) entry->aes_strength;
+    const size_t keylen = 8 + 8 * (size_t) entry->aes_strength;
+    PHYSFS_uint8 derived[64 + ZIP_AES_VERIFIER_SIZE];
+    ZIPaesinfo *aes = finfo->aes;
+
+    __PHYSFS_Pbkdf2Sha1(password, strlen((const char *) password),
+                        header, saltlen, ZIP_AES_ITERATIONS,
+                        derived, 2 * keylen + ZIP_AES_VERIFIER_SIZE);
+
+    /* you have a 1/65536 chance of passing this test incorrectly. */
+    if (memcmp(derived + 2 * keylen, header + saltlen, ZIP_AES_VERIFIER_SIZE) != 0)
+        return 0;
+
+    __PHYSFS_AesSetKey(&aes->key, derived, keylen);
+    __PHYSFS_HmacSha1Init(&aes->initial_mac, derived + keylen, keylen);
+    memcpy(&aes->mac, &aes->initial_mac, sizeof (aes->mac));
+    aes->start = entry->offset + saltlen + ZIP_AES_VERIFIER_SIZE;
+    aes->size = entry->compressed_size - (saltlen + ZIP_AES_VERIFIER_SIZE + ZIP_AES_AUTHCODE_SIZE);
+    aes->pos = 0;
+    aes->authenticating = 1;
+    return 1;
+} /* zip_prep_aes */
+
+/* Rewind an AES entry to the start of its data. Reading it all from there
+   checks the authentication code again. */
+static int zip_aes_rewind(ZIPfileinfo *finfo)
+{
+    ZIPaesinfo *aes = finfo->aes;
+    BAIL_IF_ERRPASS(!finfo->io->seek(finfo->io, aes->start), 0);
+    memcpy(&aes->mac, &aes->initial_mac, sizeof (aes->mac));
+    aes->pos = 0;
+    aes->authenticating = 1;
+    return 1;
+} /* zip_aes_rewind */
+
 
 /*
  * Bridge physfs allocation functions to zlib's format...
  */
 static voidpf zlibPhysfsAlloc(voidpf opaque, uInt items, uInt size)
 {
-    return ((PHYSFS_Allocator *) opaque)->Malloc(items * size);
+    return allocator.Malloc((PHYSFS_uint64) items * size, PHYSFS_ALLOC_DECOMPRESS);
 } /* zlibPhysfsAlloc */
 
 /*
@@ -227,7 +397,7 @@ static voidpf zlibPhysfsAlloc(voidpf opaque, uInt items, uInt size)
  */
 static void zlibPhysfsFree(voidpf opaque, voidpf address)
 {
-    ((PHYSFS_Allocator *) opaque)->Free(address);
+    allocator.Free(address);
 } /* zlibPhysfsFree */
 
 
@@ -239,7 +409,7 @@ static void initializeZStream(z_stream *pstr)
     memset(pstr, '\0', sizeof (z_stream));
     pstr->zalloc = zlibPhysfsAlloc;
     pstr->zfree = zlibPhysfsFree;
-    pstr->opaque = &allocator;
+    pstr->opaque = NULL;
 } /* initializeZStream */
 
 
@@ -378,17 +548,35 @@ static int ZIP_seek(PHYSFS_Io *_io, PHYSFS_uint64 offset)
     ZIPfileinfo *finfo = (ZIPfileinfo *) _io->opaque;
     ZIPentry *entry = finfo->entry;
     PHYSFS_Io *io = finfo->io;
+    ZIPaesinfo *aes = finfo->aes;
     const int encrypted = zip_entry_is_tradional_crypto(entry);
 
     BAIL_IF(offset > entry->uncompressed_size, PHYSFS_ERR_PAST_EOF, 0);
 
-    if (!encrypted && (entry->compression_method == COMPMETH_NONE))
+    if (!encrypted && (aes == nullptr) && (entry->compression_method == COMPMETH_NONE))
     {
         PHYSFS_sint64 newpos = offset + entry->offset;
         BAIL_IF_ERRPASS(!io->seek(io, newpos), 0);
         finfo->uncompressed_position = (PHYSFS_uint32) offset;
     } /* if */
 
+    /* AES is a counter mode, so stored data can be decrypted from anywhere.
+       Only a read all the way from the start can be authenticated, though. */
+    else if ((aes != nullptr) && (entry->compression_method == COMPMETH_NONE))
+    {
+        if (offset == 0)
+        {
+            BAIL_IF_ERRPASS(!zip_aes_rewind(finfo), 0);
+        } /* if */
+        else if (offset != aes->pos)
+        {
+            BAIL_IF_ERRPASS(!io->seek(io, aes->start + offset), 0);
+            aes->pos = offset;
+            aes->authenticating = 0;
+        } /* else if */
+        finfo->uncompressed_position = (PHYSFS_uint32) offset;
+    } /* else if */
+
     else
     {
         /*
@@ -399,17 +587,32 @@ static int ZIP_seek(PHYSFS_Io *_io, PHYSFS_uint64 offset)
          */
         if (offset < finfo->uncompressed_position)
         {
-            /* we do a copy so state is sane if inflateInit2() fails. */
+            /* we do a copy so state is sane if inflateInit2() fails. Stored
+               entries land here when encrypted, but have no stream. */
+            const int compressed = (entry->compression_method != COMPMETH_NONE);
+            int rewound;
             z_stream str;
             initializeZStream(&str);
-            if (zlib_err(inflateInit2(&str, -MAX_WBITS)) != Z_OK)
+            if (compressed && (zlib_err(inflateInit2(&str, -MAX_WBITS)) != Z_OK))
                 return 0;
 
-            if (!io->seek(io, entry->offset + (encrypted ? 12 : 0)))
+            if (aes != nullptr)
+                rewound = zip_aes_rewind(finfo);
+            else
+                rewound = io->seek(io, entry->offset + (encrypted ? 12 : 0));
+
+            if (!rewound)
+            {
+                if (compressed)
+                    inflateEnd(&str);
                 return 0;
+            } /* if */
 
-            inflateEnd(&finfo->stream);
-            memcpy(&finfo->stream, &str, sizeof (z_stream));
+            if (compressed)
+            {
+                inflateEnd(&finfo->stream);
+                memcpy(&finfo->stream, &str, sizeof (z_stream));
+            } /* if */
             finfo->uncompressed_position = finfo->compressed_position = 0;
 
             if (encrypted)
@@ -441,30 +644,86 @@ static PHYSFS_sint64 ZIP_length(PHYSFS_Io *io)
 } /* ZIP_length */
 
 
-static PHYSFS_Io *zip_get_io(PHYSFS_Io *io, ZIPinfo *inf, ZIPentry *entry);
+/*
+ * Only entries that are stored as-is can be read positionally; anything
+ *  compressed or traditionally encrypted has to be decoded in order. Stored
+ *  AES entries decrypt anywhere, but what's read this way isn't
+ *  authenticated.
+ */
+static PHYSFS_sint64 ZIP_readAt(PHYSFS_Io *_io, PHYSFS_uint64 offset,
+                                void *buf, PHYSFS_uint64 len)
+{
+    ZIPfileinfo *finfo = (ZIPfileinfo *) _io->opaque;
+    const ZIPentry *entry = finfo->entry;
+    PHYSFS_Io *io = finfo->io;
+
+    if (offset >= entry->uncompressed_size)
+        return 0;
+
+    if (len > entry->uncompressed_size - offset)
+        len = entry->uncompressed_size - offset;
+
+    if (finfo->aes != nullptr)
+    {
+        const ZIPaesinfo *aes = finfo->aes;
+        const PHYSFS_sint64 br = io->readAt(io, aes->start + offset, buf, len);
+        if (br > 0)
+            __PHYSFS_AesCtrXor(&aes->key, offset, (PHYSFS_uint8 *) buf, (size_t) br);
+        return br;
+    } /* if */
+
+    return io->readAt(io, entry->offset + offset, buf, len);
+} /* ZIP_readAt */
+
+
+static int zip_entry_can_read_at(const ZIPfileinfo *finfo)
+{
+    const ZIPentry *entry = finfo->entry;
+    return ( (entry->compression_method == COMPMETH_NONE) &&
+             (!zip_entry_is_tradional_crypto(entry)) &&
+             (__PHYSFS_ioCanReadAt(finfo->io)) );
+} /* zip_entry_can_read_at */
+
+
+static PHYSFS_Io *zip_get_io(PHYSFS_Io *io, ZIPentry *entry);
 
 static PHYSFS_Io *ZIP_duplicate(PHYSFS_Io *io)
 {
     ZIPfileinfo *origfinfo = (ZIPfileinfo *) io->opaque;
-    PHYSFS_Io *retval = (PHYSFS_Io *) allocator.Malloc(sizeof (PHYSFS_Io));
-    ZIPfileinfo *finfo = (ZIPfileinfo *) allocator.Malloc(sizeof (ZIPfileinfo));
+    PHYSFS_Io *retval = (PHYSFS_Io *) allocator.Malloc(sizeof (PHYSFS_Io), PHYSFS_ALLOC_FILEHANDLE);
+    ZIPfileinfo *finfo = (ZIPfileinfo *) allocator.Malloc(sizeof (ZIPfileinfo), PHYSFS_ALLOC_FILEHANDLE);
     GOTO_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, failed);
     GOTO_IF(!finfo, PHYSFS_ERR_OUT_OF_MEMORY, failed);
     memset(finfo, '\0', sizeof (*finfo));
 
     finfo->entry = origfinfo->entry;
-    finfo->io = zip_get_io(origfinfo->io, nullptr, finfo->entry);
+    finfo->io = zip_get_io(origfinfo->io, finfo->entry);
     GOTO_IF_ERRPASS(!finfo->io, failed);
 
     initializeZStream(&finfo->stream);
     if (finfo->entry->compression_method != COMPMETH_NONE)
     {
-        finfo->buffer = (PHYSFS_uint8 *) allocator.Malloc(ZIP_READBUFSIZE);
+        finfo->buffer = (PHYSFS_uint8 *) allocator.Malloc(ZIP_READBUFSIZE, PHYSFS_ALLOC_DECOMPRESS);
         GOTO_IF(!finfo->buffer, PHYSFS_ERR_OUT_OF_MEMORY, failed);
         if (zlib_err(inflateInit2(&finfo->stream, -MAX_WBITS)) != Z_OK)
             goto failed;
     } /* if */
 
+    /* the copy starts over at the beginning, keys and all. */
+    if (origfinfo->aes != nullptr)
+    {
+        finfo->aes = (ZIPaesinfo *) allocator.Malloc(sizeof (ZIPaesinfo), PHYSFS_ALLOC_FILEHANDLE);
+        GOTO_IF(!finfo->aes, PHYSFS_ERR_OUT_OF_MEMORY, failed);
+        memcpy(finfo->aes, origfinfo->aes, sizeof (ZIPaesinfo));
+        GOTO_IF_ERRPASS(!zip_aes_rewind(finfo), failed);
+    } /* if */
+    else if (zip_entry_is_tradional_crypto(finfo->entry))
+    {
+        GOTO_IF_ERRPASS(!finfo->io->seek(finfo->io, finfo->entry->offset + 12), failed);
+        memcpy(finfo->crypto_keys, origfinfo->initial_crypto_keys, 12);
+        memcpy(finfo->initial_crypto_keys, origfinfo->initial_crypto_keys, 12);
+    } /* else if */
+
     memcpy(retval, io, sizeof (PHYSFS_Io));
     retval->opaque = finfo;
     return retval;
@@ -481,6 +740,9 @@ failed:
             inflateEnd(&finfo->stream);
         } /* if */
 
+        if (finfo->aes != nullptr)
+            allocator.Free(finfo->aes);
+
         allocator.Free(finfo);
     } /* if */
 
@@ -503,6 +765,9 @@ static void ZIP_destroy(PHYSFS_Io *io)
     if (finfo->buffer != nullptr)
         allocator.Free(finfo->buffer);
 
+    if (finfo->aes != nullptr)
+        allocator.Free(finfo->aes);
+
     allocator.Free(finfo);
     allocator.Free(io);
 } /* ZIP_destroy */
@@ -518,7 +783,8 @@ static const PHYSFS_Io ZIP_Io =
     ZIP_length,
     ZIP_duplicate,
     ZIP_flush,
-    ZIP_destroy
+    ZIP_destroy,
+    ZIP_readAt
 };
 
 
@@ -717,6 +983,44 @@ static inline ZIPentry *zip_find_entry(ZIPinfo *info, const char *path)
     return (ZIPentry *) __PHYSFS_DirTreeFind(&info->tree, path);
 } /* zip_find_entry */
 
+
+/*
+ * Read an entry's resolve state. Seeing a final state also makes the offset
+ *  and symlink it was published with safe to use.
+ */
+static inline ZipResolveType zip_resolve_state(const ZIPentry *entry)
+{
+    ZipResolveType *state = const_cast<ZipResolveType *>(&entry->resolved);
+    return std::atomic_ref<ZipResolveType>(*state).load(std::memory_order_acquire);
+} /* zip_resolve_state */
+
+
+static inline void zip_set_resolve_state(ZIPentry *entry,
+                                         const ZipResolveType state)
+{
+    std::atomic_ref<ZipResolveType>(entry->resolved).store(state, std::memory_order_release);
+} /* zip_set_resolve_state */
+
+
+/* Holds an archive's resolve_lock for a scope, even if a BAIL throws. */
+struct ZipResolveLock
+{
+    void *mutex;
+
+    explicit ZipResolveLock(void *m) : mutex(m)
+    {
+        __PHYSFS_platformGrabMutex(mutex);
+    } /* ZipResolveLock */
+
+    ~ZipResolveLock()
+    {
+        __PHYSFS_platformReleaseMutex(mutex);
+    } /* ~ZipResolveLock */
+
+    ZipResolveLock(const ZipResolveLock &) = delete;
+    ZipResolveLock &operator=(const ZipResolveLock &) = delete;
+};
+
 /* (forward reference: zip_follow_symlink and zip_resolve call each other.) */
 static int zip_resolve(PHYSFS_Io *io, ZIPinfo *info, ZIPentry *entry);
 
@@ -807,15 +1111,28 @@ static int zip_resolve_symlink(PHYSFS_Io *io, ZIPinfo *info, ZIPentry *entry)
 } /* zip_resolve_symlink */
 
 
+static inline PHYSFS_uint16 zip_le16(const PHYSFS_uint8 *ptr)
+{
+    return (PHYSFS_uint16) (ptr[0] | (ptr[1] << 8));
+} /* zip_le16 */
+
+
+static inline PHYSFS_uint32 zip_le32(const PHYSFS_uint8 *ptr)
+{
+    return ((PHYSFS_uint32) ptr[0]) | (((PHYSFS_uint32) ptr[1]) << 8) |
+           (((PHYSFS_uint32) ptr[2]) << 16) | (((PHYSFS_uint32) ptr[3]) << 24);
+} /* zip_le32 */
+
+
 /*
- * Parse the local file header of an entry, and update entry->offset.
+ * Check an entry against its raw local file header (the fixed-size part,
+ *  ZIP_LOCAL_FILE_HEADER_SIZE bytes), and update entry->offset to point at
+ *  the file data. Returns zero if the header doesn't match the entry; that
+ *  doesn't set an error, so callers can decide what corrupt means for them.
  */
-static int zip_parse_local(PHYSFS_Io *io, ZIPentry *entry)
+static int zip_apply_local_header(ZIPentry *entry, const PHYSFS_uint8 *hdr)
 {
     PHYSFS_uint32 ui32;
-    PHYSFS_uint16 ui16;
-    PHYSFS_uint16 fnamelen;
-    PHYSFS_uint16 extralen;
 
     /*
      * crc and (un)compressed_size are always zero if this is a "JAR"
@@ -830,41 +1147,53 @@ static int zip_parse_local(PHYSFS_Io *io, ZIPentry *entry)
        !!! FIXME:  which is probably true for Jar files, fwiw, but we don't
        !!! FIXME:  care about these values anyhow. */
 
-    BAIL_IF_ERRPASS(!io->seek(io, entry->offset), 0);
-    BAIL_IF_ERRPASS(!readui32(io, &ui32), 0);
-    BAIL_IF(ui32 != ZIP_LOCAL_FILE_SIG, PHYSFS_ERR_CORRUPT, 0);
-    BAIL_IF_ERRPASS(!readui16(io, &ui16), 0);
+    if (zip_le32(hdr) != ZIP_LOCAL_FILE_SIG)
+        return 0;
+    else if (zip_le16(hdr + 8) != (zip_entry_is_aes(entry) ? COMPMETH_AES : entry->compression_method))
+        return 0;
+
+    ui32 = zip_le32(hdr + 14);
+    if (ui32 && (ui32 != entry->crc))
+        return 0;
+
+    ui32 = zip_le32(hdr + 18);
+    if (ui32 && (ui32 != 0xFFFFFFFF) && (ui32 != entry->compressed_size))
+        return 0;
+
+    ui32 = zip_le32(hdr + 22);
+    if (ui32 && (ui32 != 0xFFFFFFFF) && (ui32 != entry->uncompressed_size))
+        return 0;
+
     /* Windows Explorer might rewrite the entire central directory, setting
        this field to 2.0/MS-DOS for all files, so favor the local version,
        which it leaves intact if it didn't alter that specific file. */
-    entry->version_needed = ui16;
-    BAIL_IF_ERRPASS(!readui16(io, &ui16), 0);  /* general bits. */
-    BAIL_IF_ERRPASS(!readui16(io, &ui16), 0);
-    BAIL_IF(ui16 != entry->compression_method, PHYSFS_ERR_CORRUPT, 0);
-    BAIL_IF_ERRPASS(!readui32(io, &ui32), 0);  /* date/time */
-    BAIL_IF_ERRPASS(!readui32(io, &ui32), 0);
-    BAIL_IF(ui32 && (ui32 != entry->crc), PHYSFS_ERR_CORRUPT, 0);
-
-    BAIL_IF_ERRPASS(!readui32(io, &ui32), 0);
-    BAIL_IF(ui32 && (ui32 != 0xFFFFFFFF) &&
-                  (ui32 != entry->compressed_size), PHYSFS_ERR_CORRUPT, 0);
+    entry->version_needed = zip_le16(hdr + 4);
 
-    BAIL_IF_ERRPASS(!readui32(io, &ui32), 0);
-    BAIL_IF(ui32 && (ui32 != 0xFFFFFFFF) &&
-                 (ui32 != entry->uncompressed_size), PHYSFS_ERR_CORRUPT, 0);
+    /* skip the fixed header, the file name and the extra field. */
+    entry->offset += ZIP_LOCAL_FILE_HEADER_SIZE +
+                     zip_le16(hdr + 26) + zip_le16(hdr + 28);
+    return 1;
+} /* zip_apply_local_header */
 
-    BAIL_IF_ERRPASS(!readui16(io, &fnamelen), 0);
-    BAIL_IF_ERRPASS(!readui16(io, &extralen), 0);
 
-    entry->offset += fnamelen + extralen + 30;
+/*
+ * Parse the local file header of an entry, and update entry->offset.
+ */
+static int zip_parse_local(PHYSFS_Io *io, ZIPentry *entry)
+{
+    PHYSFS_uint8 hdr[ZIP_LOCAL_FILE_HEADER_SIZE];
+    BAIL_IF_ERRPASS(!io->seek(io, entry->offset), 0);
+    BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, hdr, sizeof (hdr)), 0);
+    BAIL_IF(!zip_apply_local_header(entry, hdr), PHYSFS_ERR_CORRUPT, 0);
     return 1;
 } /* zip_parse_local */
 
 
-static int zip_resolve(PHYSFS_Io *io, ZIPinfo *info, ZIPentry *entry)
+/* MAKE SURE you hold info->resolve_lock before calling this! */
+static int zip_resolve_locked(PHYSFS_Io *io, ZIPinfo *info, ZIPentry *entry)
 {
     int retval = 1;
-    const ZipResolveType resolve_type = entry->resolved;
+    const ZipResolveType resolve_type = zip_resolve_state(entry);
 
     if (resolve_type == ZIP_DIRECTORY)
         return 1;   /* we're good. */
@@ -873,7 +1202,8 @@ static int zip_resolve(PHYSFS_Io *io, ZIPinfo *info, ZIPentry *entry)
     BAIL_IF(resolve_type == ZIP_BROKEN_FILE, PHYSFS_ERR_CORRUPT, 0);
     BAIL_IF(resolve_type == ZIP_BROKEN_SYMLINK, PHYSFS_ERR_CORRUPT, 0);
 
-    /* uhoh...infinite symlink loop! */
+    /* uhoh...infinite symlink loop! Only this thread can be resolving it,
+       since we're holding the lock. */
     BAIL_IF(resolve_type == ZIP_RESOLVING, PHYSFS_ERR_SYMLINK_LOOP, 0);
 
     /*
@@ -885,38 +1215,67 @@ static int zip_resolve(PHYSFS_Io *io, ZIPinfo *info, ZIPentry *entry)
      */
     if (resolve_type != ZIP_RESOLVED)
     {
+        const ZipResolveType broken_type =
+            (resolve_type == ZIP_UNRESOLVED_SYMLINK) ?
+                ZIP_BROKEN_SYMLINK : ZIP_BROKEN_FILE;
+
         if (entry->tree.isdir)  /* an ancestor dir that DirTree filled in? */
         {
-            entry->resolved = ZIP_DIRECTORY;
+            zip_set_resolve_state(entry, ZIP_DIRECTORY);
             return 1;
         } /* if */
 
-        retval = zip_parse_local(io, entry);
-        if (retval)
+        zip_set_resolve_state(entry, ZIP_RESOLVING);
+
+        try
         {
+            retval = zip_parse_local(io, entry);
+
             /*
              * If it's a symlink, find the original file. This will cause
              *  resolution of other entries (other symlinks and, eventually,
              *  the real file) if all goes well.
              */
-            if (resolve_type == ZIP_UNRESOLVED_SYMLINK)
+            if (retval && (resolve_type == ZIP_UNRESOLVED_SYMLINK))
                 retval = zip_resolve_symlink(io, info, entry);
-        } /* if */
+        } /* try */
+        catch (...)
+        {
+            /* never leave it stuck in ZIP_RESOLVING. */
+            zip_set_resolve_state(entry, broken_type);
+            throw;
+        } /* catch */
 
-        if (resolve_type == ZIP_UNRESOLVED_SYMLINK)
-            entry->resolved = ((retval) ? ZIP_RESOLVED : ZIP_BROKEN_SYMLINK);
-        else if (resolve_type == ZIP_UNRESOLVED_FILE)
-            entry->resolved = ((retval) ? ZIP_RESOLVED : ZIP_BROKEN_FILE);
+        zip_set_resolve_state(entry, (retval) ? ZIP_RESOLVED : broken_type);
     } /* if */
 
     return retval;
+} /* zip_resolve_locked */
+
+
+static int zip_resolve(PHYSFS_Io *io, ZIPinfo *info, ZIPentry *entry)
+{
+    const ZipResolveType resolve_type = zip_resolve_state(entry);
+
+    /* Final states never change again, so the common case takes no lock. */
+    if ((resolve_type == ZIP_RESOLVED) || (resolve_type == ZIP_DIRECTORY))
+        return 1;
+
+    /*
+     * The lock is recursive, so following a symlink can come back in here
+     *  for its target. Another thread opening the same entry just waits,
+     *  then finds it already resolved.
+     */
+    ZipResolveLock lock(info->resolve_lock);
+    return zip_resolve_locked(io, info, entry);
 } /* zip_resolve */
 
 
 static int zip_entry_is_symlink(const ZIPentry *entry)
 {
-    return ((entry->resolved == ZIP_UNRESOLVED_SYMLINK) ||
-            (entry->resolved == ZIP_BROKEN_SYMLINK) ||
+    const ZipResolveType resolve_type = zip_resolve_state(entry);
+    return ((resolve_type == ZIP_UNRESOLVED_SYMLINK) ||
+            (resolve_type == ZIP_BROKEN_SYMLINK) ||
             (entry->symlink));
 } /* zip_entry_is_symlink */
 
@@ -1004,6 +1363,7 @@ static ZIPentry *zip_load_entry(ZIPinfo *info, const int zip64,
     PHYSFS_sint64 si64;
     char *name = nullptr;
     int isdir = 0;
+    int need_zip64, need_aes;
 
     /* sanity check with central directory signature... */
     BAIL_IF_ERRPASS(!readui32(io, &ui32), nullptr);
@@ -1065,6 +1425,7 @@ static ZIPentry *zip_load_entry(ZIPinfo *info, const int zip64,
            sizeof (*retval) - sizeof (__PHYSFS_DirTreeEntry));
 
     retval->symlink = nullptr;  /* will be resolved later, if necessary. */
+    retval->inlined = nullptr;  /* set by zip_inline_small, if at all. */
 
     if (isdir)
         retval->resolved = ZIP_DIRECTORY;
@@ -1078,64 +1439,86 @@ static ZIPentry *zip_load_entry(ZIPinfo *info, const int zip64,
     BAIL_IF_ERRPASS(si64 == -1, nullptr);
 
     /* If the actual sizes didn't fit in 32-bits, look for the Zip64
-        extended information extra field... */
-    if ( (zip64) &&
-         ((offset == 0xFFFFFFFF) ||
-          (starting_disk == 0xFFFFFFFF) ||
-          (retval->compressed_size == 0xFFFFFFFF) ||
-          (retval->uncompressed_size == 0xFFFFFFFF)) )
+        extended information extra field. WinZip AES entries keep their
+        key size and real compression method in an extra field, too. */
+    need_zip64 = ( (zip64) &&
+                   ((offset == 0xFFFFFFFF) ||
+                    (starting_disk == 0xFFFFFFFF) ||
+                    (retval->compressed_size == 0xFFFFFFFF) ||
+                    (retval->uncompressed_size == 0xFFFFFFFF)) );
+    need_aes = (retval->compression_method == COMPMETH_AES);
+
+    if (need_zip64 || need_aes)
     {
-        int found = 0;
+        int found_zip64 = 0;
+        int found_aes = 0;
         PHYSFS_uint16 sig = 0;
         PHYSFS_uint16 len = 0;
-        while (extralen > 4)
+        while (extralen >= 4)
         {
             BAIL_IF_ERRPASS(!readui16(io, &sig), nullptr);
             BAIL_IF_ERRPASS(!readui16(io, &len), nullptr);
+            BAIL_IF(len > extralen - 4, PHYSFS_ERR_CORRUPT, nullptr);
 
             si64 += 4 + len;
             extralen -= 4 + len;
-            if (sig != ZIP64_EXTENDED_INFO_EXTRA_FIELD_SIG)
+
+            if ((sig == ZIP64_EXTENDED_INFO_EXTRA_FIELD_SIG) && (need_zip64))
             {
-                BAIL_IF_ERRPASS(!io->seek(io, si64), nullptr);
-                continue;
-            } /* if */
+                found_zip64 = 1;
 
-            found = 1;
-            break;
-        } /* while */
+                if (retval->uncompressed_size == 0xFFFFFFFF)
+                {
+                    BAIL_IF(len < 8, PHYSFS_ERR_CORRUPT, nullptr);
+                    BAIL_IF_ERRPASS(!readui64(io, &retval->uncompressed_size), nullptr);
+                    len -= 8;
+                } /* if */
 
-        BAIL_IF(!found, PHYSFS_ERR_CORRUPT, nullptr);
+                if (retval->compressed_size == 0xFFFFFFFF)
+                {
+                    BAIL_IF(len < 8, PHYSFS_ERR_CORRUPT, nullptr);
+                    BAIL_IF_ERRPASS(!readui64(io, &retval->compressed_size), nullptr);
+                    len -= 8;
+                } /* if */
 
-        if (retval->uncompressed_size == 0xFFFFFFFF)
-        {
-            BAIL_IF(len < 8, PHYSFS_ERR_CORRUPT, nullptr);
-            BAIL_IF_ERRPASS(!readui64(io, &retval->uncompressed_size), nullptr);
-            len -= 8;
-        } /* if */
+                if (offset == 0xFFFFFFFF)
+                {
+                    BAIL_IF(len < 8, PHYSFS_ERR_CORRUPT, nullptr);
+                    BAIL_IF_ERRPASS(!readui64(io, &offset), nullptr);
+                    len -= 8;
+                } /* if */
 
-        if (retval->compressed_size == 0xFFFFFFFF)
-        {
-            BAIL_IF(len < 8, PHYSFS_ERR_CORRUPT, nullptr);
-            BAIL_IF_ERRPASS(!readui64(io, &retval->compressed_size), nullptr);
-            len -= 8;
-        } /* if */
+                if (starting_disk == 0xFFFFFFFF)
+                {
+                    BAIL_IF(len < 8, PHYSFS_ERR_CORRUPT, nullptr);
+                    BAIL_IF_ERRPASS(!readui32(io, &starting_disk), nullptr);
+                    len -= 4;
+                } /* if */
 
-        if (offset == 0xFFFFFFFF)
-        {
-            BAIL_IF(len < 8, PHYSFS_ERR_CORRUPT, nullptr);
-            BAIL_IF_ERRPASS(!readui64(io, &offset), nullptr);
-            len -= 8;
-        } /* if */
+                BAIL_IF(len != 0, PHYSFS_ERR_CORRUPT, nullptr);
+            } /* if */
 
-        if (starting_disk == 0xFFFFFFFF)
-        {
-            BAIL_IF(len < 8, PHYSFS_ERR_CORRUPT, nullptr);
-            BAIL_IF_ERRPASS(!readui32(io, &starting_disk), nullptr);
-            len -= 4;
-        } /* if */
+            else if ((sig == ZIP_WINZIP_AES_EXTRA_FIELD_SIG) && (need_aes))
+            {
+                /* version (AE-1 or AE-2), vendor id, strength, method. */
+                PHYSFS_uint8 strength = 0;
+                BAIL_IF(len != 7, PHYSFS_ERR_CORRUPT, nullptr);
+                BAIL_IF_ERRPASS(!readui16(io, &ui16), nullptr);
+                BAIL_IF_ERRPASS(!readui16(io, &ui16), nullptr);
+                BAIL_IF(ui16 != ZIP_WINZIP_AES_VENDOR_ID, PHYSFS_ERR_UNSUPPORTED, nullptr);
+                BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &strength, 1), nullptr);
+                BAIL_IF((strength < 1) || (strength > 3), PHYSFS_ERR_UNSUPPORTED, nullptr);
+                BAIL_IF_ERRPASS(!readui16(io, &retval->compression_method), nullptr);
+                retval->aes_strength = strength;
+                found_aes = 1;
+            } /* else if */
 
-        BAIL_IF(len != 0, PHYSFS_ERR_CORRUPT, nullptr);
+            BAIL_IF_ERRPASS(!io->seek(io, si64), nullptr);
+        } /* while */
+
+        BAIL_IF(need_zip64 && !found_zip64, PHYSFS_ERR_CORRUPT, nullptr);
+        BAIL_IF(need_aes && !found_aes, PHYSFS_ERR_CORRUPT, nullptr);
+        BAIL_IF(need_aes && !zip_entry_is_encrypted(retval), PHYSFS_ERR_CORRUPT, nullptr);
     } /* if */
 
     BAIL_IF(starting_disk != 0, PHYSFS_ERR_CORRUPT, nullptr);
@@ -1165,7 +1548,7 @@ static int zip_load_entries(ZIPinfo *info,
     {
         ZIPentry *entry = zip_load_entry(info, zip64, data_ofs);
         BAIL_IF_ERRPASS(!entry, 0);
-        if (zip_entry_is_tradional_crypto(entry))
+        if (zip_entry_is_encrypted(entry))
             info->has_crypto = 1;
     } /* for */
 
@@ -1446,6 +1829,268 @@ static int zip_parse_end_of_central_dir(ZIPinfo *info,
 } /* zip_parse_end_of_central_dir */
 
 
+#ifdef METAPHYSFS_ZIP_EAGER_RESOLVE
+/*
+ * Resolve every entry right after loading the central directory, instead of
+ *  on first open. Local headers are visited in archive order and pulled out
+ *  of large sequential reads, rather than a seek and a read per file later
+ *  on. Symlinks then go through the usual path, since their targets are all
+ *  in place by now. An entry whose local header is bad is only marked
+ *  broken, just like a failed lazy resolve: opening it fails, mounting
+ *  doesn't.
+ */
+static int zip_resolve_all(ZIPinfo *info)
+{
+    __PHYSFS_DirTree *tree = &info->tree;
+    PHYSFS_Io *io = info->io;
+    const PHYSFS_sint64 archive_len = io->length(io);
+    PHYSFS_uint64 window_ofs = 0;
+    PHYSFS_uint64 window_len = 0;
+    PHYSFS_uint32 count = 0;
+    PHYSFS_uint32 i;
+    ZIPentry **sorted;
+    PHYSFS_uint8 *window;
+
+    BAIL_IF_ERRPASS(archive_len < 0, 0);
+
+    sorted = (ZIPentry **) allocator.Malloc(tree->entryCount * sizeof (ZIPentry *));
+    BAIL_IF(!sorted, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    window = (PHYSFS_uint8 *) allocator.Malloc(ZIP_EAGER_BUFSIZE, PHYSFS_ALLOC_CACHE);
+    if (!window)
+    {
+        allocator.Free(sorted);
+        BAIL(PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    } /* if */
+
+    for (i = 1; i < tree->entryCount; i++)  /* (entry 0 is the root.) */
+    {
+        ZIPentry *entry = (ZIPentry *) __PHYSFS_DirTreeEntryAt(tree, i);
+        if (entry->tree.isdir)
+            entry->resolved = ZIP_DIRECTORY;
+        else
+            sorted[count++] = entry;
+    } /* for */
+
+    std::sort(sorted, sorted + count,
+              [](const ZIPentry *a, const ZIPentry *b) {
+                  return a->offset < b->offset;
+              });
+
+    for (i = 0; i < count; i++)
+    {
+        ZIPentry *entry = sorted[i];
+        const PHYSFS_uint64 hdr_end = entry->offset + ZIP_LOCAL_FILE_HEADER_SIZE;
+        const int is_symlink = (entry->resolved == ZIP_UNRESOLVED_SYMLINK);
+
+        if (is_symlink)
+            continue;  /* second pass. */
+
+        /* not in the current window? Slide it up to this header. */
+        if ((entry->offset < window_ofs) || (hdr_end > window_ofs + window_len))
+        {
+            window_ofs = entry->offset;
+            window_len = ZIP_EAGER_BUFSIZE;
+            if (window_ofs >= (PHYSFS_uint64) archive_len)
+                window_len = 0;
+            else if (window_ofs + window_len > (PHYSFS_uint64) archive_len)
+                window_len = ((PHYSFS_uint64) archive_len) - window_ofs;
+
+            if ((window_len > 0) && ((!io->seek(io, window_ofs)) ||
+                (!__PHYSFS_readAll(io, window, (size_t) window_len))))
+                window_len = 0;
+        } /* if */
+
+        if ((hdr_end <= window_ofs + window_len) &&
+            (zip_apply_local_header(entry, window + (entry->offset - window_ofs))))
+            entry->resolved = ZIP_RESOLVED;
+        else
+            entry->resolved = ZIP_BROKEN_FILE;
+    } /* for */
+
+    allocator.Free(window);
+
+    for (i = 0; i < count; i++)
+    {
+        ZIPentry *entry = sorted[i];
+        if (entry->resolved != ZIP_UNRESOLVED_SYMLINK)
+            continue;
+
+        /* a failure just leaves it ZIP_BROKEN_SYMLINK for later opens. */
+        try
+        {
+            zip_resolve(io, info, entry);
+        } /* try */
+        catch (...)
+        {
+        } /* catch */
+    } /* for */
+
+    allocator.Free(sorted);
+    return 1;
+} /* zip_resolve_all */
+#endif
+
+
+/*
+ * Read every small entry into one block of memory, in archive order, right
+ *  after mounting, so opening one later is just handing out a memory i/o.
+ *  Local headers and data are pulled out of a sliding window, like
+ *  zip_resolve_all does, so neighboring entries cost one read between them,
+ *  and unresolved entries get resolved on the way. This is only ever an
+ *  optimization: an entry that doesn't fit the budget, doesn't fit the
+ *  window or doesn't inflate is simply read the usual way when opened.
+ */
+static const PHYSFS_uint8 zip_empty_entry[1] = { 0 };
+
+static void zip_inline_small(ZIPinfo *info)
+{
+    __PHYSFS_DirTree *tree = &info->tree;
+    PHYSFS_Io *io = info->io;
+    PHYSFS_uint64 budget = 0;
+    const PHYSFS_uint32 max_size = __PHYSFS_inlineMaxFileSize(&budget);
+    const PHYSFS_sint64 archive_len = io->length(io);
+    const PHYSFS_uint64 window_cap = ZIP_EAGER_BUFSIZE + (PHYSFS_uint64) max_size;
+    PHYSFS_uint64 window_ofs = 0;
+    PHYSFS_uint64 window_len = 0;
+    PHYSFS_uint64 total = 0;
+    PHYSFS_uint64 used = 0;
+    PHYSFS_uint32 count = 0;
+    PHYSFS_uint32 i;
+    ZIPentry **sorted;
+    PHYSFS_uint8 *window;
+
+    if ((max_size == 0) || (archive_len < 0))
+        return;
+
+    sorted = (ZIPentry **) allocator.Malloc(tree->entryCount * sizeof (ZIPentry *));
+    if (!sorted)
+        return;
+
+    for (i = 1; i < tree->entryCount; i++)  /* (entry 0 is the root.) */
+    {
+        ZIPentry *entry = (ZIPentry *) __PHYSFS_DirTreeEntryAt(tree, i);
+        const ZipResolveType state = entry->resolved;
+        if ((entry->tree.isdir) || (entry->uncompressed_size > max_size))
+            continue;
+        else if ((state != ZIP_UNRESOLVED_FILE) && (state != ZIP_RESOLVED))
+            continue;  /* symlinks, and anything already known broken. */
+        else if (zip_entry_is_encrypted(entry))
+            continue;
+        else if ((entry->compression_method != COMPMETH_NONE) &&
+                 (entry->compression_method != 8))  /* 8 == deflate. */
+            continue;
+        else if (total + entry->uncompressed_size > budget)
+            continue;
+
+        total += entry->uncompressed_size;
+        sorted[count++] = entry;
+    } /* for */
+
+    std::sort(sorted, sorted + count,
+              [](const ZIPentry *a, const ZIPentry *b) {
+                  return a->offset < b->offset;
+              });
+
+    window = (PHYSFS_uint8 *) allocator.Malloc(window_cap, PHYSFS_ALLOC_CACHE);
+    if (total)
+        info->inline_data = (PHYSFS_uint8 *) allocator.Malloc(total, PHYSFS_ALLOC_CACHE);
+
+    for (i = 0; (window != nullptr) && (i < count); i++)
+    {
+        ZIPentry *entry = sorted[i];
+        const PHYSFS_uint64 size = entry->uncompressed_size;
+        PHYSFS_uint64 need_ofs = entry->offset;
+        PHYSFS_uint64 need_end = need_ofs + ZIP_LOCAL_FILE_HEADER_SIZE;
+        int pass;
+
+        if (size == 0)
+        {
+            if (entry->resolved == ZIP_RESOLVED)
+                entry->inlined = zip_empty_entry;
+            continue;  /* nothing to read, and nothing to resolve yet. */
+        } /* if */
+        else if (!info->inline_data)
+            break;
+
+        /* first the local header if it's unresolved, then the data. */
+        for (pass = (entry->resolved == ZIP_RESOLVED); pass < 2; pass++)
+        {
+            if (pass == 1)
+            {
+                need_ofs = entry->offset;
+                need_end = need_ofs + entry->compressed_size;
+            } /* if */
+
+            if ((need_ofs < window_ofs) || (need_end > window_ofs + window_len))
+            {
+                window_ofs = need_ofs;
+                window_len = window_cap;
+                if (window_ofs >= (PHYSFS_uint64) archive_len)
+                    window_len = 0;
+                else if (window_ofs + window_len > (PHYSFS_uint64) archive_len)
+                    window_len = ((PHYSFS_uint64) archive_len) - window_ofs;
+
+                if ((window_len > 0) && ((!io->seek(io, window_ofs)) ||
+                    (!__PHYSFS_readAll(io, window, (size_t) window_len))))
+                    window_len = 0;
+            } /* if */
+
+            if (need_end > window_ofs + window_len)
+                break;  /* too big for the window, or the read failed. */
+            else if (pass == 1)
+                break;
+            else if (!zip_apply_local_header(entry, window + (need_ofs - window_ofs)))
+            {
+                entry->resolved = ZIP_BROKEN_FILE;
+                break;
+            } /* else if */
+
+            entry->resolved = ZIP_RESOLVED;
+        } /* for */
+
+        if ((entry->resolved != ZIP_RESOLVED) || (need_end > window_ofs + window_len))
+            continue;
+
+        {
+            const PHYSFS_uint8 *packed = window + (entry->offset - window_ofs);
+            PHYSFS_uint8 *into = info->inline_data + used;
+            int ok = 0;
+
+            if (entry->compression_method == COMPMETH_NONE)
+            {
+                ok = (entry->compressed_size == size);
+                if (ok)
+                    memcpy(into, packed, (size_t) size);
+            } /* if */
+            else
+            {
+                z_stream stream;
+                initializeZStream(&stream);
+                stream.next_in = (unsigned char *) packed;
+                stream.avail_in = (unsigned int) entry->compressed_size;
+                stream.next_out = into;
+                stream.avail_out = (unsigned int) size;
+                if (inflateInit2(&stream, -MAX_WBITS) == Z_OK)
+                {
+                    const int rc = inflate(&stream, Z_FINISH);
+                    ok = ((rc == Z_STREAM_END) && (stream.total_out == size));
+                    inflateEnd(&stream);
+                } /* if */
+            } /* else */
+
+            if (ok)
+            {
+                entry->inlined = into;
+                used += size;
+            } /* if */
+        }
+    } /* for */
+
+    allocator.Free(window);
+    allocator.Free(sorted);
+} /* zip_inline_small */
+
+
 static void ZIP_closeArchive(void *opaque)
 {
     ZIPinfo *info = (ZIPinfo *) (opaque);
@@ -1456,6 +2101,10 @@ static void ZIP_closeArchive(void *opaque)
     if (info->io)
         info->io->destroy(info->io);
 
+    if (info->resolve_lock)
+        __PHYSFS_platformDestroyMutex(info->resolve_lock);
+
+    allocator.Free(info->inline_data);
     __PHYSFS_DirTreeDeinit(&info->tree);
 
     allocator.Free(info);
@@ -1484,18 +2133,27 @@ static void *ZIP_openArchive(PHYSFS_Io *io, const char *name,
 
     info->io = io;
 
+    info->resolve_lock = __PHYSFS_platformCreateMutex();
+    if (!info->resolve_lock)
+        goto ZIP_openarchive_failed;
+
     if (!zip_parse_end_of_central_dir(info, &dstart, &cdir_ofs, &count))
         goto ZIP_openarchive_failed;
     else if (!__PHYSFS_DirTreeInit(&info->tree, sizeof (ZIPentry), 1, 0))
         goto ZIP_openarchive_failed;
 
-    root = (ZIPentry *) info->tree.root;
+    root = (ZIPentry *) __PHYSFS_DirTreeEntryAt(&info->tree, 0);
     root->resolved = ZIP_DIRECTORY;
 
     if (!zip_load_entries(info, dstart, cdir_ofs, count))
         goto ZIP_openarchive_failed;
 
-    assert(info->tree.root->sibling == nullptr);
+#ifdef METAPHYSFS_ZIP_EAGER_RESOLVE
+    if (!zip_resolve_all(info))
+        goto ZIP_openarchive_failed;
+#endif
+
+    zip_inline_small(info);
     return info;
 
 ZIP_openarchive_failed:
@@ -1505,22 +2163,42 @@ ZIP_openarchive_failed:
 } /* ZIP_openArchive */
 
 
-static PHYSFS_Io *zip_get_io(PHYSFS_Io *io, ZIPinfo *inf, ZIPentry *entry)
+/*
+ * Wrap an entry's (io) for read-ahead if it's worth it. The wrapper takes
+ *  care of its own duplicates, so ZIP_duplicate() doesn't need this.
+ */
+static PHYSFS_Io *zip_read_ahead(PHYSFS_Io *io, const ZIPentry *entry)
+{
+#if PHYSFS_HAVE_READ_AHEAD
+    const PHYSFS_uint64 minsize = __PHYSFS_readAheadMinSize();
+    if ((entry->compression_method != COMPMETH_NONE) && (minsize != 0) &&
+        (entry->compressed_size >= minsize))
+    {
+        PHYSFS_Io *retval = __PHYSFS_createReadAheadIo(io,
+                                entry->offset + entry->compressed_size,
+                                ZIP_READAHEAD_CHUNK, ZIP_READAHEAD_CHUNKS);
+        if (retval != nullptr)
+            return retval;
+    } /* if */
+#endif
+
+    return io;  /* not worth it, or not possible; read it the usual way. */
+} /* zip_read_ahead */
+
+
+/* (entry) must already be resolved; this only reads it. */
+static PHYSFS_Io *zip_get_io(PHYSFS_Io *io, ZIPentry *entry)
 {
     int success;
+    PHYSFS_sint64 offset;
     PHYSFS_Io *retval = io->duplicate(io);
     BAIL_IF_ERRPASS(!retval, nullptr);
 
     assert(!entry->tree.isdir); /* should have been checked before calling. */
+    assert(zip_resolve_state(entry) == ZIP_RESOLVED);
 
-    /* (inf) can be nullptr if we already resolved. */
-    success = (inf == nullptr) || zip_resolve(retval, inf, entry);
-    if (success)
-    {
-        PHYSFS_sint64 offset;
-        offset = ((entry->symlink) ? entry->symlink->offset : entry->offset);
-        success = retval->seek(retval, offset);
-    } /* if */
+    offset = ((entry->symlink) ? entry->symlink->offset : entry->offset);
+    success = retval->seek(retval, offset);
 
     if (!success)
     {
@@ -1536,11 +2214,20 @@ static PHYSFS_Io *ZIP_openRead(void *opaque, const char *filename)
 {
     PHYSFS_Io *retval = nullptr;
     ZIPinfo *info = (ZIPinfo *) opaque;
-    ZIPentry *entry = zip_find_entry(info, filename);
+    ZIPentry *entry = nullptr;
     ZIPfileinfo *finfo = nullptr;
     PHYSFS_Io *io = nullptr;
     PHYSFS_uint8 *password = nullptr;
 
+    /* the tree throws for a missing path, and "name$PASSWORD" is one. */
+    if (!info->has_crypto)
+        entry = zip_find_entry(info, filename);
+    else
+    {
+        try { entry = zip_find_entry(info, filename); }
+        catch (const MetaPhysFS::Exception<PHYSFS_ERR_NOT_FOUND> &) {}
+    } /* else */
+
     /* if not found, see if maybe "$PASSWORD" is appended. */
     if ((!entry) && (info->has_crypto))
     {
@@ -1564,42 +2251,65 @@ static PHYSFS_Io *ZIP_openRead(void *opaque, const char *filename)
 
     BAIL_IF(entry->tree.isdir, PHYSFS_ERR_NOT_A_FILE, nullptr);
 
-    retval = (PHYSFS_Io *) allocator.Malloc(sizeof (PHYSFS_Io));
+    /* inlined at mount? Then there's nothing left to read. */
+    {
+        const ZIPentry *target = ((entry->symlink != nullptr) ? entry->symlink : entry);
+        if ((target->inlined != nullptr) && (password == nullptr))
+            return __PHYSFS_createMemoryIo(target->inlined, target->uncompressed_size, nullptr);
+    }
+
+    retval = (PHYSFS_Io *) allocator.Malloc(sizeof (PHYSFS_Io), PHYSFS_ALLOC_FILEHANDLE);
     GOTO_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, ZIP_openRead_failed);
 
-    finfo = (ZIPfileinfo *) allocator.Malloc(sizeof (ZIPfileinfo));
+    finfo = (ZIPfileinfo *) allocator.Malloc(sizeof (ZIPfileinfo), PHYSFS_ALLOC_FILEHANDLE);
     GOTO_IF(!finfo, PHYSFS_ERR_OUT_OF_MEMORY, ZIP_openRead_failed);
     memset(finfo, '\0', sizeof (ZIPfileinfo));
 
-    io = zip_get_io(info->io, info, entry);
+    io = zip_get_io(info->io, entry);
     GOTO_IF_ERRPASS(!io, ZIP_openRead_failed);
-    finfo->io = io;
     finfo->entry = ((entry->symlink != nullptr) ? entry->symlink : entry);
+    io = zip_read_ahead(io, finfo->entry);
+    finfo->io = io;
     initializeZStream(&finfo->stream);
 
     if (finfo->entry->compression_method != COMPMETH_NONE)
     {
-        finfo->buffer = (PHYSFS_uint8 *) allocator.Malloc(ZIP_READBUFSIZE);
+        finfo->buffer = (PHYSFS_uint8 *) allocator.Malloc(ZIP_READBUFSIZE, PHYSFS_ALLOC_DECOMPRESS);
         if (!finfo->buffer)
             GOTO(PHYSFS_ERR_OUT_OF_MEMORY, ZIP_openRead_failed);
         else if (zlib_err(inflateInit2(&finfo->stream, -MAX_WBITS)) != Z_OK)
             goto ZIP_openRead_failed;
     } /* if */
 
-    if (!zip_entry_is_tradional_crypto(entry))
+    if (!zip_entry_is_encrypted(finfo->entry))
         GOTO_IF(password != nullptr, PHYSFS_ERR_BAD_PASSWORD, ZIP_openRead_failed);
+    else if (zip_entry_is_aes(finfo->entry))
+    {
+        const size_t headerlen = 4 + 4 * (size_t) finfo->entry->aes_strength + ZIP_AES_VERIFIER_SIZE;
+        PHYSFS_uint8 aes_header[16 + ZIP_AES_VERIFIER_SIZE];
+        GOTO_IF(password == nullptr, PHYSFS_ERR_BAD_PASSWORD, ZIP_openRead_failed);
+        GOTO_IF(finfo->entry->compressed_size < headerlen + ZIP_AES_AUTHCODE_SIZE,
+                PHYSFS_ERR_CORRUPT, ZIP_openRead_failed);
+        finfo->aes = (ZIPaesinfo *) allocator.Malloc(sizeof (ZIPaesinfo), PHYSFS_ALLOC_FILEHANDLE);
+        GOTO_IF(!finfo->aes, PHYSFS_ERR_OUT_OF_MEMORY, ZIP_openRead_failed);
+        if (io->read(io, aes_header, headerlen) != (PHYSFS_sint64) headerlen)
+            goto ZIP_openRead_failed;
+        GOTO_IF(!zip_prep_aes(finfo, aes_header, password), PHYSFS_ERR_BAD_PASSWORD, ZIP_openRead_failed);
+    } /* else if */
     else
     {
         PHYSFS_uint8 crypto_header[12];
         GOTO_IF(password == nullptr, PHYSFS_ERR_BAD_PASSWORD, ZIP_openRead_failed);
         if (io->read(io, crypto_header, 12) != 12)
             goto ZIP_openRead_failed;
-        else if (!zip_prep_crypto_keys(finfo, crypto_header, password))
-            goto ZIP_openRead_failed;
-    } /* if */
+        GOTO_IF(!zip_prep_crypto_keys(finfo, crypto_header, password),
+                PHYSFS_ERR_BAD_PASSWORD, ZIP_openRead_failed);
+    } /* else */
 
     memcpy(retval, &ZIP_Io, sizeof (PHYSFS_Io));
     retval->opaque = finfo;
+    if (!zip_entry_can_read_at(finfo))
+        retval->readAt = nullptr;
 
     return retval;
 
@@ -1615,6 +2325,9 @@ ZIP_openRead_failed:
             inflateEnd(&finfo->stream);
         } /* if */
 
+        if (finfo->aes != nullptr)
+            allocator.Free(finfo->aes);
+
         allocator.Free(finfo);
     } /* if */
 
@@ -1660,7 +2373,7 @@ static int ZIP_stat(void *opaque, const char *filename, PHYSFS_Stat *stat)
     else if (!zip_resolve(info->io, info, entry))
         return 0;
 
-    else if (entry->resolved == ZIP_DIRECTORY)
+    else if (zip_resolve_state(entry) == ZIP_DIRECTORY)
     {
         stat->filesize = 0;
         stat->filetype = PHYSFS_FILETYPE_DIRECTORY;
@@ -1687,6 +2400,40 @@ static int ZIP_stat(void *opaque, const char *filename, PHYSFS_Stat *stat)
 } /* ZIP_stat */
 
 
+static int ZIP_statEx(void *opaque, const char *filename, PHYSFS_StatEx *stat)
+{
+    ZIPinfo *info = (ZIPinfo *) opaque;
+    ZIPentry *entry;
+
+    if (!ZIP_stat(opaque, filename, &stat->stat))
+        return 0;
+    else if (stat->stat.filetype == PHYSFS_FILETYPE_DIRECTORY)
+        return 1;
+
+    /* ZIP_stat resolved it; a symlink's layout is its target's. */
+    entry = zip_find_entry(info, filename);
+    if (entry->symlink != nullptr)
+        entry = entry->symlink;
+    if (zip_resolve_state(entry) != ZIP_RESOLVED)
+        return 1;  /* broken symlink: nothing to lay out. */
+
+    stat->offset = (PHYSFS_sint64) entry->offset;
+    stat->storedSize = (PHYSFS_sint64) entry->compressed_size;
+    stat->method = entry->compression_method;
+    if (entry->compression_method == COMPMETH_NONE)
+        stat->compression = PHYSFS_COMPRESSION_NONE;
+    else if (entry->compression_method == COMPMETH_DEFLATE)
+        stat->compression = PHYSFS_COMPRESSION_DEFLATE;
+    else
+        stat->compression = PHYSFS_COMPRESSION_OTHER;
+    stat->encrypted = zip_entry_is_encrypted(entry);
+    stat->contiguous = 1;
+    stat->mappable = ((stat->compression == PHYSFS_COMPRESSION_NONE) &&
+                      (!stat->encrypted));
+    return 1;
+} /* ZIP_statEx */
+
+
 const PHYSFS_Archiver __PHYSFS_Archiver_ZIP =
 {
     CURRENT_PHYSFS_ARCHIVER_API_VERSION,
@@ -1705,5 +2452,7 @@ const PHYSFS_Archiver __PHYSFS_Archiver_ZIP =
     ZIP_remove,
     ZIP_mkdir,
     ZIP_stat,
-    ZIP_closeArchive
+    ZIP_closeArchive,
+    ZIP_statEx,
+    1  /* concurrentOpenRead */
 };
@@ -4,8 +4,24 @@
 /// Please see the file LICENSE.txt in the source's root directory.           
 /// This file written by Ryan C. Gordon.                                      
 ///                                                                           
-#include "physfs_internal.hpp"
+#include "physfs_tree.hpp"
 #include <cassert>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+
+#if PHYSFS_HAVE_DIRECT_IO or PHYSFS_HAVE_READ_AHEAD or not defined(PHYSFS_NO_THREADS)
+   #include <chrono>
+   #include <mutex>
+   #include <shared_mutex>
+   #include <thread>
+#endif
+
+namespace
+{
+   struct IoScheduler;
+}
 
 
 struct DirHandle
@@ -24,10 +40,81 @@ struct DirHandle
    size_t rootlen;
    // Ptr to archiver info for this handle                              
    const PHYSFS_Archiver* funcs;
+   // Files opened through this handle, only touched atomically         
+   int openFiles;
+   // Archive this one is nested in, if mounted like "outer.zip/in.pak" 
+   // Owned, and closed right after this one                            
+   struct DirHandle* parent;
+   // Registry entry, if (opaque) is shared with other DirHandles       
+   struct SharedArchive* shared;
+   // Serializes calls into (opaque) when it isn't shared; DIR has none 
+   void* lock;
+   // Queues the reads of this mount, if its context schedules them     
+   IoScheduler* scheduler;
+   // Read from the file at (dirName) itself, not from memory or an     
+   // archive it's nested in                                            
+   bool physical;
    // Linked list stuff                                                 
    struct DirHandle* next;
 };
 
+/// Our copy of a registered archiver, and how many DirHandles use it, in     
+/// any context                                                               
+struct RegisteredArchiver
+{
+   PHYSFS_Archiver archiver;
+   std::atomic<int> dirHandles;
+};
+
+/// The registration behind (funcs), which must not be the DIR archiver       
+static inline RegisteredArchiver* registeredArchiver(const PHYSFS_Archiver* funcs) {
+   return reinterpret_cast<RegisteredArchiver*>(const_cast<PHYSFS_Archiver*>(funcs));
+}
+
+/// What an archive file is, as opposed to what it's called. Without file     
+/// ids from the platform, the path has to do                                 
+struct ArchiveIdentity
+{
+   PHYSFS_uint64 device;
+   PHYSFS_uint64 inode;
+   PHYSFS_sint64 size;
+   PHYSFS_sint64 modtime;
+   const char* path;
+   bool byFileId;
+};
+
+/// One parsed archive, mounted by one or more DirHandles in any context.     
+/// Its archiver instance is only ever read through, under (lock), except     
+/// by openRead on archivers that allow concurrent opens                      
+struct SharedArchive
+{
+   ArchiveIdentity id;                 // (id.path) is owned            
+   const PHYSFS_Archiver* funcs;
+   void* opaque;
+   void* lock;                         // Serializes the archiver calls 
+   IoScheduler* scheduler;             // Its io's, if it has one       
+   int refs;                           // DirHandles, under sharedLock  
+   SharedArchive* next;
+};
+
+/// Holds an archive's lock for a call into its archiver: the shared one's,   
+/// or the DirHandle's own. Neither a context's stateLock, nor lack thereof,  
+/// has any say in who else is calling in at the time                         
+struct ArchiveLock {
+   void* lock;
+
+   explicit ArchiveLock(const DirHandle* dh)
+      : lock {dh->shared ? dh->shared->lock : dh->lock} {
+      if (lock)
+         __PHYSFS_platformGrabMutex(lock);
+   }
+
+   ~ArchiveLock() {
+      if (lock)
+         __PHYSFS_platformReleaseMutex(lock);
+   }
+};
+
 struct FileHandle
 {
    // Instance data unique to the archiver for this file                
@@ -35,7 +122,9 @@ struct FileHandle
    // Non-zero if reading, zero if write/append                         
    PHYSFS_uint8 forReading;
    // Archiver instance that created this                               
-   const DirHandle* dirHandle;
+   DirHandle* dirHandle;
+   // Context whose open list this is in                                
+   struct PHYSFS_Context* context;
    // Buffer, if set (nullptr otherwise). Don't touch!                  
    PHYSFS_uint8* buffer;
    // Bufsize, if set (0 otherwise). Don't touch!                       
@@ -44,7 +133,12 @@ struct FileHandle
    size_t buffill;
    // Buffer position. Don't touch!                                     
    size_t bufpos;
+   // Private duplicate of io for PHYSFS_readAt, when io has no readAt  
+   PHYSFS_Io* atIo;
+   // Serializes PHYSFS_readAt over atIo (nullptr if io has a readAt)   
+   void* atLock;
    // linked list stuff                                                 
+   struct FileHandle* prev;
    struct FileHandle* next;
 };
 
@@ -56,33 +150,74 @@ struct ErrState
 };
 
 
+/// One independent PhysicsFS: a search path and a write dir, the files open  
+/// through them, and the locks that guard them. The legacy API works on the  
+/// calling thread's current context, which is the default one unless         
+/// PHYSFS_setContext picked another                                          
+struct PHYSFS_Context
+{
+   DirHandle* searchPath = nullptr;
+   DirHandle* writeDir = nullptr;
+   FileHandle* openWriteList = nullptr;
+   FileHandle* openReadList = nullptr;
+   int allowSymLinks = 0;
+   size_t longest_root = 0;
+   PHYSFS_IoSchedule ioSchedule {};    // For mounts, if ioScheduled    
+   bool ioScheduled = false;
+   void* stateLock = nullptr;          // Protects the states above     
+   void* fileLock = nullptr;           // Protects the open file lists  
+   PHYSFS_Context* next = nullptr;     // In the list of created ones   
+
+   // Settings that opens and mounts read without stateLock, so atomic  
+   std::atomic<PHYSFS_uint32> inlineMaxFileSize {0};
+   std::atomic<PHYSFS_uint64> inlineMaxBytes {0};
+#if PHYSFS_HAVE_READ_AHEAD
+   static constexpr PHYSFS_uint64 DefaultReadAheadMinSize = 1024 * 1024;
+   std::atomic<PHYSFS_uint64> readAheadMinSize {DefaultReadAheadMinSize};
+#endif
+};
+
 /// General PhysicsFS state ...                                               
 static int initialized = 0;
 static ErrState* errorStates = nullptr;
-static DirHandle* searchPath = nullptr;
-static DirHandle* writeDir = nullptr;
-static FileHandle* openWriteList = nullptr;
-static FileHandle* openReadList = nullptr;
 static char* baseDir = nullptr;
 static char* userDir = nullptr;
 static char* prefDir = nullptr;
-static int allowSymLinks = 0;
 static PHYSFS_Archiver** archivers = nullptr;
 static PHYSFS_ArchiveInfo** archiveInfo = nullptr;
-static volatile size_t numArchivers = 0;
-static size_t longest_root = 0;
+static size_t numArchivers = 0;      // Only touched under archiverLock 
+static PHYSFS_Context defaultContext;
+static PHYSFS_Context* contexts = nullptr;
+static SharedArchive* sharedArchives = nullptr;
+static thread_local PHYSFS_Context* currentContext = nullptr;
 
 /// Mutexes ...                                                               
 static void* errorLock = nullptr;     // Protects error message list    
-static void* stateLock = nullptr;     // Protects other PhysFS states   
+static void* cacheLock = nullptr;     // Protects the i/o block cache   
+static void* contextLock = nullptr;   // Protects the list of contexts  
+static void* sharedLock = nullptr;    // Protects the archive registry  
+#ifndef PHYSFS_NO_THREADS
+   static void* commitLock = nullptr; // Protects the commit queue      
+   static void* commitDone = nullptr; // Broadcast as each commit ends  
+   static void* asyncLock = nullptr;  // Protects the async op queue    
+   static void* asyncWake = nullptr;  // Broadcast as ops come and go   
+   static void* asyncStop = nullptr;  // Serializes stopping the pool   
+   // Shared while probing archivers, exclusive to (de)register them    
+   static std::shared_mutex archiverLock;
+#endif
+
+/// The context the calling thread works on                                   
+static inline PHYSFS_Context& ctx() {
+   return currentContext ? *currentContext : defaultContext;
+}
 
 #ifdef PHYSFS_NEED_ATOMIC_OP_FALLBACK
    static int __PHYSFS_atomicAdd(int* ptrval, const int val) {
       int retval;
-      __PHYSFS_platformGrabMutex(stateLock);
+      __PHYSFS_platformGrabMutex(defaultContext.stateLock);
       *ptrval += val;
       retval = *ptrval;
-      __PHYSFS_platformReleaseMutex(stateLock);
+      __PHYSFS_platformReleaseMutex(defaultContext.stateLock);
       return retval;
    }
 
@@ -96,6 +231,224 @@ static void* stateLock = nullptr;     // Protects other PhysFS states
 #endif
 
 
+///                                                                           
+/// Runtime allocator                                                         
+///                                                                           
+namespace
+{
+   #ifndef PHYSFS_NO_CRUNTIME_MALLOC
+      // The parentheses get past the "do not use" macros, on purpose   
+      void* mallocAllocatorMalloc(PHYSFS_uint64 s, PHYSFS_AllocTag, void*) {
+         return (std::malloc)((size_t) s);
+      }
+
+      void* mallocAllocatorRealloc(void* ptr, PHYSFS_uint64,
+         PHYSFS_uint64 s, PHYSFS_AllocTag, void*) {
+         return (std::realloc)(ptr, (size_t) s);
+      }
+
+      void mallocAllocatorFree(void* ptr, PHYSFS_uint64, PHYSFS_AllocTag, void*) {
+         (std::free)(ptr);
+      }
+
+      constexpr PHYSFS_AllocatorCallbacks defaultAllocator {
+         nullptr, nullptr,
+         mallocAllocatorMalloc,
+         mallocAllocatorRealloc,
+         mallocAllocatorFree,
+         nullptr
+      };
+   #else
+      // The platform supplies one, see __PHYSFS_setPlatformAllocator   
+      constexpr PHYSFS_AllocatorCallbacks defaultAllocator {};
+   #endif
+
+   PHYSFS_AllocatorCallbacks allocCallbacks = defaultAllocator;
+   int externalAllocator = 0;
+
+   /// Every allocation is prefixed with its size and tag, so that frees can  
+   /// be sized and accounted for without any help from the caller            
+   struct alignas(std::max_align_t) AllocHeader {
+      PHYSFS_uint64 size;
+      PHYSFS_AllocTag tag;
+   };
+
+   /// Counters for a tag. Relaxed atomics are enough, they're statistics     
+   struct AllocCounters {
+      std::atomic<PHYSFS_uint64> liveBytes;
+      std::atomic<PHYSFS_uint64> liveCount;
+      std::atomic<PHYSFS_uint64> peakBytes;
+      std::atomic<PHYSFS_uint64> totalCount;
+   };
+
+   /// One per tag, plus the totals at PHYSFS_ALLOC_TAG_COUNT                 
+   AllocCounters allocStats[PHYSFS_ALLOC_TAG_COUNT + 1];
+
+   void countBytes(AllocCounters& c, PHYSFS_uint64 oldsize, PHYSFS_uint64 size) {
+      // Unsigned wraparound makes this a subtraction when shrinking    
+      const auto live = c.liveBytes.fetch_add(size - oldsize, std::memory_order_relaxed) + (size - oldsize);
+      auto peak = c.peakBytes.load(std::memory_order_relaxed);
+      while (live > peak and not c.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed));
+   }
+
+   void countAlloc(PHYSFS_AllocTag tag, PHYSFS_uint64 size) {
+      for (auto c : {&allocStats[tag], &allocStats[PHYSFS_ALLOC_TAG_COUNT]}) {
+         countBytes(*c, 0, size);
+         c->liveCount.fetch_add(1, std::memory_order_relaxed);
+         c->totalCount.fetch_add(1, std::memory_order_relaxed);
+      }
+   }
+
+   void countFree(PHYSFS_AllocTag tag, PHYSFS_uint64 size) {
+      for (auto c : {&allocStats[tag], &allocStats[PHYSFS_ALLOC_TAG_COUNT]}) {
+         c->liveBytes.fetch_sub(size, std::memory_order_relaxed);
+         c->liveCount.fetch_sub(1, std::memory_order_relaxed);
+      }
+   }
+
+   /// Size of the whole block for (size) user bytes, or zero on overflow     
+   PHYSFS_uint64 blockSize(PHYSFS_uint64 size) {
+      const PHYSFS_uint64 total = size + sizeof(AllocHeader);
+      if (total < size or not __PHYSFS_ui64FitsAddressSpace(total))
+         return 0;
+      return total;
+   }
+
+} // namespace
+
+void __PHYSFS_setPlatformAllocator(const PHYSFS_AllocatorCallbacks* callbacks) {
+   if (not externalAllocator)
+      allocCallbacks = *callbacks;
+}
+
+void* PHYSFS_allocate(PHYSFS_uint64 size, PHYSFS_AllocTag tag) {
+   if (tag < 0 or tag >= PHYSFS_ALLOC_TAG_COUNT)
+      tag = PHYSFS_ALLOC_GENERAL;
+
+   const auto total = blockSize(size);
+   AllocHeader* header = nullptr;
+   if (total and allocCallbacks.Malloc)
+      header = static_cast<AllocHeader*>(allocCallbacks.Malloc(total, tag, allocCallbacks.userdata));
+
+   if (not header) {
+      PHYSFS_setErrorCode(PHYSFS_ERR_OUT_OF_MEMORY);
+      return nullptr;
+   }
+
+   header->size = size;
+   header->tag = tag;
+   countAlloc(tag, size);
+   return header + 1;
+}
+
+void* PHYSFS_reallocate(void* ptr, PHYSFS_uint64 size, PHYSFS_AllocTag tag) {
+   if (not ptr)
+      return PHYSFS_allocate(size, tag);
+
+   const auto header = static_cast<AllocHeader*>(ptr) - 1;
+   const auto oldsize = header->size;
+   const auto oldtotal = oldsize + sizeof(AllocHeader);
+   const auto total = blockSize(size);
+   tag = header->tag;
+
+   AllocHeader* moved = nullptr;
+   if (total and allocCallbacks.Realloc)
+      moved = static_cast<AllocHeader*>(allocCallbacks.Realloc(header, oldtotal, total, tag, allocCallbacks.userdata));
+   else if (total) {
+      // No realloc in the callbacks (std::pmr has none): move by hand  
+      moved = static_cast<AllocHeader*>(allocCallbacks.Malloc(total, tag, allocCallbacks.userdata));
+      if (moved) {
+         memcpy(moved, header, (size_t) std::min(oldtotal, total));
+         allocCallbacks.Free(header, oldtotal, tag, allocCallbacks.userdata);
+      }
+   }
+
+   if (not moved) {
+      PHYSFS_setErrorCode(PHYSFS_ERR_OUT_OF_MEMORY);
+      return nullptr;
+   }
+
+   moved->size = size;
+   countBytes(allocStats[tag], oldsize, size);
+   countBytes(allocStats[PHYSFS_ALLOC_TAG_COUNT], oldsize, size);
+   return moved + 1;
+}
+
+void PHYSFS_deallocate(void* ptr) {
+   if (not ptr)
+      return;
+
+   const auto header = static_cast<AllocHeader*>(ptr) - 1;
+   const auto size = header->size;
+   const auto tag = header->tag;
+   countFree(tag, size);
+   allocCallbacks.Free(header, size + sizeof(AllocHeader), tag, allocCallbacks.userdata);
+}
+
+int PHYSFS_setAllocator(const PHYSFS_AllocatorCallbacks* a) {
+   BAIL_IF(initialized, PHYSFS_ERR_IS_INITIALIZED, 0);
+   if (a) {
+      BAIL_IF(not a->Malloc or not a->Free, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+      allocCallbacks = *a;
+      externalAllocator = 1;
+   }
+   else {
+      allocCallbacks = defaultAllocator;
+      externalAllocator = 0;
+   }
+
+   return 1;
+}
+
+const PHYSFS_AllocatorCallbacks* PHYSFS_getAllocator() {
+   return &allocCallbacks;
+}
+
+int PHYSFS_getAllocStats(PHYSFS_AllocTag tag, PHYSFS_AllocStats* stats) {
+   BAIL_IF(tag < 0 or tag > PHYSFS_ALLOC_TAG_COUNT, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(not stats, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+   const auto& c = allocStats[tag];
+   stats->liveBytes = c.liveBytes.load(std::memory_order_relaxed);
+   stats->liveCount = c.liveCount.load(std::memory_order_relaxed);
+   stats->peakBytes = c.peakBytes.load(std::memory_order_relaxed);
+   stats->totalCount = c.totalCount.load(std::memory_order_relaxed);
+   return 1;
+}
+
+
+/// Link a new FileHandle at the head of its open list in O(1). Only          
+/// fileLock is taken, so callers should release stateLock first - the        
+/// handle's dirHandle stays alive because its openFiles count was already    
+/// raised by whoever opened it                                               
+static void registerFileHandle(FileHandle* fh) {
+   const auto context = fh->context;
+   auto list = fh->forReading ? &context->openReadList : &context->openWriteList;
+   __PHYSFS_platformGrabMutex(context->fileLock);
+      fh->prev = nullptr;
+      fh->next = *list;
+      if (*list)
+         (*list)->prev = fh;
+      *list = fh;
+   __PHYSFS_platformReleaseMutex(context->fileLock);
+}
+
+/// Unlink a FileHandle from its open list in O(1)                            
+static void unregisterFileHandle(FileHandle* fh) {
+   const auto context = fh->context;
+   auto list = fh->forReading ? &context->openReadList : &context->openWriteList;
+   __PHYSFS_platformGrabMutex(context->fileLock);
+      if (fh->prev)
+         fh->prev->next = fh->next;
+      else
+         *list = fh->next;
+      if (fh->next)
+         fh->next->prev = fh->prev;
+      fh->prev = fh->next = nullptr;
+   __PHYSFS_platformReleaseMutex(context->fileLock);
+}
+
+
 ///                                                                           
 /// PHYSFS_Io implementation for i/o to physical filesystem...                
 ///                                                                           
@@ -112,6 +465,14 @@ static PHYSFS_sint64 nativeIo_read(PHYSFS_Io* io, void* buf, PHYSFS_uint64 len)
    return __PHYSFS_platformRead(info->handle, buf, len);
 }
 
+#ifndef PHYSFS_NO_POSITIONAL_READS
+   static PHYSFS_sint64 nativeIo_readAt(PHYSFS_Io* io, PHYSFS_uint64 offset,
+      void* buf, PHYSFS_uint64 len) {
+      NativeIoInfo* info = (NativeIoInfo*) io->opaque;
+      return __PHYSFS_platformReadAt(info->handle, offset, buf, len);
+   }
+#endif
+
 static PHYSFS_sint64 nativeIo_write(PHYSFS_Io* io, const void* buffer,
    PHYSFS_uint64 len) {
    NativeIoInfo* info = (NativeIoInfo*) io->opaque;
@@ -161,2269 +522,6198 @@ static const PHYSFS_Io __PHYSFS_nativeIoInterface =
    nativeIo_length,
    nativeIo_duplicate,
    nativeIo_flush,
-   nativeIo_destroy
+   nativeIo_destroy,
+#ifndef PHYSFS_NO_POSITIONAL_READS
+   nativeIo_readAt
+#else
+   nullptr
+#endif
 };
 
-PHYSFS_Io* __PHYSFS_createNativeIo(const char* path, const int mode) {
-   assert((mode == 'r') || (mode == 'w') || (mode == 'a'));
-   auto io = PHYSFS_Allocator<PHYSFS_Io>(1, __PHYSFS_nativeIoInterface);
-   auto info = PHYSFS_Allocator<NativeIoInfo>(1);
-   auto pathdup = PHYSFS_Allocator<char>(strlen(path) + 1);
 
-   void* handle = nullptr;
-   if (mode == 'r')
-      handle = __PHYSFS_platformOpenRead(path);
-   else if (mode == 'w')
-      handle = __PHYSFS_platformOpenWrite(path);
-   else if (mode == 'a')
-      handle = __PHYSFS_platformOpenAppend(path);
+#if PHYSFS_HAVE_DIRECT_IO
+///                                                                           
+/// PHYSFS_Io implementation for direct i/o to physical filesystem, past the  
+/// page cache. Reads are done a whole aligned block at a time into one of    
+/// two aligned buffers, while a helper thread fetches the following block    
+/// into the other, so a sequential stream rarely waits on the disk. The      
+/// logical position can be anything, so archive entries that start at odd    
+/// offsets are read just fine                                                
+///                                                                           
+namespace
+{
+   constexpr size_t DirectIoBlock = 1024 * 1024;
+   static_assert(DirectIoBlock % PHYSFS_DIRECT_IO_ALIGNMENT == 0);
+
+   struct DirectIoBuffer {
+      void* raw = nullptr;             // As allocated                  
+      PHYSFS_uint8* data = nullptr;    // Aligned into raw              
+      PHYSFS_uint64 start = 0;         // File offset of data[0]        
+      size_t fill = 0;                 // Valid bytes, 0 if empty       
+   };
+
+   enum class ReadAhead { Idle, Requested, Done };
+
+   struct DirectIoInfo {
+      void* handle = nullptr;
+      char* path = nullptr;
+      PHYSFS_uint64 pos = 0;
+      PHYSFS_uint64 length = 0;        // Read-only, so taken once      
+      DirectIoBuffer buffers[2];
+      int current = 0;                 // The buffer being consumed     
+
+      // Read-ahead into buffers[current ^ 1], by the worker            
+      void* worker = nullptr;          // Once a whole block was read   
+      void* mutex = nullptr;
+      void* wake = nullptr;
+      ReadAhead ahead = ReadAhead::Idle;
+      bool quit = false;
+   };
+
+   /// Read the aligned block at (start). Errors are reported through the     
+   /// usual error state, and only on the calling thread                      
+   PHYSFS_sint64 directIoReadBlock(void* handle, DirectIoBuffer& b, PHYSFS_uint64 start) {
+      b.start = start;
+      b.fill = 0;
+      const auto rc = __PHYSFS_platformReadAt(handle, start, b.data, DirectIoBlock);
+      if (rc > 0)
+         b.fill = static_cast<size_t>(rc);
+      return rc;
+   }
 
-   if (not handle)
-      MetaPhysFS::Throw<PHYSFS_ERR_OUT_OF_MEMORY>();
+   /// The read-ahead is only a hint: if it fails, the block is simply read   
+   /// again when it's needed, which reports the error where it belongs       
+   void directIoWorker(void* opaque) {
+      auto info = static_cast<DirectIoInfo*>(opaque);
+      __PHYSFS_PlatformLock lock {info->mutex};
+      while (true) {
+         lock.wait(info->wake, [info] {
+            return info->quit or info->ahead == ReadAhead::Requested;
+         });
+         if (info->quit)
+            return;
+
+         auto& b = info->buffers[info->current ^ 1];
+         const auto start = b.start;
+         lock.unlock();
+         try { directIoReadBlock(info->handle, b, start); }
+         catch (...) { b.fill = 0; }
+         lock.lock();
+
+         info->ahead = ReadAhead::Done;
+         __PHYSFS_platformBroadcastCond(info->wake);
+      }
+   }
 
-   strcpy(pathdup.Get(), path);
-   info->handle = handle;
-   info->path = pathdup.Ref();
-   info->mode = mode;
-   io->opaque = info.Ref();
-   return io.Ref();
-}
+   /// Make sure the block holding pos is in buffers[current], and queue      
+   /// the block after it                                                     
+   ///   @return false on error                                               
+   bool directIoFill(DirectIoInfo* info) {
+      const auto start = info->pos - info->pos % DirectIoBlock;
+      if (info->buffers[info->current].fill and info->buffers[info->current].start == start)
+         return true;
 
+      bool found = false;
+      {
+         __PHYSFS_PlatformLock lock {info->mutex};
+         lock.wait(info->wake, [info] { return info->ahead != ReadAhead::Requested; });
+         if (info->ahead == ReadAhead::Done) {
+            info->ahead = ReadAhead::Idle;
+            const auto& other = info->buffers[info->current ^ 1];
+            if (other.fill and other.start == start) {
+               info->current ^= 1;
+               found = true;
+            }
+         }
+      }
 
-///                                                                           
-/// PHYSFS_Io implementation for i/o to a memory buffer...                    
-///                                                                           
-struct MemoryIoInfo {
-   const PHYSFS_uint8* buf;
-   PHYSFS_uint64 len;
-   PHYSFS_uint64 pos;
-   PHYSFS_Io* parent;
-   int refcount;
-   void (*destruct)(void*);
-};
+      if (not found and directIoReadBlock(info->handle, info->buffers[info->current], start) < 0)
+         return false;
+
+      // A short block is the end of the file, nothing more to fetch    
+      if (info->buffers[info->current].fill == DirectIoBlock) {
+         if (not info->worker) {
+            // Without a helper, every block is just read when needed   
+            try { info->worker = __PHYSFS_platformCreateThread(directIoWorker, info); }
+            catch (...) {}
+            if (not info->worker)
+               return true;
+         }
 
-static PHYSFS_sint64 memoryIo_read(PHYSFS_Io* io, void* buf, PHYSFS_uint64 len) {
-   MemoryIoInfo* info = (MemoryIoInfo*) io->opaque;
-   const PHYSFS_uint64 avail = info->len - info->pos;
-   assert(avail <= info->len);
+         __PHYSFS_PlatformLock lock {info->mutex};
+         info->buffers[info->current ^ 1].start = start + DirectIoBlock;
+         info->buffers[info->current ^ 1].fill = 0;
+         info->ahead = ReadAhead::Requested;
+         __PHYSFS_platformBroadcastCond(info->wake);
+      }
+      return true;
+   }
 
-   if (avail == 0)
-      return 0;  // We're at EOF; nothing to do                         
+   PHYSFS_sint64 directIo_read(PHYSFS_Io* io, void* buf, PHYSFS_uint64 len) {
+      auto info = static_cast<DirectIoInfo*>(io->opaque);
+      auto out = static_cast<PHYSFS_uint8*>(buf);
+      PHYSFS_sint64 retval = 0;
+
+      while (len > 0) {
+         if (not directIoFill(info))
+            return retval ? retval : -1;
+
+         const auto& b = info->buffers[info->current];
+         const auto offset = static_cast<size_t>(info->pos - b.start);
+         if (offset >= b.fill)
+            break;  // We're at EOF                                     
+
+         const auto count = static_cast<size_t>(std::min<PHYSFS_uint64>(len, b.fill - offset));
+         memcpy(out, b.data + offset, count);
+         out += count;
+         len -= count;
+         info->pos += count;
+         retval += count;
+      }
 
-   if (len > avail)
-      len = avail;
+      return retval;
+   }
 
-   memcpy(buf, info->buf + info->pos, (size_t) len);
-   info->pos += len;
-   return len;
-}
+   PHYSFS_sint64 directIo_write(PHYSFS_Io*, const void*, PHYSFS_uint64) {
+      BAIL(PHYSFS_ERR_OPEN_FOR_READING, -1);
+   }
 
-static PHYSFS_sint64 memoryIo_write(PHYSFS_Io*, const void*, PHYSFS_uint64) {
-   BAIL(PHYSFS_ERR_OPEN_FOR_READING, -1);
-}
+   int directIo_seek(PHYSFS_Io* io, PHYSFS_uint64 offset) {
+      auto info = static_cast<DirectIoInfo*>(io->opaque);
+      BAIL_IF(offset > info->length, PHYSFS_ERR_PAST_EOF, 0);
+      info->pos = offset;
+      return 1;
+   }
 
-static int memoryIo_seek(PHYSFS_Io* io, PHYSFS_uint64 offset) {
-   MemoryIoInfo* info = (MemoryIoInfo*) io->opaque;
-   BAIL_IF(offset > info->len, PHYSFS_ERR_PAST_EOF, 0);
-   info->pos = offset;
-   return 1;
-}
+   PHYSFS_sint64 directIo_tell(PHYSFS_Io* io) {
+      return static_cast<PHYSFS_sint64>(static_cast<DirectIoInfo*>(io->opaque)->pos);
+   }
 
-static PHYSFS_sint64 memoryIo_tell(PHYSFS_Io* io) {
-   const MemoryIoInfo* info = (MemoryIoInfo*) io->opaque;
-   return (PHYSFS_sint64) info->pos;
-}
+   PHYSFS_sint64 directIo_length(PHYSFS_Io* io) {
+      return static_cast<PHYSFS_sint64>(static_cast<DirectIoInfo*>(io->opaque)->length);
+   }
 
-static PHYSFS_sint64 memoryIo_length(PHYSFS_Io* io) {
-   const MemoryIoInfo* info = (MemoryIoInfo*) io->opaque;
-   return (PHYSFS_sint64) info->len;
-}
+   PHYSFS_Io* directIo_duplicate(PHYSFS_Io* io) {
+      return __PHYSFS_createNativeIo(static_cast<DirectIoInfo*>(io->opaque)->path, 'd');
+   }
 
-static PHYSFS_Io* memoryIo_duplicate(PHYSFS_Io* io) {
-   auto info = static_cast<MemoryIoInfo*>(io->opaque);
-   PHYSFS_Io* parent = info->parent;
+   int directIo_flush(PHYSFS_Io*) {
+      return 1;  // It's read-only                                      
+   }
 
-   // Avoid deep copies                                                 
-   assert(not parent or not ((MemoryIoInfo*) parent->opaque)->parent);
+   void directIo_destroy(PHYSFS_Io* io) {
+      auto info = static_cast<DirectIoInfo*>(io->opaque);
+      if (info->worker) {
+         {
+            __PHYSFS_PlatformLock lock {info->mutex};
+            info->quit = true;
+            __PHYSFS_platformBroadcastCond(info->wake);
+         }
+         __PHYSFS_platformJoinThread(info->worker);
+      }
 
-   // Share the buffer between duplicates                               
-   if (parent != nullptr)  // Dup the parent, increment its refcount    
-      return parent->duplicate(parent);
+      __PHYSFS_platformDestroyCond(info->wake);
+      __PHYSFS_platformDestroyMutex(info->mutex);
+      if (info->handle)
+         __PHYSFS_platformClose(info->handle);
+      for (auto& b : info->buffers)
+         allocator.Free(b.raw);
+      allocator.Free(info->path);
+      info->~DirectIoInfo();
+      allocator.Free(info);
+      allocator.Free(io);
+   }
 
-   // We're the parent                                                  
-   auto newinfo = PHYSFS_Allocator<MemoryIoInfo>(1);
-   (void) __PHYSFS_ATOMIC_INCR(&info->refcount);
+   const PHYSFS_Io directIoInterface =
+   {
+      CURRENT_PHYSFS_IO_API_VERSION, nullptr,
+      directIo_read,
+      directIo_write,
+      directIo_seek,
+      directIo_tell,
+      directIo_length,
+      directIo_duplicate,
+      directIo_flush,
+      directIo_destroy,
+      nullptr  // Buffers are per stream, PHYSFS_readAt serializes      
+   };
+
+   /// Open a direct io, or return nullptr if direct i/o is refused           
+   PHYSFS_Io* createDirectIo(const char* path) {
+      void* handle = __PHYSFS_platformOpenReadDirect(path);
+      if (not handle)
+         return nullptr;
+
+      PHYSFS_sint64 length = -1;
+      try { length = __PHYSFS_platformFileLength(handle); }
+      catch (...) {
+         __PHYSFS_platformClose(handle);
+         throw;
+      }
+      if (length < 0) {
+         __PHYSFS_platformClose(handle);
+         return nullptr;
+      }
 
-   memset(newinfo.Get(), 0, sizeof(*info));
-   newinfo->buf = info->buf;
-   newinfo->len = info->len;
-   newinfo->pos = 0;
-   newinfo->parent = io;
-   newinfo->refcount = 0;
-   newinfo->destruct = nullptr;
+      auto info = static_cast<DirectIoInfo*>(allocator.Malloc(sizeof(DirectIoInfo), PHYSFS_ALLOC_FILEHANDLE));
+      if (not info) {
+         __PHYSFS_platformClose(handle);
+         BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+      }
 
-   auto retval = PHYSFS_Allocator<PHYSFS_Io>(1, *io);
-   retval->opaque = newinfo.Ref();
-   return retval.Ref();
-}
+      new (info) DirectIoInfo {};
+      info->handle = handle;
+      info->length = static_cast<PHYSFS_uint64>(length);
+      auto io = static_cast<PHYSFS_Io*>(allocator.Malloc(sizeof(PHYSFS_Io), PHYSFS_ALLOC_FILEHANDLE));
+      info->path = static_cast<char*>(allocator.Malloc(strlen(path) + 1, PHYSFS_ALLOC_FILEHANDLE));
+      bool allocated = io and info->path;
+      for (auto& b : info->buffers) {
+         b.raw = allocator.Malloc(DirectIoBlock + PHYSFS_DIRECT_IO_ALIGNMENT, PHYSFS_ALLOC_CACHE);
+         if (b.raw) {
+            const auto addr = reinterpret_cast<uintptr_t>(b.raw);
+            const auto mask = uintptr_t(PHYSFS_DIRECT_IO_ALIGNMENT - 1);
+            b.data = reinterpret_cast<PHYSFS_uint8*>((addr + mask) & ~mask);
+         }
+         else allocated = false;
+      }
 
-static int memoryIo_flush(PHYSFS_Io*) {
-   return 1;  // It's read-only                                         
-}
+      auto discard = [&] {
+         __PHYSFS_platformClose(handle);
+         if (info->wake)
+            __PHYSFS_platformDestroyCond(info->wake);
+         if (info->mutex)
+            __PHYSFS_platformDestroyMutex(info->mutex);
+         for (auto& b : info->buffers)
+            allocator.Free(b.raw);
+         allocator.Free(info->path);
+         allocator.Free(io);
+         info->~DirectIoInfo();
+         allocator.Free(info);
+      };
+
+      if (not allocated) {
+         discard();
+         BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+      }
 
-static void memoryIo_destroy(PHYSFS_Io* io) {
-   auto info = static_cast<MemoryIoInfo*>(io->opaque);
-   auto parent = info->parent;
+      try {
+         info->mutex = __PHYSFS_platformCreateMutex();
+         info->wake = __PHYSFS_platformCreateCond();
+      }
+      catch (...) {
+         discard();
+         throw;
+      }
 
-   if (parent) {
-      assert(info->buf == ((MemoryIoInfo*) info->parent->opaque)->buf);
-      assert(info->len == ((MemoryIoInfo*) info->parent->opaque)->len);
-      assert(info->refcount == 0);
-      assert(info->destruct == nullptr);
-      PHYSFS_Allocator<>::Free(info);
-      PHYSFS_Allocator<>::Free(io);
-      parent->destroy(parent);   // Decrements refcount                 
-      return;
+      strcpy(info->path, path);
+      memcpy(io, &directIoInterface, sizeof(PHYSFS_Io));
+      io->opaque = info;
+      return io;
    }
 
-   // We _are_ the parent                                               
-   assert(info->refcount > 0);   // Even in a race, we hold a reference 
+   ///                                                                        
+   /// An archive entry stored as-is, read through a direct io of its own on  
+   /// the whole archive file, for PHYSFS_openReadDirect                      
+   ///                                                                        
+   struct WindowIoInfo {
+      PHYSFS_Io* io;                   // Owned, sought before each read
+      PHYSFS_uint64 start;             // Where the entry starts in io  
+      PHYSFS_uint64 length;
+      PHYSFS_uint64 pos;
+   };
 
-   if (__PHYSFS_ATOMIC_DECR(&info->refcount) == 0) {
-      void (*destruct)(void*) = info->destruct;
-      void* buf = (void*) info->buf;
-      io->opaque = nullptr;      // Kill this here in case of race      
-      PHYSFS_Allocator<>::Free(info);
-      PHYSFS_Allocator<>::Free(io);
-      if (destruct)
-         destruct(buf);
+   PHYSFS_Io* createWindowIo(PHYSFS_Io* io, PHYSFS_uint64 start, PHYSFS_uint64 length);
+
+   PHYSFS_sint64 windowIo_read(PHYSFS_Io* io, void* buf, PHYSFS_uint64 len) {
+      auto info = static_cast<WindowIoInfo*>(io->opaque);
+      len = std::min(len, info->length - info->pos);
+      if (not len)
+         return 0;
+
+      BAIL_IF_ERRPASS(not info->io->seek(info->io, info->start + info->pos), -1);
+      const auto rc = info->io->read(info->io, buf, len);
+      if (rc > 0)
+         info->pos += static_cast<PHYSFS_uint64>(rc);
+      return rc;
    }
-}
 
-static const PHYSFS_Io __PHYSFS_memoryIoInterface =
-{
-   CURRENT_PHYSFS_IO_API_VERSION, nullptr,
-   memoryIo_read,
-   memoryIo_write,
-   memoryIo_seek,
-   memoryIo_tell,
-   memoryIo_length,
-   memoryIo_duplicate,
-   memoryIo_flush,
-   memoryIo_destroy
-};
+   PHYSFS_sint64 windowIo_write(PHYSFS_Io*, const void*, PHYSFS_uint64) {
+      BAIL(PHYSFS_ERR_OPEN_FOR_READING, -1);
+   }
 
-PHYSFS_Io* __PHYSFS_createMemoryIo(const void* buf, PHYSFS_uint64 len, void (*destruct)(void*)) {
-   auto io = PHYSFS_Allocator<PHYSFS_Io>(1, __PHYSFS_memoryIoInterface);
-   auto info = PHYSFS_Allocator<MemoryIoInfo>(1);
+   int windowIo_seek(PHYSFS_Io* io, PHYSFS_uint64 offset) {
+      auto info = static_cast<WindowIoInfo*>(io->opaque);
+      BAIL_IF(offset > info->length, PHYSFS_ERR_PAST_EOF, 0);
+      info->pos = offset;
+      return 1;
+   }
 
-   memset(info.Get(), 0, sizeof(MemoryIoInfo));
-   info->buf = (const PHYSFS_uint8*) buf;
-   info->len = len;
-   info->pos = 0;
-   info->parent = nullptr;
-   info->refcount = 1;
-   info->destruct = destruct;
-   io->opaque = info.Ref();
-   return io.Ref();
-}
+   PHYSFS_sint64 windowIo_tell(PHYSFS_Io* io) {
+      return static_cast<PHYSFS_sint64>(static_cast<WindowIoInfo*>(io->opaque)->pos);
+   }
 
+   PHYSFS_sint64 windowIo_length(PHYSFS_Io* io) {
+      return static_cast<PHYSFS_sint64>(static_cast<WindowIoInfo*>(io->opaque)->length);
+   }
 
-///                                                                           
-/// PHYSFS_Io implementation for i/o to a PHYSFS_File...                      
-///                                                                           
-static PHYSFS_sint64 handleIo_read(PHYSFS_Io* io, void* buf, PHYSFS_uint64 len) {
-   return PHYSFS_readBytes((PHYSFS_File*) io->opaque, buf, len);
-}
+   PHYSFS_Io* windowIo_duplicate(PHYSFS_Io* io) {
+      auto info = static_cast<WindowIoInfo*>(io->opaque);
+      auto dup = info->io->duplicate(info->io);
+      BAIL_IF_ERRPASS(not dup, nullptr);
 
-static PHYSFS_sint64 handleIo_write(PHYSFS_Io* io, const void* buffer,
-   PHYSFS_uint64 len) {
-   return PHYSFS_writeBytes((PHYSFS_File*) io->opaque, buffer, len);
-}
+      PHYSFS_Io* retval = nullptr;
+      try { retval = createWindowIo(dup, info->start, info->length); }
+      catch (...) {
+         dup->destroy(dup);
+         throw;
+      }
+      if (not retval)
+         dup->destroy(dup);
+      return retval;
+   }
 
-static int handleIo_seek(PHYSFS_Io* io, PHYSFS_uint64 offset) {
-   return PHYSFS_seek((PHYSFS_File*) io->opaque, offset);
-}
+   int windowIo_flush(PHYSFS_Io*) {
+      return 1;  // It's read-only                                      
+   }
 
-static PHYSFS_sint64 handleIo_tell(PHYSFS_Io* io) {
-   return PHYSFS_tell((PHYSFS_File*) io->opaque);
+   void windowIo_destroy(PHYSFS_Io* io) {
+      auto info = static_cast<WindowIoInfo*>(io->opaque);
+      info->io->destroy(info->io);
+      allocator.Free(info);
+      allocator.Free(io);
+   }
+
+   const PHYSFS_Io windowIoInterface =
+   {
+      CURRENT_PHYSFS_IO_API_VERSION, nullptr,
+      windowIo_read,
+      windowIo_write,
+      windowIo_seek,
+      windowIo_tell,
+      windowIo_length,
+      windowIo_duplicate,
+      windowIo_flush,
+      windowIo_destroy,
+      nullptr  // Same as the direct io underneath                      
+   };
+
+   /// Take over (io), and read (length) bytes of it from (start) on          
+   ///   @return the window, or nullptr (leaving io to the caller)            
+   PHYSFS_Io* createWindowIo(PHYSFS_Io* io, PHYSFS_uint64 start, PHYSFS_uint64 length) {
+      auto info = static_cast<WindowIoInfo*>(allocator.Malloc(sizeof(WindowIoInfo), PHYSFS_ALLOC_FILEHANDLE));
+      auto retval = static_cast<PHYSFS_Io*>(allocator.Malloc(sizeof(PHYSFS_Io), PHYSFS_ALLOC_FILEHANDLE));
+      if (not info or not retval) {
+         allocator.Free(info);
+         allocator.Free(retval);
+         BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+      }
+
+      *info = {io, start, length, 0};
+      memcpy(retval, &windowIoInterface, sizeof(PHYSFS_Io));
+      retval->opaque = info;
+      return retval;
+   }
 }
+#endif
 
-static PHYSFS_sint64 handleIo_length(PHYSFS_Io* io) {
-   return PHYSFS_fileLength((PHYSFS_File*) io->opaque);
+/// The calling thread's i/o class, see PHYSFS_setIoPriority. Only the        
+/// scheduled io below ever looks at it                                       
+namespace
+{
+   thread_local PHYSFS_IoPriority ioPriority = PHYSFS_IO_CRITICAL;
+   thread_local PHYSFS_uint32 ioDeadlineUs = 0;
+
+   /// Raised while this thread holds stateLock for an open or a mount,       
+   /// which every other open waits on                                        
+   thread_local int ioUnderStateLock = 0;
+
+   struct IoUnderStateLock {
+      IoUnderStateLock() { ++ioUnderStateLock; }
+      ~IoUnderStateLock() { --ioUnderStateLock; }
+   };
+
+   /// Lowers it again while stateLock is let go in the middle of an open     
+   struct IoOutsideStateLock {
+      IoOutsideStateLock() { --ioUnderStateLock; }
+      ~IoOutsideStateLock() { ++ioUnderStateLock; }
+   };
 }
 
-static PHYSFS_Io* handleIo_duplicate(PHYSFS_Io* io) {
-   // There's no duplicate at the PHYSFS_File level, so we break the    
-   // abstraction. We're allowed to: we're physfs.c!                    
-   auto origfh = static_cast<FileHandle*>(io->opaque);
-   auto newfh = PHYSFS_Allocator<FileHandle>(1);
-   memset(newfh.Get(), 0, sizeof(FileHandle));
+#if PHYSFS_HAVE_READ_AHEAD
+///                                                                           
+/// PHYSFS_Io decorator, that keeps a ring of chunks read ahead of a          
+/// sequential consumer. A helper thread fills the free chunks from the       
+/// wrapped io, while the consumer drains the filled ones, so the wrapped     
+/// io's latency overlaps with whatever the consumer does with the data       
+///                                                                           
+namespace
+{
+   struct ReadAheadChunk {
+      PHYSFS_uint8* data = nullptr;
+      size_t fill = 0;                 // Valid bytes                   
+   };
+
+   struct ReadAheadIoInfo {
+      PHYSFS_Io* io = nullptr;         // Wrapped, owned                
+      PHYSFS_uint64 end = 0;           // Never read past this          
+      PHYSFS_sint64 length = 0;
+      size_t chunkSize = 0;
+      int chunkCount = 0;
+      ReadAheadChunk* chunks = nullptr;
+      PHYSFS_uint64 pos = 0;           // Logical position              
+
+      // Everything below is guarded by mutex. The consumer owns the    
+      // (filled) chunks starting at head, the worker fills the next    
+      // free one, which is the only chunk it ever touches              
+      int head = 0;
+      int filled = 0;
+      size_t headOffset = 0;           // Bytes consumed from head      
+      PHYSFS_uint64 next = 0;          // Wrapped io's position         
+      bool busy = false;               // Worker is inside io->read     
+      bool stopped = false;            // At end, or failed             
+      bool failed = false;
+
+      void* worker = nullptr;          // Started on the first read     
+      void* mutex = nullptr;
+      void* wake = nullptr;
+      PHYSFS_IoPriority priority = PHYSFS_IO_CRITICAL;
+      bool quit = false;
+   };
+
+   /// Reading ahead is only a hint: on failure the worker just stops, and    
+   /// the consumer repeats the read itself, so the error is reported on the  
+   /// thread that asked for the data. It runs in the class of the consumer   
+   /// that started it, demoted to streaming at best                          
+   void readAheadWorker(void* opaque) {
+      auto info = static_cast<ReadAheadIoInfo*>(opaque);
+      ioPriority = std::max(info->priority, PHYSFS_IO_STREAMING);
+      __PHYSFS_PlatformLock lock {info->mutex};
+      while (true) {
+         lock.wait(info->wake, [info] {
+            return info->quit or (not info->stopped and info->filled < info->chunkCount);
+         });
+         if (info->quit)
+            return;
+
+         auto& c = info->chunks[(info->head + info->filled) % info->chunkCount];
+         const auto want = std::min<PHYSFS_uint64>(info->chunkSize, info->end - info->next);
+         info->busy = true;
+         lock.unlock();
+
+         PHYSFS_sint64 rc;
+         try { rc = info->io->read(info->io, c.data, want); }
+         catch (...) { rc = -1; }
+
+         lock.lock();
+         info->busy = false;
+         if (rc > 0) {
+            c.fill = static_cast<size_t>(rc);
+            info->next += rc;
+            info->filled++;
+         }
+         if (rc <= 0 or info->next >= info->end) {
+            info->stopped = true;
+            info->failed = rc < 0;
+         }
+         __PHYSFS_platformBroadcastCond(info->wake);
+      }
+   }
 
-   newfh->io = origfh->io->duplicate(origfh->io);
-   newfh->forReading = origfh->forReading;
-   newfh->dirHandle = origfh->dirHandle;
+   PHYSFS_sint64 readAheadIo_read(PHYSFS_Io* io, void* buf, PHYSFS_uint64 len) {
+      auto info = static_cast<ReadAheadIoInfo*>(io->opaque);
+      auto out = static_cast<PHYSFS_uint8*>(buf);
+      PHYSFS_sint64 retval = 0;
 
-   __PHYSFS_platformGrabMutex(stateLock);
-      if (newfh->forReading) {
-         newfh->next = openReadList;
-         openReadList = newfh.Get();
+      if (not info->worker) {
+         info->priority = ioPriority;
+         info->worker = __PHYSFS_platformCreateThread(readAheadWorker, info);
       }
-      else {
-         newfh->next = openWriteList;
-         openWriteList = newfh.Get();
+
+      while (len > 0) {
+         __PHYSFS_PlatformLock lock {info->mutex};
+         lock.wait(info->wake, [info] { return info->filled > 0 or info->stopped; });
+
+         if (info->filled == 0) {
+            if (not info->failed)
+               break;  // We're at the end                              
+
+            // The worker is parked, so the wrapped io is ours now. Retry
+            // the read here: it either reports the error to the caller,
+            // or it was transient and reading ahead resumes            
+            const auto want = std::min<PHYSFS_uint64>(len, info->end - info->next);
+            BAIL_IF_ERRPASS(not info->io->seek(info->io, info->next), retval ? retval : -1);
+            const auto rc = info->io->read(info->io, out, want);
+            BAIL_IF_ERRPASS(rc < 0, retval ? retval : -1);
+            info->next += rc;
+            info->pos += rc;
+            retval += rc;
+            if (rc == 0)
+               break;
+
+            out += rc;
+            len -= rc;
+            info->stopped = info->next >= info->end;
+            info->failed = false;
+            __PHYSFS_platformBroadcastCond(info->wake);
+            continue;
+         }
+         lock.unlock();
+
+         auto& c = info->chunks[info->head];
+         const auto count = static_cast<size_t>(std::min<PHYSFS_uint64>(len, c.fill - info->headOffset));
+         memcpy(out, c.data + info->headOffset, count);
+         out += count;
+         len -= count;
+         info->pos += count;
+         retval += count;
+
+         lock.lock();
+         info->headOffset += count;
+         if (info->headOffset == c.fill) {
+            info->head = (info->head + 1) % info->chunkCount;
+            info->headOffset = 0;
+            info->filled--;
+            __PHYSFS_platformBroadcastCond(info->wake);
+         }
       }
-   __PHYSFS_platformReleaseMutex(stateLock);
 
-   auto retval = PHYSFS_Allocator<PHYSFS_Io>(1, *io);
-   retval->opaque = newfh.Ref();
-   return retval.Ref();
-}
+      return retval;
+   }
 
-static int handleIo_flush(PHYSFS_Io* io) {
-   return PHYSFS_flush((PHYSFS_File*) io->opaque);
-}
+   PHYSFS_sint64 readAheadIo_write(PHYSFS_Io*, const void*, PHYSFS_uint64) {
+      BAIL(PHYSFS_ERR_OPEN_FOR_READING, -1);
+   }
 
-static void handleIo_destroy(PHYSFS_Io* io) {
-   if (io->opaque)
-      PHYSFS_close((PHYSFS_File*) io->opaque);
-   PHYSFS_Allocator<>::Free(io);
-}
+   /// Seeking drops the whole ring, once the worker is out of the wrapped    
+   /// io, and restarts the pipeline from the new position                    
+   int readAheadIo_seek(PHYSFS_Io* io, PHYSFS_uint64 offset) {
+      auto info = static_cast<ReadAheadIoInfo*>(io->opaque);
+      if (offset == info->pos)
+         return 1;
 
-static const PHYSFS_Io __PHYSFS_handleIoInterface = {
-   CURRENT_PHYSFS_IO_API_VERSION, nullptr,
-   handleIo_read,
-   handleIo_write,
-   handleIo_seek,
-   handleIo_tell,
-   handleIo_length,
-   handleIo_duplicate,
-   handleIo_flush,
-   handleIo_destroy
-};
+      __PHYSFS_PlatformLock lock {info->mutex};
+      lock.wait(info->wake, [info] { return not info->busy; });
+      BAIL_IF_ERRPASS(not info->io->seek(info->io, offset), 0);
+      info->pos = info->next = offset;
+      info->head = info->filled = 0;
+      info->headOffset = 0;
+      info->stopped = offset >= info->end;
+      info->failed = false;
+      __PHYSFS_platformBroadcastCond(info->wake);
+      return 1;
+   }
 
-static PHYSFS_Io* __PHYSFS_createHandleIo(PHYSFS_File* f) {
-   auto io = PHYSFS_Allocator<PHYSFS_Io>(1, __PHYSFS_handleIoInterface);
-   io->opaque = f;
-   return io.Ref();
-}
+   PHYSFS_sint64 readAheadIo_tell(PHYSFS_Io* io) {
+      return static_cast<PHYSFS_sint64>(static_cast<ReadAheadIoInfo*>(io->opaque)->pos);
+   }
 
+   /// Cached when wrapping, the wrapped io might be busy on the worker       
+   PHYSFS_sint64 readAheadIo_length(PHYSFS_Io* io) {
+      return static_cast<ReadAheadIoInfo*>(io->opaque)->length;
+   }
 
-///                                                                           
-/// Functions ...                                                             
-///                                                                           
+   PHYSFS_Io* readAheadIo_duplicate(PHYSFS_Io* io) {
+      auto info = static_cast<ReadAheadIoInfo*>(io->opaque);
+      auto dup = info->io->duplicate(info->io);
+      BAIL_IF_ERRPASS(not dup, nullptr);
 
-struct EnumStringListCallbackData {
-   char** list;
-   PHYSFS_uint32 size;
-   PHYSFS_ErrorCode errcode;
-};
+      auto retval = __PHYSFS_createReadAheadIo(dup, info->end, info->chunkSize, info->chunkCount);
+      if (not retval)
+         return dup;  // Still a valid duplicate, just not a fast one   
+      return retval;
+   }
 
-static void enumStringListCallback(void* data, const char* str) {
-   auto pecd = static_cast<EnumStringListCallbackData*>(data);
-   if (pecd->errcode)
-      return;
+   int readAheadIo_flush(PHYSFS_Io*) {
+      return 1;  // It's read-only                                      
+   }
 
-   auto ptr = PHYSFS_Allocator<>::Realloc(pecd->list, (pecd->size + 2) * sizeof(char*));
-   auto newstr = PHYSFS_Allocator<char>(strlen(str) + 1);
-   if (ptr)
-      pecd->list = (char**) ptr;
+   void readAheadIo_destroy(PHYSFS_Io* io) {
+      auto info = static_cast<ReadAheadIoInfo*>(io->opaque);
+      if (info->worker) {
+         {
+            __PHYSFS_PlatformLock lock {info->mutex};
+            info->quit = true;
+            __PHYSFS_platformBroadcastCond(info->wake);
+         }
+         __PHYSFS_platformJoinThread(info->worker);
+      }
 
-   if (not ptr or not newstr) {
-      pecd->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
-      pecd->list[pecd->size] = nullptr;
-      PHYSFS_freeList(pecd->list);
-      return;
+      __PHYSFS_platformDestroyCond(info->wake);
+      __PHYSFS_platformDestroyMutex(info->mutex);
+      info->io->destroy(info->io);
+      allocator.Free(info->chunks);
+      info->~ReadAheadIoInfo();
+      allocator.Free(info);
+      allocator.Free(io);
    }
 
-   strcpy(newstr.Get(), str);
-   pecd->list[pecd->size] = newstr.Ref();
-   pecd->size++;
-}
+   const PHYSFS_Io readAheadIoInterface =
+   {
+      CURRENT_PHYSFS_IO_API_VERSION, nullptr,
+      readAheadIo_read,
+      readAheadIo_write,
+      readAheadIo_seek,
+      readAheadIo_tell,
+      readAheadIo_length,
+      readAheadIo_duplicate,
+      readAheadIo_flush,
+      readAheadIo_destroy,
+      nullptr  // The ring is per stream, PHYSFS_readAt serializes      
+   };
+}
+
+/// The chunks live in one block, right after their descriptors               
+PHYSFS_Io* __PHYSFS_createReadAheadIo(PHYSFS_Io* io, PHYSFS_uint64 end, size_t chunkSize, int chunkCount) {
+   assert(chunkSize > 0 and chunkCount > 1);
+   const auto at = io->tell(io);
+   const auto length = io->length(io);
+   if (at < 0 or length < 0)
+      return nullptr;
 
-static char** doEnumStringList(void (*func)(PHYSFS_StringCallback, void*)) {
-   EnumStringListCallbackData ecd;
-   memset(&ecd, '\0', sizeof(ecd));
-   ecd.list = PHYSFS_Allocator<char*>(1).Ref();
-   func(enumStringListCallback, &ecd);
+   auto retval = static_cast<PHYSFS_Io*>(allocator.Malloc(sizeof(PHYSFS_Io), PHYSFS_ALLOC_FILEHANDLE));
+   auto info = static_cast<ReadAheadIoInfo*>(allocator.Malloc(sizeof(ReadAheadIoInfo), PHYSFS_ALLOC_FILEHANDLE));
+   auto chunks = static_cast<ReadAheadChunk*>(allocator.Malloc(
+      (sizeof(ReadAheadChunk) + chunkSize) * chunkCount, PHYSFS_ALLOC_CACHE));
+   void* mutex = nullptr;
+   void* wake = nullptr;
+   if (retval and info and chunks) {
+      try {
+         mutex = __PHYSFS_platformCreateMutex();
+         wake = __PHYSFS_platformCreateCond();
+      }
+      catch (...) {}
+   }
 
-   if (ecd.errcode) {
-      PHYSFS_setErrorCode(ecd.errcode);
+   if (not wake) {
+      if (mutex)
+         __PHYSFS_platformDestroyMutex(mutex);
+      allocator.Free(retval);
+      allocator.Free(info);
+      allocator.Free(chunks);
       return nullptr;
    }
 
-   ecd.list[ecd.size] = nullptr;
-   return ecd.list;
+   auto data = reinterpret_cast<PHYSFS_uint8*>(chunks + chunkCount);
+   for (int i = 0; i < chunkCount; ++i)
+      new (chunks + i) ReadAheadChunk {data + chunkSize * i, 0};
+
+   new (info) ReadAheadIoInfo {};
+   info->io = io;
+   info->end = std::min<PHYSFS_uint64>(end, static_cast<PHYSFS_uint64>(length));
+   info->length = length;
+   info->chunkSize = chunkSize;
+   info->chunkCount = chunkCount;
+   info->chunks = chunks;
+   info->mutex = mutex;
+   info->wake = wake;
+   info->pos = info->next = static_cast<PHYSFS_uint64>(at);
+   info->stopped = info->next >= info->end;
+
+   memcpy(retval, &readAheadIoInterface, sizeof(PHYSFS_Io));
+   retval->opaque = info;
+   return retval;
 }
 
-static void __PHYSFS_bubble_sort(void* a, size_t lo, size_t hi,
-   int (*cmpfn)(void*, size_t, size_t),
-   void (*swapfn)(void*, size_t, size_t)) {
-   size_t i;
-   int sorted;
+PHYSFS_uint64 __PHYSFS_readAheadMinSize() {
+   return ctx().readAheadMinSize.load(std::memory_order_relaxed);
+}
+#endif
 
-   do {
-      sorted = 1;
-      for (i = lo; i < hi; i++) {
-         if (cmpfn(a, i, i + 1) > 0) {
-            swapfn(a, i, i + 1);
-            sorted = 0;
+#ifndef PHYSFS_NO_THREADS
+///                                                                           
+/// PHYSFS_Io decorator, that makes the wrapped io behave like slower media.  
+/// Every duplicate shares one simulated device, with a single head, a        
+/// single link and a single request queue, the way every file in an archive  
+/// shares the one disk the archive is on                                     
+///                                                                           
+namespace
+{
+   struct SimulatedDevice {
+      PHYSFS_SimulatedMedia media {};
+      std::atomic<int> refCount {1};
+      void* mutex = nullptr;
+      void* slotFree = nullptr;        // Broadcast as requests finish  
+
+      // Everything below is guarded by mutex                           
+      unsigned inFlight = 0;
+      PHYSFS_uint64 head = 0;          // Where the last request ended  
+      PHYSFS_uint64 rng = 0;           // Jitter, splitmix64 state      
+      std::chrono::steady_clock::time_point linkFreeAt {};
+      PHYSFS_SimulatedStats stats {};
+   };
+
+   struct SimulatedIoInfo {
+      PHYSFS_Io* io = nullptr;         // Wrapped, owned                
+      SimulatedDevice* device = nullptr;
+      PHYSFS_uint64 pos = 0;
+   };
+
+   /// Holds one of the device's queue slots, for the whole of a request      
+   class SimulatedRequest {
+      SimulatedDevice* device;
+
+   public:
+      explicit SimulatedRequest(SimulatedDevice* d) : device {d} {
+         __PHYSFS_PlatformLock lock {device->mutex};
+         const auto depth = device->media.queueDepth;
+         lock.wait(device->slotFree, [this, depth] {
+            return depth == 0 or device->inFlight < depth;
+         });
+         device->inFlight++;
+      }
+
+      ~SimulatedRequest() {
+         __PHYSFS_PlatformLock lock {device->mutex};
+         device->inFlight--;
+         __PHYSFS_platformBroadcastCond(device->slotFree);
+      }
+
+      /// Charge a finished transfer of (len) bytes at (offset) to the        
+      /// device, and sleep until the simulated media would have delivered it 
+      void Complete(PHYSFS_uint64 offset, PHYSFS_uint64 len) {
+         const auto& media = device->media;
+         __PHYSFS_PlatformLock lock {device->mutex};
+
+         PHYSFS_uint64 us = media.latencyUs;
+         if (media.jitterUs) {
+            auto z = (device->rng += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            us += (z ^ (z >> 31)) % (PHYSFS_uint64(media.jitterUs) + 1);
+         }
+         if (offset != device->head) {
+            us += media.seekUs;
+            device->stats.seeks++;
          }
+         device->head = offset + len;
+
+         // The link is shared: a transfer can't start before the ones  
+         // already on it are done, however deep the queue is           
+         const auto now = std::chrono::steady_clock::now();
+         auto ready = now + std::chrono::microseconds(us);
+         if (media.bytesPerSecond) {
+            const auto transfer = len * 1000000 / media.bytesPerSecond;
+            ready = std::max(ready, device->linkFreeAt) + std::chrono::microseconds(transfer);
+            device->linkFreeAt = ready;
+            us += transfer;
+         }
+
+         device->stats.requests++;
+         device->stats.bytes += len;
+         device->stats.busyUs += us;
+         lock.unlock();
+         std::this_thread::sleep_until(ready);
       }
+   };
+
+   PHYSFS_sint64 simulatedIo_read(PHYSFS_Io* io, void* buf, PHYSFS_uint64 len) {
+      auto info = static_cast<SimulatedIoInfo*>(io->opaque);
+      SimulatedRequest request {info->device};
+      const auto rc = info->io->read(info->io, buf, len);
+      if (rc > 0) {
+         request.Complete(info->pos, PHYSFS_uint64(rc));
+         info->pos += rc;
+      }
+      return rc;
    }
-   while (not sorted);
-}
 
-static void __PHYSFS_quick_sort(
-   void* a, size_t lo, size_t hi,
-   int (*cmpfn)(void*, size_t, size_t),
-   void (*swapfn)(void*, size_t, size_t)
-) {
-   size_t i, j, v;
+   PHYSFS_sint64 simulatedIo_write(PHYSFS_Io* io, const void* buf, PHYSFS_uint64 len) {
+      auto info = static_cast<SimulatedIoInfo*>(io->opaque);
+      SimulatedRequest request {info->device};
+      const auto rc = info->io->write(info->io, buf, len);
+      if (rc > 0) {
+         request.Complete(info->pos, PHYSFS_uint64(rc));
+         info->pos += rc;
+      }
+      return rc;
+   }
 
-   if ((hi - lo) <= PHYSFS_QUICKSORT_THRESHOLD)
-      __PHYSFS_bubble_sort(a, lo, hi, cmpfn, swapfn);
-   else {
-      i = (hi + lo) / 2;
+   /// Seeking is free, the head only moves when a request needs it to        
+   int simulatedIo_seek(PHYSFS_Io* io, PHYSFS_uint64 offset) {
+      auto info = static_cast<SimulatedIoInfo*>(io->opaque);
+      BAIL_IF_ERRPASS(not info->io->seek(info->io, offset), 0);
+      info->pos = offset;
+      return 1;
+   }
 
-      if (cmpfn(a, lo, i) > 0)
-         swapfn(a, lo, i);
-      if (cmpfn(a, lo, hi) > 0)
-         swapfn(a, lo, hi);
-      if (cmpfn(a, i, hi) > 0)
-         swapfn(a, i, hi);
+   PHYSFS_sint64 simulatedIo_tell(PHYSFS_Io* io) {
+      return static_cast<PHYSFS_sint64>(static_cast<SimulatedIoInfo*>(io->opaque)->pos);
+   }
 
-      j = hi - 1;
-      swapfn(a, i, j);
-      i = lo;
-      v = j;
+   PHYSFS_sint64 simulatedIo_length(PHYSFS_Io* io) {
+      auto inner = static_cast<SimulatedIoInfo*>(io->opaque)->io;
+      return inner->length(inner);
+   }
 
-      while (1) {
-         while (cmpfn(a, ++i, v) < 0) { /* do nothing */ }
-         while (cmpfn(a, --j, v) > 0) { /* do nothing */ }
-         if (j < i)
-            break;
-         swapfn(a, i, j);
+   PHYSFS_Io* simulatedIo_duplicate(PHYSFS_Io* io) {
+      auto info = static_cast<SimulatedIoInfo*>(io->opaque);
+      auto dup = info->io->duplicate(info->io);
+      BAIL_IF_ERRPASS(not dup, nullptr);
+      const auto at = dup->tell(dup);
+
+      auto retval = static_cast<PHYSFS_Io*>(allocator.Malloc(sizeof(PHYSFS_Io), PHYSFS_ALLOC_FILEHANDLE));
+      auto dupInfo = static_cast<SimulatedIoInfo*>(allocator.Malloc(sizeof(SimulatedIoInfo), PHYSFS_ALLOC_FILEHANDLE));
+      if (at < 0 or not retval or not dupInfo) {
+         allocator.Free(retval);
+         allocator.Free(dupInfo);
+         dup->destroy(dup);
+         BAIL_IF_ERRPASS(at < 0, nullptr);
+         BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
       }
 
-      if (i != (hi - 1))
-         swapfn(a, i, hi - 1);
+      info->device->refCount.fetch_add(1, std::memory_order_relaxed);
+      new (dupInfo) SimulatedIoInfo {dup, info->device, static_cast<PHYSFS_uint64>(at)};
+      memcpy(retval, io, sizeof(PHYSFS_Io));
+      retval->opaque = dupInfo;
+      return retval;
+   }
 
-      __PHYSFS_quick_sort(a, lo, j, cmpfn, swapfn);
-      __PHYSFS_quick_sort(a, i + 1, hi, cmpfn, swapfn);
+   int simulatedIo_flush(PHYSFS_Io* io) {
+      auto inner = static_cast<SimulatedIoInfo*>(io->opaque)->io;
+      return inner->flush ? inner->flush(inner) : 1;
    }
-}
 
-void __PHYSFS_sort(
-   void* entries, size_t max,
-   int  (*cmpfn)(void*, size_t, size_t),
-   void (*swapfn)(void*, size_t, size_t)
-) {
-   /// Quicksort w/ Bubblesort fallback algorithm inspired by code from here: 
-   ///   https://www.cs.ubc.ca/spider/harrison/Java/sorting-demo.html         
-   if (max > 0)
-      __PHYSFS_quick_sort(entries, 0, max - 1, cmpfn, swapfn);
-}
+   void simulatedIo_destroy(PHYSFS_Io* io) {
+      auto info = static_cast<SimulatedIoInfo*>(io->opaque);
+      info->io->destroy(info->io);
+      if (info->device->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+         __PHYSFS_platformDestroyCond(info->device->slotFree);
+         __PHYSFS_platformDestroyMutex(info->device->mutex);
+         info->device->~SimulatedDevice();
+         allocator.Free(info->device);
+      }
+      info->~SimulatedIoInfo();
+      allocator.Free(info);
+      allocator.Free(io);
+   }
 
-static ErrState* findErrorForCurrentThread(void) {
-   ErrState* i;
-   void* tid;
+   /// Concurrent positional reads are what the queue depth is there for      
+   PHYSFS_sint64 simulatedIo_readAt(PHYSFS_Io* io, PHYSFS_uint64 offset, void* buf, PHYSFS_uint64 len) {
+      auto info = static_cast<SimulatedIoInfo*>(io->opaque);
+      SimulatedRequest request {info->device};
+      const auto rc = info->io->readAt(info->io, offset, buf, len);
+      if (rc > 0)
+         request.Complete(offset, PHYSFS_uint64(rc));
+      return rc;
+   }
 
-   if (errorLock)
-      __PHYSFS_platformGrabMutex(errorLock);
+   const PHYSFS_Io simulatedIoInterface =
+   {
+      CURRENT_PHYSFS_IO_API_VERSION, nullptr,
+      simulatedIo_read,
+      simulatedIo_write,
+      simulatedIo_seek,
+      simulatedIo_tell,
+      simulatedIo_length,
+      simulatedIo_duplicate,
+      simulatedIo_flush,
+      simulatedIo_destroy,
+      simulatedIo_readAt
+   };
+}
+
+PHYSFS_Io* PHYSFS_createSimulatedIo(PHYSFS_Io* io, const PHYSFS_SimulatedMedia* media) {
+   BAIL_IF(not io, PHYSFS_ERR_INVALID_ARGUMENT, nullptr);
+   const auto at = io->tell(io);
+   BAIL_IF_ERRPASS(at < 0, nullptr);
+
+   auto retval = static_cast<PHYSFS_Io*>(allocator.Malloc(sizeof(PHYSFS_Io), PHYSFS_ALLOC_FILEHANDLE));
+   auto info = static_cast<SimulatedIoInfo*>(allocator.Malloc(sizeof(SimulatedIoInfo), PHYSFS_ALLOC_FILEHANDLE));
+   auto device = static_cast<SimulatedDevice*>(allocator.Malloc(sizeof(SimulatedDevice), PHYSFS_ALLOC_FILEHANDLE));
+   if (not retval or not info or not device) {
+      allocator.Free(retval);
+      allocator.Free(info);
+      allocator.Free(device);
+      BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+   }
 
-   if (errorStates) {
-      tid = __PHYSFS_platformGetThreadID();
+   new (device) SimulatedDevice {};
+   try {
+      device->mutex = __PHYSFS_platformCreateMutex();
+      if (device->mutex)
+         device->slotFree = __PHYSFS_platformCreateCond();
+   }
+   catch (...) {
+      if (device->mutex)
+         __PHYSFS_platformDestroyMutex(device->mutex);
+      allocator.Free(retval);
+      allocator.Free(info);
+      allocator.Free(device);
+      throw;
+   }
+   if (not device->slotFree) {
+      if (device->mutex)
+         __PHYSFS_platformDestroyMutex(device->mutex);
+      allocator.Free(retval);
+      allocator.Free(info);
+      allocator.Free(device);
+      return nullptr;
+   }
 
-      for (i = errorStates; i; i = i->next) {
-         if (i->tid == tid) {
-            if (errorLock)
-               __PHYSFS_platformReleaseMutex(errorLock);
-            return i;
-         }
-      }
+   if (media) {
+      device->media = *media;
+      device->rng = media->seed;
    }
+   new (info) SimulatedIoInfo {io, device, static_cast<PHYSFS_uint64>(at)};
+   device->head = info->pos;
 
-   if (errorLock != nullptr)
-      __PHYSFS_platformReleaseMutex(errorLock);
+   memcpy(retval, &simulatedIoInterface, sizeof(PHYSFS_Io));
+   if (io->version < 1 or not io->readAt)
+      retval->readAt = nullptr;
+   retval->opaque = info;
+   return retval;
+}
 
-   return nullptr;   // No error available                              
+int PHYSFS_getSimulatedStats(PHYSFS_Io* io, PHYSFS_SimulatedStats* stats) {
+   BAIL_IF(not io or not stats or io->read != simulatedIo_read, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   auto device = static_cast<SimulatedIoInfo*>(io->opaque)->device;
+   __PHYSFS_PlatformLock lock {device->mutex};
+   *stats = device->stats;
+   return 1;
+}
+#else
+PHYSFS_Io* PHYSFS_createSimulatedIo(PHYSFS_Io*, const PHYSFS_SimulatedMedia*) {
+   BAIL(PHYSFS_ERR_UNSUPPORTED, nullptr);
 }
 
-/// This doesn't reset the error state                                        
-static inline PHYSFS_ErrorCode currentErrorCode(void) {
-   const ErrState* err = findErrorForCurrentThread();
-   return err ? err->code : PHYSFS_ERR_OK;
+int PHYSFS_getSimulatedStats(PHYSFS_Io*, PHYSFS_SimulatedStats*) {
+   BAIL(PHYSFS_ERR_UNSUPPORTED, 0);
 }
+#endif
 
-PHYSFS_ErrorCode PHYSFS_getLastErrorCode(void) {
-   ErrState* err = findErrorForCurrentThread();
-   const PHYSFS_ErrorCode retval = (err) ? err->code : PHYSFS_ERR_OK;
-   if (err)
-      err->code = PHYSFS_ERR_OK;
-   return retval;
-}
-
-PHYSFS_DECL const char* PHYSFS_getErrorByCode(PHYSFS_ErrorCode code) {
-   switch (code) {
-   case PHYSFS_ERR_OK: return "no error";
-   case PHYSFS_ERR_OTHER_ERROR: return "unknown error";
-   case PHYSFS_ERR_OUT_OF_MEMORY: return "out of memory";
-   case PHYSFS_ERR_NOT_INITIALIZED: return "not initialized";
-   case PHYSFS_ERR_IS_INITIALIZED: return "already initialized";
-   case PHYSFS_ERR_ARGV0_IS_NULL: return "argv[0] is nullptr";
-   case PHYSFS_ERR_UNSUPPORTED: return "unsupported";
-   case PHYSFS_ERR_PAST_EOF: return "past end of file";
-   case PHYSFS_ERR_FILES_STILL_OPEN: return "files still open";
-   case PHYSFS_ERR_INVALID_ARGUMENT: return "invalid argument";
-   case PHYSFS_ERR_NOT_MOUNTED: return "not mounted";
-   case PHYSFS_ERR_NOT_FOUND: return "not found";
-   case PHYSFS_ERR_SYMLINK_FORBIDDEN: return "symlinks are forbidden";
-   case PHYSFS_ERR_NO_WRITE_DIR: return "write directory is not set";
-   case PHYSFS_ERR_OPEN_FOR_READING: return "file open for reading";
-   case PHYSFS_ERR_OPEN_FOR_WRITING: return "file open for writing";
-   case PHYSFS_ERR_NOT_A_FILE: return "not a file";
-   case PHYSFS_ERR_READ_ONLY: return "read-only filesystem";
-   case PHYSFS_ERR_CORRUPT: return "corrupted";
-   case PHYSFS_ERR_SYMLINK_LOOP: return "infinite symbolic link loop";
-   case PHYSFS_ERR_IO: return "i/o error";
-   case PHYSFS_ERR_PERMISSION: return "permission denied";
-   case PHYSFS_ERR_NO_SPACE: return "no space available for writing";
-   case PHYSFS_ERR_BAD_FILENAME: return "filename is illegal or insecure";
-   case PHYSFS_ERR_BUSY: return "tried to modify a file the OS needs";
-   case PHYSFS_ERR_DIR_NOT_EMPTY: return "directory isn't empty";
-   case PHYSFS_ERR_OS_ERROR: return "OS reported an error";
-   case PHYSFS_ERR_DUPLICATE: return "duplicate resource";
-   case PHYSFS_ERR_BAD_PASSWORD: return "bad password";
-   case PHYSFS_ERR_APP_CALLBACK: return "app callback reported error";
+///                                                                           
+/// PHYSFS_Io decorator, that serves reads out of fixed-size blocks kept in   
+/// one process-wide LRU. Blocks are keyed by the source they came from,      
+/// which every duplicate of a cached io shares, so files opened in the same  
+/// archive reuse each other's blocks instead of fetching them again          
+///                                                                           
+namespace
+{
+   struct CacheBlock {
+      CacheBlock* hashNext;
+      CacheBlock* newer;
+      CacheBlock* older;
+      PHYSFS_uint64 source;
+      PHYSFS_uint64 index;
+      PHYSFS_uint32 size;              // Valid bytes, less at the end  
+      PHYSFS_uint32 capacity;
+      // Data follows, at dataOffset                                    
+   };
+
+   /// Block data starts on a cache line                                      
+   constexpr size_t dataOffset = (sizeof(CacheBlock) + 63) & ~size_t(63);
+
+   /// A fetch is read into one scratch buffer, so read-ahead is capped to    
+   /// keep it within this, unless a single block is bigger already           
+   constexpr PHYSFS_uint64 maxFetchSize = 64 * 1024 * 1024;
+
+   PHYSFS_uint8* blockData(CacheBlock* block) {
+      return reinterpret_cast<PHYSFS_uint8*>(block) + dataOffset;
    }
 
-   return nullptr;  /* don't know this error code. */
-}
+   /// Everything in here is guarded by cacheLock                             
+   struct IoCache {
+      PHYSFS_uint64 capacity = 16 * 1024 * 1024;
+      PHYSFS_uint64 nextSource = 1;
+      CacheBlock** buckets = nullptr;
+      PHYSFS_uint32 bucketCount = 0;   // Power of two                  
+      CacheBlock* newest = nullptr;
+      CacheBlock* oldest = nullptr;
+      PHYSFS_IoCacheStats stats {};
+   } ioCache;
+
+   PHYSFS_uint32 cacheBucket(PHYSFS_uint64 source, PHYSFS_uint64 index) {
+      auto z = source * 0x9E3779B97F4A7C15ull ^ index;
+      z = (z ^ (z >> 31)) * 0xBF58476D1CE4E5B9ull;
+      return static_cast<PHYSFS_uint32>(z >> 32) & (ioCache.bucketCount - 1);
+   }
 
-void PHYSFS_setErrorCode(PHYSFS_ErrorCode errcode) {
-   if (not errcode)
-      return;
+   CacheBlock* cacheFind(PHYSFS_uint64 source, PHYSFS_uint64 index) {
+      if (not ioCache.bucketCount)
+         return nullptr;
+      auto b = ioCache.buckets[cacheBucket(source, index)];
+      while (b and (b->source != source or b->index != index))
+         b = b->hashNext;
+      return b;
+   }
 
-   auto err = findErrorForCurrentThread();
-   if (not err) {
-      err = PHYSFS_Allocator<ErrState>(1).Ref();
-      memset(err, '\0', sizeof(ErrState));
-      err->tid = __PHYSFS_platformGetThreadID();
+   void cacheUnlink(CacheBlock* block) {
+      (block->newer ? block->newer->older : ioCache.newest) = block->older;
+      (block->older ? block->older->newer : ioCache.oldest) = block->newer;
+   }
 
-      if (errorLock)
-         __PHYSFS_platformGrabMutex(errorLock);
+   void cachePushNewest(CacheBlock* block) {
+      block->newer = nullptr;
+      block->older = ioCache.newest;
+      (ioCache.newest ? ioCache.newest->newer : ioCache.oldest) = block;
+      ioCache.newest = block;
+   }
 
-      err->next = errorStates;
-      errorStates = err;
+   void cacheRemove(CacheBlock* block) {
+      auto link = &ioCache.buckets[cacheBucket(block->source, block->index)];
+      while (*link != block)
+         link = &(*link)->hashNext;
+      *link = block->hashNext;
+      cacheUnlink(block);
+      ioCache.stats.cachedBytes -= block->capacity;
+      ioCache.stats.cachedBlocks--;
+      allocator.Free(block);
+   }
 
-      if (errorLock)
-         __PHYSFS_platformReleaseMutex(errorLock);
+   void cacheTrim(PHYSFS_uint64 capacity) {
+      while (ioCache.oldest and ioCache.stats.cachedBytes > capacity) {
+         cacheRemove(ioCache.oldest);
+         ioCache.stats.evictions++;
+      }
    }
 
-   err->code = errcode;
-}
+   /// Takes ownership of (block). Keeps at most one bucket per block, and    
+   /// just drops the block if the table can't grow                           
+   void cacheInsert(CacheBlock* block) {
+      if (cacheFind(block->source, block->index) or block->capacity > ioCache.capacity) {
+         allocator.Free(block);
+         return;
+      }
 
-const char* PHYSFS_getLastError() {
-   const auto err = PHYSFS_getLastErrorCode();
-   return err ? PHYSFS_getErrorByCode(err) : nullptr;
-}
+      if (ioCache.stats.cachedBlocks >= ioCache.bucketCount) {
+         const auto count = ioCache.bucketCount ? ioCache.bucketCount * 2 : 64;
+         auto buckets = static_cast<CacheBlock**>(allocator.Malloc(sizeof(CacheBlock*) * count, PHYSFS_ALLOC_CACHE));
+         if (not buckets) {
+            allocator.Free(block);
+            return;
+         }
 
-/// MAKE SURE that errorLock is held before calling this!                     
-static void freeErrorStates() {
-   ErrState* next;
-   for (auto i = errorStates; i; i = next) {
-      next = i->next;
-      PHYSFS_Allocator<>::Free(i);
+         memset(buckets, 0, sizeof(CacheBlock*) * count);
+         auto old = ioCache.buckets;
+         const auto oldCount = ioCache.bucketCount;
+         ioCache.buckets = buckets;
+         ioCache.bucketCount = count;
+         for (PHYSFS_uint32 i = 0; i < oldCount; ++i) {
+            for (auto b = old[i]; b; ) {
+               const auto next = b->hashNext;
+               auto& head = buckets[cacheBucket(b->source, b->index)];
+               b->hashNext = head;
+               head = b;
+               b = next;
+            }
+         }
+         allocator.Free(old);
+      }
+
+      cacheTrim(ioCache.capacity - block->capacity);
+      auto& head = ioCache.buckets[cacheBucket(block->source, block->index)];
+      block->hashNext = head;
+      head = block;
+      cachePushNewest(block);
+      ioCache.stats.cachedBytes += block->capacity;
+      ioCache.stats.cachedBlocks++;
    }
 
-   errorStates = nullptr;
-}
+   /// Shared by a cached io and all of its duplicates                        
+   struct CacheSource {
+      PHYSFS_uint64 id;
+      PHYSFS_uint32 blockSize;
+      PHYSFS_uint32 readAhead;
+      PHYSFS_uint64 length;
+      std::atomic<int> refCount {1};
+   };
+
+   struct CachedIoInfo {
+      PHYSFS_Io* io = nullptr;         // Wrapped, owned                
+      CacheSource* source = nullptr;
+      PHYSFS_uint64 pos = 0;
+      PHYSFS_uint64 nextBlock = 0;     // Where a sequential read goes  
+   };
+
+   /// Copy whatever part of [offset, offset + len) the cache has, starting   
+   /// at (offset), and stop at the first block that's missing                
+   PHYSFS_uint64 cacheCopyOut(const CacheSource* source, PHYSFS_uint64 offset, PHYSFS_uint8* out, PHYSFS_uint64 len) {
+      PHYSFS_uint64 copied = 0;
+      __PHYSFS_platformGrabMutex(cacheLock);
+      while (len > 0 and offset < source->length) {
+         auto block = cacheFind(source->id, offset / source->blockSize);
+         if (not block)
+            break;
 
-void PHYSFS_getLinkedVersion(PHYSFS_Version* ver) {
-   if (not ver)
-      return;
-   ver->major = PHYSFS_VER_MAJOR;
-   ver->minor = PHYSFS_VER_MINOR;
-   ver->patch = PHYSFS_VER_PATCH;
-}
+         const auto at = offset % source->blockSize;
+         const auto count = std::min<PHYSFS_uint64>(len, block->size - at);
+         memcpy(out, blockData(block) + at, count);
+         cacheUnlink(block);
+         cachePushNewest(block);
+         ioCache.stats.hits++;
+         out += count;
+         offset += count;
+         len -= count;
+         copied += count;
+      }
+      __PHYSFS_platformReleaseMutex(cacheLock);
+      return copied;
+   }
 
-static const char* find_filename_extension(const char* fname) {
-   const char* retval = nullptr;
-   if (fname) {
-      const char* p = strchr(fname, '.');
-      retval = p;
+   /// Fetch (count) blocks from (first) on in one read from the wrapped io,  
+   /// positionally if (positional), and cache them. The part the caller      
+   /// asked for is copied straight out of the fetched data, so it's served   
+   /// even if the blocks don't fit the cache                                 
+   PHYSFS_sint64 cacheFetch(CachedIoInfo* info, bool positional, PHYSFS_uint64 first, PHYSFS_uint64 count,
+      PHYSFS_uint64 offset, PHYSFS_uint8* out, PHYSFS_uint64 len) {
+      const auto source = info->source;
+      const auto bs = PHYSFS_uint64(source->blockSize);
+      const auto start = first * bs;
+      const auto want = std::min(count * bs, source->length - start);
+
+      auto scratch = static_cast<PHYSFS_uint8*>(allocator.Malloc(want, PHYSFS_ALLOC_CACHE));
+      BAIL_IF(not scratch, PHYSFS_ERR_OUT_OF_MEMORY, -1);
+
+      PHYSFS_uint64 got = 0;
+      auto inner = info->io;
+      if (not positional and not inner->seek(inner, start)) {
+         allocator.Free(scratch);
+         return -1;
+      }
 
-      while (p != nullptr) {
-         p = strchr(p + 1, '.');
-         if (p != nullptr)
-            retval = p;
+      while (got < want) {
+         PHYSFS_sint64 rc;
+         try {
+            rc = positional ? inner->readAt(inner, start + got, scratch + got, want - got)
+                            : inner->read(inner, scratch + got, want - got);
+         }
+         catch (...) {
+            allocator.Free(scratch);
+            throw;
+         }
+         if (rc < 0) {
+            allocator.Free(scratch);
+            return -1;
+         }
+         if (rc == 0)
+            break;
+         got += rc;
       }
 
-      if (retval != nullptr)
-         retval++;  /* skip '.' */
-   }
+      const auto at = offset - start;
+      const auto retval = at < got ? std::min(len, got - at) : 0;
+      memcpy(out, scratch + at, retval);
 
-   return retval;
-}
+      // Only whole blocks, or the one that ends the data, are kept     
+      __PHYSFS_platformGrabMutex(cacheLock);
+      ioCache.stats.misses++;
+      for (PHYSFS_uint64 i = 0; i < count and i * bs < got; ++i) {
+         const auto size = std::min(bs, got - i * bs);
+         if (size < bs and start + i * bs + size < source->length)
+            break;
 
-static DirHandle* tryOpenDir(
-   PHYSFS_Io* io, const PHYSFS_Archiver* funcs,
-   const char* d, int forWriting, int* _claimed
-) {
-   if (io)
-      BAIL_IF_ERRPASS(not io->seek(io, 0), nullptr);
+         auto block = static_cast<CacheBlock*>(allocator.Malloc(dataOffset + bs, PHYSFS_ALLOC_CACHE));
+         if (not block)
+            break;
+         block->source = source->id;
+         block->index = first + i;
+         block->size = static_cast<PHYSFS_uint32>(size);
+         block->capacity = static_cast<PHYSFS_uint32>(bs);
+         memcpy(blockData(block), scratch + i * bs, size);
+         cacheInsert(block);
+         if (i)
+            ioCache.stats.readAheadBlocks++;
+      }
+      __PHYSFS_platformReleaseMutex(cacheLock);
 
-   DirHandle* retval = nullptr;
-   auto opaque = funcs->openArchive(io, d, forWriting, _claimed);
-   if (opaque) {
-      retval = PHYSFS_Allocator<DirHandle>(1).Ref();
-      if (not retval)
-         funcs->closeArchive(opaque);
-      else {
-         memset(retval, '\0', sizeof(DirHandle));
-         retval->mountPoint = nullptr;
-         retval->funcs = funcs;
-         retval->opaque = opaque;
+      allocator.Free(scratch);
+      return static_cast<PHYSFS_sint64>(retval);
+   }
+
+   PHYSFS_sint64 cachedIo_read(PHYSFS_Io* io, void* buf, PHYSFS_uint64 len) {
+      BAIL_IF(not cacheLock, PHYSFS_ERR_NOT_INITIALIZED, -1);
+      auto info = static_cast<CachedIoInfo*>(io->opaque);
+      const auto source = info->source;
+      auto out = static_cast<PHYSFS_uint8*>(buf);
+      PHYSFS_sint64 retval = 0;
+
+      len = std::min(len, source->length - std::min(info->pos, source->length));
+      while (len > 0) {
+         auto copied = cacheCopyOut(source, info->pos, out, len);
+         if (not copied) {
+            // Reading on from where the last read left off gets the    
+            // next few blocks fetched along with this one              
+            const auto block = info->pos / source->blockSize;
+            const auto count = block == info->nextBlock ? 1 + source->readAhead : 1;
+            const auto rc = cacheFetch(info, false, block, count, info->pos, out, len);
+            BAIL_IF_ERRPASS(rc < 0, retval ? retval : -1);
+            if (rc == 0)
+               break;
+            copied = static_cast<PHYSFS_uint64>(rc);
+         }
+
+         info->pos += copied;
+         info->nextBlock = (info->pos + source->blockSize - 1) / source->blockSize;
+         out += copied;
+         len -= copied;
+         retval += copied;
       }
+      return retval;
    }
 
-   return retval;
-}
+   PHYSFS_sint64 cachedIo_write(PHYSFS_Io*, const void*, PHYSFS_uint64) {
+      BAIL(PHYSFS_ERR_OPEN_FOR_READING, -1);
+   }
 
-/// Open directory                                                            
-static DirHandle* openDirectory(PHYSFS_Io* io, const char* d, int forWriting) {
-   assert(io or d);
-   DirHandle* retval = nullptr;
-   int created_io = 0;
-   int claimed = 0;
+   /// The wrapped io is only moved when a block has to be fetched            
+   int cachedIo_seek(PHYSFS_Io* io, PHYSFS_uint64 offset) {
+      auto info = static_cast<CachedIoInfo*>(io->opaque);
+      BAIL_IF(offset > info->source->length, PHYSFS_ERR_PAST_EOF, 0);
+      info->pos = offset;
+      return 1;
+   }
 
-   if (not io) {
-      // File doesn't exist, etc? Just fail out                         
-      PHYSFS_Stat statbuf;
-      BAIL_IF_ERRPASS(not __PHYSFS_platformStat(d, &statbuf, 1), nullptr);
+   PHYSFS_sint64 cachedIo_tell(PHYSFS_Io* io) {
+      return static_cast<PHYSFS_sint64>(static_cast<CachedIoInfo*>(io->opaque)->pos);
+   }
 
-      // DIR gets first shot (unlike the rest, it doesn't deal with     
-      // files)                                                         
-      if (statbuf.filetype == PHYSFS_FILETYPE_DIRECTORY) {
-         retval = tryOpenDir(io, &__PHYSFS_Archiver_DIR, d, forWriting, &claimed);
-         if (retval or claimed)
-            return retval;
+   PHYSFS_sint64 cachedIo_length(PHYSFS_Io* io) {
+      return static_cast<PHYSFS_sint64>(static_cast<CachedIoInfo*>(io->opaque)->source->length);
+   }
+
+   PHYSFS_Io* cachedIo_duplicate(PHYSFS_Io* io) {
+      auto info = static_cast<CachedIoInfo*>(io->opaque);
+      auto dup = info->io->duplicate(info->io);
+      BAIL_IF_ERRPASS(not dup, nullptr);
+
+      auto retval = static_cast<PHYSFS_Io*>(allocator.Malloc(sizeof(PHYSFS_Io), PHYSFS_ALLOC_FILEHANDLE));
+      auto dupInfo = static_cast<CachedIoInfo*>(allocator.Malloc(sizeof(CachedIoInfo), PHYSFS_ALLOC_FILEHANDLE));
+      if (not retval or not dupInfo) {
+         allocator.Free(retval);
+         allocator.Free(dupInfo);
+         dup->destroy(dup);
+         BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
       }
 
-      io = __PHYSFS_createNativeIo(d, forWriting ? 'w' : 'r');
-      BAIL_IF_ERRPASS(not io, nullptr);
-      created_io = 1;
+      info->source->refCount.fetch_add(1, std::memory_order_relaxed);
+      new (dupInfo) CachedIoInfo {dup, info->source, 0, 0};
+      memcpy(retval, io, sizeof(PHYSFS_Io));
+      retval->opaque = dupInfo;
+      return retval;
    }
 
-   auto ext = find_filename_extension(d);
-   if (ext) {
-      // Look for archivers with matching file extensions first...      
-      for (auto i = archivers; *i and not retval and not claimed; i++) {
-         if (PHYSFS_utf8stricmp(ext, (*i)->info.extension) == 0)
-            retval = tryOpenDir(io, *i, d, forWriting, &claimed);
+   int cachedIo_flush(PHYSFS_Io*) {
+      return 1;  // It's read-only                                      
+   }
+
+   /// The last one out drops the source's blocks, nothing can ask for them   
+   /// anymore. After PHYSFS_deinit() they went with the cache, and so did    
+   /// cacheLock                                                              
+   void cachedIo_destroy(PHYSFS_Io* io) {
+      auto info = static_cast<CachedIoInfo*>(io->opaque);
+      info->io->destroy(info->io);
+
+      auto source = info->source;
+      if (source->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+         if (cacheLock) {
+            __PHYSFS_platformGrabMutex(cacheLock);
+            for (auto b = ioCache.oldest; b; ) {
+               const auto next = b->newer;
+               if (b->source == source->id)
+                  cacheRemove(b);
+               b = next;
+            }
+            __PHYSFS_platformReleaseMutex(cacheLock);
+         }
+         source->~CacheSource();
+         allocator.Free(source);
       }
 
-      // Failing an exact file extension match, try all the others...   
-      for (auto i = archivers; *i and not retval and not claimed; i++) {
-         if (PHYSFS_utf8stricmp(ext, (*i)->info.extension) != 0)
-            retval = tryOpenDir(io, *i, d, forWriting, &claimed);
+      info->~CachedIoInfo();
+      allocator.Free(info);
+      allocator.Free(io);
+   }
+
+   /// Only there when the wrapped io has a readAt of its own. Positional     
+   /// reads carry no history, so they never read ahead                       
+   PHYSFS_sint64 cachedIo_readAt(PHYSFS_Io* io, PHYSFS_uint64 offset, void* buf, PHYSFS_uint64 len) {
+      BAIL_IF(not cacheLock, PHYSFS_ERR_NOT_INITIALIZED, -1);
+      auto info = static_cast<CachedIoInfo*>(io->opaque);
+      const auto source = info->source;
+      auto out = static_cast<PHYSFS_uint8*>(buf);
+      PHYSFS_sint64 retval = 0;
+
+      len = std::min(len, source->length - std::min(offset, source->length));
+      while (len > 0) {
+         auto copied = cacheCopyOut(source, offset, out, len);
+         if (not copied) {
+            const auto rc = cacheFetch(info, true, offset / source->blockSize, 1, offset, out, len);
+            BAIL_IF_ERRPASS(rc < 0, retval ? retval : -1);
+            if (rc == 0)
+               break;
+            copied = static_cast<PHYSFS_uint64>(rc);
+         }
+
+         offset += copied;
+         out += copied;
+         len -= copied;
+         retval += copied;
       }
+      return retval;
    }
-   else {
-      // No extension? Gotta try them all!                              
-      for (auto i = archivers; *i and not retval and not claimed; i++)
-         retval = tryOpenDir(io, *i, d, forWriting, &claimed);
+
+   /// Whatever cached ios the app didn't destroy can't use the cache         
+   /// anymore, it goes along with cacheLock                                  
+   void freeIoCache() {
+      while (ioCache.oldest)
+         cacheRemove(ioCache.oldest);
+      allocator.Free(ioCache.buckets);
+
+      // Ids are never handed out twice, so such an io can't drop the   
+      // blocks of one made after PHYSFS_init() runs again              
+      const auto nextSource = ioCache.nextSource;
+      ioCache = {};
+      ioCache.nextSource = nextSource;
    }
 
-   if (not retval and created_io)
-      io->destroy(io);
+   const PHYSFS_Io cachedIoInterface =
+   {
+      CURRENT_PHYSFS_IO_API_VERSION, nullptr,
+      cachedIo_read,
+      cachedIo_write,
+      cachedIo_seek,
+      cachedIo_tell,
+      cachedIo_length,
+      cachedIo_duplicate,
+      cachedIo_flush,
+      cachedIo_destroy,
+      cachedIo_readAt
+   };
+}
+
+PHYSFS_Io* PHYSFS_createCachedIo(PHYSFS_Io* io, PHYSFS_uint32 blockSize, PHYSFS_uint32 readAhead) {
+   BAIL_IF(not initialized, PHYSFS_ERR_NOT_INITIALIZED, nullptr);
+   BAIL_IF(not io, PHYSFS_ERR_INVALID_ARGUMENT, nullptr);
+   if (not blockSize)
+      blockSize = 64 * 1024;
+   BAIL_IF(blockSize & (blockSize - 1), PHYSFS_ERR_INVALID_ARGUMENT, nullptr);
+   const auto maxAhead = std::max<PHYSFS_uint64>(maxFetchSize / blockSize, 1) - 1;
+   readAhead = static_cast<PHYSFS_uint32>(std::min<PHYSFS_uint64>(readAhead, maxAhead));
+
+   const auto length = io->length(io);
+   const auto at = io->tell(io);
+   BAIL_IF_ERRPASS(length < 0 or at < 0, nullptr);
+
+   auto retval = static_cast<PHYSFS_Io*>(allocator.Malloc(sizeof(PHYSFS_Io), PHYSFS_ALLOC_FILEHANDLE));
+   auto info = static_cast<CachedIoInfo*>(allocator.Malloc(sizeof(CachedIoInfo), PHYSFS_ALLOC_FILEHANDLE));
+   auto source = static_cast<CacheSource*>(allocator.Malloc(sizeof(CacheSource), PHYSFS_ALLOC_FILEHANDLE));
+   if (not retval or not info or not source) {
+      allocator.Free(retval);
+      allocator.Free(info);
+      allocator.Free(source);
+      BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+   }
 
-   BAIL_IF(not retval, PHYSFS_ERR_UNSUPPORTED, nullptr);
+   __PHYSFS_platformGrabMutex(cacheLock);
+   const auto id = ioCache.nextSource++;
+   __PHYSFS_platformReleaseMutex(cacheLock);
+
+   new (source) CacheSource {id, blockSize, readAhead, static_cast<PHYSFS_uint64>(length)};
+   new (info) CachedIoInfo {io, source, static_cast<PHYSFS_uint64>(at), 0};
+   info->nextBlock = info->pos / blockSize;
+
+   memcpy(retval, &cachedIoInterface, sizeof(PHYSFS_Io));
+   if (io->version < 1 or not io->readAt)
+      retval->readAt = nullptr;
+   retval->opaque = info;
    return retval;
 }
 
+int PHYSFS_setIoCacheSize(PHYSFS_uint64 bytes) {
+   BAIL_IF(not initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+   __PHYSFS_platformGrabMutex(cacheLock);
+   ioCache.capacity = bytes;
+   cacheTrim(bytes);
+   __PHYSFS_platformReleaseMutex(cacheLock);
+   return 1;
+}
+
+int PHYSFS_getIoCacheStats(PHYSFS_IoCacheStats* stats) {
+   BAIL_IF(not initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+   BAIL_IF(not stats, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   __PHYSFS_platformGrabMutex(cacheLock);
+   *stats = ioCache.stats;
+   __PHYSFS_platformReleaseMutex(cacheLock);
+   return 1;
+}
+
+int PHYSFS_setIoPriority(PHYSFS_IoPriority priority, PHYSFS_uint32 deadlineUs) {
+   BAIL_IF(priority < PHYSFS_IO_CRITICAL or priority >= PHYSFS_IO_PRIORITY_COUNT,
+      PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   ioPriority = priority;
+   ioDeadlineUs = deadlineUs;
+   return 1;
+}
+
+PHYSFS_IoPriority PHYSFS_getIoPriority(PHYSFS_uint32* deadlineUs) {
+   if (deadlineUs)
+      *deadlineUs = ioDeadlineUs;
+   return ioPriority;
+}
+
+#ifndef PHYSFS_NO_THREADS
 ///                                                                           
-/// Make a platform-independent path string sane. Doesn't actually check the  
-/// file hierarchy, it just cleans up the string.                             
-/// (dst) must be a buffer at least as big as (src), as this is where the     
-/// cleaned up string is deposited.                                           
-/// If there are illegal bits in the path (".." entries, etc) then we         
-/// return zero and (dst) is undefined. Non-zero if the path was sanitized.   
+/// PHYSFS_Io decorator, that queues every request the wrapper and its        
+/// duplicates make in one scheduler, and serves them by priority class,      
+/// deadline and offset, a few at a time. Requests wait on the calling        
+/// thread, and are carried out there too once granted a slot                 
 ///                                                                           
-static int sanitizePlatformIndependentPath(const char* src, char* dst) {
-   char* prev;
-   char ch;
-
-   // Skip initial '/' chars...                                         
-   while (*src == '/')
-      src++;
+namespace
+{
+   using SchedulerClock = std::chrono::steady_clock;
+
+   /// One piece of a request, queued on the caller's stack                   
+   struct ScheduledPiece {
+      ScheduledPiece* next = nullptr;
+      ScheduledPiece* prev = nullptr;
+      PHYSFS_IoPriority priority = PHYSFS_IO_CRITICAL;
+      PHYSFS_uint64 offset = 0;
+      PHYSFS_uint64 len = 0;
+      SchedulerClock::time_point queuedAt {};
+      SchedulerClock::time_point urgentAt = SchedulerClock::time_point::max();
+      SchedulerClock::time_point deadline = SchedulerClock::time_point::max();
+      PHYSFS_uint64 grantsBefore = 0;  // Scheduler's grants when queued
+      bool continued = false;          // Not the request's first piece 
+      bool throttled = false;          // Waited for the budget         
+      bool granted = false;
+   };
+
+   struct IoScheduler {
+      PHYSFS_IoSchedule schedule {};
+      std::atomic<int> refCount {1};   // Ios and DirHandles using it   
+      void* mutex = nullptr;
+      void* wake = nullptr;            // Broadcast as slots are granted
+
+      // Everything below is guarded by mutex                           
+      ScheduledPiece* waiting = nullptr;
+      unsigned inFlight = 0;
+      PHYSFS_uint64 head = 0;          // Where the last piece ended    
+      PHYSFS_uint64 grants = 0;
+
+      // Background budget, as token buckets                            
+      double byteTokens = 0;
+      double opTokens = 0;
+      SchedulerClock::time_point refilledAt {};
+      SchedulerClock::time_point retryAt = SchedulerClock::time_point::max();
+      PHYSFS_IoSchedulerStats stats {};
+   };
+
+   struct ScheduledIoInfo {
+      PHYSFS_Io* io = nullptr;         // Wrapped, owned                
+      IoScheduler* scheduler = nullptr;
+      PHYSFS_uint64 pos = 0;
+   };
+
+   double schedulerByteBurst(const IoScheduler* s) {
+      return std::max(s->schedule.backgroundBytesPerSecond / 10.0, double(s->schedule.chunkSize));
+   }
 
-   // Make sure the entire string isn't "." or ".."                     
-   if (strcmp(src, ".") == 0 or strcmp(src, "..") == 0)
-      BAIL(PHYSFS_ERR_BAD_FILENAME, 0);
+   double schedulerOpBurst(const IoScheduler* s) {
+      return std::max(s->schedule.backgroundOpsPerSecond / 10.0, 1.0);
+   }
 
-   prev = dst;
-   do {
-      ch = *(src++);
+   void schedulerRefill(IoScheduler* s, SchedulerClock::time_point now) {
+      const auto secs = std::chrono::duration<double>(now - s->refilledAt).count();
+      s->refilledAt = now;
+      s->byteTokens = std::min(schedulerByteBurst(s), s->byteTokens + secs * s->schedule.backgroundBytesPerSecond);
+      s->opTokens = std::min(schedulerOpBurst(s), s->opTokens + secs * s->schedule.backgroundOpsPerSecond);
+   }
 
-      if (ch == ':' or ch == '\\') {
-         // Illegal chars in a physfs path                              
-         BAIL(PHYSFS_ERR_BAD_FILENAME, 0);
+   /// When a background piece fits the budget, or now if it already does     
+   SchedulerClock::time_point schedulerAffordableAt(const IoScheduler* s,
+      const ScheduledPiece* p, SchedulerClock::time_point now) {
+      double wait = 0;
+      if (s->schedule.backgroundBytesPerSecond) {
+         const auto need = std::min(double(p->len), schedulerByteBurst(s));
+         if (s->byteTokens < need)
+            wait = (need - s->byteTokens) / s->schedule.backgroundBytesPerSecond;
       }
+      if (s->schedule.backgroundOpsPerSecond and s->opTokens < 1)
+         wait = std::max(wait, (1 - s->opTokens) / s->schedule.backgroundOpsPerSecond);
+      if (wait <= 0)
+         return now;
+      return now + std::chrono::duration_cast<SchedulerClock::duration>(
+         std::chrono::duration<double>(wait)) + std::chrono::microseconds(1);
+   }
 
-      if (ch == '/') {
-         // Path separator                                              
-         *dst = '\0';
+   /// Whether (a) goes before (b): urgent pieces first, by deadline, then    
+   /// by class, then by one sweep up the offsets from the head               
+   bool schedulerBefore(const IoScheduler* s, const ScheduledPiece* a,
+      const ScheduledPiece* b, SchedulerClock::time_point now) {
+      const bool urgentA = now >= a->urgentAt;
+      const bool urgentB = now >= b->urgentAt;
+      if (urgentA != urgentB)
+         return urgentA;
+      if (urgentA)
+         return a->deadline < b->deadline;
+      if (a->priority != b->priority)
+         return a->priority < b->priority;
+
+      const bool wrapsA = a->offset < s->head;
+      const bool wrapsB = b->offset < s->head;
+      if (wrapsA != wrapsB)
+         return wrapsB;
+      return a->offset < b->offset;
+   }
 
-         // "." and ".." are illegal pathnames                          
-         if (strcmp(prev, ".") == 0 or strcmp(prev, "..") == 0)
-            BAIL(PHYSFS_ERR_BAD_FILENAME, 0);
+   /// Grant free slots to the best pieces waiting, and wake them             
+   void schedulerDispatch(IoScheduler* s) {
+      const auto depth = std::max(s->schedule.queueDepth, 1u);
+      const auto now = SchedulerClock::now();
+      const bool budgeted = s->schedule.backgroundBytesPerSecond or s->schedule.backgroundOpsPerSecond;
+      if (budgeted)
+         schedulerRefill(s, now);
+
+      bool woke = false;
+      s->retryAt = SchedulerClock::time_point::max();
+      while (s->inFlight < depth) {
+         ScheduledPiece* best = nullptr;
+         for (auto p = s->waiting; p; p = p->next) {
+            if (budgeted and p->priority == PHYSFS_IO_BACKGROUND and now < p->urgentAt) {
+               const auto at = schedulerAffordableAt(s, p, now);
+               if (at > now) {
+                  s->retryAt = std::min(s->retryAt, at);
+                  p->throttled = true;
+                  continue;
+               }
+            }
+            if (not best or schedulerBefore(s, p, best, now))
+               best = p;
+         }
+         if (not best)
+            break;
 
-         // Chop out doubles...                                         
-         while (*src == '/')
-            src++;
+         if (best->prev)
+            best->prev->next = best->next;
+         else
+            s->waiting = best->next;
+         if (best->next)
+            best->next->prev = best->prev;
 
-         // Ends with a pathsep?                                        
-         if (not *src)
-            break;  // We're done, don't add final pathsep to dst       
+         if (budgeted and best->priority == PHYSFS_IO_BACKGROUND) {
+            s->byteTokens -= double(best->len);
+            s->opTokens -= 1;
+         }
 
-         prev = dst + 1;
+         auto& cls = s->stats.classes[best->priority];
+         const auto waited = PHYSFS_uint64(std::chrono::duration_cast<std::chrono::microseconds>(now - best->queuedAt).count());
+         cls.queued--;
+         cls.waitUs += waited;
+         cls.maxWaitUs = std::max(cls.maxWaitUs, waited);
+         if (best->continued and s->grants > best->grantsBefore)
+            s->stats.preemptions++;
+         if (best->throttled)
+            s->stats.throttled++;
+
+         s->grants++;
+         s->inFlight++;
+         s->head = best->offset + best->len;
+         best->granted = true;
+         woke = true;
       }
 
-      *(dst++) = ch;
+      if (woke)
+         __PHYSFS_platformBroadcastCond(s->wake);
    }
-   while (ch);
 
-   return 1;
-}
-
-static inline size_t dirHandleRootLen(const DirHandle* h) {
-   return h ? h->rootlen : 0;
-}
-
-static inline int sanitizePlatformIndependentPathWithRoot(
-   const DirHandle* h, const char* src, char* dst
-) {
-   return sanitizePlatformIndependentPath(src, dst + dirHandleRootLen(h));
-}
+   /// Make a scheduler for (schedule), or nullptr for the defaults, with     
+   /// one reference for the caller                                           
+   IoScheduler* createScheduler(const PHYSFS_IoSchedule* schedule) {
+      auto retval = static_cast<IoScheduler*>(allocator.Malloc(sizeof(IoScheduler), PHYSFS_ALLOC_FILEHANDLE));
+      BAIL_IF(not retval, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+      new (retval) IoScheduler {};
+
+      try {
+         retval->mutex = __PHYSFS_platformCreateMutex();
+         if (retval->mutex)
+            retval->wake = __PHYSFS_platformCreateCond();
+      }
+      catch (...) {
+         if (retval->mutex)
+            __PHYSFS_platformDestroyMutex(retval->mutex);
+         allocator.Free(retval);
+         throw;
+      }
+      if (not retval->wake) {
+         if (retval->mutex)
+            __PHYSFS_platformDestroyMutex(retval->mutex);
+         allocator.Free(retval);
+         return nullptr;
+      }
 
-///                                                                           
-/// Figure out if (fname) is part of (h)'s mountpoint. (fname) must be an     
-/// output from sanitizePlatformIndependentPath(), so that it is in a known   
-/// state.                                                                    
-///                                                                           
-/// This only finds legitimate segments of a mountpoint. If the mountpoint is 
-/// "/a/b/c" and (fname) is "/a/b/c", "/", or "/a/b/c/d", then the results are
-/// all zero. "/a/b" will succeed, though.                                    
-///                                                                           
-static int partOfMountPoint(DirHandle* h, char* fname) {
-   if (h->mountPoint == nullptr)
-      return 0;
-   else if (*fname == '\0')
-      return 1;
+      if (schedule)
+         retval->schedule = *schedule;
+      if (not retval->schedule.chunkSize)
+         retval->schedule.chunkSize = 256 * 1024;
 
-   size_t len = strlen(fname);
-   size_t mntpntlen = strlen(h->mountPoint);
-   if (len > mntpntlen)  // Can't be a subset of mountpoint             
-      return 0;
+      // Start with a full budget                                       
+      retval->byteTokens = schedulerByteBurst(retval);
+      retval->opTokens = schedulerOpBurst(retval);
+      retval->refilledAt = SchedulerClock::now();
+      return retval;
+   }
 
-   // If true, must be not a match or a complete match, but not a subset
-   if ((len + 1) == mntpntlen)
-      return 0;
+   IoScheduler* retainScheduler(IoScheduler* s) {
+      if (s)
+         s->refCount.fetch_add(1, std::memory_order_relaxed);
+      return s;
+   }
 
-   // !!! FIXME: case insensitive? 
-   int rc = strncmp(fname, h->mountPoint, len);
-   if (rc != 0)
-      return 0;         // Not a match                                  
+   void releaseScheduler(IoScheduler* s) {
+      if (not s or s->refCount.fetch_sub(1, std::memory_order_acq_rel) != 1)
+         return;
+      __PHYSFS_platformDestroyCond(s->wake);
+      __PHYSFS_platformDestroyMutex(s->mutex);
+      s->~IoScheduler();
+      allocator.Free(s);
+   }
 
-   // Make sure /a/b matches /a/b/ and not /a/bc ...                    
-   return h->mountPoint[len] == '/';
-}
+   /// Holds one of the scheduler's slots, for one piece of a request         
+   class ScheduledSlot {
+      IoScheduler* scheduler;
+
+   public:
+      ScheduledSlot(IoScheduler* s, ScheduledPiece& piece) : scheduler {s} {
+         __PHYSFS_PlatformLock lock {s->mutex};
+         piece.next = s->waiting;
+         piece.prev = nullptr;
+         if (s->waiting)
+            s->waiting->prev = &piece;
+         s->waiting = &piece;
+         piece.granted = false;
+         piece.throttled = false;
+         piece.queuedAt = SchedulerClock::now();
+         piece.grantsBefore = s->grants;
+
+         auto& cls = s->stats.classes[piece.priority];
+         cls.maxQueued = std::max(cls.maxQueued, ++cls.queued);
+
+         // Whoever waits for the budget to refill dispatches again     
+         schedulerDispatch(s);
+         while (not piece.granted) {
+            if (s->retryAt == SchedulerClock::time_point::max())
+               __PHYSFS_platformWaitCond(s->wake, s->mutex);
+            else {
+               // Round up, so the budget has refilled when we wake     
+               const auto left = s->retryAt - SchedulerClock::now();
+               if (left > SchedulerClock::duration::zero()) {
+                  const auto ms = std::chrono::ceil<std::chrono::milliseconds>(left).count();
+                  __PHYSFS_platformWaitCondTimeout(s->wake, s->mutex, PHYSFS_uint32(std::min<decltype(ms)>(ms, 1000)));
+               }
+            }
+            if (not piece.granted)
+               schedulerDispatch(s);
+         }
+      }
 
-///                                                                           
-static DirHandle* createDirHandle(
-   PHYSFS_Io* io, const char* newDir,
-   const char* mountPoint, int forWriting
-) {
-   DirHandle* dirHandle = nullptr;
-   char* tmpmntpnt = nullptr;
+      ~ScheduledSlot() {
+         __PHYSFS_PlatformLock lock {scheduler->mutex};
+         scheduler->inFlight--;
+         schedulerDispatch(scheduler);
+      }
+   };
+
+   /// Run (len) bytes at (offset) through the scheduler, in pieces if the    
+   /// thread's class allows it, calling transfer(done, pieceLen) for each    
+   /// once it's granted a slot. Stops early on a short or failed transfer    
+   template<class F>
+   PHYSFS_sint64 scheduledTransfer(IoScheduler* s, PHYSFS_uint64 offset, PHYSFS_uint64 len, F&& transfer) {
+      const auto start = SchedulerClock::now();
+      ScheduledPiece piece;
+      piece.priority = ioPriority;
+      if (ioUnderStateLock)
+         piece.priority = std::min(piece.priority, PHYSFS_IO_STREAMING);
+      if (ioDeadlineUs) {
+         piece.deadline = start + std::chrono::microseconds(ioDeadlineUs);
+         piece.urgentAt = start + std::chrono::microseconds(ioDeadlineUs / 2);
+      }
 
-   assert(newDir);  /* should have caught this higher up. */
+      const PHYSFS_uint64 chunk = piece.priority == PHYSFS_IO_CRITICAL ? len : s->schedule.chunkSize;
+      PHYSFS_sint64 retval = 0;
+      PHYSFS_uint64 done = 0;
+      do {
+         piece.offset = offset + done;
+         piece.continued = done > 0;
+         piece.len = std::min(chunk, len - done);
+         PHYSFS_sint64 rc;
+         {
+            ScheduledSlot slot {s, piece};
+            rc = transfer(done, piece.len);
+         }
+         if (rc < 0) {
+            if (not retval)
+               retval = rc;
+            break;
+         }
 
-   if (mountPoint) {
-      const size_t len = strlen(mountPoint) + 1;
-      tmpmntpnt = (char*) __PHYSFS_smallAlloc(len);
-      GOTO_IF(!tmpmntpnt, PHYSFS_ERR_OUT_OF_MEMORY, badDirHandle);
-      if (!sanitizePlatformIndependentPath(mountPoint, tmpmntpnt))
-         goto badDirHandle;
-      mountPoint = tmpmntpnt;  /* sanitized version. */
+         done += PHYSFS_uint64(rc);
+         retval = PHYSFS_sint64(done);
+         if (PHYSFS_uint64(rc) < piece.len)
+            break;
+      } while (done < len);
+
+      __PHYSFS_PlatformLock lock {s->mutex};
+      auto& cls = s->stats.classes[piece.priority];
+      cls.requests++;
+      cls.bytes += done;
+      if (SchedulerClock::now() > piece.deadline)
+         cls.deadlineMisses++;
+      return retval;
    }
 
-   dirHandle = openDirectory(io, newDir, forWriting);
-   GOTO_IF_ERRPASS(!dirHandle, badDirHandle);
+   PHYSFS_sint64 scheduledIo_read(PHYSFS_Io* io, void* buf, PHYSFS_uint64 len) {
+      auto info = static_cast<ScheduledIoInfo*>(io->opaque);
+      auto out = static_cast<PHYSFS_uint8*>(buf);
+      const auto rc = scheduledTransfer(info->scheduler, info->pos, len,
+         [info, out](PHYSFS_uint64 done, PHYSFS_uint64 count) {
+            return info->io->read(info->io, out + done, count);
+         });
+      if (rc > 0)
+         info->pos += rc;
+      return rc;
+   }
 
-   dirHandle->dirName = (char*) allocator.Malloc(strlen(newDir) + 1);
-   GOTO_IF(!dirHandle->dirName, PHYSFS_ERR_OUT_OF_MEMORY, badDirHandle);
-   strcpy(dirHandle->dirName, newDir);
+   PHYSFS_sint64 scheduledIo_write(PHYSFS_Io* io, const void* buf, PHYSFS_uint64 len) {
+      auto info = static_cast<ScheduledIoInfo*>(io->opaque);
+      auto in = static_cast<const PHYSFS_uint8*>(buf);
+      const auto rc = scheduledTransfer(info->scheduler, info->pos, len,
+         [info, in](PHYSFS_uint64 done, PHYSFS_uint64 count) {
+            return info->io->write(info->io, in + done, count);
+         });
+      if (rc > 0)
+         info->pos += rc;
+      return rc;
+   }
 
-   if ((mountPoint != nullptr) && (*mountPoint != '\0')) {
-      dirHandle->mountPoint = (char*) allocator.Malloc(strlen(mountPoint) + 2);
-      if (!dirHandle->mountPoint)
-         GOTO(PHYSFS_ERR_OUT_OF_MEMORY, badDirHandle);
-      strcpy(dirHandle->mountPoint, mountPoint);
-      strcat(dirHandle->mountPoint, "/");
+   /// Seeking doesn't touch the media, so it isn't scheduled                 
+   int scheduledIo_seek(PHYSFS_Io* io, PHYSFS_uint64 offset) {
+      auto info = static_cast<ScheduledIoInfo*>(io->opaque);
+      BAIL_IF_ERRPASS(not info->io->seek(info->io, offset), 0);
+      info->pos = offset;
+      return 1;
    }
 
-   __PHYSFS_smallFree(tmpmntpnt);
-   return dirHandle;
+   PHYSFS_sint64 scheduledIo_tell(PHYSFS_Io* io) {
+      return static_cast<PHYSFS_sint64>(static_cast<ScheduledIoInfo*>(io->opaque)->pos);
+   }
 
-badDirHandle:
-   if (dirHandle != nullptr) {
-      dirHandle->funcs->closeArchive(dirHandle->opaque);
-      PHYSFS_Allocator<>::Free(dirHandle->dirName);
-      PHYSFS_Allocator<>::Free(dirHandle->mountPoint);
-      PHYSFS_Allocator<>::Free(dirHandle);
+   PHYSFS_sint64 scheduledIo_length(PHYSFS_Io* io) {
+      auto inner = static_cast<ScheduledIoInfo*>(io->opaque)->io;
+      return inner->length(inner);
    }
 
-   __PHYSFS_smallFree(tmpmntpnt);
-   return nullptr;
-}
+   PHYSFS_Io* scheduledIo_duplicate(PHYSFS_Io* io) {
+      auto info = static_cast<ScheduledIoInfo*>(io->opaque);
+      auto dup = info->io->duplicate(info->io);
+      BAIL_IF_ERRPASS(not dup, nullptr);
+      const auto at = dup->tell(dup);
+
+      auto retval = static_cast<PHYSFS_Io*>(allocator.Malloc(sizeof(PHYSFS_Io), PHYSFS_ALLOC_FILEHANDLE));
+      auto dupInfo = static_cast<ScheduledIoInfo*>(allocator.Malloc(sizeof(ScheduledIoInfo), PHYSFS_ALLOC_FILEHANDLE));
+      if (at < 0 or not retval or not dupInfo) {
+         allocator.Free(retval);
+         allocator.Free(dupInfo);
+         dup->destroy(dup);
+         BAIL_IF_ERRPASS(at < 0, nullptr);
+         BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+      }
 
-/// MAKE SURE you've got the stateLock held before calling this!              
-static int freeDirHandle(DirHandle* dh, FileHandle* openList) {
-   if (not dh)
-      return 1;
+      new (dupInfo) ScheduledIoInfo {dup, retainScheduler(info->scheduler), static_cast<PHYSFS_uint64>(at)};
+      memcpy(retval, io, sizeof(PHYSFS_Io));
+      retval->opaque = dupInfo;
+      return retval;
+   }
 
-   for (auto i = openList; i; i = i->next)
-      BAIL_IF(i->dirHandle == dh, PHYSFS_ERR_FILES_STILL_OPEN, 0);
+   int scheduledIo_flush(PHYSFS_Io* io) {
+      auto inner = static_cast<ScheduledIoInfo*>(io->opaque)->io;
+      return inner->flush ? inner->flush(inner) : 1;
+   }
 
-   dh->funcs->closeArchive(dh->opaque);
+   void scheduledIo_destroy(PHYSFS_Io* io) {
+      auto info = static_cast<ScheduledIoInfo*>(io->opaque);
+      info->io->destroy(info->io);
+      releaseScheduler(info->scheduler);
+      info->~ScheduledIoInfo();
+      allocator.Free(info);
+      allocator.Free(io);
+   }
 
-   if (dh->root)
-      PHYSFS_Allocator<>::Free(dh->root);
-   PHYSFS_Allocator<>::Free(dh->dirName);
-   PHYSFS_Allocator<>::Free(dh->mountPoint);
-   PHYSFS_Allocator<>::Free(dh);
-   return 1;
-}
+   PHYSFS_sint64 scheduledIo_readAt(PHYSFS_Io* io, PHYSFS_uint64 offset, void* buf, PHYSFS_uint64 len) {
+      auto info = static_cast<ScheduledIoInfo*>(io->opaque);
+      auto out = static_cast<PHYSFS_uint8*>(buf);
+      return scheduledTransfer(info->scheduler, offset, len,
+         [info, offset, out](PHYSFS_uint64 done, PHYSFS_uint64 count) {
+            return info->io->readAt(info->io, offset + done, out + done, count);
+         });
+   }
 
-///                                                                           
-static char* calculateBaseDir(const char* argv0) {
-   const char dirsep = __PHYSFS_platformDirSeparator;
-   char* retval = nullptr;
-   char* ptr = nullptr;
+   const PHYSFS_Io scheduledIoInterface =
+   {
+      CURRENT_PHYSFS_IO_API_VERSION, nullptr,
+      scheduledIo_read,
+      scheduledIo_write,
+      scheduledIo_seek,
+      scheduledIo_tell,
+      scheduledIo_length,
+      scheduledIo_duplicate,
+      scheduledIo_flush,
+      scheduledIo_destroy,
+      scheduledIo_readAt
+   };
+}
+
+/// Wrap (io) in (s), which it then holds a reference to. On failure, (io) is 
+/// left alone                                                                
+static PHYSFS_Io* scheduleIo(PHYSFS_Io* io, IoScheduler* s) {
+   const auto at = io->tell(io);
+   BAIL_IF_ERRPASS(at < 0, nullptr);
+
+   auto retval = static_cast<PHYSFS_Io*>(allocator.Malloc(sizeof(PHYSFS_Io), PHYSFS_ALLOC_FILEHANDLE));
+   auto info = static_cast<ScheduledIoInfo*>(allocator.Malloc(sizeof(ScheduledIoInfo), PHYSFS_ALLOC_FILEHANDLE));
+   if (not retval or not info) {
+      allocator.Free(retval);
+      allocator.Free(info);
+      BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+   }
 
-   // Give the platform layer first shot at this                        
-   retval = __PHYSFS_platformCalcBaseDir(argv0);
-   if (retval)
-      return retval;
+   new (info) ScheduledIoInfo {io, retainScheduler(s), static_cast<PHYSFS_uint64>(at)};
+   memcpy(retval, &scheduledIoInterface, sizeof(PHYSFS_Io));
+   if (io->version < 1 or not io->readAt)
+      retval->readAt = nullptr;
+   retval->opaque = info;
+   return retval;
+}
 
-   // We need argv0 to go on                                            
-   BAIL_IF(not argv0, PHYSFS_ERR_ARGV0_IS_NULL, nullptr);
+PHYSFS_Io* PHYSFS_createScheduledIo(PHYSFS_Io* io, const PHYSFS_IoSchedule* schedule) {
+   BAIL_IF(not io, PHYSFS_ERR_INVALID_ARGUMENT, nullptr);
+   auto scheduler = createScheduler(schedule);
+   BAIL_IF_ERRPASS(not scheduler, nullptr);
 
-   ptr = strrchr(argv0, dirsep);
-   if (ptr) {
-      const size_t size = ((size_t) (ptr - argv0)) + 1;
-      retval = (char*) allocator.Malloc(size + 1);
-      BAIL_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
-      memcpy(retval, argv0, size);
-      retval[size] = '\0';
-      return retval;
+   PHYSFS_Io* retval;
+   try { retval = scheduleIo(io, scheduler); }
+   catch (...) {
+      releaseScheduler(scheduler);
+      throw;
    }
+   if (retval)
+      scheduler->head = static_cast<ScheduledIoInfo*>(retval->opaque)->pos;
+   releaseScheduler(scheduler);
+   return retval;
+}
 
-   // argv0 wasn't helpful                                              
-   BAIL(PHYSFS_ERR_INVALID_ARGUMENT, nullptr);
+int PHYSFS_getIoSchedulerStats(PHYSFS_Io* io, PHYSFS_IoSchedulerStats* stats) {
+   BAIL_IF(not io or not stats or io->read != scheduledIo_read, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   auto scheduler = static_cast<ScheduledIoInfo*>(io->opaque)->scheduler;
+   __PHYSFS_PlatformLock lock {scheduler->mutex};
+   *stats = scheduler->stats;
+   return 1;
 }
 
-///                                                                           
-static int initializeMutexes(void) {
-   errorLock = __PHYSFS_platformCreateMutex();
-   if (errorLock == nullptr)
-      goto initializeMutexes_failed;
+/// Picked up by the mounts made in this context from now on                  
+int PHYSFS_setIoSchedule(const PHYSFS_IoSchedule* schedule) {
+   auto& context = ctx();
+   __PHYSFS_platformGrabMutex(context.stateLock);
+   context.ioScheduled = schedule != nullptr;
+   context.ioSchedule = schedule ? *schedule : PHYSFS_IoSchedule {};
+   __PHYSFS_platformReleaseMutex(context.stateLock);
+   return 1;
+}
 
-   stateLock = __PHYSFS_platformCreateMutex();
-   if (stateLock == nullptr)
-      goto initializeMutexes_failed;
+int PHYSFS_getMountIoSchedulerStats(const char* dir, PHYSFS_IoSchedulerStats* stats) {
+   BAIL_IF(not dir or not stats, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   auto& context = ctx();
+   __PHYSFS_platformGrabMutex(context.stateLock);
+   auto i = context.searchPath;
+   while (i and strcmp(i->dirName, dir) != 0)
+      i = i->next;
+   BAIL_IF_MUTEX(not i, PHYSFS_ERR_NOT_MOUNTED, context.stateLock, 0);
+   BAIL_IF_MUTEX(not i->scheduler, PHYSFS_ERR_INVALID_ARGUMENT, context.stateLock, 0);
 
-   // Success                                                           
+   {
+      __PHYSFS_PlatformLock lock {i->scheduler->mutex};
+      *stats = i->scheduler->stats;
+   }
+   __PHYSFS_platformReleaseMutex(context.stateLock);
    return 1;
+}
+#else
+namespace
+{
+   // Nothing runs alongside anything to be queued behind               
+   IoScheduler* createScheduler(const PHYSFS_IoSchedule*) {
+      BAIL(PHYSFS_ERR_UNSUPPORTED, nullptr);
+   }
 
-initializeMutexes_failed:
-   if (errorLock != nullptr)
-      __PHYSFS_platformDestroyMutex(errorLock);
-
-   if (stateLock != nullptr)
-      __PHYSFS_platformDestroyMutex(stateLock);
+   IoScheduler* retainScheduler(IoScheduler* s) {
+      return s;
+   }
 
-   // Fail                                                              
-   errorLock = stateLock = nullptr;
-   return 0;
+   void releaseScheduler(IoScheduler*) {}
 }
 
+static PHYSFS_Io* scheduleIo(PHYSFS_Io*, IoScheduler*) {
+   BAIL(PHYSFS_ERR_UNSUPPORTED, nullptr);
+}
 
-static int doRegisterArchiver(const PHYSFS_Archiver*);
+PHYSFS_Io* PHYSFS_createScheduledIo(PHYSFS_Io*, const PHYSFS_IoSchedule*) {
+   BAIL(PHYSFS_ERR_UNSUPPORTED, nullptr);
+}
 
-static int initStaticArchivers(void) {
-   #define REGISTER_STATIC_ARCHIVER(arc) { \
-      if (not doRegisterArchiver(&__PHYSFS_Archiver_##arc)) \
-         return 0; \
-    }
+int PHYSFS_getIoSchedulerStats(PHYSFS_Io*, PHYSFS_IoSchedulerStats*) {
+   BAIL(PHYSFS_ERR_UNSUPPORTED, 0);
+}
 
-   #if PHYSFS_SUPPORTS_ZIP
-      REGISTER_STATIC_ARCHIVER(ZIP);
-   #endif
-   #if PHYSFS_SUPPORTS_7Z
-      SZIP_global_init();
-      REGISTER_STATIC_ARCHIVER(7Z);
-   #endif
-   #if PHYSFS_SUPPORTS_GRP
-      REGISTER_STATIC_ARCHIVER(GRP);
-   #endif
-   #if PHYSFS_SUPPORTS_QPAK
-      REGISTER_STATIC_ARCHIVER(QPAK);
-   #endif
-   #if PHYSFS_SUPPORTS_HOG
-      REGISTER_STATIC_ARCHIVER(HOG);
-   #endif
-   #if PHYSFS_SUPPORTS_MVL
-      REGISTER_STATIC_ARCHIVER(MVL);
-   #endif
-   #if PHYSFS_SUPPORTS_WAD
-      REGISTER_STATIC_ARCHIVER(WAD);
-   #endif
-   #if PHYSFS_SUPPORTS_CSM
-      REGISTER_STATIC_ARCHIVER(CSM);
-   #endif
-   #if PHYSFS_SUPPORTS_SLB
-      REGISTER_STATIC_ARCHIVER(SLB);
-   #endif
-   #if PHYSFS_SUPPORTS_ISO9660
-      REGISTER_STATIC_ARCHIVER(ISO9660);
-   #endif
-   #if PHYSFS_SUPPORTS_VDF
-   REGISTER_STATIC_ARCHIVER(VDF)
-   #endif
+int PHYSFS_setIoSchedule(const PHYSFS_IoSchedule*) {
+   BAIL(PHYSFS_ERR_UNSUPPORTED, 0);
+}
 
-   #undef REGISTER_STATIC_ARCHIVER
-   return 1;
+int PHYSFS_getMountIoSchedulerStats(const char*, PHYSFS_IoSchedulerStats*) {
+   BAIL(PHYSFS_ERR_UNSUPPORTED, 0);
 }
+#endif
 
+PHYSFS_Io* __PHYSFS_createNativeIo(const char* path, int mode) {
+   assert((mode == 'r') || (mode == 'w') || (mode == 'a') || (mode == 'd'));
 
-static int  doDeinit(void);
+#if PHYSFS_HAVE_DIRECT_IO
+   if (mode == 'd') {
+      if (auto io = createDirectIo(path))
+         return io;
+   }
+#endif
 
-int PHYSFS_init(const char* argv0) {
-   BAIL_IF(initialized, PHYSFS_ERR_IS_INITIALIZED, 0);
-   if (not __PHYSFS_platformInit(argv0))
-      return 0;
+   // Direct i/o is unavailable, or refused by this filesystem          
+   if (mode == 'd')
+      mode = 'r';
+   auto io = PHYSFS_Allocator<PHYSFS_Io, PHYSFS_ALLOC_FILEHANDLE>(1, __PHYSFS_nativeIoInterface);
+   auto info = PHYSFS_Allocator<NativeIoInfo, PHYSFS_ALLOC_FILEHANDLE>(1);
+   auto pathdup = PHYSFS_Allocator<char, PHYSFS_ALLOC_FILEHANDLE>(strlen(path) + 1);
 
-   // Everything below here can be cleaned up safely by doDeinit()      
-   if (not initializeMutexes())
-      goto initFailed;
+   void* handle = nullptr;
+   if (mode == 'r')
+      handle = __PHYSFS_platformOpenRead(path);
+   else if (mode == 'w')
+      handle = __PHYSFS_platformOpenWrite(path);
+   else if (mode == 'a')
+      handle = __PHYSFS_platformOpenAppend(path);
 
-   baseDir = calculateBaseDir(argv0);
-   if (not baseDir)
-      goto initFailed;
+   if (not handle)
+      MetaPhysFS::Throw<PHYSFS_ERR_OUT_OF_MEMORY>();
 
-   userDir = __PHYSFS_platformCalcUserDir();
-   if (not userDir)
-      goto initFailed;
+   strcpy(pathdup.Get(), path);
+   info->handle = handle;
+   info->path = pathdup.Ref();
+   info->mode = mode;
+   io->opaque = info.Ref();
+   return io.Ref();
+}
 
-   // Platform layer is required to append a dirsep                     
-   #ifndef __ANDROID__  // It's an APK file, not a directory on Android 
-      assert(baseDir[strlen(baseDir) - 1] == __PHYSFS_platformDirSeparator);
-   #endif
 
-   assert(userDir[strlen(userDir) - 1] == __PHYSFS_platformDirSeparator);
+///                                                                           
+/// PHYSFS_Io implementation for i/o to a memory buffer...                    
+///                                                                           
+struct MemoryIoInfo {
+   const PHYSFS_uint8* buf;
+   PHYSFS_uint64 len;
+   PHYSFS_uint64 pos;
+   PHYSFS_Io* parent;
+   int refcount;
+   void (*destruct)(void*);
+};
 
-   if (not initStaticArchivers())
-      goto initFailed;
+static PHYSFS_sint64 memoryIo_read(PHYSFS_Io* io, void* buf, PHYSFS_uint64 len) {
+   MemoryIoInfo* info = (MemoryIoInfo*) io->opaque;
+   const PHYSFS_uint64 avail = info->len - info->pos;
+   assert(avail <= info->len);
 
-   initialized = 1;
+   if (avail == 0)
+      return 0;  // We're at EOF; nothing to do                         
 
-   // This makes sure that the error subsystem is initialized           
-   PHYSFS_setErrorCode(PHYSFS_getLastErrorCode());
-   return 1;
+   if (len > avail)
+      len = avail;
 
-initFailed:
-   doDeinit();
-   return 0;
+   memcpy(buf, info->buf + info->pos, (size_t) len);
+   info->pos += len;
+   return len;
 }
 
-/// MAKE SURE you hold stateLock before calling this!                         
-static int closeFileHandleList(FileHandle** list) {
-   FileHandle* next = nullptr;
-   for (auto i = *list; i; i = next) {
-      auto io = i->io;
-      next = i->next;
-
-      if (io->flush and not io->flush(io)) {
-         *list = i;
-         return 0;
-      }
+/// Doesn't touch pos, so any number of threads can do this at once           
+static PHYSFS_sint64 memoryIo_readAt(PHYSFS_Io* io, PHYSFS_uint64 offset,
+   void* buf, PHYSFS_uint64 len) {
+   const MemoryIoInfo* info = (MemoryIoInfo*) io->opaque;
+   if (offset >= info->len)
+      return 0;
 
-      io->destroy(io);
-      PHYSFS_Allocator<>::Free(i);
-   }
+   if (len > info->len - offset)
+      len = info->len - offset;
 
-   *list = nullptr;
-   return 1;
+   memcpy(buf, info->buf + offset, (size_t) len);
+   return (PHYSFS_sint64) len;
 }
 
-/// MAKE SURE you hold the stateLock before calling this!                     
-static void freeSearchPath(void) {
-   closeFileHandleList(&openReadList);
-
-   if (searchPath) {
-      DirHandle* next = nullptr;
-      for (auto i = searchPath; i; i = next) {
-         next = i->next;
-         freeDirHandle(i, openReadList);
-      }
+static PHYSFS_sint64 memoryIo_write(PHYSFS_Io*, const void*, PHYSFS_uint64) {
+   BAIL(PHYSFS_ERR_OPEN_FOR_READING, -1);
+}
 
-      searchPath = nullptr;
-   }
+static int memoryIo_seek(PHYSFS_Io* io, PHYSFS_uint64 offset) {
+   MemoryIoInfo* info = (MemoryIoInfo*) io->opaque;
+   BAIL_IF(offset > info->len, PHYSFS_ERR_PAST_EOF, 0);
+   info->pos = offset;
+   return 1;
 }
 
-/// MAKE SURE you hold stateLock before calling this!                         
-static int archiverInUse(const PHYSFS_Archiver* arc, const DirHandle* list) {
-   for (auto i = list; i; i = i->next) {
-      if (i->funcs == arc)
-         return 1;
-   }
+static PHYSFS_sint64 memoryIo_tell(PHYSFS_Io* io) {
+   const MemoryIoInfo* info = (MemoryIoInfo*) io->opaque;
+   return (PHYSFS_sint64) info->pos;
+}
 
-   return 0;  // Not in use                                             
+static PHYSFS_sint64 memoryIo_length(PHYSFS_Io* io) {
+   const MemoryIoInfo* info = (MemoryIoInfo*) io->opaque;
+   return (PHYSFS_sint64) info->len;
 }
 
-/// MAKE SURE you hold stateLock before calling this!                         
-static int doDeregisterArchiver(const size_t idx) {
-   const size_t len = (numArchivers - idx) * sizeof(void*);
-   auto info = archiveInfo[idx];
-   auto arc = archivers[idx];
+static PHYSFS_Io* memoryIo_duplicate(PHYSFS_Io* io) {
+   auto info = static_cast<MemoryIoInfo*>(io->opaque);
+   PHYSFS_Io* parent = info->parent;
 
-   // Make sure nothing is still using this archiver                    
-   if (archiverInUse(arc, searchPath) or archiverInUse(arc, writeDir))
-      BAIL(PHYSFS_ERR_FILES_STILL_OPEN, 0);
+   // Avoid deep copies                                                 
+   assert(not parent or not ((MemoryIoInfo*) parent->opaque)->parent);
 
-   PHYSFS_Allocator<>::Free((void*) info->extension);
-   PHYSFS_Allocator<>::Free((void*) info->description);
-   PHYSFS_Allocator<>::Free((void*) info->author);
-   PHYSFS_Allocator<>::Free((void*) info->url);
-   PHYSFS_Allocator<>::Free((void*) arc);
+   // Share the buffer between duplicates                               
+   if (parent != nullptr)  // Dup the parent, increment its refcount    
+      return parent->duplicate(parent);
 
-   memmove(&archiveInfo[idx], &archiveInfo[idx + 1], len);
-   memmove(&archivers[idx], &archivers[idx + 1], len);
+   // We're the parent                                                  
+   auto newinfo = PHYSFS_Allocator<MemoryIoInfo, PHYSFS_ALLOC_FILEHANDLE>(1);
+   (void) __PHYSFS_ATOMIC_INCR(&info->refcount);
 
-   assert(numArchivers > 0);
-   numArchivers--;
+   memset(newinfo.Get(), 0, sizeof(*info));
+   newinfo->buf = info->buf;
+   newinfo->len = info->len;
+   newinfo->pos = 0;
+   newinfo->parent = io;
+   newinfo->refcount = 0;
+   newinfo->destruct = nullptr;
 
-   return 1;
+   auto retval = PHYSFS_Allocator<PHYSFS_Io, PHYSFS_ALLOC_FILEHANDLE>(1, *io);
+   retval->opaque = newinfo.Ref();
+   return retval.Ref();
 }
 
-/// Does NOT hold the state lock; we're shutting down                         
-static void freeArchivers(void) {
-   while (numArchivers > 0) {
-      if (not doDeregisterArchiver(numArchivers - 1))
-         assert(not "nothing should be mounted during shutdown.");
-   }
-
-   PHYSFS_Allocator<>::Free(archivers);
-   PHYSFS_Allocator<>::Free(archiveInfo);
-   archivers = nullptr;
-   archiveInfo = nullptr;
+static int memoryIo_flush(PHYSFS_Io*) {
+   return 1;  // It's read-only                                         
 }
 
-///                                                                           
-static int doDeinit(void) {
-   closeFileHandleList(&openWriteList);
-   BAIL_IF(not PHYSFS_setWriteDir(nullptr), PHYSFS_ERR_FILES_STILL_OPEN, 0);
-
-   freeSearchPath();
-   freeArchivers();
-   freeErrorStates();
-
-   if (baseDir) {
-      PHYSFS_Allocator<>::Free(baseDir);
-      baseDir = nullptr;
-   }
-
-   if (userDir) {
-      PHYSFS_Allocator<>::Free(userDir);
-      userDir = nullptr;
-   }
+static void memoryIo_destroy(PHYSFS_Io* io) {
+   auto info = static_cast<MemoryIoInfo*>(io->opaque);
+   auto parent = info->parent;
 
-   if (prefDir) {
-      PHYSFS_Allocator<>::Free(prefDir);
-      prefDir = nullptr;
+   if (parent) {
+      assert(info->buf == ((MemoryIoInfo*) info->parent->opaque)->buf);
+      assert(info->len == ((MemoryIoInfo*) info->parent->opaque)->len);
+      assert(info->refcount == 0);
+      assert(info->destruct == nullptr);
+      PHYSFS_Allocator<>::Free(info);
+      PHYSFS_Allocator<>::Free(io);
+      parent->destroy(parent);   // Decrements refcount                 
+      return;
    }
 
-   if (archiveInfo) {
-      PHYSFS_Allocator<>::Free(archiveInfo);
-      archiveInfo = nullptr;
-   }
+   // We _are_ the parent                                               
+   assert(info->refcount > 0);   // Even in a race, we hold a reference 
 
-   if (archivers) {
-      PHYSFS_Allocator<>::Free(archivers);
-      archivers = nullptr;
+   if (__PHYSFS_ATOMIC_DECR(&info->refcount) == 0) {
+      void (*destruct)(void*) = info->destruct;
+      void* buf = (void*) info->buf;
+      io->opaque = nullptr;      // Kill this here in case of race      
+      PHYSFS_Allocator<>::Free(info);
+      PHYSFS_Allocator<>::Free(io);
+      if (destruct)
+         destruct(buf);
    }
+}
 
-   longest_root = 0;
-   allowSymLinks = 0;
-   initialized = 0;
-
-   if (errorLock)
-      __PHYSFS_platformDestroyMutex(errorLock);
-
-   if (stateLock)
-      __PHYSFS_platformDestroyMutex(stateLock);
+static const PHYSFS_Io __PHYSFS_memoryIoInterface =
+{
+   CURRENT_PHYSFS_IO_API_VERSION, nullptr,
+   memoryIo_read,
+   memoryIo_write,
+   memoryIo_seek,
+   memoryIo_tell,
+   memoryIo_length,
+   memoryIo_duplicate,
+   memoryIo_flush,
+   memoryIo_destroy,
+   memoryIo_readAt
+};
 
-   errorLock = stateLock = nullptr;
+PHYSFS_Io* __PHYSFS_createMemoryIo(const void* buf, PHYSFS_uint64 len, void (*destruct)(void*)) {
+   auto io = PHYSFS_Allocator<PHYSFS_Io, PHYSFS_ALLOC_FILEHANDLE>(1, __PHYSFS_memoryIoInterface);
+   auto info = PHYSFS_Allocator<MemoryIoInfo, PHYSFS_ALLOC_FILEHANDLE>(1);
 
-   __PHYSFS_platformDeinit();
-   return 1;
+   memset(info.Get(), 0, sizeof(MemoryIoInfo));
+   info->buf = (const PHYSFS_uint8*) buf;
+   info->len = len;
+   info->pos = 0;
+   info->parent = nullptr;
+   info->refcount = 1;
+   info->destruct = destruct;
+   io->opaque = info.Ref();
+   return io.Ref();
 }
 
-///                                                                           
-int PHYSFS_deinit() {
-   BAIL_IF(not initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
-   return doDeinit();
-}
 
 ///                                                                           
-int PHYSFS_isInit() {
-   return initialized;
-}
-
+/// PHYSFS_Io implementation for i/o to a PHYSFS_File...                      
 ///                                                                           
-char* __PHYSFS_strdup(const char* str) {
-   char* retval = PHYSFS_Allocator<char>(strlen(str) + 1).Ref();
-   if (retval)
-      strcpy(retval, str);
-   return retval;
+static PHYSFS_sint64 handleIo_read(PHYSFS_Io* io, void* buf, PHYSFS_uint64 len) {
+   return PHYSFS_readBytes((PHYSFS_File*) io->opaque, buf, len);
 }
 
-///                                                                           
-PHYSFS_uint32 __PHYSFS_hashString(const char* str) {
-   PHYSFS_uint32 hash = 5381;
-   while (1) {
-      const char ch = *(str++);
-      if (not ch)
-         break;
-      hash = ((hash << 5) + hash) ^ ch;
-   }
+static PHYSFS_sint64 handleIo_readAt(PHYSFS_Io* io, PHYSFS_uint64 offset,
+   void* buf, PHYSFS_uint64 len) {
+   return PHYSFS_readAt((PHYSFS_File*) io->opaque, offset, buf, len);
+}
 
-   return hash;
+static PHYSFS_sint64 handleIo_write(PHYSFS_Io* io, const void* buffer,
+   PHYSFS_uint64 len) {
+   return PHYSFS_writeBytes((PHYSFS_File*) io->opaque, buffer, len);
 }
 
-///                                                                           
-PHYSFS_uint32 __PHYSFS_hashStringCaseFold(const char* str) {
-   PHYSFS_uint32 hash = 5381;
-   while (1) {
-      const auto cp = __PHYSFS_utf8codepoint(&str);
-      if (not cp)
-         break;
+static int handleIo_seek(PHYSFS_Io* io, PHYSFS_uint64 offset) {
+   return PHYSFS_seek((PHYSFS_File*) io->opaque, offset);
+}
 
-      PHYSFS_uint32 folded[3];
-      const int numbytes = PHYSFS_caseFold(cp, folded) * sizeof(PHYSFS_uint32);
-      const char* bytes  = (const char*) folded;
-      for (auto i = 0; i < numbytes; i++)
-         hash = ((hash << 5) + hash) ^ *(bytes++);
-   }
+static PHYSFS_sint64 handleIo_tell(PHYSFS_Io* io) {
+   return PHYSFS_tell((PHYSFS_File*) io->opaque);
+}
 
-   return hash;
+static PHYSFS_sint64 handleIo_length(PHYSFS_Io* io) {
+   return PHYSFS_fileLength((PHYSFS_File*) io->opaque);
 }
 
-PHYSFS_uint32 __PHYSFS_hashStringCaseFoldUSAscii(const char* str) {
-   PHYSFS_uint32 hash = 5381;
-   while (1) {
-      char ch = *(str++);
-      if (not ch)
-         break;
+static PHYSFS_Io* handleIo_duplicate(PHYSFS_Io* io) {
+   // There's no duplicate at the PHYSFS_File level, so we break the    
+   // abstraction. We're allowed to: we're physfs.c!                    
+   auto origfh = static_cast<FileHandle*>(io->opaque);
+   auto newfh = PHYSFS_Allocator<FileHandle, PHYSFS_ALLOC_FILEHANDLE>(1);
+   memset(newfh.Get(), 0, sizeof(FileHandle));
 
-      if (ch >= 'A' and ch <= 'Z')
-         ch -= ('A' - 'a');
-      hash = ((hash << 5) + hash) ^ ch;
+   newfh->io = origfh->io->duplicate(origfh->io);
+   newfh->forReading = origfh->forReading;
+   newfh->dirHandle = origfh->dirHandle;
+   newfh->context = origfh->context;
+   if (origfh->atLock) {
+      newfh->atLock = __PHYSFS_platformCreateMutex();
+      if (not newfh->atLock) {
+         newfh->io->destroy(newfh->io);
+         BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+      }
    }
 
-   return hash;
+   // The original handle keeps dirHandle mounted, so no stateLock here 
+   __PHYSFS_ATOMIC_INCR(&newfh->dirHandle->openFiles);
+   registerFileHandle(newfh.Get());
+
+   auto retval = PHYSFS_Allocator<PHYSFS_Io, PHYSFS_ALLOC_FILEHANDLE>(1, *io);
+   retval->opaque = newfh.Ref();
+   return retval.Ref();
 }
 
-/// MAKE SURE you hold stateLock before calling this!                         
-static int doRegisterArchiver(const PHYSFS_Archiver* _archiver) {
-   const PHYSFS_uint32 maxver = CURRENT_PHYSFS_ARCHIVER_API_VERSION;
-   const size_t len = (numArchivers + 2) * sizeof(void*);
-   void* ptr = nullptr;
-
-   BAIL_IF(not _archiver, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-   BAIL_IF(    _archiver->version > maxver, PHYSFS_ERR_UNSUPPORTED, 0);
-   BAIL_IF(not _archiver->info.extension, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-   BAIL_IF(not _archiver->info.description, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-   BAIL_IF(not _archiver->info.author, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-   BAIL_IF(not _archiver->info.url, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-   BAIL_IF(not _archiver->openArchive, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-   BAIL_IF(not _archiver->enumerate, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-   BAIL_IF(not _archiver->openRead, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-   BAIL_IF(not _archiver->openWrite, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-   BAIL_IF(not _archiver->openAppend, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-   BAIL_IF(not _archiver->remove, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-   BAIL_IF(not _archiver->mkdir, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-   BAIL_IF(not _archiver->closeArchive, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-   BAIL_IF(not _archiver->stat, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+static int handleIo_flush(PHYSFS_Io* io) {
+   return PHYSFS_flush((PHYSFS_File*) io->opaque);
+}
 
-   auto ext = _archiver->info.extension;
-   for (auto i = 0; i < numArchivers; i++) {
-      if (PHYSFS_utf8stricmp(archiveInfo[i]->extension, ext) == 0)
-         BAIL(PHYSFS_ERR_DUPLICATE, 0);
-   }
+static void handleIo_destroy(PHYSFS_Io* io) {
+   if (io->opaque)
+      PHYSFS_close((PHYSFS_File*) io->opaque);
+   PHYSFS_Allocator<>::Free(io);
+}
 
-   // Make a copy of the data                                           
-   auto archiver = PHYSFS_Allocator<PHYSFS_Archiver>(1, *_archiver);
-   auto info = &archiver->info;
-   memset(info, '\0', sizeof(*info));  // nullptr in case an alloc fails
+static const PHYSFS_Io __PHYSFS_handleIoInterface = {
+   CURRENT_PHYSFS_IO_API_VERSION, nullptr,
+   handleIo_read,
+   handleIo_write,
+   handleIo_seek,
+   handleIo_tell,
+   handleIo_length,
+   handleIo_duplicate,
+   handleIo_flush,
+   handleIo_destroy,
+   handleIo_readAt
+};
 
-   #define CPYSTR(item) \
-           info->item = __PHYSFS_strdup(_archiver->info.item); \
-           GOTO_IF(!info->item, PHYSFS_ERR_OUT_OF_MEMORY, regfailed);
-      CPYSTR(extension);
-      CPYSTR(description);
-      CPYSTR(author);
-      CPYSTR(url);
-      info->supportsSymlinks = _archiver->info.supportsSymlinks;
-   #undef CPYSTR
+static PHYSFS_Io* __PHYSFS_createHandleIo(PHYSFS_File* f) {
+   auto io = PHYSFS_Allocator<PHYSFS_Io, PHYSFS_ALLOC_FILEHANDLE>(1, __PHYSFS_handleIoInterface);
+   io->opaque = f;
+   return io.Ref();
+}
 
-   ptr = allocator.Realloc(archiveInfo, len);
-   GOTO_IF(!ptr, PHYSFS_ERR_OUT_OF_MEMORY, regfailed);
-   archiveInfo = (PHYSFS_ArchiveInfo**) ptr;
 
-   ptr = allocator.Realloc(archivers, len);
-   GOTO_IF(!ptr, PHYSFS_ERR_OUT_OF_MEMORY, regfailed);
-   archivers = (PHYSFS_Archiver**) ptr;
+///                                                                           
+/// Functions ...                                                             
+///                                                                           
 
-   archiveInfo[numArchivers] = info;
-   archiveInfo[numArchivers + 1] = nullptr;
+struct EnumStringListCallbackData {
+   char** list;
+   PHYSFS_uint32 size;
+   PHYSFS_ErrorCode errcode;
+};
 
-   archivers[numArchivers] = archiver.Ref();
-   archivers[numArchivers + 1] = nullptr;
+static void enumStringListCallback(void* data, const char* str) {
+   auto pecd = static_cast<EnumStringListCallbackData*>(data);
+   if (pecd->errcode)
+      return;
 
-   numArchivers++;
-   return 1;
+   auto ptr = PHYSFS_Allocator<>::Realloc(pecd->list, (pecd->size + 2) * sizeof(char*));
+   auto newstr = PHYSFS_Allocator<char>(strlen(str) + 1);
+   if (ptr)
+      pecd->list = (char**) ptr;
 
-regfailed:
-   if (info) {
-      PHYSFS_Allocator<>::Free((void*) info->extension);
-      PHYSFS_Allocator<>::Free((void*) info->description);
-      PHYSFS_Allocator<>::Free((void*) info->author);
-      PHYSFS_Allocator<>::Free((void*) info->url);
+   if (not ptr or not newstr) {
+      pecd->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
+      pecd->list[pecd->size] = nullptr;
+      PHYSFS_freeList(pecd->list);
+      return;
    }
 
-   allocator.Free(archiver);
-   return 0;
+   strcpy(newstr.Get(), str);
+   pecd->list[pecd->size] = newstr.Ref();
+   pecd->size++;
 }
 
-int PHYSFS_registerArchiver(const PHYSFS_Archiver* archiver) {
-   BAIL_IF(not initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+static char** doEnumStringList(void (*func)(PHYSFS_StringCallback, void*)) {
+   EnumStringListCallbackData ecd;
+   memset(&ecd, '\0', sizeof(ecd));
+   ecd.list = PHYSFS_Allocator<char*>(1).Ref();
+   func(enumStringListCallback, &ecd);
 
-   __PHYSFS_platformGrabMutex(stateLock);
-   auto retval = doRegisterArchiver(archiver);
-   __PHYSFS_platformReleaseMutex(stateLock);
-   return retval;
+   if (ecd.errcode) {
+      PHYSFS_setErrorCode(ecd.errcode);
+      return nullptr;
+   }
+
+   ecd.list[ecd.size] = nullptr;
+   return ecd.list;
 }
 
-int PHYSFS_deregisterArchiver(const char* ext) {
-   BAIL_IF(not initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
-   BAIL_IF(not ext, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+static void __PHYSFS_bubble_sort(void* a, size_t lo, size_t hi,
+   int (*cmpfn)(void*, size_t, size_t),
+   void (*swapfn)(void*, size_t, size_t)) {
+   size_t i;
+   int sorted;
 
-   __PHYSFS_platformGrabMutex(stateLock);
-   for (size_t i = 0; i < numArchivers; i++) {
-      if (PHYSFS_utf8stricmp(archiveInfo[i]->extension, ext) == 0) {
-         const int retval = doDeregisterArchiver(i);
-         __PHYSFS_platformReleaseMutex(stateLock);
-         return retval;
+   do {
+      sorted = 1;
+      for (i = lo; i < hi; i++) {
+         if (cmpfn(a, i, i + 1) > 0) {
+            swapfn(a, i, i + 1);
+            sorted = 0;
+         }
       }
    }
-   __PHYSFS_platformReleaseMutex(stateLock);
-
-   BAIL(PHYSFS_ERR_NOT_FOUND, 0);
+   while (not sorted);
 }
 
-const PHYSFS_ArchiveInfo** PHYSFS_supportedArchiveTypes(void) {
-   BAIL_IF(not initialized, PHYSFS_ERR_NOT_INITIALIZED, nullptr);
-   return (const PHYSFS_ArchiveInfo**) archiveInfo;
-}
+static void __PHYSFS_quick_sort(
+   void* a, size_t lo, size_t hi,
+   int (*cmpfn)(void*, size_t, size_t),
+   void (*swapfn)(void*, size_t, size_t)
+) {
+   size_t i, j, v;
 
-void PHYSFS_freeList(void* list) {
-   if (list) {
-      for (auto i = static_cast<void**>(list); *i; i++)
-         PHYSFS_Allocator<>::Free(*i);
-      PHYSFS_Allocator<>::Free(list);
+   if ((hi - lo) <= PHYSFS_QUICKSORT_THRESHOLD)
+      __PHYSFS_bubble_sort(a, lo, hi, cmpfn, swapfn);
+   else {
+      i = (hi + lo) / 2;
+
+      if (cmpfn(a, lo, i) > 0)
+         swapfn(a, lo, i);
+      if (cmpfn(a, lo, hi) > 0)
+         swapfn(a, lo, hi);
+      if (cmpfn(a, i, hi) > 0)
+         swapfn(a, i, hi);
+
+      j = hi - 1;
+      swapfn(a, i, j);
+      i = lo;
+      v = j;
+
+      while (1) {
+         while (cmpfn(a, ++i, v) < 0) { /* do nothing */ }
+         while (cmpfn(a, --j, v) > 0) { /* do nothing */ }
+         if (j < i)
+            break;
+         swapfn(a, i, j);
+      }
+
+      if (i != (hi - 1))
+         swapfn(a, i, hi - 1);
+
+      __PHYSFS_quick_sort(a, lo, j, cmpfn, swapfn);
+      __PHYSFS_quick_sort(a, i + 1, hi, cmpfn, swapfn);
    }
 }
 
-const char* PHYSFS_getDirSeparator() {
-   static char retval[2] = {__PHYSFS_platformDirSeparator, '\0'};
-   return retval;
+void __PHYSFS_sort(
+   void* entries, size_t max,
+   int  (*cmpfn)(void*, size_t, size_t),
+   void (*swapfn)(void*, size_t, size_t)
+) {
+   /// Quicksort w/ Bubblesort fallback algorithm inspired by code from here: 
+   ///   https://www.cs.ubc.ca/spider/harrison/Java/sorting-demo.html         
+   if (max > 0)
+      __PHYSFS_quick_sort(entries, 0, max - 1, cmpfn, swapfn);
 }
 
-char** PHYSFS_getCdRomDirs() {
-   return doEnumStringList(__PHYSFS_platformDetectAvailableCDs);
-}
+static ErrState* findErrorForCurrentThread(void) {
+   ErrState* i;
+   void* tid;
 
-void PHYSFS_getCdRomDirsCallback(PHYSFS_StringCallback callback, void* data) {
-   __PHYSFS_platformDetectAvailableCDs(callback, data);
-}
+   if (errorLock)
+      __PHYSFS_platformGrabMutex(errorLock);
 
-const char* PHYSFS_getPrefDir(const char* org, const char* app) {
-   const char dirsep = __PHYSFS_platformDirSeparator;
-   PHYSFS_Stat statbuf;
-   char* ptr = nullptr;
-   char* endstr = nullptr;
+   if (errorStates) {
+      tid = __PHYSFS_platformGetThreadID();
 
-   BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
-   BAIL_IF(!org, PHYSFS_ERR_INVALID_ARGUMENT, nullptr);
-   BAIL_IF(*org == '\0', PHYSFS_ERR_INVALID_ARGUMENT, nullptr);
-   BAIL_IF(!app, PHYSFS_ERR_INVALID_ARGUMENT, nullptr);
-   BAIL_IF(*app == '\0', PHYSFS_ERR_INVALID_ARGUMENT, nullptr);
+      for (i = errorStates; i; i = i->next) {
+         if (i->tid == tid) {
+            if (errorLock)
+               __PHYSFS_platformReleaseMutex(errorLock);
+            return i;
+         }
+      }
+   }
 
-   allocator.Free(prefDir);
-   prefDir = __PHYSFS_platformCalcPrefDir(org, app);
-   BAIL_IF_ERRPASS(!prefDir, nullptr);
+   if (errorLock != nullptr)
+      __PHYSFS_platformReleaseMutex(errorLock);
 
-   assert(strlen(prefDir) > 0);
-   endstr = prefDir + (strlen(prefDir) - 1);
-   assert(*endstr == dirsep);
-   *endstr = '\0';  /* mask out the final dirsep for now. */
+   return nullptr;   // No error available                              
+}
+
+/// This doesn't reset the error state                                        
+static inline PHYSFS_ErrorCode currentErrorCode(void) {
+   const ErrState* err = findErrorForCurrentThread();
+   return err ? err->code : PHYSFS_ERR_OK;
+}
+
+PHYSFS_ErrorCode PHYSFS_getLastErrorCode(void) {
+   ErrState* err = findErrorForCurrentThread();
+   const PHYSFS_ErrorCode retval = (err) ? err->code : PHYSFS_ERR_OK;
+   if (err)
+      err->code = PHYSFS_ERR_OK;
+   return retval;
+}
+
+PHYSFS_DECL const char* PHYSFS_getErrorByCode(PHYSFS_ErrorCode code) {
+   switch (code) {
+   case PHYSFS_ERR_OK: return "no error";
+   case PHYSFS_ERR_OTHER_ERROR: return "unknown error";
+   case PHYSFS_ERR_OUT_OF_MEMORY: return "out of memory";
+   case PHYSFS_ERR_NOT_INITIALIZED: return "not initialized";
+   case PHYSFS_ERR_IS_INITIALIZED: return "already initialized";
+   case PHYSFS_ERR_ARGV0_IS_NULL: return "argv[0] is nullptr";
+   case PHYSFS_ERR_UNSUPPORTED: return "unsupported";
+   case PHYSFS_ERR_PAST_EOF: return "past end of file";
+   case PHYSFS_ERR_FILES_STILL_OPEN: return "files still open";
+   case PHYSFS_ERR_INVALID_ARGUMENT: return "invalid argument";
+   case PHYSFS_ERR_NOT_MOUNTED: return "not mounted";
+   case PHYSFS_ERR_NOT_FOUND: return "not found";
+   case PHYSFS_ERR_SYMLINK_FORBIDDEN: return "symlinks are forbidden";
+   case PHYSFS_ERR_NO_WRITE_DIR: return "write directory is not set";
+   case PHYSFS_ERR_OPEN_FOR_READING: return "file open for reading";
+   case PHYSFS_ERR_OPEN_FOR_WRITING: return "file open for writing";
+   case PHYSFS_ERR_NOT_A_FILE: return "not a file";
+   case PHYSFS_ERR_READ_ONLY: return "read-only filesystem";
+   case PHYSFS_ERR_CORRUPT: return "corrupted";
+   case PHYSFS_ERR_SYMLINK_LOOP: return "infinite symbolic link loop";
+   case PHYSFS_ERR_IO: return "i/o error";
+   case PHYSFS_ERR_PERMISSION: return "permission denied";
+   case PHYSFS_ERR_NO_SPACE: return "no space available for writing";
+   case PHYSFS_ERR_BAD_FILENAME: return "filename is illegal or insecure";
+   case PHYSFS_ERR_BUSY: return "tried to modify a file the OS needs";
+   case PHYSFS_ERR_DIR_NOT_EMPTY: return "directory isn't empty";
+   case PHYSFS_ERR_OS_ERROR: return "OS reported an error";
+   case PHYSFS_ERR_DUPLICATE: return "duplicate resource";
+   case PHYSFS_ERR_BAD_PASSWORD: return "bad password";
+   case PHYSFS_ERR_APP_CALLBACK: return "app callback reported error";
+   case PHYSFS_ERR_CANCELLED: return "operation was cancelled";
+   }
+
+   return nullptr;  /* don't know this error code. */
+}
+
+void PHYSFS_setErrorCode(PHYSFS_ErrorCode errcode) {
+   if (not errcode)
+      return;
+
+   auto err = findErrorForCurrentThread();
+   if (not err) {
+      err = PHYSFS_Allocator<ErrState>(1).Ref();
+      memset(err, '\0', sizeof(ErrState));
+      err->tid = __PHYSFS_platformGetThreadID();
+
+      if (errorLock)
+         __PHYSFS_platformGrabMutex(errorLock);
+
+      err->next = errorStates;
+      errorStates = err;
+
+      if (errorLock)
+         __PHYSFS_platformReleaseMutex(errorLock);
+   }
+
+   err->code = errcode;
+}
+
+const char* PHYSFS_getLastError() {
+   const auto err = PHYSFS_getLastErrorCode();
+   return err ? PHYSFS_getErrorByCode(err) : nullptr;
+}
+
+/// MAKE SURE that errorLock is held before calling this!                     
+static void freeErrorStates() {
+   ErrState* next;
+   for (auto i = errorStates; i; i = next) {
+      next = i->next;
+      PHYSFS_Allocator<>::Free(i);
+   }
+
+   errorStates = nullptr;
+}
+
+void PHYSFS_getLinkedVersion(PHYSFS_Version* ver) {
+   if (not ver)
+      return;
+   ver->major = PHYSFS_VER_MAJOR;
+   ver->minor = PHYSFS_VER_MINOR;
+   ver->patch = PHYSFS_VER_PATCH;
+}
+
+static const char* find_filename_extension(const char* fname) {
+   const char* retval = nullptr;
+   if (fname) {
+      const char* p = strchr(fname, '.');
+      retval = p;
+
+      while (p != nullptr) {
+         p = strchr(p + 1, '.');
+         if (p != nullptr)
+            retval = p;
+      }
+
+      if (retval != nullptr)
+         retval++;  /* skip '.' */
+   }
+
+   return retval;
+}
+
+static DirHandle* tryOpenDir(
+   PHYSFS_Io* io, const PHYSFS_Archiver* funcs,
+   const char* d, int forWriting, int* _claimed
+) {
+   if (io)
+      BAIL_IF_ERRPASS(not io->seek(io, 0), nullptr);
+
+   auto opaque = funcs->openArchive(io, d, forWriting, _claimed);
+   if (not opaque)
+      return nullptr;
+
+   // Archives that enumerate straight from a __PHYSFS_DirTree get their
+   // sorted listings built once, right here at mount. An archive that  
+   // can't list its files is no use mounted                            
+   if (funcs->enumerate == __PHYSFS_DirTreeEnumerate) {
+      int finalized;
+      try { finalized = __PHYSFS_DirTreeFinalize(static_cast<__PHYSFS_DirTree*>(opaque)); }
+      catch (...) {
+         funcs->closeArchive(opaque);
+         throw;
+      }
+      if (not finalized) {
+         funcs->closeArchive(opaque);
+         return nullptr;
+      }
+   }
+
+   DirHandle* retval;
+   try { retval = PHYSFS_Allocator<DirHandle>(1).Ref(); }
+   catch (...) {
+      funcs->closeArchive(opaque);
+      throw;
+   }
+
+   memset(retval, '\0', sizeof(DirHandle));
+   retval->mountPoint = nullptr;
+   retval->funcs = funcs;
+   retval->opaque = opaque;
+   if (funcs != &__PHYSFS_Archiver_DIR)
+      registeredArchiver(funcs)->dirHandles.fetch_add(1, std::memory_order_relaxed);
+   return retval;
+}
+
+///                                                                           
+/// Tell what the archive file at (d) is, from its (statbuf) and, where the   
+/// platform can tell, its file id                                            
+///                                                                           
+static ArchiveIdentity identifyArchive(const char* d, const PHYSFS_Stat& statbuf) {
+   ArchiveIdentity id {0, 0, statbuf.filesize, statbuf.modtime, d, false};
+#if PHYSFS_HAVE_FILE_IDS
+   id.byFileId = __PHYSFS_platformFileId(d, &id.device, &id.inode) != 0;
+#endif
+   return id;
+}
+
+///                                                                           
+/// Whether (a) and (b) are the same unchanged file, named alike enough to    
+/// have been probed by the same archiver                                     
+///                                                                           
+static bool sameArchive(const ArchiveIdentity& a, const ArchiveIdentity& b) {
+   if (a.size != b.size or a.modtime != b.modtime or a.byFileId != b.byFileId)
+      return false;
+
+   if (not a.byFileId)
+      return strcmp(a.path, b.path) == 0;
+   if (a.device != b.device or a.inode != b.inode)
+      return false;
+
+   // A hard link called .pk3 could probe differently than its .grp     
+   auto aext = find_filename_extension(a.path);
+   auto bext = find_filename_extension(b.path);
+   if (not aext or not bext)
+      return aext == bext;
+   return PHYSFS_utf8stricmp(aext, bext) == 0;
+}
+
+///                                                                           
+/// Make a DirHandle onto an archive that's already mounted somewhere, in any 
+/// context, instead of parsing it again. Returns nullptr if there's none     
+///                                                                           
+static DirHandle* openSharedArchive(const ArchiveIdentity& id) {
+   DirHandle* retval = nullptr;
+   __PHYSFS_platformGrabMutex(sharedLock);
+
+   auto shared = sharedArchives;
+   while (shared and not sameArchive(shared->id, id))
+      shared = shared->next;
+
+   if (shared)
+      retval = PHYSFS_Allocator<DirHandle>(1).Ref();
+   if (retval) {
+      memset(retval, '\0', sizeof(DirHandle));
+      retval->funcs = shared->funcs;
+      retval->opaque = shared->opaque;
+      retval->shared = shared;
+      retval->scheduler = retainScheduler(shared->scheduler);
+      shared->refs++;
+      registeredArchiver(shared->funcs)->dirHandles.fetch_add(1, std::memory_order_relaxed);
+   }
+
+   __PHYSFS_platformReleaseMutex(sharedLock);
+   return retval;
+}
+
+///                                                                           
+/// Offer the archive (dh) just parsed from the file (id) to later mounts.    
+/// Running out of anything here only means it isn't shared                   
+///                                                                           
+static void shareArchive(DirHandle* dh, const ArchiveIdentity& id) {
+   if (dh->funcs == &__PHYSFS_Archiver_DIR)
+      return;
+
+   auto shared = PHYSFS_Allocator<SharedArchive>(1).Ref();
+   if (not shared)
+      return;
+
+   auto path = static_cast<char*>(allocator.Malloc(strlen(id.path) + 1));
+   void* lock = nullptr;
+   try { lock = __PHYSFS_platformCreateMutex(); }
+   catch (...) {}
+
+   if (not path or not lock) {
+      if (lock)
+         __PHYSFS_platformDestroyMutex(lock);
+      allocator.Free(path);
+      PHYSFS_Allocator<>::Free(shared);
+      return;
+   }
+
+   strcpy(path, id.path);
+   shared->id = id;
+   shared->id.path = path;
+   shared->funcs = dh->funcs;
+   shared->opaque = dh->opaque;
+   shared->lock = lock;
+   shared->refs = 1;
+
+   __PHYSFS_platformGrabMutex(sharedLock);
+   // Someone mounting the same file at the same time may have won      
+   auto other = sharedArchives;
+   while (other and not sameArchive(other->id, id))
+      other = other->next;
+
+   if (not other) {
+      shared->scheduler = retainScheduler(dh->scheduler);
+      shared->next = sharedArchives;
+      sharedArchives = shared;
+      dh->shared = shared;
+   }
+   __PHYSFS_platformReleaseMutex(sharedLock);
+
+   if (other) {
+      __PHYSFS_platformDestroyMutex(lock);
+      allocator.Free(path);
+      PHYSFS_Allocator<>::Free(shared);
+   }
+}
+
+///                                                                           
+/// Close the archiver instance behind (dh), unless other DirHandles still    
+/// share it                                                                  
+///                                                                           
+static void closeDirHandleArchive(DirHandle* dh) {
+   if (dh->funcs != &__PHYSFS_Archiver_DIR)
+      registeredArchiver(dh->funcs)->dirHandles.fetch_sub(1, std::memory_order_release);
+   releaseScheduler(dh->scheduler);
+   dh->scheduler = nullptr;
+
+   auto shared = dh->shared;
+   if (not shared) {
+      dh->funcs->closeArchive(dh->opaque);
+      if (dh->lock)
+         __PHYSFS_platformDestroyMutex(dh->lock);
+      return;
+   }
+
+   __PHYSFS_platformGrabMutex(sharedLock);
+   const bool last = --shared->refs == 0;
+   if (last) {
+      auto link = &sharedArchives;
+      while (*link != shared)
+         link = &(*link)->next;
+      *link = shared->next;
+   }
+   __PHYSFS_platformReleaseMutex(sharedLock);
+
+   if (last) {
+      shared->funcs->closeArchive(shared->opaque);
+      releaseScheduler(shared->scheduler);
+      __PHYSFS_platformDestroyMutex(shared->lock);
+      allocator.Free(const_cast<char*>(shared->id.path));
+      PHYSFS_Allocator<>::Free(shared);
+   }
+}
+
+/// Archiver calls that read through a mounted DirHandle, under its shared    
+/// archive's lock                                                            
+static int archiveStat(const DirHandle* dh, const char* name, PHYSFS_Stat* st) {
+   ArchiveLock lock {dh};
+   return dh->funcs->stat(dh->opaque, name, st);
+}
+
+/// Whether (dh)'s archiver opens files safely on any number of threads at    
+/// once, so that no lock needs to be held around its openRead                
+static bool concurrentOpenRead(const DirHandle* dh) {
+   return dh->funcs->version >= 2 and dh->funcs->concurrentOpenRead;
+}
+
+static PHYSFS_Io* archiveOpenRead(const DirHandle* dh, const char* name) {
+   if (concurrentOpenRead(dh))
+      return dh->funcs->openRead(dh->opaque, name);
+
+   ArchiveLock lock {dh};
+   return dh->funcs->openRead(dh->opaque, name);
+}
+
+static DirHandle* openDirectory(PHYSFS_Io*, const char*, int, IoScheduler*);
+static int freeDirHandle(DirHandle*);
+static bool recoverCommit(DirHandle*);
+
+/// Stat (path) in the physical filesystem. The platform layer may throw for  
+/// a missing file instead of failing quietly; here that only means there's   
+/// nothing at (path), same as verifyPath treats it                           
+///   @return true if (path) exists                                           
+static bool statPhysical(const char* path, PHYSFS_Stat* statbuf) {
+   try { return __PHYSFS_platformStat(path, statbuf, 1) != 0; }
+   catch (const MetaPhysFS::Exception<PHYSFS_ERR_NOT_FOUND>&) {
+      return false;
+   }
+}
+
+///                                                                           
+/// Give an entry of a nested archive an io that seeks as cheaply as a file.  
+/// Ios with a readAt are plain windows onto their container already (stored  
+/// ZIP entries, the legacy formats, 7z's decoded buffers), so they're used   
+/// as they are. Anything else is a decoder that would restart on every       
+/// backward seek, so it's decoded once, into memory. If that much memory     
+/// can't be had, the slow io still works, so it's kept                       
+///   @return the io to use, or nullptr if decoding failed                    
+///                                                                           
+static PHYSFS_Io* nestedIo(PHYSFS_Io* io) {
+   if (__PHYSFS_ioCanReadAt(io))
+      return io;
+
+   const auto length = io->length(io);
+   if (length < 0 or PHYSFS_uint64(length) > SIZE_MAX)
+      return io;
+
+   const auto len = static_cast<size_t>(length);
+   auto buf = allocator.Malloc(len ? len : 1, PHYSFS_ALLOC_CACHE);
+   if (not buf)
+      return io;
+
+   if (not io->seek(io, 0) or not __PHYSFS_readAll(io, buf, len)) {
+      allocator.Free(buf);
+      return nullptr;
+   }
+
+   auto retval = __PHYSFS_createMemoryIo(buf, len, allocator.Free);
+   if (not retval) {
+      allocator.Free(buf);
+      return io;
+   }
+
+   io->destroy(io);
+   return retval;
+}
+
+/// Open the archive at (name) inside (outer), which becomes its parent       
+static DirHandle* openNestedArchive(DirHandle* outer, const char* name) {
+   auto io = archiveOpenRead(outer, name);
+   BAIL_IF_ERRPASS(not io, nullptr);
+
+   PHYSFS_Io* fast = nullptr;
+   DirHandle* retval = nullptr;
+   try {
+      fast = nestedIo(io);
+      if (fast)
+         retval = openDirectory(fast, name, 0, nullptr);
+   }
+   catch (...) {
+      (fast ? fast : io)->destroy(fast ? fast : io);
+      throw;
+   }
+
+   if (not retval) {
+      (fast ? fast : io)->destroy(fast ? fast : io);
+      return nullptr;
+   }
+
+   // Its reads are its parent's, so they queue where those do         
+   retval->parent = outer;
+   retval->scheduler = retainScheduler(outer->scheduler);
+   return retval;
+}
+
+///                                                                           
+/// Walk (path) down to the innermost archive. (current) is always the        
+/// innermost archive opened so far, for the caller to clean up on failure.   
+/// The outermost one's reads go through (scheduler), if there is one         
+///                                                                           
+static bool openNestedChain(char* path, DirHandle*& current, IoScheduler* scheduler) {
+   const char sep = __PHYSFS_platformDirSeparator;
+
+   // Find the outermost archive, the first prefix that isn't a         
+   // directory. Not finding one means the path simply isn't there      
+   PHYSFS_Stat statbuf;
+   char* end = path;
+   while (not current) {
+      end = strchr(end + 1, sep);
+      BAIL_IF(not end or not end[1], PHYSFS_ERR_NOT_FOUND, false);
+
+      *end = '\0';
+      BAIL_IF(not statPhysical(path, &statbuf), PHYSFS_ERR_NOT_FOUND, false);
+      if (statbuf.filetype != PHYSFS_FILETYPE_DIRECTORY) {
+         current = openDirectory(nullptr, path, 0, scheduler);
+         BAIL_IF_ERRPASS(not current, false);
+      }
+      *end = sep;
+   }
+
+   // The rest is inside archives, so in platform-independent notation. 
+   // Walk it down, opening every regular file on the way               
+   char* name = end + 1;
+   for (char* p = name; *p; ++p) {
+      if (*p == sep)
+         *p = '/';
+   }
+
+   char* component = name;
+   while (true) {
+      char* slash = strchr(component, '/');
+      if (slash)
+         *slash = '\0';
+
+      BAIL_IF_ERRPASS(not archiveStat(current, name, &statbuf), false);
+      if (statbuf.filetype == PHYSFS_FILETYPE_DIRECTORY) {
+         // Mounting a directory inside an archive isn't a thing        
+         BAIL_IF(not slash, PHYSFS_ERR_NOT_A_FILE, false);
+         *slash = '/';
+         component = slash + 1;
+         continue;
+      }
+
+      auto inner = openNestedArchive(current, name);
+      BAIL_IF_ERRPASS(not inner, false);
+      current = inner;
+      if (not slash)
+         return true;
+      name = component = slash + 1;
+   }
+}
+
+///                                                                           
+/// Open a path like "mods/outer.zip/sub/inner.zip/data.pak", where the first 
+/// regular file is an archive in the physical filesystem, and each regular   
+/// file after it is an archive inside the previous one. Only the outermost   
+/// one is opened by name; every other one is read through its parent, which  
+/// it keeps open for as long as it lives                                     
+///                                                                           
+static DirHandle* openNestedDirectory(const char* d, IoScheduler* scheduler) {
+   auto path = static_cast<char*>(allocator.Malloc(strlen(d) + 1));
+   BAIL_IF(not path, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+   strcpy(path, d);
+
+   DirHandle* current = nullptr;
+   bool ok;
+   try { ok = openNestedChain(path, current, scheduler); }
+   catch (...) {
+      freeDirHandle(current);
+      allocator.Free(path);
+      throw;
+   }
+
+   if (not ok) {
+      freeDirHandle(current);
+      current = nullptr;
+   }
+
+   allocator.Free(path);
+   return current;
+}
+
+/// Open directory. If there's a (scheduler), the reads of a directory, or of  
+/// an archive file this opens itself, go through it                          
+static DirHandle* openDirectory(PHYSFS_Io* io, const char* d, int forWriting, IoScheduler* scheduler) {
+   assert(io or d);
+   DirHandle* retval = nullptr;
+   int created_io = 0;
+   int created_file = 0;
+   int claimed = 0;
+   auto ext = find_filename_extension(d);
+   ArchiveIdentity id {};
+   bool shareable = false;
+
+   if (not io) {
+      // File doesn't exist? It might be an archive inside an archive,  
+      // otherwise just fail out                                        
+      PHYSFS_Stat statbuf;
+      if (not statPhysical(d, &statbuf)) {
+         if (not forWriting)
+            return openNestedDirectory(d, scheduler);
+
+         // A write dir that doesn't exist yet can still be an archive, 
+         // if its extension names one: writable archivers start an     
+         // empty file, the rest turn it down and it's removed again    
+         bool known = false;
+         for (auto i = archivers; ext and *i and not known; i++)
+            known = PHYSFS_utf8stricmp(ext, (*i)->info.extension) == 0;
+         BAIL_IF(not known, PHYSFS_ERR_NOT_FOUND, nullptr);
+         created_file = 1;
+      }
+      else if (statbuf.filetype == PHYSFS_FILETYPE_DIRECTORY) {
+         // DIR gets first shot (unlike the rest, it doesn't deal with  
+         // files)                                                      
+         retval = tryOpenDir(io, &__PHYSFS_Archiver_DIR, d, forWriting, &claimed);
+         if (retval)
+            retval->scheduler = retainScheduler(scheduler);
+         if (retval or claimed)
+            return retval;
+      }
+      else if (not forWriting and statbuf.filetype == PHYSFS_FILETYPE_REGULAR) {
+         // Mounted already, maybe in another context? Then there's no  
+         // need to parse it all over again                             
+         id = identifyArchive(d, statbuf);
+         retval = openSharedArchive(id);
+         if (retval) {
+            retval->physical = true;
+            return retval;
+         }
+         shareable = true;
+      }
+
+      // Archives opened for writing are appended to, never truncated   
+      io = __PHYSFS_createNativeIo(d, forWriting ? 'a' : 'r');
+      BAIL_IF_ERRPASS(not io, nullptr);
+      created_io = 1;
+
+      if (scheduler) {
+         PHYSFS_Io* scheduled;
+         try { scheduled = scheduleIo(io, scheduler); }
+         catch (...) {
+            io->destroy(io);
+            throw;
+         }
+         if (not scheduled) {
+            io->destroy(io);
+            return nullptr;
+         }
+         io = scheduled;
+      }
+   }
+   else
+      scheduler = nullptr;
+
+   if (ext) {
+      // Look for archivers with matching file extensions first...      
+      for (auto i = archivers; *i and not retval and not claimed; i++) {
+         if (PHYSFS_utf8stricmp(ext, (*i)->info.extension) == 0)
+            retval = tryOpenDir(io, *i, d, forWriting, &claimed);
+      }
+
+      // Failing an exact file extension match, try all the others...   
+      for (auto i = archivers; *i and not retval and not claimed; i++) {
+         if (PHYSFS_utf8stricmp(ext, (*i)->info.extension) != 0)
+            retval = tryOpenDir(io, *i, d, forWriting, &claimed);
+      }
+   }
+   else {
+      // No extension? Gotta try them all!                              
+      for (auto i = archivers; *i and not retval and not claimed; i++)
+         retval = tryOpenDir(io, *i, d, forWriting, &claimed);
+   }
+
+   if (not retval and created_io) {
+      io->destroy(io);
+      if (created_file)
+         __PHYSFS_platformDelete(d);
+   }
+
+   BAIL_IF(not retval, PHYSFS_ERR_UNSUPPORTED, nullptr);
+   retval->scheduler = retainScheduler(scheduler);
+   retval->physical = created_io;
+   if (shareable)
+      shareArchive(retval, id);
+   return retval;
+}
+
+///                                                                           
+/// Make a platform-independent path string sane. Doesn't actually check the  
+/// file hierarchy, it just cleans up the string.                             
+/// (dst) must be a buffer at least as big as (src), as this is where the     
+/// cleaned up string is deposited.                                           
+/// If there are illegal bits in the path (".." entries, etc) then we         
+/// return zero and (dst) is undefined. Non-zero if the path was sanitized.   
+///                                                                           
+static int sanitizePlatformIndependentPath(const char* src, char* dst) {
+   char* prev;
+   char ch;
+
+   // Skip initial '/' chars...                                         
+   while (*src == '/')
+      src++;
+
+   // Make sure the entire string isn't "." or ".."                     
+   if (strcmp(src, ".") == 0 or strcmp(src, "..") == 0)
+      BAIL(PHYSFS_ERR_BAD_FILENAME, 0);
+
+   prev = dst;
+   do {
+      ch = *(src++);
+
+      if (ch == ':' or ch == '\\') {
+         // Illegal chars in a physfs path                              
+         BAIL(PHYSFS_ERR_BAD_FILENAME, 0);
+      }
+
+      if (ch == '/') {
+         // Path separator                                              
+         *dst = '\0';
+
+         // "." and ".." are illegal pathnames                          
+         if (strcmp(prev, ".") == 0 or strcmp(prev, "..") == 0)
+            BAIL(PHYSFS_ERR_BAD_FILENAME, 0);
+
+         // Chop out doubles...                                         
+         while (*src == '/')
+            src++;
+
+         // Ends with a pathsep?                                        
+         if (not *src)
+            break;  // We're done, don't add final pathsep to dst       
+
+         prev = dst + 1;
+      }
+
+      *(dst++) = ch;
+   }
+   while (ch);
+
+   return 1;
+}
+
+static inline size_t dirHandleRootLen(const DirHandle* h) {
+   return h ? h->rootlen : 0;
+}
+
+static inline int sanitizePlatformIndependentPathWithRoot(
+   const DirHandle* h, const char* src, char* dst
+) {
+   return sanitizePlatformIndependentPath(src, dst + dirHandleRootLen(h));
+}
+
+///                                                                           
+/// Figure out if (fname) is part of (h)'s mountpoint. (fname) must be an     
+/// output from sanitizePlatformIndependentPath(), so that it is in a known   
+/// state.                                                                    
+///                                                                           
+/// This only finds legitimate segments of a mountpoint. If the mountpoint is 
+/// "/a/b/c" and (fname) is "/a/b/c", "/", or "/a/b/c/d", then the results are
+/// all zero. "/a/b" will succeed, though.                                    
+///                                                                           
+static int partOfMountPoint(DirHandle* h, char* fname) {
+   if (h->mountPoint == nullptr)
+      return 0;
+   else if (*fname == '\0')
+      return 1;
+
+   size_t len = strlen(fname);
+   size_t mntpntlen = strlen(h->mountPoint);
+   if (len > mntpntlen)  // Can't be a subset of mountpoint             
+      return 0;
+
+   // If true, must be not a match or a complete match, but not a subset
+   if ((len + 1) == mntpntlen)
+      return 0;
+
+   // !!! FIXME: case insensitive? 
+   int rc = strncmp(fname, h->mountPoint, len);
+   if (rc != 0)
+      return 0;         // Not a match                                  
+
+   // Make sure /a/b matches /a/b/ and not /a/bc ...                    
+   return h->mountPoint[len] == '/';
+}
+
+///                                                                           
+static DirHandle* createDirHandle(
+   PHYSFS_Io* io, const char* newDir,
+   const char* mountPoint, int forWriting
+) {
+   auto& context = ctx();
+   DirHandle* dirHandle = nullptr;
+   IoScheduler* scheduler = nullptr;
+   char* tmpmntpnt = nullptr;
+
+   assert(newDir);  /* should have caught this higher up. */
+
+#ifndef PHYSFS_NO_THREADS
+   // Other contexts probe at the same time; only (de)registering waits 
+   std::shared_lock probing {archiverLock};
+#endif
+
+   if (mountPoint) {
+      const size_t len = strlen(mountPoint) + 1;
+      tmpmntpnt = (char*) __PHYSFS_smallAlloc(len);
+      GOTO_IF(!tmpmntpnt, PHYSFS_ERR_OUT_OF_MEMORY, badDirHandle);
+      if (!sanitizePlatformIndependentPath(mountPoint, tmpmntpnt))
+         goto badDirHandle;
+      mountPoint = tmpmntpnt;  /* sanitized version. */
+   }
+
+   // Each mount gets a scheduler of its own, that the DirHandle keeps  
+   // if anything it reads goes through it                              
+   if (not forWriting and context.ioScheduled) {
+      try { scheduler = createScheduler(&context.ioSchedule); }
+      catch (...) {
+         __PHYSFS_smallFree(tmpmntpnt);
+         throw;
+      }
+      GOTO_IF_ERRPASS(!scheduler, badDirHandle);
+   }
+
+   try { dirHandle = openDirectory(io, newDir, forWriting, scheduler); }
+   catch (...) {
+      releaseScheduler(scheduler);
+      __PHYSFS_smallFree(tmpmntpnt);
+      throw;
+   }
+   releaseScheduler(scheduler);
+   scheduler = nullptr;
+   GOTO_IF_ERRPASS(!dirHandle, badDirHandle);
+
+   // An archive of its own still gets a lock, so that its listings can 
+   // be read without stateLock                                         
+   if (not dirHandle->shared and dirHandle->funcs != &__PHYSFS_Archiver_DIR) {
+      try { dirHandle->lock = __PHYSFS_platformCreateMutex(); }
+      catch (...) {
+         closeDirHandleArchive(dirHandle);
+         freeDirHandle(dirHandle->parent);
+         PHYSFS_Allocator<>::Free(dirHandle);
+         __PHYSFS_smallFree(tmpmntpnt);
+         throw;
+      }
+      GOTO_IF_ERRPASS(!dirHandle->lock, badDirHandle);
+   }
+
+   dirHandle->dirName = (char*) allocator.Malloc(strlen(newDir) + 1);
+   GOTO_IF(!dirHandle->dirName, PHYSFS_ERR_OUT_OF_MEMORY, badDirHandle);
+   strcpy(dirHandle->dirName, newDir);
+
+   if ((mountPoint != nullptr) && (*mountPoint != '\0')) {
+      dirHandle->mountPoint = (char*) allocator.Malloc(strlen(mountPoint) + 2);
+      if (!dirHandle->mountPoint)
+         GOTO(PHYSFS_ERR_OUT_OF_MEMORY, badDirHandle);
+      strcpy(dirHandle->mountPoint, mountPoint);
+      strcat(dirHandle->mountPoint, "/");
+   }
+
+   __PHYSFS_smallFree(tmpmntpnt);
+   return dirHandle;
+
+badDirHandle:
+   releaseScheduler(scheduler);
+   if (dirHandle != nullptr) {
+      closeDirHandleArchive(dirHandle);
+      freeDirHandle(dirHandle->parent);
+      PHYSFS_Allocator<>::Free(dirHandle->dirName);
+      PHYSFS_Allocator<>::Free(dirHandle->mountPoint);
+      PHYSFS_Allocator<>::Free(dirHandle);
+   }
+
+   __PHYSFS_smallFree(tmpmntpnt);
+   return nullptr;
+}
+
+/// MAKE SURE you've got the stateLock held before calling this!              
+static int freeDirHandle(DirHandle* dh) {
+   if (not dh)
+      return 1;
+
+   // Opens raise this under stateLock, so it can't go up behind our back
+   BAIL_IF(dh->openFiles != 0, PHYSFS_ERR_FILES_STILL_OPEN, 0);
+
+   closeDirHandleArchive(dh);
+   freeDirHandle(dh->parent);
+
+   if (dh->root)
+      PHYSFS_Allocator<>::Free(dh->root);
+   PHYSFS_Allocator<>::Free(dh->dirName);
+   PHYSFS_Allocator<>::Free(dh->mountPoint);
+   PHYSFS_Allocator<>::Free(dh);
+   return 1;
+}
+
+///                                                                           
+static char* calculateBaseDir(const char* argv0) {
+   const char dirsep = __PHYSFS_platformDirSeparator;
+   char* retval = nullptr;
+   char* ptr = nullptr;
+
+   // Give the platform layer first shot at this                        
+   retval = __PHYSFS_platformCalcBaseDir(argv0);
+   if (retval)
+      return retval;
+
+   // We need argv0 to go on                                            
+   BAIL_IF(not argv0, PHYSFS_ERR_ARGV0_IS_NULL, nullptr);
+
+   ptr = strrchr(argv0, dirsep);
+   if (ptr) {
+      const size_t size = ((size_t) (ptr - argv0)) + 1;
+      retval = (char*) allocator.Malloc(size + 1);
+      BAIL_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+      memcpy(retval, argv0, size);
+      retval[size] = '\0';
+      return retval;
+   }
+
+   // argv0 wasn't helpful                                              
+   BAIL(PHYSFS_ERR_INVALID_ARGUMENT, nullptr);
+}
+
+/// Create the locks of a context                                             
+static int initContextLocks(PHYSFS_Context& context) {
+   context.stateLock = __PHYSFS_platformCreateMutex();
+   context.fileLock = __PHYSFS_platformCreateMutex();
+   if (context.stateLock and context.fileLock)
+      return 1;
+
+   if (context.stateLock)
+      __PHYSFS_platformDestroyMutex(context.stateLock);
+   if (context.fileLock)
+      __PHYSFS_platformDestroyMutex(context.fileLock);
+   context.stateLock = context.fileLock = nullptr;
+   return 0;
+}
+
+/// Destroy the locks of a context, once nothing can take them anymore        
+static void freeContextLocks(PHYSFS_Context& context) {
+   if (context.stateLock)
+      __PHYSFS_platformDestroyMutex(context.stateLock);
+   if (context.fileLock)
+      __PHYSFS_platformDestroyMutex(context.fileLock);
+   context.stateLock = context.fileLock = nullptr;
+}
+
+///                                                                           
+static int initializeMutexes(void) {
+   errorLock = __PHYSFS_platformCreateMutex();
+   if (errorLock == nullptr)
+      goto initializeMutexes_failed;
+
+   if (not initContextLocks(defaultContext))
+      goto initializeMutexes_failed;
+
+   cacheLock = __PHYSFS_platformCreateMutex();
+   if (cacheLock == nullptr)
+      goto initializeMutexes_failed;
+
+   contextLock = __PHYSFS_platformCreateMutex();
+   if (contextLock == nullptr)
+      goto initializeMutexes_failed;
+
+   sharedLock = __PHYSFS_platformCreateMutex();
+   if (sharedLock == nullptr)
+      goto initializeMutexes_failed;
+
+#ifndef PHYSFS_NO_THREADS
+   commitLock = __PHYSFS_platformCreateMutex();
+   if (commitLock == nullptr)
+      goto initializeMutexes_failed;
+
+   try { commitDone = __PHYSFS_platformCreateCond(); }
+   catch (...) {}
+   if (commitDone == nullptr)
+      goto initializeMutexes_failed;
+
+   asyncLock = __PHYSFS_platformCreateMutex();
+   if (asyncLock == nullptr)
+      goto initializeMutexes_failed;
+
+   try { asyncWake = __PHYSFS_platformCreateCond(); }
+   catch (...) {}
+   if (asyncWake == nullptr)
+      goto initializeMutexes_failed;
+
+   asyncStop = __PHYSFS_platformCreateMutex();
+   if (asyncStop == nullptr)
+      goto initializeMutexes_failed;
+#endif
+
+   // Success                                                           
+   return 1;
+
+initializeMutexes_failed:
+   if (errorLock != nullptr)
+      __PHYSFS_platformDestroyMutex(errorLock);
+
+   freeContextLocks(defaultContext);
+
+   if (cacheLock != nullptr)
+      __PHYSFS_platformDestroyMutex(cacheLock);
+
+   if (contextLock != nullptr)
+      __PHYSFS_platformDestroyMutex(contextLock);
+
+   if (sharedLock != nullptr)
+      __PHYSFS_platformDestroyMutex(sharedLock);
+
+#ifndef PHYSFS_NO_THREADS
+   if (commitLock != nullptr)
+      __PHYSFS_platformDestroyMutex(commitLock);
+   if (commitDone != nullptr)
+      __PHYSFS_platformDestroyCond(commitDone);
+   if (asyncLock != nullptr)
+      __PHYSFS_platformDestroyMutex(asyncLock);
+   if (asyncWake != nullptr)
+      __PHYSFS_platformDestroyCond(asyncWake);
+   commitLock = commitDone = asyncLock = asyncWake = nullptr;
+#endif
+
+   // Fail                                                              
+   errorLock = cacheLock = contextLock = sharedLock = nullptr;
+   return 0;
+}
+
+
+static int doRegisterArchiver(const PHYSFS_Archiver*);
+
+static int initStaticArchivers(void) {
+   #define REGISTER_STATIC_ARCHIVER(arc) { \
+      if (not doRegisterArchiver(&__PHYSFS_Archiver_##arc)) \
+         return 0; \
+    }
+
+   #if PHYSFS_SUPPORTS_ZIP
+      REGISTER_STATIC_ARCHIVER(ZIP);
+   #endif
+   #if PHYSFS_SUPPORTS_7Z
+      SZIP_global_init();
+      REGISTER_STATIC_ARCHIVER(7Z);
+   #endif
+   #if PHYSFS_SUPPORTS_GRP
+      REGISTER_STATIC_ARCHIVER(GRP);
+   #endif
+   #if PHYSFS_SUPPORTS_QPAK
+      REGISTER_STATIC_ARCHIVER(QPAK);
+   #endif
+   #if PHYSFS_SUPPORTS_HOG
+      REGISTER_STATIC_ARCHIVER(HOG);
+   #endif
+   #if PHYSFS_SUPPORTS_MVL
+      REGISTER_STATIC_ARCHIVER(MVL);
+   #endif
+   #if PHYSFS_SUPPORTS_WAD
+      REGISTER_STATIC_ARCHIVER(WAD);
+   #endif
+   #if PHYSFS_SUPPORTS_CSM
+      REGISTER_STATIC_ARCHIVER(CSM);
+   #endif
+   #if PHYSFS_SUPPORTS_SLB
+      REGISTER_STATIC_ARCHIVER(SLB);
+   #endif
+   #if PHYSFS_SUPPORTS_ISO9660
+      REGISTER_STATIC_ARCHIVER(ISO9660);
+   #endif
+   #if PHYSFS_SUPPORTS_VDF
+      REGISTER_STATIC_ARCHIVER(VDF);
+   #endif
+   #if PHYSFS_SUPPORTS_MPK
+      REGISTER_STATIC_ARCHIVER(MPK);
+   #endif
+   #if PHYSFS_SUPPORTS_MPL
+      REGISTER_STATIC_ARCHIVER(MPL);
+   #endif
+
+   #undef REGISTER_STATIC_ARCHIVER
+   return 1;
+}
+
+
+static int  doDeinit(void);
+#ifndef PHYSFS_NO_THREADS
+   namespace
+   {
+      void stopAsync();
+      bool onAsyncThread() noexcept;
+   }
+#endif
+
+int PHYSFS_init(const char* argv0) {
+   BAIL_IF(initialized, PHYSFS_ERR_IS_INITIALIZED, 0);
+   if (not __PHYSFS_platformInit(argv0))
+      return 0;
+
+   // The platform may have supplied the default allocator just now     
+   if (allocCallbacks.Init and not allocCallbacks.Init(allocCallbacks.userdata)) {
+      __PHYSFS_platformDeinit();
+      return 0;
+   }
+
+   // Everything below here can be cleaned up safely by doDeinit()      
+   if (not initializeMutexes())
+      goto initFailed;
+
+   baseDir = calculateBaseDir(argv0);
+   if (not baseDir)
+      goto initFailed;
+
+   userDir = __PHYSFS_platformCalcUserDir();
+   if (not userDir)
+      goto initFailed;
+
+   // Platform layer is required to append a dirsep                     
+   #ifndef __ANDROID__  // It's an APK file, not a directory on Android 
+      assert(baseDir[strlen(baseDir) - 1] == __PHYSFS_platformDirSeparator);
+   #endif
+
+   assert(userDir[strlen(userDir) - 1] == __PHYSFS_platformDirSeparator);
+
+   if (not initStaticArchivers())
+      goto initFailed;
+
+   initialized = 1;
+
+   // This makes sure that the error subsystem is initialized           
+   PHYSFS_setErrorCode(PHYSFS_getLastErrorCode());
+   return 1;
+
+initFailed:
+   doDeinit();
+   return 0;
+}
+
+/// MAKE SURE you hold the context's stateLock before calling this!           
+static int closeFileHandleList(PHYSFS_Context& context, FileHandle** list) {
+   __PHYSFS_platformGrabMutex(context.fileLock);
+
+   // Always pop the head: destroying a handle-backed io closes another 
+   // handle, which may unlink itself from this very list               
+   while (*list) {
+      auto i = *list;
+      auto io = i->io;
+      if (io->flush and not io->flush(io)) {
+         __PHYSFS_platformReleaseMutex(context.fileLock);
+         return 0;
+      }
+
+      unregisterFileHandle(i);
+      io->destroy(io);
+      __PHYSFS_ATOMIC_DECR(&i->dirHandle->openFiles);
+      PHYSFS_Allocator<>::Free(i);
+   }
+
+   __PHYSFS_platformReleaseMutex(context.fileLock);
+   return 1;
+}
+
+/// MAKE SURE you hold the context's stateLock before calling this!           
+static void freeSearchPath(PHYSFS_Context& context) {
+   closeFileHandleList(context, &context.openReadList);
+
+   if (context.searchPath) {
+      DirHandle* next = nullptr;
+      for (auto i = context.searchPath; i; i = next) {
+         next = i->next;
+         freeDirHandle(i);
+      }
+
+      context.searchPath = nullptr;
+   }
+}
+
+/// Close everything a context has open, and unmount all of it. Its locks     
+/// are left alone                                                            
+static int closeContext(PHYSFS_Context& context) {
+   __PHYSFS_platformGrabMutex(context.stateLock);
+   closeFileHandleList(context, &context.openWriteList);
+   if (context.writeDir) {
+      // Pinned by a transaction, which only its owner can end          
+      BAIL_IF_MUTEX(context.writeDir->openFiles != 0,
+         PHYSFS_ERR_FILES_STILL_OPEN, context.stateLock, 0);
+      freeDirHandle(context.writeDir);
+      context.writeDir = nullptr;
+   }
+
+   freeSearchPath(context);
+   context.longest_root = 0;
+   context.allowSymLinks = 0;
+   context.ioScheduled = false;
+   context.ioSchedule = {};
+   context.inlineMaxFileSize.store(0, std::memory_order_relaxed);
+   context.inlineMaxBytes.store(0, std::memory_order_relaxed);
+#if PHYSFS_HAVE_READ_AHEAD
+   context.readAheadMinSize.store(PHYSFS_Context::DefaultReadAheadMinSize, std::memory_order_relaxed);
+#endif
+   __PHYSFS_platformReleaseMutex(context.stateLock);
+   return 1;
+}
+
+/// MAKE SURE you hold archiverLock exclusively before calling this!          
+static int doDeregisterArchiver(const size_t idx) {
+   const size_t len = (numArchivers - idx) * sizeof(void*);
+   auto info = archiveInfo[idx];
+   auto arc = registeredArchiver(archivers[idx]);
+
+   // Make sure nothing, in any context, is still using this archiver   
+   if (arc->dirHandles.load(std::memory_order_acquire) != 0)
+      BAIL(PHYSFS_ERR_FILES_STILL_OPEN, 0);
+
+   PHYSFS_Allocator<>::Free((void*) info->extension);
+   PHYSFS_Allocator<>::Free((void*) info->description);
+   PHYSFS_Allocator<>::Free((void*) info->author);
+   PHYSFS_Allocator<>::Free((void*) info->url);
+   PHYSFS_Allocator<>::Free((void*) arc);
+
+   memmove(&archiveInfo[idx], &archiveInfo[idx + 1], len);
+   memmove(&archivers[idx], &archivers[idx + 1], len);
+
+   assert(numArchivers > 0);
+   numArchivers--;
+
+   return 1;
+}
+
+/// Does NOT hold the state lock; we're shutting down                         
+static void freeArchivers(void) {
+   while (numArchivers > 0) {
+      if (not doDeregisterArchiver(numArchivers - 1))
+         assert(not "nothing should be mounted during shutdown.");
+   }
+
+   PHYSFS_Allocator<>::Free(archivers);
+   PHYSFS_Allocator<>::Free(archiveInfo);
+   archivers = nullptr;
+   archiveInfo = nullptr;
+}
+
+///                                                                           
+static int doDeinit(void) {
+#ifndef PHYSFS_NO_THREADS
+   stopAsync();
+#endif
+   // Contexts that weren't destroyed go down with the library          
+   while (contexts) {
+      BAIL_IF(not closeContext(*contexts), PHYSFS_ERR_FILES_STILL_OPEN, 0);
+      auto next = contexts->next;
+      freeContextLocks(*contexts);
+      contexts->~PHYSFS_Context();
+      allocator.Free(contexts);
+      contexts = next;
+   }
+
+   if (defaultContext.stateLock)
+      BAIL_IF(not closeContext(defaultContext), PHYSFS_ERR_FILES_STILL_OPEN, 0);
+
+   freeArchivers();
+   freeErrorStates();
+   freeIoCache();
+
+   if (baseDir) {
+      PHYSFS_Allocator<>::Free(baseDir);
+      baseDir = nullptr;
+   }
+
+   if (userDir) {
+      PHYSFS_Allocator<>::Free(userDir);
+      userDir = nullptr;
+   }
+
+   if (prefDir) {
+      PHYSFS_Allocator<>::Free(prefDir);
+      prefDir = nullptr;
+   }
+
+   if (archiveInfo) {
+      PHYSFS_Allocator<>::Free(archiveInfo);
+      archiveInfo = nullptr;
+   }
+
+   if (archivers) {
+      PHYSFS_Allocator<>::Free(archivers);
+      archivers = nullptr;
+   }
+
+   initialized = 0;
+
+   if (errorLock)
+      __PHYSFS_platformDestroyMutex(errorLock);
+
+   freeContextLocks(defaultContext);
+
+   if (cacheLock)
+      __PHYSFS_platformDestroyMutex(cacheLock);
+
+   if (contextLock)
+      __PHYSFS_platformDestroyMutex(contextLock);
+
+   // Every DirHandle is gone, and the registry went empty with the last
+   assert(sharedArchives == nullptr);
+   if (sharedLock)
+      __PHYSFS_platformDestroyMutex(sharedLock);
+
+#ifndef PHYSFS_NO_THREADS
+   __PHYSFS_platformDestroyCond(commitDone);
+   __PHYSFS_platformDestroyMutex(commitLock);
+   __PHYSFS_platformDestroyCond(asyncWake);
+   __PHYSFS_platformDestroyMutex(asyncLock);
+   __PHYSFS_platformDestroyMutex(asyncStop);
+   commitLock = commitDone = nullptr;
+   asyncLock = asyncWake = asyncStop = nullptr;
+#endif
+
+   errorLock = cacheLock = contextLock = sharedLock = nullptr;
+
+   __PHYSFS_platformDeinit();
+
+   if (allocCallbacks.Deinit)
+      allocCallbacks.Deinit(allocCallbacks.userdata);
+   return 1;
+}
+
+///                                                                           
+int PHYSFS_deinit() {
+   BAIL_IF(not initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+#ifndef PHYSFS_NO_THREADS
+   // Deinit joins the async threads, so it can't run on one of them    
+   BAIL_IF(onAsyncThread(), PHYSFS_ERR_BUSY, 0);
+#endif
+   return doDeinit();
+}
+
+///                                                                           
+int PHYSFS_isInit() {
+   return initialized;
+}
+
+///                                                                           
+PHYSFS_Context* PHYSFS_createContext(void) {
+   BAIL_IF(not initialized, PHYSFS_ERR_NOT_INITIALIZED, nullptr);
+   auto context = static_cast<PHYSFS_Context*>(allocator.Malloc(sizeof(PHYSFS_Context)));
+   BAIL_IF(not context, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+
+   new (context) PHYSFS_Context {};
+   if (not initContextLocks(*context)) {
+      context->~PHYSFS_Context();
+      allocator.Free(context);
+      BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+   }
+
+   __PHYSFS_platformGrabMutex(contextLock);
+   context->next = contexts;
+   contexts = context;
+   __PHYSFS_platformReleaseMutex(contextLock);
+   return context;
+}
+
+///                                                                           
+int PHYSFS_destroyContext(PHYSFS_Context* context) {
+   BAIL_IF(not initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+   BAIL_IF(not context or context == &defaultContext, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+   __PHYSFS_platformGrabMutex(contextLock);
+   auto link = &contexts;
+   while (*link and *link != context)
+      link = &(*link)->next;
+   BAIL_IF_MUTEX(not *link, PHYSFS_ERR_INVALID_ARGUMENT, contextLock, 0);
+   __PHYSFS_platformReleaseMutex(contextLock);
+
+   BAIL_IF(not closeContext(*context), PHYSFS_ERR_FILES_STILL_OPEN, 0);
+
+   // Look it up again: another one may have gone in the meantime       
+   __PHYSFS_platformGrabMutex(contextLock);
+   link = &contexts;
+   while (*link != context)
+      link = &(*link)->next;
+   *link = context->next;
+   __PHYSFS_platformReleaseMutex(contextLock);
+
+   if (currentContext == context)
+      currentContext = nullptr;
+   freeContextLocks(*context);
+   context->~PHYSFS_Context();
+   allocator.Free(context);
+   return 1;
+}
+
+///                                                                           
+PHYSFS_Context* PHYSFS_setContext(PHYSFS_Context* context) {
+   const auto previous = currentContext;
+   currentContext = context == &defaultContext ? nullptr : context;
+   return previous;
+}
+
+///                                                                           
+PHYSFS_Context* PHYSFS_getContext(void) {
+   return currentContext;
+}
+
+///                                                                           
+char* __PHYSFS_strdup(const char* str) {
+   char* retval = PHYSFS_Allocator<char>(strlen(str) + 1).Ref();
+   if (retval)
+      strcpy(retval, str);
+   return retval;
+}
+
+///                                                                           
+PHYSFS_uint32 __PHYSFS_hashString(const char* str) {
+   PHYSFS_uint32 hash = 5381;
+   while (1) {
+      const char ch = *(str++);
+      if (not ch)
+         break;
+      hash = ((hash << 5) + hash) ^ ch;
+   }
+
+   return hash;
+}
+
+///                                                                           
+PHYSFS_uint32 __PHYSFS_hashStringCaseFold(const char* str) {
+   PHYSFS_uint32 hash = 5381;
+   while (1) {
+      const auto cp = __PHYSFS_utf8codepoint(&str);
+      if (not cp)
+         break;
+
+      PHYSFS_uint32 folded[3];
+      const int numbytes = PHYSFS_caseFold(cp, folded) * sizeof(PHYSFS_uint32);
+      const char* bytes  = (const char*) folded;
+      for (auto i = 0; i < numbytes; i++)
+         hash = ((hash << 5) + hash) ^ *(bytes++);
+   }
+
+   return hash;
+}
+
+PHYSFS_uint32 __PHYSFS_hashStringCaseFoldUSAscii(const char* str) {
+   PHYSFS_uint32 hash = 5381;
+   while (1) {
+      char ch = *(str++);
+      if (not ch)
+         break;
+
+      if (ch >= 'A' and ch <= 'Z')
+         ch -= ('A' - 'a');
+      hash = ((hash << 5) + hash) ^ ch;
+   }
+
+   return hash;
+}
+
+/// MAKE SURE you hold archiverLock exclusively before calling this!          
+static int doRegisterArchiver(const PHYSFS_Archiver* _archiver) {
+   const PHYSFS_uint32 maxver = CURRENT_PHYSFS_ARCHIVER_API_VERSION;
+   const size_t len = (numArchivers + 2) * sizeof(void*);
+   void* ptr = nullptr;
+
+   BAIL_IF(not _archiver, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(    _archiver->version > maxver, PHYSFS_ERR_UNSUPPORTED, 0);
+   BAIL_IF(not _archiver->info.extension, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(not _archiver->info.description, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(not _archiver->info.author, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(not _archiver->info.url, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(not _archiver->openArchive, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(not _archiver->enumerate, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(not _archiver->openRead, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(not _archiver->openWrite, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(not _archiver->openAppend, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(not _archiver->remove, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(not _archiver->mkdir, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(not _archiver->closeArchive, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(not _archiver->stat, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+   auto ext = _archiver->info.extension;
+   for (size_t i = 0; i < numArchivers; i++) {
+      if (PHYSFS_utf8stricmp(archiveInfo[i]->extension, ext) == 0)
+         BAIL(PHYSFS_ERR_DUPLICATE, 0);
+   }
+
+   // Make a copy of the data                                           
+   auto archiver = PHYSFS_Allocator<RegisteredArchiver>(1, *_archiver, 0);
+   if (_archiver->version < 1)
+      archiver->archiver.statEx = nullptr;  // Not there in version 0
+   if (_archiver->version < 2)
+      archiver->archiver.concurrentOpenRead = 0;  // Nor this, before 2
+   auto info = &archiver->archiver.info;
+   memset(info, '\0', sizeof(*info));  // nullptr in case an alloc fails
+
+   #define CPYSTR(item) \
+           info->item = __PHYSFS_strdup(_archiver->info.item); \
+           GOTO_IF(!info->item, PHYSFS_ERR_OUT_OF_MEMORY, regfailed);
+      CPYSTR(extension);
+      CPYSTR(description);
+      CPYSTR(author);
+      CPYSTR(url);
+      info->supportsSymlinks = _archiver->info.supportsSymlinks;
+   #undef CPYSTR
+
+   ptr = allocator.Realloc(archiveInfo, len);
+   GOTO_IF(!ptr, PHYSFS_ERR_OUT_OF_MEMORY, regfailed);
+   archiveInfo = (PHYSFS_ArchiveInfo**) ptr;
+
+   ptr = allocator.Realloc(archivers, len);
+   GOTO_IF(!ptr, PHYSFS_ERR_OUT_OF_MEMORY, regfailed);
+   archivers = (PHYSFS_Archiver**) ptr;
+
+   archiveInfo[numArchivers] = info;
+   archiveInfo[numArchivers + 1] = nullptr;
+
+   archivers[numArchivers] = &archiver.Ref()->archiver;
+   archivers[numArchivers + 1] = nullptr;
+
+   numArchivers++;
+   return 1;
+
+regfailed:
+   if (info) {
+      PHYSFS_Allocator<>::Free((void*) info->extension);
+      PHYSFS_Allocator<>::Free((void*) info->description);
+      PHYSFS_Allocator<>::Free((void*) info->author);
+      PHYSFS_Allocator<>::Free((void*) info->url);
+   }
+
+   return 0;
+}
+
+int PHYSFS_registerArchiver(const PHYSFS_Archiver* archiver) {
+   BAIL_IF(not initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+
+#ifndef PHYSFS_NO_THREADS
+   std::unique_lock lock {archiverLock};
+#endif
+   return doRegisterArchiver(archiver);
+}
+
+int PHYSFS_deregisterArchiver(const char* ext) {
+   BAIL_IF(not initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+   BAIL_IF(not ext, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+#ifndef PHYSFS_NO_THREADS
+   std::unique_lock lock {archiverLock};
+#endif
+   for (size_t i = 0; i < numArchivers; i++) {
+      if (PHYSFS_utf8stricmp(archiveInfo[i]->extension, ext) == 0)
+         return doDeregisterArchiver(i);
+   }
+
+   BAIL(PHYSFS_ERR_NOT_FOUND, 0);
+}
+
+const PHYSFS_ArchiveInfo** PHYSFS_supportedArchiveTypes(void) {
+   BAIL_IF(not initialized, PHYSFS_ERR_NOT_INITIALIZED, nullptr);
+   return (const PHYSFS_ArchiveInfo**) archiveInfo;
+}
+
+void PHYSFS_freeList(void* list) {
+   if (list) {
+      for (auto i = static_cast<void**>(list); *i; i++)
+         PHYSFS_Allocator<>::Free(*i);
+      PHYSFS_Allocator<>::Free(list);
+   }
+}
+
+const char* PHYSFS_getDirSeparator() {
+   static char retval[2] = {__PHYSFS_platformDirSeparator, '\0'};
+   return retval;
+}
+
+char** PHYSFS_getCdRomDirs() {
+   return doEnumStringList(__PHYSFS_platformDetectAvailableCDs);
+}
+
+void PHYSFS_getCdRomDirsCallback(PHYSFS_StringCallback callback, void* data) {
+   __PHYSFS_platformDetectAvailableCDs(callback, data);
+}
+
+const char* PHYSFS_getPrefDir(const char* org, const char* app) {
+   const char dirsep = __PHYSFS_platformDirSeparator;
+   PHYSFS_Stat statbuf;
+   char* ptr = nullptr;
+   char* endstr = nullptr;
+
+   BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+   BAIL_IF(!org, PHYSFS_ERR_INVALID_ARGUMENT, nullptr);
+   BAIL_IF(*org == '\0', PHYSFS_ERR_INVALID_ARGUMENT, nullptr);
+   BAIL_IF(!app, PHYSFS_ERR_INVALID_ARGUMENT, nullptr);
+   BAIL_IF(*app == '\0', PHYSFS_ERR_INVALID_ARGUMENT, nullptr);
+
+   allocator.Free(prefDir);
+   prefDir = __PHYSFS_platformCalcPrefDir(org, app);
+   BAIL_IF_ERRPASS(!prefDir, nullptr);
+
+   assert(strlen(prefDir) > 0);
+   endstr = prefDir + (strlen(prefDir) - 1);
+   assert(*endstr == dirsep);
+   *endstr = '\0';  /* mask out the final dirsep for now. */
+
+   if (!__PHYSFS_platformStat(prefDir, &statbuf, 1)) {
+      for (ptr = strchr(prefDir, dirsep); ptr; ptr = strchr(ptr + 1, dirsep)) {
+         *ptr = '\0';
+         __PHYSFS_platformMkDir(prefDir);
+         *ptr = dirsep;
+      }
+
+      if (!__PHYSFS_platformMkDir(prefDir)) {
+         allocator.Free(prefDir);
+         prefDir = nullptr;
+      }
+   }
+
+   *endstr = dirsep;  /* readd the final dirsep. */
+   return prefDir;
+}
+
+const char* PHYSFS_getBaseDir(void) {
+   return baseDir;   /* this is calculated in PHYSFS_init()... */
+}
+
+const char* __PHYSFS_getUserDir(void)  /* not deprecated internal version. */
+{
+   return userDir;   /* this is calculated in PHYSFS_init()... */
+}
+
+const char* PHYSFS_getUserDir(void) {
+   return __PHYSFS_getUserDir();
+}
+
+const char* PHYSFS_getWriteDir(void) {
+   auto& context = ctx();
+   const char* retval = nullptr;
+   __PHYSFS_platformGrabMutex(context.stateLock);
+   if (context.writeDir != nullptr)
+      retval = context.writeDir->dirName;
+   __PHYSFS_platformReleaseMutex(context.stateLock);
+   return retval;
+}
+
+int PHYSFS_setWriteDir(const char* newDir) {
+   auto& context = ctx();
+   int retval = 1;
+
+   __PHYSFS_platformGrabMutex(context.stateLock);
+
+   // An archiver throwing out of the open mustn't leave stateLock held 
+   try {
+      if (context.writeDir != nullptr) {
+         BAIL_IF_MUTEX_ERRPASS(!freeDirHandle(context.writeDir),
+            context.stateLock, 0);
+         context.writeDir = nullptr;
+      }
+
+      if (newDir != nullptr) {
+         context.writeDir = createDirHandle(nullptr, newDir, nullptr, 1);
+         retval = (context.writeDir != nullptr);
+
+         // Finish off a commit that was cut short last time            
+         if (context.writeDir)
+            recoverCommit(context.writeDir);
+      }
+   }
+   catch (...) {
+      __PHYSFS_platformReleaseMutex(context.stateLock);
+      throw;
+   }
+
+   __PHYSFS_platformReleaseMutex(context.stateLock);
+
+   return retval;
+}
+
+int PHYSFS_setRoot(const char* archive, const char* subdir) {
+   auto& context = ctx();
+   DirHandle* i;
+
+   BAIL_IF(!archive, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+   __PHYSFS_platformGrabMutex(context.stateLock);
+   for (i = context.searchPath; i != nullptr; i = i->next) {
+      if ((i->dirName != nullptr) && (strcmp(archive, i->dirName) == 0)) {
+         if (!subdir || (strcmp(subdir, "/") == 0)) {
+            if (i->root)
+               allocator.Free(i->root);
+            i->root = nullptr;
+            i->rootlen = 0;
+         }
+         else {
+            const size_t len = strlen(subdir) + 1;
+            char* ptr = (char*) allocator.Malloc(len);
+            BAIL_IF_MUTEX(!ptr, PHYSFS_ERR_OUT_OF_MEMORY, context.stateLock, 0);
+            if (!sanitizePlatformIndependentPath(subdir, ptr)) {
+               allocator.Free(ptr);
+               BAIL_MUTEX_ERRPASS(context.stateLock, 0);
+            }
+
+            if (i->root)
+               allocator.Free(i->root);
+            i->root = ptr;
+            i->rootlen = strlen(i->root);  /* in case sanitizePlatformIndependentPath changed subdir */
+
+            if (context.longest_root < i->rootlen)
+               context.longest_root = i->rootlen;
+         }
+
+         break;
+      }
+   }
+   __PHYSFS_platformReleaseMutex(context.stateLock);
+   return 1;
+}
+
+static int doMount(
+   PHYSFS_Io* io, const char* fname,
+   const char* mountPoint, int appendToPath
+) {
+   auto& context = ctx();
+   DirHandle* dh;
+   DirHandle* prev = nullptr;
+   DirHandle* i;
+
+   BAIL_IF(!fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+   if (mountPoint == nullptr)
+      mountPoint = "/";
+
+   IoUnderStateLock scope;
+   __PHYSFS_platformGrabMutex(context.stateLock);
+
+   for (i = context.searchPath; i != nullptr; i = i->next) {
+      // Already in search path?                                        
+      if ((i->dirName != nullptr) && (strcmp(fname, i->dirName) == 0))
+         BAIL_MUTEX_ERRPASS(context.stateLock, 1);
+      prev = i;
+   }
+
+   // An archiver throwing out of the open mustn't leave stateLock held 
+   try { dh = createDirHandle(io, fname, mountPoint, 0); }
+   catch (...) {
+      __PHYSFS_platformReleaseMutex(context.stateLock);
+      throw;
+   }
+   BAIL_IF_MUTEX_ERRPASS(!dh, context.stateLock, 0);
+
+   if (appendToPath) {
+      if (prev == nullptr)
+         context.searchPath = dh;
+      else
+         prev->next = dh;
+   }
+   else {
+      dh->next = context.searchPath;
+      context.searchPath = dh;
+   }
+
+   __PHYSFS_platformReleaseMutex(context.stateLock);
+   return 1;
+}
+
+int PHYSFS_mountIo(
+   PHYSFS_Io* io, const char* fname,
+   const char* mountPoint, int appendToPath
+) {
+   BAIL_IF(!io, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(!fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(io->version > CURRENT_PHYSFS_IO_API_VERSION, PHYSFS_ERR_UNSUPPORTED, 0);
+   return doMount(io, fname, mountPoint, appendToPath);
+}
+
+int PHYSFS_mountMemory(
+   const void* buf, PHYSFS_uint64 len, void (*del)(void*),
+   const char* fname, const char* mountPoint, int appendToPath
+) {
+   int retval = 0;
+   PHYSFS_Io* io = nullptr;
+
+   BAIL_IF(!buf, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(!fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+   io = __PHYSFS_createMemoryIo(buf, len, del);
+   BAIL_IF_ERRPASS(!io, 0);
+   retval = doMount(io, fname, mountPoint, appendToPath);
+   if (!retval) {
+      // Docs say not to call (del) in case of failure, so cheat        
+      MemoryIoInfo* info = (MemoryIoInfo*) io->opaque;
+      info->destruct = nullptr;
+      io->destroy(io);
+   }
+
+   return retval;
+}
+
+int PHYSFS_mountHandle(
+   PHYSFS_File* file, const char* fname,
+   const char* mountPoint, int appendToPath
+) {
+   int retval = 0;
+   PHYSFS_Io* io = nullptr;
+
+   BAIL_IF(!file, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(!fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+   io = __PHYSFS_createHandleIo(file);
+   BAIL_IF_ERRPASS(!io, 0);
+   retval = doMount(io, fname, mountPoint, appendToPath);
+   if (!retval) {
+      // Docs say not to destruct in case of failure, so cheat          
+      io->opaque = nullptr;
+      io->destroy(io);
+   }
+
+   return retval;
+}
+
+int PHYSFS_mount(
+   const char* newDir, const char* mountPoint, int appendToPath
+) {
+   BAIL_IF(!newDir, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   return doMount(nullptr, newDir, mountPoint, appendToPath);
+}
+
+int PHYSFS_addToSearchPath(const char* newDir, int appendToPath) {
+   return PHYSFS_mount(newDir, nullptr, appendToPath);
+}
+
+int PHYSFS_removeFromSearchPath(const char* oldDir) {
+   return PHYSFS_unmount(oldDir);
+}
+
+int PHYSFS_unmount(const char* oldDir) {
+   auto& context = ctx();
+   DirHandle* i;
+   DirHandle* prev = nullptr;
+   DirHandle* next = nullptr;
+
+   BAIL_IF(oldDir == nullptr, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+   __PHYSFS_platformGrabMutex(context.stateLock);
+   for (i = context.searchPath; i != nullptr; i = i->next) {
+      if (strcmp(i->dirName, oldDir) == 0) {
+         next = i->next;
+         BAIL_IF_MUTEX_ERRPASS(!freeDirHandle(i),
+            context.stateLock, 0);
+
+         if (prev == nullptr)
+            context.searchPath = next;
+         else
+            prev->next = next;
+
+         BAIL_MUTEX_ERRPASS(context.stateLock, 1);
+      }
+      prev = i;
+   }
+
+   BAIL_MUTEX(PHYSFS_ERR_NOT_MOUNTED, context.stateLock, 0);
+}
+
+char** PHYSFS_getSearchPath(void) {
+   return doEnumStringList(PHYSFS_getSearchPathCallback);
+}
+
+const char* PHYSFS_getMountPoint(const char* dir) {
+   auto& context = ctx();
+   DirHandle* i;
+   __PHYSFS_platformGrabMutex(context.stateLock);
+   for (i = context.searchPath; i != nullptr; i = i->next) {
+      if (strcmp(i->dirName, dir) == 0) {
+         const char* retval = ((i->mountPoint) ? i->mountPoint : "/");
+         __PHYSFS_platformReleaseMutex(context.stateLock);
+         return retval;
+      }
+   }
+   __PHYSFS_platformReleaseMutex(context.stateLock);
+
+   BAIL(PHYSFS_ERR_NOT_MOUNTED, nullptr);
+}
+
+void PHYSFS_getSearchPathCallback(PHYSFS_StringCallback callback, void* data) {
+   auto& context = ctx();
+   DirHandle* i;
+
+   __PHYSFS_platformGrabMutex(context.stateLock);
+
+   for (i = context.searchPath; i != nullptr; i = i->next)
+      callback(data, i->dirName);
+
+   __PHYSFS_platformReleaseMutex(context.stateLock);
+}
+
+typedef struct setSaneCfgEnumData
+{
+   const char* archiveExt;
+   size_t archiveExtLen;
+   int archivesFirst;
+   PHYSFS_ErrorCode errcode;
+} setSaneCfgEnumData;
+
+static PHYSFS_EnumerateCallbackResult setSaneCfgEnumCallback(void* _data,
+   const char* /*dir*/, const char* f) {
+   setSaneCfgEnumData* data = (setSaneCfgEnumData*) _data;
+   const size_t extlen = data->archiveExtLen;
+   const size_t l = strlen(f);
+   const char* ext;
+
+   if ((l > extlen) && (f[l - extlen - 1] == '.')) {
+      ext = f + (l - extlen);
+      if (PHYSFS_utf8stricmp(ext, data->archiveExt) == 0) {
+         const char dirsep = __PHYSFS_platformDirSeparator;
+         const char* d = PHYSFS_getRealDir(f);
+         const size_t allocsize = strlen(d) + l + 2;
+         char* str = (char*) __PHYSFS_smallAlloc(allocsize);
+         if (str == nullptr)
+            data->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
+         else {
+            snprintf(str, allocsize, "%s%c%s", d, dirsep, f);
+            if (!PHYSFS_mount(str, nullptr, data->archivesFirst == 0))
+               data->errcode = currentErrorCode();
+            __PHYSFS_smallFree(str);
+         }
+      }
+   }
+
+   /* !!! FIXME: if we want to abort on errors... */
+   /*return (data->errcode != PHYSFS_ERR_OK) ? PHYSFS_ENUM_ERROR : PHYSFS_ENUM_OK;*/
+
+   return PHYSFS_ENUM_OK;  /* keep going */
+}
+
+int PHYSFS_setSaneConfig(const char* organization, const char* appName,
+   const char* archiveExt, int includeCdRoms,
+   int archivesFirst) {
+   const char* basedir;
+   const char* prefdir;
+
+   BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+
+   prefdir = PHYSFS_getPrefDir(organization, appName);
+   BAIL_IF_ERRPASS(!prefdir, 0);
+
+   basedir = PHYSFS_getBaseDir();
+   BAIL_IF_ERRPASS(!basedir, 0);
+
+   BAIL_IF(!PHYSFS_setWriteDir(prefdir), PHYSFS_ERR_NO_WRITE_DIR, 0);
+
+   /* !!! FIXME: these can fail and we should report that... */
+
+   /* Put write dir first in search path... */
+   PHYSFS_mount(prefdir, nullptr, 0);
+
+   /* Put base path on search path... */
+   PHYSFS_mount(basedir, nullptr, 1);
+
+   /* handle CD-ROMs... */
+   if (includeCdRoms) {
+      char** cds = PHYSFS_getCdRomDirs();
+      char** i;
+      for (i = cds; *i != nullptr; i++)
+         PHYSFS_mount(*i, nullptr, 1);
+      PHYSFS_freeList(cds);
+   }
+
+   /* Root out archives, and add them to search path... */
+   if (archiveExt != nullptr) {
+      setSaneCfgEnumData data;
+      memset(&data, '\0', sizeof(data));
+      data.archiveExt = archiveExt;
+      data.archiveExtLen = strlen(archiveExt);
+      data.archivesFirst = archivesFirst;
+      data.errcode = PHYSFS_ERR_OK;
+      if (!PHYSFS_enumerate("/", setSaneCfgEnumCallback, &data)) {
+         /* !!! FIXME: use this if we're reporting errors.
+         PHYSFS_ErrorCode errcode = currentErrorCode();
+         if (errcode == PHYSFS_ERR_APP_CALLBACK)
+             errcode = data->errcode; */
+      }
+   }
+
+   return 1;
+}
+
+void PHYSFS_permitSymbolicLinks(int allow) {
+   ctx().allowSymLinks = allow;
+}
+
+int PHYSFS_symbolicLinksPermitted(void) {
+   return ctx().allowSymLinks;
+}
+
+///                                                                           
+/// Verify that (fname) (in platform-independent notation), in relation       
+/// to (h) is secure. That means that each element of fname is checked        
+/// for symlinks (if they aren't permitted). This also allows for quick       
+/// rejection of files that exist outside an archive's mountpoint.            
+///                                                                           
+/// With some exceptions (like PHYSFS_mkdir(), which builds multiple subdirs  
+/// at a time), you should always pass zero for "allowMissing" for efficiency.
+///                                                                           
+/// (fname) must point to an output from sanitizePlatformIndependentPath(),   
+/// since it will make sure that path names are in the right format for       
+/// passing certain checks. It will also do checks for "insecure" pathnames   
+/// like ".." which should be done once instead of once per archive. This also
+/// gives us license to treat (fname) as scratch space in this function.      
+///                                                                           
+/// (fname)'s buffer must have enough space available before it for this      
+/// function to prepend any root directory for this DirHandle.                
+///                                                                           
+/// Returns non-zero if string is safe, zero if there's a security issue.     
+/// PHYSFS_getLastError() will specify what was wrong. (*fname) will be       
+/// updated to point past any mount point elements so it is prepared to       
+/// be used with the archiver directly.                                       
+///                                                                           
+static int verifyPath(DirHandle* h, char** _fname, int allowMissing) {
+   char* fname = *_fname;
+   int retval = 1;
+   char* start;
+   char* end;
+
+   if (*fname == '\0' and not h->root)  // Quick rejection              
+      return 1;
+
+   /* !!! FIXME: This codeblock sucks. */
+   if (h->mountPoint != nullptr)  /* nullptr mountpoint means "/". */
+   {
+      size_t mntpntlen = strlen(h->mountPoint);
+      size_t len = strlen(fname);
+      assert(mntpntlen > 1); /* root mount points should be nullptr. */
+      /* not under the mountpoint, so skip this archive. */
+      BAIL_IF(len < mntpntlen - 1, PHYSFS_ERR_NOT_FOUND, 0);
+      /* !!! FIXME: Case insensitive? */
+      retval = strncmp(h->mountPoint, fname, mntpntlen - 1);
+      BAIL_IF(retval != 0, PHYSFS_ERR_NOT_FOUND, 0);
+      if (len > mntpntlen - 1)  /* corner case... */
+         BAIL_IF(fname[mntpntlen - 1] != '/', PHYSFS_ERR_NOT_FOUND, 0);
+      fname += mntpntlen - 1;  /* move to start of actual archive path. */
+      if (*fname == '/')
+         fname++;
+      *_fname = fname;  /* skip mountpoint for later use. */
+      retval = 1;  /* may be reset, below. */
+   } /* if */
+
+   // Prepend the root directory, if any                                
+   if (h->root) {
+      const int isempty = (*fname == '\0');
+      fname -= h->rootlen + (isempty ? 0 : 1);
+      strcpy(fname, h->root);
+      if (!isempty)
+         fname[h->rootlen] = '/';
+      *_fname = fname;
+   }
+
+   start = fname;
+   if (not ctx().allowSymLinks) {
+      while (1) {
+         end = strchr(start, '/');
+         if (end)
+            *end = '\0';
+
+         // Archivers may throw for a missing element instead of failing
+         // quietly; either way it's handled below, not an error yet    
+         PHYSFS_Stat statbuf;
+         int rc = 0;
+         try {
+            rc = archiveStat(h, fname, &statbuf);
+            if (rc)
+               rc = (statbuf.filetype == PHYSFS_FILETYPE_SYMLINK);
+            else if (currentErrorCode() == PHYSFS_ERR_NOT_FOUND)
+               retval = 0;
+         }
+         catch (const MetaPhysFS::Exception<PHYSFS_ERR_NOT_FOUND>&) {
+            retval = 0;
+         }
+
+         if (end)
+            *end = '/';
+
+         // Insecure path (has a disallowed symlink in it)?             
+         BAIL_IF(rc, PHYSFS_ERR_SYMLINK_FORBIDDEN, 0);
+
+         // Break out early if path element is missing                  
+         if (not retval) {
+            // We need to clear it if it's the last element of the path,
+            // since this might be a non-existant file we're opening    
+            // for writing...                                           
+            if (not end or allowMissing)
+               retval = 1;
+            break;
+         }
+
+         if (not end)
+            break;
+
+         start = end + 1;
+      }
+   }
+
+   return retval;
+}
+
+
+/// This must hold the stateLock before calling                               
+static int doMkdir(const char* _dname, char* dname) {
+   DirHandle* h = ctx().writeDir;
+   char* start;
+   char* end;
+   int retval = 0;
+   int exists = 1;  // Force existance check on first path element      
+
+   assert(h != nullptr);
+
+   BAIL_IF_ERRPASS(!sanitizePlatformIndependentPathWithRoot(h, _dname, dname), 0);
+   BAIL_IF_ERRPASS(!verifyPath(h, &dname, 1), 0);
+
+   start = dname;
+   while (1) {
+      end = strchr(start, '/');
+      if (end)
+         *end = '\0';
 
-   if (!__PHYSFS_platformStat(prefDir, &statbuf, 1)) {
-      for (ptr = strchr(prefDir, dirsep); ptr; ptr = strchr(ptr + 1, dirsep)) {
-         *ptr = '\0';
-         __PHYSFS_platformMkDir(prefDir);
-         *ptr = dirsep;
-      }
+      // Only check for existance if all parent dirs existed, too...    
+      if (exists) {
+         PHYSFS_Stat statbuf;
+         const int rc = archiveStat(h, dname, &statbuf);
+         if ((!rc) && (currentErrorCode() == PHYSFS_ERR_NOT_FOUND))
+            exists = 0;
 
-      if (!__PHYSFS_platformMkDir(prefDir)) {
-         allocator.Free(prefDir);
-         prefDir = nullptr;
+         /* verifyPath made sure that (dname) doesn't have symlinks if they aren't
+            allowed, but it's possible the mounted writeDir itself has symlinks in it,
+            (for example "/var" on iOS is a symlink, and the prefpath will be somewhere
+            under that)...if we mounted that writeDir, we must allow those symlinks here
+            unconditionally. */
+         retval = ((rc) && ((statbuf.filetype == PHYSFS_FILETYPE_DIRECTORY) || (statbuf.filetype == PHYSFS_FILETYPE_SYMLINK)));
       }
-   }
-
-   *endstr = dirsep;  /* readd the final dirsep. */
-   return prefDir;
-}
 
-const char* PHYSFS_getBaseDir(void) {
-   return baseDir;   /* this is calculated in PHYSFS_init()... */
-}
+      if (not exists)
+         retval = h->funcs->mkdir(h->opaque, dname);
 
-const char* __PHYSFS_getUserDir(void)  /* not deprecated internal version. */
-{
-   return userDir;   /* this is calculated in PHYSFS_init()... */
-}
+      if (not retval or not end)
+         break;
 
-const char* PHYSFS_getUserDir(void) {
-   return __PHYSFS_getUserDir();
-}
+      *end = '/';
+      start = end + 1;
+   }
 
-const char* PHYSFS_getWriteDir(void) {
-   const char* retval = nullptr;
-   __PHYSFS_platformGrabMutex(stateLock);
-   if (writeDir != nullptr)
-      retval = writeDir->dirName;
-   __PHYSFS_platformReleaseMutex(stateLock);
    return retval;
 }
 
-int PHYSFS_setWriteDir(const char* newDir) {
-   int retval = 1;
+int PHYSFS_mkdir(const char* _dname) {
+   auto& context = ctx();
+   int retval = 0;
+   char* dname;
+   size_t len;
 
-   __PHYSFS_platformGrabMutex(stateLock);
+   BAIL_IF(!_dname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
 
-   if (writeDir != nullptr) {
-      BAIL_IF_MUTEX_ERRPASS(!freeDirHandle(writeDir, openWriteList),
-         stateLock, 0);
-      writeDir = nullptr;
-   }
+   __PHYSFS_platformGrabMutex(context.stateLock);
+   BAIL_IF_MUTEX(!context.writeDir, PHYSFS_ERR_NO_WRITE_DIR, context.stateLock, 0);
+   len = strlen(_dname) + dirHandleRootLen(context.writeDir) + 1;
+   dname = (char*) __PHYSFS_smallAlloc(len);
+   BAIL_IF_MUTEX(!dname, PHYSFS_ERR_OUT_OF_MEMORY, context.stateLock, 0);
+   retval = doMkdir(_dname, dname);
+   __PHYSFS_platformReleaseMutex(context.stateLock);
+   __PHYSFS_smallFree(dname);
+   return retval;
+}
 
-   if (newDir != nullptr) {
-      writeDir = createDirHandle(nullptr, newDir, nullptr, 1);
-      retval = (writeDir != nullptr);
-   }
+/// This must hold the stateLock before calling                               
+static int doDelete(const char* _fname, char* fname) {
+   DirHandle* h = ctx().writeDir;
+   BAIL_IF_ERRPASS(!sanitizePlatformIndependentPathWithRoot(h, _fname, fname), 0);
+   BAIL_IF_ERRPASS(!verifyPath(h, &fname, 0), 0);
+   return h->funcs->remove(h->opaque, fname);
+}
 
-   __PHYSFS_platformReleaseMutex(stateLock);
+int PHYSFS_delete(const char* _fname) {
+   auto& context = ctx();
+   int retval;
+   char* fname;
+   size_t len;
 
+   __PHYSFS_platformGrabMutex(context.stateLock);
+   BAIL_IF_MUTEX(!context.writeDir, PHYSFS_ERR_NO_WRITE_DIR, context.stateLock, 0);
+   len = strlen(_fname) + dirHandleRootLen(context.writeDir) + 1;
+   fname = (char*) __PHYSFS_smallAlloc(len);
+   BAIL_IF_MUTEX(!fname, PHYSFS_ERR_OUT_OF_MEMORY, context.stateLock, 0);
+   retval = doDelete(_fname, fname);
+   __PHYSFS_platformReleaseMutex(context.stateLock);
+   __PHYSFS_smallFree(fname);
    return retval;
 }
 
-int PHYSFS_setRoot(const char* archive, const char* subdir) {
-   DirHandle* i;
+static DirHandle* getRealDirHandle(const char* _fname) {
+   auto& context = ctx();
+   DirHandle* retval = nullptr;
+   char* allocated_fname = nullptr;
+   char* fname = nullptr;
+   size_t len;
 
-   BAIL_IF(!archive, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(!_fname, PHYSFS_ERR_INVALID_ARGUMENT, nullptr);
 
-   __PHYSFS_platformGrabMutex(stateLock);
-   for (i = searchPath; i != nullptr; i = i->next) {
-      if ((i->dirName != nullptr) && (strcmp(archive, i->dirName) == 0)) {
-         if (!subdir || (strcmp(subdir, "/") == 0)) {
-            if (i->root)
-               allocator.Free(i->root);
-            i->root = nullptr;
-            i->rootlen = 0;
-         }
-         else {
-            const size_t len = strlen(subdir) + 1;
-            char* ptr = (char*) allocator.Malloc(len);
-            BAIL_IF_MUTEX(!ptr, PHYSFS_ERR_OUT_OF_MEMORY, stateLock, 0);
-            if (!sanitizePlatformIndependentPath(subdir, ptr)) {
-               allocator.Free(ptr);
-               BAIL_MUTEX_ERRPASS(stateLock, 0);
-            }
+   __PHYSFS_platformGrabMutex(context.stateLock);
+   len = strlen(_fname) + context.longest_root + 2;
+   allocated_fname = __PHYSFS_smallAlloc(len);
+   BAIL_IF_MUTEX(!allocated_fname, PHYSFS_ERR_OUT_OF_MEMORY, context.stateLock, nullptr);
+   fname = allocated_fname + context.longest_root + 1;
+   if (sanitizePlatformIndependentPath(_fname, fname)) {
+      DirHandle* i;
+      for (i = context.searchPath; i != nullptr; i = i->next) {
+         char* arcfname = fname;
+         if (partOfMountPoint(i, arcfname)) {
+            retval = i;
+            break;
+         } /* if */
+         else if (verifyPath(i, &arcfname, 0)) {
+            PHYSFS_Stat statbuf;
+            if (archiveStat(i, arcfname, &statbuf)) {
+               retval = i;
+               break;
+            } /* if */
+         } /* if */
+      } /* for */
+   } /* if */
 
-            if (i->root)
-               allocator.Free(i->root);
-            i->root = ptr;
-            i->rootlen = strlen(i->root);  /* in case sanitizePlatformIndependentPath changed subdir */
+   __PHYSFS_platformReleaseMutex(context.stateLock);
+   __PHYSFS_smallFree(allocated_fname);
+   return retval;
+}
 
-            if (longest_root < i->rootlen)
-               longest_root = i->rootlen;
-         }
+const char* PHYSFS_getRealDir(const char* fname) {
+   DirHandle* dh = getRealDirHandle(fname);
+   return dh ? dh->dirName : nullptr;
+}
 
-         break;
-      }
+/// PHYSFS_enumerate hands out names already sorted and without duplicates,   
+/// so building the list is a plain append                                    
+static PHYSFS_EnumerateCallbackResult enumFilesCallback(
+   void* data, const char*, const char* str
+) {
+   EnumStringListCallbackData* pecd = (EnumStringListCallbackData*) data;
+   auto ptr = PHYSFS_Allocator<>::Realloc(pecd->list, (pecd->size + 2) * sizeof(char*));
+   if (not ptr) {
+      pecd->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
+      return PHYSFS_ENUM_ERROR;  /* better luck next time. */
    }
-   __PHYSFS_platformReleaseMutex(stateLock);
-   return 1;
+
+   pecd->list = (char**) ptr;
+   auto newstr = PHYSFS_Allocator<char>(strlen(str) + 1);
+   strcpy(newstr.Get(), str);
+   pecd->list[pecd->size++] = newstr.Ref();
+   return PHYSFS_ENUM_OK;
 }
 
-static int doMount(
-   PHYSFS_Io* io, const char* fname,
-   const char* mountPoint, int appendToPath
-) {
-   DirHandle* dh;
-   DirHandle* prev = nullptr;
-   DirHandle* i;
+char** PHYSFS_enumerateFiles(const char* path) {
+   EnumStringListCallbackData ecd;
+   memset(&ecd, '\0', sizeof(ecd));
+   ecd.list = PHYSFS_Allocator<char*>(1).Ref();
+   BAIL_IF(!ecd.list, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+   if (!PHYSFS_enumerate(path, enumFilesCallback, &ecd)) {
+      const PHYSFS_ErrorCode errcode = currentErrorCode();
+      PHYSFS_uint32 i;
+      for (i = 0; i < ecd.size; i++)
+         PHYSFS_Allocator<>::Free(ecd.list[i]);
+      PHYSFS_Allocator<>::Free(ecd.list);
+      if (errcode == PHYSFS_ERR_APP_CALLBACK)
+         PHYSFS_setErrorCode(ecd.errcode);
+      return nullptr;
+   }
 
-   BAIL_IF(!fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   ecd.list[ecd.size] = nullptr;
+   return ecd.list;
+}
 
-   if (mountPoint == nullptr)
-      mountPoint = "/";
+///                                                                           
+/// One sorted listing per search path element, consumed by the k-way merge   
+/// in PHYSFS_enumerate. Archives built on __PHYSFS_DirTree already keep each 
+/// directory's kids sorted, so those are walked in place. Everything else    
+/// (native dirs, mount point stubs) is gathered once into a single name      
+/// buffer per source, and sorted there                                       
+///                                                                           
+struct EnumSource {
+   DirHandle* dirhandle = nullptr;
+   char* arcfname = nullptr;         // Path of the dir inside the archive
+   bool filterSymLinks = false;      // Stat and drop symlinks on the way 
+
+   // Listing straight from an archive's directory tree                 
+   __PHYSFS_DirTree* tree = nullptr;
+   const PHYSFS_uint32* ids = nullptr;
+
+   // Gathered listing                                                  
+   char* names = nullptr;            // All names, back to back         
+   size_t namesUsed = 0;
+   size_t namesAllocated = 0;
+   PHYSFS_uint32* offsets = nullptr; // Where each name starts in names 
+   PHYSFS_uint32 offsetsAllocated = 0;
+
+   PHYSFS_uint32 count = 0;
+   PHYSFS_uint32 pos = 0;
+
+   ~EnumSource() {
+      if (names)
+         PHYSFS_Allocator<>::Free(names);
+      if (offsets)
+         PHYSFS_Allocator<>::Free(offsets);
+   }
 
-   __PHYSFS_platformGrabMutex(stateLock);
+   const char* Current() const noexcept {
+      return tree
+         ? __PHYSFS_DirTreeName(tree, __PHYSFS_DirTreeEntryAt(tree, ids[pos]))
+         : names + offsets[pos];
+   }
 
-   for (i = searchPath; i != nullptr; i = i->next) {
-      // Already in search path?                                        
-      if ((i->dirName != nullptr) && (strcmp(fname, i->dirName) == 0))
-         BAIL_MUTEX_ERRPASS(stateLock, 1);
-      prev = i;
+   bool Done() const noexcept {
+      return pos >= count;
    }
 
-   dh = createDirHandle(io, fname, mountPoint, 0);
-   BAIL_IF_MUTEX_ERRPASS(!dh, stateLock, 0);
+   /// Append a name to the gathered listing                                  
+   bool Gather(const char* name) {
+      const size_t len = strlen(name) + 1;
+      if (namesUsed + len > namesAllocated) {
+         const size_t size = std::max(namesAllocated * 2, namesUsed + len + 256);
+         auto ptr = PHYSFS_Allocator<>::Realloc(names, size);
+         BAIL_IF(not ptr, PHYSFS_ERR_OUT_OF_MEMORY, false);
+         names = static_cast<char*>(ptr);
+         namesAllocated = size;
+      }
 
-   if (appendToPath) {
-      if (prev == nullptr)
-         searchPath = dh;
-      else
-         prev->next = dh;
+      if (count == offsetsAllocated) {
+         const PHYSFS_uint32 size = offsetsAllocated ? offsetsAllocated * 2 : 32;
+         auto ptr = PHYSFS_Allocator<>::Realloc(offsets, size * sizeof(PHYSFS_uint32));
+         BAIL_IF(not ptr, PHYSFS_ERR_OUT_OF_MEMORY, false);
+         offsets = static_cast<PHYSFS_uint32*>(ptr);
+         offsetsAllocated = size;
+      }
+
+      memcpy(names + namesUsed, name, len);
+      offsets[count++] = static_cast<PHYSFS_uint32>(namesUsed);
+      namesUsed += len;
+      return true;
    }
-   else {
-      dh->next = searchPath;
-      searchPath = dh;
+
+   /// Sort the gathered listing, in the same order directory trees use       
+   void Sort() {
+      std::sort(offsets, offsets + count, [this](PHYSFS_uint32 a, PHYSFS_uint32 b) {
+         return strcmp(names + a, names + b) < 0;
+      });
    }
+};
 
-   __PHYSFS_platformReleaseMutex(stateLock);
-   return 1;
+static PHYSFS_EnumerateCallbackResult enumGatherCallback(
+   void* data, const char*, const char* fname
+) {
+   auto source = static_cast<EnumSource*>(data);
+   return source->Gather(fname) ? PHYSFS_ENUM_OK : PHYSFS_ENUM_ERROR;
 }
 
-int PHYSFS_mountIo(
-   PHYSFS_Io* io, const char* fname,
-   const char* mountPoint, int appendToPath
-) {
-   BAIL_IF(!io, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-   BAIL_IF(!fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-   BAIL_IF(io->version != 0, PHYSFS_ERR_UNSUPPORTED, 0);
-   return doMount(io, fname, mountPoint, appendToPath);
+/// Broke out to seperate function so we can use stack allocation gratuitously
+static int gatherFromMountPoint(EnumSource* source, const char* arcfname) {
+   const DirHandle* i = source->dirhandle;
+   const size_t len = strlen(arcfname);
+   char* ptr = nullptr;
+   char* end = nullptr;
+   const size_t slen = strlen(i->mountPoint) + 1;
+   char* mountPoint = (char*) __PHYSFS_smallAlloc(slen);
+
+   BAIL_IF(!mountPoint, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+
+   strcpy(mountPoint, i->mountPoint);
+   ptr = mountPoint + ((len) ? len + 1 : 0);
+   end = strchr(ptr, '/');
+   assert(end);  // Should always find a terminating '/'                
+   *end = '\0';
+   const bool gathered = source->Gather(ptr);
+   __PHYSFS_smallFree(mountPoint);
+   return gathered ? 1 : 0;
 }
 
-int PHYSFS_mountMemory(
-   const void* buf, PHYSFS_uint64 len, void (*del)(void*),
-   const char* fname, const char* mountPoint, int appendToPath
-) {
-   int retval = 0;
-   PHYSFS_Io* io = nullptr;
+/// Check whether a name coming out of a source is a symlink that has to be   
+/// hidden from the application                                               
+///   @return 1 if it's a symlink, 0 if not, -1 on error                      
+static int isFilteredSymLink(const EnumSource* source, const char* fname) {
+   const DirHandle* dh = source->dirhandle;
+   const char* arcfname = source->arcfname;
+   PHYSFS_Stat statbuf;
+   const char* trimmedDir = (*arcfname == '/') ? (arcfname + 1) : arcfname;
+   const size_t slen = strlen(trimmedDir) + strlen(fname) + 2;
+   char* path = (char*) __PHYSFS_smallAlloc(slen);
+   BAIL_IF(!path, PHYSFS_ERR_OUT_OF_MEMORY, -1);
 
-   BAIL_IF(!buf, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-   BAIL_IF(!fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   snprintf(path, slen, "%s%s%s", trimmedDir, *trimmedDir ? "/" : "", fname);
 
-   io = __PHYSFS_createMemoryIo(buf, len, del);
-   BAIL_IF_ERRPASS(!io, 0);
-   retval = doMount(io, fname, mountPoint, appendToPath);
-   if (!retval) {
-      // Docs say not to call (del) in case of failure, so cheat        
-      MemoryIoInfo* info = (MemoryIoInfo*) io->opaque;
-      info->destruct = nullptr;
-      io->destroy(io);
-   }
+   int retval = -1;
+   if (archiveStat(dh, path, &statbuf))
+      retval = (statbuf.filetype == PHYSFS_FILETYPE_SYMLINK) ? 1 : 0;
 
+   __PHYSFS_smallFree(path);
    return retval;
 }
 
-int PHYSFS_mountHandle(
-   PHYSFS_File* file, const char* fname,
-   const char* mountPoint, int appendToPath
-) {
-   int retval = 0;
-   PHYSFS_Io* io = nullptr;
-
-   BAIL_IF(!file, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-   BAIL_IF(!fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+/// MAKE SURE you hold stateLock before calling this!                         
+/// Find the directory in one search path element. A mount point that only    
+/// passes through it has the next part of its name listed right here, the    
+/// rest are listed by fillEnumSource                                         
+///   @return 1 if the source has something to list, 0 if it can be skipped,  
+///           -1 on error                                                     
+static int openEnumSource(EnumSource* source, DirHandle* i, char* fname) {
+   char* arcfname = fname;
+   source->dirhandle = i;
+
+   if (partOfMountPoint(i, arcfname)) {
+      BAIL_IF_ERRPASS(not gatherFromMountPoint(source, arcfname), -1);
+      return 1;
+   }
+   else if (not verifyPath(i, &arcfname, 0))
+      return 0;
 
-   io = __PHYSFS_createHandleIo(file);
-   BAIL_IF_ERRPASS(!io, 0);
-   retval = doMount(io, fname, mountPoint, appendToPath);
-   if (!retval) {
-      // Docs say not to destruct in case of failure, so cheat          
-      io->opaque = nullptr;
-      io->destroy(io);
+   PHYSFS_Stat statbuf;
+   if (!archiveStat(i, arcfname, &statbuf)) {
+      if (currentErrorCode() == PHYSFS_ERR_NOT_FOUND)
+         return 0;  /* no such dir in this archive, skip it. */
    }
 
-   return retval;
-}
+   if (statbuf.filetype != PHYSFS_FILETYPE_DIRECTORY)
+      return 0;  /* not a directory in this archive, skip it. */
 
-int PHYSFS_mount(
-   const char* newDir, const char* mountPoint, int appendToPath
-) {
-   BAIL_IF(!newDir, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-   return doMount(nullptr, newDir, mountPoint, appendToPath);
+   source->arcfname = arcfname;
+   source->filterSymLinks = (!ctx().allowSymLinks) && (i->funcs->info.supportsSymlinks);
+   return 1;
 }
 
-int PHYSFS_addToSearchPath(const char* newDir, int appendToPath) {
-   return PHYSFS_mount(newDir, nullptr, appendToPath);
-}
+/// Prepare the sorted listing of a source that openEnumSource found the      
+/// directory in. No stateLock needed: the source's DirHandle is pinned, and  
+/// calls into its archive take the archive's own lock                        
+///   @return false on error                                                  
+static bool fillEnumSource(EnumSource* source, const char* _fn) {
+   const auto i = source->dirhandle;
+   if (not source->arcfname)
+      return true;  // A mount point, listed already                    
+
+   if (i->funcs->enumerate == __PHYSFS_DirTreeEnumerate) {
+      // Already sorted, just point at the kids                         
+      source->tree = static_cast<__PHYSFS_DirTree*>(i->opaque);
+      source->ids = __PHYSFS_DirTreeChildren(source->tree, source->arcfname, &source->count);
+      BAIL_IF_ERRPASS(not source->ids, false);
+      return true;
+   }
 
-int PHYSFS_removeFromSearchPath(const char* oldDir) {
-   return PHYSFS_unmount(oldDir);
+   PHYSFS_EnumerateCallbackResult result;
+   {
+      ArchiveLock lock {i};
+      result = i->funcs->enumerate(i->opaque, source->arcfname, enumGatherCallback, _fn, source);
+   }
+   BAIL_IF_ERRPASS(result == PHYSFS_ENUM_ERROR, false);
+   source->Sort();
+   return true;
 }
 
-int PHYSFS_unmount(const char* oldDir) {
-   DirHandle* i;
-   DirHandle* prev = nullptr;
-   DirHandle* next = nullptr;
+///                                                                           
+/// Every search path element produces its own sorted listing, and these are  
+/// merged into one snapshot: a small min-heap keeps the source with the      
+/// smallest pending name on top, and a name equal to the last one handed out 
+/// is a duplicate from a lower priority mount, so it's dropped. Nothing is   
+/// globally sorted, and the merged names are copied once, into (into).       
+/// Only finding the directory in each element takes stateLock. Those that    
+/// have it are pinned like open files meanwhile, so that their listings can  
+/// be read and merged with no lock held                                      
+///   @return 0 on error, non-zero otherwise                                  
+///                                                                           
+static int mergeDirListing(const char* _fn, EnumSource* into) {
+   auto& context = ctx();
+   __PHYSFS_platformGrabMutex(context.stateLock);
+   const size_t len = strlen(_fn) + context.longest_root + 2;
+   char* allocated_fname = (char*) __PHYSFS_smallAlloc(len);
+   BAIL_IF_MUTEX(!allocated_fname, PHYSFS_ERR_OUT_OF_MEMORY, context.stateLock, 0);
+
+   // Lets go of the pinned DirHandles, however the merge ends          
+   struct Pins {
+      DirHandle** handles;
+      PHYSFS_uint32 count = 0;
+
+      ~Pins() {
+         for (PHYSFS_uint32 n = 0; n < count; ++n)
+            __PHYSFS_ATOMIC_DECR(&handles[n]->openFiles);
+      }
+   };
 
-   BAIL_IF(oldDir == nullptr, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   int retval = 1;
+   bool locked = true;
+   char* fname = allocated_fname + context.longest_root + 1;
+   try {
+      if (sanitizePlatformIndependentPath(_fn, fname)) {
+         PHYSFS_uint32 mounts = 0;
+         for (auto i = context.searchPath; i; i = i->next)
+            ++mounts;
+
+         // Each source needs its own copy of the path, verifyPath will 
+         // chop the mount point off of it                              
+         auto sources = PHYSFS_Allocator<EnumSource>(mounts);
+         auto heap = PHYSFS_Allocator<EnumSource*>(mounts);
+         auto paths = PHYSFS_Allocator<char>(mounts * len);
+         auto pinned = PHYSFS_Allocator<DirHandle*>(mounts);
+         Pins pins {pinned.Get()};
+         PHYSFS_uint32 heapSize = 0;
+         PHYSFS_uint32 m = 0;
+
+         for (auto i = context.searchPath; i and retval; i = i->next, ++m) {
+            auto source = sources.Get() + m;
+            auto path = paths.Get() + m * len;
+            memcpy(path, allocated_fname, len);
+
+            const int opened = openEnumSource(source, i, path + context.longest_root + 1);
+            if (opened < 0)
+               retval = 0;
+            else if (opened > 0) {
+               __PHYSFS_ATOMIC_INCR(&i->openFiles);
+               pins.handles[pins.count++] = i;
+               heap.Get()[heapSize++] = source;
+            }
+         }
 
-   __PHYSFS_platformGrabMutex(stateLock);
-   for (i = searchPath; i != nullptr; i = i->next) {
-      if (strcmp(i->dirName, oldDir) == 0) {
-         next = i->next;
-         BAIL_IF_MUTEX_ERRPASS(!freeDirHandle(i, openReadList),
-            stateLock, 0);
+         locked = false;
+         __PHYSFS_platformReleaseMutex(context.stateLock);
 
-         if (prev == nullptr)
-            searchPath = next;
-         else
-            prev->next = next;
+         PHYSFS_uint32 listed = 0;
+         for (PHYSFS_uint32 n = 0; n < heapSize and retval; ++n) {
+            auto source = heap.Get()[n];
+            if (not fillEnumSource(source, _fn))
+               retval = 0;
+            else if (not source->Done())
+               heap.Get()[listed++] = source;
+         }
+         heapSize = listed;
+
+         // Min-heap on the pending name, ties go to the earlier mount  
+         const auto after = [](const EnumSource* a, const EnumSource* b) {
+            const int cmp = strcmp(a->Current(), b->Current());
+            return cmp ? (cmp > 0) : (a > b);
+         };
+
+         auto first = heap.Get();
+         std::make_heap(first, first + heapSize, after);
+
+         const char* last = nullptr;
+         while (heapSize and retval) {
+            std::pop_heap(first, first + heapSize, after);
+            auto source = first[heapSize - 1];
+            const char* name = source->Current();
+
+            if (not last or strcmp(last, name) != 0) {
+               const int symlink = source->filterSymLinks
+                  ? isFilteredSymLink(source, name) : 0;
+
+               if (symlink < 0 or (not symlink and not into->Gather(name)))
+                  retval = 0;
+               else if (not symlink)
+                  last = name;
+            }
 
-         BAIL_MUTEX_ERRPASS(stateLock, 1);
+            ++source->pos;
+            if (source->Done())
+               --heapSize;
+            else
+               std::push_heap(first, first + heapSize, after);
+         }
       }
-      prev = i;
+   }
+   catch (...) {
+      if (locked)
+         __PHYSFS_platformReleaseMutex(context.stateLock);
+      __PHYSFS_smallFree(allocated_fname);
+      throw;
    }
 
-   BAIL_MUTEX(PHYSFS_ERR_NOT_MOUNTED, stateLock, 0);
+   if (locked)
+      __PHYSFS_platformReleaseMutex(context.stateLock);
+   __PHYSFS_smallFree(allocated_fname);
+   return retval;
 }
 
-char** PHYSFS_getSearchPath(void) {
-   return doEnumStringList(PHYSFS_getSearchPathCallback);
-}
+///                                                                           
+/// A snapshot of one directory's merged listing. It doesn't point back into  
+/// any archive, so it can be read with no lock held, and it stays valid      
+/// while the search path changes underneath it                               
+///                                                                           
+struct PHYSFS_Dir {
+   EnumSource listing;
+};
 
-const char* PHYSFS_getMountPoint(const char* dir) {
-   DirHandle* i;
-   __PHYSFS_platformGrabMutex(stateLock);
-   for (i = searchPath; i != nullptr; i = i->next) {
-      if (strcmp(i->dirName, dir) == 0) {
-         const char* retval = ((i->mountPoint) ? i->mountPoint : "/");
-         __PHYSFS_platformReleaseMutex(stateLock);
-         return retval;
-      }
+PHYSFS_Dir* PHYSFS_openDir(const char* dirName) {
+   BAIL_IF(!dirName, PHYSFS_ERR_INVALID_ARGUMENT, nullptr);
+
+   auto dir = static_cast<PHYSFS_Dir*>(allocator.Malloc(sizeof(PHYSFS_Dir)));
+   BAIL_IF(not dir, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+   new (dir) PHYSFS_Dir {};
+
+   int merged = 0;
+   try { merged = mergeDirListing(dirName, &dir->listing); }
+   catch (...) {
+      PHYSFS_closeDir(dir);
+      throw;
    }
-   __PHYSFS_platformReleaseMutex(stateLock);
 
-   BAIL(PHYSFS_ERR_NOT_MOUNTED, nullptr);
+   if (not merged) {
+      PHYSFS_closeDir(dir);
+      return nullptr;
+   }
+   return dir;
 }
 
-void PHYSFS_getSearchPathCallback(PHYSFS_StringCallback callback, void* data) {
-   DirHandle* i;
+PHYSFS_sint64 PHYSFS_readDir(PHYSFS_Dir* dir, const char** names, PHYSFS_uint64 maxNames) {
+   BAIL_IF(!dir, PHYSFS_ERR_INVALID_ARGUMENT, -1);
+   BAIL_IF(!names and maxNames, PHYSFS_ERR_INVALID_ARGUMENT, -1);
 
-   __PHYSFS_platformGrabMutex(stateLock);
+   auto& listing = dir->listing;
+   PHYSFS_uint64 read = 0;
+   while (read < maxNames and not listing.Done()) {
+      names[read++] = listing.Current();
+      ++listing.pos;
+   }
+   return static_cast<PHYSFS_sint64>(read);
+}
 
-   for (i = searchPath; i != nullptr; i = i->next)
-      callback(data, i->dirName);
+void PHYSFS_closeDir(PHYSFS_Dir* dir) {
+   if (not dir)
+      return;
 
-   __PHYSFS_platformReleaseMutex(stateLock);
+   dir->~PHYSFS_Dir();
+   allocator.Free(dir);
 }
 
-typedef struct setSaneCfgEnumData
-{
-   const char* archiveExt;
-   size_t archiveExtLen;
-   int archivesFirst;
-   PHYSFS_ErrorCode errcode;
-} setSaneCfgEnumData;
+///                                                                           
+/// Built on a PHYSFS_Dir, so that the callback runs without stateLock, and   
+/// is free to open files, mount archives, or take its time                   
+///                                                                           
+int PHYSFS_enumerate(const char* _fn, PHYSFS_EnumerateCallback cb, void* data) {
+   BAIL_IF(!_fn, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(!cb, PHYSFS_ERR_INVALID_ARGUMENT, 0);
 
-static PHYSFS_EnumerateCallbackResult setSaneCfgEnumCallback(void* _data,
-   const char* dir, const char* f) {
-   setSaneCfgEnumData* data = (setSaneCfgEnumData*) _data;
-   const size_t extlen = data->archiveExtLen;
-   const size_t l = strlen(f);
-   const char* ext;
+   PHYSFS_Dir* dir = PHYSFS_openDir(_fn);
+   BAIL_IF_ERRPASS(not dir, 0);
 
-   if ((l > extlen) && (f[l - extlen - 1] == '.')) {
-      ext = f + (l - extlen);
-      if (PHYSFS_utf8stricmp(ext, data->archiveExt) == 0) {
-         const char dirsep = __PHYSFS_platformDirSeparator;
-         const char* d = PHYSFS_getRealDir(f);
-         const size_t allocsize = strlen(d) + l + 2;
-         char* str = (char*) __PHYSFS_smallAlloc(allocsize);
-         if (str == nullptr)
-            data->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
-         else {
-            snprintf(str, allocsize, "%s%c%s", d, dirsep, f);
-            if (!PHYSFS_mount(str, nullptr, data->archivesFirst == 0))
-               data->errcode = currentErrorCode();
-            __PHYSFS_smallFree(str);
-         }
+   PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
+   const char* names[64];
+   PHYSFS_sint64 count;
+   while (retval == PHYSFS_ENUM_OK
+      and (count = PHYSFS_readDir(dir, names, __PHYSFS_ARRAYLEN(names))) > 0) {
+      for (PHYSFS_sint64 n = 0; n < count and retval == PHYSFS_ENUM_OK; ++n) {
+         retval = cb(data, _fn, names[n]);
+         if (retval == PHYSFS_ENUM_ERROR)
+            PHYSFS_setErrorCode(PHYSFS_ERR_APP_CALLBACK);
       }
    }
 
-   /* !!! FIXME: if we want to abort on errors... */
-   /*return (data->errcode != PHYSFS_ERR_OK) ? PHYSFS_ENUM_ERROR : PHYSFS_ENUM_OK;*/
-
-   return PHYSFS_ENUM_OK;  /* keep going */
+   PHYSFS_closeDir(dir);
+   return (retval == PHYSFS_ENUM_ERROR) ? 0 : 1;
 }
 
-int PHYSFS_setSaneConfig(const char* organization, const char* appName,
-   const char* archiveExt, int includeCdRoms,
-   int archivesFirst) {
-   const char* basedir;
-   const char* prefdir;
-
-   BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+struct LegacyEnumFilesCallbackData {
+   PHYSFS_EnumFilesCallback callback;
+   void* data;
+};
 
-   prefdir = PHYSFS_getPrefDir(organization, appName);
-   BAIL_IF_ERRPASS(!prefdir, 0);
+static PHYSFS_EnumerateCallbackResult enumFilesCallbackAlwaysSucceed(
+   void* d, const char* origdir, const char* fname
+) {
+   LegacyEnumFilesCallbackData* cbdata = (LegacyEnumFilesCallbackData*) d;
+   cbdata->callback(cbdata->data, origdir, fname);
+   return PHYSFS_ENUM_OK;
+}
 
-   basedir = PHYSFS_getBaseDir();
-   BAIL_IF_ERRPASS(!basedir, 0);
+void PHYSFS_enumerateFilesCallback(
+   const char* fname, PHYSFS_EnumFilesCallback callback, void* data
+) {
+   LegacyEnumFilesCallbackData cbdata;
+   cbdata.callback = callback;
+   cbdata.data = data;
+   (void) PHYSFS_enumerate(fname, enumFilesCallbackAlwaysSucceed, &cbdata);
+}
 
-   BAIL_IF(!PHYSFS_setWriteDir(prefdir), PHYSFS_ERR_NO_WRITE_DIR, 0);
+int PHYSFS_exists(const char* fname) {
+   return (getRealDirHandle(fname) != nullptr);
+}
 
-   /* !!! FIXME: these can fail and we should report that... */
+PHYSFS_sint64 PHYSFS_getLastModTime(const char* fname) {
+   PHYSFS_Stat statbuf;
+   BAIL_IF_ERRPASS(!PHYSFS_stat(fname, &statbuf), -1);
+   return statbuf.modtime;
+}
 
-   /* Put write dir first in search path... */
-   PHYSFS_mount(prefdir, nullptr, 0);
+int PHYSFS_isDirectory(const char* fname) {
+   PHYSFS_Stat statbuf;
+   BAIL_IF_ERRPASS(!PHYSFS_stat(fname, &statbuf), 0);
+   return (statbuf.filetype == PHYSFS_FILETYPE_DIRECTORY);
+}
 
-   /* Put base path on search path... */
-   PHYSFS_mount(basedir, nullptr, 1);
+int PHYSFS_isSymbolicLink(const char* fname) {
+   PHYSFS_Stat statbuf;
+   BAIL_IF_ERRPASS(!PHYSFS_stat(fname, &statbuf), 0);
+   return (statbuf.filetype == PHYSFS_FILETYPE_SYMLINK);
+}
 
-   /* handle CD-ROMs... */
-   if (includeCdRoms) {
-      char** cds = PHYSFS_getCdRomDirs();
-      char** i;
-      for (i = cds; *i != nullptr; i++)
-         PHYSFS_mount(*i, nullptr, 1);
-      PHYSFS_freeList(cds);
+/// Wrap a freshly opened io in a FileHandle and register it in (context).    
+/// Call this after releasing stateLock; the caller must already have         
+/// raised dh->openFiles while still holding it                               
+static FileHandle* makeFileHandle(PHYSFS_Io* io, DirHandle* dh,
+   const PHYSFS_uint8 forReading, PHYSFS_Context& context) {
+   auto fh = (FileHandle*) allocator.Malloc(sizeof(FileHandle), PHYSFS_ALLOC_FILEHANDLE);
+   if (fh == nullptr) {
+      io->destroy(io);
+      __PHYSFS_ATOMIC_DECR(&dh->openFiles);
+      BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
    }
 
-   /* Root out archives, and add them to search path... */
-   if (archiveExt != nullptr) {
-      setSaneCfgEnumData data;
-      memset(&data, '\0', sizeof(data));
-      data.archiveExt = archiveExt;
-      data.archiveExtLen = strlen(archiveExt);
-      data.archivesFirst = archivesFirst;
-      data.errcode = PHYSFS_ERR_OK;
-      if (!PHYSFS_enumerate("/", setSaneCfgEnumCallback, &data)) {
-         /* !!! FIXME: use this if we're reporting errors.
-         PHYSFS_ErrorCode errcode = currentErrorCode();
-         if (errcode == PHYSFS_ERR_APP_CALLBACK)
-             errcode = data->errcode; */
+   memset(fh, '\0', sizeof(FileHandle));
+   fh->io = io;
+   fh->forReading = forReading;
+   fh->dirHandle = dh;
+   fh->context = &context;
+
+   // Streams that can't read positionally (compressed ones, mostly)    
+   // get their PHYSFS_readAt calls serialized                          
+   if (forReading and not __PHYSFS_ioCanReadAt(io)) {
+      fh->atLock = __PHYSFS_platformCreateMutex();
+      if (not fh->atLock) {
+         io->destroy(io);
+         allocator.Free(fh);
+         __PHYSFS_ATOMIC_DECR(&dh->openFiles);
+         BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
       }
    }
 
-   return 1;
+   registerFileHandle(fh);
+   return fh;
 }
 
-void PHYSFS_permitSymbolicLinks(int allow) {
-   allowSymLinks = allow;
-}
+static PHYSFS_File* doOpenWrite(const char* _fname, const int appending) {
+   auto& context = ctx();
+   FileHandle* fh = nullptr;
+   PHYSFS_Io* io = nullptr;
+   DirHandle* h;
+   size_t len;
+   char* fname;
 
-int PHYSFS_symbolicLinksPermitted(void) {
-   return allowSymLinks;
-}
+   BAIL_IF(!_fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
 
-///                                                                           
-/// Verify that (fname) (in platform-independent notation), in relation       
-/// to (h) is secure. That means that each element of fname is checked        
-/// for symlinks (if they aren't permitted). This also allows for quick       
-/// rejection of files that exist outside an archive's mountpoint.            
-///                                                                           
-/// With some exceptions (like PHYSFS_mkdir(), which builds multiple subdirs  
-/// at a time), you should always pass zero for "allowMissing" for efficiency.
-///                                                                           
-/// (fname) must point to an output from sanitizePlatformIndependentPath(),   
-/// since it will make sure that path names are in the right format for       
-/// passing certain checks. It will also do checks for "insecure" pathnames   
-/// like ".." which should be done once instead of once per archive. This also
-/// gives us license to treat (fname) as scratch space in this function.      
-///                                                                           
-/// (fname)'s buffer must have enough space available before it for this      
-/// function to prepend any root directory for this DirHandle.                
-///                                                                           
-/// Returns non-zero if string is safe, zero if there's a security issue.     
-/// PHYSFS_getLastError() will specify what was wrong. (*fname) will be       
-/// updated to point past any mount point elements so it is prepared to       
-/// be used with the archiver directly.                                       
-///                                                                           
-static int verifyPath(DirHandle* h, char** _fname, int allowMissing) {
-   char* fname = *_fname;
-   int retval = 1;
-   char* start;
-   char* end;
+   __PHYSFS_platformGrabMutex(context.stateLock);
+   h = context.writeDir;
+   BAIL_IF_MUTEX(!h, PHYSFS_ERR_NO_WRITE_DIR, context.stateLock, 0);
 
-   if (*fname == '\0' and not h->root)  // Quick rejection              
-      return 1;
+   len = strlen(_fname) + dirHandleRootLen(h) + 1;
+   fname = (char*) __PHYSFS_smallAlloc(len);
+   BAIL_IF_MUTEX(!fname, PHYSFS_ERR_OUT_OF_MEMORY, context.stateLock, 0);
 
-   /* !!! FIXME: This codeblock sucks. */
-   if (h->mountPoint != nullptr)  /* nullptr mountpoint means "/". */
-   {
-      size_t mntpntlen = strlen(h->mountPoint);
-      size_t len = strlen(fname);
-      assert(mntpntlen > 1); /* root mount points should be nullptr. */
-      /* not under the mountpoint, so skip this archive. */
-      BAIL_IF(len < mntpntlen - 1, PHYSFS_ERR_NOT_FOUND, 0);
-      /* !!! FIXME: Case insensitive? */
-      retval = strncmp(h->mountPoint, fname, mntpntlen - 1);
-      BAIL_IF(retval != 0, PHYSFS_ERR_NOT_FOUND, 0);
-      if (len > mntpntlen - 1)  /* corner case... */
-         BAIL_IF(fname[mntpntlen - 1] != '/', PHYSFS_ERR_NOT_FOUND, 0);
-      fname += mntpntlen - 1;  /* move to start of actual archive path. */
-      if (*fname == '/')
-         fname++;
-      *_fname = fname;  /* skip mountpoint for later use. */
-      retval = 1;  /* may be reset, below. */
-   } /* if */
+   if (sanitizePlatformIndependentPathWithRoot(h, _fname, fname)) {
+      char* arcfname = fname;
+      if (verifyPath(h, &arcfname, 0)) {
+         const PHYSFS_Archiver* f = h->funcs;
+         if (appending)
+            io = f->openAppend(h->opaque, arcfname);
+         else
+            io = f->openWrite(h->opaque, arcfname);
 
-   // Prepend the root directory, if any                                
-   if (h->root) {
-      const int isempty = (*fname == '\0');
-      fname -= h->rootlen + (isempty ? 0 : 1);
-      strcpy(fname, h->root);
-      if (!isempty)
-         fname[h->rootlen] = '/';
-      *_fname = fname;
+         // Pin the write dir before anyone can swap it out             
+         if (io)
+            __PHYSFS_ATOMIC_INCR(&h->openFiles);
+      }
    }
+   __PHYSFS_platformReleaseMutex(context.stateLock);
+   __PHYSFS_smallFree(fname);
 
-   start = fname;
-   if (not allowSymLinks) {
-      while (1) {
-         end = strchr(start, '/');
-         if (end)
-            *end = '\0';
-
-         PHYSFS_Stat statbuf;
-         auto rc = h->funcs->stat(h->opaque, fname, &statbuf);
-         if (rc)
-            rc = (statbuf.filetype == PHYSFS_FILETYPE_SYMLINK);
-         else if (currentErrorCode() == PHYSFS_ERR_NOT_FOUND)
-            retval = 0;
+   if (io)
+      fh = makeFileHandle(io, h, 0, context);
+   return ((PHYSFS_File*) fh);
+}
 
-         if (end)
-            *end = '/';
+PHYSFS_File* PHYSFS_openWrite(const char* filename) {
+   return doOpenWrite(filename, 0);
+}
 
-         // Insecure path (has a disallowed symlink in it)?             
-         BAIL_IF(rc, PHYSFS_ERR_SYMLINK_FORBIDDEN, 0);
+PHYSFS_File* PHYSFS_openAppend(const char* filename) {
+   return doOpenWrite(filename, 1);
+}
 
-         // Break out early if path element is missing                  
-         if (not retval) {
-            // We need to clear it if it's the last element of the path,
-            // since this might be a non-existant file we're opening    
-            // for writing...                                           
-            if (not end or allowMissing)
-               retval = 1;
-            break;
-         }
+static void presetStatEx(PHYSFS_StatEx*) noexcept;
+
+/// Open (name) in (dh) for PHYSFS_openReadDirect. A directory's file gets a  
+/// direct io, and so does an entry stored as-is in an archive file on disk,  
+/// through a window onto a direct io of the whole archive. Anything else     
+/// (compressed, encrypted, in memory or nested) opens the usual way          
+static PHYSFS_Io* archiveOpenReadDirect(const DirHandle* dh, const char* name) {
+#if PHYSFS_HAVE_DIRECT_IO
+   if (dh->funcs == &__PHYSFS_Archiver_DIR)
+      return __PHYSFS_DirOpenReadDirect(dh->opaque, name);
+
+   if (dh->physical and dh->funcs->version >= 1 and dh->funcs->statEx) {
+      PHYSFS_StatEx st;
+      presetStatEx(&st);
+      bool found = false;
+      try {
+         ArchiveLock lock {dh};
+         found = dh->funcs->statEx(dh->opaque, name, &st);
+      }
+      catch (const MetaPhysFS::Exception<PHYSFS_ERR_NOT_FOUND>&) {}
 
-         if (not end)
-            break;
+      if (found and st.stat.filetype == PHYSFS_FILETYPE_REGULAR
+      and st.mappable and st.contiguous and not st.encrypted
+      and st.offset >= 0 and st.storedSize >= 0) {
+         auto io = __PHYSFS_createNativeIo(dh->dirName, 'd');
+         BAIL_IF_ERRPASS(not io, nullptr);
 
-         start = end + 1;
+         PHYSFS_Io* retval = nullptr;
+         try { retval = createWindowIo(io, st.offset, st.storedSize); }
+         catch (...) {
+            io->destroy(io);
+            throw;
+         }
+         if (not retval)
+            io->destroy(io);
+         return retval;
       }
    }
+#endif
 
-   return retval;
+   return archiveOpenRead(dh, name);
 }
 
+/// Shared by PHYSFS_openRead and PHYSFS_openReadDirect, which only differ in 
+/// how the archive that has the file is asked for it                         
+static PHYSFS_File* doOpenRead(const char* _fname, const bool direct) {
+   auto& context = ctx();
+   const auto openIn = direct ? archiveOpenReadDirect : archiveOpenRead;
+   FileHandle* fh = nullptr;
+   PHYSFS_Io* io = nullptr;
+   DirHandle* i = nullptr;
+   bool pinned = false;
+   char* allocated_fname;
+   char* fname;
+   size_t len;
 
-/// This must hold the stateLock before calling                               
-static int doMkdir(const char* _dname, char* dname) {
-   DirHandle* h = writeDir;
-   char* start;
-   char* end;
-   int retval = 0;
-   int exists = 1;  // Force existance check on first path element      
+   BAIL_IF(!_fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
 
-   assert(h != nullptr);
+   IoUnderStateLock scope;
+   __PHYSFS_platformGrabMutex(context.stateLock);
 
-   BAIL_IF_ERRPASS(!sanitizePlatformIndependentPathWithRoot(h, _dname, dname), 0);
-   BAIL_IF_ERRPASS(!verifyPath(h, &dname, 1), 0);
+   BAIL_IF_MUTEX(!context.searchPath, PHYSFS_ERR_NOT_FOUND, context.stateLock, 0);
 
-   start = dname;
-   while (1) {
-      end = strchr(start, '/');
-      if (end)
-         *end = '\0';
+   len = strlen(_fname) + context.longest_root + 2;
+   allocated_fname = (char*) __PHYSFS_smallAlloc(len);
+   BAIL_IF_MUTEX(!allocated_fname, PHYSFS_ERR_OUT_OF_MEMORY, context.stateLock, 0);
+   fname = allocated_fname + context.longest_root + 1;
+
+   // A failed open mustn't leave stateLock held: on any other thread,  
+   // that would stall every open and mount from then on                
+   try {
+      if (sanitizePlatformIndependentPath(_fname, fname)) {
+         for (i = context.searchPath; i != nullptr; i = i->next) {
+            char* arcfname = fname;
+            if (not verifyPath(i, &arcfname, 0))
+               continue;
+
+            if (not concurrentOpenRead(i)) {
+               io = openIn(i, arcfname);
+               if (io)
+                  break;
+               continue;
+            }
 
-      // Only check for existance if all parent dirs existed, too...    
-      if (exists) {
-         PHYSFS_Stat statbuf;
-         const int rc = h->funcs->stat(h->opaque, dname, &statbuf);
-         if ((!rc) && (currentErrorCode() == PHYSFS_ERR_NOT_FOUND))
-            exists = 0;
+            // The archive is pinned, so it stays mounted, and in the   
+            // search path, while stateLock is let go for the open      
+            __PHYSFS_ATOMIC_INCR(&i->openFiles);
+            __PHYSFS_platformReleaseMutex(context.stateLock);
+            try {
+               IoOutsideStateLock outside;
+               io = openIn(i, arcfname);
+            }
+            catch (...) {
+               __PHYSFS_platformGrabMutex(context.stateLock);
+               __PHYSFS_ATOMIC_DECR(&i->openFiles);
+               throw;
+            }
+            __PHYSFS_platformGrabMutex(context.stateLock);
 
-         /* verifyPath made sure that (dname) doesn't have symlinks if they aren't
-            allowed, but it's possible the mounted writeDir itself has symlinks in it,
-            (for example "/var" on iOS is a symlink, and the prefpath will be somewhere
-            under that)...if we mounted that writeDir, we must allow those symlinks here
-            unconditionally. */
-         retval = ((rc) && ((statbuf.filetype == PHYSFS_FILETYPE_DIRECTORY) || (statbuf.filetype == PHYSFS_FILETYPE_SYMLINK)));
-      }
+            if (io) {
+               pinned = true;
+               break;
+            }
+            __PHYSFS_ATOMIC_DECR(&i->openFiles);
+         }
 
-      if (not exists)
-         retval = h->funcs->mkdir(h->opaque, dname);
+         // Pin the archive before anyone can unmount it                
+         if (io and not pinned)
+            __PHYSFS_ATOMIC_INCR(&i->openFiles);
+      }
+   }
+   catch (...) {
+      __PHYSFS_platformReleaseMutex(context.stateLock);
+      __PHYSFS_smallFree(allocated_fname);
+      throw;
+   }
 
-      if (not retval or not end)
-         break;
+   __PHYSFS_platformReleaseMutex(context.stateLock);
+   __PHYSFS_smallFree(allocated_fname);
 
-      *end = '/';
-      start = end + 1;
+   // Archives read through an io scheduled at mount; a directory's     
+   // files are opened one by one, so they join its scheduler here      
+   if (io and i->scheduler and i->funcs == &__PHYSFS_Archiver_DIR) {
+      PHYSFS_Io* scheduled;
+      try { scheduled = scheduleIo(io, i->scheduler); }
+      catch (...) {
+         io->destroy(io);
+         __PHYSFS_ATOMIC_DECR(&i->openFiles);
+         throw;
+      }
+      if (not scheduled) {
+         io->destroy(io);
+         __PHYSFS_ATOMIC_DECR(&i->openFiles);
+         return nullptr;
+      }
+      io = scheduled;
    }
 
-   return retval;
+   if (io)
+      fh = makeFileHandle(io, i, 1, context);
+   return ((PHYSFS_File*) fh);
 }
 
-int PHYSFS_mkdir(const char* _dname) {
-   int retval = 0;
-   char* dname;
-   size_t len;
-
-   BAIL_IF(!_dname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-
-   __PHYSFS_platformGrabMutex(stateLock);
-   BAIL_IF_MUTEX(!writeDir, PHYSFS_ERR_NO_WRITE_DIR, stateLock, 0);
-   len = strlen(_dname) + dirHandleRootLen(writeDir) + 1;
-   dname = (char*) __PHYSFS_smallAlloc(len);
-   BAIL_IF_MUTEX(!dname, PHYSFS_ERR_OUT_OF_MEMORY, stateLock, 0);
-   retval = doMkdir(_dname, dname);
-   __PHYSFS_platformReleaseMutex(stateLock);
-   __PHYSFS_smallFree(dname);
-   return retval;
+PHYSFS_File* PHYSFS_openRead(const char* filename) {
+   return doOpenRead(filename, false);
 }
 
-/// This must hold the stateLock before calling                               
-static int doDelete(const char* _fname, char* fname) {
-   DirHandle* h = writeDir;
-   BAIL_IF_ERRPASS(!sanitizePlatformIndependentPathWithRoot(h, _fname, fname), 0);
-   BAIL_IF_ERRPASS(!verifyPath(h, &fname, 0), 0);
-   return h->funcs->remove(h->opaque, fname);
+PHYSFS_File* PHYSFS_openReadDirect(const char* filename) {
+   return doOpenRead(filename, true);
 }
 
-int PHYSFS_delete(const char* _fname) {
-   int retval;
-   char* fname;
-   size_t len;
-
-   __PHYSFS_platformGrabMutex(stateLock);
-   BAIL_IF_MUTEX(!writeDir, PHYSFS_ERR_NO_WRITE_DIR, stateLock, 0);
-   len = strlen(_fname) + dirHandleRootLen(writeDir) + 1;
-   fname = (char*) __PHYSFS_smallAlloc(len);
-   BAIL_IF_MUTEX(!fname, PHYSFS_ERR_OUT_OF_MEMORY, stateLock, 0);
-   retval = doDelete(_fname, fname);
-   __PHYSFS_platformReleaseMutex(stateLock);
-   __PHYSFS_smallFree(fname);
-   return retval;
+/// Picked up by the archivers whenever they open an entry, in the context    
+/// the open works in                                                         
+int PHYSFS_setReadAhead(PHYSFS_uint64 minSize) {
+#if PHYSFS_HAVE_READ_AHEAD
+   ctx().readAheadMinSize.store(minSize, std::memory_order_relaxed);
+   return 1;
+#else
+   (void) minSize;
+   BAIL(PHYSFS_ERR_UNSUPPORTED, 0);
+#endif
 }
 
-static DirHandle* getRealDirHandle(const char* _fname) {
-   DirHandle* retval = nullptr;
-   char* allocated_fname = nullptr;
-   char* fname = nullptr;
-   size_t len;
-
-   BAIL_IF(!_fname, PHYSFS_ERR_INVALID_ARGUMENT, nullptr);
-
-   __PHYSFS_platformGrabMutex(stateLock);
-   len = strlen(_fname) + longest_root + 2;
-   allocated_fname = __PHYSFS_smallAlloc(len);
-   BAIL_IF_MUTEX(!allocated_fname, PHYSFS_ERR_OUT_OF_MEMORY, stateLock, nullptr);
-   fname = allocated_fname + longest_root + 1;
-   if (sanitizePlatformIndependentPath(_fname, fname)) {
-      DirHandle* i;
-      for (i = searchPath; i != nullptr; i = i->next) {
-         char* arcfname = fname;
-         if (partOfMountPoint(i, arcfname)) {
-            retval = i;
-            break;
-         } /* if */
-         else if (verifyPath(i, &arcfname, 0)) {
-            PHYSFS_Stat statbuf;
-            if (i->funcs->stat(i->opaque, arcfname, &statbuf)) {
-               retval = i;
-               break;
-            } /* if */
-         } /* if */
-      } /* for */
-   } /* if */
-
-   __PHYSFS_platformReleaseMutex(stateLock);
-   __PHYSFS_smallFree(allocated_fname);
-   return retval;
+/// Snapshotted by the archivers that inline, as they mount in this context   
+int PHYSFS_setInlineSmallFiles(PHYSFS_uint32 maxFileSize, PHYSFS_uint64 maxBytes) {
+   auto& context = ctx();
+   context.inlineMaxFileSize.store(maxFileSize, std::memory_order_relaxed);
+   context.inlineMaxBytes.store(maxBytes, std::memory_order_relaxed);
+   return 1;
 }
 
-const char* PHYSFS_getRealDir(const char* fname) {
-   DirHandle* dh = getRealDirHandle(fname);
-   return dh ? dh->dirName : nullptr;
+PHYSFS_uint32 __PHYSFS_inlineMaxFileSize(PHYSFS_uint64* maxBytes) {
+   auto& context = ctx();
+   *maxBytes = context.inlineMaxBytes.load(std::memory_order_relaxed);
+   return *maxBytes ? context.inlineMaxFileSize.load(std::memory_order_relaxed) : 0;
 }
 
-static int locateInStringList(const char* str,
-   char** list,
-   PHYSFS_uint32* pos) {
-   PHYSFS_uint32 len = *pos;
-   PHYSFS_uint32 half_len;
-   PHYSFS_uint32 lo = 0;
-   PHYSFS_uint32 middle;
-   int cmp;
+/// The pack writer lives with the archiver, and goes where it goes           
+#if not PHYSFS_SUPPORTS_MPK
+int PHYSFS_writePack(const char*, const char*, const PHYSFS_PackOptions*) {
+   BAIL(PHYSFS_ERR_UNSUPPORTED, 0);
+}
+#endif
 
-   while (len > 0) {
-      half_len = len >> 1;
-      middle = lo + half_len;
-      cmp = strcmp(list[middle], str);
+///                                                                           
+/// Transactions. A transacted file is written to a temporary next to its     
+/// target, without the sync on close. A commit syncs all the temporaries at  
+/// once, then writes and syncs a record of the renames still to be done,     
+/// then does those renames and syncs the directories they were done in.      
+/// The record is what makes it all or nothing: it only reaches the disk      
+/// after the data it covers, and if it's found at the next setWriteDir (or   
+/// the next commit), its renames are finished                                
+///                                                                           
+namespace
+{
+   constexpr char CommitRecordName[] = ".metaphysfs-commit";
+   constexpr char TransactedSuffix[] = ".~txn";
+
+   struct TransactedFile {
+      char* name;                      // Target, relative to the dir   
+      char* temp;                      // Temporary, relative as well   
+   };
+
+   std::atomic<PHYSFS_uint32> transactionIds {0};
+}
+
+struct PHYSFS_Transaction {
+   DirHandle* dir;                     // The write dir, pinned         
+   PHYSFS_Context* context;            // Where it was begun            
+   TransactedFile* files;
+   size_t count;
+   size_t capacity;
+   PHYSFS_uint32 id;
+   std::atomic<int> openFiles;
+
+   // Commit state, guarded by the commit queue's mutex                 
+   PHYSFS_Transaction* nextQueued;
+   PHYSFS_Transaction* nextCommitting;
+   PHYSFS_ErrorCode result;
+   bool pending;                       // Left to recoverCommit         
+   bool done;
+};
 
-      if (cmp == 0)  // It's in the list already                        
-         return 1;
-      else if (cmp > 0)
-         len = half_len;
-      else {
-         lo = middle + 1;
-         len -= half_len + 1;
+namespace
+{
+   /// Platform-dependent path of (name) in the write dir (dir)               
+   char* transactedPath(const DirHandle* dir, const char* name) {
+      const auto base = static_cast<const char*>(dir->opaque);
+      const auto baselen = strlen(base);
+      auto retval = static_cast<char*>(allocator.Malloc(baselen + strlen(name) + 1));
+      BAIL_IF(not retval, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+      strcpy(retval, base);
+      strcpy(retval + baselen, name);
+      if constexpr (__PHYSFS_platformDirSeparator != '/') {
+         for (auto p = strchr(retval + baselen, '/'); p; p = strchr(p + 1, '/'))
+            *p = __PHYSFS_platformDirSeparator;
       }
+      return retval;
    }
 
-   *pos = lo;
-   return 0;
-}
-
-static PHYSFS_EnumerateCallbackResult enumFilesCallback(
-   void* data, const char* origdir, const char* str
-) {
-   PHYSFS_uint32 pos;
-   void* ptr;
-   char* newstr;
-   EnumStringListCallbackData* pecd = (EnumStringListCallbackData*) data;
+   /// Delete whatever temporaries are left, and unpin the write dir          
+   void freeTransaction(PHYSFS_Transaction* txn, bool removeTemps) {
+      for (size_t i = 0; i < txn->count; ++i) {
+         if (removeTemps) {
+            if (auto path = transactedPath(txn->dir, txn->files[i].temp)) {
+               try { __PHYSFS_platformDelete(path); }
+               catch (...) {}
+               allocator.Free(path);
+            }
+         }
+         allocator.Free(txn->files[i].name);
+         allocator.Free(txn->files[i].temp);
+      }
 
-   // See if file is in the list already, and if not, insert it in there
-   // alphabetically...                                                 
-   pos = pecd->size;
-   if (locateInStringList(str, pecd->list, &pos))
-      return PHYSFS_ENUM_OK;  // Already in the list, but keep going    
+      allocator.Free(txn->files);
+      __PHYSFS_ATOMIC_DECR(&txn->dir->openFiles);
+      txn->~PHYSFS_Transaction();
+      allocator.Free(txn);
+   }
 
-   ptr = allocator.Realloc(pecd->list, (pecd->size + 2) * sizeof(char*));
-   newstr = (char*) allocator.Malloc(strlen(str) + 1);
-   if (ptr != nullptr)
-      pecd->list = (char**) ptr;
+   /// A transacted file closes like any other, except that it isn't synced:  
+   /// the commit does that for the whole transaction at once                 
+   struct TransactedIoInfo {
+      PHYSFS_Io* io;
+      PHYSFS_Transaction* txn;
+   };
 
-   if ((ptr == nullptr) || (newstr == nullptr)) {
-      if (newstr)
-         allocator.Free(newstr);
+   PHYSFS_sint64 transactedIo_read(PHYSFS_Io* io, void* buf, PHYSFS_uint64 len) {
+      auto inner = static_cast<TransactedIoInfo*>(io->opaque)->io;
+      return inner->read(inner, buf, len);
+   }
 
-      pecd->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
-      return PHYSFS_ENUM_ERROR;  /* better luck next time. */
+   PHYSFS_sint64 transactedIo_write(PHYSFS_Io* io, const void* buf, PHYSFS_uint64 len) {
+      auto inner = static_cast<TransactedIoInfo*>(io->opaque)->io;
+      return inner->write(inner, buf, len);
    }
 
-   strcpy(newstr, str);
+   int transactedIo_seek(PHYSFS_Io* io, PHYSFS_uint64 offset) {
+      auto inner = static_cast<TransactedIoInfo*>(io->opaque)->io;
+      return inner->seek(inner, offset);
+   }
 
-   if (pos != pecd->size) {
-      memmove(&pecd->list[pos + 1], &pecd->list[pos],
-         sizeof(char*) * ((pecd->size) - pos));
+   PHYSFS_sint64 transactedIo_tell(PHYSFS_Io* io) {
+      auto inner = static_cast<TransactedIoInfo*>(io->opaque)->io;
+      return inner->tell(inner);
    }
 
-   pecd->list[pos] = newstr;
-   pecd->size++;
-   return PHYSFS_ENUM_OK;
-}
+   PHYSFS_sint64 transactedIo_length(PHYSFS_Io* io) {
+      auto inner = static_cast<TransactedIoInfo*>(io->opaque)->io;
+      return inner->length(inner);
+   }
 
-char** PHYSFS_enumerateFiles(const char* path) {
-   EnumStringListCallbackData ecd;
-   memset(&ecd, '\0', sizeof(ecd));
-   ecd.list = (char**) allocator.Malloc(sizeof(char*));
-   BAIL_IF(!ecd.list, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
-   if (!PHYSFS_enumerate(path, enumFilesCallback, &ecd)) {
-      const PHYSFS_ErrorCode errcode = currentErrorCode();
-      PHYSFS_uint32 i;
-      for (i = 0; i < ecd.size; i++)
-         allocator.Free(ecd.list[i]);
-      allocator.Free(ecd.list);
-      BAIL_IF(errcode == PHYSFS_ERR_APP_CALLBACK, ecd.errcode, nullptr);
-      return nullptr;
+   PHYSFS_Io* transactedIo_duplicate(PHYSFS_Io*) {
+      BAIL(PHYSFS_ERR_UNSUPPORTED, nullptr);
    }
 
-   ecd.list[ecd.size] = nullptr;
-   return ecd.list;
-}
+   int transactedIo_flush(PHYSFS_Io*) {
+      return 1;
+   }
 
-/// Broke out to seperate function so we can use stack allocation gratuitously
-static PHYSFS_EnumerateCallbackResult enumerateFromMountPoint(DirHandle* i,
-   const char* arcfname,
-   PHYSFS_EnumerateCallback callback,
-   const char* _fname, void* data) {
-   PHYSFS_EnumerateCallbackResult retval;
-   const size_t len = strlen(arcfname);
-   char* ptr = nullptr;
-   char* end = nullptr;
-   const size_t slen = strlen(i->mountPoint) + 1;
-   char* mountPoint = (char*) __PHYSFS_smallAlloc(slen);
+   void transactedIo_destroy(PHYSFS_Io* io) {
+      auto info = static_cast<TransactedIoInfo*>(io->opaque);
+      info->io->destroy(info->io);
+      info->txn->openFiles.fetch_sub(1, std::memory_order_release);
+      allocator.Free(info);
+      allocator.Free(io);
+   }
 
-   BAIL_IF(!mountPoint, PHYSFS_ERR_OUT_OF_MEMORY, PHYSFS_ENUM_ERROR);
+   const PHYSFS_Io transactedIoInterface =
+   {
+      CURRENT_PHYSFS_IO_API_VERSION, nullptr,
+      transactedIo_read,
+      transactedIo_write,
+      transactedIo_seek,
+      transactedIo_tell,
+      transactedIo_length,
+      transactedIo_duplicate,
+      transactedIo_flush,
+      transactedIo_destroy,
+      nullptr
+   };
+
+   /// Platform-dependent paths, with the duplicates left out                 
+   struct PathList {
+      char** paths = nullptr;
+      size_t count = 0;
+      size_t capacity = 0;
+
+      ~PathList() {
+         for (size_t i = 0; i < count; ++i)
+            allocator.Free(paths[i]);
+         allocator.Free(paths);
+      }
 
-   strcpy(mountPoint, i->mountPoint);
-   ptr = mountPoint + ((len) ? len + 1 : 0);
-   end = strchr(ptr, '/');
-   assert(end);  // Should always find a terminating '/'                
-   *end = '\0';
-   retval = callback(data, _fname, ptr);
-   __PHYSFS_smallFree(mountPoint);
+      /// Takes (path) over, even on failure                                  
+      bool Add(char* path) {
+         if (not path)
+            return false;
+         for (size_t i = 0; i < count; ++i) {
+            if (strcmp(paths[i], path) == 0) {
+               allocator.Free(path);
+               return true;
+            }
+         }
 
-   BAIL_IF(retval == PHYSFS_ENUM_ERROR, PHYSFS_ERR_APP_CALLBACK, retval);
-   return retval;
-}
+         if (count == capacity) {
+            const auto newCapacity = capacity ? capacity * 2 : 16;
+            auto grown = static_cast<char**>(allocator.Realloc(paths, newCapacity * sizeof(char*)));
+            if (not grown) {
+               allocator.Free(path);
+               return false;
+            }
+            paths = grown;
+            capacity = newCapacity;
+         }
+         paths[count++] = path;
+         return true;
+      }
 
-struct SymlinkFilterData {
-   PHYSFS_EnumerateCallback callback;
-   void* callbackData;
-   DirHandle* dirhandle;
-   const char* arcfname;
-   PHYSFS_ErrorCode errcode;
-};
+      /// Add the directory (path) is in                                      
+      bool AddParent(const char* path) {
+         auto sep = strrchr(path, __PHYSFS_platformDirSeparator);
+         if (not sep)
+            return true;
+         const auto len = size_t(sep - path);
+         auto parent = static_cast<char*>(allocator.Malloc(len + 2));
+         if (not parent)
+            return false;
+         memcpy(parent, path, len);
+         parent[len] = len ? '\0' : __PHYSFS_platformDirSeparator;
+         parent[len ? len : 1] = '\0';
+         return Add(parent);
+      }
 
-static PHYSFS_EnumerateCallbackResult enumCallbackFilterSymLinks(
-   void* _data, const char* origdir, const char* fname
-) {
-   SymlinkFilterData* data = (SymlinkFilterData*) _data;
-   const DirHandle* dh = data->dirhandle;
-   const char* arcfname = data->arcfname;
-   PHYSFS_Stat statbuf;
-   const char* trimmedDir = (*arcfname == '/') ? (arcfname + 1) : arcfname;
-   const size_t slen = strlen(trimmedDir) + strlen(fname) + 2;
-   char* path = (char*) __PHYSFS_smallAlloc(slen);
-   PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
+      bool Sync() const {
+         return count == 0 or __PHYSFS_platformSync(paths, count);
+      }
+   };
+
+   /// Do the renames a commit record lists. Missing temporaries were         
+   /// renamed already, before whatever cut the commit short                  
+   bool finishRenames(const DirHandle* dir, const char* record, size_t size, PathList& dirs) {
+      bool ok = true;
+      for (auto p = record; p < record + size; ) {
+         const auto name = p;
+         const auto temp = name + strlen(name) + 1;
+         p = temp + strlen(temp) + 1;
+
+         auto from = transactedPath(dir, temp);
+         auto to = transactedPath(dir, name);
+         PHYSFS_Stat statbuf;
+         bool exists = false;
+         bool renamed = false;
+         try {
+            exists = from and to and __PHYSFS_platformStat(from, &statbuf, 0);
+            renamed = exists and __PHYSFS_platformRename(from, to);
+         }
+         catch (...) {}
 
-   if (path == nullptr) {
-      data->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
-      return PHYSFS_ENUM_ERROR;
+         ok = ok and from and to and (renamed or not exists);
+         if (to)
+            ok = dirs.AddParent(to) and ok;
+         allocator.Free(from);
+         allocator.Free(to);
+      }
+      return ok;
    }
 
-   snprintf(path, slen, "%s%s%s", trimmedDir, *trimmedDir ? "/" : "", fname);
-
-   if (!dh->funcs->stat(dh->opaque, path, &statbuf)) {
-      data->errcode = currentErrorCode();
-      retval = PHYSFS_ENUM_ERROR;
-   }
-   else {
-      // Pass it on to the application if it's not a symlink            
-      if (statbuf.filetype != PHYSFS_FILETYPE_SYMLINK) {
-         retval = data->callback(data->callbackData, origdir, fname);
-         if (retval == PHYSFS_ENUM_ERROR)
-            data->errcode = PHYSFS_ERR_APP_CALLBACK;
+   /// Read a commit record, checking its hash. Returns the pairs of names    
+   /// it lists, without the hash, or nullptr if there's no good record.      
+   /// (exists) tells whether there's any at all                              
+   char* readCommitRecord(const char* path, size_t& size, bool& exists) {
+      PHYSFS_Io* io = nullptr;
+      try { io = __PHYSFS_createNativeIo(path, 'r'); }
+      catch (...) {}
+      exists = io != nullptr;
+      if (not io)
+         return nullptr;
+
+      const auto length = io->length(io);
+      char* retval = nullptr;
+      if (length > PHYSFS_sint64(sizeof(PHYSFS_uint64))) {
+         size = size_t(length) - sizeof(PHYSFS_uint64);
+         retval = static_cast<char*>(allocator.Malloc(size + sizeof(PHYSFS_uint64)));
+         PHYSFS_uint64 hash;
+         bool read = false;
+         try { read = retval and __PHYSFS_readAll(io, retval, size_t(length)); }
+         catch (...) {}
+         if (read) {
+            memcpy(&hash, retval + size, sizeof(hash));
+            if (PHYSFS_swapLE(hash) != __PHYSFS_fnv1a(__PHYSFS_FNV_BASIS, retval, size) or retval[size - 1] != '\0') {
+               allocator.Free(retval);
+               retval = nullptr;
+            }
+         }
+         else {
+            allocator.Free(retval);
+            retval = nullptr;
+         }
       }
+      io->destroy(io);
+      return retval;
    }
 
-   __PHYSFS_smallFree(path);
-   return retval;
-}
+   /// Commit a group of transactions, setting each one's (result). They      
+   /// all write to the directory of the first one's write dir, which every   
+   /// one of them keeps pinned until it's done                               
+   void commitGroup(PHYSFS_Transaction* group) {
+      const auto dir = group->dir;
+      auto error = PHYSFS_ERR_OK;
+      char* recordPath = nullptr;
+      char* record = nullptr;
+      bool recorded = false;
+      bool durable = false;
+      bool renamed = false;
+
+      try {
+         // The record: a target and its temporary per file, in commit  
+         // order so the last one to write a file wins, then a hash     
+         size_t size = sizeof(PHYSFS_uint64);
+         for (auto txn = group; txn; txn = txn->nextQueued) {
+            for (size_t i = 0; i < txn->count; ++i)
+               size += strlen(txn->files[i].name) + strlen(txn->files[i].temp) + 2;
+         }
 
-int PHYSFS_enumerate(const char* _fn, PHYSFS_EnumerateCallback cb, void* data) {
-   PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
-   size_t len;
-   char* allocated_fname;
-   char* fname;
+         PathList toSync;
+         recordPath = transactedPath(dir, CommitRecordName);
+         record = static_cast<char*>(allocator.Malloc(size));
+
+         // A record left by a commit whose renames failed has to be    
+         // finished first: ours would take its place                   
+         bool ok = recordPath and record and recoverCommit(dir);
+         auto at = record;
+         for (auto txn = group; ok and txn; txn = txn->nextQueued) {
+            for (size_t i = 0; ok and i < txn->count; ++i) {
+               for (auto part : {txn->files[i].name, txn->files[i].temp}) {
+                  const auto len = strlen(part) + 1;
+                  memcpy(at, part, len);
+                  at += len;
+               }
+               auto temp = transactedPath(dir, txn->files[i].temp);
+               ok = temp and toSync.AddParent(temp);
+               ok = toSync.Add(temp) and ok;
+            }
+         }
 
-   BAIL_IF(!_fn, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-   BAIL_IF(!cb, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+         // One sync for the data of every file, and the directories    
+         // they were created in. The record mustn't reach the disk     
+         // before them, or a crash could leave it covering files       
+         // that never made it                                          
+         ok = ok and toSync.Sync();
+
+         if (ok) {
+            const auto hash = PHYSFS_swapLE(__PHYSFS_fnv1a(__PHYSFS_FNV_BASIS, record, size - sizeof(PHYSFS_uint64)));
+            memcpy(at, &hash, sizeof(hash));
+
+            auto io = __PHYSFS_createNativeIo(recordPath, 'w');
+            recorded = io != nullptr;
+            if (io) {
+               try { ok = io->write(io, record, size) == PHYSFS_sint64(size); }
+               catch (...) { ok = false; }
+               io->destroy(io);
+            }
+            ok = ok and recorded;
+         }
 
-   __PHYSFS_platformGrabMutex(stateLock);
+         // Then the record, and its directory. Once that's through,    
+         // the commit has happened                                     
+         if (ok) {
+            PathList recordSync;
+            ok = recordSync.Add(transactedPath(dir, CommitRecordName))
+               and recordSync.AddParent(recordPath) and recordSync.Sync();
+            durable = ok;
+         }
 
-   len = strlen(_fn) + longest_root + 2;
-   allocated_fname = (char*) __PHYSFS_smallAlloc(len);
-   BAIL_IF_MUTEX(!allocated_fname, PHYSFS_ERR_OUT_OF_MEMORY, stateLock, 0);
-   fname = allocated_fname + longest_root + 1;
-   if (!sanitizePlatformIndependentPath(_fn, fname))
-      retval = PHYSFS_ENUM_STOP;
-   else {
-      DirHandle* i;
-      SymlinkFilterData filterdata;
+         if (ok) {
+            PathList dirs;
+            renamed = finishRenames(dir, record, size - sizeof(PHYSFS_uint64), dirs);
+            ok = renamed and dirs.Sync();
+         }
 
-      if (!allowSymLinks) {
-         memset(&filterdata, '\0', sizeof(filterdata));
-         filterdata.callback = cb;
-         filterdata.callbackData = data;
+         if (not ok)
+            error = PHYSFS_ERR_IO;
+      }
+      catch (...) {
+         error = PHYSFS_ERR_IO;
       }
 
-      for (i = searchPath; (retval == PHYSFS_ENUM_OK) && i; i = i->next) {
-         char* arcfname = fname;
+      // With every rename done, or the record never made durable, it   
+      // has done its job: a record that isn't durable mustn't be       
+      // acted on later. Otherwise it stays, along with whatever        
+      // temporaries are left, for recoverCommit to finish              
+      const bool pending = durable and not renamed;
+      if (recorded and not pending) {
+         try { __PHYSFS_platformDelete(recordPath); }
+         catch (...) {}
+      }
+      allocator.Free(recordPath);
+      allocator.Free(record);
 
-         if (partOfMountPoint(i, arcfname))
-            retval = enumerateFromMountPoint(i, arcfname, cb, _fn, data);
+      for (auto txn = group; txn; txn = txn->nextQueued) {
+         txn->result = error;
+         txn->pending = pending;
+      }
+   }
 
-         else if (verifyPath(i, &arcfname, 0)) {
-            PHYSFS_Stat statbuf;
-            if (!i->funcs->stat(i->opaque, arcfname, &statbuf)) {
-               if (currentErrorCode() == PHYSFS_ERR_NOT_FOUND)
-                  continue;  /* no such dir in this archive, skip it. */
-            }
+#ifndef PHYSFS_NO_THREADS
+   /// Transactions waiting to be committed. Whoever finds no commit in       
+   /// progress to its directory commits everything queued for it up to       
+   /// then, so commits that overlap share one sync. Write dirs of other      
+   /// contexts get groups of their own, committed alongside. All of it is    
+   /// guarded by commitLock                                                  
+   PHYSFS_Transaction* commitQueue = nullptr;
+   PHYSFS_Transaction* committing = nullptr;  // Leaders of the groups  
+
+   /// Whether (a) and (b) are the same directory on disk. Contexts each      
+   /// have their own write dir, but two of them can still name one place,    
+   /// and a place has only the one commit record                             
+   bool sameWriteDir(const DirHandle* a, const DirHandle* b) {
+      return a == b or strcmp(static_cast<const char*>(a->opaque),
+         static_cast<const char*>(b->opaque)) == 0;
+   }
 
-            if (statbuf.filetype != PHYSFS_FILETYPE_DIRECTORY)
-               continue;  /* not a directory in this archive, skip it. */
-
-            else if ((!allowSymLinks) && (i->funcs->info.supportsSymlinks)) {
-               filterdata.dirhandle = i;
-               filterdata.arcfname = arcfname;
-               filterdata.errcode = PHYSFS_ERR_OK;
-               retval = i->funcs->enumerate(i->opaque, arcfname,
-                  enumCallbackFilterSymLinks,
-                  _fn, &filterdata);
-               if (retval == PHYSFS_ENUM_ERROR) {
-                  if (currentErrorCode() == PHYSFS_ERR_APP_CALLBACK)
-                     PHYSFS_setErrorCode(filterdata.errcode);
-               }
-            }
-            else {
-               retval = i->funcs->enumerate(i->opaque, arcfname,
-                  cb, _fn, data);
-            }
-         }
+   /// Whether a group writing to the directory of (dir) is being committed   
+   bool committingTo(const DirHandle* dir) {
+      for (auto i = committing; i; i = i->nextCommitting) {
+         if (sameWriteDir(i->dir, dir))
+            return true;
       }
+      return false;
    }
 
-   __PHYSFS_platformReleaseMutex(stateLock);
-   __PHYSFS_smallFree(allocated_fname);
-   return (retval == PHYSFS_ENUM_ERROR) ? 0 : 1;
+   /// Take everything queued for the directory of (dir) out of the queue,    
+   /// in the order it was queued                                             
+   PHYSFS_Transaction* takeQueued(const DirHandle* dir) {
+      PHYSFS_Transaction* group = nullptr;
+      auto groupTail = &group;
+      for (auto i = &commitQueue; *i; ) {
+         auto txn = *i;
+         if (not sameWriteDir(txn->dir, dir)) {
+            i = &txn->nextQueued;
+            continue;
+         }
+         *i = txn->nextQueued;
+         txn->nextQueued = nullptr;
+         *groupTail = txn;
+         groupTail = &txn->nextQueued;
+      }
+      return group;
+   }
+#endif
 }
 
-struct LegacyEnumFilesCallbackData {
-   PHYSFS_EnumFilesCallback callback;
-   void* data;
-};
-
-static PHYSFS_EnumerateCallbackResult enumFilesCallbackAlwaysSucceed(
-   void* d, const char* origdir, const char* fname
-) {
-   LegacyEnumFilesCallbackData* cbdata = (LegacyEnumFilesCallbackData*) d;
-   cbdata->callback(cbdata->data, origdir, fname);
-   return PHYSFS_ENUM_OK;
-}
+/// Called with the write dir freshly set, and before every commit. Returns   
+/// false if a record is left that can't be finished                          
+static bool recoverCommit(DirHandle* dir) {
+   if (dir->funcs != &__PHYSFS_Archiver_DIR)
+      return true;
+
+   char* recordPath = nullptr;
+   try { recordPath = transactedPath(dir, CommitRecordName); }
+   catch (...) {}
+   if (not recordPath)
+      return false;
+
+   size_t size = 0;
+   bool exists = false;
+   bool finished = true;
+   if (auto record = readCommitRecord(recordPath, size, exists)) {
+      PathList dirs;
+      finished = false;
+      try { finished = finishRenames(dir, record, size, dirs) and dirs.Sync(); }
+      catch (...) {}
+      allocator.Free(record);
+   }
 
-void PHYSFS_enumerateFilesCallback(
-   const char* fname, PHYSFS_EnumFilesCallback callback, void* data
-) {
-   LegacyEnumFilesCallbackData cbdata;
-   cbdata.callback = callback;
-   cbdata.data = data;
-   (void) PHYSFS_enumerate(fname, enumFilesCallbackAlwaysSucceed, &cbdata);
+   // Finished, or torn: a torn record means the commit never got past  
+   // its sync, so there's nothing to finish                            
+   if (exists and finished) {
+      try { finished = __PHYSFS_platformDelete(recordPath); }
+      catch (...) { finished = false; }
+   }
+   allocator.Free(recordPath);
+   return finished;
 }
 
-int PHYSFS_exists(const char* fname) {
-   return (getRealDirHandle(fname) != nullptr);
-}
+PHYSFS_Transaction* PHYSFS_beginTransaction(void) {
+   auto& context = ctx();
+   auto txn = static_cast<PHYSFS_Transaction*>(allocator.Malloc(sizeof(PHYSFS_Transaction), PHYSFS_ALLOC_FILEHANDLE));
+   BAIL_IF(not txn, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
 
-PHYSFS_sint64 PHYSFS_getLastModTime(const char* fname) {
-   PHYSFS_Stat statbuf;
-   BAIL_IF_ERRPASS(!PHYSFS_stat(fname, &statbuf), -1);
-   return statbuf.modtime;
-}
+   __PHYSFS_platformGrabMutex(context.stateLock);
+   if (not context.writeDir or context.writeDir->funcs != &__PHYSFS_Archiver_DIR) {
+      allocator.Free(txn);
+      const auto error = context.writeDir ? PHYSFS_ERR_UNSUPPORTED : PHYSFS_ERR_NO_WRITE_DIR;
+      BAIL_MUTEX(error, context.stateLock, nullptr);
+   }
 
-int PHYSFS_isDirectory(const char* fname) {
-   PHYSFS_Stat statbuf;
-   BAIL_IF_ERRPASS(!PHYSFS_stat(fname, &statbuf), 0);
-   return (statbuf.filetype == PHYSFS_FILETYPE_DIRECTORY);
-}
+   // Pinned like an open file, so the write dir stays put              
+   new (txn) PHYSFS_Transaction {};
+   txn->dir = context.writeDir;
+   txn->context = &context;
+   txn->id = transactionIds.fetch_add(1, std::memory_order_relaxed);
+   __PHYSFS_ATOMIC_INCR(&context.writeDir->openFiles);
+   __PHYSFS_platformReleaseMutex(context.stateLock);
+   return txn;
+}
+
+PHYSFS_File* PHYSFS_openWriteTransacted(PHYSFS_Transaction* txn, const char* _fname) {
+   BAIL_IF(not txn or not _fname, PHYSFS_ERR_INVALID_ARGUMENT, nullptr);
+   auto& context = *txn->context;
+   const auto h = txn->dir;
+
+   __PHYSFS_platformGrabMutex(context.stateLock);
+   const auto len = strlen(_fname) + dirHandleRootLen(h) + 1;
+   auto fname = static_cast<char*>(allocator.Malloc(len));
+   BAIL_IF_MUTEX(not fname, PHYSFS_ERR_OUT_OF_MEMORY, context.stateLock, nullptr);
+
+   char* arcfname = fname;
+   const bool valid = sanitizePlatformIndependentPathWithRoot(h, _fname, fname)
+      and verifyPath(h, &arcfname, 0);
+   __PHYSFS_platformReleaseMutex(context.stateLock);
+   if (not valid) {
+      allocator.Free(fname);
+      return nullptr;
+   }
 
-int PHYSFS_isSymbolicLink(const char* fname) {
-   PHYSFS_Stat statbuf;
-   BAIL_IF_ERRPASS(!PHYSFS_stat(fname, &statbuf), 0);
-   return (statbuf.filetype == PHYSFS_FILETYPE_SYMLINK);
-}
+   // Writing a file twice starts it over, in the same temporary        
+   size_t index = 0;
+   while (index < txn->count and strcmp(txn->files[index].name, arcfname) != 0)
+      ++index;
+
+   // A new entry only stays once its temporary exists. The commit      
+   // would fail its whole group on one it can't open                   
+   const bool added = index == txn->count;
+   const auto forget = [txn, added] {
+      if (not added)
+         return;
+      auto& file = txn->files[--txn->count];
+      allocator.Free(file.name);
+      allocator.Free(file.temp);
+   };
+
+   if (added) {
+      if (txn->count == txn->capacity) {
+         const auto capacity = txn->capacity ? txn->capacity * 2 : 16;
+         auto files = static_cast<TransactedFile*>(allocator.Realloc(txn->files, capacity * sizeof(TransactedFile), PHYSFS_ALLOC_FILEHANDLE));
+         if (not files) {
+            allocator.Free(fname);
+            BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+         }
+         txn->files = files;
+         txn->capacity = capacity;
+      }
 
-static PHYSFS_File* doOpenWrite(const char* _fname, const int appending) {
-   FileHandle* fh = nullptr;
-   DirHandle* h;
-   size_t len;
-   char* fname;
+      char suffix[sizeof(TransactedSuffix) + 8];
+      snprintf(suffix, sizeof(suffix), "%s%08x", TransactedSuffix, unsigned(txn->id));
+      const auto namelen = strlen(arcfname);
+      auto name = static_cast<char*>(allocator.Malloc(namelen + 1, PHYSFS_ALLOC_FILEHANDLE));
+      auto temp = static_cast<char*>(allocator.Malloc(namelen + strlen(suffix) + 1, PHYSFS_ALLOC_FILEHANDLE));
+      if (not name or not temp) {
+         allocator.Free(name);
+         allocator.Free(temp);
+         allocator.Free(fname);
+         BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+      }
 
-   BAIL_IF(!_fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+      strcpy(name, arcfname);
+      strcpy(temp, arcfname);
+      strcpy(temp + namelen, suffix);
+      txn->files[txn->count++] = {name, temp};
+   }
+   allocator.Free(fname);
 
-   __PHYSFS_platformGrabMutex(stateLock);
-   h = writeDir;
-   BAIL_IF_MUTEX(!h, PHYSFS_ERR_NO_WRITE_DIR, stateLock, 0);
+   auto path = transactedPath(h, txn->files[index].temp);
+   if (not path) {
+      forget();
+      return nullptr;
+   }
 
-   len = strlen(_fname) + dirHandleRootLen(h) + 1;
-   fname = (char*) __PHYSFS_smallAlloc(len);
-   BAIL_IF_MUTEX(!fname, PHYSFS_ERR_OUT_OF_MEMORY, stateLock, 0);
+   PHYSFS_Io* inner = nullptr;
+   try { inner = __PHYSFS_createNativeIo(path, 'w'); }
+   catch (...) {
+      allocator.Free(path);
+      forget();
+      throw;
+   }
+   if (not inner) {
+      allocator.Free(path);
+      forget();
+      return nullptr;
+   }
 
-   if (sanitizePlatformIndependentPathWithRoot(h, _fname, fname)) {
-      PHYSFS_Io* io = nullptr;
-      char* arcfname = fname;
-      if (verifyPath(h, &arcfname, 0)) {
-         const PHYSFS_Archiver* f = h->funcs;
-         if (appending)
-            io = f->openAppend(h->opaque, arcfname);
-         else
-            io = f->openWrite(h->opaque, arcfname);
+   auto io = static_cast<PHYSFS_Io*>(allocator.Malloc(sizeof(PHYSFS_Io), PHYSFS_ALLOC_FILEHANDLE));
+   auto info = static_cast<TransactedIoInfo*>(allocator.Malloc(sizeof(TransactedIoInfo), PHYSFS_ALLOC_FILEHANDLE));
+   if (not io or not info) {
+      allocator.Free(io);
+      allocator.Free(info);
+      inner->destroy(inner);
+      if (added) {
+         try { __PHYSFS_platformDelete(path); }
+         catch (...) {}
+      }
+      allocator.Free(path);
+      forget();
+      BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+   }
+   allocator.Free(path);
+
+   memcpy(io, &transactedIoInterface, sizeof(PHYSFS_Io));
+   info->io = inner;
+   info->txn = txn;
+   io->opaque = info;
+   txn->openFiles.fetch_add(1, std::memory_order_relaxed);
+
+   // The file pins the write dir too, as any file would                
+   __PHYSFS_ATOMIC_INCR(&h->openFiles);
+   return reinterpret_cast<PHYSFS_File*>(makeFileHandle(io, h, 0, context));
+}
+
+int PHYSFS_commitTransaction(PHYSFS_Transaction* txn) {
+   BAIL_IF(not txn, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(txn->openFiles.load(std::memory_order_acquire), PHYSFS_ERR_FILES_STILL_OPEN, 0);
+
+   if (txn->count) {
+#ifdef PHYSFS_NO_THREADS
+      commitGroup(txn);
+#else
+      __PHYSFS_PlatformLock lock {commitLock};
+      auto tail = &commitQueue;
+      while (*tail)
+         tail = &(*tail)->nextQueued;
+      *tail = txn;
+
+      while (not txn->done) {
+         if (committingTo(txn->dir)) {
+            __PHYSFS_platformWaitCond(commitDone, commitLock);
+            continue;
+         }
 
-         if (io) {
-            fh = (FileHandle*) allocator.Malloc(sizeof(FileHandle));
-            if (fh == nullptr) {
-               io->destroy(io);
-               PHYSFS_setErrorCode(PHYSFS_ERR_OUT_OF_MEMORY);
-            }
-            else {
-               memset(fh, '\0', sizeof(FileHandle));
-               fh->io = io;
-               fh->dirHandle = h;
-               fh->next = openWriteList;
-               openWriteList = fh;
+         // Lead: commit everyone queued so far for our directory,      
+         // ourselves included                                          
+         auto group = takeQueued(txn->dir);
+         group->nextCommitting = committing;
+         committing = group;
+         lock.unlock();
+         commitGroup(group);
+         lock.lock();
+
+         for (auto i = group; i; i = i->nextQueued)
+            i->done = true;
+         for (auto i = &committing; *i; i = &(*i)->nextCommitting) {
+            if (*i == group) {
+               *i = group->nextCommitting;
+               break;
             }
          }
+         __PHYSFS_platformBroadcastCond(commitDone);
       }
+#endif
    }
-   __PHYSFS_platformReleaseMutex(stateLock);
-
-   __PHYSFS_smallFree(fname);
-   return ((PHYSFS_File*) fh);
-}
 
-PHYSFS_File* PHYSFS_openWrite(const char* filename) {
-   return doOpenWrite(filename, 0);
+   // A commit that got as far as its record keeps its temporaries, so  
+   // the renames left can still be finished                            
+   const auto result = txn->result;
+   freeTransaction(txn, result != PHYSFS_ERR_OK and not txn->pending);
+   if (result != PHYSFS_ERR_OK) {
+      PHYSFS_setErrorCode(result);
+      return 0;
+   }
+   return 1;
 }
 
-PHYSFS_File* PHYSFS_openAppend(const char* filename) {
-   return doOpenWrite(filename, 1);
+int PHYSFS_abortTransaction(PHYSFS_Transaction* txn) {
+   BAIL_IF(not txn, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(txn->openFiles.load(std::memory_order_acquire), PHYSFS_ERR_FILES_STILL_OPEN, 0);
+   freeTransaction(txn, true);
+   return 1;
 }
 
-PHYSFS_File* PHYSFS_openRead(const char* _fname) {
-   FileHandle* fh = nullptr;
-   char* allocated_fname;
-   char* fname;
-   size_t len;
-
-   BAIL_IF(!_fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-
-   __PHYSFS_platformGrabMutex(stateLock);
+///                                                                           
+/// Asynchronous i/o: a queue of ops that the caller owns and we only link    
+/// together, served by a few threads that make the usual blocking calls      
+///                                                                           
+namespace
+{
+   constexpr PHYSFS_uint32 AsyncMaxThreads = 64;
+
+   /// Largest piece an async read does between checks for cancellation       
+   constexpr PHYSFS_uint64 AsyncChunk = 1024 * 1024;
+
+   /// Which error the exception in flight carries. Ours have no common       
+   /// base, so each code gets tried in turn; it's the slow path anyway       
+   template<int E = PHYSFS_ERR_OTHER_ERROR>
+   PHYSFS_ErrorCode caughtErrorCode(const std::exception_ptr& e) noexcept {
+      try { std::rethrow_exception(e); }
+      catch (const MetaPhysFS::Exception<PHYSFS_ErrorCode(E)>&) {
+         return PHYSFS_ErrorCode(E);
+      }
+      catch (...) {
+         if constexpr (E < PHYSFS_ERR_CANCELLED)
+            return caughtErrorCode<E + 1>(e);
+      }
+      return PHYSFS_ERR_OTHER_ERROR;
+   }
 
-   BAIL_IF_MUTEX(!searchPath, PHYSFS_ERR_NOT_FOUND, stateLock, 0);
+   /// Read in chunks, checking for cancellation between them. Like           
+   /// PHYSFS_readBytes, a failure after some data returns the data           
+   PHYSFS_sint64 asyncRead(
+      PHYSFS_AsyncOp* op, PHYSFS_File* file, PHYSFS_uint8* out,
+      PHYSFS_uint64 len, const PHYSFS_uint64* offset
+   ) {
+      PHYSFS_sint64 done = 0;
+      while (len) {
+         if (op->cancel.stop_requested()) {
+            op->error = PHYSFS_ERR_CANCELLED;
+            break;
+         }
 
-   len = strlen(_fname) + longest_root + 2;
-   allocated_fname = (char*) __PHYSFS_smallAlloc(len);
-   BAIL_IF_MUTEX(!allocated_fname, PHYSFS_ERR_OUT_OF_MEMORY, stateLock, 0);
-   fname = allocated_fname + longest_root + 1;
+         const auto want = std::min(len, AsyncChunk);
+         const auto rc = offset
+            ? PHYSFS_readAt(file, *offset + done, out + done, want)
+            : PHYSFS_readBytes(file, out + done, want);
+         if (rc < 0)
+            return done ? done : -1;
+
+         done += rc;
+         len -= rc;
+         if (PHYSFS_uint64(rc) < want)
+            break;  // End of file                                      
+      }
+      return done;
+   }
 
-   if (sanitizePlatformIndependentPath(_fname, fname)) {
-      PHYSFS_Io* io = nullptr;
-      DirHandle* i;
+   /// The file's length is only a hint for the first allocation, so a file   
+   /// that doesn't know it, or lies about it, still reads fine               
+   PHYSFS_sint64 asyncReadAll(PHYSFS_AsyncOp* op, PHYSFS_File* file) {
+      const auto length = PHYSFS_fileLength(file);
+      PHYSFS_uint64 capacity = length >= 0 ? PHYSFS_uint64(length) : AsyncChunk;
+      PHYSFS_uint64 size = 0;
+      auto data = static_cast<PHYSFS_uint8*>(allocator.Malloc(std::max<PHYSFS_uint64>(capacity, 1)));
+      BAIL_IF(not data, PHYSFS_ERR_OUT_OF_MEMORY, -1);
+
+      try {
+         while (true) {
+            if (size == capacity) {
+               // Check for more only if the length was a guess         
+               if (length >= 0)
+                  break;
+               auto grown = static_cast<PHYSFS_uint8*>(allocator.Realloc(data, capacity * 2));
+               BAIL_IF(not grown, PHYSFS_ERR_OUT_OF_MEMORY, -1);
+               data = grown;
+               capacity *= 2;
+            }
 
-      for (i = searchPath; i != nullptr; i = i->next) {
-         char* arcfname = fname;
-         if (verifyPath(i, &arcfname, 0)) {
-            io = i->funcs->openRead(i->opaque, arcfname);
-            if (io)
+            const auto rc = asyncRead(op, file, data + size, capacity - size, nullptr);
+            if (rc < 0 or op->error == PHYSFS_ERR_CANCELLED) {
+               allocator.Free(data);
+               return -1;
+            }
+            size += rc;
+            if (size < capacity)
                break;
          }
       }
-
-      if (io) {
-         fh = (FileHandle*) allocator.Malloc(sizeof(FileHandle));
-         if (fh == nullptr) {
-            io->destroy(io);
-            PHYSFS_setErrorCode(PHYSFS_ERR_OUT_OF_MEMORY);
-         }
-         else {
-            memset(fh, '\0', sizeof(FileHandle));
-            fh->io = io;
-            fh->forReading = 1;
-            fh->dirHandle = i;
-            fh->next = openReadList;
-            openReadList = fh;
-         }
+      catch (...) {
+         allocator.Free(data);
+         throw;
       }
+
+      op->buffer = data;
+      op->len = size;
+      return PHYSFS_sint64(size);
    }
 
-   __PHYSFS_platformReleaseMutex(stateLock);
-   __PHYSFS_smallFree(allocated_fname);
-   return ((PHYSFS_File*) fh);
-}
+   /// Do (op) on this thread, and fill in its result                         
+   void runAsync(PHYSFS_AsyncOp* op) noexcept {
+      op->result = -1;
+      op->error = PHYSFS_ERR_OK;
+      if (op->type == PHYSFS_ASYNC_OPEN_READ)
+         op->file = nullptr;
+      else if (op->type == PHYSFS_ASYNC_READ_ALL) {
+         op->buffer = nullptr;
+         op->len = 0;
+      }
 
-static int closeHandleInOpenList(FileHandle** list, FileHandle* handle) {
-   FileHandle* prev = nullptr;
-   FileHandle* i;
+      if (op->cancel.stop_requested()) {
+         op->error = PHYSFS_ERR_CANCELLED;
+         return;
+      }
 
-   for (i = *list; i != nullptr; i = i->next) {
-      if (i == handle)  /* handle is in this list? */
-      {
-         PHYSFS_Io* io = handle->io;
-         PHYSFS_uint8* tmp = handle->buffer;
+      PHYSFS_getLastErrorCode();  // So that what's left is ours        
+      try {
+         const auto out = static_cast<PHYSFS_uint8*>(op->buffer);
+         switch (op->type) {
+         case PHYSFS_ASYNC_OPEN_READ:
+            op->file = PHYSFS_openRead(op->path);
+            op->result = op->file ? 0 : -1;
+            break;
+         case PHYSFS_ASYNC_READ:
+            op->result = asyncRead(op, op->file, out, op->len, nullptr);
+            break;
+         case PHYSFS_ASYNC_READ_AT:
+            op->result = asyncRead(op, op->file, out, op->len, &op->offset);
+            break;
+         case PHYSFS_ASYNC_READ_ALL:
+            if (auto file = PHYSFS_openRead(op->path)) {
+               try { op->result = asyncReadAll(op, file); }
+               catch (...) {
+                  PHYSFS_close(file);
+                  throw;
+               }
+               PHYSFS_close(file);
+            }
+            break;
+         default:
+            PHYSFS_setErrorCode(PHYSFS_ERR_INVALID_ARGUMENT);
+            break;
+         }
 
-         /* send our buffer to io... */
-         if (!handle->forReading) {
-            if (!PHYSFS_flush((PHYSFS_File*) handle))
-               return -1;
+         if (op->error == PHYSFS_ERR_OK)
+            op->error = currentErrorCode();
+      }
+      catch (...) {
+         op->result = -1;
+         op->error = caughtErrorCode(std::current_exception());
+      }
+   }
 
-            /* ...then have io send it to the disk... */
-            else if (io->flush && !io->flush(io))
-               return -1;
-         } /* if */
+   PHYSFS_uint32 asyncThreadCount = 2;    // Wanted                     
 
-         /* ...then close the underlying file. */
-         io->destroy(io);
+#ifndef PHYSFS_NO_THREADS
+   PHYSFS_AsyncOp* asyncHead = nullptr;
+   PHYSFS_AsyncOp** asyncTail = &asyncHead;
+   void* asyncThreads[AsyncMaxThreads] {};
+   PHYSFS_uint32 asyncRunning = 0;        // Started                    
+   bool asyncStopping = false;
+   thread_local bool asyncWorkerThread = false;
 
-         if (tmp != nullptr)  /* free any associated buffer. */
-            allocator.Free(tmp);
+   bool onAsyncThread() noexcept {
+      return asyncWorkerThread;
+   }
 
-         if (prev == nullptr)
-            *list = handle->next;
-         else
-            prev->next = handle->next;
+   /// Runs the ops in the order they came in, until told to stop and the     
+   /// queue's empty. An op isn't touched once it's completed. All of the     
+   /// queue is guarded by asyncLock                                          
+   void asyncWorker(void*) {
+      asyncWorkerThread = true;
+      __PHYSFS_PlatformLock lock {asyncLock};
+      while (true) {
+         lock.wait(asyncWake, [] { return asyncHead or asyncStopping; });
+         if (not asyncHead)
+            return;
+
+         auto op = asyncHead;
+         asyncHead = op->next;
+         if (not asyncHead)
+            asyncTail = &asyncHead;
+         lock.unlock();
+
+         ioPriority = op->priority;
+         ioDeadlineUs = op->deadlineUs;
+         currentContext = op->context;
+         runAsync(op);
+         op->complete(op);
+         lock.lock();
+      }
+   }
 
-         allocator.Free(handle);
-         return 1;
+   /// Let the threads finish what's queued, and join them. Not from an       
+   /// op's completion, which runs on one of them: the callers turn that      
+   /// down with PHYSFS_ERR_BUSY. asyncStop makes sure that no thread is      
+   /// joined twice                                                           
+   void stopAsync() {
+      if (not asyncStop)
+         return;  // Not initialized, so nothing was started            
+
+      __PHYSFS_PlatformLock stop {asyncStop};
+      __PHYSFS_PlatformLock lock {asyncLock};
+      if (not asyncRunning)
+         return;
+
+      asyncStopping = true;
+      __PHYSFS_platformBroadcastCond(asyncWake);
+      const auto running = asyncRunning;
+      lock.unlock();
+      for (PHYSFS_uint32 i = 0; i < running; ++i) {
+         __PHYSFS_platformJoinThread(asyncThreads[i]);
+         asyncThreads[i] = nullptr;
       }
+      lock.lock();
+      asyncRunning = 0;
+      asyncStopping = false;
+   }
+#endif
+}
 
-      prev = i;
+int PHYSFS_submitAsync(PHYSFS_AsyncOp* op) {
+   BAIL_IF(not op, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   op->priority = ioPriority;
+   op->deadlineUs = ioDeadlineUs;
+   op->context = currentContext;
+   op->next = nullptr;
+
+#ifndef PHYSFS_NO_THREADS
+   if (initialized and op->complete) {
+      __PHYSFS_PlatformLock lock {asyncLock};
+      if (not asyncStopping) {
+         // Threads start with the first op, after init or a resize     
+         try {
+            while (asyncRunning < asyncThreadCount) {
+               auto thread = __PHYSFS_platformCreateThread(asyncWorker, nullptr);
+               if (not thread)
+                  break;
+               asyncThreads[asyncRunning++] = thread;
+            }
+         }
+         catch (...) {}
+
+         if (asyncRunning) {
+            *asyncTail = op;
+            asyncTail = &op->next;
+            __PHYSFS_platformBroadcastCond(asyncWake);
+            return 1;
+         }
+      }
    }
+#endif
 
+   if (not initialized) {
+      op->result = -1;
+      op->error = PHYSFS_ERR_NOT_INITIALIZED;
+   }
+   else runAsync(op);
    return 0;
 }
 
+int PHYSFS_setAsyncThreads(PHYSFS_uint32 count) {
+   BAIL_IF(count < 1 or count > AsyncMaxThreads, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+#ifndef PHYSFS_NO_THREADS
+   // Stopping joins the threads, so it can't run on one of them        
+   BAIL_IF(onAsyncThread(), PHYSFS_ERR_BUSY, 0);
+   stopAsync();
+   if (asyncLock) {
+      __PHYSFS_PlatformLock lock {asyncLock};
+      asyncThreadCount = count;
+      return 1;
+   }
+#endif
+   asyncThreadCount = count;
+   return 1;
+}
+
+/// Closing doesn't touch stateLock at all: the handle is unlinked in O(1)    
+/// under fileLock, the io is destroyed without any global lock held, and     
+/// only then is the archive's openFiles dropped, so an unmount can never     
+/// pull the archive out from under a closing stream. Like fclose(), closing  
+/// the same handle twice is undefined                                        
 int PHYSFS_close(PHYSFS_File* _handle) {
-   FileHandle* handle = (FileHandle*) _handle;
-   int rc;
+   auto handle = (FileHandle*) _handle;
+   BAIL_IF(!handle, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+   auto io = handle->io;
+   if (not handle->forReading) {
+      // Send our buffer to io, then have io send it to the disk. On    
+      // failure the handle stays open and registered                   
+      BAIL_IF_ERRPASS(!PHYSFS_flush(_handle), 0);
+      BAIL_IF_ERRPASS(io->flush and not io->flush(io), 0);
+   }
 
-   __PHYSFS_platformGrabMutex(stateLock);
+   unregisterFileHandle(handle);
+   io->destroy(io);
+   if (handle->atIo)
+      handle->atIo->destroy(handle->atIo);
+   if (handle->atLock)
+      __PHYSFS_platformDestroyMutex(handle->atLock);
 
-   /* -1 == close failure. 0 == not found. 1 == success. */
-   rc = closeHandleInOpenList(&openReadList, handle);
-   BAIL_IF_MUTEX_ERRPASS(rc == -1, stateLock, 0);
-   if (!rc) {
-      rc = closeHandleInOpenList(&openWriteList, handle);
-      BAIL_IF_MUTEX_ERRPASS(rc == -1, stateLock, 0);
-   }
+   if (handle->buffer)
+      allocator.Free(handle->buffer);
 
-   __PHYSFS_platformReleaseMutex(stateLock);
-   BAIL_IF(!rc, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   auto dh = handle->dirHandle;
+   allocator.Free(handle);
+   __PHYSFS_ATOMIC_DECR(&dh->openFiles);
    return 1;
 }
 
@@ -2489,6 +6779,57 @@ PHYSFS_sint64 PHYSFS_readBytes(
    return fh->io->read(fh->io, buffer, len);
 }
 
+///                                                                           
+/// Positional reads go straight to the io when it has a readAt, with no      
+/// lock at all. Otherwise they're serialized on the handle's atLock, and     
+/// done by seeking a private duplicate of the stream, which is left where    
+/// the read ended - ascending reads of a compressed entry never rewind       
+///                                                                           
+PHYSFS_sint64 PHYSFS_readAt(
+   PHYSFS_File* handle, PHYSFS_uint64 offset, void* buffer, PHYSFS_uint64 len
+) {
+   FileHandle* fh = (FileHandle*) handle;
+   const PHYSFS_uint64 maxlen = __PHYSFS_UI64(0x7FFFFFFFFFFFFFFF);
+   BAIL_IF(!fh, PHYSFS_ERR_INVALID_ARGUMENT, -1);
+   BAIL_IF(!__PHYSFS_ui64FitsAddressSpace(len), PHYSFS_ERR_INVALID_ARGUMENT, -1);
+   BAIL_IF(len > maxlen, PHYSFS_ERR_INVALID_ARGUMENT, -1);
+   BAIL_IF(!fh->forReading, PHYSFS_ERR_OPEN_FOR_WRITING, -1);
+   BAIL_IF_ERRPASS(len == 0, 0);
+
+   PHYSFS_Io* io = fh->io;
+   if (__PHYSFS_ioCanReadAt(io))
+      return io->readAt(io, offset, buffer, len);
+
+   __PHYSFS_platformGrabMutex(fh->atLock);
+
+   // A throwing io mustn't leave atLock held, or every later readAt on 
+   // this handle would wait for it forever                             
+   PHYSFS_sint64 retval = 0;
+   try {
+      if (not fh->atIo) {
+         fh->atIo = io->duplicate(io);
+         BAIL_IF_MUTEX_ERRPASS(not fh->atIo, fh->atLock, -1);
+      }
+
+      io = fh->atIo;
+      const PHYSFS_sint64 length = io->length(io);
+      BAIL_IF_MUTEX_ERRPASS(length < 0, fh->atLock, -1);
+
+      if (offset < (PHYSFS_uint64) length) {
+         if (io->tell(io) != (PHYSFS_sint64) offset)
+            BAIL_IF_MUTEX_ERRPASS(!io->seek(io, offset), fh->atLock, -1);
+         retval = io->read(io, buffer, len);
+      }
+   }
+   catch (...) {
+      __PHYSFS_platformReleaseMutex(fh->atLock);
+      throw;
+   }
+
+   __PHYSFS_platformReleaseMutex(fh->atLock);
+   return retval;
+}
+
 static PHYSFS_sint64 doBufferedWrite(
    PHYSFS_File* handle, const void* buffer, const size_t len
 ) {
@@ -2618,7 +6959,7 @@ int PHYSFS_setBuffer(PHYSFS_File* handle, PHYSFS_uint64 _bufsize) {
    }
    else {
       PHYSFS_uint8* newbuf;
-      newbuf = (PHYSFS_uint8*) allocator.Realloc(fh->buffer, bufsize);
+      newbuf = (PHYSFS_uint8*) allocator.Realloc(fh->buffer, bufsize, PHYSFS_ALLOC_CACHE);
       BAIL_IF(!newbuf, PHYSFS_ERR_OUT_OF_MEMORY, 0);
       fh->buffer = newbuf;
    }
@@ -2645,6 +6986,7 @@ int PHYSFS_flush(PHYSFS_File* handle) {
 }
 
 int PHYSFS_stat(const char* _fname, PHYSFS_Stat* stat) {
+   auto& context = ctx();
    int retval = 0;
    char* allocated_fname;
    char* fname;
@@ -2661,22 +7003,22 @@ int PHYSFS_stat(const char* _fname, PHYSFS_Stat* stat) {
    stat->filetype = PHYSFS_FILETYPE_OTHER;
    stat->readonly = 1;
 
-   __PHYSFS_platformGrabMutex(stateLock);
-   len = strlen(_fname) + longest_root + 2;
+   __PHYSFS_platformGrabMutex(context.stateLock);
+   len = strlen(_fname) + context.longest_root + 2;
    allocated_fname = (char*) __PHYSFS_smallAlloc(len);
-   BAIL_IF_MUTEX(!allocated_fname, PHYSFS_ERR_OUT_OF_MEMORY, stateLock, 0);
-   fname = allocated_fname + longest_root + 1;
+   BAIL_IF_MUTEX(!allocated_fname, PHYSFS_ERR_OUT_OF_MEMORY, context.stateLock, 0);
+   fname = allocated_fname + context.longest_root + 1;
 
    if (sanitizePlatformIndependentPath(_fname, fname)) {
       if (*fname == '\0') {
          stat->filetype = PHYSFS_FILETYPE_DIRECTORY;
-         stat->readonly = !writeDir; /* Writeable if we have a writeDir */
+         stat->readonly = !context.writeDir; /* Writeable if we have a writeDir */
          retval = 1;
       }
       else {
          DirHandle* i;
          int exists = 0;
-         for (i = searchPath; ((i != nullptr) && (!exists)); i = i->next) {
+         for (i = context.searchPath; ((i != nullptr) && (!exists)); i = i->next) {
             char* arcfname = fname;
             exists = partOfMountPoint(i, arcfname);
             if (exists) {
@@ -2685,7 +7027,7 @@ int PHYSFS_stat(const char* _fname, PHYSFS_Stat* stat) {
                retval = 1;
             }
             else if (verifyPath(i, &arcfname, 0)) {
-               retval = i->funcs->stat(i->opaque, arcfname, stat);
+               retval = archiveStat(i, arcfname, stat);
                if ((retval) || (currentErrorCode() != PHYSFS_ERR_NOT_FOUND))
                   exists = 1;
             }
@@ -2693,11 +7035,165 @@ int PHYSFS_stat(const char* _fname, PHYSFS_Stat* stat) {
       }
    }
 
-   __PHYSFS_platformReleaseMutex(stateLock);
+   __PHYSFS_platformReleaseMutex(context.stateLock);
    __PHYSFS_smallFree(allocated_fname);
    return retval;
 }
 
+/// Defaults for everything in a PHYSFS_StatEx, as PHYSFS_stat has them       
+static void presetStatEx(PHYSFS_StatEx* st) noexcept {
+   st->stat.filesize = -1;
+   st->stat.modtime = -1;
+   st->stat.createtime = -1;
+   st->stat.accesstime = -1;
+   st->stat.filetype = PHYSFS_FILETYPE_OTHER;
+   st->stat.readonly = 1;
+   st->archive = nullptr;
+   st->offset = -1;
+   st->storedSize = -1;
+   st->compression = PHYSFS_COMPRESSION_UNKNOWN;
+   st->method = 0;
+   st->block = -1;
+   st->contiguous = 0;
+   st->mappable = 0;
+   st->encrypted = 0;
+}
+
+/// Stat (fname), already sanitized and with longest_root bytes of room in    
+/// front of it, walking the search path like PHYSFS_stat does. An archive    
+/// that doesn't have it is skipped, whether it says so or throws it; any     
+/// other failure ends the search. Throws PHYSFS_ERR_NOT_FOUND if none has it 
+/// MAKE SURE you hold stateLock before calling this!                         
+static bool doStatEx(char* fname, PHYSFS_StatEx* st) {
+   presetStatEx(st);
+   if (*fname == '\0') {
+      st->stat.filetype = PHYSFS_FILETYPE_DIRECTORY;
+      st->stat.readonly = not ctx().writeDir;
+      st->archive = "";
+      return true;
+   }
+
+   for (auto i = ctx().searchPath; i; i = i->next) {
+      char* arcfname = fname;
+      if (partOfMountPoint(i, arcfname)) {
+         st->stat.filetype = PHYSFS_FILETYPE_DIRECTORY;
+         st->archive = i->dirName;
+         return true;
+      }
+
+      try {
+         if (not verifyPath(i, &arcfname, 0))
+            continue;
+
+         const auto funcs = i->funcs;
+         ArchiveLock lock {i};
+         const bool found = funcs->version >= 1 and funcs->statEx
+            ? funcs->statEx(i->opaque, arcfname, st)
+            : funcs->stat(i->opaque, arcfname, &st->stat);
+         if (found) {
+            st->archive = i->dirName;
+            return true;
+         }
+         if (currentErrorCode() != PHYSFS_ERR_NOT_FOUND)
+            return false;
+      }
+      catch (const MetaPhysFS::Exception<PHYSFS_ERR_NOT_FOUND>&) {}
+
+      // The archive may have filled in some of it before giving up     
+      presetStatEx(st);
+   }
+
+   BAIL(PHYSFS_ERR_NOT_FOUND, false);
+}
+
+int PHYSFS_statEx(const char* _fname, PHYSFS_StatEx* stat) {
+   auto& context = ctx();
+   BAIL_IF(not _fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(not stat, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+   __PHYSFS_platformGrabMutex(context.stateLock);
+   const size_t len = strlen(_fname) + context.longest_root + 2;
+   auto allocated_fname = (char*) __PHYSFS_smallAlloc(len);
+   BAIL_IF_MUTEX(not allocated_fname, PHYSFS_ERR_OUT_OF_MEMORY, context.stateLock, 0);
+   auto fname = allocated_fname + context.longest_root + 1;
+
+   bool found = false;
+   try {
+      found = sanitizePlatformIndependentPath(_fname, fname)
+          and doStatEx(fname, stat);
+   }
+   catch (...) {
+      __PHYSFS_platformReleaseMutex(context.stateLock);
+      __PHYSFS_smallFree(allocated_fname);
+      throw;
+   }
+
+   __PHYSFS_platformReleaseMutex(context.stateLock);
+   __PHYSFS_smallFree(allocated_fname);
+   return found;
+}
+
+PHYSFS_uint32 PHYSFS_statMany(
+   const char* const* fnames, PHYSFS_uint32 count, PHYSFS_StatEx* stats
+) {
+   auto& context = ctx();
+   BAIL_IF(not fnames and count, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+   BAIL_IF(not stats and count, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+   // One buffer, big enough for the longest name, serves the lot       
+   size_t longest = 0;
+   for (PHYSFS_uint32 i = 0; i < count; ++i) {
+      BAIL_IF(not fnames[i], PHYSFS_ERR_INVALID_ARGUMENT, 0);
+      longest = std::max(longest, strlen(fnames[i]));
+   }
+
+   __PHYSFS_platformGrabMutex(context.stateLock);
+   const size_t len = longest + context.longest_root + 2;
+   auto allocated_fname = static_cast<char*>(allocator.Malloc(len));
+   BAIL_IF_MUTEX(not allocated_fname, PHYSFS_ERR_OUT_OF_MEMORY, context.stateLock, 0);
+   auto fname = allocated_fname + context.longest_root + 1;
+
+   // Some files missing is the expected case here: a miss doesn't      
+   // touch the error code, and doesn't stop the rest. Any other        
+   // failure ends the call, the way it would end PHYSFS_statEx         
+   const auto errorCode = currentErrorCode();
+   PHYSFS_uint32 found = 0;
+   bool failed = false;
+   try {
+      for (PHYSFS_uint32 i = 0; i < count and not failed; ++i) {
+         bool ok = false;
+         bool missing = false;
+         try {
+            ok = sanitizePlatformIndependentPath(fnames[i], fname)
+             and doStatEx(fname, &stats[i]);
+            missing = not ok and currentErrorCode() == PHYSFS_ERR_NOT_FOUND;
+         }
+         catch (const MetaPhysFS::Exception<PHYSFS_ERR_NOT_FOUND>&) {
+            missing = true;
+         }
+
+         if (ok)
+            ++found;
+         else if (missing)
+            stats[i].archive = nullptr;
+         else
+            failed = true;
+      }
+   }
+   catch (...) {
+      __PHYSFS_platformReleaseMutex(context.stateLock);
+      allocator.Free(allocated_fname);
+      throw;
+   }
+
+   if (not failed)
+      PHYSFS_setErrorCode(errorCode);
+
+   __PHYSFS_platformReleaseMutex(context.stateLock);
+   allocator.Free(allocated_fname);
+   return failed ? 0 : found;
+}
+
 int __PHYSFS_readAll(PHYSFS_Io* io, void* buf, const size_t _len) {
    const PHYSFS_uint64 len = (PHYSFS_uint64) _len;
    return (io->read(io, buf, len) == len);
@@ -2728,35 +7224,3 @@ void __PHYSFS_smallFree(void* ptr) {
          allocator.Free(block);
    }
 }
-
-#ifndef PHYSFS_NO_CRUNTIME_MALLOC
-   static void* mallocAllocatorMalloc(PHYSFS_uint64 s) {
-      if (!__PHYSFS_ui64FitsAddressSpace(s))
-         BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
-      #undef malloc
-      return malloc((size_t) s);
-   }
-
-   static void* mallocAllocatorRealloc(void* ptr, PHYSFS_uint64 s) {
-      if (!__PHYSFS_ui64FitsAddressSpace(s))
-         BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
-      #undef realloc
-      return realloc(ptr, (size_t) s);
-   }
-
-   static void mallocAllocatorFree(void* ptr) {
-      #undef free
-      free(ptr);
-   }
-#endif
-
-static void setDefaultAllocator() {
-   assert(!externalAllocator);
-   allocator.Init = nullptr;
-   allocator.Deinit = nullptr;
-   #ifndef PHYSFS_NO_CRUNTIME_MALLOC
-      allocator.Malloc = mallocAllocatorMalloc;
-      allocator.Realloc = mallocAllocatorRealloc;
-      allocator.Free = mallocAllocatorFree;
-   #endif
-}
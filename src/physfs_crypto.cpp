@@ -0,0 +1,556 @@
+///                                                                           
+/// Internal function/structure declaration. Do NOT include in your           
+/// application.                                                              
+/// Please see the file LICENSE.txt in the source's root directory.           
+///                                                                           
+#include <algorithm>
+#include <array>
+#include <utility>
+
+// Intrinsics headers come first, as mm_malloc.h trips over the poisoned
+// malloc() of physfs_internal.hpp                                      
+#if defined(__x86_64__) or defined(_M_X64) or defined(__i386__) or defined(_M_IX86)
+   #define PHYSFS_AES_X86 1
+   #include <immintrin.h>
+   #if defined(_MSC_VER) and not defined(__clang__)
+      #include <intrin.h>
+      #define PHYSFS_AES_TARGET
+      #define PHYSFS_SHA_TARGET
+   #else
+      #define PHYSFS_AES_TARGET __attribute__((target("aes,sse2")))
+      #define PHYSFS_SHA_TARGET __attribute__((target("sha,sse4.1")))
+   #endif
+#elif defined(__ARM_FEATURE_AES) or defined(__ARM_FEATURE_CRYPTO)
+   // Only when the compiler targets the crypto extension anyway; finding
+   // out at runtime differs on every ARM platform                      
+   #define PHYSFS_AES_ARM 1
+   #include <arm_neon.h>
+#endif
+
+#include "physfs_crypto.hpp"
+
+
+namespace
+{
+   constexpr PHYSFS_uint8 xtime(PHYSFS_uint8 x) {
+      return PHYSFS_uint8((x << 1) ^ ((x & 0x80) ? 0x1B : 0));
+   }
+
+   constexpr PHYSFS_uint8 rotl8(PHYSFS_uint8 x, int n) {
+      return PHYSFS_uint8((x << n) | (x >> (8 - n)));
+   }
+
+   constexpr PHYSFS_uint32 rotr32(PHYSFS_uint32 x, int n) {
+      return (x >> n) | (x << (32 - n));
+   }
+
+   /// The S-box, from walking the multiplicative group with generator 3      
+   constexpr std::array<PHYSFS_uint8, 256> makeSbox() {
+      std::array<PHYSFS_uint8, 256> sbox {};
+      PHYSFS_uint8 p = 1, q = 1;
+      do {
+         p = PHYSFS_uint8(p ^ xtime(p));
+         q = PHYSFS_uint8(q ^ (q << 1));
+         q = PHYSFS_uint8(q ^ (q << 2));
+         q = PHYSFS_uint8(q ^ (q << 4));
+         if (q & 0x80)
+            q ^= 0x09;
+         const PHYSFS_uint8 x = q ^ rotl8(q, 1) ^ rotl8(q, 2) ^ rotl8(q, 3) ^ rotl8(q, 4);
+         sbox[p] = x ^ 0x63;
+      } while (p != 1);
+      sbox[0] = 0x63;
+      return sbox;
+   }
+
+   constexpr auto Sbox = makeSbox();
+
+   /// SubBytes and MixColumns of one byte in column position (n), as the     
+   /// big endian word it contributes to its column                           
+   constexpr std::array<PHYSFS_uint32, 256> makeTe(int n) {
+      std::array<PHYSFS_uint32, 256> te {};
+      for (int i = 0; i < 256; ++i) {
+         const PHYSFS_uint8 s = Sbox[i];
+         const PHYSFS_uint8 s2 = xtime(s);
+         const PHYSFS_uint32 word = (PHYSFS_uint32(s2) << 24) | (PHYSFS_uint32(s) << 16)
+                                  | (PHYSFS_uint32(s) << 8) | PHYSFS_uint32(s2 ^ s);
+         te[i] = n ? rotr32(word, 8 * n) : word;
+      }
+      return te;
+   }
+
+   constexpr auto Te0 = makeTe(0);
+   constexpr auto Te1 = makeTe(1);
+   constexpr auto Te2 = makeTe(2);
+   constexpr auto Te3 = makeTe(3);
+
+   inline PHYSFS_uint32 loadBE32(const PHYSFS_uint8* p) {
+      return (PHYSFS_uint32(p[0]) << 24) | (PHYSFS_uint32(p[1]) << 16)
+           | (PHYSFS_uint32(p[2]) << 8) | PHYSFS_uint32(p[3]);
+   }
+
+   inline void storeBE32(PHYSFS_uint8* p, PHYSFS_uint32 v) {
+      p[0] = PHYSFS_uint8(v >> 24);
+      p[1] = PHYSFS_uint8(v >> 16);
+      p[2] = PHYSFS_uint8(v >> 8);
+      p[3] = PHYSFS_uint8(v);
+   }
+
+   inline PHYSFS_uint32 subWord(PHYSFS_uint32 w) {
+      return (PHYSFS_uint32(Sbox[w >> 24]) << 24)
+           | (PHYSFS_uint32(Sbox[(w >> 16) & 0xFF]) << 16)
+           | (PHYSFS_uint32(Sbox[(w >> 8) & 0xFF]) << 8)
+           | PHYSFS_uint32(Sbox[w & 0xFF]);
+   }
+
+   /// The counter block of keystream block (block): WinZip counts from one,  
+   /// little endian, in the first eight bytes                                
+   inline void counterBlock(PHYSFS_uint64 block, PHYSFS_uint8* out) {
+      const PHYSFS_uint64 counter = block + 1;
+      for (int i = 0; i < 8; ++i)
+         out[i] = PHYSFS_uint8(counter >> (8 * i));
+      memset(out + 8, 0, 8);
+   }
+
+   /// Encrypt the counter block of keystream block (block) with T-tables,    
+   /// into four big endian words                                             
+   void encryptCounter(const __PHYSFS_AesKey* key, PHYSFS_uint64 block, PHYSFS_uint32* out) {
+      PHYSFS_uint8 counter[16];
+      counterBlock(block, counter);
+
+      const PHYSFS_uint32* rk = key->words;
+      PHYSFS_uint32 s0 = loadBE32(counter) ^ rk[0];
+      PHYSFS_uint32 s1 = loadBE32(counter + 4) ^ rk[1];
+      PHYSFS_uint32 s2 = rk[2];
+      PHYSFS_uint32 s3 = rk[3];
+
+      for (int round = 1; round < key->rounds; ++round) {
+         rk += 4;
+         const PHYSFS_uint32 t0 = Te0[s0 >> 24] ^ Te1[(s1 >> 16) & 0xFF] ^ Te2[(s2 >> 8) & 0xFF] ^ Te3[s3 & 0xFF] ^ rk[0];
+         const PHYSFS_uint32 t1 = Te0[s1 >> 24] ^ Te1[(s2 >> 16) & 0xFF] ^ Te2[(s3 >> 8) & 0xFF] ^ Te3[s0 & 0xFF] ^ rk[1];
+         const PHYSFS_uint32 t2 = Te0[s2 >> 24] ^ Te1[(s3 >> 16) & 0xFF] ^ Te2[(s0 >> 8) & 0xFF] ^ Te3[s1 & 0xFF] ^ rk[2];
+         const PHYSFS_uint32 t3 = Te0[s3 >> 24] ^ Te1[(s0 >> 16) & 0xFF] ^ Te2[(s1 >> 8) & 0xFF] ^ Te3[s2 & 0xFF] ^ rk[3];
+         s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+      }
+
+      // The last round has no MixColumns                               
+      rk += 4;
+      const auto last = [](PHYSFS_uint32 a, PHYSFS_uint32 b, PHYSFS_uint32 c, PHYSFS_uint32 d) {
+         return (PHYSFS_uint32(Sbox[a >> 24]) << 24) | (PHYSFS_uint32(Sbox[(b >> 16) & 0xFF]) << 16)
+              | (PHYSFS_uint32(Sbox[(c >> 8) & 0xFF]) << 8) | PHYSFS_uint32(Sbox[d & 0xFF]);
+      };
+      out[0] = last(s0, s1, s2, s3) ^ rk[0];
+      out[1] = last(s1, s2, s3, s0) ^ rk[1];
+      out[2] = last(s2, s3, s0, s1) ^ rk[2];
+      out[3] = last(s3, s0, s1, s2) ^ rk[3];
+   }
+
+   /// XOR (len) bytes of (buf) with keystream block (block), from byte (skip)
+   void ctrXorPartial(const __PHYSFS_AesKey* key, PHYSFS_uint64 block, size_t skip, PHYSFS_uint8* buf, size_t len) {
+      PHYSFS_uint32 words[4];
+      PHYSFS_uint8 stream[16];
+      encryptCounter(key, block, words);
+      for (int i = 0; i < 4; ++i)
+         storeBE32(stream + 4 * i, words[i]);
+      for (size_t i = 0; i < len; ++i)
+         buf[i] ^= stream[skip + i];
+   }
+
+   void ctrXorBlocksPortable(const __PHYSFS_AesKey* key, PHYSFS_uint64 block, PHYSFS_uint8* buf, size_t count) {
+      PHYSFS_uint32 words[4];
+      for (; count; --count, ++block, buf += 16) {
+         encryptCounter(key, block, words);
+         for (int i = 0; i < 4; ++i)
+            storeBE32(buf + 4 * i, loadBE32(buf + 4 * i) ^ words[i]);
+      }
+   }
+
+#if PHYSFS_AES_X86
+   bool haveAesInstructions() {
+      static const bool have = [] {
+      #if defined(_MSC_VER) and not defined(__clang__)
+         int info[4];
+         __cpuid(info, 1);
+         return (info[2] & (1 << 25)) != 0;
+      #else
+         return __builtin_cpu_supports("aes") != 0;
+      #endif
+      }();
+      return have;
+   }
+
+   /// Four blocks at a time, so the AESENC latency of one hides behind the   
+   /// others                                                                 
+   PHYSFS_AES_TARGET
+   void ctrXorBlocksHardware(const __PHYSFS_AesKey* key, PHYSFS_uint64 block, PHYSFS_uint8* buf, size_t count) {
+      __m128i rk[15];
+      const int rounds = key->rounds;
+      for (int i = 0; i <= rounds; ++i)
+         rk[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(key->bytes) + i);
+
+      const auto counter = [](PHYSFS_uint64 b) {
+         return _mm_set_epi64x(0, static_cast<long long>(b + 1));
+      };
+
+      for (; count >= 4; count -= 4, block += 4, buf += 64) {
+         __m128i b0 = _mm_xor_si128(counter(block), rk[0]);
+         __m128i b1 = _mm_xor_si128(counter(block + 1), rk[0]);
+         __m128i b2 = _mm_xor_si128(counter(block + 2), rk[0]);
+         __m128i b3 = _mm_xor_si128(counter(block + 3), rk[0]);
+         for (int r = 1; r < rounds; ++r) {
+            b0 = _mm_aesenc_si128(b0, rk[r]);
+            b1 = _mm_aesenc_si128(b1, rk[r]);
+            b2 = _mm_aesenc_si128(b2, rk[r]);
+            b3 = _mm_aesenc_si128(b3, rk[r]);
+         }
+         b0 = _mm_aesenclast_si128(b0, rk[rounds]);
+         b1 = _mm_aesenclast_si128(b1, rk[rounds]);
+         b2 = _mm_aesenclast_si128(b2, rk[rounds]);
+         b3 = _mm_aesenclast_si128(b3, rk[rounds]);
+
+         auto data = reinterpret_cast<__m128i*>(buf);
+         _mm_storeu_si128(data + 0, _mm_xor_si128(_mm_loadu_si128(data + 0), b0));
+         _mm_storeu_si128(data + 1, _mm_xor_si128(_mm_loadu_si128(data + 1), b1));
+         _mm_storeu_si128(data + 2, _mm_xor_si128(_mm_loadu_si128(data + 2), b2));
+         _mm_storeu_si128(data + 3, _mm_xor_si128(_mm_loadu_si128(data + 3), b3));
+      }
+
+      for (; count; --count, ++block, buf += 16) {
+         __m128i b = _mm_xor_si128(counter(block), rk[0]);
+         for (int r = 1; r < rounds; ++r)
+            b = _mm_aesenc_si128(b, rk[r]);
+         b = _mm_aesenclast_si128(b, rk[rounds]);
+         auto data = reinterpret_cast<__m128i*>(buf);
+         _mm_storeu_si128(data, _mm_xor_si128(_mm_loadu_si128(data), b));
+      }
+   }
+#elif PHYSFS_AES_ARM
+   bool haveAesInstructions() {
+      return true;
+   }
+
+   void ctrXorBlocksHardware(const __PHYSFS_AesKey* key, PHYSFS_uint64 block, PHYSFS_uint8* buf, size_t count) {
+      uint8x16_t rk[15];
+      const int rounds = key->rounds;
+      for (int i = 0; i <= rounds; ++i)
+         rk[i] = vld1q_u8(key->bytes + 16 * i);
+
+      PHYSFS_uint8 counter[16];
+      for (; count; --count, ++block, buf += 16) {
+         counterBlock(block, counter);
+         uint8x16_t b = vld1q_u8(counter);
+         // AESE does AddRoundKey first, so the keys run one round ahead
+         for (int r = 0; r < rounds - 1; ++r)
+            b = vaesmcq_u8(vaeseq_u8(b, rk[r]));
+         b = veorq_u8(vaeseq_u8(b, rk[rounds - 1]), rk[rounds]);
+         vst1q_u8(buf, veorq_u8(vld1q_u8(buf), b));
+      }
+   }
+#endif
+
+   void ctrXorBlocks(const __PHYSFS_AesKey* key, PHYSFS_uint64 block, PHYSFS_uint8* buf, size_t count) {
+   #if PHYSFS_AES_X86 or PHYSFS_AES_ARM
+      if (key->hardware)
+         return ctrXorBlocksHardware(key, block, buf, count);
+   #endif
+      ctrXorBlocksPortable(key, block, buf, count);
+   }
+
+   inline PHYSFS_uint32 rotl32(PHYSFS_uint32 x, int n) {
+      return (x << n) | (x >> (32 - n));
+   }
+
+   /// SHA-1 round (I) of a block. The message schedule is kept as a ring of  
+   /// sixteen words updated in place, and callers rotate the variables instead
+   /// of moving them, so a fully unrolled block stays in registers           
+   template<int I>
+   inline void sha1Round(PHYSFS_uint32 a, PHYSFS_uint32& b, PHYSFS_uint32 c, PHYSFS_uint32 d, PHYSFS_uint32& e, PHYSFS_uint32* w) {
+      if constexpr (I >= 16)
+         w[I % 16] = rotl32(w[(I + 13) % 16] ^ w[(I + 8) % 16] ^ w[(I + 2) % 16] ^ w[I % 16], 1);
+
+      if constexpr (I < 20)
+         e += (d ^ (b & (c ^ d))) + 0x5A827999;
+      else if constexpr (I < 40)
+         e += (b ^ c ^ d) + 0x6ED9EBA1;
+      else if constexpr (I < 60)
+         e += ((b & c) | (d & (b | c))) + 0x8F1BBCDC;
+      else
+         e += (b ^ c ^ d) + 0xCA62C1D6;
+
+      e += rotl32(a, 5) + w[I % 16];
+      b = rotl32(b, 30);
+   }
+
+   /// Five rounds, after which the variables are back in their places        
+   template<int I>
+   inline void sha1Rounds(PHYSFS_uint32* v, PHYSFS_uint32* w) {
+      sha1Round<I * 5>(v[0], v[1], v[2], v[3], v[4], w);
+      sha1Round<I * 5 + 1>(v[4], v[0], v[1], v[2], v[3], w);
+      sha1Round<I * 5 + 2>(v[3], v[4], v[0], v[1], v[2], w);
+      sha1Round<I * 5 + 3>(v[2], v[3], v[4], v[0], v[1], w);
+      sha1Round<I * 5 + 4>(v[1], v[2], v[3], v[4], v[0], w);
+   }
+
+   template<int... I>
+   inline void sha1Block(std::integer_sequence<int, I...>, PHYSFS_uint32* v, PHYSFS_uint32* w) {
+      (sha1Rounds<I>(v, w), ...);
+   }
+
+   void sha1BlocksPortable(PHYSFS_uint32* state, const PHYSFS_uint8* data, size_t count) {
+      for (; count; --count, data += 64) {
+         PHYSFS_uint32 w[16];
+         for (int i = 0; i < 16; ++i)
+            w[i] = loadBE32(data + 4 * i);
+
+         PHYSFS_uint32 v[5] = {state[0], state[1], state[2], state[3], state[4]};
+         sha1Block(std::make_integer_sequence<int, 16> {}, v, w);
+         for (int i = 0; i < 5; ++i)
+            state[i] += v[i];
+      }
+   }
+
+#if PHYSFS_AES_X86
+   bool haveShaInstructions() {
+      static const bool have = [] {
+      #if defined(_MSC_VER) and not defined(__clang__)
+         int info[4];
+         __cpuid(info, 0);
+         if (info[0] < 7)
+            return false;
+         __cpuidex(info, 7, 0);
+         return (info[1] & (1 << 29)) != 0;
+      #else
+         return __builtin_cpu_supports("sha") != 0;
+      #endif
+      }();
+      return have;
+   }
+
+   /// Rounds 4G to 4G+3, while scheduling the message words that later       
+   /// groups need. The two E registers take turns                            
+   template<int G>
+   PHYSFS_SHA_TARGET
+   inline void sha1Group(__m128i& abcd, __m128i* e, __m128i* msg) {
+      e[G % 2] = _mm_sha1nexte_epu32(e[G % 2], msg[G % 4]);
+      e[(G + 1) % 2] = abcd;
+      if constexpr (G >= 3 and G <= 18)
+         msg[(G + 1) % 4] = _mm_sha1msg2_epu32(msg[(G + 1) % 4], msg[G % 4]);
+      abcd = _mm_sha1rnds4_epu32(abcd, e[G % 2], G / 5);
+      if constexpr (G <= 16)
+         msg[(G + 3) % 4] = _mm_sha1msg1_epu32(msg[(G + 3) % 4], msg[G % 4]);
+      if constexpr (G >= 2 and G <= 17)
+         msg[(G + 2) % 4] = _mm_xor_si128(msg[(G + 2) % 4], msg[G % 4]);
+   }
+
+   template<int... G>
+   PHYSFS_SHA_TARGET
+   inline void sha1Groups(std::integer_sequence<int, G...>, __m128i& abcd, __m128i* e, __m128i* msg) {
+      (sha1Group<G + 1>(abcd, e, msg), ...);
+   }
+
+   PHYSFS_SHA_TARGET
+   void sha1BlocksHardware(PHYSFS_uint32* state, const PHYSFS_uint8* data, size_t count) {
+      const __m128i mask = _mm_set_epi64x(0x0001020304050607LL, 0x08090A0B0C0D0E0FLL);
+      __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1B);
+      __m128i e0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+
+      for (; count; --count, data += 64) {
+         const __m128i abcdSave = abcd;
+         const __m128i e0Save = e0;
+         __m128i msg[4], e[2];
+         for (int i = 0; i < 4; ++i) {
+            msg[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data) + i);
+            msg[i] = _mm_shuffle_epi8(msg[i], mask);
+         }
+
+         e[0] = _mm_add_epi32(e0, msg[0]);
+         e[1] = abcd;
+         abcd = _mm_sha1rnds4_epu32(abcd, e[0], 0);
+         sha1Groups(std::make_integer_sequence<int, 19> {}, abcd, e, msg);
+
+         e0 = _mm_sha1nexte_epu32(e[0], e0Save);
+         abcd = _mm_add_epi32(abcd, abcdSave);
+      }
+
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(abcd, 0x1B));
+      state[4] = static_cast<PHYSFS_uint32>(_mm_extract_epi32(e0, 3));
+   }
+#endif
+
+   void sha1Blocks(PHYSFS_uint32* state, const PHYSFS_uint8* data, size_t count) {
+   #if PHYSFS_AES_X86
+      if (haveShaInstructions())
+         return sha1BlocksHardware(state, data, count);
+   #endif
+      sha1BlocksPortable(state, data, count);
+   }
+}
+
+
+int __PHYSFS_AesSetKey(__PHYSFS_AesKey* key, const PHYSFS_uint8* raw, size_t len) {
+   if (len != 16 and len != 24 and len != 32)
+      return 0;
+
+   const int nk = int(len / 4);
+   key->rounds = nk + 6;
+   const int total = 4 * (key->rounds + 1);
+   for (int i = 0; i < nk; ++i)
+      key->words[i] = loadBE32(raw + 4 * i);
+
+   PHYSFS_uint32 rcon = 0x01;
+   for (int i = nk; i < total; ++i) {
+      PHYSFS_uint32 temp = key->words[i - 1];
+      if (i % nk == 0) {
+         temp = subWord(rotl32(temp, 8)) ^ (rcon << 24);
+         rcon = xtime(PHYSFS_uint8(rcon));
+      }
+      else if (nk > 6 and i % nk == 4)
+         temp = subWord(temp);
+      key->words[i] = key->words[i - nk] ^ temp;
+   }
+
+   for (int i = 0; i < total; ++i)
+      storeBE32(key->bytes + 4 * i, key->words[i]);
+
+#if PHYSFS_AES_X86 or PHYSFS_AES_ARM
+   key->hardware = haveAesInstructions();
+#else
+   key->hardware = 0;
+#endif
+   return 1;
+}
+
+void __PHYSFS_AesCtrXor(const __PHYSFS_AesKey* key, PHYSFS_uint64 pos, PHYSFS_uint8* buf, size_t len) {
+   PHYSFS_uint64 block = pos / 16;
+   const size_t skip = size_t(pos % 16);
+
+   if (skip and len) {
+      const size_t take = std::min(len, 16 - skip);
+      ctrXorPartial(key, block++, skip, buf, take);
+      buf += take;
+      len -= take;
+   }
+
+   const size_t full = len / 16;
+   if (full) {
+      ctrXorBlocks(key, block, buf, full);
+      block += full;
+      buf += 16 * full;
+      len -= 16 * full;
+   }
+
+   if (len)
+      ctrXorPartial(key, block, 0, buf, len);
+}
+
+void __PHYSFS_Sha1Init(__PHYSFS_Sha1* sha) {
+   sha->state[0] = 0x67452301;
+   sha->state[1] = 0xEFCDAB89;
+   sha->state[2] = 0x98BADCFE;
+   sha->state[3] = 0x10325476;
+   sha->state[4] = 0xC3D2E1F0;
+   sha->length = 0;
+}
+
+void __PHYSFS_Sha1Update(__PHYSFS_Sha1* sha, const void* data, size_t len) {
+   auto ptr = static_cast<const PHYSFS_uint8*>(data);
+   size_t used = size_t(sha->length % 64);
+   sha->length += len;
+
+   if (used) {
+      const size_t take = std::min(len, 64 - used);
+      memcpy(sha->block + used, ptr, take);
+      ptr += take;
+      len -= take;
+      if (used + take < 64)
+         return;
+      sha1Blocks(sha->state, sha->block, 1);
+   }
+
+   if (len >= 64) {
+      sha1Blocks(sha->state, ptr, len / 64);
+      ptr += len - len % 64;
+      len %= 64;
+   }
+   memcpy(sha->block, ptr, len);
+}
+
+void __PHYSFS_Sha1Final(__PHYSFS_Sha1* sha, PHYSFS_uint8* digest) {
+   const PHYSFS_uint64 bits = sha->length * 8;
+   static const PHYSFS_uint8 pad[64] = {0x80};
+   const size_t used = size_t(sha->length % 64);
+   __PHYSFS_Sha1Update(sha, pad, (used < 56) ? (56 - used) : (120 - used));
+
+   PHYSFS_uint8 trailer[8];
+   for (int i = 0; i < 8; ++i)
+      trailer[i] = PHYSFS_uint8(bits >> (56 - 8 * i));
+   __PHYSFS_Sha1Update(sha, trailer, 8);
+
+   for (int i = 0; i < 5; ++i)
+      storeBE32(digest + 4 * i, sha->state[i]);
+}
+
+void __PHYSFS_HmacSha1Init(__PHYSFS_HmacSha1* mac, const PHYSFS_uint8* key, size_t len) {
+   PHYSFS_uint8 block[64] = {};
+   if (len > 64) {
+      __PHYSFS_Sha1 sha;
+      __PHYSFS_Sha1Init(&sha);
+      __PHYSFS_Sha1Update(&sha, key, len);
+      __PHYSFS_Sha1Final(&sha, block);
+   }
+   else memcpy(block, key, len);
+
+   for (auto& b : block)
+      b ^= 0x36;
+   __PHYSFS_Sha1Init(&mac->inner);
+   __PHYSFS_Sha1Update(&mac->inner, block, 64);
+
+   // 0x36 ^ 0x5C, to turn the inner pad into the outer one             
+   for (auto& b : block)
+      b ^= 0x6A;
+   __PHYSFS_Sha1Init(&mac->outer);
+   __PHYSFS_Sha1Update(&mac->outer, block, 64);
+}
+
+void __PHYSFS_HmacSha1Update(__PHYSFS_HmacSha1* mac, const void* data, size_t len) {
+   __PHYSFS_Sha1Update(&mac->inner, data, len);
+}
+
+void __PHYSFS_HmacSha1Final(__PHYSFS_HmacSha1* mac, PHYSFS_uint8* digest) {
+   PHYSFS_uint8 inner[20];
+   __PHYSFS_Sha1Final(&mac->inner, inner);
+   __PHYSFS_Sha1Update(&mac->outer, inner, sizeof(inner));
+   __PHYSFS_Sha1Final(&mac->outer, digest);
+}
+
+void __PHYSFS_Pbkdf2Sha1(
+   const PHYSFS_uint8* password, size_t passlen,
+   const PHYSFS_uint8* salt, size_t saltlen,
+   PHYSFS_uint32 iterations, PHYSFS_uint8* out, size_t outlen
+) {
+   __PHYSFS_HmacSha1 keyed;
+   __PHYSFS_HmacSha1Init(&keyed, password, passlen);
+
+   for (PHYSFS_uint32 index = 1; outlen; ++index) {
+      PHYSFS_uint8 be[4], u[20], t[20];
+      storeBE32(be, index);
+
+      auto mac = keyed;
+      __PHYSFS_HmacSha1Update(&mac, salt, saltlen);
+      __PHYSFS_HmacSha1Update(&mac, be, sizeof(be));
+      __PHYSFS_HmacSha1Final(&mac, u);
+      memcpy(t, u, sizeof(t));
+
+      for (PHYSFS_uint32 i = 1; i < iterations; ++i) {
+         mac = keyed;
+         __PHYSFS_HmacSha1Update(&mac, u, sizeof(u));
+         __PHYSFS_HmacSha1Final(&mac, u);
+         for (int j = 0; j < 20; ++j)
+            t[j] ^= u[j];
+      }
+
+      const size_t take = std::min(outlen, sizeof(t));
+      memcpy(out, t, take);
+      out += take;
+      outlen -= take;
+   }
+}
@@ -0,0 +1,60 @@
+///                                                                           
+/// Internal function/structure declaration. Do NOT include in your           
+/// application.                                                              
+/// Please see the file LICENSE.txt in the source's root directory.           
+///                                                                           
+#pragma once
+#include "physfs_internal.hpp"
+
+
+/// The primitives WinZip AES encryption (AE-1 and AE-2) is built from: AES   
+/// in counter mode, HMAC-SHA1 over the ciphertext, and PBKDF2-HMAC-SHA1 to   
+/// turn a password into keys. Only what decrypting an archive needs is here, 
+/// and none of it is hardened against timing attacks: it protects data at    
+/// rest, read by whoever holds the password anyway                           
+
+/// An expanded AES-128, AES-192 or AES-256 encryption key                    
+struct __PHYSFS_AesKey {
+   PHYSFS_uint32 words[60];              // round keys, as big endian words
+   alignas(16) PHYSFS_uint8 bytes[240];  // same keys, for AES instructions
+   int rounds;                           // 10, 12 or 14
+   int hardware;                         // nonzero to use AES instructions
+};
+
+/// (len) is 16, 24 or 32. Returns zero for any other length                  
+int  __PHYSFS_AesSetKey(__PHYSFS_AesKey* key, const PHYSFS_uint8* raw, size_t len);
+
+/// XORs (len) bytes at (buf) with the keystream WinZip uses, starting at     
+/// byte (pos) of it. The counter is little endian and starts at one, so any  
+/// position can be decrypted without the bytes before it                     
+void __PHYSFS_AesCtrXor(const __PHYSFS_AesKey* key, PHYSFS_uint64 pos, PHYSFS_uint8* buf, size_t len);
+
+
+struct __PHYSFS_Sha1 {
+   PHYSFS_uint32 state[5];
+   PHYSFS_uint64 length;                 // bytes hashed so far
+   PHYSFS_uint8 block[64];               // partial block, length % 64 bytes
+};
+
+void __PHYSFS_Sha1Init(__PHYSFS_Sha1* sha);
+void __PHYSFS_Sha1Update(__PHYSFS_Sha1* sha, const void* data, size_t len);
+void __PHYSFS_Sha1Final(__PHYSFS_Sha1* sha, PHYSFS_uint8* digest);
+
+
+/// HMAC-SHA1, with both pads already hashed in, so that copying one after    
+/// Init is the cheap way to MAC many messages under the same key             
+struct __PHYSFS_HmacSha1 {
+   __PHYSFS_Sha1 inner;
+   __PHYSFS_Sha1 outer;
+};
+
+void __PHYSFS_HmacSha1Init(__PHYSFS_HmacSha1* mac, const PHYSFS_uint8* key, size_t len);
+void __PHYSFS_HmacSha1Update(__PHYSFS_HmacSha1* mac, const void* data, size_t len);
+void __PHYSFS_HmacSha1Final(__PHYSFS_HmacSha1* mac, PHYSFS_uint8* digest);
+
+/// PBKDF2 with HMAC-SHA1, as in RFC 2898                                     
+void __PHYSFS_Pbkdf2Sha1(
+   const PHYSFS_uint8* password, size_t passlen,
+   const PHYSFS_uint8* salt, size_t saltlen,
+   PHYSFS_uint32 iterations, PHYSFS_uint8* out, size_t outlen
+);
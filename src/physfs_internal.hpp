@@ -13,6 +13,7 @@
 
 #include "physfs.hpp"
 #include "physfs_platforms.hpp"
+#include <cstdlib>
 
 // !!! FIXME: remove this when revamping stack allocation code...
 #if defined(_MSC_VER) or defined(__MINGW32__) or defined(__WATCOMC__)
@@ -28,6 +29,48 @@
 #endif
 
 
+/// The build reflects each METAPHYSFS_ARCHIVE_* option as a define, the      
+/// archiver registration below keys off PHYSFS_SUPPORTS_*                    
+#ifdef METAPHYSFS_ARCHIVE_ZIP
+   #define PHYSFS_SUPPORTS_ZIP 1
+#endif
+#ifdef METAPHYSFS_ARCHIVE_7Z
+   #define PHYSFS_SUPPORTS_7Z 1
+#endif
+#ifdef METAPHYSFS_ARCHIVE_GRP
+   #define PHYSFS_SUPPORTS_GRP 1
+#endif
+#ifdef METAPHYSFS_ARCHIVE_WAD
+   #define PHYSFS_SUPPORTS_WAD 1
+#endif
+#ifdef METAPHYSFS_ARCHIVE_CSM
+   #define PHYSFS_SUPPORTS_CSM 1
+#endif
+#ifdef METAPHYSFS_ARCHIVE_HOG
+   #define PHYSFS_SUPPORTS_HOG 1
+#endif
+#ifdef METAPHYSFS_ARCHIVE_MVL
+   #define PHYSFS_SUPPORTS_MVL 1
+#endif
+#ifdef METAPHYSFS_ARCHIVE_QPAK
+   #define PHYSFS_SUPPORTS_QPAK 1
+#endif
+#ifdef METAPHYSFS_ARCHIVE_SLB
+   #define PHYSFS_SUPPORTS_SLB 1
+#endif
+#ifdef METAPHYSFS_ARCHIVE_ISO9660
+   #define PHYSFS_SUPPORTS_ISO9660 1
+#endif
+#ifdef METAPHYSFS_ARCHIVE_VDF
+   #define PHYSFS_SUPPORTS_VDF 1
+#endif
+#ifdef METAPHYSFS_ARCHIVE_MPK
+   #define PHYSFS_SUPPORTS_MPK 1
+#endif
+#ifdef METAPHYSFS_ARCHIVE_MPL
+   #define PHYSFS_SUPPORTS_MPL 1
+#endif
+
 /// These are the build-in archivers. We list them all as "extern" here       
 /// without #ifdefs to keep it tidy, but obviously you need to make sure      
 /// these are wrapped in PHYSFS_SUPPORTS_* checks before actually referencing 
@@ -44,6 +87,8 @@ extern const PHYSFS_Archiver __PHYSFS_Archiver_CSM;
 extern const PHYSFS_Archiver __PHYSFS_Archiver_SLB;
 extern const PHYSFS_Archiver __PHYSFS_Archiver_ISO9660;
 extern const PHYSFS_Archiver __PHYSFS_Archiver_VDF;
+extern const PHYSFS_Archiver __PHYSFS_Archiver_MPK;
+extern const PHYSFS_Archiver __PHYSFS_Archiver_MPL;
 
 /// Some simple wrappers around WinRT C++ interfaces we can call from C.      
 #ifdef PHYSFS_PLATFORM_WINRT
@@ -129,16 +174,49 @@ void __PHYSFS_smallFree(void*);
 #define free(x)         Do not use free() directly.
 #define alloca(x)       Do not use alloca() directly.
 
+/// Shorthand for the runtime allocator (see PHYSFS_setAllocator) that all    
+/// of PhysicsFS allocates through. Free is a plain static function, so it    
+/// can still be handed out as a destructor callback                          
+struct __PHYSFS_RuntimeAllocator {
+   METAPHYSFS(INLINED)
+   static void* Malloc(PHYSFS_uint64 size, PHYSFS_AllocTag tag = PHYSFS_ALLOC_GENERAL) {
+      return PHYSFS_allocate(size, tag);
+   }
+
+   /// A reallocated pointer keeps the tag it was first allocated with        
+   METAPHYSFS(INLINED)
+   static void* Realloc(void* ptr, PHYSFS_uint64 size, PHYSFS_AllocTag tag = PHYSFS_ALLOC_GENERAL) {
+      return PHYSFS_reallocate(ptr, size, tag);
+   }
+
+   static void Free(void* ptr) {
+      PHYSFS_deallocate(ptr);
+   }
+};
+
+inline constexpr __PHYSFS_RuntimeAllocator allocator {};
+
+/// Platforms without a usable C runtime heap call this from                  
+/// __PHYSFS_platformInit() to supply the default allocator. It's ignored if  
+/// the app already installed its own with PHYSFS_setAllocator()              
+void __PHYSFS_setPlatformAllocator(const PHYSFS_AllocatorCallbacks* callbacks);
+
 #if PHYSFS_SUPPORTS_7Z
    /// 7zip support needs a global init function called at startup (no deinit)
    extern void SZIP_global_init(void);
 #endif
 
 /// The latest supported PHYSFS_Io::version value                             
-#define CURRENT_PHYSFS_IO_API_VERSION 0
+#define CURRENT_PHYSFS_IO_API_VERSION 1
+
+/// Check if an io has a usable PHYSFS_Io::readAt (added in version 1)        
+METAPHYSFS(INLINED)
+bool __PHYSFS_ioCanReadAt(const PHYSFS_Io* io) noexcept {
+   return io->version >= 1 and io->readAt;
+}
 
 /// The latest supported PHYSFS_Archiver::version value                       
-#define CURRENT_PHYSFS_ARCHIVER_API_VERSION 0
+#define CURRENT_PHYSFS_ARCHIVER_API_VERSION 2
 
 ///                                                                           
 /// When sorting the entries in an archive, we use a modified QuickSort.      
@@ -233,10 +311,18 @@ PHYSFS_uint32 __PHYSFS_hashStringCaseFoldUSAscii(const char* str);
 /*
  * Create a PHYSFS_Io for a file in the physical filesystem.
  *  This path is in platform-dependent notation. (mode) must be 'r', 'w', or
- *  'a' for Read, Write, or Append.
+ *  'a' for Read, Write, or Append, or 'd' to read with direct i/o, past the
+ *  page cache. 'd' quietly turns into 'r' where direct i/o isn't available.
  */
 PHYSFS_Io* __PHYSFS_createNativeIo(const char* path, const int mode);
 
+/*
+ * Open (filename) in a directory mounted with __PHYSFS_Archiver_DIR, whose
+ *  instance is (opaque), with mode 'd'. This is PHYSFS_openReadDirect()'s
+ *  way into a directory, since an archiver's openRead can't be told.
+ */
+PHYSFS_Io* __PHYSFS_DirOpenReadDirect(void* opaque, const char* filename);
+
 /*
  * Create a PHYSFS_Io for a buffer of memory (READ-ONLY). If you already
  *  have one of these, just use its duplicate() method, and it'll increment
@@ -245,6 +331,39 @@ PHYSFS_Io* __PHYSFS_createNativeIo(const char* path, const int mode);
 PHYSFS_Io* __PHYSFS_createMemoryIo(const void* buf, PHYSFS_uint64 len,
    void (*destruct)(void*));
 
+#if defined(METAPHYSFS_READ_AHEAD) and not defined(PHYSFS_NO_READ_AHEAD)
+#define PHYSFS_HAVE_READ_AHEAD 1
+
+/*
+ * Wrap (io) so that a helper thread keeps up to (chunkCount) chunks of
+ *  (chunkSize) bytes read ahead of its current position, but never past
+ *  byte (end). Meant for archivers that decompress a long sequential run
+ *  of (io), so the next compressed chunk is fetched while the current one
+ *  is inflated. Seeking restarts the pipeline at the new position.
+ *
+ * On success, the returned io owns (io). Return (nullptr) and leave (io)
+ *  alone if the wrapper can't be made; (io) is still perfectly usable then.
+ */
+PHYSFS_Io* __PHYSFS_createReadAheadIo(PHYSFS_Io* io, PHYSFS_uint64 end,
+   size_t chunkSize, int chunkCount);
+
+/*
+ * Smallest compressed entry that archivers should read ahead, as set with
+ *  PHYSFS_setReadAhead() in the current context. Zero if read-ahead is
+ *  switched off.
+ */
+PHYSFS_uint64 __PHYSFS_readAheadMinSize();
+#endif
+
+/*
+ * Archivers that can inline small files ask this once, when they mount.
+ *  Returns the largest file to inline, zero if inlining is off, and puts
+ *  the most bytes to inline per archive in (maxBytes). Both as set with
+ *  PHYSFS_setInlineSmallFiles() in the current context, which is the one
+ *  doing the mount.
+ */
+PHYSFS_uint32 __PHYSFS_inlineMaxFileSize(PHYSFS_uint64* maxBytes);
+
 
 /*
  * Read (len) bytes from (io) into (buf). Returns non-zero on success,
@@ -252,6 +371,19 @@ PHYSFS_Io* __PHYSFS_createMemoryIo(const void* buf, PHYSFS_uint64 len,
  */
 int __PHYSFS_readAll(PHYSFS_Io* io, void* buf, const size_t len);
 
+/// 64-bit FNV-1a, what MetaPhysFS's own pack formats hash names and data     
+/// with. Start from __PHYSFS_FNV_BASIS, and feed the result back in to hash  
+/// something in pieces                                                       
+constexpr PHYSFS_uint64 __PHYSFS_FNV_BASIS = 0xCBF29CE484222325ull;
+
+METAPHYSFS(INLINED)
+PHYSFS_uint64 __PHYSFS_fnv1a(PHYSFS_uint64 hash, const void* data, size_t len) noexcept {
+   auto p = static_cast<const PHYSFS_uint8*>(data);
+   for (size_t i = 0; i < len; ++i)
+      hash = (hash ^ p[i]) * 0x00000100000001B3ull;
+   return hash;
+}
+
 
 
 /*--------------------------------------------------------------------------*/
@@ -359,6 +491,36 @@ void* __PHYSFS_platformOpenAppend(const char* filename);
  */
 PHYSFS_sint64 __PHYSFS_platformRead(void* opaque, void* buf, PHYSFS_uint64 len);
 
+#if PHYSFS_HAVE_DIRECT_IO
+/*
+ * Open a file for reading with direct i/o (O_DIRECT on Linux), bypassing the
+ *  page cache. Reads from this handle will only ever go through
+ *  __PHYSFS_platformReadAt(), with offsets, lengths and buffers aligned to
+ *  PHYSFS_DIRECT_IO_ALIGNMENT.
+ *
+ * Return (nullptr) without setting an error if the filesystem refuses direct
+ *  i/o, so the caller can quietly open it the usual way instead. Set an error
+ *  and return (nullptr) if the file can't be opened at all.
+ */
+#define PHYSFS_DIRECT_IO_ALIGNMENT 4096
+void* __PHYSFS_platformOpenReadDirect(const char* filename);
+#endif
+
+#ifndef PHYSFS_NO_POSITIONAL_READS
+/*
+ * Read up to (len) bytes at byte (offset) of a platform-specific file handle,
+ *  without moving its file pointer, like pread(). This has to be safe to
+ *  call from several threads at once on the same handle. Return the number
+ *  of bytes read, 0 at or past the end of the file, or (-1) on catastrophic
+ *  error, after calling PHYSFS_setErrorCode().
+ *
+ * Platforms that can't do this define PHYSFS_NO_POSITIONAL_READS, and native
+ *  files then fall back to the serialized path in PHYSFS_readAt().
+ */
+PHYSFS_sint64 __PHYSFS_platformReadAt(void* opaque, PHYSFS_uint64 offset,
+   void* buf, PHYSFS_uint64 len);
+#endif
+
 /*
  * Write more data to a platform-specific file handle. (opaque) should be
  *  cast to whatever data type your platform uses. Write a maximum of (len)
@@ -423,6 +585,20 @@ PHYSFS_sint64 __PHYSFS_platformFileLength(void* handle);
  */
 int __PHYSFS_platformStat(const char* fn, PHYSFS_Stat* stat, const int follow);
 
+#if PHYSFS_HAVE_FILE_IDS
+/*
+ * Identify the file at (fname) by the device it's on and its inode (or
+ *  whatever the platform calls it), so that two paths naming the same file
+ *  can be told apart from two copies of it. Symlinks are followed.
+ *
+ * Return non-zero and fill in (device) and (inode) on success. Return zero
+ *  without setting an error if the platform can't tell for this file; the
+ *  caller then falls back to comparing paths.
+ */
+int __PHYSFS_platformFileId(const char* fname, PHYSFS_uint64* device,
+   PHYSFS_uint64* inode);
+#endif
+
 /*
  * Flush any pending writes to disk. (opaque) should be cast to whatever data
  *  type your platform uses. Be sure to check for errors; the caller expects
@@ -527,6 +703,28 @@ int __PHYSFS_platformMkDir(const char* path);
 int __PHYSFS_platformDelete(const char* path);
 
 
+/*
+ * Rename the file (from) to (to), both in platform-dependent notation,
+ *  replacing (to) if it exists. Where the platform allows it, this should
+ *  be atomic: anyone opening (to) sees either the old file or the new one.
+ *
+ * On error, return zero and set the error message. Return non-zero on success.
+ */
+int __PHYSFS_platformRename(const char* from, const char* to);
+
+
+/*
+ * Make everything written to the files in (paths) durable, along with the
+ *  entries created or renamed in any directories in (paths). All paths are
+ *  in platform-dependent notation. Batch the device flushes as much as the
+ *  platform allows: this is called for many files at once precisely so it
+ *  doesn't take a flush per file.
+ *
+ * On error, return zero and set the error message. Return non-zero on success.
+ */
+int __PHYSFS_platformSync(const char* const* paths, size_t count);
+
+
 /*
  * Create a platform-specific mutex. This can be whatever datatype your
  *  platform uses for mutexes, but it is cast to a (void *) for abstractness.
@@ -573,6 +771,88 @@ int __PHYSFS_platformGrabMutex(void* mutex);
  */
 void __PHYSFS_platformReleaseMutex(void* mutex);
 
+#ifndef PHYSFS_NO_THREADS
+/*
+ * Start a thread that runs (fn)(arg) and then ends. Return a handle for
+ *  __PHYSFS_platformJoinThread(), or set an error and return (nullptr) if
+ *  the thread can't be started. (fn) must not let an exception escape.
+ */
+void* __PHYSFS_platformCreateThread(void (*fn)(void*), void* arg);
+
+/*
+ * Wait for a thread from __PHYSFS_platformCreateThread() to end, and free
+ *  its handle. Every thread must be joined exactly once.
+ */
+void __PHYSFS_platformJoinThread(void* thread);
+
+/*
+ * Create a condition variable, to wait for with a mutex made by
+ *  __PHYSFS_platformCreateMutex(). Set an error and return (nullptr) if you
+ *  couldn't make one.
+ */
+void* __PHYSFS_platformCreateCond(void);
+
+/*
+ * Destroy a condition variable from __PHYSFS_platformCreateCond(). Nothing
+ *  may be waiting for it.
+ */
+void __PHYSFS_platformDestroyCond(void* cond);
+
+/*
+ * Release (mutex), which the calling thread must hold exactly once, wait
+ *  until (cond) is broadcast, and grab (mutex) again before returning.
+ *  Waking up without a broadcast is allowed, so callers wait in a loop
+ *  until what they're waiting for is true.
+ *
+ * _DO NOT_ call PHYSFS_setErrorCode() in here, for the same reasons as in
+ *  __PHYSFS_platformGrabMutex().
+ */
+void __PHYSFS_platformWaitCond(void* cond, void* mutex);
+
+/*
+ * Same as __PHYSFS_platformWaitCond(), but stop waiting after (ms)
+ *  milliseconds even if (cond) isn't broadcast. (mutex) is held again when
+ *  this returns either way, and waking up early is allowed here too.
+ */
+void __PHYSFS_platformWaitCondTimeout(void* cond, void* mutex, PHYSFS_uint32 ms);
+
+/*
+ * Wake every thread waiting for (cond). The caller should hold the mutex
+ *  they wait with, so a waiter can't miss it between checking and waiting.
+ */
+void __PHYSFS_platformBroadcastCond(void* cond);
+
+/// Holds a platform mutex for a scope, so a throw never leaves it held.      
+/// It can be let go and grabbed again in between, and wait() lets go of it   
+/// while sleeping on a condition variable, until (ready) returns true        
+struct __PHYSFS_PlatformLock {
+   void* mutex;
+   bool held = false;
+
+   explicit __PHYSFS_PlatformLock(void* m) : mutex {m} { lock(); }
+   ~__PHYSFS_PlatformLock() { if (held) unlock(); }
+
+   __PHYSFS_PlatformLock(const __PHYSFS_PlatformLock&) = delete;
+   __PHYSFS_PlatformLock& operator = (const __PHYSFS_PlatformLock&) = delete;
+
+   void lock() {
+      __PHYSFS_platformGrabMutex(mutex);
+      held = true;
+   }
+
+   void unlock() {
+      held = false;
+      __PHYSFS_platformReleaseMutex(mutex);
+   }
+
+   template<class F>
+   void wait(void* cond, F&& ready) {
+      while (not ready())
+         __PHYSFS_platformWaitCond(cond, mutex);
+   }
+};
+#endif
+
 
 /* !!! FIXME: move to public API? */
 PHYSFS_uint32 __PHYSFS_utf8codepoint(const char** _str);
@@ -5,119 +5,377 @@
 /// This file written by Ryan C. Gordon.                                      
 ///                                                                           
 #include "physfs_tree.hpp"
+#include <algorithm>
+#include <cassert>
+
+
+namespace
+{
+   /// Plain allocation for tree blocks and tables. Going through             
+   /// PHYSFS_Allocator(...).Ref() would make and drop a reference counter    
+   /// for every single block, which is exactly the overhead trees avoid      
+   METAPHYSFS(INLINED)
+   void* allocRaw(const size_t bytes) {
+      auto ptr = PHYSFS_Allocator<void, PHYSFS_ALLOC_DIRTREE>::Realloc(nullptr, bytes);
+      BAIL_IF(not ptr, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+      return ptr;
+   }
+
+   /// Grow one of the tree's blocks to hold at least 'needed' items of       
+   /// 'itemlen' bytes, doubling its capacity. The block may move             
+   ///   @return non-zero on success                                          
+   template<class T>
+   int growBlock(T*& block, PHYSFS_uint32& capacity, const PHYSFS_uint64 needed, const size_t itemlen) {
+      PHYSFS_uint64 grown = capacity;
+      while (grown < needed)
+         grown *= 2;
+      BAIL_IF(grown > 0xFFFFFFFF, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+
+      auto ptr = PHYSFS_Allocator<void, PHYSFS_ALLOC_DIRTREE>::Realloc(block, size_t(grown) * itemlen);
+      BAIL_IF(not ptr, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+      block = static_cast<T*>(ptr);
+      capacity = PHYSFS_uint32(grown);
+      return 1;
+   }
+
+   ///                                                                        
+   /// Path components are never copied while searching: they're read in      
+   /// place, and a '/' ends a component just as the null terminator does     
+   ///                                                                        
+   METAPHYSFS(INLINED)
+   bool isComponentEnd(const char ch) noexcept {
+      return ch == '\0' or ch == '/';
+   }
+
+   /// Hash a single path component, and mix in the id of its parent, so      
+   /// that identical names in different directories land apart               
+   PHYSFS_uint32 hashComponent(const __PHYSFS_DirTree* dt, PHYSFS_uint32 parent, const char* str) {
+      PHYSFS_uint32 hash = 5381;
+
+      if (dt->case_sensitive) {
+         for (; not isComponentEnd(*str); ++str)
+            hash = ((hash << 5) + hash) ^ *str;
+      }
+      else if (dt->only_usascii) {
+         for (; not isComponentEnd(*str); ++str) {
+            char ch = *str;
+            if (ch >= 'A' and ch <= 'Z')
+               ch -= ('A' - 'a');
+            hash = ((hash << 5) + hash) ^ ch;
+         }
+      }
+      else while (1) {
+         const auto cp = __PHYSFS_utf8codepoint(&str);
+         if (not cp or cp == '/')
+            break;
+
+         PHYSFS_uint32 folded[3];
+         const int numbytes = PHYSFS_caseFold(cp, folded) * sizeof(PHYSFS_uint32);
+         const char* bytes  = (const char*) folded;
+         for (auto i = 0; i < numbytes; i++)
+            hash = ((hash << 5) + hash) ^ *(bytes++);
+      }
+
+      // Fibonacci-scramble the parent id in                            
+      return hash ^ (parent * 0x9E3779B1u);
+   }
+
+   /// Compare a stored leaf name against a path component in place           
+   bool componentMatches(const __PHYSFS_DirTree* dt, const char* leaf, const char* str) {
+      if (dt->case_sensitive) {
+         while (*leaf and *leaf == *str)
+            ++leaf, ++str;
+         return not *leaf and isComponentEnd(*str);
+      }
+      else if (dt->only_usascii) {
+         while (*leaf) {
+            char a = *leaf, b = *str;
+            if (a >= 'A' and a <= 'Z')
+               a -= ('A' - 'a');
+            if (b >= 'A' and b <= 'Z')
+               b -= ('A' - 'a');
+            if (a != b)
+               return false;
+            ++leaf, ++str;
+         }
+         return isComponentEnd(*str);
+      }
+
+      // Same as PHYSFS_utf8stricmp, except it stops at '/' too         
+      PHYSFS_uint32 folded1[3], folded2[3];
+      int head1 = 0, tail1 = 0, head2 = 0, tail2 = 0;
+      while (1) {
+         PHYSFS_uint32 cp1, cp2;
+         if (head1 != tail1)
+            cp1 = folded1[tail1++];
+         else {
+            head1 = PHYSFS_caseFold(__PHYSFS_utf8codepoint(&leaf), folded1);
+            cp1 = folded1[0];
+            tail1 = 1;
+         }
+
+         if (head2 != tail2)
+            cp2 = folded2[tail2++];
+         else {
+            auto cp = __PHYSFS_utf8codepoint(&str);
+            if (cp == '/')
+               cp = 0;
+            head2 = PHYSFS_caseFold(cp, folded2);
+            cp2 = folded2[0];
+            tail2 = 1;
+         }
+
+         if (cp1 != cp2)
+            return false;
+         if (cp1 == 0)
+            return true;
+      }
+   }
+
+   /// Find a direct child of 'parent' named like the component at 'str'      
+   ///   @return the child's id, or zero if there's no such child             
+   PHYSFS_uint32 findChild(__PHYSFS_DirTree* dt, PHYSFS_uint32 parent, const char* str) {
+      const auto hashval = hashComponent(dt, parent, str) % dt->hashBuckets;
+      PHYSFS_uint32 prev = 0;
+
+      for (auto id = dt->hash[hashval]; id; id = __PHYSFS_DirTreeEntryAt(dt, id)->hashnext) {
+         auto entry = __PHYSFS_DirTreeEntryAt(dt, id);
+         if (entry->parent == parent
+         and componentMatches(dt, __PHYSFS_DirTreeName(dt, entry), str)) {
+            if (prev and not dt->finalized) {
+               // Move this to the front of the list. Never once the    
+               // tree is finalized: it's mounted by then, and lookups  
+               // from several threads must not write to it             
+               __PHYSFS_DirTreeEntryAt(dt, prev)->hashnext = entry->hashnext;
+               entry->hashnext = dt->hash[hashval];
+               dt->hash[hashval] = id;
+            }
+
+            return id;
+         }
+
+         prev = id;
+      }
+
+      return 0;
+   }
+
+   /// Rebuild the hash with more buckets, once it gets crowded               
+   int growHash(__PHYSFS_DirTree* dt) {
+      const size_t buckets = dt->hashBuckets * 2;
+      const size_t alloclen = buckets * sizeof(PHYSFS_uint32);
+      auto hash = static_cast<PHYSFS_uint32*>(allocRaw(alloclen));
+      BAIL_IF(not hash, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+      memset(hash, '\0', alloclen);
+
+      for (PHYSFS_uint32 id = 1; id < dt->entryCount; ++id) {
+         auto entry = __PHYSFS_DirTreeEntryAt(dt, id);
+         const auto name = __PHYSFS_DirTreeName(dt, entry);
+         const auto hashval = hashComponent(dt, entry->parent, name) % buckets;
+         entry->hashnext = hash[hashval];
+         hash[hashval] = id;
+      }
+
+      PHYSFS_Allocator<>::Free(dt->hash);
+      dt->hash = hash;
+      dt->hashBuckets = buckets;
+      return 1;
+   }
+
+   /// Create a new entry from the component at 'str', and link it under      
+   /// 'parent'. Only the component itself is stored, in the names block      
+   ///   @return the new entry's id, or zero on failure                       
+   PHYSFS_uint32 addChild(__PHYSFS_DirTree* dt, PHYSFS_uint32 parent, const char* str, const int isdir) {
+      size_t namelen = 0;
+      while (not isComponentEnd(str[namelen]))
+         ++namelen;
+
+      if (dt->entryCount == dt->entryCapacity) {
+         const auto needed = PHYSFS_uint64(dt->entryCount) + 1;
+         BAIL_IF_ERRPASS(not growBlock(dt->entries, dt->entryCapacity, needed, dt->entrylen), 0);
+      }
+
+      const auto needed = PHYSFS_uint64(dt->namesUsed) + namelen + 1;
+      if (needed > dt->namesCapacity)
+         BAIL_IF_ERRPASS(not growBlock(dt->names, dt->namesCapacity, needed, 1), 0);
+
+      if (dt->entryCount >= dt->hashBuckets)
+         BAIL_IF_ERRPASS(not growHash(dt), 0);
+
+      const auto offset = dt->namesUsed;
+      auto name = dt->names + offset;
+      memcpy(name, str, namelen);
+      name[namelen] = '\0';
+      dt->namesUsed += PHYSFS_uint32(namelen + 1);
+
+      const auto id = dt->entryCount++;
+      const auto hashval = hashComponent(dt, parent, name) % dt->hashBuckets;
+      auto entry = __PHYSFS_DirTreeEntryAt(dt, id);
+      memset(entry, '\0', dt->entrylen);
+      entry->name = offset;
+      entry->parent = parent;
+      entry->isdir = isdir;
+      entry->hashnext = dt->hash[hashval];
+      dt->hash[hashval] = id;
+      dt->finalized = 0;
+      return id;
+   }
+
+} // namespace
 
 
 //TODO SHOULD THROW ON FAIL
 int __PHYSFS_DirTreeInit(__PHYSFS_DirTree* dt, const size_t entrylen, const int case_sensitive, const int only_usascii) {
-   static char rootpath[2] = {'/', '\0'};
-   size_t alloclen;
-
    assert(entrylen >= sizeof(__PHYSFS_DirTreeEntry));
 
    memset(dt, '\0', sizeof(*dt));
    dt->case_sensitive = case_sensitive;
    dt->only_usascii = only_usascii;
-
-   dt->root = (__PHYSFS_DirTreeEntry*) allocator.Malloc(entrylen);
-   BAIL_IF(!dt->root, PHYSFS_ERR_OUT_OF_MEMORY, 0);
-   memset(dt->root, '\0', entrylen);
-   dt->root->name = rootpath;
-   dt->root->isdir = 1;
-   dt->hashBuckets = 64;
-   if (!dt->hashBuckets)
-      dt->hashBuckets = 1;
    dt->entrylen = entrylen;
 
-   alloclen = dt->hashBuckets * sizeof(__PHYSFS_DirTreeEntry*);
-   dt->hash = (__PHYSFS_DirTreeEntry**) allocator.Malloc(alloclen);
+   dt->entryCapacity = 64;
+   dt->entries = static_cast<PHYSFS_uint8*>(allocRaw(dt->entryCapacity * entrylen));
+   BAIL_IF(!dt->entries, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+
+   // The root is entry zero, and its empty name is at offset zero      
+   dt->namesCapacity = 1024;
+   dt->names = static_cast<char*>(allocRaw(dt->namesCapacity));
+   BAIL_IF(!dt->names, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+   dt->names[0] = '\0';
+   dt->namesUsed = 1;
+
+   memset(dt->entries, '\0', entrylen);
+   __PHYSFS_DirTreeEntryAt(dt, 0)->isdir = 1;
+   dt->entryCount = 1;
+
+   dt->hashBuckets = 64;
+   const size_t alloclen = dt->hashBuckets * sizeof(PHYSFS_uint32);
+   dt->hash = static_cast<PHYSFS_uint32*>(allocRaw(alloclen));
    BAIL_IF(!dt->hash, PHYSFS_ERR_OUT_OF_MEMORY, 0);
    memset(dt->hash, '\0', alloclen);
    return 1;
 }
 
-static PHYSFS_uint32 hashPathName(__PHYSFS_DirTree* dt, const char* name) {
-   const PHYSFS_uint32 hashval = dt->case_sensitive ? __PHYSFS_hashString(name) : dt->only_usascii ? __PHYSFS_hashStringCaseFoldUSAscii(name) : __PHYSFS_hashStringCaseFold(name);
-   return hashval % dt->hashBuckets;
-}
+/// Add an entry for a path in platform-independent notation, filling in any  
+/// missing parent directories along the way. 'name' isn't modified           
+void* __PHYSFS_DirTreeAdd(__PHYSFS_DirTree* dt, char* name, const int isdir) {
+   PHYSFS_uint32 parent = 0;
+   const char* str = name;
 
-/// Fill in missing parent directories                                        
-static __PHYSFS_DirTreeEntry* addAncestors(__PHYSFS_DirTree* dt, char* name) {
-   __PHYSFS_DirTreeEntry* retval = dt->root;
-   char* sep = strrchr(name, '/');
+   while (1) {
+      const char* sep = strchr(str, '/');
+      if (sep == str) {
+         // Skip empty components                                       
+         str = sep + 1;
+         continue;
+      }
+      else if (*str == '\0')
+         return __PHYSFS_DirTreeEntryAt(dt, parent);
 
-   if (sep) {
-      *sep = '\0';         // Chop off last piece                       
-      retval = (__PHYSFS_DirTreeEntry*) __PHYSFS_DirTreeFind(dt, name);
+      auto id = findChild(dt, parent, str);
+      if (not sep) {
+         if (not id)
+            id = addChild(dt, parent, str, isdir);
+         BAIL_IF_ERRPASS(not id, nullptr);
+         return __PHYSFS_DirTreeEntryAt(dt, id);
+      }
 
-      if (retval != nullptr) {
-         *sep = '/';
-         BAIL_IF(!retval->isdir, PHYSFS_ERR_CORRUPT, nullptr);
-         return retval;    // Already hashed                            
+      if (not id) {
+         // Okay, this is a new dir. Build and hash us                  
+         id = addChild(dt, parent, str, 1);
+         BAIL_IF_ERRPASS(not id, nullptr);
       }
+      else BAIL_IF(not __PHYSFS_DirTreeEntryAt(dt, id)->isdir, PHYSFS_ERR_CORRUPT, nullptr);
 
-      // Okay, this is a new dir. Build and hash us                     
-      retval = (__PHYSFS_DirTreeEntry*) __PHYSFS_DirTreeAdd(dt, name, 1);
-      *sep = '/';
+      parent = id;
+      str = sep + 1;
    }
-
-   return retval;
-}
-
-void* __PHYSFS_DirTreeAdd(__PHYSFS_DirTree* dt, char* name, const int isdir) {
-   __PHYSFS_DirTreeEntry* retval = __PHYSFS_DirTreeFind(dt, name);
-   if (retval)
-      return retval;
-
-   const size_t alloclen = strlen(name) + 1 + dt->entrylen;
-   PHYSFS_uint32 hashval;
-   auto parent = addAncestors(dt, name);
-   BAIL_IF_ERRPASS(!parent, nullptr);
-   assert(dt->entrylen >= sizeof(__PHYSFS_DirTreeEntry));
-
-   retval = (__PHYSFS_DirTreeEntry*) allocator.Malloc(alloclen);
-   BAIL_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
-   memset(retval, '\0', dt->entrylen);
-   retval->name = ((char*) retval) + dt->entrylen;
-   strcpy(retval->name, name);
-   hashval = hashPathName(dt, name);
-   retval->hashnext = dt->hash[hashval];
-   dt->hash[hashval] = retval;
-   retval->sibling = parent->children;
-   retval->isdir = isdir;
-   parent->children = retval;
-   return retval;
 }
 
 /// Find the __PHYSFS_DirTreeEntry for a path in platform-independent notation   
+/// Each component is hashed on its own, together with its parent's id        
 void* __PHYSFS_DirTreeFind(__PHYSFS_DirTree* dt, const char* path) {
-   const int cs = dt->case_sensitive;
-   __PHYSFS_DirTreeEntry* prev = nullptr;
-   __PHYSFS_DirTreeEntry* retval;
-
-   if (*path == '\0')
-      return dt->root;
-
-   auto hashval = hashPathName(dt, path);
-   for (retval = dt->hash[hashval]; retval; retval = retval->hashnext) {
-      const int cmp = cs
-         ? strcmp(retval->name, path)
-         : PHYSFS_utf8stricmp(retval->name, path);
-
-      if (cmp == 0) {
-         if (prev) {
-            // Move this to the front of the list                       
-            prev->hashnext = retval->hashnext;
-            retval->hashnext = dt->hash[hashval];
-            dt->hash[hashval] = retval;
-         }
+   PHYSFS_uint32 id = 0;
 
-         return retval;
+   while (*path) {
+      if (*path == '/') {
+         ++path;
+         continue;
       }
 
-      prev = retval;
+      BAIL_IF(not __PHYSFS_DirTreeEntryAt(dt, id)->isdir, PHYSFS_ERR_NOT_FOUND, nullptr);
+      id = findChild(dt, id, path);
+      BAIL_IF(not id, PHYSFS_ERR_NOT_FOUND, nullptr);
+
+      while (not isComponentEnd(*path))
+         ++path;
+   }
+
+   return __PHYSFS_DirTreeEntryAt(dt, id);
+}
+
+/// Group all kids by their directory, and sort each group by name. Called    
+/// once the archive is fully loaded, so that enumeration never has to sort   
+int __PHYSFS_DirTreeFinalize(__PHYSFS_DirTree* dt) {
+   if (dt->finalized)
+      return 1;
+
+   if (dt->children)
+      PHYSFS_Allocator<>::Free(dt->children);
+   dt->children = nullptr;
+
+   const PHYSFS_uint32 kids = dt->entryCount - 1;
+   if (kids) {
+      dt->children = static_cast<PHYSFS_uint32*>(allocRaw(kids * sizeof(PHYSFS_uint32)));
+      BAIL_IF(not dt->children, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+   }
+
+   // Count kids per dir, then turn the counts into offsets             
+   for (PHYSFS_uint32 id = 0; id < dt->entryCount; ++id)
+      __PHYSFS_DirTreeEntryAt(dt, id)->childCount = 0;
+   for (PHYSFS_uint32 id = 1; id < dt->entryCount; ++id)
+      ++__PHYSFS_DirTreeEntryAt(dt, __PHYSFS_DirTreeEntryAt(dt, id)->parent)->childCount;
+
+   PHYSFS_uint32 offset = 0;
+   for (PHYSFS_uint32 id = 0; id < dt->entryCount; ++id) {
+      auto entry = __PHYSFS_DirTreeEntryAt(dt, id);
+      entry->children = offset;
+      offset += entry->childCount;
+      entry->childCount = 0;
+   }
+
+   for (PHYSFS_uint32 id = 1; id < dt->entryCount; ++id) {
+      auto parent = __PHYSFS_DirTreeEntryAt(dt, __PHYSFS_DirTreeEntryAt(dt, id)->parent);
+      dt->children[parent->children + parent->childCount++] = id;
    }
 
-   BAIL(PHYSFS_ERR_NOT_FOUND, nullptr);
+   // Same byte order PHYSFS_enumerateFiles has always produced         
+   const auto byName = [dt](PHYSFS_uint32 a, PHYSFS_uint32 b) {
+      return strcmp(__PHYSFS_DirTreeName(dt, __PHYSFS_DirTreeEntryAt(dt, a)),
+                    __PHYSFS_DirTreeName(dt, __PHYSFS_DirTreeEntryAt(dt, b))) < 0;
+   };
+
+   for (PHYSFS_uint32 id = 0; id < dt->entryCount; ++id) {
+      const auto entry = __PHYSFS_DirTreeEntryAt(dt, id);
+      if (entry->childCount > 1) {
+         auto first = dt->children + entry->children;
+         std::sort(first, first + entry->childCount, byName);
+      }
+   }
+
+   dt->finalized = 1;
+   return 1;
+}
+
+/// Get the sorted kid ids of a directory, finalizing the tree if needed      
+///   @param count - [out] the number of kids                                 
+///   @return the first kid id, or nullptr if not found                       
+const PHYSFS_uint32* __PHYSFS_DirTreeChildren(__PHYSFS_DirTree* dt, const char* dname, PHYSFS_uint32* count) {
+   BAIL_IF_ERRPASS(not __PHYSFS_DirTreeFinalize(dt), nullptr);
+   const auto entry = static_cast<__PHYSFS_DirTreeEntry*>(__PHYSFS_DirTreeFind(dt, dname));
+   BAIL_IF_ERRPASS(not entry, nullptr);
+   *count = entry->childCount;
+   return dt->children + entry->children;
 }
 
 PHYSFS_EnumerateCallbackResult __PHYSFS_DirTreeEnumerate(
@@ -126,17 +384,14 @@ PHYSFS_EnumerateCallbackResult __PHYSFS_DirTreeEnumerate(
 ) {
    PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
    __PHYSFS_DirTree* tree = (__PHYSFS_DirTree*) opaque;
-   const __PHYSFS_DirTreeEntry* entry = __PHYSFS_DirTreeFind(tree, dname);
-   BAIL_IF(!entry, PHYSFS_ERR_NOT_FOUND, PHYSFS_ENUM_ERROR);
-
-   entry = entry->children;
+   PHYSFS_uint32 count;
+   const auto kids = __PHYSFS_DirTreeChildren(tree, dname, &count);
+   BAIL_IF_ERRPASS(not kids, PHYSFS_ENUM_ERROR);
 
-   while (entry and retval == PHYSFS_ENUM_OK) {
-      const char* name = entry->name;
-      const char* ptr = strrchr(name, '/');
-      retval = cb(callbackdata, origdir, ptr ? ptr + 1 : name);
+   for (PHYSFS_uint32 i = 0; i < count and retval == PHYSFS_ENUM_OK; ++i) {
+      const auto entry = __PHYSFS_DirTreeEntryAt(tree, kids[i]);
+      retval = cb(callbackdata, origdir, __PHYSFS_DirTreeName(tree, entry));
       BAIL_IF(retval == PHYSFS_ENUM_ERROR, PHYSFS_ERR_APP_CALLBACK, retval);
-      entry = entry->sibling;
    }
 
    return retval;
@@ -146,21 +401,17 @@ void __PHYSFS_DirTreeDeinit(__PHYSFS_DirTree* dt) {
    if (not dt)
       return;
 
-   if (dt->root) {
-      assert(not dt->root->sibling);
-      assert(dt->hash or not dt->root->children);
-      allocator.Free(dt->root);
-   }
+   if (dt->entries)
+      PHYSFS_Allocator<>::Free(dt->entries);
+   if (dt->names)
+      PHYSFS_Allocator<>::Free(dt->names);
+   if (dt->hash)
+      PHYSFS_Allocator<>::Free(dt->hash);
+   if (dt->children)
+      PHYSFS_Allocator<>::Free(dt->children);
 
-   if (dt->hash) {
-      for (size_t i = 0; i < dt->hashBuckets; i++) {
-         __PHYSFS_DirTreeEntry* next;
-         for (auto entry = dt->hash[i]; entry; entry = next) {
-            next = entry->hashnext;
-            allocator.Free(entry);
-         }
-      }
-
-      allocator.Free(dt->hash);
-   }
+   dt->entries = nullptr;
+   dt->names = nullptr;
+   dt->hash = nullptr;
+   dt->children = nullptr;
 }
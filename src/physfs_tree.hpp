@@ -10,18 +10,37 @@
 
 /// Optional API many archivers use this to manage their directory tree       
 /// !!! FIXME: document this better                                           
+///                                                                           
+/// All entries live back to back in one block, (entrylen) bytes apart, and   
+/// their leaf names back to back in another. Entries refer to each other,    
+/// and to their names, by 32-bit index only. Index zero is always the root,  
+/// which can never be a child, so zero also doubles as "none" for hash       
+/// links. Both blocks grow as entries are added, which moves them: pointers  
+/// from __PHYSFS_DirTreeAdd are only good until the next add, and should be  
+/// kept only once the archive is fully loaded.                               
+/// Each directory's kids are a contiguous, strcmp-sorted range of the tree's 
+/// children array. That array is built once by __PHYSFS_DirTreeFinalize,     
+/// after the archive is fully loaded, so enumeration is already in order.    
 
 struct __PHYSFS_DirTreeEntry {
-   char* name;                              // Full path in archive.      
-   struct __PHYSFS_DirTreeEntry* hashnext;  // next item in hash bucket.  
-   struct __PHYSFS_DirTreeEntry* children;  // linked list of kids, if dir
-   struct __PHYSFS_DirTreeEntry* sibling;   // next item in same dir.     
+   PHYSFS_uint32 parent;      // index of the containing directory.      
+   PHYSFS_uint32 hashnext;    // next item in hash bucket.               
+   PHYSFS_uint32 children;    // first kid in tree's children, if dir.   
+   PHYSFS_uint32 childCount;  // number of kids, if dir.                 
+   PHYSFS_uint32 name;        // offset of the leaf name in tree's names.
    int isdir;
 };
 
 struct __PHYSFS_DirTree {
-   __PHYSFS_DirTreeEntry* root;    /* root of directory tree.             */
-   __PHYSFS_DirTreeEntry** hash;  /* all entries hashed for fast lookup. */
+   PHYSFS_uint8* entries;           /* all entries, entrylen bytes apart.    */
+   PHYSFS_uint32 entryCount;        /* number of used slots in entries.      */
+   PHYSFS_uint32 entryCapacity;     /* number of allocated slots in entries. */
+   char* names;                     /* leaf names, each null-terminated.     */
+   PHYSFS_uint32 namesUsed;         /* bytes used in names.                  */
+   PHYSFS_uint32 namesCapacity;     /* bytes allocated for names.            */
+   PHYSFS_uint32* hash;  /* first entry id per bucket, hashed on (parent, leaf). */
+   PHYSFS_uint32* children;         /* kid ids, grouped by dir and sorted.   */
+   int finalized;       /* non-zero if children is up to date with entries. */
    size_t hashBuckets;            /* number of buckets in hash.          */
    size_t entrylen;    /* size in bytes of entries (including subclass). */
    int case_sensitive;  /* non-zero to treat entries as case-sensitive in DirTreeFind */
@@ -32,6 +51,8 @@ struct __PHYSFS_DirTree {
 int   __PHYSFS_DirTreeInit(__PHYSFS_DirTree* dt, const size_t entrylen, const int case_sensitive, const int only_usascii);
 void* __PHYSFS_DirTreeAdd(__PHYSFS_DirTree* dt, char* name, const int isdir);
 void* __PHYSFS_DirTreeFind(__PHYSFS_DirTree* dt, const char* path);
+int   __PHYSFS_DirTreeFinalize(__PHYSFS_DirTree* dt);
+const PHYSFS_uint32* __PHYSFS_DirTreeChildren(__PHYSFS_DirTree* dt, const char* dname, PHYSFS_uint32* count);
 
 PHYSFS_EnumerateCallbackResult __PHYSFS_DirTreeEnumerate(void* opaque,
    const char* dname, PHYSFS_EnumerateCallback cb,
@@ -40,3 +61,14 @@ PHYSFS_EnumerateCallbackResult __PHYSFS_DirTreeEnumerate(void* opaque,
 
 void __PHYSFS_DirTreeDeinit(__PHYSFS_DirTree* dt);
 
+/// Get the entry with index (id); the root is entry zero                     
+METAPHYSFS(INLINED)
+__PHYSFS_DirTreeEntry* __PHYSFS_DirTreeEntryAt(const __PHYSFS_DirTree* dt, PHYSFS_uint32 id) {
+   return reinterpret_cast<__PHYSFS_DirTreeEntry*>(dt->entries + size_t(id) * dt->entrylen);
+}
+
+/// Get the leaf name of an entry (the root's name is an empty string)        
+METAPHYSFS(INLINED)
+const char* __PHYSFS_DirTreeName(const __PHYSFS_DirTree* dt, const __PHYSFS_DirTreeEntry* entry) {
+   return dt->names + entry->name;
+}
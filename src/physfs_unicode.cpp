@@ -1,6 +1,8 @@
 #include "physfs_internal.hpp"
 #include "physfs_casefolding.hpp"
 
+#include <array>
+
 /*
  * From rfc3629, the UTF-8 spec:
  *  https://www.ietf.org/rfc/rfc3629.txt
@@ -425,6 +427,174 @@ void PHYSFS_utf8FromUtf16(const PHYSFS_uint16 *src, char *dst, PHYSFS_uint64 len
 } /* PHYSFS_utf8FromUtf16 */
 
 
+/*
+ * Two-level direct-index case folding table for the Basic Multilingual Plane.
+ *
+ * The hash buckets in physfs_casefolding.hpp are compact, but every lookup
+ *  has to probe up to three of them with a linear scan. Here the very same
+ *  mapping data is flattened at compile time into a page index (one byte
+ *  per 64 codepoints) and a set of 64-entry blocks, so folding any BMP
+ *  codepoint costs exactly two loads. Identical blocks are shared (most of
+ *  the plane doesn't fold at all, and collapses into block zero), which
+ *  keeps the whole thing at a few kilobytes.
+ *
+ * Each block entry packs the fold count in bits 16-17. A count of zero means
+ *  the codepoint folds to itself, a count of one keeps the folded codepoint
+ *  in the low 16 bits, and counts of two or three keep an index into
+ *  case_fold_multi instead.
+ */
+#define CASEFOLD_BLOCK_BITS 6
+#define CASEFOLD_BLOCK_SIZE (1 << CASEFOLD_BLOCK_BITS)
+#define CASEFOLD_BLOCK_MASK (CASEFOLD_BLOCK_SIZE - 1)
+#define CASEFOLD_PAGES (0x10000 >> CASEFOLD_BLOCK_BITS)
+
+namespace
+{
+    typedef std::array<PHYSFS_uint32, 0x10000> CaseFoldPlane;
+    typedef std::array<PHYSFS_uint32, CASEFOLD_BLOCK_SIZE> CaseFoldBlock;
+
+    template<class BUCKETS>
+    constexpr size_t caseFoldCountMappings(const BUCKETS &buckets)
+    {
+        size_t count = 0;
+        for (const auto &bucket : buckets)
+            count += bucket.count;
+        return count;
+    } /* caseFoldCountMappings */
+
+    constexpr size_t CASEFOLD_MULTI_COUNT =
+        caseFoldCountMappings(case_fold_hash2_16) +
+        caseFoldCountMappings(case_fold_hash3_16);
+
+    static_assert(CASEFOLD_MULTI_COUNT <= 0xFFFF,
+                  "Multi-codepoint folds must be indexable in 16 bits");
+
+    /* Expand all 16-bit mappings into a flat, uncompressed plane. */
+    constexpr CaseFoldPlane caseFoldBuildPlane()
+    {
+        CaseFoldPlane plane {};
+        PHYSFS_uint32 multi = 0;
+
+        for (const auto &bucket : case_fold_hash1_16)
+        {
+            for (PHYSFS_uint8 i = 0; i < bucket.count; i++)
+                plane[bucket.list[i].from] = 0x10000 | bucket.list[i].to0;
+        } /* for */
+
+        for (const auto &bucket : case_fold_hash2_16)
+        {
+            for (PHYSFS_uint8 i = 0; i < bucket.count; i++)
+                plane[bucket.list[i].from] = 0x20000 | multi++;
+        } /* for */
+
+        for (const auto &bucket : case_fold_hash3_16)
+        {
+            for (PHYSFS_uint8 i = 0; i < bucket.count; i++)
+                plane[bucket.list[i].from] = 0x30000 | multi++;
+        } /* for */
+
+        return plane;
+    } /* caseFoldBuildPlane */
+
+    constexpr bool caseFoldSameBlock(const CaseFoldPlane &plane,
+                                     const size_t pageA, const size_t pageB)
+    {
+        const size_t a = pageA << CASEFOLD_BLOCK_BITS;
+        const size_t b = pageB << CASEFOLD_BLOCK_BITS;
+        for (size_t i = 0; i < CASEFOLD_BLOCK_SIZE; i++)
+        {
+            if (plane[a + i] != plane[b + i])
+                return false;
+        } /* for */
+        return true;
+    } /* caseFoldSameBlock */
+
+    /* Count the distinct blocks, so that the final table is sized exactly. */
+    constexpr size_t caseFoldCountBlocks()
+    {
+        const CaseFoldPlane plane = caseFoldBuildPlane();
+        std::array<size_t, CASEFOLD_PAGES> unique {};
+        size_t count = 0;
+
+        for (size_t page = 0; page < CASEFOLD_PAGES; page++)
+        {
+            size_t i;
+            for (i = 0; i < count; i++)
+            {
+                if (caseFoldSameBlock(plane, unique[i], page))
+                    break;
+            } /* for */
+
+            if (i == count)
+                unique[count++] = page;
+        } /* for */
+
+        return count;
+    } /* caseFoldCountBlocks */
+
+    constexpr size_t CASEFOLD_BLOCK_COUNT = caseFoldCountBlocks();
+
+    static_assert(CASEFOLD_BLOCK_COUNT <= 256,
+                  "Case folding blocks must be indexable with a byte");
+
+    struct CaseFoldTable
+    {
+        PHYSFS_uint8 page[CASEFOLD_PAGES];
+        CaseFoldBlock block[CASEFOLD_BLOCK_COUNT];
+        CaseFoldMapping3_16 multi[CASEFOLD_MULTI_COUNT];
+    };
+
+    constexpr CaseFoldTable caseFoldBuildTable()
+    {
+        const CaseFoldPlane plane = caseFoldBuildPlane();
+        std::array<size_t, CASEFOLD_BLOCK_COUNT> unique {};
+        CaseFoldTable table {};
+        size_t count = 0;
+        size_t multi = 0;
+
+        for (size_t page = 0; page < CASEFOLD_PAGES; page++)
+        {
+            size_t i;
+            for (i = 0; i < count; i++)
+            {
+                if (caseFoldSameBlock(plane, unique[i], page))
+                    break;
+            } /* for */
+
+            if (i == count)
+            {
+                unique[count++] = page;
+                for (size_t j = 0; j < CASEFOLD_BLOCK_SIZE; j++)
+                    table.block[i][j] = plane[(page << CASEFOLD_BLOCK_BITS) + j];
+            } /* if */
+
+            table.page[page] = (PHYSFS_uint8) i;
+        } /* for */
+
+        /* Same order as caseFoldBuildPlane() handed out the indices. */
+        for (const auto &bucket : case_fold_hash2_16)
+        {
+            for (PHYSFS_uint8 i = 0; i < bucket.count; i++, multi++)
+            {
+                table.multi[multi].from = bucket.list[i].from;
+                table.multi[multi].to0 = bucket.list[i].to0;
+                table.multi[multi].to1 = bucket.list[i].to1;
+            } /* for */
+        } /* for */
+
+        for (const auto &bucket : case_fold_hash3_16)
+        {
+            for (PHYSFS_uint8 i = 0; i < bucket.count; i++, multi++)
+                table.multi[multi] = bucket.list[i];
+        } /* for */
+
+        return table;
+    } /* caseFoldBuildTable */
+
+    constexpr CaseFoldTable case_fold_table = caseFoldBuildTable();
+} /* anonymous namespace */
+
+
 int PHYSFS_caseFold(const PHYSFS_uint32 from, PHYSFS_uint32 *to)
 {
     int i;
@@ -440,53 +610,32 @@ int PHYSFS_caseFold(const PHYSFS_uint32 from, PHYSFS_uint32 *to)
 
     else if (from <= 0xFFFF)
     {
-        const PHYSFS_uint8 hash = ((from ^ (from >> 8)) & 0xFF);
-        const PHYSFS_uint16 from16 = (PHYSFS_uint16) from;
+        const PHYSFS_uint8 block = case_fold_table.page[from >> CASEFOLD_BLOCK_BITS];
+        const PHYSFS_uint32 entry = case_fold_table.block[block][from & CASEFOLD_BLOCK_MASK];
 
+        switch (entry >> 16)
         {
-            const CaseFoldHashBucket1_16 *bucket = &case_fold_hash1_16[hash];
-            const int count = (int) bucket->count;
-            for (i = 0; i < count; i++)
-            {
-                const CaseFoldMapping1_16 *mapping = &bucket->list[i];
-                if (mapping->from == from16)
-                {
-                    *to = mapping->to0;
-                    return 1;
-                } /* if */
-            } /* for */
-        }
+            case 1:
+                *to = entry & 0xFFFF;
+                return 1;
 
-        {
-            const CaseFoldHashBucket2_16 *bucket = &case_fold_hash2_16[hash & 15];
-            const int count = (int) bucket->count;
-            for (i = 0; i < count; i++)
+            case 2:
             {
-                const CaseFoldMapping2_16 *mapping = &bucket->list[i];
-                if (mapping->from == from16)
-                {
-                    to[0] = mapping->to0;
-                    to[1] = mapping->to1;
-                    return 2;
-                } /* if */
-            } /* for */
-        }
+                const CaseFoldMapping3_16 *mapping = &case_fold_table.multi[entry & 0xFFFF];
+                to[0] = mapping->to0;
+                to[1] = mapping->to1;
+                return 2;
+            }
 
-        {
-            const CaseFoldHashBucket3_16 *bucket = &case_fold_hash3_16[hash & 3];
-            const int count = (int) bucket->count;
-            for (i = 0; i < count; i++)
+            case 3:
             {
-                const CaseFoldMapping3_16 *mapping = &bucket->list[i];
-                if (mapping->from == from16)
-                {
-                    to[0] = mapping->to0;
-                    to[1] = mapping->to1;
-                    to[2] = mapping->to2;
-                    return 3;
-                } /* if */
-            } /* for */
-        }
+                const CaseFoldMapping3_16 *mapping = &case_fold_table.multi[entry & 0xFFFF];
+                to[0] = mapping->to0;
+                to[1] = mapping->to1;
+                to[2] = mapping->to2;
+                return 3;
+            }
+        } /* switch */
     } /* else if */
 
     else  /* codepoint that doesn't fit in 16 bits. */
@@ -27,7 +27,42 @@ PHYSFS_Io* UNPK_openAppend(void* opaque, const char* name);
 int UNPK_remove(void* opaque, const char* name);
 int UNPK_mkdir(void* opaque, const char* name);
 int UNPK_stat(void* opaque, const char* fn, PHYSFS_Stat* st);
+int UNPK_statEx(void* opaque, const char* fn, PHYSFS_StatEx* st);
 
 #define UNPK_enumerate __PHYSFS_DirTreeEnumerate
 
+/// Reads an archive's directory table from memory, so formats that parse it  
+/// field by field pay one io read per table instead of one per field.        
+/// (expected) is how many bytes of table follow the io's position; they are  
+/// fetched in one read (up to MaxWindow at a time). Formats whose            
+/// headers are spread over the archive (like HOG1) pass zero, and get        
+/// sector-sized windows that seek() moves around without touching the io     
+struct UNPK_TableReader {
+   static constexpr size_t MaxWindow = 4 * 1024 * 1024;
+   static constexpr size_t SectorWindow = 4096;
+
+   UNPK_TableReader(PHYSFS_Io* io, PHYSFS_uint64 expected);
+   ~UNPK_TableReader();
+   UNPK_TableReader(const UNPK_TableReader&) = delete;
+   UNPK_TableReader& operator = (const UNPK_TableReader&) = delete;
+
+   /// Same contract as __PHYSFS_readAll: nonzero only if all of (len) came   
+   int read(void* buf, size_t len);
+   /// Read a littleendian 32-bit value                                       
+   int readui32(PHYSFS_uint32* val);
+   /// Move to an absolute archive offset, fetching nothing yet               
+   int seek(PHYSFS_uint64 pos);
+
+private:
+   int refill();
+
+   PHYSFS_Io* io;
+   PHYSFS_uint8* buffer = nullptr;
+   size_t capacity = 0;
+   size_t fill = 0;              // Valid bytes in the buffer             
+   size_t cursor = 0;            // Next byte to hand out                 
+   PHYSFS_uint64 base = 0;       // Archive offset of buffer[0]           
+   PHYSFS_uint64 end = 0;        // Archive length                        
+};
+
 
@@ -300,6 +300,40 @@ int __PHYSFS_platformDelete(const char *path)
 } /* __PHYSFS_platformDelete */
 
 
+int __PHYSFS_platformRename(const char *from, const char *to)
+{
+    BAIL_IF(rename(from, to) == -1, errcodeFromErrno(), 0);
+    return 1;
+} /* __PHYSFS_platformRename */
+
+
+int __PHYSFS_platformSync(const char *const *paths, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        struct stat statbuf;
+        int fd, rc;
+
+        /* Directory entries can't be synced on their own here. */
+        if ((stat(paths[i], &statbuf) == 0) && (S_ISDIR(statbuf.st_mode)))
+            continue;
+
+        do {
+            fd = open(paths[i], O_RDWR);
+        } while ((fd < 0) && (errno == EINTR));
+        BAIL_IF(fd < 0, errcodeFromErrno(), 0);
+
+        do {
+            rc = fsync(fd);
+        } while ((rc == -1) && (errno == EINTR));
+        close(fd);
+        BAIL_IF(rc == -1, errcodeFromErrno(), 0);
+    } /* for */
+    return 1;
+} /* __PHYSFS_platformSync */
+
+
 int __PHYSFS_platformStat(const char *fname, PHYSFS_Stat *st, const int follow)
 {
     struct stat statbuf;
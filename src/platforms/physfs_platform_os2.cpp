@@ -700,6 +700,51 @@ done:
 } /* __PHYSFS_platformDelete */
 
 
+/* DosMove() won't replace an existing file, so this isn't atomic here. */
+int __PHYSFS_platformRename(const char *from, const char *to)
+{
+    char *cpfrom = cvtUtf8ToCodepage(from);
+    char *cpto = cvtUtf8ToCodepage(to);
+    APIRET rc;
+    int retval = 0;
+
+    GOTO_IF(!cpfrom || !cpto, PHYSFS_ERR_OUT_OF_MEMORY, done);
+    DosDelete(cpto);
+    rc = DosMove(cpfrom, cpto);
+    GOTO_IF(rc != NO_ERROR, errcodeFromAPIRET(rc), done);
+    retval = 1;  /* success */
+
+done:
+    allocator.Free(cpfrom);
+    allocator.Free(cpto);
+    return retval;
+} /* __PHYSFS_platformRename */
+
+
+int __PHYSFS_platformSync(const char *const *paths, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        PHYSFS_Stat statbuf;
+        void *h;
+        int rc;
+
+        /* Directories have nothing to flush here. */
+        BAIL_IF_ERRPASS(!__PHYSFS_platformStat(paths[i], &statbuf, 1), 0);
+        if (statbuf.filetype == PHYSFS_FILETYPE_DIRECTORY)
+            continue;
+
+        h = __PHYSFS_platformOpenAppend(paths[i]);
+        BAIL_IF_ERRPASS(!h, 0);
+        rc = __PHYSFS_platformFlush(h);
+        __PHYSFS_platformClose(h);
+        BAIL_IF_ERRPASS(!rc, 0);
+    } /* for */
+    return 1;
+} /* __PHYSFS_platformSync */
+
+
 /* Convert to a format PhysicsFS can grok... */
 static PHYSFS_sint64 os2TimeToUnixTime(const FDATE *date, const FTIME *time)
 {
@@ -805,6 +850,95 @@ void __PHYSFS_platformReleaseMutex(void *mutex)
     DosReleaseMutexSem((HMTX) mutex);
 } /* __PHYSFS_platformReleaseMutex */
 
+
+typedef struct
+{
+    TID tid;
+    void (*fn)(void *);
+    void *arg;
+} OS2Thread;
+
+
+static VOID APIENTRY os2ThreadMain(ULONG _t)
+{
+    OS2Thread *t = (OS2Thread *) _t;
+    t->fn(t->arg);
+} /* os2ThreadMain */
+
+
+void *__PHYSFS_platformCreateThread(void (*fn)(void *), void *arg)
+{
+    APIRET rc;
+    OS2Thread *t = (OS2Thread *) allocator.Malloc(sizeof (OS2Thread));
+    BAIL_IF(!t, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+    t->fn = fn;
+    t->arg = arg;
+    rc = DosCreateThread(&t->tid, os2ThreadMain, (ULONG) t,
+                         CREATE_READY | STACK_COMMITTED, 256 * 1024);
+    if (rc != NO_ERROR)
+    {
+        allocator.Free(t);
+        BAIL(PHYSFS_ERR_OS_ERROR, nullptr);
+    } /* if */
+
+    return ((void *) t);
+} /* __PHYSFS_platformCreateThread */
+
+
+void __PHYSFS_platformJoinThread(void *thread)
+{
+    OS2Thread *t = (OS2Thread *) thread;
+    DosWaitThread(&t->tid, DCWW_WAIT);
+    allocator.Free(t);
+} /* __PHYSFS_platformJoinThread */
+
+
+/*
+ * A condition variable is an event semaphore that a broadcast posts. A
+ *  waiter resets it before letting go of the mutex, and only sleeps a short
+ *  while on it, so a broadcast racing the reset costs a little latency
+ *  instead of a lost wakeup. Waking up early is allowed by the contract.
+ */
+void *__PHYSFS_platformCreateCond(void)
+{
+    HEV hev = NULLHANDLE;
+    const APIRET rc = DosCreateEventSem(nullptr, &hev, 0, FALSE);
+    BAIL_IF(rc != NO_ERROR, PHYSFS_ERR_OS_ERROR, nullptr);
+    return ((void *) hev);
+} /* __PHYSFS_platformCreateCond */
+
+
+void __PHYSFS_platformDestroyCond(void *cond)
+{
+    DosCloseEventSem((HEV) cond);
+} /* __PHYSFS_platformDestroyCond */
+
+
+void __PHYSFS_platformWaitCond(void *cond, void *mutex)
+{
+    ULONG posts = 0;
+    DosResetEventSem((HEV) cond, &posts);
+    DosReleaseMutexSem((HMTX) mutex);
+    DosWaitEventSem((HEV) cond, 10);
+    DosRequestMutexSem((HMTX) mutex, SEM_INDEFINITE_WAIT);
+} /* __PHYSFS_platformWaitCond */
+
+
+void __PHYSFS_platformWaitCondTimeout(void *cond, void *mutex, PHYSFS_uint32 ms)
+{
+    ULONG posts = 0;
+    DosResetEventSem((HEV) cond, &posts);
+    DosReleaseMutexSem((HMTX) mutex);
+    DosWaitEventSem((HEV) cond, (ms < 10) ? ms : 10);
+    DosRequestMutexSem((HMTX) mutex, SEM_INDEFINITE_WAIT);
+} /* __PHYSFS_platformWaitCondTimeout */
+
+
+void __PHYSFS_platformBroadcastCond(void *cond)
+{
+    DosPostEventSem((HEV) cond);
+} /* __PHYSFS_platformBroadcastCond */
+
 #endif  /* PHYSFS_PLATFORM_OS2 */
 
 /* end of physfs_platform_os2.c ... */
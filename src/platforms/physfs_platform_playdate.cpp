@@ -22,20 +22,25 @@ static PlaydateAPI *playdate = nullptr;
 #define WRITABLE_DIRNAME ".$PHYSFSWRITE$"
 
 
-static void *playdateAllocatorMalloc(PHYSFS_uint64 s);
-static void *playdateAllocatorRealloc(void *ptr, PHYSFS_uint64 s);
-static void playdateAllocatorFree(void *ptr);
+static void *playdateAllocatorMalloc(PHYSFS_uint64 s, PHYSFS_AllocTag, void *);
+static void *playdateAllocatorRealloc(void *ptr, PHYSFS_uint64, PHYSFS_uint64 s,
+                                      PHYSFS_AllocTag, void *);
+static void playdateAllocatorFree(void *ptr, PHYSFS_uint64, PHYSFS_AllocTag, void *);
+
+static const PHYSFS_AllocatorCallbacks playdateAllocator = {
+    nullptr, nullptr,
+    playdateAllocatorMalloc,
+    playdateAllocatorRealloc,
+    playdateAllocatorFree,
+    nullptr
+};
 
 int __PHYSFS_platformInit(const char *argv0)
 {
     /* as a cheat, we expect argv0 to be a PlaydateAPI* on Playdate. */
     playdate = (PlaydateAPI *) argv0;
 
-    allocator.Init = nullptr;
-    allocator.Deinit = nullptr;
-    allocator.Malloc = playdateAllocatorMalloc;
-    allocator.Realloc = playdateAllocatorRealloc;
-    allocator.Free = playdateAllocatorFree;
+    __PHYSFS_setPlatformAllocator(&playdateAllocator);
 
     return 1;  /* ready to go! */
 }
@@ -214,6 +219,20 @@ int __PHYSFS_platformDelete(const char *path)
     return 1;
 }
 
+int __PHYSFS_platformRename(const char *from, const char *to)
+{
+    BAIL_IF(playdate->file->rename(from, to) == -1, PHYSFS_ERR_OS_ERROR, 0);
+    return 1;
+}
+
+int __PHYSFS_platformSync(const char *const *paths, size_t count)
+{
+    /* Files are on storage once they're closed, there's no more to do. */
+    (void) paths;
+    (void) count;
+    return 1;
+}
+
 
 /* Convert to a format PhysicsFS can grok... */
 static PHYSFS_sint64 playdateTimeToUnixTime(FileStat *statbuf)
@@ -262,19 +281,20 @@ void __PHYSFS_platformReleaseMutex(void *mutex)
 
 #undef realloc
 
-static void *playdateAllocatorMalloc(PHYSFS_uint64 s)
+static void *playdateAllocatorMalloc(PHYSFS_uint64 s, PHYSFS_AllocTag, void *)
 {
     BAIL_IF(!__PHYSFS_ui64FitsAddressSpace(s), PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
     return playdate->system->realloc(nullptr, (size_t) s);
 }
 
-static void *playdateAllocatorRealloc(void *ptr, PHYSFS_uint64 s)
+static void *playdateAllocatorRealloc(void *ptr, PHYSFS_uint64, PHYSFS_uint64 s,
+                                      PHYSFS_AllocTag, void *)
 {
     BAIL_IF(!__PHYSFS_ui64FitsAddressSpace(s), PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
     return playdate->system->realloc(ptr, (size_t) s);
 }
 
-static void playdateAllocatorFree(void *ptr)
+static void playdateAllocatorFree(void *ptr, PHYSFS_uint64, PHYSFS_AllocTag, void *)
 {
     playdate->system->realloc(ptr, 0);
 }
@@ -18,6 +18,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <time.h>
 
 #include "physfs_internal.h"
 
@@ -54,6 +55,29 @@ static inline PHYSFS_ErrorCode errcodeFromErrno(void)
 } /* errcodeFromErrno */
 
 
+/* Throw what (err) maps to. Error codes are template arguments of Throw, so
+   one picked at runtime can't be passed along: each gets a constant here. */
+static void throwErrnoError(const int err)
+{
+    switch (errcodeFromErrnoError(err))
+    {
+        case PHYSFS_ERR_OK: break;
+        case PHYSFS_ERR_PERMISSION: MetaPhysFS::Throw<PHYSFS_ERR_PERMISSION>(); break;
+        case PHYSFS_ERR_NO_SPACE: MetaPhysFS::Throw<PHYSFS_ERR_NO_SPACE>(); break;
+        case PHYSFS_ERR_IO: MetaPhysFS::Throw<PHYSFS_ERR_IO>(); break;
+        case PHYSFS_ERR_SYMLINK_LOOP: MetaPhysFS::Throw<PHYSFS_ERR_SYMLINK_LOOP>(); break;
+        case PHYSFS_ERR_BAD_FILENAME: MetaPhysFS::Throw<PHYSFS_ERR_BAD_FILENAME>(); break;
+        case PHYSFS_ERR_NOT_FOUND: MetaPhysFS::Throw<PHYSFS_ERR_NOT_FOUND>(); break;
+        case PHYSFS_ERR_NOT_A_FILE: MetaPhysFS::Throw<PHYSFS_ERR_NOT_A_FILE>(); break;
+        case PHYSFS_ERR_READ_ONLY: MetaPhysFS::Throw<PHYSFS_ERR_READ_ONLY>(); break;
+        case PHYSFS_ERR_BUSY: MetaPhysFS::Throw<PHYSFS_ERR_BUSY>(); break;
+        case PHYSFS_ERR_OUT_OF_MEMORY: MetaPhysFS::Throw<PHYSFS_ERR_OUT_OF_MEMORY>(); break;
+        case PHYSFS_ERR_DIR_NOT_EMPTY: MetaPhysFS::Throw<PHYSFS_ERR_DIR_NOT_EMPTY>(); break;
+        default: MetaPhysFS::Throw<PHYSFS_ERR_OS_ERROR>(); break;
+    } /* switch */
+} /* throwErrnoError */
+
+
 static char *getUserDirByUID(void)
 {
     uid_t uid = getuid();
@@ -182,7 +206,11 @@ static void *doOpen(const char *filename, int mode)
     do {
         fd = open(filename, mode, S_IRUSR | S_IWUSR);
     } while ((fd < 0) && (errno == EINTR));
-    BAIL_IF(fd < 0, errcodeFromErrno(), nullptr);
+    if (fd < 0)
+    {
+        throwErrnoError(errno);
+        return nullptr;
+    } /* if */
 
 #if !defined(O_CLOEXEC) && defined(FD_CLOEXEC)
     set_CLOEXEC(fd);
@@ -194,7 +222,8 @@ static void *doOpen(const char *filename, int mode)
         {
             const int err = errno;
             close(fd);
-            BAIL(errcodeFromErrnoError(err), nullptr);
+            throwErrnoError(err);
+            return nullptr;
         } /* if */
     } /* if */
 
@@ -216,6 +245,52 @@ void *__PHYSFS_platformOpenRead(const char *filename)
 } /* __PHYSFS_platformOpenRead */
 
 
+#if PHYSFS_HAVE_DIRECT_IO
+void *__PHYSFS_platformOpenReadDirect(const char *filename)
+{
+    /* a page worth of probe, aligned the way O_DIRECT wants it. */
+    alignas(PHYSFS_DIRECT_IO_ALIGNMENT) char probe[PHYSFS_DIRECT_IO_ALIGNMENT];
+    int fd;
+    int *retval;
+    ssize_t rc;
+
+    do {
+        fd = open(filename, O_RDONLY | O_DIRECT | O_CLOEXEC);
+    } while ((fd < 0) && (errno == EINTR));
+
+    /* tmpfs and friends refuse O_DIRECT at open time... */
+    if ((fd < 0) && (errno == EINVAL))
+        return nullptr;
+    if (fd < 0)
+    {
+        throwErrnoError(errno);
+        return nullptr;
+    } /* if */
+
+    /* ...others only when you actually read, so try it once. */
+    do {
+        rc = pread(fd, probe, sizeof (probe), 0);
+    } while ((rc == -1) && (errno == EINTR));
+
+    if (rc == -1)
+    {
+        close(fd);
+        return nullptr;
+    } /* if */
+
+    retval = (int *) allocator.Malloc(sizeof (int));
+    if (!retval)
+    {
+        close(fd);
+        BAIL(PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+    } /* if */
+
+    *retval = fd;
+    return ((void *) retval);
+} /* __PHYSFS_platformOpenReadDirect */
+#endif
+
+
 void *__PHYSFS_platformOpenWrite(const char *filename)
 {
     return doOpen(filename, O_WRONLY | O_CREAT | O_TRUNC);
@@ -247,6 +322,25 @@ PHYSFS_sint64 __PHYSFS_platformRead(void *opaque, void *buffer,
 } /* __PHYSFS_platformRead */
 
 
+PHYSFS_sint64 __PHYSFS_platformReadAt(void *opaque, PHYSFS_uint64 offset,
+                                      void *buffer, PHYSFS_uint64 len)
+{
+    const int fd = *((int *) opaque);
+    ssize_t rc = 0;
+
+    if (!__PHYSFS_ui64FitsAddressSpace(len))
+        BAIL(PHYSFS_ERR_INVALID_ARGUMENT, -1);
+
+    do {
+        rc = pread(fd, buffer, (size_t) len, (off_t) offset);
+    } while ((rc == -1) && (errno == EINTR));
+    BAIL_IF(rc == -1, errcodeFromErrno(), -1);
+    assert(rc >= 0);
+    assert(rc <= len);
+    return (PHYSFS_sint64) rc;
+} /* __PHYSFS_platformReadAt */
+
+
 PHYSFS_sint64 __PHYSFS_platformWrite(void *opaque, const void *buffer,
                                      PHYSFS_uint64 len)
 {
@@ -326,6 +420,90 @@ int __PHYSFS_platformDelete(const char *path)
 } /* __PHYSFS_platformDelete */
 
 
+int __PHYSFS_platformRename(const char *from, const char *to)
+{
+    BAIL_IF(rename(from, to) == -1, errcodeFromErrno(), 0);
+    return 1;
+} /* __PHYSFS_platformRename */
+
+
+#if defined(PHYSFS_PLATFORM_LINUX) && !defined(PHYSFS_PLATFORM_ANDROID)
+#define PHYSFS_HAVE_SYNCFS 1
+#endif
+
+int __PHYSFS_platformSync(const char *const *paths, size_t count)
+{
+#ifdef PHYSFS_HAVE_SYNCFS
+    /* syncfs() writes back a whole filesystem with a single device flush,
+       so do that once per filesystem instead of an fsync() per file. */
+    dev_t synced[16];
+    size_t nsynced = 0;
+#endif
+    size_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        int fd, rc;
+
+        do {
+            fd = open(paths[i], O_RDONLY);
+        } while ((fd < 0) && (errno == EINTR));
+        BAIL_IF(fd < 0, errcodeFromErrno(), 0);
+
+#ifdef PHYSFS_HAVE_SYNCFS
+        {
+            struct stat statbuf;
+            size_t j = 0;
+            rc = fstat(fd, &statbuf);
+            if (rc == 0)
+            {
+                while ((j < nsynced) && (synced[j] != statbuf.st_dev))
+                    j++;
+                if (j < nsynced)
+                {
+                    close(fd);
+                    continue;  /* already got this one. */
+                } /* if */
+            } /* if */
+
+            if ((rc == 0) && (nsynced < (sizeof (synced) / sizeof (synced[0]))))
+            {
+                synced[nsynced++] = statbuf.st_dev;
+                rc = syncfs(fd);
+            } /* if */
+            else
+            {
+                do {
+                    rc = fsync(fd);
+                } while ((rc == -1) && (errno == EINTR));
+            } /* else */
+        }
+#else
+        do {
+            rc = fsync(fd);
+        } while ((rc == -1) && (errno == EINTR));
+#endif
+
+#ifdef PHYSFS_PLATFORM_APPLE
+        /* fsync() only gets the data to the drive, which may cache it.
+           F_FULLFSYNC empties the drive's whole cache, so once will do. */
+        if ((rc == 0) && (i == count - 1))
+            rc = fcntl(fd, F_FULLFSYNC);
+#endif
+
+        if (rc == -1)
+        {
+            const PHYSFS_ErrorCode err = errcodeFromErrno();
+            close(fd);
+            BAIL(err, 0);
+        } /* if */
+        close(fd);
+    } /* for */
+
+    return 1;
+} /* __PHYSFS_platformSync */
+
+
 int __PHYSFS_platformStat(const char *fname, PHYSFS_Stat *st, const int follow)
 {
     struct stat statbuf;
@@ -365,6 +543,19 @@ int __PHYSFS_platformStat(const char *fname, PHYSFS_Stat *st, const int follow)
 } /* __PHYSFS_platformStat */
 
 
+int __PHYSFS_platformFileId(const char *fname, PHYSFS_uint64 *device,
+                            PHYSFS_uint64 *inode)
+{
+    struct stat statbuf;
+    if (stat(fname, &statbuf) == -1)
+        return 0;  /* no error; the caller just won't know. */
+
+    *device = (PHYSFS_uint64) statbuf.st_dev;
+    *inode = (PHYSFS_uint64) statbuf.st_ino;
+    return 1;
+} /* __PHYSFS_platformFileId */
+
+
 typedef struct
 {
     pthread_mutex_t mutex;
@@ -441,6 +632,115 @@ void __PHYSFS_platformReleaseMutex(void *mutex)
     } /* if */
 } /* __PHYSFS_platformReleaseMutex */
 
+
+typedef struct
+{
+    pthread_t thread;
+    void (*fn)(void *);
+    void *arg;
+} PthreadThread;
+
+
+static void *pthreadThreadMain(void *_t)
+{
+    PthreadThread *t = (PthreadThread *) _t;
+    t->fn(t->arg);
+    return nullptr;
+} /* pthreadThreadMain */
+
+
+void *__PHYSFS_platformCreateThread(void (*fn)(void *), void *arg)
+{
+    PthreadThread *t = (PthreadThread *) allocator.Malloc(sizeof (PthreadThread));
+    BAIL_IF(!t, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+    t->fn = fn;
+    t->arg = arg;
+    if (pthread_create(&t->thread, nullptr, pthreadThreadMain, t) != 0)
+    {
+        allocator.Free(t);
+        BAIL(PHYSFS_ERR_OS_ERROR, nullptr);
+    } /* if */
+
+    return ((void *) t);
+} /* __PHYSFS_platformCreateThread */
+
+
+void __PHYSFS_platformJoinThread(void *thread)
+{
+    PthreadThread *t = (PthreadThread *) thread;
+    pthread_join(t->thread, nullptr);
+    allocator.Free(t);
+} /* __PHYSFS_platformJoinThread */
+
+
+void *__PHYSFS_platformCreateCond(void)
+{
+    pthread_cond_t *c = (pthread_cond_t *) allocator.Malloc(sizeof (pthread_cond_t));
+    BAIL_IF(!c, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+    if (pthread_cond_init(c, nullptr) != 0)
+    {
+        allocator.Free(c);
+        BAIL(PHYSFS_ERR_OS_ERROR, nullptr);
+    } /* if */
+
+    return ((void *) c);
+} /* __PHYSFS_platformCreateCond */
+
+
+void __PHYSFS_platformDestroyCond(void *cond)
+{
+    pthread_cond_destroy((pthread_cond_t *) cond);
+    allocator.Free(cond);
+} /* __PHYSFS_platformDestroyCond */
+
+
+void __PHYSFS_platformWaitCond(void *cond, void *mutex)
+{
+    PthreadMutex *m = (PthreadMutex *) mutex;
+    const pthread_t tid = pthread_self();
+    assert(m->owner == tid);  /* catch programming errors. */
+    assert(m->count == 1);  /* catch programming errors. */
+
+    /* pthread_cond_wait() unlocks behind our back, so look unowned. */
+    m->owner = (pthread_t) 0xDEADBEEF;
+    m->count = 0;
+    pthread_cond_wait((pthread_cond_t *) cond, &m->mutex);
+    m->owner = tid;
+    m->count = 1;
+} /* __PHYSFS_platformWaitCond */
+
+
+void __PHYSFS_platformWaitCondTimeout(void *cond, void *mutex, PHYSFS_uint32 ms)
+{
+    PthreadMutex *m = (PthreadMutex *) mutex;
+    const pthread_t tid = pthread_self();
+    struct timespec until;
+    assert(m->owner == tid);  /* catch programming errors. */
+    assert(m->count == 1);  /* catch programming errors. */
+
+    /* pthread_cond_timedwait() wants a deadline on the realtime clock. */
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += ms / 1000;
+    until.tv_nsec += (long) (ms % 1000) * 1000000;
+    if (until.tv_nsec >= 1000000000)
+    {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000;
+    } /* if */
+
+    m->owner = (pthread_t) 0xDEADBEEF;
+    m->count = 0;
+    pthread_cond_timedwait((pthread_cond_t *) cond, &m->mutex, &until);
+    m->owner = tid;
+    m->count = 1;
+} /* __PHYSFS_platformWaitCondTimeout */
+
+
+void __PHYSFS_platformBroadcastCond(void *cond)
+{
+    pthread_cond_broadcast((pthread_cond_t *) cond);
+} /* __PHYSFS_platformBroadcastCond */
+
 #endif  /* PHYSFS_PLATFORM_POSIX */
 
 /* end of physfs_platform_posix.c ... */
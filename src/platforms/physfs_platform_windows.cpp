@@ -872,6 +872,58 @@ int __PHYSFS_platformDelete(const char *path)
 } /* __PHYSFS_platformDelete */
 
 
+int __PHYSFS_platformRename(const char *from, const char *to)
+{
+    WCHAR *wfrom = nullptr;
+    WCHAR *wto = nullptr;
+    BOOL rc;
+
+    UTF8_TO_UNICODE_STACK(wfrom, from);
+    BAIL_IF(!wfrom, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    UTF8_TO_UNICODE_STACK(wto, to);
+    if (!wto)
+    {
+        __PHYSFS_smallFree(wfrom);
+        BAIL(PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    } /* if */
+
+    rc = MoveFileExW(wfrom, wto, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+    __PHYSFS_smallFree(wto);
+    __PHYSFS_smallFree(wfrom);
+    BAIL_IF(!rc, errcodeFromWinApi(), 0);
+    return 1;
+} /* __PHYSFS_platformRename */
+
+
+int __PHYSFS_platformSync(const char *const *paths, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        PHYSFS_Stat statbuf;
+        HANDLE h;
+        BOOL rc;
+
+        /* Renames are written through, so directories need nothing. */
+        BAIL_IF_ERRPASS(!__PHYSFS_platformStat(paths[i], &statbuf, 1), 0);
+        if (statbuf.filetype == PHYSFS_FILETYPE_DIRECTORY)
+            continue;
+
+        h = doOpen(paths[i], GENERIC_WRITE, OPEN_EXISTING);
+        BAIL_IF_ERRPASS(h == INVALID_HANDLE_VALUE, 0);
+        rc = FlushFileBuffers(h);
+        if (!rc)
+        {
+            const PHYSFS_ErrorCode err = errcodeFromWinApi();
+            CloseHandle(h);
+            BAIL(err, 0);
+        } /* if */
+        CloseHandle(h);
+    } /* for */
+    return 1;
+} /* __PHYSFS_platformSync */
+
+
 void *__PHYSFS_platformCreateMutex(void)
 {
     LPCRITICAL_SECTION lpcs;
@@ -908,6 +960,85 @@ void __PHYSFS_platformReleaseMutex(void *mutex)
 } /* __PHYSFS_platformReleaseMutex */
 
 
+typedef struct
+{
+    HANDLE handle;
+    void (*fn)(void *);
+    void *arg;
+} WinApiThread;
+
+
+static DWORD WINAPI winApiThreadMain(LPVOID _t)
+{
+    WinApiThread *t = (WinApiThread *) _t;
+    t->fn(t->arg);
+    return 0;
+} /* winApiThreadMain */
+
+
+void *__PHYSFS_platformCreateThread(void (*fn)(void *), void *arg)
+{
+    WinApiThread *t = (WinApiThread *) allocator.Malloc(sizeof (WinApiThread));
+    BAIL_IF(!t, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+    t->fn = fn;
+    t->arg = arg;
+    t->handle = CreateThread(nullptr, 0, winApiThreadMain, t, 0, nullptr);
+    if (t->handle == nullptr)
+    {
+        allocator.Free(t);
+        BAIL(PHYSFS_ERR_OS_ERROR, nullptr);
+    } /* if */
+
+    return ((void *) t);
+} /* __PHYSFS_platformCreateThread */
+
+
+void __PHYSFS_platformJoinThread(void *thread)
+{
+    WinApiThread *t = (WinApiThread *) thread;
+    WaitForSingleObject(t->handle, INFINITE);
+    CloseHandle(t->handle);
+    allocator.Free(t);
+} /* __PHYSFS_platformJoinThread */
+
+
+void *__PHYSFS_platformCreateCond(void)
+{
+    PCONDITION_VARIABLE cv;
+    cv = (PCONDITION_VARIABLE) allocator.Malloc(sizeof (CONDITION_VARIABLE));
+    BAIL_IF(!cv, PHYSFS_ERR_OUT_OF_MEMORY, nullptr);
+    InitializeConditionVariable(cv);
+    return cv;
+} /* __PHYSFS_platformCreateCond */
+
+
+void __PHYSFS_platformDestroyCond(void *cond)
+{
+    /* condition variables have nothing to tear down. */
+    allocator.Free(cond);
+} /* __PHYSFS_platformDestroyCond */
+
+
+void __PHYSFS_platformWaitCond(void *cond, void *mutex)
+{
+    SleepConditionVariableCS((PCONDITION_VARIABLE) cond,
+                             (LPCRITICAL_SECTION) mutex, INFINITE);
+} /* __PHYSFS_platformWaitCond */
+
+
+void __PHYSFS_platformWaitCondTimeout(void *cond, void *mutex, PHYSFS_uint32 ms)
+{
+    SleepConditionVariableCS((PCONDITION_VARIABLE) cond,
+                             (LPCRITICAL_SECTION) mutex, (DWORD) ms);
+} /* __PHYSFS_platformWaitCondTimeout */
+
+
+void __PHYSFS_platformBroadcastCond(void *cond)
+{
+    WakeAllConditionVariable((PCONDITION_VARIABLE) cond);
+} /* __PHYSFS_platformBroadcastCond */
+
+
 static PHYSFS_sint64 FileTimeToPhysfsTime(const FILETIME *ft)
 {
     SYSTEMTIME st_utc;
@@ -1019,6 +1150,55 @@ int __PHYSFS_platformStat(const char *filename, PHYSFS_Stat *st, const int follo
     return 1;
 } /* __PHYSFS_platformStat */
 
+
+int __PHYSFS_platformFileId(const char *fname, PHYSFS_uint64 *device,
+                            PHYSFS_uint64 *inode)
+{
+    HANDLE h;
+    BOOL rc;
+    WCHAR *wfname;
+
+    UTF8_TO_UNICODE_STACK(wfname, fname);
+    if (!wfname)
+        return 0;  /* no error; the caller just won't know. */
+
+    /* Zero access rights: we only want the handle's metadata. */
+    h = winCreateFileW(wfname, 0, OPEN_EXISTING);
+    __PHYSFS_smallFree(wfname);
+    if (h == INVALID_HANDLE_VALUE)
+        return 0;
+
+    #if defined(PHYSFS_PLATFORM_WINRT)
+    {
+        /* ReFS file ids are 128 bits; fold them, size and modtime
+           still have to match too. */
+        FILE_ID_INFO info;
+        PHYSFS_uint64 id[2];
+        rc = GetFileInformationByHandleEx(h, FileIdInfo, &info, sizeof (info));
+        if (rc)
+        {
+            memcpy(id, info.FileId.Identifier, sizeof (id));
+            *device = (PHYSFS_uint64) info.VolumeSerialNumber;
+            *inode = id[0] ^ id[1];
+        } /* if */
+    }
+    #else
+    {
+        BY_HANDLE_FILE_INFORMATION info;
+        rc = GetFileInformationByHandle(h, &info);
+        if (rc)
+        {
+            *device = (PHYSFS_uint64) info.dwVolumeSerialNumber;
+            *inode = (((PHYSFS_uint64) info.nFileIndexHigh) << 32) |
+                     ((PHYSFS_uint64) info.nFileIndexLow);
+        } /* if */
+    }
+    #endif
+
+    CloseHandle(h);
+    return rc ? 1 : 0;
+} /* __PHYSFS_platformFileId */
+
 #endif  /* PHYSFS_PLATFORM_WINDOWS */
 
 /* end of physfs_platform_windows.c ... */
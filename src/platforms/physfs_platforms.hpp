@@ -13,6 +13,9 @@
 #if defined(TARGET_EXTENSION) and (defined(TARGET_PLAYDATE) or defined(TARGET_SIMULATOR))
    #define PHYSFS_PLATFORM_PLAYDATE 1
    #define PHYSFS_NO_CRUNTIME_MALLOC 1
+   #define PHYSFS_NO_POSITIONAL_READS 1
+   #define PHYSFS_NO_READ_AHEAD 1
+   #define PHYSFS_NO_THREADS 1
 #elif defined(__HAIKU__)
    #define PHYSFS_PLATFORM_HAIKU 1
    #define PHYSFS_PLATFORM_POSIX 1
@@ -23,14 +26,19 @@
 #elif defined(_MSC_VER) and (_MSC_VER >= 1700) and not _USING_V110_SDK71_	// _MSC_VER==1700 for MSVC 2012
    #include <winapifamily.h>
    #define PHYSFS_PLATFORM_WINDOWS 1
+   // ReadFile at an OVERLAPPED offset still moves a synchronous        
+   // handle's file pointer, so it can't stand in for pread()           
+   #define PHYSFS_NO_POSITIONAL_READS 1
    #if WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_APP) and not WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP)
       #define PHYSFS_NO_CDROM_SUPPORT 1
       #define PHYSFS_PLATFORM_WINRT 1
    #endif
 #elif (defined(_WIN32) or defined(_WIN64)) and not defined(__CYGWIN__)
    #define PHYSFS_PLATFORM_WINDOWS 1
+   #define PHYSFS_NO_POSITIONAL_READS 1
 #elif defined(__OS2__) or defined(OS2)
    #define PHYSFS_PLATFORM_OS2 1
+   #define PHYSFS_NO_POSITIONAL_READS 1
 #elif defined(__MACH__) and defined(__APPLE__)
    // To check if iOS or not, we need to include this file                 
    #include <TargetConditionals.h>
@@ -50,6 +58,7 @@
    #define PHYSFS_PLATFORM_LINUX 1
    #define PHYSFS_PLATFORM_UNIX 1
    #define PHYSFS_PLATFORM_POSIX 1
+   #define PHYSFS_HAVE_DIRECT_IO 1
 #elif defined(__sun) or defined(sun)
    #define PHYSFS_PLATFORM_SOLARIS 1
    #define PHYSFS_PLATFORM_UNIX 1
@@ -76,6 +85,15 @@
 #elif defined(__wii__) or defined(__gamecube__)
    #define PHYSFS_PLATFORM_OGC 1
    #define PHYSFS_NO_CDROM_SUPPORT 1 // TODO
+   #define PHYSFS_NO_POSITIONAL_READS 1
+   // No std::thread in libogc, read-ahead would need LWP threads       
+   #define PHYSFS_NO_READ_AHEAD 1
+   #define PHYSFS_NO_THREADS 1
 #else
    #error Unknown platform.
+#endif
+
+/// Platforms that can tell whether two paths name the same file              
+#if PHYSFS_PLATFORM_POSIX or PHYSFS_PLATFORM_WINDOWS
+   #define PHYSFS_HAVE_FILE_IDS 1
 #endif
\ No newline at end of file
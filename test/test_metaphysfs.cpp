@@ -14,7 +14,26 @@
    #include <readline/history.h>
 #endif
 
+#if defined(__linux__)
+   #include <fcntl.h>
+   #include <sys/mman.h>
+   #include <sys/stat.h>
+   #include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <format>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 #include <physfs.hpp>
 
 static constexpr int TEST_VERSION_MAJOR = 3;
@@ -24,6 +43,38 @@ static constexpr int TEST_VERSION_PATCH = 0;
 static FILE* history_file = nullptr;
 static PHYSFS_uint32 do_buffer_size = 0;
 
+/// The check commands print a line per failure, and count it here, so that   
+/// a run of them from the command line exits with an error if any fails      
+static int failed_checks = 0;
+
+static bool check(bool ok, const std::string& what) {
+   if (not ok) {
+      std::println("FAILED: {}", what);
+      ++failed_checks;
+   }
+   return ok;
+}
+
+/// Whole contents of (path), as the current context sees it                  
+static bool readWhole(const char* path, std::string& contents) {
+   contents.clear();
+   try {
+      auto f = PHYSFS_openRead(path);
+      if (not f)
+         return false;
+
+      char buf[4096];
+      PHYSFS_sint64 got;
+      while ((got = PHYSFS_readBytes(f, buf, sizeof(buf))) > 0)
+         contents.append(buf, size_t(got));
+      PHYSFS_close(f);
+      return got == 0;
+   }
+   catch (...) {
+      return false;
+   }
+}
+
 
 void output_versions() {
    PHYSFS_Version compiled;
@@ -310,6 +361,34 @@ int cmd_enumerate(char* args) {
    return 1;
 }
 
+int cmd_readdir(char* args) {
+   if (*args == '\"') {
+      args++;
+      args[strlen(args) - 1] = '\0';
+   }
+
+   auto dir = PHYSFS_openDir(args);
+   if (not dir) {
+      std::println("Failure. reason: {}.", PHYSFS_getLastError());
+      return 1;
+   }
+
+   // Read in small batches, the way a background loader would          
+   const char* names[16];
+   PHYSFS_sint64 count;
+   int file_count = 0;
+   while ((count = PHYSFS_readDir(dir, names, std::size(names))) > 0) {
+      for (PHYSFS_sint64 i = 0; i < count; ++i, ++file_count)
+         std::println("{}", names[i]);
+   }
+
+   if (count < 0)
+      std::println("Failure. reason: {}.", PHYSFS_getLastError());
+   std::print("\n total ({}) files.\n", file_count);
+   PHYSFS_closeDir(dir);
+   return 1;
+}
+
 #define STR_BOX_VERTICAL_RIGHT  "\xe2\x94\x9c"
 #define STR_BOX_VERTICAL        "\xe2\x94\x82"
 #define STR_BOX_HORIZONTAL      "\xe2\x94\x80"
@@ -1163,208 +1242,2547 @@ static int cmd_stat(char* args) {
    return 1;
 } /* cmd_filelength */
 
+static int cmd_statex(char* args) {
+   if (*args == '\"') {
+      args++;
+      args[strlen(args) - 1] = '\0';
+   }
 
+   PHYSFS_StatEx st;
+   if (not PHYSFS_statEx(args, &st)) {
+      std::println("failed to stat. Reason [{}].", PHYSFS_getLastError());
+      return 1;
+   }
 
-/* must have spaces trimmed prior to this call. */
-static int count_args(const char* str) {
-   int retval = 0;
-   int in_quotes = 0;
-
-   if (str != nullptr) {
-      for (; *str != '\0'; str++) {
-         if (*str == '\"')
-            in_quotes = !in_quotes;
-         else if ((*str == ' ') && (!in_quotes))
-            retval++;
-      } /* for */
-      retval++;
-   } /* if */
+   static constexpr const char* compressions[] = {
+      "none", "deflate", "lz4", "solid", "other", "unknown"
+   };
+
+   std::println("Filename: {}", args);
+   std::println("Size: {}", st.stat.filesize);
+   std::println("Archive: {}", st.archive);
+   std::println("Offset: {}", st.offset);
+   std::println("Stored size: {}", st.storedSize);
+   std::println("Compression: {} (method {})", compressions[st.compression], st.method);
+   std::println("Block: {}", st.block);
+   std::println("Contiguous: {}", st.contiguous ? "true" : "false");
+   std::println("Mappable: {}", st.mappable ? "true" : "false");
+   std::println("Encrypted: {}", st.encrypted ? "true" : "false");
+   return 1;
+}
 
-   return retval;
-} /* count_args */
+static int cmd_benchcasefold(char* args) {
+   if (*args == '\"') {
+      args++;
+      args[strlen(args) - 1] = '\0';
+   }
 
+   const auto iterations = atoi(args);
+   if (iterations <= 0) {
+      std::println("iterations must be greater than zero.");
+      return 1;
+   }
 
-static int cmd_help(char* args);
+   struct Sample {
+      const char* name;
+      PHYSFS_uint32 first;
+      PHYSFS_uint32 last;
+   };
+
+   // Mixed case ranges, so that roughly half of each sample folds      
+   static constexpr Sample samples[] = {
+      {"ASCII",    0x0041, 0x007A},
+      {"Latin-1",  0x00C0, 0x00FF},
+      {"Cyrillic", 0x0400, 0x047F},
+      {"Astral",   0x10400, 0x1044F},
+   };
+
+   for (auto& sample : samples) {
+      PHYSFS_uint32 input[256];
+      PHYSFS_uint32 folded[3];
+      PHYSFS_uint64 checksum = 0;
+      const auto span = sample.last - sample.first + 1;
+      for (PHYSFS_uint32 i = 0; i < 256; ++i)
+         input[i] = sample.first + (i % span);
+
+      const auto start = std::chrono::steady_clock::now();
+      for (int n = 0; n < iterations; ++n) {
+         for (auto cp : input)
+            checksum += PHYSFS_caseFold(cp, folded) + folded[0];
+      }
+      const auto end = std::chrono::steady_clock::now();
 
-typedef struct
-{
-   const char* cmd;
-   int (*func)(char* args);
-   int argcount;
-   const char* usage;
-} command_info;
+      const auto ns = std::chrono::duration<double, std::nano>(end - start).count();
+      std::println("{:>9}: {:.2f} ns per codepoint (checksum {:X})",
+         sample.name, ns / (256.0 * iterations), checksum);
+   }
 
-static const command_info commands[] =
-{
-   {"quit", cmd_quit, 0, nullptr},
-   {"q", cmd_quit, 0, nullptr},
-   {"help", cmd_help, 0, nullptr},
-   {"init", cmd_init, 1, "<argv0>"},
-   {"deinit", cmd_deinit, 0, nullptr},
-   {"addarchive", cmd_addarchive, 2, "<archiveLocation> <append>"},
-   {"mount", cmd_mount, 3, "<archiveLocation> <mntpoint> <append>"},
-   {"mountmem", cmd_mount_mem, 3, "<archiveLocation> <mntpoint> <append>"},
-   {"mounthandle", cmd_mount_handle, 3, "<archiveLocation> <mntpoint> <append>"},
-   {"removearchive", cmd_removearchive, 1, "<archiveLocation>"},
-   {"unmount", cmd_removearchive, 1, "<archiveLocation>"},
-   {"enumerate", cmd_enumerate, 1, "<dirToEnumerate>"},
-   {"ls", cmd_enumerate, 1, "<dirToEnumerate>"},
-   {"tree", cmd_tree, 1, "<dirToEnumerate>"},
-   {"getlasterror", cmd_getlasterror, 0, nullptr},
-   {"getdirsep", cmd_getdirsep, 0, nullptr},
-   {"getcdromdirs", cmd_getcdromdirs, 0, nullptr},
-   {"getsearchpath", cmd_getsearchpath, 0, nullptr},
-   {"getbasedir", cmd_getbasedir, 0, nullptr},
-   {"getuserdir", cmd_getuserdir, 0, nullptr},
-   {"getprefdir", cmd_getprefdir, 2, "<org> <app>"},
-   {"getwritedir", cmd_getwritedir, 0, nullptr},
-   {"setwritedir", cmd_setwritedir, 1, "<newWriteDir>"},
-   {"permitsymlinks", cmd_permitsyms, 1, "<1or0>"},
-   {"setsaneconfig", cmd_setsaneconfig, 5, "<org> <appName> <arcExt> <includeCdRoms> <archivesFirst>"},
-   {"mkdir", cmd_mkdir, 1, "<dirToMk>"},
-   {"delete", cmd_delete, 1, "<dirToDelete>"},
-   {"getrealdir", cmd_getrealdir, 1, "<fileToFind>"},
-   {"exists", cmd_exists, 1, "<fileToCheck>"},
-   {"isdir", cmd_isdir, 1, "<fileToCheck>"},
-   {"issymlink", cmd_issymlink, 1, "<fileToCheck>"},
-   {"cat", cmd_cat, 1, "<fileToCat>"},
-   {"cat2", cmd_cat2, 2, "<fileToCat1> <fileToCat2>"},
-   {"filelength", cmd_filelength, 1, "<fileToCheck>"},
-   {"stat", cmd_stat, 1, "<fileToStat>"},
-   {"append", cmd_append, 1, "<fileToAppend>"},
-   {"write", cmd_write, 1, "<fileToCreateOrTrash>"},
-   {"getlastmodtime", cmd_getlastmodtime, 1, "<fileToExamine>"},
-   {"setbuffer", cmd_setbuffer, 1, "<bufferSize>"},
-   {"stressbuffer", cmd_stressbuffer, 1, "<bufferSize>"},
-   {"crc32", cmd_crc32, 1, "<fileToHash>"},
-   {"getmountpoint", cmd_getmountpoint, 1, "<dir>"},
-   {"setroot", cmd_setroot, 2, "<archiveLocation> <root>"},
-   {nullptr, nullptr, -1, nullptr}
-};
+   return 1;
+}
 
+static int cmd_benchopenclose(char* args) {
+   if (*args == '\"') {
+      args++;
+      args[strlen(args) - 1] = '\0';
+   }
 
-static void output_usage(const char* intro, const command_info* cmdinfo) {
-   if (cmdinfo->argcount == 0)
-      printf("%s \"%s\" (no arguments)\n", intro, cmdinfo->cmd);
-   else
-      printf("%s \"%s %s\"\n", intro, cmdinfo->cmd, cmdinfo->usage);
-} /* output_usage */
+   // Cost of one open+close pair while N other handles stay open       
+   static constexpr int outstanding[] = {1, 1000, 50000};
+   static constexpr int cycles = 10000;
+   std::vector<PHYSFS_File*> held;
 
+   for (auto count : outstanding) {
+      held.reserve(count);
+      while (held.size() < size_t(count)) {
+         auto f = PHYSFS_openRead(args);
+         if (not f) {
+            std::println("Couldn't open [{}] ({} handles open): {}.", args,
+               held.size(), PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+            break;
+         }
+         held.push_back(f);
+      }
 
-static int cmd_help(char* args) {
-   const command_info* i;
+      const auto start = std::chrono::steady_clock::now();
+      for (int n = 0; n < cycles; ++n) {
+         auto f = PHYSFS_openRead(args);
+         if (not f)
+            break;
+         PHYSFS_close(f);
+      }
+      const auto end = std::chrono::steady_clock::now();
 
-   printf("Commands:\n");
-   for (i = commands; i->cmd != nullptr; i++)
-      output_usage("  -", i);
+      const auto ns = std::chrono::duration<double, std::nano>(end - start).count();
+      std::println("{:>6} outstanding: {:.0f} ns per open+close",
+         held.size(), ns / cycles);
+   }
 
+   for (auto f : held)
+      PHYSFS_close(f);
    return 1;
-} /* output_cmd_help */
+}
 
+static int cmd_benchreadat(char* args) {
+   if (*args == '\"') {
+      args++;
+      args[strlen(args) - 1] = '\0';
+   }
 
-static void trim_command(const char* orig, char* copy) {
-   const char* i;
-   char* writeptr = copy;
-   int spacecount = 0;
-   int have_first = 0;
+   auto f = PHYSFS_openRead(args);
+   if (not f) {
+      std::println("Couldn't open [{}]: {}.", args,
+         PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+      return 1;
+   }
 
-   for (i = orig; *i != '\0'; i++) {
-      if (*i == ' ') {
-         if ((*(i + 1) != ' ') && (*(i + 1) != '\0')) {
-            if ((have_first) && (!spacecount)) {
-               spacecount++;
-               *writeptr = ' ';
-               writeptr++;
-            } /* if */
-         } /* if */
-      } /* if */
-      else {
-         have_first = 1;
-         spacecount = 0;
-         *writeptr = *i;
-         writeptr++;
-      } /* else */
-   } /* for */
+   const auto length = PHYSFS_fileLength(f);
+   if (length <= 0) {
+      std::println("Couldn't determine the length of [{}].", args);
+      PHYSFS_close(f);
+      return 1;
+   }
 
-   *writeptr = '\0';
+   // Every worker reads its own interleaved chunks of one shared handle
+   static constexpr PHYSFS_uint64 chunk = 1024 * 1024;
+   const auto chunks = (PHYSFS_uint64(length) + chunk - 1) / chunk;
+
+   for (unsigned workers : {1u, 2u, 4u, 8u}) {
+      std::vector<std::thread> threads;
+      std::vector<PHYSFS_uint64> totals(workers);
+      const auto start = std::chrono::steady_clock::now();
+
+      for (unsigned w = 0; w < workers; ++w) {
+         threads.emplace_back([&, w] {
+            std::vector<char> buf(chunk);
+            for (auto c = PHYSFS_uint64(w); c < chunks; c += workers) {
+               const auto rc = PHYSFS_readAt(f, c * chunk, buf.data(), chunk);
+               if (rc <= 0)
+                  break;
+               totals[w] += PHYSFS_uint64(rc);
+            }
+         });
+      }
 
-   /*
-   printf("\n command is [%s].\n", copy);
-   */
-} /* trim_command */
+      for (auto& t : threads)
+         t.join();
+      const auto end = std::chrono::steady_clock::now();
 
+      PHYSFS_uint64 total = 0;
+      for (auto t : totals)
+         total += t;
 
-static int process_command(char* complete_cmd) {
-   const command_info* i;
-   char* cmd_copy;
-   char* args;
-   int rc = 1;
+      const auto s = std::chrono::duration<double>(end - start).count();
+      std::println("{} thread(s): {} bytes in {:.3f} s, {:.1f} MiB/s",
+         workers, total, s, total / s / (1024.0 * 1024.0));
+   }
 
-   if (complete_cmd == nullptr)  /* can happen if user hits CTRL-D, etc. */
-   {
-      printf("\n");
-      return 0;
-   } /* if */
+   PHYSFS_close(f);
+   return 1;
+}
 
-   cmd_copy = (char*)malloc(strlen(complete_cmd) + 1);
-   if (cmd_copy == nullptr) {
-      printf("\n\n\nOUT OF MEMORY!\n\n\n");
-      return 0;
-   } /* if */
+/// A PHYSFS_Io over a stdio file, for mounting through the simulated media   
+struct StdioFile {
+   FILE* file;
+   std::string path;
+};
 
-   trim_command(complete_cmd, cmd_copy);
-   args = strchr(cmd_copy, ' ');
-   if (args != nullptr) {
-      *args = '\0';
-      args++;
-   } /* else */
+static PHYSFS_Io* stdioIo_create(const std::string& path);
 
-   if (cmd_copy[0] != '\0') {
-      for (i = commands; i->cmd != nullptr; i++) {
-         if (strcmp(i->cmd, cmd_copy) == 0) {
-            if ((i->argcount >= 0) && (count_args(args) != i->argcount))
-               output_usage("usage:", i);
-            else
-               rc = i->func(args);
-            break;
-         } /* if */
-      } /* for */
+static PHYSFS_sint64 stdioIo_read(PHYSFS_Io* io, void* buf, PHYSFS_uint64 len) {
+   auto sf = static_cast<StdioFile*>(io->opaque);
+   const auto rc = fread(buf, 1, size_t(len), sf->file);
+   return (rc == 0 and ferror(sf->file)) ? -1 : PHYSFS_sint64(rc);
+}
 
-      if (i->cmd == nullptr)
-         printf("Unknown command. Enter \"help\" for instructions.\n");
+static PHYSFS_sint64 stdioIo_write(PHYSFS_Io*, const void*, PHYSFS_uint64) {
+   return -1;
+}
 
-   #if (defined PHYSFS_HAVE_READLINE)
-      add_history(complete_cmd);
-      if (history_file) {
-         fprintf(history_file, "%s\n", complete_cmd);
-         fflush(history_file);
-      } /* if */
-   #endif
+static int stdioIo_seek(PHYSFS_Io* io, PHYSFS_uint64 offset) {
+   return fseek(static_cast<StdioFile*>(io->opaque)->file, long(offset), SEEK_SET) == 0;
+}
 
-   } /* if */
+static PHYSFS_sint64 stdioIo_tell(PHYSFS_Io* io) {
+   return ftell(static_cast<StdioFile*>(io->opaque)->file);
+}
 
-   free(cmd_copy);
-   return rc;
-} /* process_command */
+static PHYSFS_sint64 stdioIo_length(PHYSFS_Io* io) {
+   auto file = static_cast<StdioFile*>(io->opaque)->file;
+   const auto at = ftell(file);
+   fseek(file, 0, SEEK_END);
+   const auto retval = ftell(file);
+   fseek(file, at, SEEK_SET);
+   return retval;
+}
 
+static PHYSFS_Io* stdioIo_duplicate(PHYSFS_Io* io) {
+   return stdioIo_create(static_cast<StdioFile*>(io->opaque)->path);
+}
 
-static void open_history_file(void) {
-#if (defined PHYSFS_HAVE_READLINE)
-#if 0
-   const char* envr = getenv("TESTPHYSFS_HISTORY");
-   if (!envr)
-      return;
-#else
-   char envr[256];
-   strcpy(envr, PHYSFS_getUserDir());
-   strcat(envr, ".testphys_history");
-#endif
+static int stdioIo_flush(PHYSFS_Io*) {
+   return 1;
+}
 
-   if (access(envr, F_OK) == 0) {
-      char buf[512];
-      FILE* f = fopen(envr, "r");
-      if (!f) {
-         printf("\n\n"
+static void stdioIo_destroy(PHYSFS_Io* io) {
+   auto sf = static_cast<StdioFile*>(io->opaque);
+   fclose(sf->file);
+   delete sf;
+   delete io;
+}
+
+static PHYSFS_Io* stdioIo_create(const std::string& path) {
+   auto file = fopen(path.c_str(), "rb");
+   if (not file)
+      return nullptr;
+
+   return new PHYSFS_Io {
+      1, new StdioFile {file, path},
+      stdioIo_read, stdioIo_write, stdioIo_seek, stdioIo_tell, stdioIo_length,
+      stdioIo_duplicate, stdioIo_flush, stdioIo_destroy, nullptr
+   };
+}
+
+/// Media that "mountsim" and "benchsuite" put archives on, see "simmedia"    
+static PHYSFS_SimulatedMedia simMedia {};
+
+/// Mount a native archive through the simulated media                        
+static PHYSFS_Io* mountSimulated(const char* archive, const char* mntpoint,
+   int appending, const PHYSFS_SimulatedMedia& media) {
+   auto file = stdioIo_create(archive);
+   if (not file) {
+      std::println("Couldn't open [{}].", archive);
+      return nullptr;
+   }
+
+   PHYSFS_Io* io = nullptr;
+   try { io = PHYSFS_createSimulatedIo(file, &media); }
+   catch (...) {}
+   if (not io) {
+      std::println("Couldn't simulate media: {}.",
+         PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+      file->destroy(file);
+      return nullptr;
+   }
+
+   int rc = 0;
+   try { rc = PHYSFS_mountIo(io, archive, mntpoint, appending); }
+   catch (...) {}
+   if (not rc) {
+      std::println("Couldn't mount [{}]: {}.", archive,
+         PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+      io->destroy(io);
+      return nullptr;
+   }
+   return io;
+}
+
+static int cmd_simmedia(char* args) {
+   unsigned latency = 0, jitter = 0, seek = 0, depth = 0;
+   double mibps = 0;
+   unsigned long long seed = 0;
+   if (sscanf(args, "%u %u %u %lf %u %llu", &latency, &jitter, &seek, &mibps, &depth, &seed) != 6 or mibps < 0) {
+      std::println("usage: simmedia <latencyUs> <jitterUs> <seekUs> <MiBps> <queueDepth> <seed>");
+      return 1;
+   }
+
+   simMedia.latencyUs = latency;
+   simMedia.jitterUs = jitter;
+   simMedia.seekUs = seek;
+   simMedia.bytesPerSecond = PHYSFS_uint64(mibps * 1024.0 * 1024.0);
+   simMedia.queueDepth = depth;
+   simMedia.seed = seed;
+   std::println("Archives mounted with mountsim or benchsuite now simulate this media.");
+   return 1;
+}
+
+static int cmd_mountsim(char* args) {
+   char archive[512], mntpoint[512];
+   int appending = 0;
+   if (sscanf(args, "%511s %511s %d", archive, mntpoint, &appending) != 3) {
+      std::println("usage: mountsim <archiveLocation> <mntpoint> <append>");
+      return 1;
+   }
+
+   if (mountSimulated(archive, mntpoint, appending, simMedia))
+      std::println("Successful.");
+   return 1;
+}
+
+/// Same as mountsim, with a block cache between the archive and the media    
+static int cmd_mountcached(char* args) {
+   char archive[512], mntpoint[512];
+   unsigned blockSize = 0, readAhead = 0;
+   if (sscanf(args, "%511s %511s %u %u", archive, mntpoint, &blockSize, &readAhead) != 4) {
+      std::println("usage: mountcached <archiveLocation> <mntpoint> <blockSize> <readAhead>");
+      return 1;
+   }
+
+   auto file = stdioIo_create(archive);
+   if (not file) {
+      std::println("Couldn't open [{}].", archive);
+      return 1;
+   }
+
+   PHYSFS_Io* io = nullptr;
+   try {
+      auto slow = PHYSFS_createSimulatedIo(file, &simMedia);
+      if (slow) {
+         file = slow;
+         io = PHYSFS_createCachedIo(file, blockSize, readAhead);
+      }
+   }
+   catch (...) {}
+   if (not io) {
+      std::println("Couldn't cache [{}]: {}.", archive,
+         PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+      file->destroy(file);
+      return 1;
+   }
+
+   int rc = 0;
+   try { rc = PHYSFS_mountIo(io, archive, mntpoint, 1); }
+   catch (...) {}
+   if (not rc) {
+      std::println("Couldn't mount [{}]: {}.", archive,
+         PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+      io->destroy(io);
+      return 1;
+   }
+
+   std::println("Successful.");
+   return 1;
+}
+
+static int cmd_iocachestats(char*) {
+   PHYSFS_IoCacheStats stats;
+   if (not PHYSFS_getIoCacheStats(&stats))
+      return 1;
+
+   std::println("{} hits, {} misses, {} blocks read ahead, {} evictions",
+      stats.hits, stats.misses, stats.readAheadBlocks, stats.evictions);
+   std::println("{} bytes in {} blocks cached", stats.cachedBytes, stats.cachedBlocks);
+   return 1;
+}
+
+static int cmd_setiocachesize(char* args) {
+   if (PHYSFS_setIoCacheSize(PHYSFS_uint64(strtoull(args, nullptr, 10))))
+      std::println("Successful.");
+   return 1;
+}
+
+static void collectFiles(const std::string& dir, std::vector<std::string>& files) {
+   auto list = PHYSFS_enumerateFiles(dir.c_str());
+   if (not list)
+      return;
+
+   for (auto i = list; *i; ++i) {
+      const auto path = dir + "/" + *i;
+      PHYSFS_Stat st;
+      if (not PHYSFS_stat(path.c_str(), &st))
+         continue;
+      if (st.filetype == PHYSFS_FILETYPE_DIRECTORY)
+         collectFiles(path, files);
+      else if (st.filetype == PHYSFS_FILETYPE_REGULAR)
+         files.push_back(path);
+   }
+   PHYSFS_freeList(list);
+}
+
+/// Runs the usual access patterns over an archive on the simulated media,    
+/// and reports both the wall time and the device's deterministic busy time   
+static int cmd_benchsuite(char* args) {
+   if (*args == '\"') {
+      args++;
+      args[strlen(args) - 1] = '\0';
+   }
+
+   auto io = mountSimulated(args, "benchsuite", 1, simMedia);
+   if (not io)
+      return 1;
+
+   std::vector<std::string> files;
+   PHYSFS_SimulatedStats before {}, after {};
+   const auto report = [&](const char* name, auto start) {
+      const auto end = std::chrono::steady_clock::now();
+      PHYSFS_getSimulatedStats(io, &after);
+      std::println("{:<12} {:>9.1f} ms wall, {:>9.1f} ms busy, {:>7} requests, {:>6} seeks, {:>11} bytes",
+         name, std::chrono::duration<double, std::milli>(end - start).count(),
+         (after.busyUs - before.busyUs) / 1000.0, after.requests - before.requests,
+         after.seeks - before.seeks, after.bytes - before.bytes);
+      before = after;
+   };
+
+   PHYSFS_getSimulatedStats(io, &before);
+   auto start = std::chrono::steady_clock::now();
+   collectFiles("benchsuite", files);
+   report("enumerate", start);
+
+   // Every file, start to end, in enumeration order                    
+   std::vector<char> buf(64 * 1024);
+   start = std::chrono::steady_clock::now();
+   for (auto& path : files) {
+      auto f = PHYSFS_openRead(path.c_str());
+      if (not f)
+         continue;
+      while (PHYSFS_readBytes(f, buf.data(), buf.size()) > 0)
+         ;
+      PHYSFS_close(f);
+   }
+   report("sequential", start);
+
+   // Small reads at seeded random places, the same ones on every run   
+   std::minstd_rand rng {PHYSFS_uint32(simMedia.seed)};
+   start = std::chrono::steady_clock::now();
+   for (size_t i = 0; not files.empty() and i < 256; ++i) {
+      auto f = PHYSFS_openRead(files[rng() % files.size()].c_str());
+      if (not f)
+         continue;
+      const auto length = PHYSFS_fileLength(f);
+      if (length > 0 and PHYSFS_seek(f, PHYSFS_uint64(rng()) % PHYSFS_uint64(length)))
+         PHYSFS_readBytes(f, buf.data(), 4096);
+      PHYSFS_close(f);
+   }
+   report("random", start);
+
+   // The same files again, their chunks spread over four threads       
+   start = std::chrono::steady_clock::now();
+   for (auto& path : files) {
+      auto f = PHYSFS_openRead(path.c_str());
+      if (not f)
+         continue;
+
+      static constexpr PHYSFS_uint64 chunk = 64 * 1024;
+      const auto length = PHYSFS_fileLength(f);
+      const auto chunks = length > 0 ? (PHYSFS_uint64(length) + chunk - 1) / chunk : 0;
+      std::vector<std::thread> threads;
+      for (unsigned w = 0; w < 4; ++w) {
+         threads.emplace_back([&, w] {
+            std::vector<char> tbuf(chunk);
+            for (auto c = PHYSFS_uint64(w); c < chunks; c += 4)
+               if (PHYSFS_readAt(f, c * chunk, tbuf.data(), chunk) <= 0)
+                  break;
+         });
+      }
+      for (auto& t : threads)
+         t.join();
+      PHYSFS_close(f);
+   }
+   report("parallel", start);
+
+   PHYSFS_unmount(args);
+   return 1;
+}
+
+static int cmd_benchreadahead(char* args) {
+   char archive[512], entry[512];
+   long latency = 0;
+   if (sscanf(args, "%511s %511s %ld", archive, entry, &latency) != 3) {
+      std::println("usage: benchreadahead <archiveLocation> <entry> <latencyUs>");
+      return 1;
+   }
+
+   // The archive is mounted on simulated media, so every read the      
+   // archiver makes, on any duplicate, pays the latency                
+   PHYSFS_SimulatedMedia media {};
+   media.latencyUs = PHYSFS_uint32(latency);
+   if (not mountSimulated(archive, "benchreadahead", 0, media))
+      return 1;
+
+   const auto path = std::string("benchreadahead/") + entry;
+   std::vector<char> buf(64 * 1024);
+   for (PHYSFS_uint64 minSize : {PHYSFS_uint64(0), PHYSFS_uint64(1)}) {
+      if (not PHYSFS_setReadAhead(minSize)) {
+         std::println("Read-ahead isn't available in this build.");
+         break;
+      }
+
+      const auto start = std::chrono::steady_clock::now();
+      auto f = PHYSFS_openRead(path.c_str());
+      if (not f) {
+         std::println("Couldn't open [{}]: {}.", path,
+            PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+         break;
+      }
+
+      PHYSFS_uint64 total = 0;
+      PHYSFS_sint64 rc;
+      while ((rc = PHYSFS_readBytes(f, buf.data(), buf.size())) > 0)
+         total += PHYSFS_uint64(rc);
+      PHYSFS_close(f);
+      const auto end = std::chrono::steady_clock::now();
+
+      const auto secs = std::chrono::duration<double>(end - start).count();
+      std::println("{:>10}: {} bytes in {:.3f} s, {:.1f} MiB/s",
+         minSize ? "read-ahead" : "plain", total, secs,
+         total / secs / (1024.0 * 1024.0));
+   }
+
+   PHYSFS_setReadAhead(1024 * 1024);
+   PHYSFS_unmount(archive);
+   return 1;
+}
+
+/// Streams one entry in the background, while the foreground opens and reads 
+/// random files of the same archive, all on the simulated media. Once with   
+/// the archive mounted straight off the media, and once with a scheduler     
+/// in front of it, that throttles the background stream to (MiBps)           
+static int cmd_benchpriority(char* args) {
+   char archive[512], entry[512];
+   double mibps = 0;
+   if (sscanf(args, "%511s %511s %lf", archive, entry, &mibps) != 3) {
+      std::println("usage: benchpriority <archiveLocation> <streamedEntry> <backgroundMiBps>");
+      return 1;
+   }
+
+   PHYSFS_IoSchedule schedule {};
+   schedule.queueDepth = simMedia.queueDepth;
+   schedule.chunkSize = 64 * 1024;
+   schedule.backgroundBytesPerSecond = PHYSFS_uint64(mibps * 1024.0 * 1024.0);
+
+   const auto streamed = std::string("benchpriority/") + entry;
+   for (bool scheduled : {false, true}) {
+      auto io = stdioIo_create(archive);
+      if (not io) {
+         std::println("Couldn't open [{}].", archive);
+         return 1;
+      }
+
+      try {
+         if (auto slow = PHYSFS_createSimulatedIo(io, &simMedia)) {
+            io = slow;
+            if (scheduled) {
+               if (auto sched = PHYSFS_createScheduledIo(io, &schedule))
+                  io = sched;
+            }
+         }
+         if (not PHYSFS_mountIo(io, archive, "benchpriority", 0))
+            throw 0;
+      }
+      catch (...) {
+         std::println("Couldn't mount [{}]: {}.", archive,
+            PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+         io->destroy(io);
+         return 1;
+      }
+
+      std::vector<std::string> files;
+      collectFiles("benchpriority", files);
+      std::erase(files, streamed);
+
+      std::atomic<bool> stop {false};
+      std::atomic<PHYSFS_uint64> streamedBytes {0};
+      std::thread background {[&] {
+         PHYSFS_setIoPriority(PHYSFS_IO_BACKGROUND, 0);
+         std::vector<char> buf(1024 * 1024);
+         while (not stop) {
+            PHYSFS_File* f = nullptr;
+            try { f = PHYSFS_openRead(streamed.c_str()); }
+            catch (...) {}
+            if (not f)
+               break;
+
+            PHYSFS_sint64 rc;
+            while (not stop and (rc = PHYSFS_readBytes(f, buf.data(), buf.size())) > 0)
+               streamedBytes += PHYSFS_uint64(rc);
+            PHYSFS_close(f);
+         }
+      }};
+
+      const auto start = std::chrono::steady_clock::now();
+      std::vector<double> latencies;
+      std::vector<char> buf(64 * 1024);
+      std::minstd_rand rng {PHYSFS_uint32(simMedia.seed)};
+      for (size_t i = 0; not files.empty() and i < 200; ++i) {
+         const auto t = std::chrono::steady_clock::now();
+         PHYSFS_File* f = nullptr;
+         try { f = PHYSFS_openRead(files[rng() % files.size()].c_str()); }
+         catch (...) {}
+         if (not f)
+            continue;
+         PHYSFS_readBytes(f, buf.data(), buf.size());
+         PHYSFS_close(f);
+         latencies.push_back(std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - t).count());
+      }
+
+      stop = true;
+      background.join();
+      const auto secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      std::sort(latencies.begin(), latencies.end());
+      const auto at = [&](double q) {
+         return latencies.empty() ? 0.0 : latencies[size_t(q * (latencies.size() - 1))];
+      };
+      std::println("{:>9}: foreground p50 {:.2f} ms, p99 {:.2f} ms, max {:.2f} ms; background {:.1f} MiB/s",
+         scheduled ? "scheduled" : "plain", at(0.5), at(0.99), at(1.0),
+         streamedBytes / secs / (1024.0 * 1024.0));
+
+      PHYSFS_IoSchedulerStats stats;
+      if (scheduled and PHYSFS_getIoSchedulerStats(io, &stats)) {
+         static constexpr const char* names[] {"critical", "streaming", "background"};
+         for (int c = 0; c < PHYSFS_IO_PRIORITY_COUNT; ++c) {
+            const auto& cls = stats.classes[c];
+            std::println("{:>11}: {} requests, {} bytes, {:.2f} ms average wait, {:.2f} ms max, {} queued at most",
+               names[c], cls.requests, cls.bytes,
+               cls.requests ? cls.waitUs / 1000.0 / cls.requests : 0.0,
+               cls.maxWaitUs / 1000.0, cls.maxQueued);
+         }
+         std::println("{:>11}: {} preemptions, {} throttled", "", stats.preemptions, stats.throttled);
+      }
+
+      PHYSFS_unmount(archive);
+   }
+   return 1;
+}
+
+/// Fire-and-forget coroutine, just enough to drive the async api             
+struct DetachedTask {
+   struct promise_type {
+      DetachedTask get_return_object() noexcept { return {}; }
+      std::suspend_never initial_suspend() noexcept { return {}; }
+      std::suspend_never final_suspend() noexcept { return {}; }
+      void return_void() noexcept {}
+      void unhandled_exception() { std::terminate(); }
+   };
+};
+
+/// Stands in for an engine's task system: coroutines are posted here from    
+/// the i/o threads, and resumed on the thread that runs the queue            
+struct ResumeQueue {
+   std::mutex mutex;
+   std::condition_variable wake;
+   std::deque<std::coroutine_handle<>> ready;
+
+   static void Post(void* context, std::coroutine_handle<> coroutine) {
+      auto self = static_cast<ResumeQueue*>(context);
+      std::lock_guard lock {self->mutex};
+      self->ready.push_back(coroutine);
+      self->wake.notify_one();
+   }
+
+   MetaPhysFS::Executor Executor() {
+      return {Post, this};
+   }
+
+   void RunUntil(const size_t& left) {
+      while (left) {
+         std::unique_lock lock {mutex};
+         wake.wait(lock, [this] { return not ready.empty(); });
+         auto coroutine = ready.front();
+         ready.pop_front();
+         lock.unlock();
+         coroutine.resume();
+      }
+   }
+};
+
+struct AsyncLoad {
+   size_t left = 0;
+   size_t failed = 0;
+   size_t cancelled = 0;
+   PHYSFS_uint64 bytes = 0;
+   PHYSFS_uint32 sum = 0;
+};
+
+static DetachedTask loadAsync(const char* path, MetaPhysFS::Executor executor,
+   std::stop_token cancel, AsyncLoad& load) {
+   auto data = co_await MetaPhysFS::ReadWholeFileAsync(path, executor, cancel);
+   if (not data) {
+      if (PHYSFS_getLastErrorCode() == PHYSFS_ERR_CANCELLED)
+         ++load.cancelled;
+      else
+         ++load.failed;
+   }
+   else {
+      load.bytes += data.Size();
+      for (auto b : data.Bytes())
+         load.sum = load.sum * 31 + PHYSFS_uint32(b);
+   }
+   --load.left;
+}
+
+/// Reads every file of an archive on the simulated media whole, one after    
+/// the other with the blocking calls, then all at once as coroutines over    
+/// (threads) i/o threads, then once more, cancelled right after it starts    
+static int cmd_benchasync(char* args) {
+   char archive[512];
+   unsigned threads = 0;
+   if (sscanf(args, "%511s %u", archive, &threads) != 2) {
+      std::println("usage: benchasync <archiveLocation> <threads>");
+      return 1;
+   }
+   if (not PHYSFS_setAsyncThreads(threads)) {
+      std::println("Failure. reason: {}.", PHYSFS_getLastError());
+      return 1;
+   }
+
+   auto io = mountSimulated(archive, "benchasync", 0, simMedia);
+   if (not io)
+      return 1;
+
+   std::vector<std::string> files;
+   collectFiles("benchasync", files);
+
+   auto start = std::chrono::steady_clock::now();
+   AsyncLoad blocking;
+   std::vector<char> buf;
+   for (auto& path : files) {
+      PHYSFS_File* f = nullptr;
+      try { f = PHYSFS_openRead(path.c_str()); }
+      catch (...) {}
+      if (not f) {
+         ++blocking.failed;
+         continue;
+      }
+      buf.resize(size_t(std::max<PHYSFS_sint64>(PHYSFS_fileLength(f), 0)));
+      const auto rc = PHYSFS_readBytes(f, buf.data(), buf.size());
+      PHYSFS_close(f);
+      if (rc < 0) {
+         ++blocking.failed;
+         continue;
+      }
+      blocking.bytes += PHYSFS_uint64(rc);
+      for (auto b : std::span(buf.data(), size_t(rc)))
+         blocking.sum = blocking.sum * 31 + PHYSFS_uint32(std::byte(b));
+   }
+   auto end = std::chrono::steady_clock::now();
+   std::println("blocking: {} files, {} bytes in {:.1f} ms, {} failed",
+      files.size(), blocking.bytes,
+      std::chrono::duration<double, std::milli>(end - start).count(), blocking.failed);
+
+   for (bool cancelling : {false, true}) {
+      ResumeQueue queue;
+      std::stop_source stop;
+      AsyncLoad load;
+      load.left = files.size();
+      start = std::chrono::steady_clock::now();
+      for (auto& path : files)
+         loadAsync(path.c_str(), queue.Executor(), stop.get_token(), load);
+      if (cancelling)
+         stop.request_stop();
+      queue.RunUntil(load.left);
+      end = std::chrono::steady_clock::now();
+
+      // Coroutines run in the order they complete, so only the total   
+      // can be checked against the blocking pass                       
+      std::println("{:>8}: {} files, {} bytes in {:.1f} ms, {} failed, {} cancelled{}",
+         cancelling ? "cancel" : "async", files.size(), load.bytes,
+         std::chrono::duration<double, std::milli>(end - start).count(),
+         load.failed, load.cancelled,
+         cancelling or load.bytes == blocking.bytes ? "" : " - MISMATCH");
+   }
+
+   PHYSFS_unmount(archive);
+   return 1;
+}
+
+static int cmd_setinline(char* args) {
+   unsigned long maxFileSize = 0;
+   unsigned long long maxBytes = 0;
+   if (sscanf(args, "%lu %llu", &maxFileSize, &maxBytes) != 2) {
+      std::println("usage: setinline <maxFileSize> <maxBytes>");
+      return 1;
+   }
+
+   if (PHYSFS_setInlineSmallFiles(PHYSFS_uint32(maxFileSize), PHYSFS_uint64(maxBytes)))
+      std::println("Successful.");
+   return 1;
+}
+
+/// Mounts an archive on the simulated media, then opens and reads every      
+/// file up to (maxFileSize), with inlining off and then on. The mount is     
+/// part of the timing, since that's where ZIP pays for its inlining          
+static int cmd_benchinline(char* args) {
+   char archive[512];
+   unsigned long maxFileSize = 0;
+   if (sscanf(args, "%511s %lu", archive, &maxFileSize) != 2) {
+      std::println("usage: benchinline <archiveLocation> <maxFileSize>");
+      return 1;
+   }
+
+   std::vector<char> buf(maxFileSize + 1);
+   for (bool inlined : {false, true}) {
+      PHYSFS_setInlineSmallFiles(inlined ? PHYSFS_uint32(maxFileSize) : 0, 64 * 1024 * 1024);
+
+      const auto start = std::chrono::steady_clock::now();
+      auto io = mountSimulated(archive, "benchinline", 0, simMedia);
+      if (not io)
+         break;
+
+      std::vector<std::string> files;
+      collectFiles("benchinline", files);
+
+      size_t count = 0;
+      PHYSFS_uint64 total = 0;
+      for (auto& path : files) {
+         PHYSFS_Stat st;
+         if (not PHYSFS_stat(path.c_str(), &st) or st.filesize > PHYSFS_sint64(maxFileSize))
+            continue;
+
+         auto f = PHYSFS_openRead(path.c_str());
+         if (not f)
+            continue;
+         const auto rc = PHYSFS_readBytes(f, buf.data(), buf.size());
+         if (rc > 0)
+            total += PHYSFS_uint64(rc);
+         PHYSFS_close(f);
+         ++count;
+      }
+
+      PHYSFS_SimulatedStats stats {};
+      PHYSFS_getSimulatedStats(io, &stats);
+      const auto end = std::chrono::steady_clock::now();
+      std::println("{:>8}: {} files, {} bytes in {:.1f} ms wall, {:.1f} ms busy, {} requests",
+         inlined ? "inlined" : "plain", count, total,
+         std::chrono::duration<double, std::milli>(end - start).count(),
+         stats.busyUs / 1000.0, stats.requests);
+      PHYSFS_unmount(archive);
+   }
+
+   PHYSFS_setInlineSmallFiles(0, 0);
+   return 1;
+}
+
+/// Mounts and unmounts an archive on the simulated media (see simmedia), and 
+/// reports what parsing its directory costs in time and device requests      
+static int cmd_benchmount(char* args) {
+   char archive[512];
+   int iterations = 0;
+   if (sscanf(args, "%511s %d", archive, &iterations) != 2 or iterations <= 0) {
+      std::println("usage: benchmount <archiveLocation> <iterations>");
+      return 1;
+   }
+
+   double totalMs = 0;
+   PHYSFS_uint64 requests = 0;
+   size_t entries = 0;
+   for (int i = 0; i < iterations; ++i) {
+      const auto start = std::chrono::steady_clock::now();
+      auto io = mountSimulated(archive, "benchmount", 0, simMedia);
+      if (not io)
+         return 1;
+      const auto end = std::chrono::steady_clock::now();
+      totalMs += std::chrono::duration<double, std::milli>(end - start).count();
+
+      PHYSFS_SimulatedStats stats {};
+      PHYSFS_getSimulatedStats(io, &stats);
+      requests += stats.requests;
+      if (i == 0) {
+         std::vector<std::string> files;
+         collectFiles("benchmount", files);
+         entries = files.size();
+      }
+      PHYSFS_unmount(archive);
+   }
+
+   std::println("{} entries: {:.2f} ms and {} device requests per mount",
+      entries, totalMs / iterations, requests / PHYSFS_uint64(iterations));
+   return 1;
+}
+
+/// Has (sessions) threads read every file in an archive (passes) times,      
+/// first all in the default context, then each in a context of its own that  
+/// mounts the archive again, the way independent sessions on a server would  
+static int cmd_benchcontexts(char* args) {
+   char archive[512];
+   int sessions = 0;
+   int passes = 0;
+   if (sscanf(args, "%511s %d %d", archive, &sessions, &passes) != 3 or sessions <= 0 or passes <= 0) {
+      std::println("usage: benchcontexts <archiveLocation> <sessions> <passes>");
+      return 1;
+   }
+
+   // Mounted in front, so that the default context finds it first      
+   if (not PHYSFS_mount(archive, "benchcontexts", 0)) {
+      std::println("Failure. Reason: [{}].", PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+      return 1;
+   }
+
+   std::vector<std::string> files;
+   collectFiles("benchcontexts", files);
+   const int symlinks = PHYSFS_symbolicLinksPermitted();
+
+   std::atomic<size_t> failures {0};
+   const auto readAll = [&] {
+      std::vector<char> buf(64 * 1024);
+      for (int p = 0; p < passes; ++p) {
+         for (auto& path : files) {
+            try {
+               auto f = PHYSFS_openRead(path.c_str());
+               if (not f) {
+                  ++failures;
+                  continue;
+               }
+               while (PHYSFS_readBytes(f, buf.data(), buf.size()) > 0);
+               PHYSFS_close(f);
+            }
+            catch (...) {
+               ++failures;
+            }
+         }
+      }
+   };
+
+   const auto run = [&](const char* what, bool ownContext) {
+      std::vector<std::thread> threads;
+      const auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < sessions; ++i) {
+         threads.emplace_back([&] {
+            if (not ownContext)
+               return readAll();
+
+            auto context = PHYSFS_createContext();
+            if (not context) {
+               ++failures;
+               return;
+            }
+
+            {
+               MetaPhysFS::ContextScope scope {context};
+               PHYSFS_permitSymbolicLinks(symlinks);
+               if (PHYSFS_mount(archive, "benchcontexts", 0))
+                  readAll();
+               else
+                  ++failures;
+            }
+            PHYSFS_destroyContext(context);
+         });
+      }
+      for (auto& t : threads)
+         t.join();
+
+      const auto end = std::chrono::steady_clock::now();
+      std::println("{:>8}: {:.2f} ms", what,
+         std::chrono::duration<double, std::milli>(end - start).count());
+   };
+
+   std::println("{} sessions, {} files, {} passes", sessions, files.size(), passes);
+   run("shared", false);
+   run("contexts", true);
+   if (failures)
+      std::println("{} reads failed.", failures.load());
+
+   PHYSFS_unmount(archive);
+   return 1;
+}
+
+/// Mounts one archive in (mounts) contexts, the way independent sessions     
+/// would, and tells what the first mount cost against every later one, which 
+/// should only point at the archive the first one parsed                     
+static int cmd_benchshare(char* args) {
+   char archive[512];
+   int mounts = 0;
+   if (sscanf(args, "%511s %d", archive, &mounts) != 2 or mounts <= 0) {
+      std::println("usage: benchshare <archiveLocation> <mounts>");
+      return 1;
+   }
+
+   const auto liveBytes = [] {
+      PHYSFS_AllocStats stats {};
+      PHYSFS_getAllocStats(PHYSFS_ALLOC_TAG_COUNT, &stats);
+      return stats.liveBytes;
+   };
+
+   std::vector<PHYSFS_Context*> contexts;
+   double firstMs = 0, laterMs = 0;
+   PHYSFS_uint64 firstBytes = 0, laterBytes = 0;
+   for (int i = 0; i < mounts; ++i) {
+      auto context = PHYSFS_createContext();
+      if (not context)
+         break;
+      contexts.push_back(context);
+
+      MetaPhysFS::ContextScope scope {context};
+      const auto before = liveBytes();
+      const auto start = std::chrono::steady_clock::now();
+      if (not PHYSFS_mount(archive, "benchshare", 0)) {
+         std::println("Failure. Reason: [{}].", PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+         break;
+      }
+      const auto end = std::chrono::steady_clock::now();
+      const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+      const auto bytes = liveBytes() - before;
+      (i ? laterMs : firstMs) += ms;
+      (i ? laterBytes : firstBytes) += bytes;
+   }
+
+   std::println("first mount: {:.3f} ms, {} bytes", firstMs, firstBytes);
+   if (contexts.size() > 1) {
+      const auto later = contexts.size() - 1;
+      std::println("later mounts: {:.3f} ms, {} bytes each",
+         laterMs / later, laterBytes / later);
+   }
+
+   for (auto context : contexts) {
+      {
+         MetaPhysFS::ContextScope scope {context};
+         try { PHYSFS_unmount(archive); }
+         catch (...) {}
+      }
+      PHYSFS_destroyContext(context);
+   }
+   return 1;
+}
+
+/// Reads an encrypted (entry) of a ZIP archive end to end, a few times, and  
+/// tells what opening it with (password) cost, and how fast it decrypts -    
+/// for AES entries, that includes checking the authentication code           
+static int cmd_benchdecrypt(char* args) {
+   char archive[512], entry[512], password[256];
+   if (sscanf(args, "%511s %511s %255s", archive, entry, password) != 3) {
+      std::println("usage: benchdecrypt <archiveLocation> <entry> <password>");
+      return 1;
+   }
+
+   if (not PHYSFS_mount(archive, "benchdecrypt", 0)) {
+      std::println("Failure. Reason: [{}].", PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+      return 1;
+   }
+
+   const auto path = std::string("benchdecrypt/") + entry + "$" + password;
+   std::vector<char> buf(256 * 1024);
+   for (int pass = 0; pass < 3; ++pass) {
+      const auto start = std::chrono::steady_clock::now();
+      PHYSFS_File* f = nullptr;
+      try { f = PHYSFS_openRead(path.c_str()); }
+      catch (...) {}
+      if (not f) {
+         std::println("Couldn't open [{}]: {}.", entry,
+            PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+         break;
+      }
+      const auto opened = std::chrono::steady_clock::now();
+
+      PHYSFS_uint64 total = 0;
+      PHYSFS_sint64 rc = 0;
+      try {
+         while ((rc = PHYSFS_readBytes(f, buf.data(), buf.size())) > 0)
+            total += PHYSFS_uint64(rc);
+      }
+      catch (...) { rc = -1; }
+      PHYSFS_close(f);
+      const auto end = std::chrono::steady_clock::now();
+
+      const auto openMs = std::chrono::duration<double, std::milli>(opened - start).count();
+      const auto secs = std::chrono::duration<double>(end - opened).count();
+      std::println("pass {}: open {:.3f} ms, {} bytes in {:.3f} s, {:.1f} MiB/s{}",
+         pass, openMs, total, secs, total / secs / (1024.0 * 1024.0),
+         rc < 0 ? " (read failed)" : "");
+   }
+
+   PHYSFS_unmount(archive);
+   return 1;
+}
+
+/// Stats every file under (dir) one call at a time, the way a loader would   
+/// without statMany, then all at once, and sums up the layout it got         
+static int cmd_benchstat(char* args) {
+   if (*args == '\"') {
+      args++;
+      args[strlen(args) - 1] = '\0';
+   }
+
+   std::vector<std::string> files;
+   collectFiles(args, files);
+   if (files.empty()) {
+      std::println("no files under {}.", args);
+      return 1;
+   }
+
+   std::vector<const char*> names;
+   for (auto& f : files)
+      names.push_back(f.c_str());
+
+   const auto start = std::chrono::steady_clock::now();
+   size_t found = 0;
+   for (auto name : names) {
+      PHYSFS_Stat st;
+      if (PHYSFS_stat(name, &st) and PHYSFS_getRealDir(name))
+         ++found;
+   }
+   const auto middle = std::chrono::steady_clock::now();
+   std::vector<PHYSFS_StatEx> stats(names.size());
+   const auto foundMany = PHYSFS_statMany(names.data(), PHYSFS_uint32(names.size()), stats.data());
+   const auto end = std::chrono::steady_clock::now();
+
+   size_t mappable = 0, contiguous = 0;
+   PHYSFS_uint64 stored = 0, size = 0;
+   for (auto& st : stats) {
+      if (not st.archive)
+         continue;
+      mappable += st.mappable ? 1 : 0;
+      contiguous += st.contiguous ? 1 : 0;
+      stored += st.storedSize > 0 ? PHYSFS_uint64(st.storedSize) : 0;
+      size += PHYSFS_uint64(st.stat.filesize);
+   }
+
+   const auto us = [&](auto from, auto to) {
+      return std::chrono::duration<double, std::micro>(to - from).count() / double(names.size());
+   };
+   std::println("{} files: stat+getRealDir {:.2f} us each ({} found), statMany {:.2f} us each ({} found)",
+      names.size(), us(start, middle), found, us(middle, end), foundMany);
+   std::println("{} contiguous, {} mappable, {} bytes stored for {} bytes of data",
+      contiguous, mappable, stored, size);
+   return 1;
+}
+
+#if defined(__linux__)
+/// Fraction of a native file's pages that are in the page cache              
+static double residentFraction(const std::string& path) {
+   const int fd = open(path.c_str(), O_RDONLY);
+   if (fd < 0)
+      return -1;
+
+   struct stat st;
+   double retval = -1;
+   if (fstat(fd, &st) == 0 and st.st_size > 0) {
+      const auto page = size_t(sysconf(_SC_PAGESIZE));
+      const auto pages = (size_t(st.st_size) + page - 1) / page;
+      void* map = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+      if (map != MAP_FAILED) {
+         std::vector<unsigned char> resident(pages);
+         if (mincore(map, size_t(st.st_size), resident.data()) == 0) {
+            size_t count = 0;
+            for (auto r : resident)
+               count += r & 1;
+            retval = double(count) / double(pages);
+         }
+         munmap(map, size_t(st.st_size));
+      }
+   }
+
+   close(fd);
+   return retval;
+}
+
+static PHYSFS_uint64 readThrough(PHYSFS_File* f) {
+   std::vector<char> buf(1024 * 1024);
+   PHYSFS_uint64 total = 0;
+   PHYSFS_sint64 rc;
+   while ((rc = PHYSFS_readBytes(f, buf.data(), buf.size())) > 0)
+      total += PHYSFS_uint64(rc);
+   return total;
+}
+
+static int cmd_benchdirectio(char* args) {
+   auto streamed = strchr(args, ' ');
+   if (not streamed) {
+      std::println("usage: benchdirectio <workingSetFile> <streamedFile>");
+      return 1;
+   }
+   *streamed++ = '\0';
+   const char* workingSet = args;
+
+   // Both have to come from plain directories, for mincore() to see them
+   std::string paths[2];
+   const char* names[2] = {workingSet, streamed};
+   for (int i = 0; i < 2; ++i) {
+      const char* dir = PHYSFS_getRealDir(names[i]);
+      if (not dir) {
+         std::println("Couldn't find [{}].", names[i]);
+         return 1;
+      }
+      paths[i] = std::string(dir) + PHYSFS_getDirSeparator() + names[i];
+   }
+
+   // The streamed file should be larger than free memory, to make the  
+   // kernel choose what to evict                                       
+   for (bool direct : {false, true}) {
+      auto ws = PHYSFS_openRead(workingSet);
+      if (not ws) {
+         std::println("Couldn't open [{}].", workingSet);
+         return 1;
+      }
+      readThrough(ws);
+      PHYSFS_close(ws);
+
+      const int fd = open(paths[1].c_str(), O_RDONLY);
+      if (fd >= 0) {
+         posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+         close(fd);
+      }
+      const double before = residentFraction(paths[0]);
+
+      const auto start = std::chrono::steady_clock::now();
+      auto f = direct ? PHYSFS_openReadDirect(streamed) : PHYSFS_openRead(streamed);
+      if (not f) {
+         std::println("Couldn't open [{}].", streamed);
+         return 1;
+      }
+      const auto total = readThrough(f);
+      PHYSFS_close(f);
+      const auto end = std::chrono::steady_clock::now();
+
+      const auto secs = std::chrono::duration<double>(end - start).count();
+      std::println("{:>6}: {} bytes in {:.3f} s ({:.1f} MiB/s), working set "
+         "{:.1f}% -> {:.1f}% resident, streamed file {:.1f}% resident",
+         direct ? "direct" : "cached", total, secs,
+         total / secs / (1024.0 * 1024.0), before * 100,
+         residentFraction(paths[0]) * 100, residentFraction(paths[1]) * 100);
+   }
+   return 1;
+}
+#endif
+
+/// Lays out a GRP (Build engine groupfile) in memory: the signature, the     
+/// file count, 12-byte names and sizes, then the data in the same order      
+static std::string makeGrp(const std::vector<std::pair<std::string, std::string>>& files) {
+   std::string grp = "KenSilverman";
+   auto put32 = [&grp](PHYSFS_uint32 v) {
+      for (int i = 0; i < 4; ++i)
+         grp += char((v >> (i * 8)) & 0xFF);
+   };
+
+   put32(PHYSFS_uint32(files.size()));
+   for (auto& [name, data] : files) {
+      grp += name;
+      grp.append(12 - name.size(), ' ');
+      put32(PHYSFS_uint32(data.size()));
+   }
+   for (auto& file : files)
+      grp += file.second;
+   return grp;
+}
+
+/// Writes a groupfile holding a groupfile to (scratchDir), mounts the inner  
+/// one through PHYSFS_mount by its nested path, and reads a file out of it   
+static int cmd_checknested(char* args) {
+   if (*args == '\"') {
+      args++;
+      args[strlen(args) - 1] = '\0';
+   }
+
+   const std::string contents = "inside an archive inside an archive";
+   const auto inner = makeGrp({{"DATA.TXT", contents}});
+   const auto outer = makeGrp({{"README.TXT", "not an archive"}, {"INNER.GRP", inner}});
+
+   const std::string sep = PHYSFS_getDirSeparator();
+   const auto outerPath = std::string(args) + sep + "checknested.grp";
+   const auto nested = outerPath + sep + "INNER.GRP";
+   auto file = fopen(outerPath.c_str(), "wb");
+   if (not file or fwrite(outer.data(), 1, outer.size(), file) != outer.size()) {
+      std::println("Couldn't write [{}].", outerPath);
+      if (file)
+         fclose(file);
+      return 1;
+   }
+   fclose(file);
+
+   bool ok = false;
+   try {
+      if (not PHYSFS_mount(nested.c_str(), "checknested", 1))
+         std::println("Couldn't mount [{}]: {}.", nested, PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+      else {
+         std::string got;
+         if (auto f = PHYSFS_openRead("checknested/DATA.TXT")) {
+            got.resize(contents.size() + 1);
+            const auto rc = PHYSFS_readBytes(f, got.data(), got.size());
+            got.resize(rc > 0 ? size_t(rc) : 0);
+            PHYSFS_close(f);
+         }
+         ok = got == contents;
+         if (not ok)
+            std::println("DATA.TXT read through [{}] came back as [{}].", nested, got);
+         PHYSFS_unmount(nested.c_str());
+      }
+   }
+   catch (...) {
+      std::println("Mounting [{}] threw.", nested);
+   }
+
+   remove(outerPath.c_str());
+   if (ok)
+      std::println("Successful.");
+   return 1;
+}
+
+/// Mounts groupfiles from memory whose listings overlap, plus one under a    
+/// mount point below the others, and checks that enumerating them gives one  
+/// strcmp-sorted listing, with every name once                               
+static int cmd_checkmergedlisting(char*) {
+   const std::vector<std::pair<std::string, std::vector<std::pair<std::string, std::string>>>> grps {
+      {"checkmergedlisting-a.grp", {{"DELTA.TXT", "a"}, {"BETA.TXT", "a"}, {"ALPHA.TXT", "a"}}},
+      {"checkmergedlisting-b.grp", {{"ECHO.TXT", "b"}, {"BETA.TXT", "b"}, {"CHARLIE.TXT", "b"}}},
+      {"checkmergedlisting-c.grp", {{"FOXTROT.TXT", "c"}, {"ALPHA.TXT", "c"}, {"ECHO.TXT", "c"}}},
+   };
+   const std::vector<std::string> expected {
+      "ALPHA.TXT", "BETA.TXT", "CHARLIE.TXT", "DELTA.TXT", "ECHO.TXT", "FOXTROT.TXT", "GOLF"
+   };
+
+   // The data has to outlive the mounts                                
+   std::vector<std::string> images;
+   for (const auto& grp : grps)
+      images.push_back(makeGrp(grp.second));
+   images.push_back(makeGrp({{"HOTEL.TXT", "d"}}));
+
+   const int failedBefore = failed_checks;
+   std::vector<std::string> mounted;
+   for (size_t i = 0; i < images.size(); ++i) {
+      const bool golf = i == grps.size();
+      const auto name = golf ? std::string("checkmergedlisting-d.grp") : grps[i].first;
+      const auto point = golf ? "checkmergedlisting/GOLF" : "checkmergedlisting";
+      if (check(PHYSFS_mountMemory(images[i].data(), images[i].size(), nullptr, name.c_str(), point, 1), "mount " + name))
+         mounted.push_back(name);
+   }
+
+   if (mounted.size() == images.size()) {
+      std::vector<std::string> got;
+      if (auto list = PHYSFS_enumerateFiles("checkmergedlisting")) {
+         for (auto i = list; *i; ++i)
+            got.emplace_back(*i);
+         PHYSFS_freeList(list);
+      }
+
+      std::string gotText;
+      for (const auto& name : got)
+         gotText += (gotText.empty() ? "" : " ") + name;
+      check(got == expected, "merged listing came back as [" + gotText + "]");
+
+      // Whichever mount comes first in the search path wins           
+      std::string alpha;
+      if (auto f = PHYSFS_openRead("checkmergedlisting/ALPHA.TXT")) {
+         alpha.resize(1);
+         alpha.resize(PHYSFS_readBytes(f, alpha.data(), 1) == 1 ? 1 : 0);
+         PHYSFS_close(f);
+      }
+      check(alpha == "a", "ALPHA.TXT is read from the first mount, got [" + alpha + "]");
+   }
+
+   for (const auto& name : mounted)
+      PHYSFS_unmount(name.c_str());
+   if (failed_checks == failedBefore)
+      std::println("Successful.");
+   return 1;
+}
+
+/// Lays out a Quake PAK in memory: the header, the data, then 64-byte        
+/// directory records (56-byte names, position and size) in the same order    
+static std::string makePak(const std::vector<std::pair<std::string, std::string>>& files) {
+   std::string pak = "PACK";
+   auto put32 = [](std::string& out, PHYSFS_uint32 v) {
+      for (int i = 0; i < 4; ++i)
+         out += char((v >> (i * 8)) & 0xFF);
+   };
+
+   std::string data, table;
+   for (auto& [name, contents] : files) {
+      table += name;
+      table.append(56 - name.size(), '\0');
+      put32(table, PHYSFS_uint32(12 + data.size()));
+      put32(table, PHYSFS_uint32(contents.size()));
+      data += contents;
+   }
+
+   put32(pak, PHYSFS_uint32(12 + data.size()));
+   put32(pak, PHYSFS_uint32(table.size()));
+   return pak + data + table;
+}
+
+/// Mounts a PAK whose entries hop between directories, so that the same     
+/// parents are looked up over and over (and moved to the front of their     
+/// hash chains) while the tree is still being built, and with enough names   
+/// that the tree's blocks and hash grow several times. Then every path is    
+/// looked up again in the finalized tree, and read back                      
+static int cmd_checkdirtree(char*) {
+   std::vector<std::pair<std::string, std::string>> files;
+   for (int i = 0; i < 400; ++i) {
+      const auto path = std::format("dir{:02}/sub{}/file{:03}.txt", i % 23, i % 3, i);
+      files.emplace_back(path, path);
+   }
+
+   // Same leaf in different dirs, and names that differ only in case   
+   files.emplace_back("dir00/same.txt", "dir00");
+   files.emplace_back("dir01/same.txt", "dir01");
+   files.emplace_back("dir02/Case.txt", "upper");
+   files.emplace_back("dir02/case.txt", "lower");
+
+   const auto image = makePak(files);
+   const int failedBefore = failed_checks;
+   if (check(PHYSFS_mountMemory(image.data(), image.size(), nullptr, "checkdirtree.pak", "checkdirtree", 1), "mount checkdirtree.pak")) {
+      for (const auto& [path, contents] : files) {
+         const auto full = "checkdirtree/" + path;
+         std::string got;
+         if (auto f = PHYSFS_openRead(full.c_str())) {
+            got.resize(contents.size() + 1);
+            const auto rc = PHYSFS_readBytes(f, got.data(), got.size());
+            got.resize(rc > 0 ? size_t(rc) : 0);
+            PHYSFS_close(f);
+         }
+         if (not check(got == contents, full + " came back as [" + got + "]"))
+            break;
+      }
+
+      PHYSFS_Stat st;
+      check(PHYSFS_stat("checkdirtree/dir22/sub1", &st) and st.filetype == PHYSFS_FILETYPE_DIRECTORY,
+         "dir22/sub1 is a directory");
+      check(not PHYSFS_exists("checkdirtree/dir23"), "dir23 doesn't exist");
+      check(not PHYSFS_exists("checkdirtree/dir00/sub0/file000.txt/more"), "a file has no kids");
+
+      size_t count = 0;
+      bool sorted = true;
+      if (auto list = PHYSFS_enumerateFiles("checkdirtree/dir02")) {
+         for (auto i = list; *i; ++i, ++count)
+            sorted = sorted and (i == list or strcmp(i[-1], *i) < 0);
+         PHYSFS_freeList(list);
+      }
+      check(count == 5 and sorted, std::format("dir02 should list 5 sorted names, got {}", count));
+      PHYSFS_unmount("checkdirtree.pak");
+   }
+
+   if (failed_checks == failedBefore)
+      std::println("Successful.");
+   return 1;
+}
+
+/// Writes a PAK to (scratchDir), mounts it from there, and reads its entries  
+/// with PHYSFS_openReadDirect, which goes through a window onto the archive  
+/// file for each. A regular open of the same archive, kept open across it,   
+/// has to be unaffected                                                      
+static int cmd_checkdirectentry(char* args) {
+   if (*args == '\"') {
+      args++;
+      args[strlen(args) - 1] = '\0';
+   }
+
+   std::vector<std::pair<std::string, std::string>> files;
+   for (int i = 0; i < 4; ++i)
+      files.emplace_back(std::format("stream/part{}.bin", i), std::string(5000 + i * 777, char('a' + i)));
+
+   const auto image = makePak(files);
+   const auto path = std::string(args) + PHYSFS_getDirSeparator() + "checkdirectentry.pak";
+   auto file = fopen(path.c_str(), "wb");
+   if (not file or fwrite(image.data(), 1, image.size(), file) != image.size()) {
+      std::println("Couldn't write [{}].", path);
+      if (file)
+         fclose(file);
+      return 1;
+   }
+   fclose(file);
+
+   const int failedBefore = failed_checks;
+   if (check(PHYSFS_mount(path.c_str(), "checkdirectentry", 1), "mount " + path)) {
+      auto regular = PHYSFS_openRead("checkdirectentry/stream/part0.bin");
+      check(regular != nullptr, "open part0.bin the usual way");
+
+      for (const auto& [name, contents] : files) {
+         const auto full = "checkdirectentry/" + name;
+         auto f = PHYSFS_openReadDirect(full.c_str());
+         if (not check(f != nullptr, "open " + full + " direct"))
+            continue;
+
+         std::string got(contents.size() + 1, '\0');
+         const auto rc = PHYSFS_readBytes(f, got.data(), got.size());
+         got.resize(rc > 0 ? size_t(rc) : 0);
+         check(got == contents, std::format("{} read {} of {} bytes back", full, got.size(), contents.size()));
+         check(PHYSFS_fileLength(f) == PHYSFS_sint64(contents.size()), full + " has the entry's length");
+
+         char ch = 0;
+         check(PHYSFS_seek(f, 100) and PHYSFS_readBytes(f, &ch, 1) == 1 and ch == contents[100],
+            full + " seeks within the entry");
+         PHYSFS_close(f);
+      }
+
+      if (regular) {
+         std::string got(files[0].second.size(), '\0');
+         const auto rc = PHYSFS_readBytes(regular, got.data(), got.size());
+         check(rc == PHYSFS_sint64(got.size()) and got == files[0].second, "part0.bin still reads the usual way");
+         PHYSFS_close(regular);
+      }
+      PHYSFS_unmount(path.c_str());
+   }
+
+   remove(path.c_str());
+   if (failed_checks == failedBefore)
+      std::println("Successful.");
+   return 1;
+}
+
+static int cmd_writepack(char* args) {
+   char dir[512], pack[512];
+   int compress = 0;
+   if (sscanf(args, "%511s %511s %d", dir, pack, &compress) != 3) {
+      std::println("usage: writepack <dirToPack> <packToWrite> <compress>");
+      return 1;
+   }
+
+   PHYSFS_PackOptions opts {};
+   opts.compress = compress;
+   opts.verify = 1;
+
+   const auto start = std::chrono::steady_clock::now();
+   if (not PHYSFS_writePack(dir, pack, &opts)) {
+      std::println("Failed to write pack. Reason: [{}].",
+         PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+      return 1;
+   }
+
+   const auto took = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+   std::println("Successful, in {:.1f} ms.", took);
+   return 1;
+}
+
+/// Sets a .mpl that isn't there yet as the write dir, overwrites one file    
+/// in it until the log compacts, and reads the last version back. Then fails 
+/// a setWriteDir, and makes sure another thread can still take stateLock     
+static int cmd_checknewlog(char* args) {
+   if (*args == '\"') {
+      args++;
+      args[strlen(args) - 1] = '\0';
+   }
+
+   const std::string sep = PHYSFS_getDirSeparator();
+   const auto log = std::string(args) + sep + "checknewlog.mpl";
+   const auto unreachable = std::string(args) + sep + "checknewlog_missing" + sep + "new.mpl";
+   remove(log.c_str());
+
+   // Each version is a whole write buffer, so it goes out as one       
+   // record, and 96 of them leave well over the 4 MiB of dead data     
+   // that starts a compaction                                          
+   constexpr int versions = 96;
+   std::string contents(64 * 1024, '\0');
+   bool ok = false;
+   try {
+      if (not PHYSFS_setWriteDir(log.c_str()))
+         std::println("Couldn't start a new log [{}]: {}.", log, PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+      else {
+         ok = true;
+         for (int v = 0; ok and v < versions; ++v) {
+            for (size_t i = 0; i < contents.size(); ++i)
+               contents[i] = char('a' + (i + v) % 26);
+            auto f = PHYSFS_openWrite("data.txt");
+            ok = f and PHYSFS_writeBytes(f, contents.data(), contents.size()) == PHYSFS_sint64(contents.size());
+            if (f)
+               ok = PHYSFS_close(f) and ok;
+         }
+         if (not ok)
+            std::println("Couldn't write data.txt to [{}].", log);
+
+         // Joins the compaction, if it's still going                   
+         PHYSFS_setWriteDir(nullptr);
+      }
+   }
+   catch (...) {
+      std::println("Starting a new log [{}] threw.", log);
+      ok = false;
+   }
+
+   if (ok) {
+      long onDisk = -1;
+      if (auto file = fopen(log.c_str(), "rb")) {
+         if (fseek(file, 0, SEEK_END) == 0)
+            onDisk = ftell(file);
+         fclose(file);
+      }
+      ok = onDisk >= 0 and onDisk < long(contents.size()) * versions / 2;
+      if (not ok)
+         std::println("[{}] is {} bytes after {} versions of data.txt, so it wasn't compacted.", log, onDisk, versions);
+   }
+
+   if (ok) {
+      std::string got;
+      try {
+         if (PHYSFS_mount(log.c_str(), "checknewlog", 1)) {
+            if (auto f = PHYSFS_openRead("checknewlog/data.txt")) {
+               got.resize(contents.size() + 1);
+               const auto rc = PHYSFS_readBytes(f, got.data(), got.size());
+               got.resize(rc > 0 ? size_t(rc) : 0);
+               PHYSFS_close(f);
+            }
+            PHYSFS_unmount(log.c_str());
+         }
+      }
+      catch (...) {}
+      ok = got == contents;
+      if (not ok)
+         std::println("The last version of data.txt didn't come back from [{}].", log);
+   }
+
+   bool set;
+   try { set = PHYSFS_setWriteDir(unreachable.c_str()); }
+   catch (...) { set = false; }
+   if (set) {
+      std::println("[{}] shouldn't be usable as a write dir.", unreachable);
+      PHYSFS_setWriteDir(nullptr);
+      ok = false;
+   }
+
+   // stateLock is recursive, so only another thread can tell if it was 
+   // left held                                                         
+   std::atomic<bool> done {false};
+   std::thread other {[&] {
+      try { PHYSFS_setWriteDir(nullptr); }
+      catch (...) {}
+      done = true;
+   }};
+   for (int waited = 0; not done and waited < 500; ++waited)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+   if (done)
+      other.join();
+   else {
+      std::println("stateLock was left held after a failed setWriteDir.");
+      other.detach();
+      ok = false;
+   }
+
+   remove(log.c_str());
+   if (ok)
+      std::println("Successful.");
+   return 1;
+}
+
+/// Run it against a plain directory and a .mpl pack as the write dir         
+static int cmd_benchwrites(char* args) {
+   int count = 0, size = 0;
+   if (sscanf(args, "%d %d", &count, &size) != 2 or count <= 0 or size < 0) {
+      std::println("usage: benchwrites <fileCount> <fileSize>");
+      return 1;
+   }
+
+   std::vector<char> data(size_t(size), 'x');
+   const auto start = std::chrono::steady_clock::now();
+   for (int i = 0; i < count; ++i) {
+      const auto name = "benchwrites_" + std::to_string(i);
+      auto f = PHYSFS_openWrite(name.c_str());
+      if (not f or PHYSFS_writeBytes(f, data.data(), data.size()) != size or not PHYSFS_close(f)) {
+         std::println("Failed to write [{}]. Reason: [{}].", name,
+            PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+         return 1;
+      }
+   }
+   const auto end = std::chrono::steady_clock::now();
+
+   const auto us = std::chrono::duration<double, std::micro>(end - start).count();
+   std::println("{} files of {} bytes in {:.1f} ms, {:.1f} us per file.",
+      count, size, us / 1000.0, us / count);
+
+   for (int i = 0; i < count; ++i)
+      PHYSFS_delete(("benchwrites_" + std::to_string(i)).c_str());
+   return 1;
+}
+
+static int cmd_benchcommit(char* args) {
+   int count = 0, size = 0, workers = 0;
+   if (sscanf(args, "%d %d %d", &count, &size, &workers) != 3 or count <= 0 or size < 0 or workers <= 0) {
+      std::println("usage: benchcommit <fileCount> <fileSize> <threads>");
+      return 1;
+   }
+
+   std::vector<char> data(size_t(size), 'x');
+   const auto nameOf = [](int i) {
+      return "benchcommit_" + std::to_string(i);
+   };
+
+   // Baseline: every file is synced on its own close                   
+   auto start = std::chrono::steady_clock::now();
+   for (int i = 0; i < count; ++i) {
+      auto f = PHYSFS_openWrite(nameOf(i).c_str());
+      if (not f or PHYSFS_writeBytes(f, data.data(), data.size()) != size or not PHYSFS_close(f)) {
+         std::println("Failed to write [{}]. Reason: [{}].", nameOf(i),
+            PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+         return 1;
+      }
+   }
+   auto end = std::chrono::steady_clock::now();
+   const auto plain = std::chrono::duration<double, std::milli>(end - start).count();
+
+   // Every worker commits its own interleaved share as one transaction,
+   // so concurrent commits get grouped behind a single sync            
+   std::vector<std::thread> threads;
+   std::vector<int> failed(static_cast<size_t>(workers));
+   start = std::chrono::steady_clock::now();
+   for (int w = 0; w < workers; ++w) {
+      threads.emplace_back([&, w] {
+         try {
+            auto txn = PHYSFS_beginTransaction();
+            if (not txn) {
+               failed[w] = 1;
+               return;
+            }
+
+            for (int i = w; i < count; i += workers) {
+               auto f = PHYSFS_openWriteTransacted(txn, nameOf(i).c_str());
+               if (not f or PHYSFS_writeBytes(f, data.data(), data.size()) != size)
+                  failed[w] = 1;
+               if (f)
+                  PHYSFS_close(f);
+            }
+
+            if (failed[w])
+               PHYSFS_abortTransaction(txn);
+            else if (not PHYSFS_commitTransaction(txn))
+               failed[w] = 1;
+         }
+         catch (...) {
+            failed[w] = 1;
+         }
+      });
+   }
+
+   for (auto& t : threads)
+      t.join();
+   end = std::chrono::steady_clock::now();
+   const auto grouped = std::chrono::duration<double, std::milli>(end - start).count();
+
+   for (int i = 0; i < count; ++i)
+      PHYSFS_delete(nameOf(i).c_str());
+
+   for (auto f : failed) {
+      if (f) {
+         std::println("A transaction failed. Is the write dir a directory?");
+         return 1;
+      }
+   }
+
+   std::println("{} files of {} bytes:", count, size);
+   std::println("   synced per file:   {:.1f} ms, {:.1f} us per file",
+      plain, plain * 1000.0 / count);
+   std::println("   {} transaction(s): {:.1f} ms, {:.1f} us per file",
+      workers, grouped, grouped * 1000.0 / count);
+   return 1;
+}
+
+/// A transaction where one file fails to open still commits the others.     
+/// Symlinks are permitted for the duration, so that the path isn't checked   
+/// up front, and the temporary's creation is what fails                      
+static int cmd_checktxnfail(char* args) {
+   if (*args == '\"') {
+      args++;
+      args[strlen(args) - 1] = '\0';
+   }
+
+   const char* names[] = {"checktxnfail_a.txt", "checktxnfail_b.txt"};
+   const char* unopenable = "checktxnfail_missing/file.txt";
+
+   const std::string previous = PHYSFS_getWriteDir() ? PHYSFS_getWriteDir() : "";
+   if (not PHYSFS_setWriteDir(args) or not PHYSFS_mount(args, "/", 1)) {
+      std::println("Couldn't write to and mount [{}]: {}.", args, PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+      PHYSFS_setWriteDir(previous.empty() ? nullptr : previous.c_str());
+      return 1;
+   }
+   const int symlinks = PHYSFS_symbolicLinksPermitted();
+   PHYSFS_permitSymbolicLinks(1);
+
+   const auto write = [](PHYSFS_Transaction* txn, const char* name) {
+      try {
+         auto file = PHYSFS_openWriteTransacted(txn, name);
+         const auto len = PHYSFS_sint64(strlen(name));
+         return file and PHYSFS_writeBytes(file, name, PHYSFS_uint64(len)) == len
+            and PHYSFS_close(file);
+      }
+      catch (...) {
+         return false;
+      }
+   };
+
+   bool ok = false;
+   try {
+      if (auto txn = PHYSFS_beginTransaction()) {
+         ok = write(txn, names[0]);
+         if (write(txn, unopenable)) {
+            std::println("[{}] shouldn't have opened.", unopenable);
+            ok = false;
+         }
+         ok = write(txn, names[1]) and ok;
+         if (not PHYSFS_commitTransaction(txn)) {
+            std::println("The commit failed: {}.", PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+            ok = false;
+         }
+      }
+      else std::println("Couldn't begin a transaction.");
+   }
+   catch (...) {
+      std::println("The transaction threw.");
+      ok = false;
+   }
+
+   for (auto name : names) {
+      std::string got;
+      if (auto f = PHYSFS_openRead(name)) {
+         got.resize(strlen(name) + 1);
+         const auto rc = PHYSFS_readBytes(f, got.data(), got.size());
+         got.resize(rc > 0 ? size_t(rc) : 0);
+         PHYSFS_close(f);
+      }
+      if (got != name) {
+         std::println("[{}] doesn't hold what was committed.", name);
+         ok = false;
+      }
+      PHYSFS_delete(name);
+   }
+
+   auto list = PHYSFS_enumerateFiles("/");
+   for (auto i = list; list and *i; ++i) {
+      if (strstr(*i, ".~txn")) {
+         std::println("The temporary [{}] was left in [{}].", *i, args);
+         ok = false;
+      }
+   }
+   PHYSFS_freeList(list);
+
+   PHYSFS_permitSymbolicLinks(symlinks);
+   PHYSFS_unmount(args);
+   PHYSFS_setWriteDir(previous.empty() ? nullptr : previous.c_str());
+   if (ok)
+      std::println("Successful.");
+   return 1;
+}
+
+/// Two contexts commit transactions at the same time, first each to a write  
+/// dir of its own, then both to (writeDir1). Every file has to end up in its 
+/// context's directory, holding what its last commit wrote, with no         
+/// temporaries left behind                                                  
+static int cmd_checkcommitcontexts(char* args) {
+   char dirs[2][512];
+   if (sscanf(args, "%511s %511s", dirs[0], dirs[1]) != 2) {
+      std::println("usage: checkcommitcontexts <writeDir1> <writeDir2>");
+      return 1;
+   }
+
+   constexpr int Rounds = 50;
+   constexpr int Files = 4;
+   const auto nameOf = [](int c, int f) {
+      return "checkcommit_" + std::to_string(c) + "_" + std::to_string(f);
+   };
+   const auto contentsOf = [](int c, int r, int f) {
+      return "context " + std::to_string(c) + ", round " + std::to_string(r)
+         + ", file " + std::to_string(f);
+   };
+
+   const int failedBefore = failed_checks;
+   const auto run = [&](const char* dirOf[2]) {
+      PHYSFS_Context* contexts[2] {};
+      for (int c = 0; c < 2; ++c) {
+         contexts[c] = PHYSFS_createContext();
+         MetaPhysFS::ContextScope scope {contexts[c]};
+         if (not check(contexts[c] and PHYSFS_setWriteDir(dirOf[c]) and PHYSFS_mount(dirOf[c], "/", 1),
+               std::format("set up a context on [{}]", dirOf[c]))) {
+            for (auto context : contexts) {
+               if (context)
+                  PHYSFS_destroyContext(context);
+            }
+            return;
+         }
+      }
+
+      std::atomic<int> failedCommits {0};
+      std::vector<std::thread> threads;
+      for (int c = 0; c < 2; ++c) {
+         threads.emplace_back([&, c] {
+            MetaPhysFS::ContextScope scope {contexts[c]};
+            for (int r = 0; r < Rounds; ++r) {
+               try {
+                  auto txn = PHYSFS_beginTransaction();
+                  bool ok = txn != nullptr;
+                  for (int f = 0; ok and f < Files; ++f) {
+                     const auto data = contentsOf(c, r, f);
+                     auto file = PHYSFS_openWriteTransacted(txn, nameOf(c, f).c_str());
+                     ok = file and PHYSFS_writeBytes(file, data.data(), data.size()) == PHYSFS_sint64(data.size());
+                     if (file)
+                        ok = PHYSFS_close(file) and ok;
+                  }
+
+                  if (txn and not ok)
+                     PHYSFS_abortTransaction(txn);
+                  if (not ok or not PHYSFS_commitTransaction(txn))
+                     ++failedCommits;
+               }
+               catch (...) {
+                  ++failedCommits;
+               }
+            }
+         });
+      }
+      for (auto& t : threads)
+         t.join();
+
+      check(failedCommits == 0, std::format("{} commits failed", failedCommits.load()));
+      for (int c = 0; c < 2; ++c) {
+         MetaPhysFS::ContextScope scope {contexts[c]};
+         for (int f = 0; f < Files; ++f) {
+            std::string contents;
+            check(readWhole(nameOf(c, f).c_str(), contents) and contents == contentsOf(c, Rounds - 1, f),
+               std::format("[{}] in [{}] holds the last commit", nameOf(c, f), dirOf[c]));
+         }
+
+         auto list = PHYSFS_enumerateFiles("/");
+         for (auto i = list; list and *i; ++i)
+            check(not strstr(*i, ".~txn"), std::format("no temporary [{}] left in [{}]", *i, dirOf[c]));
+         PHYSFS_freeList(list);
+      }
+
+      for (int c = 0; c < 2; ++c) {
+         MetaPhysFS::ContextScope scope {contexts[c]};
+         for (int f = 0; f < Files; ++f)
+            PHYSFS_delete(nameOf(c, f).c_str());
+      }
+
+      for (auto context : contexts)
+         PHYSFS_destroyContext(context);
+   };
+
+   // Separate directories get groups of their own, while two contexts 
+   // naming the same directory share them, and its commit record       
+   const char* separate[2] {dirs[0], dirs[1]};
+   const char* same[2] {dirs[0], dirs[0]};
+   run(separate);
+   run(same);
+
+   if (failed_checks == failedBefore)
+      std::println("Successful.");
+   return 1;
+}
+
+/// A version 0 io over a buffer, so it has no readAt of its own, and its     
+/// duplicates start failing once (failDuplicates) is set                     
+namespace
+{
+   std::atomic<bool> failDuplicates {false};
+
+   struct BufferIo {
+      std::string data;
+      PHYSFS_uint64 pos = 0;
+   };
+
+   PHYSFS_Io* createBufferIo(const std::string& data) {
+      static const PHYSFS_Io funcs {
+         0, nullptr,
+         [](PHYSFS_Io* io, void* buf, PHYSFS_uint64 len) -> PHYSFS_sint64 {
+            auto b = static_cast<BufferIo*>(io->opaque);
+            const auto left = b->data.size() - b->pos;
+            len = len < left ? len : left;
+            memcpy(buf, b->data.data() + b->pos, size_t(len));
+            b->pos += len;
+            return PHYSFS_sint64(len);
+         },
+         [](PHYSFS_Io*, const void*, PHYSFS_uint64) -> PHYSFS_sint64 { return -1; },
+         [](PHYSFS_Io* io, PHYSFS_uint64 offset) -> int {
+            auto b = static_cast<BufferIo*>(io->opaque);
+            if (offset > b->data.size())
+               return 0;
+            b->pos = offset;
+            return 1;
+         },
+         [](PHYSFS_Io* io) -> PHYSFS_sint64 {
+            return PHYSFS_sint64(static_cast<BufferIo*>(io->opaque)->pos);
+         },
+         [](PHYSFS_Io* io) -> PHYSFS_sint64 {
+            return PHYSFS_sint64(static_cast<BufferIo*>(io->opaque)->data.size());
+         },
+         [](PHYSFS_Io* io) -> PHYSFS_Io* {
+            if (failDuplicates)
+               throw std::runtime_error("duplicate failed on purpose");
+            return createBufferIo(static_cast<BufferIo*>(io->opaque)->data);
+         },
+         [](PHYSFS_Io*) -> int { return 1; },
+         [](PHYSFS_Io* io) {
+            delete static_cast<BufferIo*>(io->opaque);
+            delete io;
+         },
+         nullptr
+      };
+
+      auto io = new PHYSFS_Io {funcs};
+      io->opaque = new BufferIo {data};
+      return io;
+   }
+}
+
+/// Mounts a groupfile through an io without readAt, so PHYSFS_readAt has to  
+/// duplicate the entry's io, and makes that duplicate throw. The handle's    
+/// lock has to be free again afterwards, for this thread and any other       
+static int cmd_checkreadatfail(char*) {
+   const std::string contents = "read at an offset, through a duplicate";
+   const auto grp = makeGrp({{"DATA.TXT", contents}});
+
+   const int failedBefore = failed_checks;
+   auto context = PHYSFS_createContext();
+   if (not check(context != nullptr, "create a context"))
+      return 1;
+
+   bool stuck = false;
+   {
+      MetaPhysFS::ContextScope scope {context};
+      failDuplicates = false;
+      PHYSFS_File* f = nullptr;
+      try {
+         if (check(PHYSFS_mountIo(createBufferIo(grp), "checkreadatfail.grp", "/", 1), "mount the groupfile"))
+            f = PHYSFS_openRead("DATA.TXT");
+      }
+      catch (...) {}
+
+      if (check(f != nullptr, "open DATA.TXT")) {
+         char buf[64] {};
+         failDuplicates = true;
+         PHYSFS_sint64 rc;
+         try { rc = PHYSFS_readAt(f, 5, buf, 10); }
+         catch (...) { rc = -1; }
+         check(rc < 0, "readAt fails while duplicates fail");
+         failDuplicates = false;
+
+         // atLock is recursive, so only another thread can tell if it  
+         // was left held                                               
+         std::atomic<bool> done {false};
+         std::string got;
+         std::thread other {[&] {
+            try {
+               const auto n = PHYSFS_readAt(f, 5, buf, 10);
+               if (n > 0)
+                  got.assign(buf, size_t(n));
+            }
+            catch (...) {}
+            done = true;
+         }};
+         for (int waited = 0; not done and waited < 500; ++waited)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+         stuck = not check(done, "atLock is released after a failed readAt");
+         if (stuck)
+            other.detach();
+         else {
+            other.join();
+            check(got == contents.substr(5, 10), std::format("readAt works again, and got [{}]", got));
+            PHYSFS_close(f);
+         }
+      }
+   }
+
+   // A stuck handle is leaked along with its context, rather than hang 
+   if (not stuck)
+      PHYSFS_destroyContext(context);
+   if (failed_checks == failedBefore)
+      std::println("Successful.");
+   return 1;
+}
+
+/// PHYSFS_setAsyncThreads from an op's completion, which runs on an i/o     
+/// thread, has to fail with PHYSFS_ERR_BUSY instead of joining itself        
+static int cmd_checkasyncbusy(char*) {
+   struct Result {
+      std::atomic<bool> done {false};
+      int rc = -1;
+      PHYSFS_ErrorCode error = PHYSFS_ERR_OK;
+   } result;
+
+   PHYSFS_AsyncOp op {};
+   op.type = PHYSFS_ASYNC_OPEN_READ;
+   op.path = "checkasyncbusy/missing.txt";
+   op.userdata = &result;
+   op.complete = [](PHYSFS_AsyncOp* op) {
+      auto r = static_cast<Result*>(op->userdata);
+      PHYSFS_getLastErrorCode();
+      r->rc = PHYSFS_setAsyncThreads(2);
+      r->error = PHYSFS_getLastErrorCode();
+      r->done = true;
+   };
+
+   const int failedBefore = failed_checks;
+   if (not check(PHYSFS_submitAsync(&op), "queue an op on an i/o thread"))
+      return 1;
+
+   for (int waited = 0; not result.done and waited < 500; ++waited)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+   if (check(result.done, "the op completes")) {
+      check(result.rc == 0 and result.error == PHYSFS_ERR_BUSY,
+         std::format("setAsyncThreads on an i/o thread fails with [{}], got [{}]",
+            PHYSFS_getErrorByCode(PHYSFS_ERR_BUSY), PHYSFS_getErrorByCode(result.error)));
+      check(PHYSFS_setAsyncThreads(2), "setAsyncThreads works off the i/o threads");
+   }
+
+   if (failed_checks == failedBefore)
+      std::println("Successful.");
+   return 1;
+}
+
+/// Mounts a groupfile and a directory from (scratchDir) with a schedule set, 
+/// and makes sure reads of both land in their mount's scheduler, in the      
+/// class of the thread that made them. Mounts made after the schedule is     
+/// cleared again have no scheduler                                           
+static int cmd_checkschedulemount(char* args) {
+   if (*args == '\"') {
+      args++;
+      args[strlen(args) - 1] = '\0';
+   }
+
+   const std::string contents = "read through a scheduler";
+   const auto grp = makeGrp({{"DATA.TXT", contents}});
+   const std::string sep = PHYSFS_getDirSeparator();
+   const auto grpPath = std::string(args) + sep + "checkschedulemount.grp";
+   const auto dirPath = std::string(args) + sep + "checkschedulemount";
+   const auto dirFile = dirPath + sep + "DATA.TXT";
+
+   std::error_code ignored;
+   std::filesystem::create_directories(dirPath, ignored);
+   bool written = true;
+   for (const auto& [path, data] : {std::pair {grpPath, grp}, std::pair {dirFile, contents}}) {
+      auto file = fopen(path.c_str(), "wb");
+      written = written and file and fwrite(data.data(), 1, data.size(), file) == data.size();
+      if (file)
+         fclose(file);
+   }
+
+   const int failedBefore = failed_checks;
+   if (check(written, "write the groupfile and the directory")) {
+      PHYSFS_IoSchedule schedule {};
+      schedule.queueDepth = 2;
+      check(PHYSFS_setIoSchedule(&schedule), "set a schedule");
+
+      const std::pair<std::string, std::string> mounts[] {
+         {grpPath, "checkschedulemount/grp"},
+         {dirPath, "checkschedulemount/dir"}
+      };
+      for (const auto& [path, point] : mounts) {
+         if (not check(PHYSFS_mount(path.c_str(), point.c_str(), 1), "mount " + path))
+            continue;
+
+         const auto previous = PHYSFS_getIoPriority(nullptr);
+         PHYSFS_setIoPriority(PHYSFS_IO_BACKGROUND, 0);
+         std::string got;
+         if (auto f = PHYSFS_openRead((point + "/DATA.TXT").c_str())) {
+            got.resize(contents.size());
+            const auto rc = PHYSFS_readBytes(f, got.data(), got.size());
+            got.resize(rc > 0 ? size_t(rc) : 0);
+            PHYSFS_close(f);
+         }
+         PHYSFS_setIoPriority(previous, 0);
+         check(got == contents, "read DATA.TXT from " + path);
+
+         PHYSFS_IoSchedulerStats stats {};
+         if (check(PHYSFS_getMountIoSchedulerStats(path.c_str(), &stats), path + " has a scheduler")) {
+            const auto& background = stats.classes[PHYSFS_IO_BACKGROUND];
+            check(background.requests > 0 and background.bytes >= contents.size(),
+               std::format("{} served the read in the background class, got {} requests of {} bytes",
+                  path, background.requests, background.bytes));
+         }
+         PHYSFS_unmount(path.c_str());
+      }
+
+      check(PHYSFS_setIoSchedule(nullptr), "clear the schedule");
+      if (check(PHYSFS_mount(dirPath.c_str(), "checkschedulemount/dir", 1), "mount the directory again")) {
+         PHYSFS_IoSchedulerStats stats {};
+         check(not PHYSFS_getMountIoSchedulerStats(dirPath.c_str(), &stats),
+            "a mount made without a schedule has no scheduler");
+         PHYSFS_unmount(dirPath.c_str());
+      }
+   }
+
+   std::filesystem::remove(grpPath, ignored);
+   std::filesystem::remove_all(dirPath, ignored);
+   if (failed_checks == failedBefore)
+      std::println("Successful.");
+   return 1;
+}
+
+/// Writes (count) big endian u32s and reads them back, one PHYSFS_write or   
+/// PHYSFS_read per element, then with PHYSFS_writeArray/PHYSFS_readArray     
+static int cmd_benchswap(char* args) {
+   int count = 0;
+   if (sscanf(args, "%d", &count) != 1 or count <= 0) {
+      std::println("usage: benchswap <count>");
+      return 1;
+   }
+
+   const char* writeDir = PHYSFS_getWriteDir();
+   if (not writeDir) {
+      std::println("Set a write dir first.");
+      return 1;
+   }
+
+   std::vector<PHYSFS_uint32> values(static_cast<size_t>(count));
+   for (int i = 0; i < count; ++i)
+      values[size_t(i)] = PHYSFS_uint32(i) * 2654435761u;
+
+   const auto time = [](auto&& what) {
+      const auto start = std::chrono::steady_clock::now();
+      const bool ok = what();
+      const auto end = std::chrono::steady_clock::now();
+      return ok ? std::chrono::duration<double, std::milli>(end - start).count() : -1.0;
+   };
+
+   const auto write = [&](bool bulk) {
+      auto f = PHYSFS_openWrite("benchswap.bin");
+      if (not f)
+         return false;
+
+      bool ok = true;
+      if (bulk)
+         ok = PHYSFS_writeArray<std::endian::big>(f, values) == count;
+      else for (auto v : values) {
+         if (not PHYSFS_write<std::endian::big>(f, v)) {
+            ok = false;
+            break;
+         }
+      }
+      return PHYSFS_close(f) and ok;
+   };
+
+   // The write dir is mounted for the reads, unless it already is      
+   bool mounted = false;
+   try {
+      PHYSFS_getMountPoint(writeDir);
+   }
+   catch (...) {
+      mounted = true;
+   }
+   if (mounted and not PHYSFS_mount(writeDir, "benchswap", 1)) {
+      std::println("Couldn't mount the write dir.");
+      return 1;
+   }
+   const auto path = std::string(PHYSFS_getMountPoint(writeDir)) + "benchswap.bin";
+
+   std::vector<PHYSFS_uint32> back(static_cast<size_t>(count));
+   const auto read = [&](int mode, PHYSFS_uint64 buffer) {
+      std::fill(back.begin(), back.end(), 0);
+      auto f = PHYSFS_openRead(path.c_str());
+      if (not f or not PHYSFS_setBuffer(f, buffer))
+         return false;
+
+      bool ok = true;
+      if (mode == 0) {
+         for (auto& v : back) {
+            if (not PHYSFS_read<std::endian::big>(f, &v)) {
+               ok = false;
+               break;
+            }
+         }
+      }
+      else if (mode == 1)
+         ok = PHYSFS_readArray<std::endian::big>(f, back) == count;
+      else
+         ok = PHYSFS_readArray<std::endian::native>(f, back) == count;
+      PHYSFS_close(f);
+      return ok and (mode == 2 or back == values);
+   };
+
+   const double results[] = {
+      time([&] { return write(false); }),
+      time([&] { return write(true); }),
+      time([&] { return read(0, 0); }),
+      time([&] { return read(0, 64 * 1024); }),
+      time([&] { return read(1, 0); }),
+      time([&] { return read(2, 0); }),
+   };
+   static constexpr const char* names[] = {
+      "PHYSFS_write per element",
+      "PHYSFS_writeArray",
+      "PHYSFS_read per element",
+      "PHYSFS_read per element, 64 KiB buffer",
+      "PHYSFS_readArray, swapped",
+      "PHYSFS_readArray, native (no swap)",
+   };
+
+   PHYSFS_delete("benchswap.bin");
+   if (mounted)
+      PHYSFS_unmount(writeDir);
+
+   std::println("{} big endian u32 values:", count);
+   for (size_t i = 0; i < std::size(results); ++i) {
+      if (results[i] < 0)
+         std::println("   {:<40} failed", names[i]);
+      else
+         std::println("   {:<40} {:9.2f} ms, {:7.2f} ns per value",
+            names[i], results[i], results[i] * 1e6 / count);
+   }
+   return 1;
+}
+
+static int cmd_allocstats(char* args) {
+   static constexpr const char* names[] = {
+      "general", "dirtree", "filehandle", "decompress", "cache", "total"
+   };
+
+   std::println("{:<11} {:>12} {:>8} {:>12} {:>10}",
+      "tag", "live bytes", "live", "peak bytes", "allocs");
+   for (int tag = 0; tag <= PHYSFS_ALLOC_TAG_COUNT; ++tag) {
+      PHYSFS_AllocStats stats;
+      if (not PHYSFS_getAllocStats(PHYSFS_AllocTag(tag), &stats))
+         continue;
+      std::println("{:<11} {:>12} {:>8} {:>12} {:>10}", names[tag],
+         stats.liveBytes, stats.liveCount, stats.peakBytes, stats.totalCount);
+   }
+   return 1;
+}
+
+
+
+/* must have spaces trimmed prior to this call. */
+static int count_args(const char* str) {
+   int retval = 0;
+   int in_quotes = 0;
+
+   if (str != nullptr) {
+      for (; *str != '\0'; str++) {
+         if (*str == '\"')
+            in_quotes = !in_quotes;
+         else if ((*str == ' ') && (!in_quotes))
+            retval++;
+      } /* for */
+      retval++;
+   } /* if */
+
+   return retval;
+} /* count_args */
+
+
+static int cmd_help(char* args);
+
+typedef struct
+{
+   const char* cmd;
+   int (*func)(char* args);
+   int argcount;
+   const char* usage;
+} command_info;
+
+static const command_info commands[] =
+{
+   {"quit", cmd_quit, 0, nullptr},
+   {"q", cmd_quit, 0, nullptr},
+   {"help", cmd_help, 0, nullptr},
+   {"init", cmd_init, 1, "<argv0>"},
+   {"deinit", cmd_deinit, 0, nullptr},
+   {"addarchive", cmd_addarchive, 2, "<archiveLocation> <append>"},
+   {"mount", cmd_mount, 3, "<archiveLocation> <mntpoint> <append>"},
+   {"mountmem", cmd_mount_mem, 3, "<archiveLocation> <mntpoint> <append>"},
+   {"mounthandle", cmd_mount_handle, 3, "<archiveLocation> <mntpoint> <append>"},
+   {"removearchive", cmd_removearchive, 1, "<archiveLocation>"},
+   {"unmount", cmd_removearchive, 1, "<archiveLocation>"},
+   {"enumerate", cmd_enumerate, 1, "<dirToEnumerate>"},
+   {"ls", cmd_enumerate, 1, "<dirToEnumerate>"},
+   {"readdir", cmd_readdir, 1, "<dirToEnumerate>"},
+   {"tree", cmd_tree, 1, "<dirToEnumerate>"},
+   {"getlasterror", cmd_getlasterror, 0, nullptr},
+   {"getdirsep", cmd_getdirsep, 0, nullptr},
+   {"getcdromdirs", cmd_getcdromdirs, 0, nullptr},
+   {"getsearchpath", cmd_getsearchpath, 0, nullptr},
+   {"getbasedir", cmd_getbasedir, 0, nullptr},
+   {"getuserdir", cmd_getuserdir, 0, nullptr},
+   {"getprefdir", cmd_getprefdir, 2, "<org> <app>"},
+   {"getwritedir", cmd_getwritedir, 0, nullptr},
+   {"setwritedir", cmd_setwritedir, 1, "<newWriteDir>"},
+   {"permitsymlinks", cmd_permitsyms, 1, "<1or0>"},
+   {"setsaneconfig", cmd_setsaneconfig, 5, "<org> <appName> <arcExt> <includeCdRoms> <archivesFirst>"},
+   {"mkdir", cmd_mkdir, 1, "<dirToMk>"},
+   {"delete", cmd_delete, 1, "<dirToDelete>"},
+   {"getrealdir", cmd_getrealdir, 1, "<fileToFind>"},
+   {"exists", cmd_exists, 1, "<fileToCheck>"},
+   {"isdir", cmd_isdir, 1, "<fileToCheck>"},
+   {"issymlink", cmd_issymlink, 1, "<fileToCheck>"},
+   {"cat", cmd_cat, 1, "<fileToCat>"},
+   {"cat2", cmd_cat2, 2, "<fileToCat1> <fileToCat2>"},
+   {"filelength", cmd_filelength, 1, "<fileToCheck>"},
+   {"stat", cmd_stat, 1, "<fileToStat>"},
+   {"statex", cmd_statex, 1, "<fileToStat>"},
+   {"append", cmd_append, 1, "<fileToAppend>"},
+   {"write", cmd_write, 1, "<fileToCreateOrTrash>"},
+   {"getlastmodtime", cmd_getlastmodtime, 1, "<fileToExamine>"},
+   {"setbuffer", cmd_setbuffer, 1, "<bufferSize>"},
+   {"stressbuffer", cmd_stressbuffer, 1, "<bufferSize>"},
+   {"crc32", cmd_crc32, 1, "<fileToHash>"},
+   {"getmountpoint", cmd_getmountpoint, 1, "<dir>"},
+   {"setroot", cmd_setroot, 2, "<archiveLocation> <root>"},
+   {"benchcasefold", cmd_benchcasefold, 1, "<iterations>"},
+   {"benchopenclose", cmd_benchopenclose, 1, "<fileToOpen>"},
+   {"benchreadat", cmd_benchreadat, 1, "<fileToRead>"},
+   {"benchreadahead", cmd_benchreadahead, 3, "<archiveLocation> <entry> <latencyUs>"},
+   {"setinline", cmd_setinline, 2, "<maxFileSize> <maxBytes>"},
+   {"benchinline", cmd_benchinline, 2, "<archiveLocation> <maxFileSize>"},
+   {"benchmount", cmd_benchmount, 2, "<archiveLocation> <iterations>"},
+   {"benchcontexts", cmd_benchcontexts, 3, "<archiveLocation> <sessions> <passes>"},
+   {"benchshare", cmd_benchshare, 2, "<archiveLocation> <mounts>"},
+   {"benchdecrypt", cmd_benchdecrypt, 3, "<archiveLocation> <entry> <password>"},
+   {"benchstat", cmd_benchstat, 1, "<dirToStat>"},
+   {"benchpriority", cmd_benchpriority, 3, "<archiveLocation> <streamedEntry> <backgroundMiBps>"},
+   {"benchasync", cmd_benchasync, 2, "<archiveLocation> <threads>"},
+#if defined(__linux__)
+   {"benchdirectio", cmd_benchdirectio, 2, "<workingSetFile> <streamedFile>"},
+#endif
+   {"checknested", cmd_checknested, 1, "<scratchDir>"},
+   {"checkmergedlisting", cmd_checkmergedlisting, 0, nullptr},
+   {"checkdirtree", cmd_checkdirtree, 0, nullptr},
+   {"checkdirectentry", cmd_checkdirectentry, 1, "<scratchDir>"},
+   {"writepack", cmd_writepack, 3, "<dirToPack> <packToWrite> <compress>"},
+   {"checknewlog", cmd_checknewlog, 1, "<scratchDir>"},
+   {"benchwrites", cmd_benchwrites, 2, "<fileCount> <fileSize>"},
+   {"benchcommit", cmd_benchcommit, 3, "<fileCount> <fileSize> <threads>"},
+   {"checktxnfail", cmd_checktxnfail, 1, "<scratchDir>"},
+   {"checkcommitcontexts", cmd_checkcommitcontexts, 2, "<writeDir1> <writeDir2>"},
+   {"checkreadatfail", cmd_checkreadatfail, 0, nullptr},
+   {"checkasyncbusy", cmd_checkasyncbusy, 0, nullptr},
+   {"checkschedulemount", cmd_checkschedulemount, 1, "<scratchDir>"},
+   {"benchswap", cmd_benchswap, 1, "<count>"},
+   {"allocstats", cmd_allocstats, 0, nullptr},
+   {"simmedia", cmd_simmedia, 6, "<latencyUs> <jitterUs> <seekUs> <MiBps> <queueDepth> <seed>"},
+   {"mountsim", cmd_mountsim, 3, "<archiveLocation> <mntpoint> <append>"},
+   {"benchsuite", cmd_benchsuite, 1, "<archiveLocation>"},
+   {"mountcached", cmd_mountcached, 4, "<archiveLocation> <mntpoint> <blockSize> <readAhead>"},
+   {"setiocachesize", cmd_setiocachesize, 1, "<bytes>"},
+   {"iocachestats", cmd_iocachestats, 0, nullptr},
+   {nullptr, nullptr, -1, nullptr}
+};
+
+
+static void output_usage(const char* intro, const command_info* cmdinfo) {
+   if (cmdinfo->argcount == 0)
+      printf("%s \"%s\" (no arguments)\n", intro, cmdinfo->cmd);
+   else
+      printf("%s \"%s %s\"\n", intro, cmdinfo->cmd, cmdinfo->usage);
+} /* output_usage */
+
+
+static int cmd_help(char* args) {
+   const command_info* i;
+
+   printf("Commands:\n");
+   for (i = commands; i->cmd != nullptr; i++)
+      output_usage("  -", i);
+
+   return 1;
+} /* output_cmd_help */
+
+
+static void trim_command(const char* orig, char* copy) {
+   const char* i;
+   char* writeptr = copy;
+   int spacecount = 0;
+   int have_first = 0;
+
+   for (i = orig; *i != '\0'; i++) {
+      if (*i == ' ') {
+         if ((*(i + 1) != ' ') && (*(i + 1) != '\0')) {
+            if ((have_first) && (!spacecount)) {
+               spacecount++;
+               *writeptr = ' ';
+               writeptr++;
+            } /* if */
+         } /* if */
+      } /* if */
+      else {
+         have_first = 1;
+         spacecount = 0;
+         *writeptr = *i;
+         writeptr++;
+      } /* else */
+   } /* for */
+
+   *writeptr = '\0';
+
+   /*
+   printf("\n command is [%s].\n", copy);
+   */
+} /* trim_command */
+
+
+static int process_command(char* complete_cmd) {
+   const command_info* i;
+   char* cmd_copy;
+   char* args;
+   int rc = 1;
+
+   if (complete_cmd == nullptr)  /* can happen if user hits CTRL-D, etc. */
+   {
+      printf("\n");
+      return 0;
+   } /* if */
+
+   cmd_copy = (char*)malloc(strlen(complete_cmd) + 1);
+   if (cmd_copy == nullptr) {
+      printf("\n\n\nOUT OF MEMORY!\n\n\n");
+      return 0;
+   } /* if */
+
+   trim_command(complete_cmd, cmd_copy);
+   args = strchr(cmd_copy, ' ');
+   if (args != nullptr) {
+      *args = '\0';
+      args++;
+   } /* else */
+
+   if (cmd_copy[0] != '\0') {
+      for (i = commands; i->cmd != nullptr; i++) {
+         if (strcmp(i->cmd, cmd_copy) == 0) {
+            if ((i->argcount >= 0) && (count_args(args) != i->argcount))
+               output_usage("usage:", i);
+            else
+               rc = i->func(args);
+            break;
+         } /* if */
+      } /* for */
+
+      if (i->cmd == nullptr)
+         printf("Unknown command. Enter \"help\" for instructions.\n");
+
+   #if (defined PHYSFS_HAVE_READLINE)
+      add_history(complete_cmd);
+      if (history_file) {
+         fprintf(history_file, "%s\n", complete_cmd);
+         fflush(history_file);
+      } /* if */
+   #endif
+
+   } /* if */
+
+   free(cmd_copy);
+   return rc;
+} /* process_command */
+
+
+static void open_history_file(void) {
+#if (defined PHYSFS_HAVE_READLINE)
+#if 0
+   const char* envr = getenv("TESTPHYSFS_HISTORY");
+   if (!envr)
+      return;
+#else
+   char envr[256];
+   strcpy(envr, PHYSFS_getUserDir());
+   strcat(envr, ".testphys_history");
+#endif
+
+   if (access(envr, F_OK) == 0) {
+      char buf[512];
+      FILE* f = fopen(envr, "r");
+      if (!f) {
+         printf("\n\n"
             "Could not open history file [%s] for reading!\n"
             "  Will not have past history available.\n\n",
             envr);
@@ -1471,7 +3889,7 @@ int main(int argc, char** argv) {
        printf(" it makes you shoot teh railgun bettar.\n");
    */
 
-   return 0;
+   return failed_checks ? 1 : 0;
 } /* main */
 
 /* end of test_physfs.c ... */